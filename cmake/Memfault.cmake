@@ -12,7 +12,8 @@
 #   MEMFAULT_COMPONENTS_SRCS MEMFAULT_COMPONENTS_INC_FOLDERS)
 #
 # NOTE: By default, the list of sources returned will be for ARM Cortex-M targets but ARCH_XTENSA can be
-# passed as an optional final argument to return sources expected for ARCH_XTENSA architectures
+# passed as an optional final argument to return sources expected for ARCH_XTENSA architectures and
+# ARCH_POSIX for the Linux host port (ports/posix)
 #
 # After invoking the function ${MEMFAULT_COMPONENTS_SRCS} will contain the sources
 # needed for the library and ${MEMFAULT_COMPONENTS_INC_FOLDERS} will contain the include
@@ -34,6 +35,11 @@ function(memfault_library sdk_root components src_var_name inc_var_name)
     list(FILTER SDK_SRC EXCLUDE REGEX arch_arm_cortex_m.c)
   elseif(arch STREQUAL "ARCH_ARM_CORTEX_M")
     list(FILTER SDK_SRC EXCLUDE REGEX memfault_fault_handling_xtensa.c)
+  elseif(arch STREQUAL "ARCH_POSIX")
+    list(FILTER SDK_SRC EXCLUDE REGEX memfault_fault_handling_arm.c)
+    list(FILTER SDK_SRC EXCLUDE REGEX memfault_fault_handling_xtensa.c)
+    list(FILTER SDK_SRC EXCLUDE REGEX memfault_coredump_regions_armv7.c)
+    list(FILTER SDK_SRC EXCLUDE REGEX arch_arm_cortex_m.c)
   else()
     message(FATAL_ERROR "Unsupported Arch: ${arch}")
   endif()
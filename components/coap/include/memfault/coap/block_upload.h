@@ -0,0 +1,201 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Posts the data queued in the packetizer over CoAP (RFC 7252), for constrained networks such as
+//! Thread or NB-IoT where HTTP over TLS is too heavy.
+//!
+//! Every packetizer message is sent as one chunk with a Block1 transfer (RFC 7959):
+//!
+//!   CON POST /chunks/<device_serial>?key=<project key>
+//!     Content-Format: application/octet-stream, Block1: NUM/M/SZX, Size1: <chunk length>
+//!
+//! The block size is the largest one (16 to 1024 bytes) which fits in
+//! MEMFAULT_COAP_UPLOAD_TX_BUF_SIZE next to the header and options of the request, so each block
+//! is read straight from the packetizer into the buffer the datagram is sent from. A server can
+//! ask for smaller blocks in its response, as RFC 7959 allows. Blocks are sent as confirmable
+//! messages and retransmitted with exponential backoff until they are acknowledged. The message
+//! is only deleted from the data source once the final block has been acknowledged (see
+//! sPacketizerConfig.enable_delivery_confirmation). If the upload fails, the message is sent again
+//! in its entirety by the next upload.
+//!
+//! Like memfault/http/async_upload.h, the state machine never blocks. The application owns the UDP
+//! socket and drives progress:
+//!
+//!   memfault_coap_upload_start(&s_upload, &cfg);
+//!   ... then, from the event loop:
+//!   - datagram received -> memfault_coap_upload_on_datagram()
+//!   - memfault_coap_upload_get_timeout_ms() elapsed since the last datagram was sent ->
+//!       memfault_coap_upload_on_timeout()
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Size of the buffer requests are built in. It bounds the size of the datagrams sent so it
+//! should not exceed the MTU of the link (i.e 1280 bytes for IPv6, less the UDP header)
+#ifndef MEMFAULT_COAP_UPLOAD_TX_BUF_SIZE
+#define MEMFAULT_COAP_UPLOAD_TX_BUF_SIZE 256
+#endif
+
+//! Time to wait for the first acknowledgement of a block (ACK_TIMEOUT of RFC 7252). It doubles
+//! with every retransmission.
+#ifndef MEMFAULT_COAP_ACK_TIMEOUT_MS
+#define MEMFAULT_COAP_ACK_TIMEOUT_MS 2000
+#endif
+
+//! Number of times a block is retransmitted before the upload is given up on
+#ifndef MEMFAULT_COAP_MAX_RETRANSMIT
+#define MEMFAULT_COAP_MAX_RETRANSMIT 4
+#endif
+
+//! Path of the chunks resource. The device serial is appended as a second path segment.
+#ifndef MEMFAULT_COAP_CHUNKS_PATH
+#define MEMFAULT_COAP_CHUNKS_PATH "chunks"
+#endif
+
+//! The largest device serial and project key the upload can send
+#define MEMFAULT_COAP_MAX_DEVICE_SERIAL_LEN 64
+#define MEMFAULT_COAP_MAX_PROJECT_KEY_LEN 64
+
+typedef enum MfltCoapUploadResult {
+  kMfltCoapUploadResult_Success = 0,
+  kMfltCoapUploadResult_SendError = -1,
+  //! A block was not acknowledged after MEMFAULT_COAP_MAX_RETRANSMIT retransmissions
+  kMfltCoapUploadResult_Timeout = -2,
+  //! The server answered with a Reset message
+  kMfltCoapUploadResult_Reset = -3,
+  //! The server answered with an error response code, see sMfltCoapUpload.response_code
+  kMfltCoapUploadResult_ResponseError = -4,
+  //! The request headers don't fit in MEMFAULT_COAP_UPLOAD_TX_BUF_SIZE
+  kMfltCoapUploadResult_BufferTooSmall = -5,
+} eMfltCoapUploadResult;
+
+typedef struct MfltCoapUploadTransport {
+  //! Sends a datagram to the server
+  //!
+  //! @return 0 if the datagram was sent, else error code
+  int (*send)(void *ctx, const void *datagram, size_t datagram_len);
+} sMfltCoapUploadTransport;
+
+typedef struct MfltCoapUpload sMfltCoapUpload;
+
+//! Invoked once the upload has completed
+//!
+//! @param upload The upload which completed
+//! @param result kMfltCoapUploadResult_Success if all the data was posted, else the reason the
+//!   upload was stopped
+//! @param ctx The 'complete_ctx' provided in the upload configuration
+typedef void (*MfltCoapUploadCompleteCb)(sMfltCoapUpload *upload, eMfltCoapUploadResult result,
+                                         void *ctx);
+
+typedef enum MfltCoapUploadStartStatus {
+  kMfltCoapUploadStartStatus_Started = 0,
+  kMfltCoapUploadStartStatus_NoDataFound = 1,
+} eMfltCoapUploadStartStatus;
+
+typedef struct MfltCoapUploadConfig {
+  //! The Memfault Project Key, sent in the "key" query parameter of every request
+  const char *project_key;
+  const sMfltCoapUploadTransport *transport;
+  //! Passed to all the 'transport' operations
+  void *transport_ctx;
+  MfltCoapUploadCompleteCb complete_cb;
+  void *complete_ctx;
+} sMfltCoapUploadConfig;
+
+typedef struct MfltCoapUploadStats {
+  //! Messages whose final block was acknowledged
+  uint32_t num_messages;
+  //! Blocks acknowledged by the server
+  uint32_t num_blocks;
+  uint32_t num_retransmissions;
+  //! Bytes of the datagrams sent (including retransmissions) and received, i.e the UDP payloads
+  uint32_t tx_bytes;
+  uint32_t rx_bytes;
+} sMfltCoapUploadStats;
+
+typedef enum MfltCoapUploadState {
+  kMfltCoapUploadState_Idle = 0,
+  //! A block was sent, waiting for it to be acknowledged
+  kMfltCoapUploadState_AwaitingAck,
+  //! The server acknowledged the block with an empty ACK, waiting for its separate response
+  kMfltCoapUploadState_AwaitingResponse,
+} eMfltCoapUploadState;
+
+struct MfltCoapUpload {
+  //! The code of the last response received, (class << 5) | detail, i.e 0x44 for 2.04 Changed
+  uint8_t response_code;
+  //! The size of the blocks being sent, in bytes
+  size_t block_size;
+  //! Counters accumulated over every upload made with this context
+  sMfltCoapUploadStats stats;
+  //! The message ID of the next request. It is seeded with memfault_platform_coap_get_random()
+  //! by the first upload, as RFC 7252 section 4.4 recommends, so a device which rebooted doesn't
+  //! reuse the IDs of its last requests. Message IDs then carry on from one upload to the next so
+  //! a server doesn't mistake a new request for a duplicate.
+  uint16_t next_message_id;
+
+  // For internal use only
+  bool message_id_seeded;
+  eMfltCoapUploadState state;
+  sMfltCoapUploadConfig cfg;
+  const char *device_serial;
+  uint16_t message_id;
+  uint16_t token;
+  uint8_t szx;
+  uint32_t block_num;
+  //! Size of the chunk being sent and the number of bytes acknowledged so far
+  uint32_t msg_len;
+  uint32_t msg_offset;
+  size_t block_payload_len;
+  uint8_t num_retransmissions;
+  //! Bytes pulled from the packetizer which haven't been sent yet, kept at the end of tx_buf
+  size_t pending_len;
+  size_t tx_len;
+  uint8_t tx_buf[MEMFAULT_COAP_UPLOAD_TX_BUF_SIZE];
+};
+
+//! Starts posting the data queued in the packetizer
+//!
+//! @param upload The upload context. It must be zero initialized before it is used for the first
+//!   time and remain valid until the upload completes. It can then be reused for the next upload.
+//! @param cfg The configuration of the upload
+//!
+//! @return kMfltCoapUploadStartStatus_Started if the upload was started,
+//!   kMfltCoapUploadStartStatus_NoDataFound if there is no data to send, else a negative error code
+int memfault_coap_upload_start(sMfltCoapUpload *upload, const sMfltCoapUploadConfig *cfg);
+
+//! To be called with every datagram received from the server while an upload is in progress
+void memfault_coap_upload_on_datagram(sMfltCoapUpload *upload, const void *datagram,
+                                      size_t datagram_len);
+
+//! To be called when memfault_coap_upload_get_timeout_ms() has elapsed since the last datagram was
+//! sent without the upload making progress. The block is retransmitted or, once
+//! MEMFAULT_COAP_MAX_RETRANSMIT retransmissions have been made, the upload fails.
+void memfault_coap_upload_on_timeout(sMfltCoapUpload *upload);
+
+//! @return How long to wait for a response to the last datagram sent before calling
+//!   memfault_coap_upload_on_timeout()
+uint32_t memfault_coap_upload_get_timeout_ms(const sMfltCoapUpload *upload);
+
+//! @return true if an upload is in progress
+bool memfault_coap_upload_in_progress(const sMfltCoapUpload *upload);
+
+//! @return a random number the message IDs of an upload context are seeded with
+//!
+//! @note By default this function is defined as a weak symbol which derives the number from the
+//!   device serial and the time since boot. Platforms with a hardware RNG can override it.
+uint32_t memfault_platform_coap_get_random(void);
+
+#ifdef __cplusplus
+}
+#endif
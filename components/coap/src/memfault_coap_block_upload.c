@@ -0,0 +1,554 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/coap/block_upload.h"
+
+#include <string.h>
+
+#include "memfault/core/compiler.h"
+#include "memfault/core/data_packetizer.h"
+#include "memfault/core/debug_log.h"
+#include "memfault/core/errors.h"
+#include "memfault/core/math.h"
+#include "memfault/core/platform/core.h"
+#include "memfault/core/platform/device_info.h"
+
+// Message format, see RFC 7252 section 3
+#define COAP_VERSION 1
+#define COAP_HDR_LEN 4
+#define COAP_TOKEN_LEN 2
+#define COAP_PAYLOAD_MARKER 0xff
+
+#define COAP_TYPE_CON 0
+#define COAP_TYPE_NON 1
+#define COAP_TYPE_ACK 2
+#define COAP_TYPE_RST 3
+
+#define COAP_CODE(class, detail) ((uint8_t)(((class) << 5) | (detail)))
+#define COAP_CODE_EMPTY COAP_CODE(0, 0)
+#define COAP_CODE_POST COAP_CODE(0, 2)
+#define COAP_CODE_CONTINUE COAP_CODE(2, 31)
+#define COAP_CODE_CLASS(code) ((code) >> 5)
+
+#define COAP_OPTION_URI_PATH 11
+#define COAP_OPTION_CONTENT_FORMAT 12
+#define COAP_OPTION_URI_QUERY 15
+#define COAP_OPTION_BLOCK1 27
+#define COAP_OPTION_SIZE1 60
+
+#define COAP_CONTENT_FORMAT_OCTET_STREAM 42
+
+// Block1 option, see RFC 7959 section 2.2. Blocks are 2^(SZX + 4) bytes
+#define COAP_BLOCK_MAX_SZX 6
+#define COAP_BLOCK_SIZE(szx) ((size_t)1 << ((szx) + 4))
+#define COAP_BLOCK1_VALUE(num, more, szx) (((num) << 4) | ((uint32_t)(more) << 3) | (szx))
+//! A Block1 value which takes the most bytes to encode, to size the headers of a transfer
+#define COAP_BLOCK1_MAX_VALUE 0xffffff
+
+//! Space kept free at the end of tx_buf for packetizer output which doesn't fit in a block, see
+//! prv_pull_packetizer_data()
+#define CARRY_SPACE MEMFAULT_PACKETIZER_MIN_BUF_LEN
+
+//
+// Message encoding
+//
+
+typedef struct {
+  uint8_t *buf;
+  size_t len;
+  uint16_t last_option;
+} sCoapWriter;
+
+static void prv_write_option_nibble_ext(sCoapWriter *writer, uint32_t value) {
+  if (value >= 269) {
+    writer->buf[writer->len++] = (uint8_t)((value - 269) >> 8);
+    writer->buf[writer->len++] = (uint8_t)((value - 269) & 0xff);
+  } else if (value >= 13) {
+    writer->buf[writer->len++] = (uint8_t)(value - 13);
+  }
+}
+
+static uint8_t prv_option_nibble(uint32_t value) {
+  return (value >= 269) ? 14 : ((value >= 13) ? 13 : (uint8_t)value);
+}
+
+static void prv_write_option(sCoapWriter *writer, uint16_t number, const void *value,
+                             size_t value_len) {
+  const uint32_t delta = number - writer->last_option;
+  writer->buf[writer->len++] =
+      (uint8_t)((prv_option_nibble(delta) << 4) | prv_option_nibble((uint32_t)value_len));
+  prv_write_option_nibble_ext(writer, delta);
+  prv_write_option_nibble_ext(writer, (uint32_t)value_len);
+  memcpy(&writer->buf[writer->len], value, value_len);
+  writer->len += value_len;
+  writer->last_option = number;
+}
+
+//! Writes an option holding an unsigned integer, in as few bytes as possible
+static void prv_write_uint_option(sCoapWriter *writer, uint16_t number, uint32_t value) {
+  uint8_t encoded[4];
+  size_t len = 0;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    const uint8_t byte = (uint8_t)(value >> shift);
+    if ((len != 0) || (byte != 0)) {
+      encoded[len++] = byte;
+    }
+  }
+  prv_write_option(writer, number, encoded, len);
+}
+
+static void prv_write_hdr(uint8_t *buf, uint8_t type, size_t token_len, uint8_t code,
+                          uint16_t message_id) {
+  buf[0] = (uint8_t)((COAP_VERSION << 6) | (type << 4) | token_len);
+  buf[1] = code;
+  buf[2] = (uint8_t)(message_id >> 8);
+  buf[3] = (uint8_t)(message_id & 0xff);
+}
+
+//! Writes the header and options of a request for a block, up to and including the payload marker
+//!
+//! @return the number of bytes written
+static size_t prv_write_request_hdr(const sMfltCoapUpload *upload, uint8_t *buf,
+                                    uint32_t block1_value) {
+  prv_write_hdr(buf, COAP_TYPE_CON, COAP_TOKEN_LEN, COAP_CODE_POST, upload->message_id);
+  buf[COAP_HDR_LEN] = (uint8_t)(upload->token >> 8);
+  buf[COAP_HDR_LEN + 1] = (uint8_t)(upload->token & 0xff);
+
+  sCoapWriter writer = {
+    .buf = buf,
+    .len = COAP_HDR_LEN + COAP_TOKEN_LEN,
+  };
+  prv_write_option(&writer, COAP_OPTION_URI_PATH, MEMFAULT_COAP_CHUNKS_PATH,
+                   strlen(MEMFAULT_COAP_CHUNKS_PATH));
+  prv_write_option(&writer, COAP_OPTION_URI_PATH, upload->device_serial,
+                   strlen(upload->device_serial));
+  prv_write_uint_option(&writer, COAP_OPTION_CONTENT_FORMAT, COAP_CONTENT_FORMAT_OCTET_STREAM);
+  if (upload->cfg.project_key != NULL) {
+    char query[8 + MEMFAULT_COAP_MAX_PROJECT_KEY_LEN];
+    const size_t key_len = strlen(upload->cfg.project_key);
+    memcpy(query, "key=", 4);
+    memcpy(&query[4], upload->cfg.project_key, key_len);
+    prv_write_option(&writer, COAP_OPTION_URI_QUERY, query, 4 + key_len);
+  }
+  prv_write_uint_option(&writer, COAP_OPTION_BLOCK1, block1_value);
+  if (upload->block_num == 0) {
+    // the size of the whole transfer is only sent with the first block
+    prv_write_uint_option(&writer, COAP_OPTION_SIZE1, upload->msg_len);
+  }
+  writer.buf[writer.len++] = COAP_PAYLOAD_MARKER;
+  return writer.len;
+}
+
+//
+// Message decoding
+//
+
+typedef struct {
+  uint8_t type;
+  uint8_t code;
+  uint16_t message_id;
+  size_t token_len;
+  uint8_t token[8];
+  bool has_block1;
+  uint32_t block1_value;
+} sCoapMessage;
+
+static bool prv_read_option_nibble_ext(const uint8_t *buf, size_t len, size_t *offset,
+                                       uint32_t *value) {
+  if (*value == 13) {
+    if (*offset >= len) {
+      return false;
+    }
+    *value = 13 + buf[(*offset)++];
+  } else if (*value == 14) {
+    if ((*offset + 2) > len) {
+      return false;
+    }
+    *value = 269 + (((uint32_t)buf[*offset] << 8) | buf[*offset + 1]);
+    *offset += 2;
+  } else if (*value == 15) {
+    return false;
+  }
+  return true;
+}
+
+static bool prv_parse_message(const uint8_t *buf, size_t len, sCoapMessage *msg) {
+  if ((len < COAP_HDR_LEN) || ((buf[0] >> 6) != COAP_VERSION)) {
+    return false;
+  }
+
+  *msg = (sCoapMessage) {
+    .type = (buf[0] >> 4) & 0x3,
+    .token_len = buf[0] & 0xf,
+    .code = buf[1],
+    .message_id = (uint16_t)((buf[2] << 8) | buf[3]),
+  };
+  if ((msg->token_len > sizeof(msg->token)) || ((COAP_HDR_LEN + msg->token_len) > len)) {
+    return false;
+  }
+  memcpy(msg->token, &buf[COAP_HDR_LEN], msg->token_len);
+
+  size_t offset = COAP_HDR_LEN + msg->token_len;
+  uint32_t option_number = 0;
+  while ((offset < len) && (buf[offset] != COAP_PAYLOAD_MARKER)) {
+    uint32_t delta = buf[offset] >> 4;
+    uint32_t option_len = buf[offset] & 0xf;
+    offset++;
+    if (!prv_read_option_nibble_ext(buf, len, &offset, &delta) ||
+        !prv_read_option_nibble_ext(buf, len, &offset, &option_len) ||
+        ((offset + option_len) > len)) {
+      return false;
+    }
+    option_number += delta;
+
+    if ((option_number == COAP_OPTION_BLOCK1) && (option_len <= 3)) {
+      msg->has_block1 = true;
+      msg->block1_value = 0;
+      for (size_t i = 0; i < option_len; i++) {
+        msg->block1_value = (msg->block1_value << 8) | buf[offset + i];
+      }
+    }
+    offset += option_len;
+  }
+  return true;
+}
+
+//
+// Upload state machine
+//
+
+static void prv_complete(sMfltCoapUpload *upload, eMfltCoapUploadResult result) {
+  if (result != kMfltCoapUploadResult_Success) {
+    MEMFAULT_LOG_ERROR("CoAP upload failed: rv=%d, code=%d.%02d", (int)result,
+                       upload->response_code >> 5, upload->response_code & 0x1f);
+    // the message hasn't been acknowledged in its entirety, so it will be sent again by the next
+    // upload
+    memfault_packetizer_abort();
+  }
+
+  upload->state = kMfltCoapUploadState_Idle;
+  upload->pending_len = 0;
+  if (upload->cfg.complete_cb != NULL) {
+    upload->cfg.complete_cb(upload, result, upload->cfg.complete_ctx);
+  }
+}
+
+static bool prv_send(sMfltCoapUpload *upload, const void *datagram, size_t datagram_len) {
+  if (upload->cfg.transport->send(upload->cfg.transport_ctx, datagram, datagram_len) != 0) {
+    return false;
+  }
+  upload->stats.tx_bytes += (uint32_t)datagram_len;
+  return true;
+}
+
+//! Reads 'len' bytes of the chunk being sent into 'buf', from the bytes which were pulled from
+//! the packetizer but not sent yet and then from the packetizer itself
+//!
+//! Pending bytes live at the end of tx_buf, past the largest datagram of the transfer.
+//!
+//! @return false if the packetizer ran out of data before the end of the chunk
+static bool prv_pull_packetizer_data(sMfltCoapUpload *upload, uint8_t *buf, size_t len) {
+  const size_t from_pending = MEMFAULT_MIN(len, upload->pending_len);
+  if (from_pending != 0) {
+    memmove(buf, &upload->tx_buf[sizeof(upload->tx_buf) - upload->pending_len], from_pending);
+    upload->pending_len -= from_pending;
+  }
+
+  size_t offset = from_pending;
+  while (offset < len) {
+    const size_t space = len - offset;
+    eMemfaultPacketizerStatus status;
+    size_t read_len;
+    if (space >= MEMFAULT_PACKETIZER_MIN_BUF_LEN) {
+      read_len = space;
+      status = memfault_packetizer_get_next(&buf[offset], &read_len);
+      offset += read_len;
+    } else {
+      // The packetizer needs a minimum amount of room to make progress. Anything which doesn't
+      // fit in the block is kept for the next one.
+      uint8_t scratch[MEMFAULT_PACKETIZER_MIN_BUF_LEN];
+      read_len = sizeof(scratch);
+      status = memfault_packetizer_get_next(scratch, &read_len);
+      const size_t copy_len = MEMFAULT_MIN(read_len, space);
+      memcpy(&buf[offset], scratch, copy_len);
+      offset += copy_len;
+      upload->pending_len = read_len - copy_len;
+      memcpy(&upload->tx_buf[sizeof(upload->tx_buf) - upload->pending_len], &scratch[copy_len],
+             upload->pending_len);
+    }
+
+    if ((status == kMemfaultPacketizerStatus_NoMoreData) || (read_len == 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//! Builds the request for the next block of the chunk in tx_buf and sends it
+static void prv_send_next_block(sMfltCoapUpload *upload) {
+  const size_t remaining = upload->msg_len - upload->msg_offset;
+  const bool more = remaining > upload->block_size;
+  upload->block_payload_len = MEMFAULT_MIN(remaining, upload->block_size);
+
+  // every block gets a token of its own so a late response can't be mistaken for the response
+  // to the next block
+  upload->message_id = upload->next_message_id++;
+  upload->token = upload->message_id;
+  const size_t hdr_len = prv_write_request_hdr(
+      upload, upload->tx_buf, COAP_BLOCK1_VALUE(upload->block_num, more, upload->szx));
+  if (!prv_pull_packetizer_data(upload, &upload->tx_buf[hdr_len], upload->block_payload_len)) {
+    MEMFAULT_LOG_ERROR("Packetizer ran out of data at offset %d of %d",
+                       (int)upload->msg_offset, (int)upload->msg_len);
+    prv_complete(upload, kMfltCoapUploadResult_SendError);
+    return;
+  }
+  upload->tx_len = hdr_len + upload->block_payload_len;
+  upload->num_retransmissions = 0;
+
+  if (!prv_send(upload, upload->tx_buf, upload->tx_len)) {
+    prv_complete(upload, kMfltCoapUploadResult_SendError);
+    return;
+  }
+  upload->state = kMfltCoapUploadState_AwaitingAck;
+}
+
+//! Starts the Block1 transfer of the next message in the packetizer or completes the upload if
+//! there is no more data to send
+static void prv_start_next_message(sMfltCoapUpload *upload) {
+  const sPacketizerConfig cfg = {
+    // a message spans as many "memfault_packetizer_get_next" calls as there are blocks
+    .enable_multi_packet_chunk = true,
+    // only delete the message once the final block has been acknowledged
+    .enable_delivery_confirmation = true,
+  };
+  sPacketizerMetadata metadata;
+  if (!memfault_packetizer_begin(&cfg, &metadata)) {
+    prv_complete(upload, kMfltCoapUploadResult_Success);
+    return;
+  }
+
+  upload->msg_len = metadata.single_chunk_message_length;
+  upload->msg_offset = 0;
+  upload->block_num = 0;
+
+  // use the largest block which fits next to the largest header the transfer will need
+  upload->message_id = upload->next_message_id;
+  const size_t max_hdr_len = prv_write_request_hdr(upload, upload->tx_buf, COAP_BLOCK1_MAX_VALUE);
+  const size_t max_payload_len = sizeof(upload->tx_buf) - MEMFAULT_MIN(
+      sizeof(upload->tx_buf), max_hdr_len + CARRY_SPACE);
+  while ((upload->szx > 0) && (COAP_BLOCK_SIZE(upload->szx) > max_payload_len)) {
+    upload->szx--;
+  }
+  if (COAP_BLOCK_SIZE(upload->szx) > max_payload_len) {
+    MEMFAULT_LOG_ERROR("Request headers don't fit in MEMFAULT_COAP_UPLOAD_TX_BUF_SIZE");
+    prv_complete(upload, kMfltCoapUploadResult_BufferTooSmall);
+    return;
+  }
+  upload->block_size = COAP_BLOCK_SIZE(upload->szx);
+
+  prv_send_next_block(upload);
+}
+
+MEMFAULT_WEAK
+uint32_t memfault_platform_coap_get_random(void) {
+  // FNV-1a of the device serial, so devices of a fleet which booted together pick different IDs
+  sMemfaultDeviceInfo info = { 0 };
+  memfault_platform_get_device_info(&info);
+  uint32_t hash = 2166136261UL;
+  for (const char *c = info.device_serial; (c != NULL) && (*c != '\0'); c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619UL;
+  }
+  // mixed with the time since boot, so a device picks different IDs from one boot to the next
+  hash ^= (uint32_t)memfault_platform_get_time_since_boot_ms();
+  return hash ^ (hash >> 16);
+}
+
+int memfault_coap_upload_start(sMfltCoapUpload *upload, const sMfltCoapUploadConfig *cfg) {
+  if ((upload == NULL) || (cfg == NULL) || (cfg->transport == NULL) ||
+      ((cfg->project_key != NULL) &&
+       (strlen(cfg->project_key) > MEMFAULT_COAP_MAX_PROJECT_KEY_LEN))) {
+    return MemfaultInternalReturnCode_InvalidInput;
+  }
+
+  if (memfault_coap_upload_in_progress(upload)) {
+    return MemfaultInternalReturnCode_Error;
+  }
+
+  sMemfaultDeviceInfo device_info;
+  memfault_platform_get_device_info(&device_info);
+  if ((device_info.device_serial == NULL) ||
+      (strlen(device_info.device_serial) > MEMFAULT_COAP_MAX_DEVICE_SERIAL_LEN)) {
+    return MemfaultInternalReturnCode_InvalidInput;
+  }
+
+  if (!memfault_packetizer_data_available()) {
+    return kMfltCoapUploadStartStatus_NoDataFound;
+  }
+
+  const uint16_t next_message_id = upload->message_id_seeded ?
+    upload->next_message_id : (uint16_t)memfault_platform_coap_get_random();
+  *upload = (sMfltCoapUpload) {
+    .stats = upload->stats,
+    .next_message_id = next_message_id,
+    .message_id_seeded = true,
+    .cfg = *cfg,
+    .device_serial = device_info.device_serial,
+    .szx = COAP_BLOCK_MAX_SZX,
+  };
+  prv_start_next_message(upload);
+  return kMfltCoapUploadStartStatus_Started;
+}
+
+static void prv_send_empty_ack(sMfltCoapUpload *upload, uint16_t message_id) {
+  uint8_t ack[COAP_HDR_LEN];
+  prv_write_hdr(ack, COAP_TYPE_ACK, 0, COAP_CODE_EMPTY, message_id);
+  // a lost ACK makes the server send its response again, which is acknowledged then
+  prv_send(upload, ack, sizeof(ack));
+}
+
+//! Handles a 2.31 Continue for a block which isn't the final one
+static void prv_handle_continue(sMfltCoapUpload *upload, const sCoapMessage *rsp) {
+  uint32_t rsp_num = upload->block_num;
+  uint8_t rsp_szx = upload->szx;
+  if (rsp->has_block1) {
+    rsp_num = rsp->block1_value >> 4;
+    rsp_szx = (uint8_t)MEMFAULT_MIN(rsp->block1_value & 0x7, upload->szx);
+  }
+
+  // The server may ask for smaller blocks, in which case it has only taken the first
+  // 2^(SZX + 4) bytes of the block (RFC 7959 section 2.5). The rest is sent again.
+  const uint32_t block_end = upload->msg_offset + upload->block_payload_len;
+  const uint32_t acked_end = (rsp_num + 1) * (uint32_t)COAP_BLOCK_SIZE(rsp_szx);
+  if ((acked_end <= upload->msg_offset) || (acked_end > block_end)) {
+    prv_complete(upload, kMfltCoapUploadResult_ResponseError);
+    return;
+  }
+
+  const size_t unacked_len = block_end - acked_end;
+  if (unacked_len != 0) {
+    // prepend the bytes to the ones pulled from the packetizer but not sent yet
+    const size_t payload_offset = upload->tx_len - upload->block_payload_len;
+    const size_t pending_offset = sizeof(upload->tx_buf) - upload->pending_len - unacked_len;
+    memmove(&upload->tx_buf[pending_offset],
+            &upload->tx_buf[payload_offset + (acked_end - upload->msg_offset)], unacked_len);
+    upload->pending_len += unacked_len;
+  }
+
+  upload->msg_offset = acked_end;
+  upload->block_num = rsp_num + 1;
+  upload->szx = rsp_szx;
+  upload->block_size = COAP_BLOCK_SIZE(rsp_szx);
+  prv_send_next_block(upload);
+}
+
+static void prv_handle_response(sMfltCoapUpload *upload, const sCoapMessage *rsp) {
+  upload->response_code = rsp->code;
+  if (COAP_CODE_CLASS(rsp->code) != 2) {
+    prv_complete(upload, kMfltCoapUploadResult_ResponseError);
+    return;
+  }
+
+  upload->stats.num_blocks++;
+  const bool final_block =
+      (upload->msg_offset + upload->block_payload_len) == upload->msg_len;
+  if (!final_block) {
+    if (rsp->code != COAP_CODE_CONTINUE) {
+      // the server must ask for the rest of the transfer
+      prv_complete(upload, kMfltCoapUploadResult_ResponseError);
+      return;
+    }
+    prv_handle_continue(upload, rsp);
+    return;
+  }
+
+  // the whole chunk has been received, it's now safe to delete the message
+  memfault_packetizer_confirm_delivery();
+  upload->stats.num_messages++;
+  prv_start_next_message(upload);
+}
+
+void memfault_coap_upload_on_datagram(sMfltCoapUpload *upload, const void *datagram,
+                                      size_t datagram_len) {
+  if (!memfault_coap_upload_in_progress(upload)) {
+    return;
+  }
+
+  sCoapMessage msg;
+  if (!prv_parse_message((const uint8_t *)datagram, datagram_len, &msg)) {
+    return;
+  }
+  upload->stats.rx_bytes += (uint32_t)datagram_len;
+
+  if ((msg.type == COAP_TYPE_ACK) || (msg.type == COAP_TYPE_RST)) {
+    if ((upload->state != kMfltCoapUploadState_AwaitingAck) ||
+        (msg.message_id != upload->message_id)) {
+      // a duplicate or late acknowledgement of an earlier block
+      return;
+    }
+
+    if (msg.type == COAP_TYPE_RST) {
+      prv_complete(upload, kMfltCoapUploadResult_Reset);
+    } else if (msg.code == COAP_CODE_EMPTY) {
+      // the response will follow in a message of its own
+      upload->state = kMfltCoapUploadState_AwaitingResponse;
+    } else {
+      prv_handle_response(upload, &msg);
+    }
+    return;
+  }
+
+  // a separate response, matched to the request by its token
+  const uint8_t token[COAP_TOKEN_LEN] = {
+    (uint8_t)(upload->token >> 8),
+    (uint8_t)(upload->token & 0xff),
+  };
+  if ((msg.code == COAP_CODE_EMPTY) || (msg.token_len != COAP_TOKEN_LEN) ||
+      (memcmp(msg.token, token, sizeof(token)) != 0)) {
+    return;
+  }
+  if (msg.type == COAP_TYPE_CON) {
+    prv_send_empty_ack(upload, msg.message_id);
+  }
+  if (upload->state != kMfltCoapUploadState_Idle) {
+    prv_handle_response(upload, &msg);
+  }
+}
+
+void memfault_coap_upload_on_timeout(sMfltCoapUpload *upload) {
+  if ((upload->state != kMfltCoapUploadState_AwaitingAck) ||
+      (upload->num_retransmissions >= MEMFAULT_COAP_MAX_RETRANSMIT)) {
+    if (upload->state != kMfltCoapUploadState_Idle) {
+      prv_complete(upload, kMfltCoapUploadResult_Timeout);
+    }
+    return;
+  }
+
+  // the block, and the message ID it was sent with, are still in tx_buf
+  upload->num_retransmissions++;
+  upload->stats.num_retransmissions++;
+  if (!prv_send(upload, upload->tx_buf, upload->tx_len)) {
+    prv_complete(upload, kMfltCoapUploadResult_SendError);
+  }
+}
+
+uint32_t memfault_coap_upload_get_timeout_ms(const sMfltCoapUpload *upload) {
+  switch (upload->state) {
+    case kMfltCoapUploadState_AwaitingAck:
+      return (uint32_t)MEMFAULT_COAP_ACK_TIMEOUT_MS << upload->num_retransmissions;
+    case kMfltCoapUploadState_AwaitingResponse:
+      // the server has the request, give it as long as all the retransmissions would have taken
+      return (uint32_t)MEMFAULT_COAP_ACK_TIMEOUT_MS << MEMFAULT_COAP_MAX_RETRANSMIT;
+    case kMfltCoapUploadState_Idle:
+    default:
+      return 0;
+  }
+}
+
+bool memfault_coap_upload_in_progress(const sMfltCoapUpload *upload) {
+  return upload->state != kMfltCoapUploadState_Idle;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Lightweight profiling of the system boot.
+//!
+//! The boot is considered to start when memfault_reboot_tracking_boot() runs and to end when the
+//! application calls memfault_boot_complete(). The duration is measured with a free running cycle
+//! counter provided by the platform. Together with the uptime at which the previous reset took
+//! place, the result can be reported by the "metrics" component in the next heartbeat so boot time
+//! regressions across firmware versions can be tracked. This is opt-in: add
+//! -DMEMFAULT_METRICS_BOOT_PROFILE_ENABLED=1 to your build to define the heartbeat keys.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MfltBootProfile {
+  //! Time since boot when the previous reset was flagged or 0 if unknown
+  uint32_t uptime_at_reset_ms;
+  //! Time from memfault_reboot_tracking_boot() until memfault_boot_complete() was called or 0 if
+  //! no cycle counter is available on the platform
+  uint32_t boot_duration_ms;
+} sMfltBootProfile;
+
+//! Marks the start of the boot
+//!
+//! @note This is called automatically from memfault_reboot_tracking_boot(). It only needs to be
+//!   called directly when reboot tracking is not in use.
+//! @param uptime_at_reset_ms The uptime at which the previous reset took place or 0 if unknown
+void memfault_boot_profile_start(uint32_t uptime_at_reset_ms);
+
+//! To be called by the application once it has finished booting (i.e all subsystems are up and
+//! the device is ready to do useful work)
+void memfault_boot_complete(void);
+
+//! Reads the profile of the current boot
+//!
+//! @param[out] profile Populated with the boot profile on success
+//! @return true if memfault_boot_complete() has been called and a profile is available, false
+//!   otherwise
+bool memfault_boot_profile_get(sMfltBootProfile *profile);
+
+//! @return the current value of a free running cycle counter
+//!
+//! @note By default this function is defined as a weak symbol which returns 0 (no cycle counter).
+//!   On Cortex-M devices with a DWT unit, the CYCCNT register is a good choice:
+//!
+//!     CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+//!     DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+//!     return DWT->CYCCNT;
+uint32_t memfault_platform_get_cycle_count(void);
+
+//! @return the number of cycles per millisecond of the counter returned by
+//!   memfault_platform_get_cycle_count() or 0 if no cycle counter is available. By default this
+//!   function is defined as a weak symbol which returns 0.
+uint32_t memfault_platform_get_cycles_per_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
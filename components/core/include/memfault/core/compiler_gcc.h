@@ -36,6 +36,9 @@ extern "C" {
 #elif defined(MEMFAULT_UNITTEST) || defined(__APPLE__)  // Memfault iOS SDK also #includes this header
 #  define MEMFAULT_GET_LR(_a) _a = 0
 #  define MEMFAULT_GET_PC(_a) _a = 0
+#elif defined(__unix__)  // ports/posix
+#  define MEMFAULT_GET_LR(_a) _a = __builtin_return_address(0)
+#  define MEMFAULT_GET_PC(_a) _a = ({ __label__ _l; _l: &&_l;});
 #else
 #  error "New architecture to add support for!"
 #endif /* defined(__GNUC__) && defined(__arm__) */
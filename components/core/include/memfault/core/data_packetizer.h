@@ -16,6 +16,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "memfault/core/data_packetizer_source.h"
+#include "memfault/util/chunk_transport.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -47,6 +50,11 @@ typedef enum {
   //! as a value if multi packet chunking has been enabled by a call to
   //! memfault_packetizer_enable_multi_packet_chunks()
   kMemfaultPacketizerStatus_MoreDataForChunk,
+
+  //! Indicates the data of the next packet is still being read. This will _only_ be returned when
+  //! asynchronous reads have been enabled with sPacketizerConfig.async_read_buf. Call
+  //! memfault_packetizer_get_next() again once sPacketizerConfig.async_read_complete_cb is invoked
+  kMemfaultPacketizerStatus_Pending,
 } eMemfaultPacketizerStatus;
 
 //! The _absolute_ minimum a buffer passed into memfault_packetizer_get_next() can be in order to
@@ -60,6 +68,9 @@ typedef enum {
 //! underlying transport to the internet
 bool memfault_packetizer_data_available(void);
 
+//! See sPacketizerConfig.async_read_complete_cb
+typedef void (MemfaultPacketizerAsyncReadCompleteCb)(void *ctx);
+
 typedef struct {
   //! When false, memfault_packetizer_get_next() will always return a single "chunk"
   //! when data is available that can be pushed directly to the Memfault cloud
@@ -73,6 +84,45 @@ typedef struct {
   //! @note In this mode, it's the API users responsibility to make sure they push the chunk data
   //! only when a kMemfaultPacketizerStatus_EndOfChunk is received
   bool enable_multi_packet_chunk;
+
+  //! When false, the data backing a message is deleted as soon as the last packet of the message
+  //! has been returned by memfault_packetizer_get_next()
+  //!
+  //! When true, the message is only deleted once memfault_packetizer_confirm_delivery() is called,
+  //! i.e once the transport has confirmed the last packet was received. This is useful for
+  //! transports which can lose the last packet after it has been handed off (i.e CoAP over UDP).
+  //! If the delivery fails, memfault_packetizer_abort() rewinds the message so it is sent again in
+  //! its entirety.
+  bool enable_delivery_confirmation;
+
+  //! When non-zero, every 'fec_group_size' packets are followed by a parity packet from which the
+  //! receiver can rebuild one lost packet of the group, see fec_group_size in
+  //! memfault/util/chunk_transport.h. Useful for links which drop packets and can't afford a
+  //! retransmission. Only applies when enable_multi_packet_chunk is false.
+  //!
+  //! @note Parity packets are not understood by the Memfault cloud. They must be consumed by the
+  //! receiving end of the link, i.e a gateway which forwards the rebuilt messages.
+  uint8_t fec_group_size;
+  //! Scratch space for the parity of a group, required when fec_group_size is non-zero. The data
+  //! in each packet is limited to its size. It must remain valid until the message is sent.
+  void *fec_parity_buf;
+  size_t fec_parity_buf_len;
+
+  //! Scratch space the data of the next packets is read into ahead of time, for data sources which
+  //! can be read asynchronously (see MemfaultDataSourceStartReadCallback). It is split in two
+  //! halves so one is read into while packets are built from the other: the read of the data
+  //! which follows starts as soon as a packet has been returned, overlapping with its transmission.
+  //! Each half should hold at least one packet. NULL to always read synchronously.
+  //!
+  //! @note It must remain valid until the message is sent or, if the message is aborted,
+  //! until the read in flight completes. RLE encoded messages are always read synchronously.
+  void *async_read_buf;
+  size_t async_read_buf_len;
+  //! Invoked when a read started by the packetizer completes, i.e. to wake up the task sending
+  //! data after kMemfaultPacketizerStatus_Pending was returned. It runs in the context the data
+  //! source completes reads in (i.e. an interrupt) so it must not call into the packetizer.
+  MemfaultPacketizerAsyncReadCompleteCb *async_read_complete_cb;
+  void *async_read_complete_ctx;
 } sPacketizerConfig;
 
 typedef struct {
@@ -125,6 +175,264 @@ eMemfaultPacketizerStatus memfault_packetizer_get_next(void *buf, size_t *buf_le
 //! entirety (i.e coredump)
 void memfault_packetizer_abort(void);
 
+//! Deletes the message whose last packet was returned by memfault_packetizer_get_next() when
+//! sPacketizerConfig.enable_delivery_confirmation is set
+//!
+//! @note Until this is called, memfault_packetizer_get_next() returns
+//!   kMemfaultPacketizerStatus_NoMoreData and the next memfault_packetizer_begin() rewinds the
+//!   message so it is sent again
+void memfault_packetizer_confirm_delivery(void);
+
+//
+// Selective retransmission
+//
+// Every packet but the first of a message carries the offset within the message it starts at.
+// When the transport learns which packets were lost (i.e from a NACK or a selective ACK), those
+// can be regenerated from their offset and sent again, rather than aborting and sending the whole
+// message over. Only the data of the packets asked for is read again from the data source.
+//
+// This needs data sources which can be read at any offset. Coredumps and events can, and the RLE
+// encoder restarts from a checkpoint of its state (see
+// MEMFAULT_DATA_SOURCE_RLE_CHECKPOINT_INTERVAL).
+//
+
+//! @return The offset within the message the next packet returned by
+//!   memfault_packetizer_get_next() starts at. Recorded with every packet sent, it identifies the
+//!   packet to memfault_packetizer_get_packet_at_offset().
+uint32_t memfault_packetizer_get_next_offset(void);
+
+//! Regenerates a packet of the message in progress which has already been returned by
+//! memfault_packetizer_get_next(), without affecting what memfault_packetizer_get_next() returns
+//! next
+//!
+//! @note The message must still be in progress: the last packets of a message can only be
+//!   regenerated if sPacketizerConfig.enable_delivery_confirmation is set and the delivery hasn't
+//!   been confirmed yet. Packets can't be regenerated when enable_multi_packet_chunk is set, nor
+//!   can the parity packets of forward error correction.
+//!
+//! @param offset The offset of the packet, see memfault_packetizer_get_next_offset()
+//! @param[out] buf The buffer to copy the packet into
+//! @param[in,out] buf_len The size of the buffer. On return, populated with the size of the
+//!   packet. Passing the buf_len the packet was first generated with yields the same packet.
+//!
+//! @return true if the packet was regenerated, false otherwise
+bool memfault_packetizer_get_packet_at_offset(uint32_t offset, void *buf, size_t *buf_len);
+
+//
+// Asynchronous reads
+//
+// By default the data of a packet is read from its data source while
+// memfault_packetizer_get_next() builds the packet, blocking the caller for as long as a read
+// from i.e. external flash takes. Data sources which implement start_read_cb can be read in the
+// background instead, so a radio task keeps the flash and the radio busy at the same time:
+//
+//  1. Pass a double buffer in sPacketizerConfig.async_read_buf to memfault_packetizer_begin().
+//     The read of the first packets starts right away.
+//  2. memfault_packetizer_get_next() returns kMemfaultPacketizerStatus_Pending, without blocking,
+//     while the data of the next packet is still being read.
+//  3. sPacketizerConfig.async_read_complete_cb is invoked when the read is done, the next call to
+//     memfault_packetizer_get_next() then returns the packet and starts reading the data after it.
+//
+// Data the double buffer can't hold, i.e. for packets larger than its halves or packets
+// regenerated with memfault_packetizer_get_packet_at_offset(), is read synchronously with
+// read_msg_cb, so the data source must support it while a read is in flight.
+//
+// This only benefits custom data sources: none of the data sources in the SDK implement
+// start_read_cb, and the coredump source is read through the synchronous
+// memfault_platform_coredump_storage_read(). RLE encoded messages are always read synchronously
+// too, since the encoder computes its output as it reads.
+//
+
+//
+// Chunk sizing
+//
+// Rather than having every caller guess a buf_len, the packetizer can be told what the transport
+// below it carries. Packets returned by memfault_packetizer_get_next() are then sized so they fit
+// the link's MTU without being split (i.e IP fragmentation or L2CAP segmentation) and fill whole
+// link frames.
+//
+// The link can report how many packets it had to retransmit. On a lossy link smaller packets are
+// less likely to be corrupted and cheaper to resend, so the packet size is halved whenever the
+// retransmission rate exceeds MEMFAULT_PACKETIZER_SHRINK_RETRANSMIT_PERCENT. It grows back by an
+// eighth of the largest size for every MEMFAULT_PACKETIZER_GROW_AFTER_PACKETS packets sent
+// without retransmissions.
+//
+
+//! The retransmission rate, in percent of the packets reported, above which packets are shrunk
+#ifndef MEMFAULT_PACKETIZER_SHRINK_RETRANSMIT_PERCENT
+#define MEMFAULT_PACKETIZER_SHRINK_RETRANSMIT_PERCENT 10
+#endif
+
+//! The number of packets which must be sent without retransmissions before packets grow again
+#ifndef MEMFAULT_PACKETIZER_GROW_AFTER_PACKETS
+#define MEMFAULT_PACKETIZER_GROW_AFTER_PACKETS 16
+#endif
+
+typedef struct {
+  //! The largest packet the link carries without splitting it, headers of the transport included,
+  //! i.e the path MTU of an IP link or the ATT MTU of a BLE link
+  size_t mtu;
+  //! The bytes of every packet taken by the headers of the transport, i.e the 3 byte header of a
+  //! BLE ATT notification
+  size_t per_packet_overhead;
+  //! Packets, headers included, are sized to a multiple of this so they fill whole frames of the
+  //! link, i.e the BLE LL data length or the block size of a cipher. 0 or 1 when there is none.
+  size_t preferred_multiple;
+} sPacketizerTransportCaps;
+
+//! Sizes the packets returned by memfault_packetizer_get_next() for the transport described
+//!
+//! @note The buf_len passed to memfault_packetizer_get_next() still bounds the size of a packet.
+//! The packetizer fills at most memfault_packetizer_get_packet_size() bytes of it.
+//!
+//! @param caps The capabilities of the transport or NULL to go back to filling the whole buffer
+//!
+//! @return true if the capabilities leave room for a packet of at least
+//!   MEMFAULT_PACKETIZER_MIN_BUF_LEN bytes, false otherwise (the sizing is left unchanged)
+bool memfault_packetizer_set_transport_caps(const sPacketizerTransportCaps *caps);
+
+//! Reports how the link has fared, so the size of the next packets can be adapted
+//!
+//! @param num_packets The number of packets sent since the last report
+//! @param num_retransmissions The number of those which had to be retransmitted
+void memfault_packetizer_report_link_feedback(uint32_t num_packets, uint32_t num_retransmissions);
+
+//! @return The size the next packets will be, at most, or 0 if no transport capabilities have
+//!   been set
+size_t memfault_packetizer_get_packet_size(void);
+
+//
+// Packetizer instances
+//
+// The APIs above drain the data sources compiled into the SDK (coredumps & the event storage set
+// up with memfault_events_storage_boot()). A packetizer instance drains an arbitrary set of data
+// sources instead, for example the event storage instances (sMfltEventStorageCtx) a gateway keeps
+// for each downstream device it proxies data for.
+//
+// Each instance must only be used from one thread at a time but distinct instances, each with
+// their own data sources and RLE encoder, can be drained in parallel.
+//
+
+struct MfltDataSourceRleCtx;
+
+typedef struct {
+  //! Data source holding a coredump to send or NULL if there is none for the instance
+  const sMemfaultDataSourceImpl *coredump_source;
+  //! Data source holding events to send (i.e memfault_events_storage_ctx_get_data_source()) or
+  //! NULL if there is none for the instance
+  const sMemfaultDataSourceImpl *event_source;
+  //! The RLE encoder to compress coredumps with or NULL to send them uncompressed
+  struct MfltDataSourceRleCtx *rle;
+} sMfltPacketizerSources;
+
+typedef struct {
+  bool active_message;
+  //! The eMfltMessageType of the message being sent
+  uint8_t msg_type;
+  bool use_rle;
+  bool delivery_confirmation;
+  //! The last packet of the message has been returned, waiting for the delivery to be confirmed
+  bool awaiting_confirmation;
+  const sMemfaultDataSourceImpl *impl;
+  sMfltChunkTransportCtx curr_msg_ctx;
+} sMfltPacketizerTransportState;
+
+typedef enum {
+  kMfltPacketizerReadSlotState_Empty = 0,
+  kMfltPacketizerReadSlotState_Reading,
+  kMfltPacketizerReadSlotState_Ready,
+} eMfltPacketizerReadSlotState;
+
+//! One half of sPacketizerConfig.async_read_buf
+typedef struct {
+  uint8_t *buf;
+  size_t buf_len;
+  //! The offset within the data source and the length of the data held
+  uint32_t offset;
+  size_t len;
+  //! The eMfltPacketizerReadSlotState, updated from the completion of a read
+  volatile uint8_t state;
+  volatile bool read_failed;
+} sMfltPacketizerReadSlot;
+
+typedef struct {
+  //! Set while the message in progress is read asynchronously
+  bool enabled;
+  sMfltPacketizerReadSlot slots[2];
+  //! The slot the read in flight, if any, fills
+  uint8_t reading_slot;
+  volatile bool read_in_flight;
+  //! The read in flight was started for a message which has since been aborted
+  volatile bool discard_read;
+  //! Set while a read is being started, completions from within it need no wake up
+  bool starting_read;
+  MemfaultPacketizerAsyncReadCompleteCb *complete_cb;
+  void *complete_ctx;
+} sMfltPacketizerAsyncReadState;
+
+typedef struct {
+  bool enabled;
+  sPacketizerTransportCaps caps;
+  //! The bounds of the packet size and the current one, the headers of the transport included
+  size_t max_packet_len;
+  size_t min_packet_len;
+  size_t packet_len;
+  //! Packets reported sent without retransmissions since the size last changed
+  uint32_t num_clean_packets;
+} sMfltPacketizerSizingState;
+
+//! @note The contents are private to the implementation
+typedef struct MfltPacketizerCtx {
+  sMfltPacketizerSources sources;
+  sMfltPacketizerTransportState state;
+  sMfltPacketizerSizingState sizing;
+  sMfltPacketizerAsyncReadState async_read;
+} sMfltPacketizerCtx;
+
+//! Initialize a packetizer instance
+//!
+//! @param ctx The instance to initialize. Must remain valid for as long as it is in use
+//! @param sources The data sources to drain. Copied into the instance
+void memfault_packetizer_ctx_init(sMfltPacketizerCtx *ctx, const sMfltPacketizerSources *sources);
+
+//! Same as memfault_packetizer_get_chunk() but for the instance provided
+bool memfault_packetizer_ctx_get_chunk(sMfltPacketizerCtx *ctx, void *buf, size_t *buf_len);
+
+//! Same as memfault_packetizer_data_available() but for the instance provided
+bool memfault_packetizer_ctx_data_available(sMfltPacketizerCtx *ctx);
+
+//! Same as memfault_packetizer_begin() but for the instance provided
+bool memfault_packetizer_ctx_begin(sMfltPacketizerCtx *ctx, const sPacketizerConfig *cfg,
+                                   sPacketizerMetadata *metadata_out);
+
+//! Same as memfault_packetizer_get_next() but for the instance provided
+eMemfaultPacketizerStatus memfault_packetizer_ctx_get_next(sMfltPacketizerCtx *ctx, void *buf,
+                                                           size_t *buf_len);
+
+//! Same as memfault_packetizer_abort() but for the instance provided
+void memfault_packetizer_ctx_abort(sMfltPacketizerCtx *ctx);
+
+//! Same as memfault_packetizer_confirm_delivery() but for the instance provided
+void memfault_packetizer_ctx_confirm_delivery(sMfltPacketizerCtx *ctx);
+
+//! Same as memfault_packetizer_get_next_offset() but for the instance provided
+uint32_t memfault_packetizer_ctx_get_next_offset(const sMfltPacketizerCtx *ctx);
+
+//! Same as memfault_packetizer_get_packet_at_offset() but for the instance provided
+bool memfault_packetizer_ctx_get_packet_at_offset(sMfltPacketizerCtx *ctx, uint32_t offset,
+                                                  void *buf, size_t *buf_len);
+
+//! Same as memfault_packetizer_set_transport_caps() but for the instance provided
+bool memfault_packetizer_ctx_set_transport_caps(sMfltPacketizerCtx *ctx,
+                                                const sPacketizerTransportCaps *caps);
+
+//! Same as memfault_packetizer_report_link_feedback() but for the instance provided
+void memfault_packetizer_ctx_report_link_feedback(sMfltPacketizerCtx *ctx, uint32_t num_packets,
+                                                  uint32_t num_retransmissions);
+
+//! Same as memfault_packetizer_get_packet_size() but for the instance provided
+size_t memfault_packetizer_ctx_get_packet_size(const sMfltPacketizerCtx *ctx);
+
 #ifdef __cplusplus
 }
 #endif
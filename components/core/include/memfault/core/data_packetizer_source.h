@@ -10,6 +10,7 @@
 //! Memfault SDK into payloads that can be sent over the transport used up to the cloud
 //!
 //! @note A data source must implement three functions which are documented in the function typedefs below
+//! and can implement a fourth one to be read asynchronously
 //!
 //! @note A weak function implementation of all the provider functions is defined within the
 //! memfault data packetizer. This way a user can easily add or remove provider functionality by
@@ -52,12 +53,66 @@ typedef bool (MemfaultDataSourceReadMessageCallback)(uint32_t offset, void *buf,
 //! a info about a new message or nothing if there are no more messages to read
 typedef void (MemfaultDataSourceMarkMessageReadCallback)(void);
 
+//! Variants of the three callbacks above for data sources backed by an instance (i.e an event
+//! storage instance, see memfault_events_storage_ctx_init()). Each is passed the ctx of the
+//! sMemfaultDataSourceImpl.
+typedef bool (MemfaultDataSourceCtxHasMoreMessagesCallback)(void *ctx, size_t *next_msg_size);
+typedef bool (MemfaultDataSourceCtxReadMessageCallback)(void *ctx, uint32_t offset, void *buf,
+                                                        size_t buf_len);
+typedef void (MemfaultDataSourceCtxMarkMessageReadCallback)(void *ctx);
+
+//! Invoked by a data source once a read started with MemfaultDataSourceStartReadCallback is done
+//!
+//! @param complete_ctx The complete_ctx passed to MemfaultDataSourceStartReadCallback
+//! @param success true if the data was read, false otherwise
+typedef void (MemfaultDataSourceReadCompleteCallback)(void *complete_ctx, bool success);
+
+//! Start reading the requested bytes for the currently queued up message without waiting for them,
+//! i.e. by kicking off a DMA transfer from external flash
+//!
+//! @note The data source owns 'buf' until 'complete_cb' is invoked. 'complete_cb' may be invoked
+//! from any context the data source completes reads in (i.e. an interrupt) or from within this
+//! call. Only one read is started at a time.
+//!
+//! @param ctx The ctx of the sMemfaultDataSourceImpl
+//! @param offset The offset to begin reading at
+//! @param buf The buffer to copy the read data into
+//! @param buf_len The size of the result buffer
+//! @param complete_cb Invoked once the read is done, if it was started
+//! @param complete_ctx Passed to complete_cb
+//!
+//! @return true if the read was started, false otherwise ('complete_cb' will not be invoked)
+typedef bool (MemfaultDataSourceStartReadCallback)(
+    void *ctx, uint32_t offset, void *buf, size_t buf_len,
+    MemfaultDataSourceReadCompleteCallback *complete_cb, void *complete_ctx);
+
 typedef struct MemfaultDataSourceImpl {
   MemfaultDataSourceHasMoreMessagesCallback *has_more_msgs_cb;
   MemfaultDataSourceReadMessageCallback *read_msg_cb;
   MemfaultDataSourceMarkMessageReadCallback *mark_msg_read_cb;
+  //! Set instead of the three callbacks above by data sources backed by an instance
+  MemfaultDataSourceCtxHasMoreMessagesCallback *ctx_has_more_msgs_cb;
+  MemfaultDataSourceCtxReadMessageCallback *ctx_read_msg_cb;
+  MemfaultDataSourceCtxMarkMessageReadCallback *ctx_mark_msg_read_cb;
+  //! Optional, NULL for data sources which can only be read synchronously. When provided, the
+  //! packetizer can read the next packets ahead of time while the current one is sent, see
+  //! sPacketizerConfig.async_read_buf. read_msg_cb (or ctx_read_msg_cb) must still be provided.
+  //!
+  //! @note None of the data sources in the SDK implement it, including the coredump source
+  //! (there is no asynchronous coredump storage platform API). Only custom data sources which
+  //! are not RLE encoded can be read asynchronously.
+  MemfaultDataSourceStartReadCallback *start_read_cb;
+  //! Passed to the ctx_* callbacks and start_read_cb
+  void *ctx;
 } sMemfaultDataSourceImpl;
 
+//! Helpers for readers of a data source, which invoke whichever callbacks 'source' provides
+bool memfault_data_source_has_more_msgs(const sMemfaultDataSourceImpl *source,
+                                        size_t *next_msg_size);
+bool memfault_data_source_read_msg(const sMemfaultDataSourceImpl *source, uint32_t offset,
+                                   void *buf, size_t buf_len);
+void memfault_data_source_mark_msg_read(const sMemfaultDataSourceImpl *source);
+
 //! "Coredump" data source provided as part of "panics" component
 extern const sMemfaultDataSourceImpl g_memfault_coredump_data_source;
 
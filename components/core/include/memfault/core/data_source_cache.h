@@ -0,0 +1,132 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! A read-through block cache which can wrap any data source (e.g. a coredump saved in SPI flash).
+//!
+//! Every read_msg_cb call of a flash backed data source pays for a command and an address phase on
+//! top of the data itself. Readers such as the RLE encoder (see data_source_rle.h) issue many
+//! small reads, reading every byte of a message at least twice (once to compute the size of the
+//! message and once to encode it) and re-reading the data around a sequence boundary. The cache
+//! serves those from RAM and turns them into a few block sized reads of the backing data source.
+//!
+//! A miss reads all the blocks the read request spans which aren't cached in a single read of the
+//! backing data source. When reads are sequential, it also reads the blocks which follow, so a
+//! stream is read in transactions of read_ahead_blocks blocks.
+//!
+//! The blocks are dropped whenever a message is marked read or the next message is queried with
+//! has_more_msgs, so only the reads of one message in between are served from RAM.
+//!
+//! Usage:
+//!
+//!   static uint8_t s_cache_storage[4 * 256];
+//!   static sMfltDataSourceCacheCtx s_coredump_cache;
+//!   const sMfltDataSourceCacheConfig cfg = {
+//!     .source = &g_memfault_coredump_data_source,
+//!     .storage = s_cache_storage,
+//!     .block_size = 256,
+//!     .num_blocks = 4,
+//!     .read_ahead_blocks = 2,
+//!   };
+//!   const sMfltPacketizerSources sources = {
+//!     .coredump_source = memfault_data_source_cache_init(&s_coredump_cache, &cfg),
+//!     ...
+//!   };
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memfault/core/data_packetizer_source.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! The largest number of blocks a cache instance can be configured with
+#ifndef MEMFAULT_DATA_SOURCE_CACHE_MAX_BLOCKS
+#define MEMFAULT_DATA_SOURCE_CACHE_MAX_BLOCKS 8
+#endif
+
+//! The number of consecutive reads which must each start within or right after the data the
+//! previous one read for the access pattern to be considered sequential and blocks read ahead
+#ifndef MEMFAULT_DATA_SOURCE_CACHE_SEQUENTIAL_READS
+#define MEMFAULT_DATA_SOURCE_CACHE_SEQUENTIAL_READS 2
+#endif
+
+typedef struct {
+  //! The data source to cache. Must remain valid for as long as the cache is in use
+  const sMemfaultDataSourceImpl *source;
+  //! Storage for the blocks, at least block_size * num_blocks bytes
+  void *storage;
+  size_t block_size;
+  //! At most MEMFAULT_DATA_SOURCE_CACHE_MAX_BLOCKS
+  size_t num_blocks;
+  //! The number of blocks a miss reads at once when reads are sequential, clamped to num_blocks.
+  //! 0 or 1 to only read the blocks the read request spans.
+  size_t read_ahead_blocks;
+} sMfltDataSourceCacheConfig;
+
+typedef struct {
+  //! Blocks read requests were served from without reading the backing data source
+  uint32_t num_hits;
+  //! Blocks which had to be read from the backing data source for a read request
+  uint32_t num_misses;
+  //! Blocks read along with a miss, beyond the ones the request spans, as reads were sequential
+  uint32_t num_blocks_read_ahead;
+  //! read_msg_cb calls made to the backing data source, and the bytes they read
+  uint32_t num_source_reads;
+  uint32_t source_bytes_read;
+} sMfltDataSourceCacheStats;
+
+typedef struct {
+  bool valid;
+  //! The offset within the message of the data held and its length, only shorter than the block
+  //! size for the last block of a message
+  uint32_t offset;
+  size_t len;
+  //! When the block was last used, to evict the least recently used ones
+  uint32_t last_used;
+} sMfltDataSourceCacheBlock;
+
+//! @note The contents are private to the implementation
+typedef struct MfltDataSourceCacheCtx {
+  sMfltDataSourceCacheConfig cfg;
+  sMfltDataSourceCacheBlock blocks[MEMFAULT_DATA_SOURCE_CACHE_MAX_BLOCKS];
+  uint32_t use_counter;
+  //! The size of the message reported by the backing data source, 0 if it is not known
+  size_t msg_size;
+  //! The span of the last read request and the number of sequential reads in a row
+  uint32_t last_read_offset;
+  uint32_t last_read_end;
+  uint32_t num_sequential_reads;
+  sMfltDataSourceCacheStats stats;
+  //! The cached data source handed out by memfault_data_source_cache_init()
+  sMemfaultDataSourceImpl impl;
+} sMfltDataSourceCacheCtx;
+
+//! Initializes a cache instance
+//!
+//! @param ctx The instance to initialize. Must remain valid for as long as it is in use
+//! @param cfg The configuration of the cache. Copied into the instance
+//!
+//! @return The cached data source, which can be used in place of cfg->source, or NULL if the
+//!   configuration is invalid
+const sMemfaultDataSourceImpl *memfault_data_source_cache_init(
+    sMfltDataSourceCacheCtx *ctx, const sMfltDataSourceCacheConfig *cfg);
+
+//! Drops all the data the cache holds, i.e. if the backing storage was modified other than through
+//! marking a message of the cached data source read
+void memfault_data_source_cache_invalidate(sMfltDataSourceCacheCtx *ctx);
+
+//! Populates 'stats_out' with the counters of the cache since it was initialized
+void memfault_data_source_cache_get_stats(const sMfltDataSourceCacheCtx *ctx,
+                                          sMfltDataSourceCacheStats *stats_out);
+
+#ifdef __cplusplus
+}
+#endif
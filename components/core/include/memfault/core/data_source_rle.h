@@ -22,11 +22,90 @@
 #include <stdint.h>
 
 #include "memfault/core/data_packetizer_source.h"
+#include "memfault/util/rle.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+//! Encoded bytes between the checkpoints of the encoder state recorded while the size of a
+//! message is computed. Reads at an offset other than the one the last read ended at (i.e to
+//! regenerate a lost packet, see memfault_packetizer_get_packet_at_offset(), or to resume after
+//! memfault_packetizer_abort()) restart the encoder from the closest checkpoint before the offset,
+//! so only about this many bytes are encoded again.
+#ifndef MEMFAULT_DATA_SOURCE_RLE_CHECKPOINT_INTERVAL
+#define MEMFAULT_DATA_SOURCE_RLE_CHECKPOINT_INTERVAL 512
+#endif
+
+//! The size of the checkpoint table. When a message needs more checkpoints, every other one is
+//! dropped and the interval doubled, so the table always spans the whole message.
+#ifndef MEMFAULT_DATA_SOURCE_RLE_NUM_CHECKPOINTS
+#define MEMFAULT_DATA_SOURCE_RLE_NUM_CHECKPOINTS 4
+#endif
+
+typedef enum {
+  kMemfaultDataSourceRleState_Inactive = 0,
+  // Searching for the next sequence to encode
+  kMemfaultDataSourceRleState_FindingSeqLength,
+  // A sequence to encode has been found and is being written out
+  // via calls to memfault_data_source_rle_read_msg()
+  kMemfaultDataSourceRleState_WritingSequence,
+} eMemfaultDataSourceRleState;
+
+typedef struct {
+  eMemfaultDataSourceRleState state;
+  uint8_t temp_buf[128];
+  // The number of bytes written within the current RLE sequence
+  uint32_t write_offset;
+  // The total number of bytes that have been processed from the backing data source
+  uint32_t bytes_processed;
+  // The current number of encoded bytes which have been written
+  uint32_t curr_encoded_len;
+} sMemfaultDataSourceRleEncodeCtx;
+
+//! The state of the encoder at a point of the encoded message, from which encoding can resume
+typedef struct {
+  sMemfaultRleCtx rle_ctx;
+  eMemfaultDataSourceRleState state;
+  uint32_t write_offset;
+  uint32_t bytes_processed;
+  uint32_t curr_encoded_len;
+} sMemfaultDataSourceRleCheckpoint;
+
+typedef struct {
+  size_t original_size;
+  size_t total_rle_size;
+  sMemfaultRleCtx rle_ctx;
+  sMemfaultDataSourceRleEncodeCtx encode_ctx;
+  //! Checkpoints recorded during the size pass, by increasing encoded offset
+  sMemfaultDataSourceRleCheckpoint checkpoints[MEMFAULT_DATA_SOURCE_RLE_NUM_CHECKPOINTS];
+  size_t num_checkpoints;
+  uint32_t checkpoint_interval;
+  //! The furthest point sequential reads got to, where they carry on after reads elsewhere
+  sMemfaultDataSourceRleCheckpoint resume;
+} sMemfaultDataSourceRleState;
+
+//! An RLE encoder instance. The global API below operates on a default instance, additional
+//! instances let several packetizers (see memfault_packetizer_ctx_init()) encode in parallel.
+//!
+//! @note The contents are private to the implementation, zero-initialize before first use
+typedef struct MfltDataSourceRleCtx {
+  const sMemfaultDataSourceImpl *active_source;
+  sMemfaultDataSourceRleState state;
+  //! The RLE data source handed out by memfault_data_source_rle_ctx_set_active()
+  sMemfaultDataSourceImpl impl;
+} sMfltDataSourceRleCtx;
+
+//! Wrap a data source with the RLE encoder instance provided
+//!
+//! @param ctx The encoder instance to use. Only one data source can be active on an instance at
+//!   a time. Switching sources discards any encoding state for the message in progress.
+//! @param active_source The data source to encode
+//!
+//! @return The RLE encoded data source or NULL if RLE is not compiled in
+const sMemfaultDataSourceImpl *memfault_data_source_rle_ctx_set_active(
+    sMfltDataSourceRleCtx *ctx, const sMemfaultDataSourceImpl *active_source);
+
 bool memfault_data_source_rle_encoder_set_active(const sMemfaultDataSourceImpl *active_source);
 bool memfault_data_source_rle_has_more_msgs(size_t *total_size);
 bool memfault_data_source_rle_read_msg(uint32_t offset, void *buf, size_t buf_len);
@@ -17,12 +17,78 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "memfault/core/data_packetizer_source.h"
+#include "memfault/util/circular_buffer.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct MemfaultEventStorageImpl sMemfaultEventStorageImpl;
 
+//! The API an event storage implementation must adhere to. A user of the SDK should never need
+//! to invoke these directly
+struct MemfaultEventStorageImpl {
+  //! Opens a session to begin writing a heartbeat event to storage
+  //!
+  //! @note To close the session, memfault_events_storage_finish_write() must be called
+  //!
+  //! @return the free space in storage for the write
+  size_t (*begin_write_cb)(void);
+
+  //! Called to append more data to the current event
+  //!
+  //! @note This function can be called multiple times to make it easy for an event to
+  //!   be stored in chunks
+  //!
+  //! @param bytes Buffer of data to add to the current event
+  //! @param num_bytes The total number of bytes to store
+  //!
+  //! @return true if the write was successful, false otherwise
+  bool (*append_data_cb)(const void *bytes, size_t num_bytes);
+
+  //! Called to close a heartbeat event session
+  //!
+  //! @param rollback If false, the event being stored is committed meaning a future call
+  //!  to "g_memfault_event_data_source.has_more_msgs_cb" will return the event. If true,
+  //!  the event that was being stored is discarded
+  void (*finish_write_cb)(bool rollback);
+
+  //! Returns the _total_ size that can be used by event storage
+  size_t (*get_storage_size_cb)(void);
+
+  //! Set instead of the four callbacks above by event storage instances (see
+  //! memfault_events_storage_ctx_init()). Each is passed 'ctx'.
+  size_t (*ctx_begin_write_cb)(void *ctx);
+  bool (*ctx_append_data_cb)(void *ctx, const void *bytes, size_t num_bytes);
+  void (*ctx_finish_write_cb)(void *ctx, bool rollback);
+  size_t (*ctx_get_storage_size_cb)(void *ctx);
+  void *ctx;
+};
+
+typedef struct {
+  bool write_in_progress;
+  size_t bytes_written;
+} sMfltEventStorageWriteState;
+
+typedef struct {
+  size_t active_event_read_size;
+} sMfltEventStorageReadState;
+
+//! An event storage instance. memfault_events_storage_boot() sets up a default instance which
+//! backs g_memfault_event_data_source. Additional instances can be used to store events for
+//! other devices, for example when proxying data for downstream nodes from a gateway.
+//!
+//! @note The contents are private to the implementation
+typedef struct MfltEventStorageCtx {
+  sMfltCircularBuffer buffer;
+  sMfltEventStorageWriteState write_state;
+  sMfltEventStorageReadState read_state;
+  sMemfaultEventStorageImpl impl;
+  sMemfaultDataSourceImpl data_source;
+  bool use_lock;
+} sMfltEventStorageCtx;
+
 //! Must be called by the customer on boot to setup heartbeat storage.
 //!
 //! This is where serialized heartbeat data is stored as it waits to be drained
@@ -47,6 +113,26 @@ typedef struct MemfaultEventStorageImpl sMemfaultEventStorageImpl;
 //!  This handle will need to be provided to modules which use the event store on initialization
 const sMemfaultEventStorageImpl *memfault_events_storage_boot(void *buf, size_t buf_len);
 
+//! Initialize an additional event storage instance
+//!
+//! Unlike the default instance, memfault_lock() is not taken when an instance is accessed. The
+//! caller must make sure an instance is only accessed by one thread at a time. Distinct
+//! instances can be used in parallel.
+//!
+//! @param ctx The instance to initialize. Must remain valid for as long as it is in use
+//! @param buf The buffer to use for event storage
+//! @param buf_len The length of the buffer to use for event storage
+//!
+//! @return a handle to the event storage implementation, to be passed to modules which write to
+//!  the event store (e.g memfault_metrics_ctx_init())
+const sMemfaultEventStorageImpl *memfault_events_storage_ctx_init(sMfltEventStorageCtx *ctx,
+                                                                  void *buf, size_t buf_len);
+
+//! @return The data source to drain events stored in the instance from. Can be provided to
+//!  a packetizer instance (see memfault_packetizer_ctx_init())
+const sMemfaultDataSourceImpl *memfault_events_storage_ctx_get_data_source(
+    sMfltEventStorageCtx *ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@
 #include "memfault/core/serializer_key_ids.h"
 #include "memfault/util/cbor.h"
 #include "memfault/core/event_storage.h"
+#include "memfault/core/platform/device_info.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +24,11 @@ extern "C" {
 
 bool memfault_serializer_helper_encode_version_info(sMemfaultCborEncoder *encoder);
 
+//! Same as memfault_serializer_helper_encode_version_info() but for the device info provided
+//! instead of the one returned by memfault_platform_get_device_info()
+bool memfault_serializer_helper_encode_version_info_for_device(sMemfaultCborEncoder *encoder,
+                                                               const sMemfaultDeviceInfo *info);
+
 bool memfault_serializer_helper_encode_uint32_kv_pair(
     sMemfaultCborEncoder *encoder, uint32_t key, uint32_t value);
 
@@ -52,6 +58,9 @@ bool memfault_serializer_helper_encode_to_storage(sMemfaultCborEncoder *encoder,
 size_t memfault_serializer_helper_compute_size(
     sMemfaultCborEncoder *encoder, MemfaultSerializerHelperEncodeCallback encode_callback, void *ctx);
 
+//! @return The total size of the event storage, from whichever callback 'storage_impl' provides
+size_t memfault_serializer_helper_get_storage_size(const sMemfaultEventStorageImpl *storage_impl);
+
 bool memfault_serializer_helper_check_storage_size(
     const sMemfaultEventStorageImpl *storage_impl, size_t (compute_worst_case_size)(void), const char *event_type);
 
@@ -44,4 +44,10 @@ typedef enum {
   kMemfaultTraceInfoEventKey_McuReasonRegister = 4,
   kMemfaultTraceInfoEventKey_CoredumpSaved = 5,
   kMemfaultTraceInfoEventKey_UserReason = 6,
+  kMemfaultTraceInfoEventKey_UptimeMs = 7,
+  kMemfaultTraceInfoEventKey_RebootHistory = 8,
 } eMemfaultTraceInfoEventKey;
+
+#ifdef __cplusplus
+}
+#endif
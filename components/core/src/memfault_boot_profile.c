@@ -0,0 +1,61 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/core/boot_profile.h"
+
+#include <stddef.h>
+
+#include "memfault/core/compiler.h"
+
+static struct {
+  uint32_t start_cycle_count;
+  bool boot_complete;
+  sMfltBootProfile profile;
+} s_memfault_boot_profile;
+
+MEMFAULT_WEAK
+uint32_t memfault_platform_get_cycle_count(void) {
+  return 0;
+}
+
+MEMFAULT_WEAK
+uint32_t memfault_platform_get_cycles_per_ms(void) {
+  return 0;
+}
+
+void memfault_boot_profile_start(uint32_t uptime_at_reset_ms) {
+  s_memfault_boot_profile.start_cycle_count = memfault_platform_get_cycle_count();
+  s_memfault_boot_profile.boot_complete = false;
+  s_memfault_boot_profile.profile = (sMfltBootProfile) {
+    .uptime_at_reset_ms = uptime_at_reset_ms,
+  };
+}
+
+void memfault_boot_complete(void) {
+  if (s_memfault_boot_profile.boot_complete) {
+    return; // only the first call marks the end of the boot
+  }
+
+  const uint32_t cycles_per_ms = memfault_platform_get_cycles_per_ms();
+  if (cycles_per_ms != 0) {
+    // unsigned subtraction accounts for a single rollover of the counter
+    const uint32_t elapsed_cycles =
+        memfault_platform_get_cycle_count() - s_memfault_boot_profile.start_cycle_count;
+    s_memfault_boot_profile.profile.boot_duration_ms = elapsed_cycles / cycles_per_ms;
+  }
+  s_memfault_boot_profile.boot_complete = true;
+}
+
+bool memfault_boot_profile_get(sMfltBootProfile *profile) {
+  if ((profile == NULL) || !s_memfault_boot_profile.boot_complete) {
+    return false;
+  }
+
+  *profile = s_memfault_boot_profile.profile;
+  return true;
+}
@@ -57,6 +57,12 @@ bool memfault_data_source_rle_encoder_set_active(const sMemfaultDataSourceImpl *
   return false;
 }
 
+MEMFAULT_WEAK
+const sMemfaultDataSourceImpl *memfault_data_source_rle_ctx_set_active(
+    sMfltDataSourceRleCtx *ctx, const sMemfaultDataSourceImpl *active_source) {
+  return NULL;
+}
+
 // NOTE: These values are used by the Memfault cloud chunks API
 typedef enum {
   kMfltMessageType_None = 0,
@@ -70,55 +76,74 @@ typedef struct MemfaultDataSource {
   const sMemfaultDataSourceImpl *impl;
 } sMemfaultDataSource;
 
-static const sMemfaultDataSource s_memfault_data_source[] = {
-  {
-    .type = kMfltMessageType_Coredump,
-    .use_rle = true,
-    .impl = &g_memfault_coredump_data_source,
-  },
-  {
-    .type = kMfltMessageType_Event,
-    .use_rle = false,
-    .impl = &g_memfault_event_data_source,
-  }
-};
-
-typedef struct {
-  size_t total_size;
-  sMemfaultDataSource source;
-} sMessageMetadata;
-
-typedef struct {
-  bool active_message;
-  sMessageMetadata msg_metadata;
-  sMfltChunkTransportCtx curr_msg_ctx;
-} sMfltTransportState;
-
 typedef MEMFAULT_PACKED_STRUCT {
   uint8_t mflt_msg_type; // eMfltMessageType
 } sMfltPacketizerHdr;
 
-static sMfltTransportState s_mflt_packetizer_state;
+//! The instance backing the global packetizer API
+static sMfltPacketizerCtx s_mflt_packetizer_ctx = {
+  .sources = {
+    .coredump_source = &g_memfault_coredump_data_source,
+    .event_source = &g_memfault_event_data_source,
+  },
+};
 
-static void prv_reset_packetizer_state(void) {
-  s_mflt_packetizer_state = (sMfltTransportState) {
+static void prv_reset_packetizer_state(sMfltPacketizerCtx *ctx) {
+  ctx->state = (sMfltPacketizerTransportState) {
     .active_message = false,
   };
+
+  sMfltPacketizerAsyncReadState *async = &ctx->async_read;
+  async->enabled = false;
+  if (async->read_in_flight) {
+    // the buffer can only be reused once the read completes
+    async->discard_read = true;
+  }
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(async->slots); i++) {
+    if (async->slots[i].state == kMfltPacketizerReadSlotState_Ready) {
+      async->slots[i].state = kMfltPacketizerReadSlotState_Empty;
+    }
+  }
+}
+
+//! Copies what the read buffers hold of the data source from 'offset' on into 'buf'
+//!
+//! @return The number of bytes copied, the data which follows them must be read synchronously
+static size_t prv_async_copy_buffered(const sMfltPacketizerAsyncReadState *async, uint32_t offset,
+                                      uint8_t *buf, size_t buf_len) {
+  size_t bytes_copied = 0;
+  bool progress = true;
+  while (progress && (bytes_copied < buf_len)) {
+    progress = false;
+    for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(async->slots); i++) {
+      const sMfltPacketizerReadSlot *slot = &async->slots[i];
+      if ((slot->state != kMfltPacketizerReadSlotState_Ready) || (offset < slot->offset) ||
+          (offset >= (slot->offset + slot->len))) {
+        continue;
+      }
+      const size_t len = MEMFAULT_MIN(slot->offset + slot->len - offset, buf_len - bytes_copied);
+      memcpy(&buf[bytes_copied], &slot->buf[offset - slot->offset], len);
+      bytes_copied += len;
+      offset += (uint32_t)len;
+      progress = true;
+    }
+  }
+  return bytes_copied;
 }
 
-static void prv_data_source_chunk_transport_msg_reader(uint32_t offset, void *buf,
+static void prv_data_source_chunk_transport_msg_reader(void *ctx, uint32_t offset, void *buf,
                                                        size_t buf_len) {
   uint8_t *bufp = buf;
   size_t read_offset = 0;
   const size_t hdr_size = sizeof(sMfltPacketizerHdr);
 
-  const sMessageMetadata *msg_metadata = &s_mflt_packetizer_state.msg_metadata;
+  const sMfltPacketizerTransportState *state = &((sMfltPacketizerCtx *)ctx)->state;
   if (offset < hdr_size) {
     const uint8_t rle_enable_mask = 0x80;
-    const uint8_t msg_type = (uint8_t)msg_metadata->source.type;
+    const uint8_t msg_type = state->msg_type;
 
     sMfltPacketizerHdr hdr = {
-      .mflt_msg_type = msg_metadata->source.use_rle ? msg_type | rle_enable_mask : msg_type,
+      .mflt_msg_type = state->use_rle ? msg_type | rle_enable_mask : msg_type,
     };
     uint8_t *hdr_bytes = (uint8_t *)&hdr;
 
@@ -135,86 +160,443 @@ static void prv_data_source_chunk_transport_msg_reader(uint32_t offset, void *bu
     return;
   }
 
-  const bool success = msg_metadata->source.impl->read_msg_cb(read_offset, bufp, buf_len);
+  const sMfltPacketizerAsyncReadState *async = &((sMfltPacketizerCtx *)ctx)->async_read;
+  if (async->enabled) {
+    const size_t bytes_buffered = prv_async_copy_buffered(async, read_offset, bufp, buf_len);
+    if (bytes_buffered == buf_len) {
+      return;
+    }
+    read_offset += (uint32_t)bytes_buffered;
+    bufp += bytes_buffered;
+    buf_len -= bytes_buffered;
+  }
+
+  const bool success = memfault_data_source_read_msg(state->impl, read_offset, bufp, buf_len);
   if (!success) {
     // Read failures really should never happen. We have no way of knowing if the issue is
     // transient or not. If we aborted the transaction and the failure was persistent, we could get
     // stuck trying to flush out the same data. Instead, just scrub the region with a pattern and
     // continue on
     MEMFAULT_LOG_ERROR("Read at offset 0x%" PRIx32 " (%d bytes) for source type %d failed", offset,
-                       (int)msg_metadata->source.type, (int)buf_len);
+                       (int)state->msg_type, (int)buf_len);
     memset(bufp, 0xEF, buf_len);
   }
 }
 
-static bool prv_get_source_with_data(size_t *total_size, sMemfaultDataSource *active_source) {
-  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(s_memfault_data_source); i++) {
-    const sMemfaultDataSource *data_source = &s_memfault_data_source[i];
-    const bool rle_enabled = data_source->use_rle &&
-        memfault_data_source_rle_encoder_set_active(data_source->impl);
+//! @return The offset within the data source of the byte at 'msg_offset' in the message
+static uint32_t prv_async_source_offset(uint32_t msg_offset) {
+  const size_t hdr_size = sizeof(sMfltPacketizerHdr);
+  return (msg_offset > hdr_size) ? (uint32_t)(msg_offset - hdr_size) : 0;
+}
 
-    *active_source = (sMemfaultDataSource) {
-      .type = data_source->type,
-      .use_rle = rle_enabled,
-      .impl = rle_enabled ? &g_memfault_data_rle_source : data_source->impl,
-    };
+static void prv_async_read_complete(void *complete_ctx, bool success) {
+  sMfltPacketizerAsyncReadState *async = &((sMfltPacketizerCtx *)complete_ctx)->async_read;
+  sMfltPacketizerReadSlot *slot = &async->slots[async->reading_slot];
+  slot->read_failed = !success;
+  slot->state = async->discard_read ? kMfltPacketizerReadSlotState_Empty :
+                                      kMfltPacketizerReadSlotState_Ready;
+  async->discard_read = false;
+  async->read_in_flight = false;
+
+  // A read discarded by an abort still wakes the caller up. The read of the next message could
+  // only start once this one completed.
+  if (!async->starting_read && (async->complete_cb != NULL)) {
+    async->complete_cb(async->complete_ctx);
+  }
+}
 
-    if (active_source->impl->has_more_msgs_cb(total_size)) {
-      return true;
+//! Drops the data the read buffers hold which isn't needed anymore, i.e. everything but the data
+//! buffered contiguously from 'offset' on
+//!
+//! @return The offset the data buffered from 'offset' on ends at
+static uint32_t prv_async_update_slots(sMfltPacketizerAsyncReadState *async, uint32_t offset) {
+  bool used[MEMFAULT_ARRAY_SIZE(async->slots)] = { 0 };
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(async->slots); i++) {
+    sMfltPacketizerReadSlot *slot = &async->slots[i];
+    if ((slot->state == kMfltPacketizerReadSlotState_Ready) && slot->read_failed) {
+      // Same as a synchronous read failure, see prv_data_source_chunk_transport_msg_reader()
+      MEMFAULT_LOG_ERROR("Async read at offset 0x%" PRIx32 " (%d bytes) failed", slot->offset,
+                         (int)slot->len);
+      memset(slot->buf, 0xEF, slot->len);
+      slot->read_failed = false;
+    }
+  }
+
+  uint32_t buffered_end = offset;
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(async->slots); i++) {
+      const sMfltPacketizerReadSlot *slot = &async->slots[i];
+      if (used[i] || (slot->state != kMfltPacketizerReadSlotState_Ready) ||
+          (buffered_end < slot->offset) || (buffered_end >= (slot->offset + slot->len))) {
+        continue;
+      }
+      buffered_end = slot->offset + (uint32_t)slot->len;
+      used[i] = true;
+      progress = true;
     }
   }
+
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(async->slots); i++) {
+    if (!used[i] && (async->slots[i].state == kMfltPacketizerReadSlotState_Ready)) {
+      async->slots[i].state = kMfltPacketizerReadSlotState_Empty;
+    }
+  }
+  return buffered_end;
+}
+
+static void prv_async_start_read(sMfltPacketizerCtx *ctx, uint8_t slot_idx, uint32_t offset,
+                                 size_t len) {
+  sMfltPacketizerAsyncReadState *async = &ctx->async_read;
+  sMfltPacketizerReadSlot *slot = &async->slots[slot_idx];
+  const sMemfaultDataSourceImpl *impl = ctx->state.impl;
+
+  slot->offset = offset;
+  slot->len = len;
+  slot->read_failed = false;
+  slot->state = kMfltPacketizerReadSlotState_Reading;
+  async->reading_slot = slot_idx;
+  async->discard_read = false;
+  async->read_in_flight = true;
+
+  async->starting_read = true;
+  const bool started = impl->start_read_cb(impl->ctx, offset, slot->buf, len,
+                                           prv_async_read_complete, ctx);
+  async->starting_read = false;
+  if (!started) {
+    // fall back to reading the data right away
+    slot->read_failed = !memfault_data_source_read_msg(impl, offset, slot->buf, len);
+    slot->state = kMfltPacketizerReadSlotState_Ready;
+    async->read_in_flight = false;
+  }
+}
+
+//! Starts reading the message from the data source 'offset' on into a free read buffer
+//!
+//! @note prv_async_update_slots() must be called first to free the buffers no longer needed
+//!
+//! @return false if there is no free read buffer
+static bool prv_async_read_ahead(sMfltPacketizerCtx *ctx, uint32_t offset) {
+  sMfltPacketizerAsyncReadState *async = &ctx->async_read;
+  const uint32_t source_size = prv_async_source_offset(ctx->state.curr_msg_ctx.total_size);
+  for (uint8_t i = 0; i < MEMFAULT_ARRAY_SIZE(async->slots); i++) {
+    const sMfltPacketizerReadSlot *slot = &async->slots[i];
+    if (slot->state != kMfltPacketizerReadSlotState_Empty) {
+      continue;
+    }
+    prv_async_start_read(ctx, i, offset, MEMFAULT_MIN(slot->buf_len, source_size - offset));
+    return true;
+  }
   return false;
 }
 
-static bool prv_more_messages_to_send(sMessageMetadata *msg_metadata) {
-  size_t total_size;
-  sMemfaultDataSource active_source;
-  if (!prv_get_source_with_data(&total_size, &active_source)) {
+//! Starts reading the data which follows the data buffered, if no read is in flight already
+static void prv_async_prefetch(sMfltPacketizerCtx *ctx) {
+  sMfltPacketizerAsyncReadState *async = &ctx->async_read;
+  if (async->read_in_flight) {
+    return;
+  }
+
+  const sMfltChunkTransportCtx *msg = &ctx->state.curr_msg_ctx;
+  const uint32_t buffered_end =
+      prv_async_update_slots(async, prv_async_source_offset(msg->read_offset));
+  if (buffered_end < prv_async_source_offset(msg->total_size)) {
+    prv_async_read_ahead(ctx, buffered_end);
+  }
+}
+
+//! Makes sure the data of the next packet, of at most 'packet_len' bytes, is buffered and starts
+//! reading it if it is not
+//!
+//! @return false if the data of the packet is still being read
+static bool prv_async_packet_data_ready(sMfltPacketizerCtx *ctx, size_t packet_len) {
+  sMfltPacketizerAsyncReadState *async = &ctx->async_read;
+  const sMfltChunkTransportCtx *msg = &ctx->state.curr_msg_ctx;
+  if (msg->fec_parity_pending) {
+    // the parity of the group is sent next, it needs no data
+    return true;
+  }
+
+  const uint32_t start = prv_async_source_offset(msg->read_offset);
+  const uint32_t end = prv_async_source_offset(
+      (uint32_t)MEMFAULT_MIN(msg->read_offset + packet_len, msg->total_size));
+  while (true) {
+    const uint32_t buffered_end = prv_async_update_slots(async, start);
+    if (buffered_end >= end) {
+      return true;
+    }
+    if (async->read_in_flight) {
+      return false;
+    }
+    if (!prv_async_read_ahead(ctx, buffered_end)) {
+      // both buffers hold data of the packet, the rest of it is read synchronously
+      return true;
+    }
+  }
+}
+
+//! Sets up the asynchronous reads of the message just loaded, if the config and its data source
+//! allow for them, and starts reading its first packets
+static void prv_async_read_setup(sMfltPacketizerCtx *ctx, const sPacketizerConfig *cfg) {
+  sMfltPacketizerAsyncReadState *async = &ctx->async_read;
+  async->enabled = (cfg->async_read_buf != NULL) && (cfg->async_read_buf_len >= 2) &&
+      !ctx->state.use_rle && (ctx->state.impl->start_read_cb != NULL);
+  if (!async->enabled) {
+    return;
+  }
+
+  // A read discarded by an abort may still be in flight. No other read is started until it
+  // completes, so the buffers can be switched already.
+  async->complete_cb = cfg->async_read_complete_cb;
+  async->complete_ctx = cfg->async_read_complete_ctx;
+  const size_t half_len = cfg->async_read_buf_len / 2;
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(async->slots); i++) {
+    async->slots[i].buf = &((uint8_t *)cfg->async_read_buf)[i * half_len];
+    async->slots[i].buf_len = half_len;
+  }
+  prv_async_prefetch(ctx);
+}
+
+//! @return The RLE encoded version of the data source or NULL if RLE is not available
+static const sMemfaultDataSourceImpl *prv_rle_encode_source(sMfltPacketizerCtx *ctx,
+                                                            const sMemfaultDataSourceImpl *impl) {
+  if (ctx == &s_mflt_packetizer_ctx) {
+    // The global instance uses the global RLE encoder
+    return memfault_data_source_rle_encoder_set_active(impl) ? &g_memfault_data_rle_source : NULL;
+  }
+
+  if (ctx->sources.rle == NULL) {
     return NULL;
   }
+  return memfault_data_source_rle_ctx_set_active(ctx->sources.rle, impl);
+}
+
+static bool prv_get_source_with_data(sMfltPacketizerCtx *ctx, size_t *total_size,
+                                     sMemfaultDataSource *active_source) {
+  const sMemfaultDataSource data_sources[] = {
+    {
+      .type = kMfltMessageType_Coredump,
+      .use_rle = true,
+      .impl = ctx->sources.coredump_source,
+    },
+    {
+      .type = kMfltMessageType_Event,
+      .use_rle = false,
+      .impl = ctx->sources.event_source,
+    }
+  };
 
-  if (msg_metadata != NULL) {
-    *msg_metadata = (sMessageMetadata) {
-      .total_size = total_size,
-      .source = active_source,
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(data_sources); i++) {
+    const sMemfaultDataSource *data_source = &data_sources[i];
+    if (data_source->impl == NULL) {
+      continue;
+    }
+
+    const sMemfaultDataSourceImpl *rle_impl =
+        data_source->use_rle ? prv_rle_encode_source(ctx, data_source->impl) : NULL;
+
+    *active_source = (sMemfaultDataSource) {
+      .type = data_source->type,
+      .use_rle = (rle_impl != NULL),
+      .impl = (rle_impl != NULL) ? rle_impl : data_source->impl,
     };
-  }
 
-  return true;
+    if (memfault_data_source_has_more_msgs(active_source->impl, total_size)) {
+      return true;
+    }
+  }
+  return false;
 }
 
-static bool prv_load_next_message_to_send(bool enable_multi_packet_chunks,
-                                          sMfltTransportState *state) {
-  sMessageMetadata msg_metadata;
-  if (!prv_more_messages_to_send(&msg_metadata)) {
+static bool prv_load_next_message_to_send(sMfltPacketizerCtx *ctx, const sPacketizerConfig *cfg) {
+  size_t total_size;
+  sMemfaultDataSource active_source;
+  if (!prv_get_source_with_data(ctx, &total_size, &active_source)) {
     return false;
   }
 
-  *state = (sMfltTransportState) {
+  ctx->state = (sMfltPacketizerTransportState) {
     .active_message = true,
-    .msg_metadata = msg_metadata,
+    .msg_type = (uint8_t)active_source.type,
+    .use_rle = active_source.use_rle,
+    .delivery_confirmation = cfg->enable_delivery_confirmation,
+    .impl = active_source.impl,
     .curr_msg_ctx = (sMfltChunkTransportCtx) {
-      .total_size = msg_metadata.total_size + sizeof(sMfltPacketizerHdr),
-      .read_msg = prv_data_source_chunk_transport_msg_reader,
-      .enable_multi_call_chunk = enable_multi_packet_chunks,
+      .total_size = total_size + sizeof(sMfltPacketizerHdr),
+      .ctx_read_msg = prv_data_source_chunk_transport_msg_reader,
+      .read_msg_ctx = ctx,
+      .enable_multi_call_chunk = cfg->enable_multi_packet_chunk,
+      .fec_group_size = MEMFAULT_MIN(cfg->fec_group_size,
+                                     MEMFAULT_CHUNK_TRANSPORT_MAX_FEC_GROUP_SIZE),
+      .fec_parity_buf = cfg->fec_parity_buf,
+      .fec_parity_buf_len = cfg->fec_parity_buf_len,
     },
   };
-  memfault_chunk_transport_get_chunk_info(&s_mflt_packetizer_state.curr_msg_ctx);
+  memfault_chunk_transport_get_chunk_info(&ctx->state.curr_msg_ctx);
+  prv_async_read_setup(ctx, cfg);
   return true;
 }
 
-static void prv_mark_message_send_complete_and_cleanup(void) {
+static void prv_mark_message_send_complete_and_cleanup(sMfltPacketizerCtx *ctx) {
   // we've finished sending the data so delete it
-  s_mflt_packetizer_state.msg_metadata.source.impl->mark_msg_read_cb();
+  memfault_data_source_mark_msg_read(ctx->state.impl);
+
+  prv_reset_packetizer_state(ctx);
+}
+
+void memfault_packetizer_ctx_init(sMfltPacketizerCtx *ctx, const sMfltPacketizerSources *sources) {
+  *ctx = (sMfltPacketizerCtx) {
+    .sources = *sources,
+  };
+}
 
-  prv_reset_packetizer_state();
+void memfault_packetizer_ctx_abort(sMfltPacketizerCtx *ctx) {
+  prv_reset_packetizer_state(ctx);
 }
 
 void memfault_packetizer_abort(void) {
-  prv_reset_packetizer_state();
+  memfault_packetizer_ctx_abort(&s_mflt_packetizer_ctx);
 }
 
-eMemfaultPacketizerStatus memfault_packetizer_get_next(void *buf, size_t *buf_len) {
+void memfault_packetizer_ctx_confirm_delivery(sMfltPacketizerCtx *ctx) {
+  if (!ctx->state.awaiting_confirmation) {
+    return;
+  }
+  prv_mark_message_send_complete_and_cleanup(ctx);
+}
+
+void memfault_packetizer_confirm_delivery(void) {
+  memfault_packetizer_ctx_confirm_delivery(&s_mflt_packetizer_ctx);
+}
+
+uint32_t memfault_packetizer_ctx_get_next_offset(const sMfltPacketizerCtx *ctx) {
+  return ctx->state.active_message ? ctx->state.curr_msg_ctx.read_offset : 0;
+}
+
+uint32_t memfault_packetizer_get_next_offset(void) {
+  return memfault_packetizer_ctx_get_next_offset(&s_mflt_packetizer_ctx);
+}
+
+bool memfault_packetizer_ctx_get_packet_at_offset(sMfltPacketizerCtx *ctx, uint32_t offset,
+                                                  void *buf, size_t *buf_len) {
+  if ((buf == NULL) || (buf_len == NULL)) {
+    MEMFAULT_LOG_ERROR("%s: NULL input arguments", __func__);
+    return false;
+  }
+
+  if (!ctx->state.active_message) {
+    *buf_len = 0;
+    return false;
+  }
+
+  if (ctx->sizing.enabled) {
+    *buf_len = MEMFAULT_MIN(*buf_len, memfault_packetizer_ctx_get_packet_size(ctx));
+  }
+  return memfault_chunk_transport_get_chunk_at_offset(&ctx->state.curr_msg_ctx, offset, buf,
+                                                      buf_len);
+}
+
+bool memfault_packetizer_get_packet_at_offset(uint32_t offset, void *buf, size_t *buf_len) {
+  return memfault_packetizer_ctx_get_packet_at_offset(&s_mflt_packetizer_ctx, offset, buf,
+                                                      buf_len);
+}
+
+//! @return 'len' rounded down to a multiple of the preferred multiple of the transport, or 'len'
+//!   itself if that would leave nothing
+static size_t prv_round_to_multiple(const sPacketizerTransportCaps *caps, size_t len) {
+  const size_t multiple = caps->preferred_multiple;
+  if ((multiple <= 1) || (len < multiple)) {
+    return len;
+  }
+  return len - (len % multiple);
+}
+
+//! Clamps the packet length to its bounds, keeping it a multiple of the preferred multiple
+static size_t prv_clamp_packet_len(const sMfltPacketizerSizingState *sizing, size_t packet_len) {
+  packet_len = MEMFAULT_MIN(packet_len, sizing->max_packet_len);
+  packet_len = prv_round_to_multiple(&sizing->caps, packet_len);
+  return MEMFAULT_MAX(packet_len, sizing->min_packet_len);
+}
+
+bool memfault_packetizer_ctx_set_transport_caps(sMfltPacketizerCtx *ctx,
+                                                const sPacketizerTransportCaps *caps) {
+  if (caps == NULL) {
+    ctx->sizing = (sMfltPacketizerSizingState) { 0 };
+    return true;
+  }
+
+  const size_t max_packet_len = prv_round_to_multiple(caps, caps->mtu);
+  if ((max_packet_len <= caps->per_packet_overhead) ||
+      ((max_packet_len - caps->per_packet_overhead) < MEMFAULT_PACKETIZER_MIN_BUF_LEN)) {
+    MEMFAULT_LOG_ERROR("MTU of %d bytes too small to packetize data", (int)caps->mtu);
+    return false;
+  }
+
+  // don't shrink below an eighth of the largest packet, with room for a chunk in it
+  const size_t min_packet_len =
+      MEMFAULT_MAX(max_packet_len / 8, caps->per_packet_overhead + MEMFAULT_PACKETIZER_MIN_BUF_LEN);
+  ctx->sizing = (sMfltPacketizerSizingState) {
+    .enabled = true,
+    .caps = *caps,
+    .max_packet_len = max_packet_len,
+    .min_packet_len = min_packet_len,
+    .packet_len = max_packet_len,
+  };
+  return true;
+}
+
+bool memfault_packetizer_set_transport_caps(const sPacketizerTransportCaps *caps) {
+  return memfault_packetizer_ctx_set_transport_caps(&s_mflt_packetizer_ctx, caps);
+}
+
+void memfault_packetizer_ctx_report_link_feedback(sMfltPacketizerCtx *ctx, uint32_t num_packets,
+                                                  uint32_t num_retransmissions) {
+  sMfltPacketizerSizingState *sizing = &ctx->sizing;
+  if (!sizing->enabled || (num_packets == 0)) {
+    return;
+  }
+
+  if (((uint64_t)num_retransmissions * 100) >
+      ((uint64_t)num_packets * MEMFAULT_PACKETIZER_SHRINK_RETRANSMIT_PERCENT)) {
+    sizing->packet_len = prv_clamp_packet_len(sizing, sizing->packet_len / 2);
+    sizing->num_clean_packets = 0;
+    return;
+  }
+
+  if (num_retransmissions != 0) {
+    // tolerable, but not a sign the link can take larger packets either
+    sizing->num_clean_packets = 0;
+    return;
+  }
+
+  sizing->num_clean_packets += num_packets;
+  if ((sizing->num_clean_packets >= MEMFAULT_PACKETIZER_GROW_AFTER_PACKETS) &&
+      (sizing->packet_len < sizing->max_packet_len)) {
+    const size_t step = MEMFAULT_MAX(sizing->max_packet_len / 8, sizing->caps.preferred_multiple);
+    sizing->packet_len = prv_clamp_packet_len(sizing, sizing->packet_len + step);
+    sizing->num_clean_packets = 0;
+  }
+}
+
+void memfault_packetizer_report_link_feedback(uint32_t num_packets, uint32_t num_retransmissions) {
+  memfault_packetizer_ctx_report_link_feedback(&s_mflt_packetizer_ctx, num_packets,
+                                               num_retransmissions);
+}
+
+size_t memfault_packetizer_ctx_get_packet_size(const sMfltPacketizerCtx *ctx) {
+  if (!ctx->sizing.enabled) {
+    return 0;
+  }
+  return ctx->sizing.packet_len - ctx->sizing.caps.per_packet_overhead;
+}
+
+size_t memfault_packetizer_get_packet_size(void) {
+  return memfault_packetizer_ctx_get_packet_size(&s_mflt_packetizer_ctx);
+}
+
+eMemfaultPacketizerStatus memfault_packetizer_ctx_get_next(sMfltPacketizerCtx *ctx, void *buf,
+                                                           size_t *buf_len) {
   if (buf == NULL || buf_len == NULL) {
     // We may want to consider just asserting on these. For now, just log an error
     // and return NoMoreData
@@ -222,14 +604,22 @@ eMemfaultPacketizerStatus memfault_packetizer_get_next(void *buf, size_t *buf_le
     return kMemfaultPacketizerStatus_NoMoreData;
   }
 
-  if (!s_mflt_packetizer_state.active_message) {
+  if (!ctx->state.active_message || ctx->state.awaiting_confirmation) {
     // To load a new message, memfault_packetizer_begin() must first be called
     return kMemfaultPacketizerStatus_NoMoreData;
   }
 
   size_t original_size = *buf_len;
-  bool md = memfault_chunk_transport_get_next_chunk(
-      &s_mflt_packetizer_state.curr_msg_ctx, buf, buf_len);
+  if (ctx->sizing.enabled) {
+    *buf_len = MEMFAULT_MIN(*buf_len, memfault_packetizer_ctx_get_packet_size(ctx));
+  }
+
+  if (ctx->async_read.enabled && !prv_async_packet_data_ready(ctx, *buf_len)) {
+    *buf_len = 0;
+    return kMemfaultPacketizerStatus_Pending;
+  }
+
+  bool md = memfault_chunk_transport_get_next_chunk(&ctx->state.curr_msg_ctx, buf, buf_len);
 
   if (*buf_len == 0) {
     MEMFAULT_LOG_ERROR("Buffer of %d bytes too small to packetize data",
@@ -237,49 +627,80 @@ eMemfaultPacketizerStatus memfault_packetizer_get_next(void *buf, size_t *buf_le
   }
 
   if (!md) {
+    if (ctx->state.delivery_confirmation) {
+      // the message is deleted once the transport confirms it was received
+      ctx->state.awaiting_confirmation = true;
+      return kMemfaultPacketizerStatus_EndOfChunk;
+    }
+
     // the entire message has been chunked up, perform clean up
-    prv_mark_message_send_complete_and_cleanup();
+    prv_mark_message_send_complete_and_cleanup(ctx);
 
     // we have reached the end of a message
     return kMemfaultPacketizerStatus_EndOfChunk;
   }
 
-  return s_mflt_packetizer_state.curr_msg_ctx.enable_multi_call_chunk ?
+  if (ctx->async_read.enabled) {
+    // read what follows while this packet is sent
+    prv_async_prefetch(ctx);
+  }
+
+  return ctx->state.curr_msg_ctx.enable_multi_call_chunk ?
       kMemfaultPacketizerStatus_MoreDataForChunk : kMemfaultPacketizerStatus_EndOfChunk;
 }
 
-bool memfault_packetizer_begin(const sPacketizerConfig *cfg,
-                               sPacketizerMetadata *metadata_out) {
+eMemfaultPacketizerStatus memfault_packetizer_get_next(void *buf, size_t *buf_len) {
+  return memfault_packetizer_ctx_get_next(&s_mflt_packetizer_ctx, buf, buf_len);
+}
+
+bool memfault_packetizer_ctx_begin(sMfltPacketizerCtx *ctx, const sPacketizerConfig *cfg,
+                                   sPacketizerMetadata *metadata_out) {
   if ((cfg == NULL) || (metadata_out == NULL)) {
     MEMFAULT_LOG_ERROR("%s: NULL input arguments", __func__);
     return false;
   }
 
-  if (!s_mflt_packetizer_state.active_message) {
-    if (!prv_load_next_message_to_send(cfg->enable_multi_packet_chunk, &s_mflt_packetizer_state)) {
+  if (ctx->state.awaiting_confirmation) {
+    // the delivery of the last message was never confirmed, send it again
+    prv_reset_packetizer_state(ctx);
+  }
+
+  if (!ctx->state.active_message) {
+    if (!prv_load_next_message_to_send(ctx, cfg)) {
       // no new messages to send
       *metadata_out = (sPacketizerMetadata) { 0 };
       return false;
     }
   }
 
-  const bool send_in_progress = s_mflt_packetizer_state.curr_msg_ctx.read_offset != 0;
+  const bool send_in_progress = ctx->state.curr_msg_ctx.read_offset != 0;
   *metadata_out = (sPacketizerMetadata) {
-    .single_chunk_message_length = s_mflt_packetizer_state.curr_msg_ctx.single_chunk_message_length,
+    .single_chunk_message_length = ctx->state.curr_msg_ctx.single_chunk_message_length,
     .send_in_progress = send_in_progress,
   };
   return true;
 }
 
-bool memfault_packetizer_data_available(void) {
-  if (s_mflt_packetizer_state.active_message) {
+bool memfault_packetizer_begin(const sPacketizerConfig *cfg,
+                               sPacketizerMetadata *metadata_out) {
+  return memfault_packetizer_ctx_begin(&s_mflt_packetizer_ctx, cfg, metadata_out);
+}
+
+bool memfault_packetizer_ctx_data_available(sMfltPacketizerCtx *ctx) {
+  if (ctx->state.active_message) {
     return true;
   }
 
-  return prv_more_messages_to_send(NULL);
+  size_t total_size;
+  sMemfaultDataSource active_source;
+  return prv_get_source_with_data(ctx, &total_size, &active_source);
 }
 
-bool memfault_packetizer_get_chunk(void *buf, size_t *buf_len) {
+bool memfault_packetizer_data_available(void) {
+  return memfault_packetizer_ctx_data_available(&s_mflt_packetizer_ctx);
+}
+
+bool memfault_packetizer_ctx_get_chunk(sMfltPacketizerCtx *ctx, void *buf, size_t *buf_len) {
   const sPacketizerConfig cfg = {
     // By setting this to false, every call to "memfault_packetizer_get_next()" will return one
     // "chunk" that you must send from the device
@@ -287,13 +708,14 @@ bool memfault_packetizer_get_chunk(void *buf, size_t *buf_len) {
   };
 
   sPacketizerMetadata metadata;
-  bool data_available = memfault_packetizer_begin(&cfg, &metadata);
+  bool data_available = memfault_packetizer_ctx_begin(ctx, &cfg, &metadata);
   if (!data_available) {
     // there are no more chunks to send
     return false;
   }
 
-  eMemfaultPacketizerStatus packetizer_status = memfault_packetizer_get_next(buf, buf_len);
+  eMemfaultPacketizerStatus packetizer_status =
+      memfault_packetizer_ctx_get_next(ctx, buf, buf_len);
 
   // We know data is available from the memfault_packetizer_begin() call above
   // so anything but kMemfaultPacketizerStatus_EndOfChunk is unexpected
@@ -304,3 +726,7 @@ bool memfault_packetizer_get_chunk(void *buf, size_t *buf_len) {
 
   return true;
 }
+
+bool memfault_packetizer_get_chunk(void *buf, size_t *buf_len) {
+  return memfault_packetizer_ctx_get_chunk(&s_mflt_packetizer_ctx, buf, buf_len);
+}
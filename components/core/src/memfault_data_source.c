@@ -0,0 +1,33 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/core/data_packetizer_source.h"
+
+bool memfault_data_source_has_more_msgs(const sMemfaultDataSourceImpl *source,
+                                        size_t *next_msg_size) {
+  if (source->ctx_has_more_msgs_cb != NULL) {
+    return source->ctx_has_more_msgs_cb(source->ctx, next_msg_size);
+  }
+  return source->has_more_msgs_cb(next_msg_size);
+}
+
+bool memfault_data_source_read_msg(const sMemfaultDataSourceImpl *source, uint32_t offset,
+                                   void *buf, size_t buf_len) {
+  if (source->ctx_read_msg_cb != NULL) {
+    return source->ctx_read_msg_cb(source->ctx, offset, buf, buf_len);
+  }
+  return source->read_msg_cb(offset, buf, buf_len);
+}
+
+void memfault_data_source_mark_msg_read(const sMemfaultDataSourceImpl *source) {
+  if (source->ctx_mark_msg_read_cb != NULL) {
+    source->ctx_mark_msg_read_cb(source->ctx);
+    return;
+  }
+  source->mark_msg_read_cb();
+}
@@ -0,0 +1,214 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/core/data_source_cache.h"
+
+#include <string.h>
+
+#include "memfault/core/data_packetizer_source.h"
+#include "memfault/core/math.h"
+
+static void prv_invalidate(sMfltDataSourceCacheCtx *cache) {
+  for (size_t i = 0; i < cache->cfg.num_blocks; i++) {
+    cache->blocks[i].valid = false;
+  }
+}
+
+static uint8_t *prv_block_storage(sMfltDataSourceCacheCtx *cache, size_t block_idx) {
+  return &((uint8_t *)cache->cfg.storage)[block_idx * cache->cfg.block_size];
+}
+
+static bool prv_source_read(sMfltDataSourceCacheCtx *cache, uint32_t offset, void *buf,
+                            size_t buf_len) {
+  const sMemfaultDataSourceImpl *source = cache->cfg.source;
+  cache->stats.num_source_reads++;
+  cache->stats.source_bytes_read += (uint32_t)buf_len;
+  return memfault_data_source_read_msg(source, offset, buf, buf_len);
+}
+
+//! @return The index of the block holding the data at 'block_offset' or -1 if none does
+static int prv_find_block(const sMfltDataSourceCacheCtx *cache, uint32_t block_offset) {
+  for (size_t i = 0; i < cache->cfg.num_blocks; i++) {
+    const sMfltDataSourceCacheBlock *block = &cache->blocks[i];
+    if (block->valid && (block->offset == block_offset)) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+//! Blocks read at once land in consecutive blocks of the storage, so they can be read with a
+//! single read of the backing data source. The window of 'num_blocks' blocks evicted is the one
+//! whose most recently used block was used the longest time ago.
+//!
+//! @return The index of the first block of the window
+static size_t prv_find_victims(const sMfltDataSourceCacheCtx *cache, size_t num_blocks) {
+  size_t best_idx = 0;
+  uint32_t best_last_used = UINT32_MAX;
+  for (size_t start = 0; (start + num_blocks) <= cache->cfg.num_blocks; start++) {
+    uint32_t window_last_used = 0;
+    for (size_t i = start; i < (start + num_blocks); i++) {
+      const sMfltDataSourceCacheBlock *block = &cache->blocks[i];
+      if (block->valid) {
+        window_last_used = MEMFAULT_MAX(window_last_used, block->last_used);
+      }
+    }
+    if (window_last_used < best_last_used) {
+      best_idx = start;
+      best_last_used = window_last_used;
+    }
+  }
+  return best_idx;
+}
+
+//! Reads the block at 'block_offset' from the backing data source, along with the blocks which
+//! follow it that aren't cached yet, up to the 'num_needed' blocks the read request spans and, when
+//! 'read_ahead' is set, up to read_ahead_blocks
+//!
+//! @return The index of the block read or -1 if the read failed
+static int prv_load_blocks(sMfltDataSourceCacheCtx *cache, uint32_t block_offset,
+                           size_t num_needed, bool read_ahead) {
+  const size_t block_size = cache->cfg.block_size;
+  size_t max_blocks = num_needed;
+  if (read_ahead) {
+    max_blocks = MEMFAULT_MAX(max_blocks, cache->cfg.read_ahead_blocks);
+  }
+  max_blocks = MEMFAULT_MIN(max_blocks, cache->cfg.num_blocks);
+
+  size_t num_blocks = 1;
+  while ((num_blocks < max_blocks) &&
+         ((block_offset + (num_blocks * block_size)) < cache->msg_size) &&
+         (prv_find_block(cache, (uint32_t)(block_offset + (num_blocks * block_size))) < 0)) {
+    num_blocks++;
+  }
+
+  const size_t first_idx = prv_find_victims(cache, num_blocks);
+  for (size_t i = first_idx; i < (first_idx + num_blocks); i++) {
+    cache->blocks[i].valid = false;
+  }
+
+  const size_t read_len = MEMFAULT_MIN(num_blocks * block_size, cache->msg_size - block_offset);
+  if (!prv_source_read(cache, block_offset, prv_block_storage(cache, first_idx), read_len)) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < num_blocks; i++) {
+    const uint32_t offset = block_offset + (uint32_t)(i * block_size);
+    cache->blocks[first_idx + i] = (sMfltDataSourceCacheBlock) {
+      .valid = true,
+      .offset = offset,
+      .len = MEMFAULT_MIN(block_size, cache->msg_size - offset),
+      .last_used = cache->use_counter,
+    };
+  }
+  cache->stats.num_misses += (uint32_t)MEMFAULT_MIN(num_blocks, num_needed);
+  if (num_blocks > num_needed) {
+    cache->stats.num_blocks_read_ahead += (uint32_t)(num_blocks - num_needed);
+  }
+  return (int)first_idx;
+}
+
+//! @return true if the read continues the sequential reads before it
+static bool prv_track_sequential_reads(sMfltDataSourceCacheCtx *cache, uint32_t offset,
+                                       size_t buf_len) {
+  if ((offset >= cache->last_read_offset) && (offset <= cache->last_read_end)) {
+    cache->num_sequential_reads++;
+  } else {
+    cache->num_sequential_reads = 0;
+  }
+  cache->last_read_offset = offset;
+  cache->last_read_end = offset + (uint32_t)buf_len;
+  return cache->num_sequential_reads >= MEMFAULT_DATA_SOURCE_CACHE_SEQUENTIAL_READS;
+}
+
+static bool prv_cache_has_more_msgs(void *ctx, size_t *total_size_out) {
+  sMfltDataSourceCacheCtx *cache = ctx;
+  const sMemfaultDataSourceImpl *source = cache->cfg.source;
+  const bool has_msg = memfault_data_source_has_more_msgs(source, total_size_out);
+
+  // The message reported may not be the one the blocks were read from, even if it has the same
+  // size (i.e a new coredump replaced the last one), so nothing cached is reused across calls.
+  // Readers call this once before reading a message, not in between reads of it.
+  prv_invalidate(cache);
+  cache->msg_size = has_msg ? *total_size_out : 0;
+  return has_msg;
+}
+
+static bool prv_cache_read_msg(void *ctx, uint32_t offset, void *buf, size_t buf_len) {
+  sMfltDataSourceCacheCtx *cache = ctx;
+  if ((cache->msg_size == 0) || ((offset + buf_len) > cache->msg_size)) {
+    // the size of the message isn't known, let the backing data source deal with the read
+    return prv_source_read(cache, offset, buf, buf_len);
+  }
+
+  const bool sequential = prv_track_sequential_reads(cache, offset, buf_len);
+  const size_t block_size = cache->cfg.block_size;
+  // blocks last used after this point were read for this request and counted as misses
+  const uint32_t request_start = cache->use_counter;
+  uint8_t *bufp = buf;
+  while (buf_len != 0) {
+    const uint32_t block_offset = offset - (offset % block_size);
+    int block_idx = prv_find_block(cache, block_offset);
+    cache->use_counter++;
+    if (block_idx < 0) {
+      const size_t num_needed = (offset + buf_len - block_offset + block_size - 1) / block_size;
+      block_idx = prv_load_blocks(cache, block_offset, num_needed, sequential);
+      if (block_idx < 0) {
+        return false;
+      }
+    } else if (cache->blocks[block_idx].last_used <= request_start) {
+      cache->stats.num_hits++;
+    }
+
+    sMfltDataSourceCacheBlock *block = &cache->blocks[block_idx];
+    block->last_used = cache->use_counter;
+    const size_t len = MEMFAULT_MIN(block->offset + block->len - offset, buf_len);
+    memcpy(bufp, &prv_block_storage(cache, (size_t)block_idx)[offset - block->offset], len);
+    bufp += len;
+    offset += (uint32_t)len;
+    buf_len -= len;
+  }
+  return true;
+}
+
+static void prv_cache_mark_msg_read(void *ctx) {
+  sMfltDataSourceCacheCtx *cache = ctx;
+  const sMemfaultDataSourceImpl *source = cache->cfg.source;
+  memfault_data_source_mark_msg_read(source);
+  prv_invalidate(cache);
+  cache->msg_size = 0;
+}
+
+const sMemfaultDataSourceImpl *memfault_data_source_cache_init(
+    sMfltDataSourceCacheCtx *cache, const sMfltDataSourceCacheConfig *cfg) {
+  if ((cache == NULL) || (cfg == NULL) || (cfg->source == NULL) || (cfg->storage == NULL) ||
+      (cfg->block_size == 0) || (cfg->num_blocks == 0) ||
+      (cfg->num_blocks > MEMFAULT_DATA_SOURCE_CACHE_MAX_BLOCKS)) {
+    return NULL;
+  }
+
+  *cache = (sMfltDataSourceCacheCtx) {
+    .cfg = *cfg,
+    .impl = {
+      .ctx_has_more_msgs_cb = prv_cache_has_more_msgs,
+      .ctx_read_msg_cb = prv_cache_read_msg,
+      .ctx_mark_msg_read_cb = prv_cache_mark_msg_read,
+      .ctx = cache,
+    },
+  };
+  return &cache->impl;
+}
+
+void memfault_data_source_cache_invalidate(sMfltDataSourceCacheCtx *cache) {
+  prv_invalidate(cache);
+}
+
+void memfault_data_source_cache_get_stats(const sMfltDataSourceCacheCtx *cache,
+                                          sMfltDataSourceCacheStats *stats_out) {
+  *stats_out = cache->stats;
+}
@@ -28,95 +28,90 @@
 //! @note Expects to be fed all the bytes from the backing message sequentially
 //! @return true when the check has completed and calling memfault_data_source_rle_has_more_msgs()
 //! will result in no more backing flash reads, false otherwise
-static bool prv_data_source_rle_has_more_msgs_prepare(const void *data, size_t data_len);
+static bool prv_data_source_rle_has_more_msgs_prepare(sMfltDataSourceRleCtx *rle,
+                                                      const void *data, size_t data_len);
 
 //! @return the offset the next call to memfault_data_source_rle_read_msg() will start reading from
-static uint32_t prv_data_source_rle_get_backing_read_offset(void);
+static uint32_t prv_data_source_rle_get_backing_read_offset(sMfltDataSourceRleCtx *rle);
 
 //! Helper function which finds the next RLE sequence that will be written out
 //!
 //! @note Expects to be fed all the bytes from the backing message sequentially starting from
 //!   prv_data_source_rle_get_backing_read_offset()
 //! @return true when enough data has been processed to figure out what needs to be written
-static bool prv_data_source_rle_read_msg_prepare(const void *data, size_t data_len);
+static bool prv_data_source_rle_read_msg_prepare(sMfltDataSourceRleCtx *rle,
+                                                 const void *data, size_t data_len);
 
 //! Helper function that builds buffer returned from memfault_data_source_rle_read_msg()
 //!
 //! @return 0 the number of bytes populated in buf
-static uint32_t prv_data_source_rle_build_msg_incremental(uint8_t *buf, size_t buf_len);
-
-static const sMemfaultDataSourceImpl *s_active_data_source = NULL;
-
-typedef enum {
-  kMemfaultDataSourceRleState_Inactive = 0,
-  // Searching for the next sequence to encode
-  kMemfaultDataSourceRleState_FindingSeqLength,
-  // A sequence to encode has been found and is being written out
-  // via calls to memfault_data_source_rle_read_msg()
-  kMemfaultDataSourceRleState_WritingSequence,
-} eMemfaultDataSourceRleState;
-
-typedef struct {
-  eMemfaultDataSourceRleState state;
-  uint8_t temp_buf[128];
-  // The number of bytes written within the current RLE sequence
-  uint32_t write_offset;
-  // The total number of bytes that have been processed from the backing data source
-  uint32_t bytes_processed;
-  // The current number of encoded bytes which have been written
-  uint32_t curr_encoded_len;
-} sMemfaultDataSourceRleEncodeCtx;
-
-typedef struct {
-  sMemfaultDataSourceImpl *data_source;
-  size_t original_size;
-  size_t total_rle_size;
-  sMemfaultRleCtx rle_ctx;
-  sMemfaultDataSourceRleEncodeCtx encode_ctx;
-} sMemfaultDataSourceRleState;
-
-static sMemfaultDataSourceRleState s_ds_rle_state;
+static uint32_t prv_data_source_rle_build_msg_incremental(sMfltDataSourceRleCtx *rle,
+                                                          uint8_t *buf, size_t buf_len);
 
-bool memfault_data_source_rle_encoder_set_active(const sMemfaultDataSourceImpl *source) {
-  if (source == s_active_data_source) {
-    return true;
+//! Records a checkpoint of the encoder state for the sequence the size pass just found
+static void prv_checkpoint_record_sequence(sMfltDataSourceRleCtx *rle);
+
+static sMfltDataSourceRleCtx s_default_rle_ctx;
+
+static bool prv_data_source_rle_ctx_has_more_msgs(void *ctx, size_t *total_size_out);
+static bool prv_data_source_rle_ctx_read_msg(void *ctx, uint32_t offset, void *buf,
+                                             size_t buf_len);
+static void prv_data_source_rle_ctx_mark_msg_read(void *ctx);
+
+const sMemfaultDataSourceImpl *memfault_data_source_rle_ctx_set_active(
+    sMfltDataSourceRleCtx *rle, const sMemfaultDataSourceImpl *source) {
+  if (source != rle->active_source) {
+    rle->state = (sMemfaultDataSourceRleState) { 0 };
+    rle->active_source = source;
   }
 
-  s_ds_rle_state = (sMemfaultDataSourceRleState) { 0 };
-  s_active_data_source = source;
+  rle->impl = (sMemfaultDataSourceImpl) {
+    .ctx_has_more_msgs_cb = prv_data_source_rle_ctx_has_more_msgs,
+    .ctx_read_msg_cb = prv_data_source_rle_ctx_read_msg,
+    .ctx_mark_msg_read_cb = prv_data_source_rle_ctx_mark_msg_read,
+    .ctx = rle,
+  };
+  return &rle->impl;
+}
+
+bool memfault_data_source_rle_encoder_set_active(const sMemfaultDataSourceImpl *source) {
+  memfault_data_source_rle_ctx_set_active(&s_default_rle_ctx, source);
   return true;
 }
 
-static bool prv_data_source_rle_has_more_msgs_prepare(const void *data,
-                                                      size_t data_len) {
+static bool prv_data_source_rle_has_more_msgs_prepare(sMfltDataSourceRleCtx *rle,
+                                                      const void *data, size_t data_len) {
   const uint8_t *buf = data;
 
   size_t bytes_encoded = 0;
   while (bytes_encoded != data_len) {
     bytes_encoded += memfault_rle_encode(
-        &s_ds_rle_state.rle_ctx, &buf[bytes_encoded], data_len - bytes_encoded);
+        &rle->state.rle_ctx, &buf[bytes_encoded], data_len - bytes_encoded);
+    if (rle->state.rle_ctx.write_info.available) {
+      prv_checkpoint_record_sequence(rle);
+    }
   }
 
   const bool all_bytes_processed =
-      s_ds_rle_state.rle_ctx.curr_offset == s_ds_rle_state.original_size;
+      rle->state.rle_ctx.curr_offset == rle->state.original_size;
   if (!all_bytes_processed) {
     return false;
   }
 
-  memfault_rle_encode_finalize(&s_ds_rle_state.rle_ctx);
-  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &s_ds_rle_state.encode_ctx;
+  memfault_rle_encode_finalize(&rle->state.rle_ctx);
+  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &rle->state.encode_ctx;
   encode_ctx->state = kMemfaultDataSourceRleState_FindingSeqLength;
   return true;
 }
 
-static uint32_t prv_data_source_rle_get_backing_read_offset(void) {
-  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &s_ds_rle_state.encode_ctx;
+static uint32_t prv_data_source_rle_get_backing_read_offset(sMfltDataSourceRleCtx *rle) {
+  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &rle->state.encode_ctx;
   if (encode_ctx->state == kMemfaultDataSourceRleState_FindingSeqLength) {
     return encode_ctx->bytes_processed;
   }
 
   // else (encode_ctx->state == kMemfaultDataSourceRleState_WritingSequence)
-  sMemfaultRleWriteInfo *write_info = &s_ds_rle_state.rle_ctx.write_info;
+  sMemfaultRleWriteInfo *write_info = &rle->state.rle_ctx.write_info;
   if (encode_ctx->write_offset < write_info->header_len) {
     // Note: this should never happen since the read offset should only be looked up once the
     // header has been written but let's check just in case
@@ -128,32 +123,32 @@ static uint32_t prv_data_source_rle_get_backing_read_offset(void) {
   return write_info->write_start_offset + data_bytes_written;
 }
 
-static bool prv_data_source_rle_read_msg_prepare(const void *data,
-                                                 size_t data_len) {
+static bool prv_data_source_rle_read_msg_prepare(sMfltDataSourceRleCtx *rle,
+                                                 const void *data, size_t data_len) {
 
-  sMemfaultRleCtx *rle_ctx = &s_ds_rle_state.rle_ctx;
-  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &s_ds_rle_state.encode_ctx;
+  sMemfaultRleCtx *rle_ctx = &rle->state.rle_ctx;
+  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &rle->state.encode_ctx;
   const size_t bytes_encoded = memfault_rle_encode(rle_ctx, data, data_len);
   if (data_len == 0) {
     memfault_rle_encode_finalize(rle_ctx);
   }
   encode_ctx->bytes_processed += bytes_encoded;
 
-  sMemfaultRleWriteInfo *write_info = &s_ds_rle_state.rle_ctx.write_info;
+  sMemfaultRleWriteInfo *write_info = &rle->state.rle_ctx.write_info;
   if (write_info->available) {
     encode_ctx->state = kMemfaultDataSourceRleState_WritingSequence;
   }
   return write_info->available;
 }
 
-static uint32_t prv_data_source_rle_build_msg_incremental(uint8_t *buf,
-                                                          size_t buf_len) {
-  sMemfaultRleWriteInfo *write_info = &s_ds_rle_state.rle_ctx.write_info;
+static uint32_t prv_data_source_rle_build_msg_incremental(sMfltDataSourceRleCtx *rle,
+                                                          uint8_t *buf, size_t buf_len) {
+  sMemfaultRleWriteInfo *write_info = &rle->state.rle_ctx.write_info;
   if (!write_info->available) {
     return 0;
   }
 
-  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &s_ds_rle_state.encode_ctx;
+  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &rle->state.encode_ctx;
   uint32_t write_offset = encode_ctx->write_offset;
 
   // write header
@@ -174,9 +169,9 @@ static uint32_t prv_data_source_rle_build_msg_incremental(uint8_t *buf,
   size_t data_to_write =
       MEMFAULT_MIN(buf_len, total_write_len - encode_ctx->write_offset);
 
-  const uint32_t start_offset = prv_data_source_rle_get_backing_read_offset();
-  s_active_data_source->read_msg_cb(start_offset, &buf[header_bytes_to_write],
-                                    data_to_write);
+  const uint32_t start_offset = prv_data_source_rle_get_backing_read_offset(rle);
+  memfault_data_source_read_msg(rle->active_source, start_offset, &buf[header_bytes_to_write],
+                                data_to_write);
   encode_ctx->write_offset += data_to_write;
 
   const size_t bytes_written = header_bytes_to_write + data_to_write;
@@ -189,103 +184,238 @@ static uint32_t prv_data_source_rle_build_msg_incremental(uint8_t *buf,
   return bytes_written;
 }
 
-static bool prv_data_source_rle_fill_msg(uint8_t **bufpp, size_t *buf_len) {
+static bool prv_data_source_rle_fill_msg(sMfltDataSourceRleCtx *rle,
+                                         uint8_t **bufpp, size_t *buf_len) {
   const size_t bytes_written =
-      prv_data_source_rle_build_msg_incremental(*bufpp, *buf_len);
+      prv_data_source_rle_build_msg_incremental(rle, *bufpp, *buf_len);
   *buf_len -= bytes_written;
   *bufpp += bytes_written;
   return *buf_len == 0;
 }
 
-static bool prv_data_source_rle_read(uint32_t offset, void *buf,
+static void prv_checkpoint_capture(const sMfltDataSourceRleCtx *rle,
+                                   sMemfaultDataSourceRleCheckpoint *checkpoint) {
+  const sMemfaultDataSourceRleEncodeCtx *encode_ctx = &rle->state.encode_ctx;
+  *checkpoint = (sMemfaultDataSourceRleCheckpoint) {
+    .rle_ctx = rle->state.rle_ctx,
+    .state = encode_ctx->state,
+    .write_offset = encode_ctx->write_offset,
+    .bytes_processed = encode_ctx->bytes_processed,
+    .curr_encoded_len = encode_ctx->curr_encoded_len,
+  };
+}
+
+static void prv_checkpoint_apply(sMfltDataSourceRleCtx *rle,
+                                 const sMemfaultDataSourceRleCheckpoint *checkpoint) {
+  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &rle->state.encode_ctx;
+  rle->state.rle_ctx = checkpoint->rle_ctx;
+  encode_ctx->state = checkpoint->state;
+  encode_ctx->write_offset = checkpoint->write_offset;
+  encode_ctx->bytes_processed = checkpoint->bytes_processed;
+  encode_ctx->curr_encoded_len = checkpoint->curr_encoded_len;
+}
+
+static uint32_t prv_next_checkpoint_offset(const sMemfaultDataSourceRleState *state) {
+  const uint32_t last_offset = (state->num_checkpoints == 0) ?
+      0 : state->checkpoints[state->num_checkpoints - 1].curr_encoded_len;
+  return last_offset + state->checkpoint_interval;
+}
+
+//! The state recorded is the one of a read about to write the sequence out, which is only kept if
+//! it is far enough from the last checkpoint
+static void prv_checkpoint_record_sequence(sMfltDataSourceRleCtx *rle) {
+  sMemfaultDataSourceRleState *state = &rle->state;
+  const sMemfaultRleCtx *rle_ctx = &state->rle_ctx;
+  const sMemfaultRleWriteInfo *write_info = &rle_ctx->write_info;
+  const uint32_t encoded_offset =
+      rle_ctx->total_rle_size - (uint32_t)(write_info->header_len + write_info->write_len);
+
+  const size_t max_checkpoints = MEMFAULT_ARRAY_SIZE(state->checkpoints);
+  if (encoded_offset < prv_next_checkpoint_offset(state)) {
+    return;
+  }
+
+  if (state->num_checkpoints == max_checkpoints) {
+    // keep every other checkpoint so the table still spans the whole message
+    for (size_t i = 0; i < (max_checkpoints / 2); i++) {
+      state->checkpoints[i] = state->checkpoints[(2 * i) + 1];
+    }
+    state->num_checkpoints = max_checkpoints / 2;
+    state->checkpoint_interval *= 2;
+    if (encoded_offset < prv_next_checkpoint_offset(state)) {
+      return;
+    }
+  }
+
+  state->checkpoints[state->num_checkpoints++] = (sMemfaultDataSourceRleCheckpoint) {
+    .rle_ctx = *rle_ctx,
+    .state = kMemfaultDataSourceRleState_WritingSequence,
+    .write_offset = 0,
+    .bytes_processed = rle_ctx->curr_offset,
+    .curr_encoded_len = encoded_offset,
+  };
+}
+
+static bool prv_data_source_rle_read_sequential(sMfltDataSourceRleCtx *rle, void *buf,
+                                                size_t buf_len);
+
+//! Moves the encoder to 'offset' by resuming from the closest known state before it and encoding
+//! up to the offset
+static void prv_data_source_rle_seek(sMfltDataSourceRleCtx *rle, uint32_t offset) {
+  sMemfaultDataSourceRleState *state = &rle->state;
+  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &state->encode_ctx;
+
+  // remember how far sequential reads got so they carry on from there once the reads at other
+  // offsets (i.e to resend lost packets) are done
+  if (encode_ctx->curr_encoded_len > state->resume.curr_encoded_len) {
+    prv_checkpoint_capture(rle, &state->resume);
+  }
+
+  sMemfaultDataSourceRleCheckpoint start = {
+    .state = kMemfaultDataSourceRleState_FindingSeqLength,
+  };
+  if (encode_ctx->curr_encoded_len <= offset) {
+    prv_checkpoint_capture(rle, &start);
+  }
+  if ((state->resume.curr_encoded_len <= offset) &&
+      (state->resume.curr_encoded_len > start.curr_encoded_len)) {
+    start = state->resume;
+  }
+  for (size_t i = 0; i < state->num_checkpoints; i++) {
+    const sMemfaultDataSourceRleCheckpoint *checkpoint = &state->checkpoints[i];
+    if ((checkpoint->curr_encoded_len <= offset) &&
+        (checkpoint->curr_encoded_len > start.curr_encoded_len)) {
+      start = *checkpoint;
+    }
+  }
+  prv_checkpoint_apply(rle, &start);
+
+  uint8_t scratch[16];
+  while (encode_ctx->curr_encoded_len != offset) {
+    const size_t bytes_to_skip =
+        MEMFAULT_MIN(sizeof(scratch), offset - encode_ctx->curr_encoded_len);
+    prv_data_source_rle_read_sequential(rle, scratch, bytes_to_skip);
+  }
+}
+
+static bool prv_data_source_rle_read(sMfltDataSourceRleCtx *rle, uint32_t offset, void *buf,
                                      size_t buf_len) {
-  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &s_ds_rle_state.encode_ctx;
-  if (offset != encode_ctx->curr_encoded_len) {
-    return false; // Read happened from an unexpected offset
+  if ((rle->state.total_rle_size == 0) || (offset > rle->state.total_rle_size) ||
+      (buf_len > (rle->state.total_rle_size - offset))) {
+    return false; // Read past the end of the encoded message
+  }
+
+  if (offset != rle->state.encode_ctx.curr_encoded_len) {
+    prv_data_source_rle_seek(rle, offset);
   }
+  return prv_data_source_rle_read_sequential(rle, buf, buf_len);
+}
+
+static bool prv_data_source_rle_read_sequential(sMfltDataSourceRleCtx *rle, void *buf,
+                                                size_t buf_len) {
+  sMemfaultDataSourceRleEncodeCtx *encode_ctx = &rle->state.encode_ctx;
 
   // if there is already a write pending, flush that data first
   uint8_t *bufp = (uint8_t *)buf;
-  bool buf_full = prv_data_source_rle_fill_msg(&bufp, &buf_len);
+  bool buf_full = prv_data_source_rle_fill_msg(rle, &bufp, &buf_len);
   if (buf_full) {
     return true;
   }
 
-  while (encode_ctx->bytes_processed != s_ds_rle_state.original_size) {
+  while (encode_ctx->bytes_processed != rle->state.original_size) {
     uint8_t *working_buf = &encode_ctx->temp_buf[0];
     const size_t working_buf_size = sizeof(encode_ctx->temp_buf);
 
     const size_t bytes_remaining =
-        s_ds_rle_state.original_size - encode_ctx->bytes_processed;
+        rle->state.original_size - encode_ctx->bytes_processed;
     const size_t bytes_read = MEMFAULT_MIN(bytes_remaining, working_buf_size);
 
-    const size_t read_offset = prv_data_source_rle_get_backing_read_offset();
-    s_active_data_source->read_msg_cb(read_offset, working_buf, bytes_read);
-    prv_data_source_rle_read_msg_prepare(working_buf, bytes_read);
+    const size_t read_offset = prv_data_source_rle_get_backing_read_offset(rle);
+    memfault_data_source_read_msg(rle->active_source, read_offset, working_buf, bytes_read);
+    prv_data_source_rle_read_msg_prepare(rle, working_buf, bytes_read);
 
     // do we know what to write for the next block yet?
-    buf_full = prv_data_source_rle_fill_msg(&bufp, &buf_len);
+    buf_full = prv_data_source_rle_fill_msg(rle, &bufp, &buf_len);
     if (buf_full) {
       return true;
     }
   }
 
-  prv_data_source_rle_read_msg_prepare(NULL, 0);
-  prv_data_source_rle_fill_msg(&bufp, &buf_len);
+  prv_data_source_rle_read_msg_prepare(rle, NULL, 0);
+  prv_data_source_rle_fill_msg(rle, &bufp, &buf_len);
   return true;
 }
 
 //! Do one read pass over the data source currently saved in backing
 //! storage to compute what the total RLE size of the data we will be encoding
-static size_t prv_compute_rle_size(void) {
-  sMemfaultRleCtx *rle_ctx = &s_ds_rle_state.rle_ctx;
+static size_t prv_compute_rle_size(sMfltDataSourceRleCtx *rle) {
+  sMemfaultRleCtx *rle_ctx = &rle->state.rle_ctx;
+  rle->state.num_checkpoints = 0;
+  rle->state.checkpoint_interval = MEMFAULT_DATA_SOURCE_RLE_CHECKPOINT_INTERVAL;
 
   size_t bytes_processed = 0;
 
-  while (bytes_processed != s_ds_rle_state.original_size) {
-    sMemfaultDataSourceRleEncodeCtx *encode_ctx = &s_ds_rle_state.encode_ctx;
+  while (bytes_processed != rle->state.original_size) {
+    sMemfaultDataSourceRleEncodeCtx *encode_ctx = &rle->state.encode_ctx;
     uint8_t *working_buf = &encode_ctx->temp_buf[0];
     const size_t working_buf_size = sizeof(encode_ctx->temp_buf);
-    const size_t bytes_left = s_ds_rle_state.original_size - bytes_processed;
+    const size_t bytes_left = rle->state.original_size - bytes_processed;
     const size_t bytes_to_read = MEMFAULT_MIN(bytes_left, working_buf_size);
-    s_active_data_source->read_msg_cb(bytes_processed, working_buf,
-                                      bytes_to_read);
-    prv_data_source_rle_has_more_msgs_prepare(working_buf, bytes_to_read);
+    memfault_data_source_read_msg(rle->active_source, bytes_processed, working_buf,
+                                  bytes_to_read);
+    prv_data_source_rle_has_more_msgs_prepare(rle, working_buf, bytes_to_read);
     bytes_processed += bytes_to_read;
   }
 
-  s_ds_rle_state.total_rle_size = rle_ctx->total_rle_size;
+  rle->state.total_rle_size = rle_ctx->total_rle_size;
 
   *rle_ctx = (sMemfaultRleCtx){0};
-  return s_ds_rle_state.total_rle_size;
+  return rle->state.total_rle_size;
 }
 
-MEMFAULT_WEAK
-bool memfault_data_source_rle_read_msg(uint32_t offset, void *buf, size_t buf_len) {
-  return prv_data_source_rle_read(offset, buf, buf_len);
-}
+static bool prv_data_source_rle_ctx_has_more_msgs(void *ctx, size_t *total_size_out) {
+  sMfltDataSourceRleCtx *rle = ctx;
 
-bool memfault_data_source_rle_has_more_msgs(size_t *total_size_out) {
   // Check to see if the data source has any messages queued up
-  const bool has_msgs = s_active_data_source->has_more_msgs_cb(&s_ds_rle_state.original_size);
+  const bool has_msgs = memfault_data_source_has_more_msgs(rle->active_source,
+                                                           &rle->state.original_size);
   if (!has_msgs) {
     return has_msgs;
   }
 
   // we have already computed what the RLE size will be for the data
   // saved in storage, no need to do it again
-  if (s_ds_rle_state.total_rle_size != 0) {
-    *total_size_out = s_ds_rle_state.total_rle_size;
+  if (rle->state.total_rle_size != 0) {
+    *total_size_out = rle->state.total_rle_size;
     return true;
   }
 
-  *total_size_out = prv_compute_rle_size();
+  *total_size_out = prv_compute_rle_size(rle);
   return true;
 }
 
+static bool prv_data_source_rle_ctx_read_msg(void *ctx, uint32_t offset, void *buf,
+                                             size_t buf_len) {
+  return prv_data_source_rle_read(ctx, offset, buf, buf_len);
+}
+
+static void prv_data_source_rle_ctx_mark_msg_read(void *ctx) {
+  sMfltDataSourceRleCtx *rle = ctx;
+  rle->state = (sMemfaultDataSourceRleState) { 0 };
+  memfault_data_source_mark_msg_read(rle->active_source);
+}
+
+MEMFAULT_WEAK
+bool memfault_data_source_rle_read_msg(uint32_t offset, void *buf, size_t buf_len) {
+  return prv_data_source_rle_read(&s_default_rle_ctx, offset, buf, buf_len);
+}
+
+bool memfault_data_source_rle_has_more_msgs(size_t *total_size_out) {
+  return prv_data_source_rle_ctx_has_more_msgs(&s_default_rle_ctx, total_size_out);
+}
+
 void memfault_data_source_rle_mark_msg_read(void) {
-  s_ds_rle_state = (sMemfaultDataSourceRleState) { 0 };
-  s_active_data_source->mark_msg_read_cb();
+  prv_data_source_rle_ctx_mark_msg_read(&s_default_rle_ctx);
 }
 
 //! Expose a data source for use by the Memfault Packetizer
@@ -28,70 +28,78 @@ void memfault_lock(void) { }
 MEMFAULT_WEAK
 void memfault_unlock(void) { }
 
-typedef struct {
-  bool write_in_progress;
-  size_t bytes_written;
-} sHeartbeatStorageWriteState;
-
-typedef struct {
-  size_t active_event_read_size;
-} sHeartbeatStorageReadState;
-
 #define MEMFAULT_EVENT_STORAGE_WRITE_IN_PROGRESS 0xffff
 
 typedef MEMFAULT_PACKED_STRUCT {
   uint16_t total_size;
 } sHeartbeatStorageHeader;
 
-static sMfltCircularBuffer s_event_storage;
-static sHeartbeatStorageWriteState s_event_storage_write_state;
-static sHeartbeatStorageReadState s_event_storage_read_state;
+//! The instance set up by memfault_events_storage_boot()
+static sMfltEventStorageCtx s_event_storage;
+
+// Only the default instance may be shared between the system and the packetizer task. Additional
+// instances are serialized by their owner so we don't contend on the global lock
+static void prv_lock(const sMfltEventStorageCtx *ctx) {
+  if (ctx->use_lock) {
+    memfault_lock();
+  }
+}
 
-static bool prv_has_event(size_t *total_size) {
+static void prv_unlock(const sMfltEventStorageCtx *ctx) {
+  if (ctx->use_lock) {
+    memfault_unlock();
+  }
+}
+
+static bool prv_has_event(void *ctx, size_t *total_size) {
+  sMfltEventStorageCtx *storage = ctx;
   sHeartbeatStorageHeader hdr = { 0 };
   bool success;
-  memfault_lock();
+  prv_lock(storage);
   {
-    success = memfault_circular_buffer_read(&s_event_storage, 0, &hdr, sizeof(hdr));
+    success = memfault_circular_buffer_read(&storage->buffer, 0, &hdr, sizeof(hdr));
   }
-  memfault_unlock();
+  prv_unlock(storage);
 
   if (!success || hdr.total_size == MEMFAULT_EVENT_STORAGE_WRITE_IN_PROGRESS) {
     *total_size = 0;
     return false;
   }
 
-  s_event_storage_read_state.active_event_read_size = hdr.total_size;
+  storage->read_state.active_event_read_size = hdr.total_size;
   *total_size = hdr.total_size - sizeof(hdr);
   return true;
 }
 
 
-static bool prv_event_storage_read(uint32_t offset, void *buf, size_t buf_len) {
+static bool prv_event_storage_read(void *ctx, uint32_t offset, void *buf, size_t buf_len) {
+  sMfltEventStorageCtx *storage = ctx;
   offset += sizeof(sHeartbeatStorageHeader);
-  if (offset >= s_event_storage_read_state.active_event_read_size) {
+  if (offset >= storage->read_state.active_event_read_size) {
     return false;
   }
 
-  return memfault_circular_buffer_read(&s_event_storage, offset, buf, buf_len);
+  return memfault_circular_buffer_read(&storage->buffer, offset, buf, buf_len);
 }
 
-static void prv_event_storage_mark_event_read(void) {
-  if (s_event_storage_read_state.active_event_read_size == 0) {
+static void prv_event_storage_mark_event_read(void *ctx) {
+  sMfltEventStorageCtx *storage = ctx;
+  if (storage->read_state.active_event_read_size == 0) {
     // no active event to clear
     return;
   }
-  memfault_lock();
+  prv_lock(storage);
   {
-    memfault_circular_buffer_consume(&s_event_storage, s_event_storage_read_state.active_event_read_size);
+    memfault_circular_buffer_consume(&storage->buffer, storage->read_state.active_event_read_size);
   }
-  memfault_unlock();
-  s_event_storage_read_state = (sHeartbeatStorageReadState) { 0 };
+  prv_unlock(storage);
+  storage->read_state = (sMfltEventStorageReadState) { 0 };
 }
 
 // "begin" to write a heartbeat & return the space available
-static size_t prv_event_storage_storage_begin_write(void) {
-  if (s_event_storage_write_state.write_in_progress) {
+static size_t prv_event_storage_storage_begin_write(void *ctx) {
+  sMfltEventStorageCtx *storage = ctx;
+  if (storage->write_state.write_in_progress) {
     return 0;
   }
 
@@ -99,85 +107,151 @@ static size_t prv_event_storage_storage_begin_write(void) {
     .total_size = MEMFAULT_EVENT_STORAGE_WRITE_IN_PROGRESS,
   };
   bool success;
-  memfault_lock();
+  prv_lock(storage);
   {
-    success = memfault_circular_buffer_write(&s_event_storage, &hdr, sizeof(hdr));
+    success = memfault_circular_buffer_write(&storage->buffer, &hdr, sizeof(hdr));
   }
-  memfault_unlock();
+  prv_unlock(storage);
   if (!success) {
     return 0;
   }
 
-  s_event_storage_write_state = (sHeartbeatStorageWriteState) {
+  storage->write_state = (sMfltEventStorageWriteState) {
     .write_in_progress = true,
     .bytes_written = sizeof(hdr),
   };
 
-  return memfault_circular_buffer_get_write_size(&s_event_storage);
+  return memfault_circular_buffer_get_write_size(&storage->buffer);
 }
 
-static bool prv_event_storage_storage_append_data(const void *bytes, size_t num_bytes) {
+static bool prv_event_storage_storage_append_data(void *ctx, const void *bytes,
+                                                  size_t num_bytes) {
+  sMfltEventStorageCtx *storage = ctx;
   bool success;
 
-  memfault_lock();
+  prv_lock(storage);
   {
-    success = memfault_circular_buffer_write(&s_event_storage, bytes, num_bytes);
+    success = memfault_circular_buffer_write(&storage->buffer, bytes, num_bytes);
   }
-  memfault_unlock();
+  prv_unlock(storage);
   if (success) {
-    s_event_storage_write_state.bytes_written += num_bytes;
+    storage->write_state.bytes_written += num_bytes;
   }
   return success;
 }
 
-static void prv_event_storage_storage_finish_write(bool rollback) {
-  if (!s_event_storage_write_state.write_in_progress) {
+static void prv_event_storage_storage_finish_write(void *ctx, bool rollback) {
+  sMfltEventStorageCtx *storage = ctx;
+  if (!storage->write_state.write_in_progress) {
     return;
   }
 
-  memfault_lock();
+  prv_lock(storage);
   {
     if (rollback) {
-      memfault_circular_buffer_consume_from_end(&s_event_storage,
-                                                s_event_storage_write_state.bytes_written);
+      memfault_circular_buffer_consume_from_end(&storage->buffer,
+                                                storage->write_state.bytes_written);
     } else {
       const sHeartbeatStorageHeader hdr = {
-        .total_size = (uint16_t)s_event_storage_write_state.bytes_written,
+        .total_size = (uint16_t)storage->write_state.bytes_written,
       };
-      memfault_circular_buffer_write_at_offset(&s_event_storage,
-                                               s_event_storage_write_state.bytes_written,
+      memfault_circular_buffer_write_at_offset(&storage->buffer,
+                                               storage->write_state.bytes_written,
                                                &hdr, sizeof(hdr));
     }
   }
-  memfault_unlock();
+  prv_unlock(storage);
 
   // reset the write state
-  s_event_storage_write_state = (sHeartbeatStorageWriteState) { 0 };
+  storage->write_state = (sMfltEventStorageWriteState) { 0 };
 }
 
-static size_t prv_get_size_cb(void) {
-  return memfault_circular_buffer_get_read_size(&s_event_storage) +
-      memfault_circular_buffer_get_write_size(&s_event_storage);
+static size_t prv_get_size_cb(void *ctx) {
+  sMfltEventStorageCtx *storage = ctx;
+  return memfault_circular_buffer_get_read_size(&storage->buffer) +
+      memfault_circular_buffer_get_write_size(&storage->buffer);
 }
 
-const sMemfaultEventStorageImpl *memfault_events_storage_boot(void *buf, size_t buf_len) {
-  memfault_circular_buffer_init(&s_event_storage, buf, buf_len);
+static const sMemfaultEventStorageImpl *prv_event_storage_init(sMfltEventStorageCtx *ctx,
+                                                               void *buf, size_t buf_len,
+                                                               bool use_lock) {
+  *ctx = (sMfltEventStorageCtx) {
+    .impl = {
+      .ctx_begin_write_cb = &prv_event_storage_storage_begin_write,
+      .ctx_append_data_cb = &prv_event_storage_storage_append_data,
+      .ctx_finish_write_cb = &prv_event_storage_storage_finish_write,
+      .ctx_get_storage_size_cb = &prv_get_size_cb,
+      .ctx = ctx,
+    },
+    .data_source = {
+      .ctx_has_more_msgs_cb = prv_has_event,
+      .ctx_read_msg_cb = prv_event_storage_read,
+      .ctx_mark_msg_read_cb = prv_event_storage_mark_event_read,
+      .ctx = ctx,
+    },
+    .use_lock = use_lock,
+  };
+  memfault_circular_buffer_init(&ctx->buffer, buf, buf_len);
+  return &ctx->impl;
+}
+
+const sMemfaultEventStorageImpl *memfault_events_storage_ctx_init(sMfltEventStorageCtx *ctx,
+                                                                  void *buf, size_t buf_len) {
+  return prv_event_storage_init(ctx, buf, buf_len, false);
+}
 
-  s_event_storage_write_state = (sHeartbeatStorageWriteState) { 0 };
-  s_event_storage_read_state = (sHeartbeatStorageReadState) { 0 };
+const sMemfaultDataSourceImpl *memfault_events_storage_ctx_get_data_source(
+    sMfltEventStorageCtx *ctx) {
+  return &ctx->data_source;
+}
+
+//
+// The default instance, accessed through callbacks which don't take a ctx
+//
+
+static size_t prv_default_begin_write(void) {
+  return prv_event_storage_storage_begin_write(&s_event_storage);
+}
+
+static bool prv_default_append_data(const void *bytes, size_t num_bytes) {
+  return prv_event_storage_storage_append_data(&s_event_storage, bytes, num_bytes);
+}
+
+static void prv_default_finish_write(bool rollback) {
+  prv_event_storage_storage_finish_write(&s_event_storage, rollback);
+}
+
+static size_t prv_default_get_size(void) {
+  return prv_get_size_cb(&s_event_storage);
+}
+
+static bool prv_default_has_event(size_t *total_size) {
+  return prv_has_event(&s_event_storage, total_size);
+}
+
+static bool prv_default_read(uint32_t offset, void *buf, size_t buf_len) {
+  return prv_event_storage_read(&s_event_storage, offset, buf, buf_len);
+}
+
+static void prv_default_mark_event_read(void) {
+  prv_event_storage_mark_event_read(&s_event_storage);
+}
+
+const sMemfaultEventStorageImpl *memfault_events_storage_boot(void *buf, size_t buf_len) {
+  prv_event_storage_init(&s_event_storage, buf, buf_len, true);
 
   static const sMemfaultEventStorageImpl s_event_storage_impl = {
-    .begin_write_cb = &prv_event_storage_storage_begin_write,
-    .append_data_cb = &prv_event_storage_storage_append_data,
-    .finish_write_cb = &prv_event_storage_storage_finish_write,
-    .get_storage_size_cb = &prv_get_size_cb,
+    .begin_write_cb = &prv_default_begin_write,
+    .append_data_cb = &prv_default_append_data,
+    .finish_write_cb = &prv_default_finish_write,
+    .get_storage_size_cb = &prv_default_get_size,
   };
   return &s_event_storage_impl;
 }
 
 //! Expose a data source for use by the Memfault Packetizer
 const sMemfaultDataSourceImpl g_memfault_event_data_source  = {
-  .has_more_msgs_cb = prv_has_event,
-  .read_msg_cb = prv_event_storage_read,
-  .mark_msg_read_cb = prv_event_storage_mark_event_read,
+  .has_more_msgs_cb = prv_default_has_event,
+  .read_msg_cb = prv_default_read,
+  .mark_msg_read_cb = prv_default_mark_event_read,
 };
@@ -20,7 +20,8 @@ static bool prv_encode_event_key_string_pair(
       memfault_cbor_encode_string(encoder, value);
 }
 
-static bool prv_encode_device_version_info(sMemfaultCborEncoder *e) {
+static bool prv_encode_device_version_info(sMemfaultCborEncoder *e,
+                                           const sMemfaultDeviceInfo *info) {
   // Encoding something like:
   //
   // "device_serial": "ABCD1234",
@@ -30,35 +31,39 @@ static bool prv_encode_device_version_info(sMemfaultCborEncoder *e) {
   //
   // NOTE: int keys are used instead of strings to minimize the wire payload.
 
-  sMemfaultDeviceInfo info = { 0 };
-  memfault_platform_get_device_info(&info);
-
-  if (!prv_encode_event_key_string_pair(e, kMemfaultEventKey_DeviceSerial, info.device_serial)) {
+  if (!prv_encode_event_key_string_pair(e, kMemfaultEventKey_DeviceSerial, info->device_serial)) {
     return false;
   }
 
-  if (!prv_encode_event_key_string_pair(e, kMemfaultEventKey_SoftwareType, info.software_type)) {
+  if (!prv_encode_event_key_string_pair(e, kMemfaultEventKey_SoftwareType, info->software_type)) {
     return false;
   }
 
-  if (!prv_encode_event_key_string_pair(e, kMemfaultEventKey_SoftwareVersion, info.software_version)) {
+  if (!prv_encode_event_key_string_pair(e, kMemfaultEventKey_SoftwareVersion, info->software_version)) {
     return false;
   }
 
-  if (!prv_encode_event_key_string_pair(e, kMemfaultEventKey_HardwareVersion, info.hardware_version)) {
+  if (!prv_encode_event_key_string_pair(e, kMemfaultEventKey_HardwareVersion, info->hardware_version)) {
     return false;
   }
 
   return true;
 }
 
-bool memfault_serializer_helper_encode_version_info(sMemfaultCborEncoder *encoder) {
+bool memfault_serializer_helper_encode_version_info_for_device(sMemfaultCborEncoder *encoder,
+                                                               const sMemfaultDeviceInfo *info) {
   if (!memfault_serializer_helper_encode_uint32_kv_pair(
           encoder, kMemfaultEventKey_CborSchemaVersion, MEMFAULT_CBOR_SCHEMA_VERSION_V1)) {
     return false;
   }
 
-  return prv_encode_device_version_info(encoder);
+  return prv_encode_device_version_info(encoder, info);
+}
+
+bool memfault_serializer_helper_encode_version_info(sMemfaultCborEncoder *encoder) {
+  sMemfaultDeviceInfo info = { 0 };
+  memfault_platform_get_device_info(&info);
+  return memfault_serializer_helper_encode_version_info_for_device(encoder, &info);
 }
 
 bool memfault_serializer_helper_encode_uint32_kv_pair(
@@ -119,15 +124,46 @@ typedef struct {
   const sMemfaultEventStorageImpl *storage_impl;
 } sMemfaultSerializerHelperEncoderCtx;
 
+static size_t prv_storage_begin_write(const sMemfaultEventStorageImpl *storage_impl) {
+  if (storage_impl->ctx_begin_write_cb != NULL) {
+    return storage_impl->ctx_begin_write_cb(storage_impl->ctx);
+  }
+  return storage_impl->begin_write_cb();
+}
+
+static bool prv_storage_append_data(const sMemfaultEventStorageImpl *storage_impl,
+                                    const void *bytes, size_t num_bytes) {
+  if (storage_impl->ctx_append_data_cb != NULL) {
+    return storage_impl->ctx_append_data_cb(storage_impl->ctx, bytes, num_bytes);
+  }
+  return storage_impl->append_data_cb(bytes, num_bytes);
+}
+
+static void prv_storage_finish_write(const sMemfaultEventStorageImpl *storage_impl,
+                                     bool rollback) {
+  if (storage_impl->ctx_finish_write_cb != NULL) {
+    storage_impl->ctx_finish_write_cb(storage_impl->ctx, rollback);
+    return;
+  }
+  storage_impl->finish_write_cb(rollback);
+}
+
+size_t memfault_serializer_helper_get_storage_size(const sMemfaultEventStorageImpl *storage_impl) {
+  if (storage_impl->ctx_get_storage_size_cb != NULL) {
+    return storage_impl->ctx_get_storage_size_cb(storage_impl->ctx);
+  }
+  return storage_impl->get_storage_size_cb();
+}
+
 static void prv_encoder_write_cb(void *ctx, uint32_t offset, const void *buf, size_t buf_len) {
   const sMemfaultEventStorageImpl *storage_impl = ((sMemfaultSerializerHelperEncoderCtx *) ctx)->storage_impl;
-  storage_impl->append_data_cb(buf, buf_len);
+  prv_storage_append_data(storage_impl, buf, buf_len);
 }
 
 bool memfault_serializer_helper_encode_to_storage(sMemfaultCborEncoder *encoder,
     const sMemfaultEventStorageImpl *storage_impl,
     MemfaultSerializerHelperEncodeCallback encode_callback, void *ctx) {
-  const size_t space_available = storage_impl->begin_write_cb();
+  const size_t space_available = prv_storage_begin_write(storage_impl);
   bool success;
   {
     sMemfaultSerializerHelperEncoderCtx encoder_ctx = {
@@ -138,7 +174,7 @@ bool memfault_serializer_helper_encode_to_storage(sMemfaultCborEncoder *encoder,
     memfault_cbor_encoder_deinit(encoder);
   }
   const bool rollback = !success;
-  storage_impl->finish_write_cb(rollback);
+  prv_storage_finish_write(storage_impl, rollback);
   return success;
 }
 
@@ -153,7 +189,7 @@ bool memfault_serializer_helper_check_storage_size(
     const sMemfaultEventStorageImpl *storage_impl, size_t (compute_worst_case_size)(void), const char *event_type) {
   // Check to see if the backing storage can hold at least one event
   // and return an error code in this situation so it's easier for an end user to catch it:
-  const size_t storage_max_size = storage_impl->get_storage_size_cb();
+  const size_t storage_max_size = memfault_serializer_helper_get_storage_size(storage_impl);
   const size_t worst_case_size_needed = compute_worst_case_size();
   if (worst_case_size_needed > storage_max_size) {
     MEMFAULT_LOG_WARN("Event storage (%d) smaller than largest %s event (%d)",
@@ -0,0 +1,161 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! A non-blocking, event driven state machine for posting Memfault data to the chunks endpoint.
+//!
+//! The state machine never blocks or polls. The connection is managed through a small set of
+//! non-blocking transport operations (see sMfltHttpAsyncUploadTransport) and the application's
+//! event loop drives progress by reporting when the connection is established, writable or
+//! readable or when a timeout expires. This way uploads can run from an existing event loop
+//! without a dedicated thread.
+//!
+//! A typical integration looks like:
+//!
+//!   memfault_http_async_upload_start(&s_upload, &cfg);
+//!   ... then, from the event loop:
+//!   - connection established/failed -> memfault_http_async_upload_on_connected()
+//!   - socket writable && memfault_http_async_upload_wants_write() ->
+//!       memfault_http_async_upload_on_writable()
+//!   - socket readable && memfault_http_async_upload_wants_read() ->
+//!       memfault_http_async_upload_on_readable()
+//!   - no progress for a while -> memfault_http_async_upload_on_timeout()
+//!
+//! Backpressure from the transport is honored: when send() can't accept more data, the state
+//! machine waits for the next writable event before pulling more data from the packetizer.
+//! Messages are posted one after another on the same connection until the packetizer is drained.
+//! If the server closes the connection after a response, a new one is opened for the next message.
+//! A message is only deleted from the packetizer once its response has been received (see
+//! sPacketizerConfig.enable_delivery_confirmation) so it isn't lost if the upload fails before.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memfault/http/response_parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Size of the buffer used to stage the request headers and packetizer output. It must be large
+//! enough to hold the request line and all the headers
+#ifndef MEMFAULT_HTTP_ASYNC_UPLOAD_TX_BUF_SIZE
+#define MEMFAULT_HTTP_ASYNC_UPLOAD_TX_BUF_SIZE 256
+#endif
+
+typedef enum MfltHttpAsyncUploadResult {
+  kMfltHttpAsyncUploadResult_Success = 0,
+  kMfltHttpAsyncUploadResult_ConnectError = -1,
+  kMfltHttpAsyncUploadResult_SendError = -2,
+  kMfltHttpAsyncUploadResult_RecvError = -3,
+  kMfltHttpAsyncUploadResult_Timeout = -4,
+  kMfltHttpAsyncUploadResult_ParseError = -5,
+  //! The server responded with a status other than 2xx
+  kMfltHttpAsyncUploadResult_HttpError = -6,
+} eMfltHttpAsyncUploadResult;
+
+//! Non-blocking operations used to talk to the server
+typedef struct MfltHttpAsyncUploadTransport {
+  //! Starts connecting to MEMFAULT_HTTP_GET_API_HOST() / MEMFAULT_HTTP_GET_API_PORT(). The
+  //! outcome is reported later on with memfault_http_async_upload_on_connected()
+  //!
+  //! @return 0 if the connection attempt was started, else error code
+  int (*connect)(void *ctx);
+  //! @return The number of bytes accepted, 0 if no more data can be accepted right now or a
+  //!   negative value on error
+  int (*send)(void *ctx, const void *data, size_t data_len);
+  //! @return The number of bytes read, 0 if no data is available right now or a negative value
+  //!   on error (including the connection being closed by the server)
+  int (*recv)(void *ctx, void *buf, size_t buf_len);
+  //! Closes the connection
+  void (*close)(void *ctx);
+} sMfltHttpAsyncUploadTransport;
+
+typedef struct MfltHttpAsyncUpload sMfltHttpAsyncUpload;
+
+//! Invoked once the upload has completed
+//!
+//! @param upload The upload which completed
+//! @param result kMfltHttpAsyncUploadResult_Success if all the data was posted, else the reason
+//!   the upload was stopped
+//! @param ctx The 'complete_ctx' provided in the upload configuration
+typedef void (*MfltHttpAsyncUploadCompleteCb)(sMfltHttpAsyncUpload *upload,
+                                              eMfltHttpAsyncUploadResult result, void *ctx);
+
+typedef struct MfltHttpAsyncUploadConfig {
+  const sMfltHttpAsyncUploadTransport *transport;
+  //! Passed to all the 'transport' operations
+  void *transport_ctx;
+  MfltHttpAsyncUploadCompleteCb complete_cb;
+  void *complete_ctx;
+} sMfltHttpAsyncUploadConfig;
+
+typedef enum MfltHttpAsyncUploadState {
+  kMfltHttpAsyncUploadState_Idle = 0,
+  kMfltHttpAsyncUploadState_Connecting,
+  kMfltHttpAsyncUploadState_SendingRequest,
+  kMfltHttpAsyncUploadState_AwaitingResponse,
+} eMfltHttpAsyncUploadState;
+
+struct MfltHttpAsyncUpload {
+  //! The HTTP status code of the last response received
+  int http_status_code;
+  //! The number of chunk posts which were accepted by the server
+  size_t num_posts;
+
+  // For internal use only
+  eMfltHttpAsyncUploadState state;
+  sMfltHttpAsyncUploadConfig cfg;
+  bool msg_fully_staged;
+  size_t tx_len;
+  size_t tx_offset;
+  uint8_t tx_buf[MEMFAULT_HTTP_ASYNC_UPLOAD_TX_BUF_SIZE];
+  sMfltHttpResponseParser rsp_parser;
+};
+
+//! Starts posting the data queued in the packetizer
+//!
+//! @param upload The upload context. It must be zero initialized before it is used for the first
+//!   time and remain valid until the upload completes. It can then be reused for the next upload.
+//! @param cfg The configuration of the upload
+//!
+//! @note The outcome of every upload is reported to the retry policy (see retry_policy.h)
+//! @return 0 if the upload was started, kMfltPostDataStatus_NoDataFound if there is no data to
+//!   send, kMfltPostDataStatus_RetryLater if a previous upload failed and the retry delay hasn't
+//!   elapsed yet, else a negative error code
+int memfault_http_async_upload_start(sMfltHttpAsyncUpload *upload,
+                                     const sMfltHttpAsyncUploadConfig *cfg);
+
+//! To be called when the connection attempt started by 'connect' has completed
+//!
+//! @param result 0 if the connection was established, else error code
+void memfault_http_async_upload_on_connected(sMfltHttpAsyncUpload *upload, int result);
+
+//! To be called when the connection can accept more data
+void memfault_http_async_upload_on_writable(sMfltHttpAsyncUpload *upload);
+
+//! To be called when data is available to be read from the connection
+void memfault_http_async_upload_on_readable(sMfltHttpAsyncUpload *upload);
+
+//! To be called when the upload has not made progress for longer than the application allows.
+//! Messages are only deleted from the packetizer once the server has responded with a 2xx (or with
+//! an error which isn't worth retrying), so the message in flight is sent again by the next upload.
+void memfault_http_async_upload_on_timeout(sMfltHttpAsyncUpload *upload);
+
+//! @return true if the upload is waiting for the connection to become writable
+bool memfault_http_async_upload_wants_write(const sMfltHttpAsyncUpload *upload);
+
+//! @return true if the upload is waiting for a response from the server
+bool memfault_http_async_upload_wants_read(const sMfltHttpAsyncUpload *upload);
+
+//! @return true if an upload is in progress
+bool memfault_http_async_upload_in_progress(const sMfltHttpAsyncUpload *upload);
+
+#ifdef __cplusplus
+}
+#endif
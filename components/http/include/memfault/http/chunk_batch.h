@@ -0,0 +1,113 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Utilities for packing multiple chunks into the body of a single POST to the Memfault chunks
+//! endpoint.
+//!
+//! When a device has lots of small messages queued up (i.e events and heartbeats), posting one
+//! chunk per request means most of the time is spent on HTTP headers and round trips. Instead,
+//! the chunks are packed into a "multipart/mixed" body (RFC 2046), the format the chunks endpoint
+//! accepts for uploading several chunks in a single request. Each chunk is a part of its own:
+//!
+//!   --<boundary>\r\n
+//!   Content-Type:application/octet-stream\r\n
+//!   \r\n
+//!   <chunk>\r\n
+//!   ... one such part per chunk ...
+//!   --<boundary>--\r\n
+//!
+//! The body is posted with memfault_http_start_chunk_batch_post() and the response is checked
+//! once for the whole batch. A chunk must not contain the delimiter which ends its part ("\r\n--"
+//! followed by the boundary), which is why MEMFAULT_HTTP_CHUNK_BATCH_BOUNDARY is long and random.
+//!
+//! @note Each message is deleted from its data source as soon as its last chunk has been packed
+//!   into a batch: the packetizer can only hold back the deletion of a single message (see
+//!   sPacketizerConfig.enable_delivery_confirmation). A batch which is rejected or lost with the
+//!   connection is therefore not sent again, so only use batches with a transport which keeps
+//!   retrying the same body until the server has accepted it.
+//!
+//! @note The feature is experimental and disabled by default. Enable it by adding
+//!   MEMFAULT_HTTP_CHUNK_BATCH_ENABLED=1 as a define to your build system.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "memfault/core/compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MEMFAULT_HTTP_CHUNK_BATCH_ENABLED
+#define MEMFAULT_HTTP_CHUNK_BATCH_ENABLED 0
+#endif
+
+#define MEMFAULT_HTTP_CHUNK_BATCH_BOUNDARY "MemfaultChunkBatch-5f2b8e1c9a4d7306"
+#define MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE \
+  "multipart/mixed; boundary=" MEMFAULT_HTTP_CHUNK_BATCH_BOUNDARY
+
+//! The framing of a batch: every chunk is preceded by the header of its part and followed by the
+//! end of its line, and the body is closed by the close delimiter
+#define MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER \
+  "--" MEMFAULT_HTTP_CHUNK_BATCH_BOUNDARY "\r\nContent-Type:application/octet-stream\r\n\r\n"
+#define MEMFAULT_HTTP_CHUNK_BATCH_PART_END "\r\n"
+#define MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER "--" MEMFAULT_HTTP_CHUNK_BATCH_BOUNDARY "--\r\n"
+
+//! The bytes a batch takes on top of the chunks it holds
+#define MEMFAULT_HTTP_CHUNK_BATCH_PART_OVERHEAD \
+  (MEMFAULT_STATIC_STRLEN(MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER) + \
+   MEMFAULT_STATIC_STRLEN(MEMFAULT_HTTP_CHUNK_BATCH_PART_END))
+#define MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN \
+  MEMFAULT_STATIC_STRLEN(MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER)
+
+//! The "Content-Encoding" of a batch compressed with memfault_http_chunk_batch_compress()
+#define MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_ENCODING "deflate"
+
+typedef struct MfltHttpChunkBatch {
+  //! The number of bytes of the buffer which make up the body of the request
+  size_t body_len;
+  //! The number of chunks packed into the body
+  size_t num_chunks;
+} sMfltHttpChunkBatch;
+
+//! Drains chunks from the packetizer into a buffer until it is full or there is no more data
+//!
+//! Messages which do not fit in the remaining space are split across several chunks by the
+//! packetizer, as usual, and the remainder is picked up by the next batch.
+//!
+//! @param buf The buffer to fill. Its size is the budget for the body of the request.
+//! @param buf_len The size of 'buf'
+//! @param[out] batch_out Populated with information about the batch built
+//!
+//! @return true if at least one chunk was packed into the buffer, false if there was no data to
+//!   send (or the buffer is too small to hold a chunk)
+bool memfault_http_chunk_batch_build(void *buf, size_t buf_len, sMfltHttpChunkBatch *batch_out);
+
+//! Compresses the body of a batch so it can be posted with
+//! memfault_http_start_compressed_chunk_batch_post()
+//!
+//! The body is encoded with the encoder from memfault/util/deflate.h. Small batches or batches of
+//! data which doesn't compress (i.e coredumps which were already run length encoded) are better
+//! sent as is, so the caller should fall back to posting the original body when this returns
+//! false.
+//!
+//! @note The encoder state (see sMemfaultDeflateEncoder) is held in a static variable so this
+//!   function is not reentrant.
+//! @param body The body built by memfault_http_chunk_batch_build()
+//! @param body_len The length of the body, sMfltHttpChunkBatch.body_len
+//! @param out_buf The buffer to write the compressed body to. Must not overlap with 'body'
+//! @param out_buf_len The size of 'out_buf'
+//! @param[out] out_len Populated with the length of the compressed body on success
+//!
+//! @return true if the body was compressed into a smaller size, false otherwise
+bool memfault_http_chunk_batch_compress(const void *body, size_t body_len, void *out_buf,
+                                        size_t out_buf_len, size_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
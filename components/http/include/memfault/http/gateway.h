@@ -0,0 +1,167 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! A store for gateways which forward the chunks of downstream devices (i.e BLE sensor nodes
+//! draining their data with memfault_packetizer_get_chunk()) to Memfault.
+//!
+//! Chunks are queued per device, tagged by device serial, in a bounded FIFO carved out of a
+//! buffer provided by the application. Rather than posting every chunk on its own, the queued
+//! chunks of a device are packed, in the order they were received, into a multipart/mixed batch
+//! (see memfault/http/chunk_batch.h). Each batch is posted to the chunks endpoint of its device,
+//! /api/v0/chunks/<device_serial>, with memfault_http_start_device_chunk_batch_post(). A gateway
+//! is expected to post the batches of all its devices one after another on the same persistent
+//! connection.
+//!
+//! Devices are scheduled round robin, one batch at a time, so a device with a deep backlog can't
+//! starve the others.
+//!
+//! Chunks stay queued until the upload is acknowledged with memfault_gateway_batch_complete() so
+//! a failed upload is simply retried with the next batch.
+//!
+//! @note The store does not take any locks. When chunks are added from a different thread than
+//!   the one uploading the batches, the caller must serialize the calls (see the POSIX port's
+//!   memfault/posix_port/gateway.h for an example).
+//!
+//! @note The feature is experimental and disabled by default. Enable it by adding
+//!   MEMFAULT_HTTP_GATEWAY_ENABLED=1 as a define to your build system.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memfault/util/circular_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MEMFAULT_HTTP_GATEWAY_ENABLED
+#define MEMFAULT_HTTP_GATEWAY_ENABLED 0
+#endif
+
+//! The longest device serial which can be tracked, excluding the NUL terminator
+#ifndef MEMFAULT_GATEWAY_MAX_DEVICE_SERIAL_LEN
+#define MEMFAULT_GATEWAY_MAX_DEVICE_SERIAL_LEN 32
+#endif
+
+//! Each chunk is queued with a 2 byte length prefix
+#define MEMFAULT_GATEWAY_CHUNK_OVERHEAD 2
+
+typedef enum MfltGatewayError {
+  kMfltGatewayError_InvalidInput = -1,
+  //! All device slots are tracking other devices which still have chunks queued
+  kMfltGatewayError_NoDeviceSlot = -2,
+  //! The queue of the device doesn't have room for the chunk. The caller should hold off pulling
+  //! chunks from the device until a batch has been delivered.
+  kMfltGatewayError_QueueFull = -3,
+  //! The chunk, along with the framing of a batch, is larger than the max_body_len the store was
+  //! initialized with so it could never be sent
+  kMfltGatewayError_ChunkTooLarge = -4,
+} eMfltGatewayError;
+
+typedef struct {
+  //! Chunks queued with memfault_gateway_add_chunk()
+  uint32_t num_chunks_received;
+  //! Chunks rejected because the queue of the device was full or they were too large
+  uint32_t num_chunks_rejected;
+  //! Chunks which were part of a delivered batch
+  uint32_t num_chunks_forwarded;
+} sMfltGatewayDeviceStats;
+
+//! @note The contents are private to the implementation
+typedef struct {
+  bool in_use;
+  char device_serial[MEMFAULT_GATEWAY_MAX_DEVICE_SERIAL_LEN + 1];
+  sMfltCircularBuffer queue;
+  size_t num_chunks;
+  //! The chunks and bytes from the start of the queue which are part of the batch in flight
+  size_t batch_num_chunks;
+  size_t batch_queue_bytes;
+  sMfltGatewayDeviceStats stats;
+} sMfltGatewayDevice;
+
+//! @note The contents are private to the implementation
+typedef struct {
+  sMfltGatewayDevice *devices;
+  size_t max_devices;
+  size_t max_body_len;
+  //! Index of the device which is considered first for the next batch
+  size_t next_device;
+  //! The device of the batch in flight, NULL if there is none
+  sMfltGatewayDevice *batch_device;
+} sMfltGateway;
+
+typedef struct {
+  //! The number of bytes of the buffer which make up the body of the request
+  size_t body_len;
+  //! The number of chunks packed into the body
+  size_t num_chunks;
+  //! The serial of the device the chunks belong to, the batch must be posted to its chunks
+  //! endpoint. Valid until memfault_gateway_batch_complete() is called.
+  const char *device_serial;
+} sMfltGatewayBatch;
+
+//! Initializes the store
+//!
+//! @param gateway The store to initialize
+//! @param devices Slots to track devices in, one per device with chunks queued at a time
+//! @param max_devices The number of entries in 'devices'
+//! @param storage Backing storage for the queues, split evenly between the device slots. Each
+//!   queued chunk takes MEMFAULT_GATEWAY_CHUNK_OVERHEAD bytes on top of its length.
+//! @param storage_len The size of 'storage'
+//! @param max_body_len The size of the buffer batches will be built in. Chunks which wouldn't fit
+//!   in it on their own are rejected when they are added.
+//!
+//! @return true on success, false if the arguments are invalid
+bool memfault_gateway_init(sMfltGateway *gateway, sMfltGatewayDevice *devices,
+                           size_t max_devices, void *storage, size_t storage_len,
+                           size_t max_body_len);
+
+//! Queues a chunk received from a downstream device
+//!
+//! A device is assigned a slot the first time one of its chunks is added. Slots of devices with
+//! nothing left to send are handed over to new devices as needed.
+//!
+//! @param device_serial The serial of the device the chunk was produced by
+//! @param chunk The chunk, as returned by memfault_packetizer_get_chunk() on the device
+//! @param chunk_len The length of the chunk
+//!
+//! @return 0 if the chunk was queued, else an eMfltGatewayError
+int memfault_gateway_add_chunk(sMfltGateway *gateway, const char *device_serial,
+                               const void *chunk, size_t chunk_len);
+
+//! Packs as many queued chunks of the next device as fit into the body of a request
+//!
+//! The chunks remain queued until memfault_gateway_batch_complete() is called. Only one batch
+//! can be in flight at a time.
+//!
+//! @param buf The buffer to fill
+//! @param buf_len The size of 'buf'. At most max_body_len bytes of it are used for the body.
+//! @param[out] batch_out Populated with information about the batch built
+//!
+//! @return true if at least one chunk was packed into the buffer, false if there is nothing to
+//!   send, a batch is already in flight or 'buf_len' is smaller than max_body_len
+bool memfault_gateway_batch_build(sMfltGateway *gateway, void *buf, size_t buf_len,
+                                  sMfltGatewayBatch *batch_out);
+
+//! Completes the batch in flight
+//!
+//! @param delivered true if the server accepted the batch, in which case its chunks are removed
+//!   from the queues. Otherwise the chunks are kept and sent as part of the next batch.
+void memfault_gateway_batch_complete(sMfltGateway *gateway, bool delivered);
+
+//! @return the number of chunks queued across all devices, including the batch in flight
+size_t memfault_gateway_get_num_queued_chunks(const sMfltGateway *gateway);
+
+//! @return true and populates 'stats_out' if the device is tracked by the store
+bool memfault_gateway_get_device_stats(const sMfltGateway *gateway, const char *device_serial,
+                                       sMfltGatewayDeviceStats *stats_out);
+
+#ifdef __cplusplus
+}
+#endif
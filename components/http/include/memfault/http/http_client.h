@@ -72,12 +72,15 @@ sMfltHttpClient *memfault_http_client_create(void);
 typedef enum {
   kMfltPostDataStatus_Success = 0,
   kMfltPostDataStatus_NoDataFound = 1,
+  //! A previous upload failed and the retry delay has not elapsed yet (see retry_policy.h)
+  kMfltPostDataStatus_RetryLater = 2,
 } eMfltPostDataStatus;
 
 //! Posts Memfault data that is pending transmission to Memfault's services over HTTP.
 //!
 //! @return kMfltPostDataStatus_Success on success, kMfltPostDataStatus_NoDataFound
-//! if no data was found or else an error code.
+//! if no data was found, kMfltPostDataStatus_RetryLater if the upload is being held off after a
+//! failure or else an error code.
 int memfault_http_client_post_data(sMfltHttpClient *client);
 
 //! Waits until pending requests have been completed.
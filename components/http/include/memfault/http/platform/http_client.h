@@ -40,6 +40,15 @@ typedef void (*MemfaultHttpClientResponseCallback)(const sMfltHttpResponse *resp
 //! @return 0 on success, else error code
 int memfault_platform_http_response_get_status(const sMfltHttpResponse *response, uint32_t *status_out);
 
+//! Get the value of the "Retry-After" header of a response object.
+//! @param response The response object. Guaranteed to be non-NULL.
+//! @param[out] retry_after_s_out Pointer to variable to which to write the delay in seconds.
+//! @return 0 on success, else error code (i.e the response has no "Retry-After" header)
+//! @note A weak version of this API which always returns an error is defined in
+//! memfault_http_client.c.
+int memfault_platform_http_response_get_retry_after(const sMfltHttpResponse *response,
+                                                    uint32_t *retry_after_s_out);
+
 //! Posts data that is pending transmission to Memfault's services over HTTPS to the API path defined by
 //! MEMFAULT_HTTP_API_CHUNKS_SUBPATH. The implementation is expected to set the project key header (see
 //! MEMFAULT_HTTP_PROJECT_KEY_HEADER) as well as the "Content-Type: application/octet-stream" header.
@@ -0,0 +1,90 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! An incremental HTTP/1.x response parser for clients which keep connections alive.
+//!
+//! Compared to memfault_http_parse_response() (see utils.h), this parser:
+//!  - Scans for line delimiters a machine word at a time rather than byte by byte
+//!  - Understands "Transfer-Encoding: chunked" bodies as well as "Content-Length"
+//!  - Reports whether the server will keep the connection open ("Connection" header)
+//!  - Skips response bodies without copying them, so they can be of any length
+//!  - Only keeps header lines it cares about. Other header lines can be of any length.
+//!  - Reports exactly how many bytes belong to each response so back-to-back responses to
+//!    pipelined requests can be parsed from the same buffer
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memfault/http/utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Size of the buffer used to hold the status line and the headers of interest
+#ifndef MEMFAULT_HTTP_RESPONSE_PARSER_LINE_BUF_SIZE
+#define MEMFAULT_HTTP_RESPONSE_PARSER_LINE_BUF_SIZE 64
+#endif
+
+typedef enum MfltHttpResponseParserPhase {
+  kMfltHttpResponseParserPhase_StatusLine = 0,
+  kMfltHttpResponseParserPhase_Header,
+  kMfltHttpResponseParserPhase_Body,
+  kMfltHttpResponseParserPhase_ChunkSize,
+  kMfltHttpResponseParserPhase_ChunkData,
+  kMfltHttpResponseParserPhase_ChunkDataEnd,
+  kMfltHttpResponseParserPhase_Trailer,
+  kMfltHttpResponseParserPhase_Done,
+} eMfltHttpResponseParserPhase;
+
+typedef struct MfltHttpResponseParser {
+  //! Set to a value other than kMfltHttpParseStatus_Ok if the response was malformed. The
+  //! connection can not be reused in that case.
+  eMfltHttpParseStatus parse_error;
+  //! The status code from the "Status-Line"
+  int http_status_code;
+  //! true if the server will keep the connection open after this response
+  bool keep_alive;
+  //! true if the body was sent with "Transfer-Encoding: chunked"
+  bool chunked;
+  //! The value of the "Retry-After" header in seconds or 0 if there was none
+  uint32_t retry_after_s;
+  //! The number of body bytes received (excluding any chunked transfer coding framing)
+  size_t body_len;
+
+  // For internal use only
+  eMfltHttpResponseParserPhase phase;
+  bool has_content_length;
+  size_t remaining;
+  size_t line_len;
+  char line_buf[MEMFAULT_HTTP_RESPONSE_PARSER_LINE_BUF_SIZE];
+} sMfltHttpResponseParser;
+
+//! Prepares the parser for a new response
+void memfault_http_response_parser_reset(sMfltHttpResponseParser *parser);
+
+//! Feeds data received from the server into the parser
+//!
+//! Parsing stops at the end of a response. Any bytes left over are the start of the next response
+//! on the connection. They can be fed right back in: once a response is complete, the next call
+//! to this function resets the parser automatically.
+//!
+//! @param parser The parser, it must have been reset before the first response is parsed
+//! @param data The data to parse
+//! @param data_len The length of the data to parse
+//! @param[out] bytes_consumed The number of bytes from 'data' which belong to the current response
+//!
+//! @return true if the response is complete (or malformed, see 'parse_error'), false if more data
+//!   is needed
+bool memfault_http_response_parser_feed(sMfltHttpResponseParser *parser, const void *data,
+                                        size_t data_len, size_t *bytes_consumed);
+
+#ifdef __cplusplus
+}
+#endif
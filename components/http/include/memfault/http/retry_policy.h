@@ -0,0 +1,104 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Retry policy for uploads to Memfault's services.
+//!
+//! When an upload fails with a transient error (a network error, "408 Request Timeout",
+//! "429 Too Many Requests" or a 5xx status), the next attempt is delayed using exponential backoff
+//! with "full jitter": the delay is picked at random between 0 and
+//! MIN(MEMFAULT_HTTP_RETRY_MAX_DELAY_MS, MEMFAULT_HTTP_RETRY_BASE_DELAY_MS * 2^attempt). This way
+//! a fleet of devices which lost connectivity at the same time doesn't hammer the server in
+//! lockstep once it comes back. If the server provided a "Retry-After" header, the next attempt is
+//! delayed by at least that amount.
+//!
+//! After MEMFAULT_HTTP_RETRY_MAX_ATTEMPTS consecutive failures, the policy gives up and the next
+//! attempt is pushed out by MEMFAULT_HTTP_RETRY_MAX_DELAY_MS.
+//!
+//! Delays are measured with memfault_platform_get_time_since_boot_ms(). On a platform where it
+//! always returns 0, failed attempts are still counted but the delays are not enforced.
+//!
+//! The state can optionally be kept in a region of RAM which is not initialized on boot (see
+//! memfault_http_retry_policy_boot()) so a device which reboots doesn't start retrying from
+//! scratch.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! The delay of the first retry before jitter is applied
+#ifndef MEMFAULT_HTTP_RETRY_BASE_DELAY_MS
+#define MEMFAULT_HTTP_RETRY_BASE_DELAY_MS (5 * 1000)
+#endif
+
+//! The longest delay between two attempts, before any "Retry-After" is taken into account
+#ifndef MEMFAULT_HTTP_RETRY_MAX_DELAY_MS
+#define MEMFAULT_HTTP_RETRY_MAX_DELAY_MS (60 * 60 * 1000)
+#endif
+
+//! The number of consecutive failed attempts after which the policy gives up
+#ifndef MEMFAULT_HTTP_RETRY_MAX_ATTEMPTS
+#define MEMFAULT_HTTP_RETRY_MAX_ATTEMPTS 10
+#endif
+
+//! The longest "Retry-After" delay that will be honored
+#ifndef MEMFAULT_HTTP_RETRY_AFTER_MAX_S
+#define MEMFAULT_HTTP_RETRY_AFTER_MAX_S (24 * 60 * 60)
+#endif
+
+#define MEMFAULT_HTTP_RETRY_STATE_REGION_SIZE 16
+
+//! Sets the memory region used to keep the retry state across reboots.
+//!
+//! @note This region should _not_ be initialized by your bootloader or application. See
+//!   memfault_reboot_tracking_boot() for how this can be achieved with GCC.
+//! @note Since the time which elapsed while the device was rebooting is not known, the delay which
+//!   was remaining when the device reset is applied again from boot.
+//! @note Calling this function is optional. When it is not called, the state is kept in RAM and
+//!   lost on reboot.
+//! @param start_addr The location of the region. The size of the region should be
+//!   MEMFAULT_HTTP_RETRY_STATE_REGION_SIZE
+void memfault_http_retry_policy_boot(void *start_addr);
+
+//! @return true if a request which failed with the given HTTP status is worth retrying. A status
+//!   of 0 is used for requests which failed without receiving a response.
+bool memfault_http_retry_policy_is_retryable_status(uint32_t http_status);
+
+//! @return true if the backoff delay has elapsed and an upload can be attempted
+bool memfault_http_retry_policy_upload_allowed(void);
+
+//! @return the time until the next upload attempt is allowed, in milliseconds
+uint32_t memfault_http_retry_policy_get_delay_ms(void);
+
+//! @return the number of consecutive failed attempts
+size_t memfault_http_retry_policy_get_attempt_count(void);
+
+//! To be called when an upload succeeds. Clears the backoff.
+void memfault_http_retry_policy_record_success(void);
+
+//! To be called when an upload fails.
+//!
+//! @param http_status The HTTP status of the response or 0 if no response was received
+//! @param retry_after_s The value of the "Retry-After" header in seconds or 0 if there was none
+//! @return true if the upload should be retried once memfault_http_retry_policy_upload_allowed()
+//!   returns true, false if the error is not transient or the maximum number of attempts has been
+//!   reached
+bool memfault_http_retry_policy_record_failure(uint32_t http_status, uint32_t retry_after_s);
+
+//! @return a random number used to pick the backoff delay
+//!
+//! @note By default this function is defined as a weak symbol which uses a pseudo-random
+//!   generator seeded from the device serial. Platforms with a hardware RNG can override it.
+uint32_t memfault_platform_http_retry_get_random(void);
+
+#ifdef __cplusplus
+}
+#endif
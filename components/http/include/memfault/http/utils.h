@@ -44,11 +44,65 @@ typedef bool(*MfltHttpClientSendCb)(const void *data, size_t data_len, void *ctx
 bool memfault_http_start_chunk_post(
     MfltHttpClientSendCb callback, void *ctx, size_t content_body_length);
 
+//! Builds the HTTP 'Request-Line' and Headers for a POST to the Memfault Chunk Endpoint where the
+//! body is a multipart/mixed batch of chunks built with memfault_http_chunk_batch_build()
+//!
+//! @note Experimental, only available when MEMFAULT_HTTP_CHUNK_BATCH_ENABLED=1
+//!
+//! @param callback The callback invoked to send post request data.
+//! @param ctx A user specific context that gets passed to 'callback' invocations.
+//! @param content_body_length The length of the batch, sMfltHttpChunkBatch.body_len
+//!
+//! @return true if the post was successful, false otherwise
+bool memfault_http_start_chunk_batch_post(
+    MfltHttpClientSendCb callback, void *ctx, size_t content_body_length);
+
+//! Same as memfault_http_start_chunk_batch_post() but for a batch which was compressed with
+//! memfault_http_chunk_batch_compress(). The request carries a "Content-Encoding: deflate" header.
+//!
+//! @param callback The callback invoked to send post request data.
+//! @param ctx A user specific context that gets passed to 'callback' invocations.
+//! @param content_body_length The length of the compressed batch
+//!
+//! @return true if the post was successful, false otherwise
+bool memfault_http_start_compressed_chunk_batch_post(
+    MfltHttpClientSendCb callback, void *ctx, size_t content_body_length);
+
+//! Same as memfault_http_start_chunk_batch_post() but the batch holds the chunks of a downstream
+//! device, built with memfault_gateway_batch_build(), and is posted to the chunks endpoint of
+//! that device
+//!
+//! @note Experimental, only available when MEMFAULT_HTTP_GATEWAY_ENABLED=1
+//!
+//! @param callback The callback invoked to send post request data.
+//! @param ctx A user specific context that gets passed to 'callback' invocations.
+//! @param device_serial The serial of the device, sMfltGatewayBatch.device_serial
+//! @param content_body_length The length of the batch, sMfltGatewayBatch.body_len
+//!
+//! @return true if the post was successful, false otherwise
+bool memfault_http_start_device_chunk_batch_post(
+    MfltHttpClientSendCb callback, void *ctx, const char *device_serial,
+    size_t content_body_length);
+
+//! Same as memfault_http_start_device_chunk_batch_post() but for a batch which was compressed
+//! with memfault_http_chunk_batch_compress()
+//!
+//! @param callback The callback invoked to send post request data.
+//! @param ctx A user specific context that gets passed to 'callback' invocations.
+//! @param device_serial The serial of the device, sMfltGatewayBatch.device_serial
+//! @param content_body_length The length of the compressed batch
+//!
+//! @return true if the post was successful, false otherwise
+bool memfault_http_start_compressed_device_chunk_batch_post(
+    MfltHttpClientSendCb callback, void *ctx, const char *device_serial,
+    size_t content_body_length);
+
 typedef enum MfltHttpParseStatus {
   kMfltHttpParseStatus_Ok = 0,
   MfltHttpParseStatus_ParseStatusLineError,
   MfltHttpParseStatus_ParseHeaderError,
   MfltHttpParseStatus_HeaderTooLongError,
+  MfltHttpParseStatus_ParseChunkedBodyError,
 } eMfltHttpParseStatus;
 
 typedef enum MfltHttpParsePhase {
@@ -88,6 +142,11 @@ typedef struct {
 //! @return True if parsing completed or false if more data is needed for the response
 //!   Upon completion the 'parse_error' & 'http_status_code' fields can be checked
 //!   within the 'ctx' for the results
+//!
+//! @note When multiple requests are pipelined on a keep-alive connection, the responses arrive
+//!   back-to-back. Once a response completes, 'data_bytes_processed' holds the number of bytes
+//!   from 'data' which belonged to it. The remaining bytes are the start of the next response and
+//!   should be fed to the parser after zero initializing the context again.
 bool memfault_http_parse_response(
     sMemfaultHttpResponseContext *ctx, const void *data, size_t data_len);
 
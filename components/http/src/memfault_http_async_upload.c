@@ -0,0 +1,245 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/http/async_upload.h"
+
+#include <string.h>
+
+#include "memfault/core/data_packetizer.h"
+#include "memfault/core/debug_log.h"
+#include "memfault/core/errors.h"
+#include "memfault/http/http_client.h"
+#include "memfault/http/retry_policy.h"
+
+static void prv_complete(sMfltHttpAsyncUpload *upload, eMfltHttpAsyncUploadResult result) {
+  const bool got_http_error = (result == kMfltHttpAsyncUploadResult_HttpError);
+  if (got_http_error &&
+      !memfault_http_retry_policy_is_retryable_status((uint32_t)upload->http_status_code)) {
+    // the server will never accept the message, drop it rather than sending it again
+    memfault_packetizer_confirm_delivery();
+  } else if (result != kMfltHttpAsyncUploadResult_Success) {
+    // the message in flight hasn't been acknowledged with a 2xx, so it will be sent again by the
+    // next upload
+    memfault_packetizer_abort();
+  }
+
+  upload->cfg.transport->close(upload->cfg.transport_ctx);
+  upload->state = kMfltHttpAsyncUploadState_Idle;
+
+  if (result == kMfltHttpAsyncUploadResult_Success) {
+    memfault_http_retry_policy_record_success();
+  } else {
+    MEMFAULT_LOG_ERROR("Upload failed: rv=%d, http status=%d", (int)result,
+                       upload->http_status_code);
+    memfault_http_retry_policy_record_failure(
+        got_http_error ? (uint32_t)upload->http_status_code : 0,
+        got_http_error ? upload->rsp_parser.retry_after_s : 0);
+  }
+
+  if (upload->cfg.complete_cb != NULL) {
+    upload->cfg.complete_cb(upload, result, upload->cfg.complete_ctx);
+  }
+}
+
+static bool prv_stage_header_data(const void *data, size_t data_len, void *ctx) {
+  sMfltHttpAsyncUpload *upload = (sMfltHttpAsyncUpload *)ctx;
+  if ((upload->tx_len + data_len) > sizeof(upload->tx_buf)) {
+    return false;
+  }
+  memcpy(&upload->tx_buf[upload->tx_len], data, data_len);
+  upload->tx_len += data_len;
+  return true;
+}
+
+//! Stages the headers of the request for the next message in the packetizer or completes the
+//! upload if there is no more data to send
+static void prv_start_next_request(sMfltHttpAsyncUpload *upload) {
+  const sPacketizerConfig cfg = {
+    // let a single msg span many "memfault_packetizer_get_next" calls
+    .enable_multi_packet_chunk = true,
+    // only delete the msg once the server has accepted it
+    .enable_delivery_confirmation = true,
+  };
+  sPacketizerMetadata metadata;
+  if (!memfault_packetizer_begin(&cfg, &metadata)) {
+    prv_complete(upload, kMfltHttpAsyncUploadResult_Success);
+    return;
+  }
+
+  upload->state = kMfltHttpAsyncUploadState_SendingRequest;
+  upload->msg_fully_staged = false;
+  upload->tx_len = 0;
+  upload->tx_offset = 0;
+  if (!memfault_http_start_chunk_post(prv_stage_header_data, upload,
+                                      metadata.single_chunk_message_length)) {
+    MEMFAULT_LOG_ERROR("Headers don't fit in MEMFAULT_HTTP_ASYNC_UPLOAD_TX_BUF_SIZE");
+    prv_complete(upload, kMfltHttpAsyncUploadResult_SendError);
+  }
+}
+
+int memfault_http_async_upload_start(sMfltHttpAsyncUpload *upload,
+                                     const sMfltHttpAsyncUploadConfig *cfg) {
+  if ((upload == NULL) || (cfg == NULL) || (cfg->transport == NULL)) {
+    return MemfaultInternalReturnCode_InvalidInput;
+  }
+
+  if (memfault_http_async_upload_in_progress(upload)) {
+    return MemfaultInternalReturnCode_Error;
+  }
+
+  if (!memfault_packetizer_data_available()) {
+    return kMfltPostDataStatus_NoDataFound;
+  }
+
+  if (!memfault_http_retry_policy_upload_allowed()) {
+    return kMfltPostDataStatus_RetryLater;
+  }
+
+  *upload = (sMfltHttpAsyncUpload) {
+    .cfg = *cfg,
+  };
+
+  const int rv = cfg->transport->connect(cfg->transport_ctx);
+  if (rv != 0) {
+    memfault_http_retry_policy_record_failure(0, 0);
+    return rv;
+  }
+  upload->state = kMfltHttpAsyncUploadState_Connecting;
+  return 0;
+}
+
+void memfault_http_async_upload_on_connected(sMfltHttpAsyncUpload *upload, int result) {
+  if (upload->state != kMfltHttpAsyncUploadState_Connecting) {
+    return;
+  }
+
+  if (result != 0) {
+    prv_complete(upload, kMfltHttpAsyncUploadResult_ConnectError);
+    return;
+  }
+
+  prv_start_next_request(upload);
+}
+
+//! @return false if all the data for the message has been sent
+static bool prv_refill_tx_buf(sMfltHttpAsyncUpload *upload) {
+  if (upload->msg_fully_staged) {
+    return false;
+  }
+
+  size_t buf_len = sizeof(upload->tx_buf);
+  const eMemfaultPacketizerStatus status = memfault_packetizer_get_next(upload->tx_buf, &buf_len);
+  upload->tx_offset = 0;
+  upload->tx_len = (status == kMemfaultPacketizerStatus_NoMoreData) ? 0 : buf_len;
+  upload->msg_fully_staged = (status != kMemfaultPacketizerStatus_MoreDataForChunk);
+  return (upload->tx_len != 0);
+}
+
+void memfault_http_async_upload_on_writable(sMfltHttpAsyncUpload *upload) {
+  if (upload->state != kMfltHttpAsyncUploadState_SendingRequest) {
+    return;
+  }
+
+  while (1) {
+    if ((upload->tx_offset == upload->tx_len) && !prv_refill_tx_buf(upload)) {
+      // the whole request has been handed to the transport
+      upload->state = kMfltHttpAsyncUploadState_AwaitingResponse;
+      memfault_http_response_parser_reset(&upload->rsp_parser);
+      return;
+    }
+
+    const int rv = upload->cfg.transport->send(upload->cfg.transport_ctx,
+                                               &upload->tx_buf[upload->tx_offset],
+                                               upload->tx_len - upload->tx_offset);
+    if (rv < 0) {
+      prv_complete(upload, kMfltHttpAsyncUploadResult_SendError);
+      return;
+    }
+
+    if (rv == 0) {
+      // the transport is backed up, resume on the next writable event
+      return;
+    }
+    upload->tx_offset += (size_t)rv;
+  }
+}
+
+static void prv_handle_response(sMfltHttpAsyncUpload *upload) {
+  const sMfltHttpResponseParser *rsp_parser = &upload->rsp_parser;
+  upload->http_status_code = rsp_parser->http_status_code;
+
+  if (rsp_parser->parse_error != kMfltHttpParseStatus_Ok) {
+    prv_complete(upload, kMfltHttpAsyncUploadResult_ParseError);
+    return;
+  }
+
+  if ((rsp_parser->http_status_code < 200) || (rsp_parser->http_status_code >= 300)) {
+    prv_complete(upload, kMfltHttpAsyncUploadResult_HttpError);
+    return;
+  }
+
+  memfault_packetizer_confirm_delivery();
+  upload->num_posts++;
+  if (rsp_parser->keep_alive) {
+    // keep the connection open for the next message, if there is one
+    prv_start_next_request(upload);
+    return;
+  }
+
+  // the server is closing the connection so a new one is needed for any remaining data
+  if (!memfault_packetizer_data_available()) {
+    prv_complete(upload, kMfltHttpAsyncUploadResult_Success);
+    return;
+  }
+
+  upload->cfg.transport->close(upload->cfg.transport_ctx);
+  if (upload->cfg.transport->connect(upload->cfg.transport_ctx) != 0) {
+    prv_complete(upload, kMfltHttpAsyncUploadResult_ConnectError);
+    return;
+  }
+  upload->state = kMfltHttpAsyncUploadState_Connecting;
+}
+
+void memfault_http_async_upload_on_readable(sMfltHttpAsyncUpload *upload) {
+  while (upload->state == kMfltHttpAsyncUploadState_AwaitingResponse) {
+    char buf[32];
+    const int rv = upload->cfg.transport->recv(upload->cfg.transport_ctx, buf, sizeof(buf));
+    if (rv < 0) {
+      prv_complete(upload, kMfltHttpAsyncUploadResult_RecvError);
+      return;
+    }
+
+    if (rv == 0) {
+      // wait for the rest of the response to arrive
+      return;
+    }
+
+    if (memfault_http_response_parser_feed(&upload->rsp_parser, buf, (size_t)rv, NULL)) {
+      prv_handle_response(upload);
+    }
+  }
+}
+
+void memfault_http_async_upload_on_timeout(sMfltHttpAsyncUpload *upload) {
+  if (upload->state == kMfltHttpAsyncUploadState_Idle) {
+    return;
+  }
+  prv_complete(upload, kMfltHttpAsyncUploadResult_Timeout);
+}
+
+bool memfault_http_async_upload_wants_write(const sMfltHttpAsyncUpload *upload) {
+  return upload->state == kMfltHttpAsyncUploadState_SendingRequest;
+}
+
+bool memfault_http_async_upload_wants_read(const sMfltHttpAsyncUpload *upload) {
+  return upload->state == kMfltHttpAsyncUploadState_AwaitingResponse;
+}
+
+bool memfault_http_async_upload_in_progress(const sMfltHttpAsyncUpload *upload) {
+  return upload->state != kMfltHttpAsyncUploadState_Idle;
+}
@@ -0,0 +1,103 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/http/chunk_batch.h"
+
+#if MEMFAULT_HTTP_CHUNK_BATCH_ENABLED
+
+#include <stdint.h>
+#include <string.h>
+
+#include "memfault/core/data_packetizer.h"
+#include "memfault/util/deflate.h"
+
+bool memfault_http_chunk_batch_build(void *buf, size_t buf_len, sMfltHttpChunkBatch *batch_out) {
+  const size_t part_hdr_len = MEMFAULT_STATIC_STRLEN(MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER);
+  const size_t part_end_len = MEMFAULT_STATIC_STRLEN(MEMFAULT_HTTP_CHUNK_BATCH_PART_END);
+  // the framing of the next part and the delimiter which closes the body
+  const size_t framing_len =
+      MEMFAULT_HTTP_CHUNK_BATCH_PART_OVERHEAD + MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN;
+
+  uint8_t *body = (uint8_t *)buf;
+  size_t offset = 0;
+  size_t num_chunks = 0;
+
+  while (1) {
+    const size_t space_remaining = buf_len - offset;
+    if (space_remaining < (framing_len + MEMFAULT_PACKETIZER_MIN_BUF_LEN)) {
+      break;
+    }
+
+    // the packetizer fills the part right after its header
+    memcpy(&body[offset], MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER, part_hdr_len);
+    size_t chunk_len = space_remaining - framing_len;
+    if (!memfault_packetizer_get_chunk(&body[offset + part_hdr_len], &chunk_len)) {
+      break;
+    }
+    offset += part_hdr_len + chunk_len;
+    memcpy(&body[offset], MEMFAULT_HTTP_CHUNK_BATCH_PART_END, part_end_len);
+    offset += part_end_len;
+    num_chunks++;
+  }
+
+  if (num_chunks != 0) {
+    memcpy(&body[offset], MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER,
+           MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN);
+    offset += MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN;
+  }
+
+  if (batch_out != NULL) {
+    *batch_out = (sMfltHttpChunkBatch) {
+      .body_len = offset,
+      .num_chunks = num_chunks,
+    };
+  }
+  return (num_chunks != 0);
+}
+
+typedef struct {
+  uint8_t *buf;
+  size_t buf_len;
+  size_t offset;
+} sMfltChunkBatchCompressCtx;
+
+static bool prv_compressed_write_cb(void *ctx, const void *data, size_t data_len) {
+  sMfltChunkBatchCompressCtx *compress_ctx = (sMfltChunkBatchCompressCtx *)ctx;
+  if ((compress_ctx->buf_len - compress_ctx->offset) < data_len) {
+    return false;
+  }
+  memcpy(&compress_ctx->buf[compress_ctx->offset], data, data_len);
+  compress_ctx->offset += data_len;
+  return true;
+}
+
+bool memfault_http_chunk_batch_compress(const void *body, size_t body_len, void *out_buf,
+                                        size_t out_buf_len, size_t *out_len) {
+  static sMemfaultDeflateEncoder s_encoder;
+
+  if (body_len == 0) {
+    return false;
+  }
+
+  // only a body which ends up smaller than the original is worth sending
+  sMfltChunkBatchCompressCtx ctx = {
+    .buf = (uint8_t *)out_buf,
+    .buf_len = (out_buf_len < body_len) ? out_buf_len : (body_len - 1),
+  };
+
+  memfault_deflate_encoder_init(&s_encoder, prv_compressed_write_cb, &ctx);
+  if (!memfault_deflate_encoder_write(&s_encoder, body, body_len) ||
+      !memfault_deflate_encoder_finish(&s_encoder)) {
+    return false;
+  }
+
+  *out_len = ctx.offset;
+  return true;
+}
+
+#endif /* MEMFAULT_HTTP_CHUNK_BATCH_ENABLED */
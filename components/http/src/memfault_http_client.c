@@ -11,10 +11,12 @@
 
 #include <stdio.h>
 
+#include "memfault/core/compiler.h"
 #include "memfault/core/debug_log.h"
 #include "memfault/core/errors.h"
 #include "memfault/core/platform/device_info.h"
 #include "memfault/http/platform/http_client.h"
+#include "memfault/http/retry_policy.h"
 
 static const char *prv_get_scheme(void) {
   return g_mflt_http_client_config.api_no_tls ? "http" : "https";
@@ -34,27 +36,46 @@ sMfltHttpClient *memfault_http_client_create(void) {
   return memfault_platform_http_client_create();
 }
 
+MEMFAULT_WEAK
+int memfault_platform_http_response_get_retry_after(
+    MEMFAULT_UNUSED const sMfltHttpResponse *response,
+    MEMFAULT_UNUSED uint32_t *retry_after_s_out) {
+  return MemfaultInternalReturnCode_Error;
+}
+
 static void prv_handle_post_data_response(const sMfltHttpResponse *response, void *ctx) {
   if (!response) {
-    return;  // Request failed
+    // Request failed
+    memfault_http_retry_policy_record_failure(0, 0);
+    return;
   }
   uint32_t http_status = 0;
   const int rv = memfault_platform_http_response_get_status(response, &http_status);
   if (rv != 0) {
     MEMFAULT_LOG_ERROR("Request failed. No HTTP status: %d", rv);
+    memfault_http_retry_policy_record_failure(0, 0);
     return;
   }
   if (http_status < 200 || http_status >= 300) {
     // Redirections are expected to be handled by the platform implementation
     MEMFAULT_LOG_ERROR("Request failed. HTTP Status: %"PRIu32, http_status);
+    uint32_t retry_after_s = 0;
+    if (memfault_platform_http_response_get_retry_after(response, &retry_after_s) != 0) {
+      retry_after_s = 0;
+    }
+    memfault_http_retry_policy_record_failure(http_status, retry_after_s);
     return;
   }
+  memfault_http_retry_policy_record_success();
 }
 
 int memfault_http_client_post_data(sMfltHttpClient *client) {
   if (!client) {
     return MemfaultInternalReturnCode_InvalidInput;
   }
+  if (!memfault_http_retry_policy_upload_allowed()) {
+    return kMfltPostDataStatus_RetryLater;
+  }
   return memfault_platform_http_client_post_data(client, prv_handle_post_data_response, NULL);
 }
 
@@ -0,0 +1,239 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/http/gateway.h"
+
+#if MEMFAULT_HTTP_GATEWAY_ENABLED
+
+#include <string.h>
+
+#include "memfault/http/chunk_batch.h"
+
+#define MAX_QUEUED_CHUNK_LEN 0xffff
+
+bool memfault_gateway_init(sMfltGateway *gateway, sMfltGatewayDevice *devices,
+                           size_t max_devices, void *storage, size_t storage_len,
+                           size_t max_body_len) {
+  if ((gateway == NULL) || (devices == NULL) || (max_devices == 0) || (storage == NULL) ||
+      (max_body_len == 0)) {
+    return false;
+  }
+
+  const size_t queue_size = storage_len / max_devices;
+  if (queue_size <= MEMFAULT_GATEWAY_CHUNK_OVERHEAD) {
+    return false;
+  }
+
+  *gateway = (sMfltGateway) {
+    .devices = devices,
+    .max_devices = max_devices,
+    .max_body_len = max_body_len,
+  };
+
+  uint8_t *queue_storage = (uint8_t *)storage;
+  for (size_t i = 0; i < max_devices; i++) {
+    devices[i] = (sMfltGatewayDevice) { 0 };
+    memfault_circular_buffer_init(&devices[i].queue, &queue_storage[i * queue_size], queue_size);
+  }
+  return true;
+}
+
+static bool prv_device_is_idle(const sMfltGatewayDevice *device) {
+  return (device->num_chunks == 0) && (device->batch_num_chunks == 0);
+}
+
+static sMfltGatewayDevice *prv_find_device(const sMfltGateway *gateway,
+                                           const char *device_serial) {
+  for (size_t i = 0; i < gateway->max_devices; i++) {
+    sMfltGatewayDevice *device = &gateway->devices[i];
+    if (device->in_use && (strcmp(device->device_serial, device_serial) == 0)) {
+      return device;
+    }
+  }
+  return NULL;
+}
+
+//! @return a slot which is not in use or, failing that, the slot of a device with nothing left
+//!   to send. NULL if there is none.
+static sMfltGatewayDevice *prv_alloc_device(sMfltGateway *gateway) {
+  sMfltGatewayDevice *idle_device = NULL;
+  for (size_t i = 0; i < gateway->max_devices; i++) {
+    sMfltGatewayDevice *device = &gateway->devices[i];
+    if (!device->in_use) {
+      return device;
+    }
+    if ((idle_device == NULL) && prv_device_is_idle(device)) {
+      idle_device = device;
+    }
+  }
+  return idle_device;
+}
+
+int memfault_gateway_add_chunk(sMfltGateway *gateway, const char *device_serial,
+                               const void *chunk, size_t chunk_len) {
+  if ((gateway == NULL) || (device_serial == NULL) || (chunk == NULL) || (chunk_len == 0) ||
+      (chunk_len > MAX_QUEUED_CHUNK_LEN)) {
+    return kMfltGatewayError_InvalidInput;
+  }
+  const size_t serial_len = strlen(device_serial);
+  if ((serial_len == 0) || (serial_len > MEMFAULT_GATEWAY_MAX_DEVICE_SERIAL_LEN)) {
+    return kMfltGatewayError_InvalidInput;
+  }
+
+  sMfltGatewayDevice *device = prv_find_device(gateway, device_serial);
+  if (device == NULL) {
+    device = prv_alloc_device(gateway);
+    if (device == NULL) {
+      return kMfltGatewayError_NoDeviceSlot;
+    }
+    // the queue of an idle device is empty so it can be handed over as is
+    device->in_use = true;
+    memcpy(device->device_serial, device_serial, serial_len + 1);
+    device->stats = (sMfltGatewayDeviceStats) { 0 };
+  }
+
+  // a chunk which can't go out on its own would sit at the head of the queue of the device
+  // forever, holding back every chunk queued after it
+  if ((MEMFAULT_HTTP_CHUNK_BATCH_PART_OVERHEAD + chunk_len +
+       MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN) > gateway->max_body_len) {
+    device->stats.num_chunks_rejected++;
+    return kMfltGatewayError_ChunkTooLarge;
+  }
+
+  if (memfault_circular_buffer_get_write_size(&device->queue) <
+      (MEMFAULT_GATEWAY_CHUNK_OVERHEAD + chunk_len)) {
+    device->stats.num_chunks_rejected++;
+    return kMfltGatewayError_QueueFull;
+  }
+
+  const uint8_t len_hdr[MEMFAULT_GATEWAY_CHUNK_OVERHEAD] = {
+    (uint8_t)(chunk_len & 0xff),
+    (uint8_t)(chunk_len >> 8),
+  };
+  memfault_circular_buffer_write(&device->queue, len_hdr, sizeof(len_hdr));
+  memfault_circular_buffer_write(&device->queue, chunk, chunk_len);
+  device->num_chunks++;
+  device->stats.num_chunks_received++;
+  return 0;
+}
+
+static size_t prv_read_chunk_len(sMfltGatewayDevice *device, size_t queue_offset) {
+  uint8_t len_hdr[MEMFAULT_GATEWAY_CHUNK_OVERHEAD];
+  memfault_circular_buffer_read(&device->queue, queue_offset, len_hdr, sizeof(len_hdr));
+  return (size_t)len_hdr[0] | ((size_t)len_hdr[1] << 8);
+}
+
+//! @return the next device with chunks queued, starting from the one whose turn it is. NULL if
+//!   there is none.
+static sMfltGatewayDevice *prv_next_device(sMfltGateway *gateway) {
+  for (size_t i = 0; i < gateway->max_devices; i++) {
+    const size_t device_idx = (gateway->next_device + i) % gateway->max_devices;
+    sMfltGatewayDevice *device = &gateway->devices[device_idx];
+    if (device->in_use && (device->num_chunks != 0)) {
+      // the device after it goes next so every device gets its turn
+      gateway->next_device = (device_idx + 1) % gateway->max_devices;
+      return device;
+    }
+  }
+  return NULL;
+}
+
+bool memfault_gateway_batch_build(sMfltGateway *gateway, void *buf, size_t buf_len,
+                                  sMfltGatewayBatch *batch_out) {
+  if (batch_out != NULL) {
+    *batch_out = (sMfltGatewayBatch) { 0 };
+  }
+  if ((gateway == NULL) || (buf == NULL) || (gateway->batch_device != NULL) ||
+      (buf_len < gateway->max_body_len)) {
+    return false;
+  }
+
+  sMfltGatewayDevice *device = prv_next_device(gateway);
+  if (device == NULL) {
+    return false;
+  }
+
+  const size_t part_hdr_len = MEMFAULT_STATIC_STRLEN(MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER);
+  const size_t part_end_len = MEMFAULT_STATIC_STRLEN(MEMFAULT_HTTP_CHUNK_BATCH_PART_END);
+  uint8_t *body = (uint8_t *)buf;
+  size_t offset = 0;
+  size_t queue_offset = 0;
+  size_t num_chunks = 0;
+  // the chunks of a device must go out in order so the batch ends at the first one which
+  // doesn't fit. memfault_gateway_add_chunk() makes sure the first one always does.
+  while (num_chunks < device->num_chunks) {
+    const size_t chunk_len = prv_read_chunk_len(device, queue_offset);
+    if ((offset + MEMFAULT_HTTP_CHUNK_BATCH_PART_OVERHEAD + chunk_len +
+         MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN) > gateway->max_body_len) {
+      break;
+    }
+    queue_offset += MEMFAULT_GATEWAY_CHUNK_OVERHEAD;
+
+    memcpy(&body[offset], MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER, part_hdr_len);
+    offset += part_hdr_len;
+    memfault_circular_buffer_read(&device->queue, queue_offset, &body[offset], chunk_len);
+    offset += chunk_len;
+    memcpy(&body[offset], MEMFAULT_HTTP_CHUNK_BATCH_PART_END, part_end_len);
+    offset += part_end_len;
+
+    queue_offset += chunk_len;
+    num_chunks++;
+  }
+  memcpy(&body[offset], MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER,
+         MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN);
+  offset += MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN;
+
+  device->batch_num_chunks = num_chunks;
+  device->batch_queue_bytes = queue_offset;
+  gateway->batch_device = device;
+
+  if (batch_out != NULL) {
+    *batch_out = (sMfltGatewayBatch) {
+      .body_len = offset,
+      .num_chunks = num_chunks,
+      .device_serial = device->device_serial,
+    };
+  }
+  return true;
+}
+
+void memfault_gateway_batch_complete(sMfltGateway *gateway, bool delivered) {
+  if ((gateway == NULL) || (gateway->batch_device == NULL)) {
+    return;
+  }
+
+  sMfltGatewayDevice *device = gateway->batch_device;
+  if (delivered) {
+    memfault_circular_buffer_consume(&device->queue, device->batch_queue_bytes);
+    device->num_chunks -= device->batch_num_chunks;
+    device->stats.num_chunks_forwarded += device->batch_num_chunks;
+  }
+  device->batch_num_chunks = 0;
+  device->batch_queue_bytes = 0;
+  gateway->batch_device = NULL;
+}
+
+size_t memfault_gateway_get_num_queued_chunks(const sMfltGateway *gateway) {
+  size_t num_chunks = 0;
+  for (size_t i = 0; i < gateway->max_devices; i++) {
+    num_chunks += gateway->devices[i].num_chunks;
+  }
+  return num_chunks;
+}
+
+bool memfault_gateway_get_device_stats(const sMfltGateway *gateway, const char *device_serial,
+                                       sMfltGatewayDeviceStats *stats_out) {
+  const sMfltGatewayDevice *device = prv_find_device(gateway, device_serial);
+  if (device == NULL) {
+    return false;
+  }
+  *stats_out = device->stats;
+  return true;
+}
+
+#endif /* MEMFAULT_HTTP_GATEWAY_ENABLED */
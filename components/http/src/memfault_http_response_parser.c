@@ -0,0 +1,350 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/http/response_parser.h"
+
+#include <string.h>
+
+#include "memfault/core/compiler.h"
+#include "memfault/core/math.h"
+
+//
+// Word-at-a-time search for the '\n' terminating a line. A word is XOR'd with '\n' repeated in
+// every byte so a matching byte becomes zero, which the classic "has a zero byte" bit trick then
+// detects without branching on every character.
+//
+
+#define MEMFAULT_WORD_ONES (((size_t)~(size_t)0) / 0xff)
+#define MEMFAULT_WORD_HIGHS (MEMFAULT_WORD_ONES * 0x80)
+
+static bool prv_word_has_byte(size_t word, uint8_t byte) {
+  const size_t x = word ^ (MEMFAULT_WORD_ONES * byte);
+  return ((x - MEMFAULT_WORD_ONES) & ~x & MEMFAULT_WORD_HIGHS) != 0;
+}
+
+//! @return the index of the first '\n' in buf or buf_len if there is none
+static size_t prv_find_lf(const char *buf, size_t buf_len) {
+  size_t idx = 0;
+  for (; (idx + sizeof(size_t)) <= buf_len; idx += sizeof(size_t)) {
+    size_t word;
+    memcpy(&word, &buf[idx], sizeof(word)); // buf may not be word aligned
+    if (prv_word_has_byte(word, '\n')) {
+      break;
+    }
+  }
+
+  for (; idx < buf_len; idx++) {
+    if (buf[idx] == '\n') {
+      return idx;
+    }
+  }
+  return buf_len;
+}
+
+//
+// String helpers
+//
+
+static char prv_lower(char c) {
+  return ((c >= 'A') && (c <= 'Z')) ? (char)(c | 0x20) : c;
+}
+
+static bool prv_is_space(char c) {
+  return (c == ' ') || (c == '\t');
+}
+
+//! @return true if the 'len' bytes at 'str' match the lowercase string 'lower_str', ignoring case
+static bool prv_equals_ignore_case(const char *str, size_t len, const char *lower_str) {
+  if (strlen(lower_str) != len) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (prv_lower(str[i]) != lower_str[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//! @return true if the comma separated list of tokens in 'value' holds 'lower_token'
+static bool prv_has_token(const char *value, size_t len, const char *lower_token) {
+  size_t idx = 0;
+  while (idx < len) {
+    while ((idx < len) && (prv_is_space(value[idx]) || (value[idx] == ','))) {
+      idx++;
+    }
+    const size_t token_start = idx;
+    while ((idx < len) && (value[idx] != ',')) {
+      idx++;
+    }
+    size_t token_end = idx;
+    while ((token_end > token_start) && prv_is_space(value[token_end - 1])) {
+      token_end--;
+    }
+    if (prv_equals_ignore_case(&value[token_start], token_end - token_start, lower_token)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static int prv_hex_digit(char c) {
+  if ((c >= '0') && (c <= '9')) {
+    return c - '0';
+  }
+  const char lower = prv_lower(c);
+  if ((lower >= 'a') && (lower <= 'f')) {
+    return lower - 'a' + 10;
+  }
+  return -1;
+}
+
+//! Parses an unsigned number from the start of 'str'
+//!
+//! @return the number of digits parsed or 0 if there were none or the value overflowed
+static size_t prv_parse_number(const char *str, size_t len, size_t base, size_t *value_out) {
+  size_t value = 0;
+  size_t idx = 0;
+  for (; idx < len; idx++) {
+    const int digit = prv_hex_digit(str[idx]);
+    if ((digit < 0) || ((size_t)digit >= base)) {
+      break;
+    }
+    if (value > ((SIZE_MAX - (size_t)digit) / base)) {
+      return 0;
+    }
+    value = (value * base) + (size_t)digit;
+  }
+  *value_out = value;
+  return idx;
+}
+
+//
+// Line handlers
+//
+
+//! Parses a "Status-Line" of the form "HTTP/1.<minor> <3 digit status> <reason>"
+static bool prv_handle_status_line(sMfltHttpResponseParser *parser, const char *line,
+                                   size_t len) {
+  #define HTTP_VERSION "HTTP/1."
+  const size_t http_ver_len = MEMFAULT_STATIC_STRLEN(HTTP_VERSION);
+  if ((len < http_ver_len + 1) || (memcmp(line, HTTP_VERSION, http_ver_len) != 0)) {
+    return false;
+  }
+
+  size_t idx = http_ver_len;
+  if ((line[idx] < '0') || (line[idx] > '9')) {
+    return false;
+  }
+  // persistent connections are the default as of HTTP/1.1
+  parser->keep_alive = (line[idx] != '0');
+  idx++;
+
+  if ((idx >= len) || !prv_is_space(line[idx])) {
+    return false;
+  }
+  while ((idx < len) && prv_is_space(line[idx])) {
+    idx++;
+  }
+
+  size_t status;
+  const size_t num_digits = 3;
+  if ((prv_parse_number(&line[idx], len - idx, 10, &status) != num_digits)) {
+    return false;
+  }
+  parser->http_status_code = (int)status;
+  return true;
+}
+
+static bool prv_handle_header_line(sMfltHttpResponseParser *parser, const char *line,
+                                   size_t len) {
+  const char *colon = (const char *)memchr(line, ':', len);
+  if (colon == NULL) {
+    return false;
+  }
+
+  size_t name_len = (size_t)(colon - line);
+  while ((name_len > 0) && prv_is_space(line[name_len - 1])) {
+    name_len--;
+  }
+
+  size_t value_idx = (size_t)(colon - line) + 1;
+  while ((value_idx < len) && prv_is_space(line[value_idx])) {
+    value_idx++;
+  }
+  const char *value = &line[value_idx];
+  size_t value_len = len - value_idx;
+  // the value may be followed by optional whitespace, which isn't part of it
+  while ((value_len > 0) && prv_is_space(value[value_len - 1])) {
+    value_len--;
+  }
+
+  if (prv_equals_ignore_case(line, name_len, "content-length")) {
+    // the value must be made up of digits only
+    if ((value_len == 0) ||
+        (prv_parse_number(value, value_len, 10, &parser->remaining) != value_len)) {
+      return false;
+    }
+    parser->has_content_length = true;
+  } else if (prv_equals_ignore_case(line, name_len, "transfer-encoding")) {
+    parser->chunked = prv_has_token(value, value_len, "chunked");
+  } else if (prv_equals_ignore_case(line, name_len, "connection")) {
+    if (prv_has_token(value, value_len, "close")) {
+      parser->keep_alive = false;
+    } else if (prv_has_token(value, value_len, "keep-alive")) {
+      parser->keep_alive = true;
+    }
+  } else if (prv_equals_ignore_case(line, name_len, "retry-after")) {
+    // only the "delay-seconds" form is supported, an "HTTP-date" is ignored
+    size_t retry_after_s;
+    if ((value_len > 0) && (prv_parse_number(value, value_len, 10, &retry_after_s) == value_len)) {
+      parser->retry_after_s = (uint32_t)MEMFAULT_MIN(retry_after_s, UINT32_MAX);
+    }
+  }
+  return true;
+}
+
+static void prv_handle_end_of_headers(sMfltHttpResponseParser *parser) {
+  const int status = parser->http_status_code;
+  const bool has_body = !(((status >= 100) && (status < 200)) || (status == 204) ||
+                          (status == 304));
+  if (has_body && parser->chunked) {
+    // "Transfer-Encoding: chunked" takes precedence over any "Content-Length"
+    parser->phase = kMfltHttpResponseParserPhase_ChunkSize;
+  } else if (has_body && parser->has_content_length && (parser->remaining != 0)) {
+    parser->phase = kMfltHttpResponseParserPhase_Body;
+  } else {
+    // NB: Like memfault_http_parse_response(), a response without a length is treated as having
+    // no body. The Memfault API always sends one.
+    parser->phase = kMfltHttpResponseParserPhase_Done;
+  }
+}
+
+//! @return the parse error to report or kMfltHttpParseStatus_Ok
+static eMfltHttpParseStatus prv_handle_line(sMfltHttpResponseParser *parser) {
+  const char *line = parser->line_buf;
+  const size_t len = parser->line_len;
+
+  switch (parser->phase) {
+    case kMfltHttpResponseParserPhase_StatusLine:
+      if (!prv_handle_status_line(parser, line, len)) {
+        return MfltHttpParseStatus_ParseStatusLineError;
+      }
+      parser->phase = kMfltHttpResponseParserPhase_Header;
+      break;
+
+    case kMfltHttpResponseParserPhase_Header:
+      if (len == 0) {
+        prv_handle_end_of_headers(parser);
+      } else if (!prv_handle_header_line(parser, line, len)) {
+        return MfltHttpParseStatus_ParseHeaderError;
+      }
+      break;
+
+    case kMfltHttpResponseParserPhase_ChunkSize:
+      // any chunk extensions (";name=value") which follow the size are ignored
+      if (prv_parse_number(line, len, 16, &parser->remaining) == 0) {
+        return MfltHttpParseStatus_ParseChunkedBodyError;
+      }
+      parser->phase = (parser->remaining == 0) ? kMfltHttpResponseParserPhase_Trailer :
+                                                 kMfltHttpResponseParserPhase_ChunkData;
+      break;
+
+    case kMfltHttpResponseParserPhase_ChunkDataEnd:
+      if (len != 0) {
+        return MfltHttpParseStatus_ParseChunkedBodyError;
+      }
+      parser->phase = kMfltHttpResponseParserPhase_ChunkSize;
+      break;
+
+    case kMfltHttpResponseParserPhase_Trailer:
+      // trailer fields are ignored, an empty line terminates the message
+      if (len == 0) {
+        parser->phase = kMfltHttpResponseParserPhase_Done;
+      }
+      break;
+
+    default:
+      break;
+  }
+  return kMfltHttpParseStatus_Ok;
+}
+
+//! Accumulates data into the line buffer until a '\n' is found. Lines longer than the buffer are
+//! truncated, which is fine since none of the values of interest are long.
+//!
+//! @return true if a complete line is available in the line buffer
+static bool prv_consume_line(sMfltHttpResponseParser *parser, const char *data, size_t data_len,
+                             size_t *bytes_consumed) {
+  const size_t lf_idx = prv_find_lf(data, data_len);
+  const bool line_complete = (lf_idx != data_len);
+
+  const size_t space_available = sizeof(parser->line_buf) - 1 - parser->line_len;
+  const size_t copy_len = MEMFAULT_MIN(lf_idx, space_available);
+  memcpy(&parser->line_buf[parser->line_len], data, copy_len);
+  parser->line_len += copy_len;
+  *bytes_consumed = line_complete ? (lf_idx + 1) : data_len;
+
+  if (line_complete && (parser->line_len > 0) &&
+      (parser->line_buf[parser->line_len - 1] == '\r')) {
+    parser->line_len--;
+  }
+  parser->line_buf[parser->line_len] = '\0';
+  return line_complete;
+}
+
+void memfault_http_response_parser_reset(sMfltHttpResponseParser *parser) {
+  *parser = (sMfltHttpResponseParser) { 0 };
+}
+
+bool memfault_http_response_parser_feed(sMfltHttpResponseParser *parser, const void *data,
+                                        size_t data_len, size_t *bytes_consumed) {
+  if (parser->phase == kMfltHttpResponseParserPhase_Done) {
+    // start of the next response on the connection
+    memfault_http_response_parser_reset(parser);
+  }
+
+  const char *chars = (const char *)data;
+  size_t offset = 0;
+  while ((offset < data_len) && (parser->phase != kMfltHttpResponseParserPhase_Done)) {
+    const size_t bytes_available = data_len - offset;
+
+    if ((parser->phase == kMfltHttpResponseParserPhase_Body) ||
+        (parser->phase == kMfltHttpResponseParserPhase_ChunkData)) {
+      // skip over the body, there's no need to look at it
+      const size_t skip_len = MEMFAULT_MIN(parser->remaining, bytes_available);
+      parser->remaining -= skip_len;
+      parser->body_len += skip_len;
+      offset += skip_len;
+      if (parser->remaining == 0) {
+        parser->phase = (parser->phase == kMfltHttpResponseParserPhase_Body) ?
+            kMfltHttpResponseParserPhase_Done : kMfltHttpResponseParserPhase_ChunkDataEnd;
+      }
+      continue;
+    }
+
+    size_t line_bytes;
+    const bool line_complete = prv_consume_line(parser, &chars[offset], bytes_available,
+                                                &line_bytes);
+    offset += line_bytes;
+    if (!line_complete) {
+      continue;
+    }
+
+    parser->parse_error = prv_handle_line(parser);
+    parser->line_len = 0;
+    if (parser->parse_error != kMfltHttpParseStatus_Ok) {
+      parser->phase = kMfltHttpResponseParserPhase_Done;
+    }
+  }
+
+  if (bytes_consumed != NULL) {
+    *bytes_consumed = offset;
+  }
+  return (parser->phase == kMfltHttpResponseParserPhase_Done);
+}
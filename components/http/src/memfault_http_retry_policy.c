@@ -0,0 +1,150 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/http/retry_policy.h"
+
+#include "memfault/core/compiler.h"
+#include "memfault/core/debug_log.h"
+#include "memfault/core/math.h"
+#include "memfault/core/platform/core.h"
+#include "memfault/core/platform/device_info.h"
+
+#define MEMFAULT_HTTP_RETRY_STATE_MAGIC 0x59525452
+
+typedef struct MfltHttpRetryState {
+  uint32_t magic;
+  //! The number of consecutive failed attempts
+  uint32_t attempts;
+  //! The delay which was remaining before the next attempt the last time it was checked
+  uint32_t remaining_ms;
+  uint32_t rsvd;
+} sMfltHttpRetryState;
+
+MEMFAULT_STATIC_ASSERT(sizeof(sMfltHttpRetryState) == MEMFAULT_HTTP_RETRY_STATE_REGION_SIZE,
+                       "struct doesn't match expected size");
+
+//! Bounds the delay restored from a region of RAM which may hold garbage
+#define MEMFAULT_HTTP_RETRY_LONGEST_DELAY_MS \
+  MEMFAULT_MAX(MEMFAULT_HTTP_RETRY_MAX_DELAY_MS, MEMFAULT_HTTP_RETRY_AFTER_MAX_S * 1000UL)
+
+static sMfltHttpRetryState s_default_state = { .magic = MEMFAULT_HTTP_RETRY_STATE_MAGIC };
+static sMfltHttpRetryState *s_state = &s_default_state;
+static uint64_t s_next_attempt_ms;
+
+//! Devices of a fleet which lost connectivity together may well have booted at the same time, so
+//! the seed is derived from the device serial (FNV-1a) for them to pick different delays
+static uint32_t prv_compute_seed(void) {
+  sMemfaultDeviceInfo info = { 0 };
+  memfault_platform_get_device_info(&info);
+
+  uint32_t hash = 2166136261UL;
+  for (const char *c = info.device_serial; (c != NULL) && (*c != '\0'); c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619UL;
+  }
+  hash ^= (uint32_t)memfault_platform_get_time_since_boot_ms();
+  return (hash != 0) ? hash : 1;
+}
+
+MEMFAULT_WEAK
+uint32_t memfault_platform_http_retry_get_random(void) {
+  // xorshift32, seeded on first use
+  static uint32_t s_rand_state;
+  if (s_rand_state == 0) {
+    s_rand_state = prv_compute_seed();
+  }
+  s_rand_state ^= s_rand_state << 13;
+  s_rand_state ^= s_rand_state >> 17;
+  s_rand_state ^= s_rand_state << 5;
+  return s_rand_state;
+}
+
+static void prv_schedule_next_attempt(uint32_t delay_ms) {
+  s_next_attempt_ms = memfault_platform_get_time_since_boot_ms() + delay_ms;
+  s_state->remaining_ms = delay_ms;
+}
+
+void memfault_http_retry_policy_boot(void *start_addr) {
+  if (start_addr == NULL) {
+    return;
+  }
+
+  s_state = (sMfltHttpRetryState *)start_addr;
+  if (s_state->magic != MEMFAULT_HTTP_RETRY_STATE_MAGIC) {
+    *s_state = (sMfltHttpRetryState) {
+      .magic = MEMFAULT_HTTP_RETRY_STATE_MAGIC,
+    };
+  }
+
+  s_state->attempts = MEMFAULT_MIN(s_state->attempts, MEMFAULT_HTTP_RETRY_MAX_ATTEMPTS);
+  prv_schedule_next_attempt(
+      MEMFAULT_MIN(s_state->remaining_ms, (uint32_t)MEMFAULT_HTTP_RETRY_LONGEST_DELAY_MS));
+}
+
+bool memfault_http_retry_policy_is_retryable_status(uint32_t http_status) {
+  return (http_status == 0) ||   // no response, i.e a network error or timeout
+         (http_status == 408) || // Request Timeout
+         (http_status == 429) || // Too Many Requests
+         (http_status >= 500);
+}
+
+uint32_t memfault_http_retry_policy_get_delay_ms(void) {
+  const uint64_t now_ms = memfault_platform_get_time_since_boot_ms();
+  if (now_ms == 0) {
+    // the platform doesn't track the time since boot so delays can't be enforced
+    return 0;
+  }
+
+  const uint32_t delay_ms =
+      (now_ms >= s_next_attempt_ms) ? 0 : (uint32_t)(s_next_attempt_ms - now_ms);
+  // keep the persisted state up to date in case the device reboots
+  s_state->remaining_ms = delay_ms;
+  return delay_ms;
+}
+
+bool memfault_http_retry_policy_upload_allowed(void) {
+  return memfault_http_retry_policy_get_delay_ms() == 0;
+}
+
+size_t memfault_http_retry_policy_get_attempt_count(void) {
+  return s_state->attempts;
+}
+
+void memfault_http_retry_policy_record_success(void) {
+  s_state->attempts = 0;
+  prv_schedule_next_attempt(0);
+}
+
+bool memfault_http_retry_policy_record_failure(uint32_t http_status, uint32_t retry_after_s) {
+  if (!memfault_http_retry_policy_is_retryable_status(http_status)) {
+    return false;
+  }
+
+  s_state->attempts++;
+  const bool give_up = (s_state->attempts >= MEMFAULT_HTTP_RETRY_MAX_ATTEMPTS);
+  uint32_t delay_ms;
+  if (give_up) {
+    s_state->attempts = 0;
+    delay_ms = MEMFAULT_HTTP_RETRY_MAX_DELAY_MS;
+  } else {
+    // the shift is bounded so the exponential term can't overflow
+    const uint32_t shift = MEMFAULT_MIN(s_state->attempts - 1, 31U);
+    const uint64_t max_delay_ms =
+        MEMFAULT_MIN((uint64_t)MEMFAULT_HTTP_RETRY_BASE_DELAY_MS << shift,
+                     (uint64_t)MEMFAULT_HTTP_RETRY_MAX_DELAY_MS);
+    // "full jitter": anywhere between no delay and the exponential bound
+    delay_ms = (uint32_t)(memfault_platform_http_retry_get_random() % (max_delay_ms + 1));
+  }
+
+  const uint32_t retry_after_ms = MEMFAULT_MIN(retry_after_s, MEMFAULT_HTTP_RETRY_AFTER_MAX_S) * 1000;
+  delay_ms = MEMFAULT_MAX(delay_ms, retry_after_ms);
+  prv_schedule_next_attempt(delay_ms);
+
+  MEMFAULT_LOG_INFO("Upload failed (status=%d), next attempt in %d ms", (int)http_status,
+                    (int)delay_ms);
+  return !give_up;
+}
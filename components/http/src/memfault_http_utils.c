@@ -13,6 +13,8 @@
 
 #include "memfault/core/compiler.h"
 #include "memfault/core/platform/device_info.h"
+#include "memfault/http/chunk_batch.h"
+#include "memfault/http/gateway.h"
 #include "memfault/http/http_client.h"
 
 static bool prv_write_msg(MfltHttpClientSendCb write_callback, void *ctx,
@@ -24,25 +26,29 @@ static bool prv_write_msg(MfltHttpClientSendCb write_callback, void *ctx,
   return write_callback(msg, msg_len, ctx);
 }
 
-bool memfault_http_start_chunk_post(
-    MfltHttpClientSendCb write_callback, void *ctx, size_t content_body_length) {
+//! Writes the 'Request-Line' and all the headers common to every chunk post
+//!
+//! @param device_serial The device the chunks belong to, i.e a device behind a gateway, or NULL
+//!   for the device running the SDK
+static bool prv_write_chunk_post_common_headers(MfltHttpClientSendCb write_callback, void *ctx,
+                                                const char *content_type,
+                                                const char *device_serial) {
   // Request built will look like this:
   //  POST /api/v0/chunks/<device_serial> HTTP/1.1\r\n
   //  Host:chunks.memfault.com\r\n
   //  User-Agent: MemfaultSDK/0.0.11\r\n
   //  Memfault-Project-Key:<PROJECT_KEY>\r\n
-  //  Content-Type:application/octet-stream\r\n
-  //  Content-Length:<content_body_length>\r\n
-  //  \r\n
-
-  sMemfaultDeviceInfo device_info;
-  memfault_platform_get_device_info(&device_info);
+  //  Content-Type:<content_type>\r\n
 
   char buffer[100];
   const size_t max_msg_len = sizeof(buffer);
-  size_t msg_len = (size_t)snprintf(buffer, sizeof(buffer),
-                                    "POST /api/v0/chunks/%s HTTP/1.1\r\n",
-                                    device_info.device_serial);
+  if (device_serial == NULL) {
+    sMemfaultDeviceInfo device_info;
+    memfault_platform_get_device_info(&device_info);
+    device_serial = device_info.device_serial;
+  }
+  size_t msg_len = (size_t)snprintf(buffer, sizeof(buffer), "POST /api/v0/chunks/%s HTTP/1.1\r\n",
+                                    device_serial);
   if (!prv_write_msg(write_callback, ctx, buffer, msg_len, max_msg_len)) {
     return false;
   }
@@ -64,24 +70,91 @@ bool memfault_http_start_chunk_post(
   msg_len = (size_t)snprintf(buffer, sizeof(buffer), "Memfault-Project-Key:%s\r\n",
                              g_mflt_http_client_config.api_key);
 
-  #define CONTENT_TYPE "Content-Type:application/octet-stream\r\n"
-  const size_t content_type_len = MEMFAULT_STATIC_STRLEN(CONTENT_TYPE);
-  bool success = prv_write_msg(write_callback, ctx, buffer, msg_len, max_msg_len) &&
-      write_callback(CONTENT_TYPE, content_type_len, ctx);
-  if (!success) {
+  if (!prv_write_msg(write_callback, ctx, buffer, msg_len, max_msg_len)) {
+    return false;
+  }
+
+  msg_len = (size_t)snprintf(buffer, sizeof(buffer), "Content-Type:%s\r\n", content_type);
+  return prv_write_msg(write_callback, ctx, buffer, msg_len, max_msg_len);
+}
+
+#define END_HEADER_SECTION "\r\n"
+#define CHUNK_CONTENT_TYPE "application/octet-stream"
+
+//! @param content_encoding The value of the "Content-Encoding" header or NULL if the body is not
+//!   encoded
+static bool prv_start_post_with_content_length(MfltHttpClientSendCb write_callback, void *ctx,
+                                               const char *content_type,
+                                               const char *content_encoding,
+                                               const char *device_serial,
+                                               size_t content_body_length) {
+  // The common headers are followed by:
+  //  [Content-Encoding:<content_encoding>\r\n]
+  //  Content-Length:<content_body_length>\r\n
+  //  \r\n
+  if (!prv_write_chunk_post_common_headers(write_callback, ctx, content_type, device_serial)) {
     return false;
   }
 
-  msg_len = (size_t)snprintf(buffer, sizeof(buffer), "Content-Length:%d\r\n",
-                             (int)content_body_length);
+  char buffer[30];
+  if (content_encoding != NULL) {
+    const size_t msg_len = (size_t)snprintf(buffer, sizeof(buffer), "Content-Encoding:%s\r\n",
+                                            content_encoding);
+    if (!prv_write_msg(write_callback, ctx, buffer, msg_len, sizeof(buffer))) {
+      return false;
+    }
+  }
+
+  const size_t msg_len = (size_t)snprintf(buffer, sizeof(buffer), "Content-Length:%d\r\n",
+                                          (int)content_body_length);
 
-  #define END_HEADER_SECTION "\r\n"
   const size_t end_hdr_section_len = MEMFAULT_STATIC_STRLEN(END_HEADER_SECTION);
-  success = prv_write_msg(write_callback, ctx, buffer, msg_len, max_msg_len) &&
+  return prv_write_msg(write_callback, ctx, buffer, msg_len, sizeof(buffer)) &&
       write_callback(END_HEADER_SECTION, end_hdr_section_len, ctx);
-  return success;
 }
 
+bool memfault_http_start_chunk_post(
+    MfltHttpClientSendCb write_callback, void *ctx, size_t content_body_length) {
+  return prv_start_post_with_content_length(write_callback, ctx, CHUNK_CONTENT_TYPE, NULL,
+                                            NULL, content_body_length);
+}
+
+#if MEMFAULT_HTTP_CHUNK_BATCH_ENABLED
+bool memfault_http_start_chunk_batch_post(
+    MfltHttpClientSendCb write_callback, void *ctx, size_t content_body_length) {
+  return prv_start_post_with_content_length(write_callback, ctx,
+                                            MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE, NULL,
+                                            NULL, content_body_length);
+}
+
+bool memfault_http_start_compressed_chunk_batch_post(
+    MfltHttpClientSendCb write_callback, void *ctx, size_t content_body_length) {
+  return prv_start_post_with_content_length(write_callback, ctx,
+                                            MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE,
+                                            MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_ENCODING,
+                                            NULL, content_body_length);
+}
+#endif /* MEMFAULT_HTTP_CHUNK_BATCH_ENABLED */
+
+#if MEMFAULT_HTTP_GATEWAY_ENABLED
+bool memfault_http_start_device_chunk_batch_post(
+    MfltHttpClientSendCb write_callback, void *ctx, const char *device_serial,
+    size_t content_body_length) {
+  return prv_start_post_with_content_length(write_callback, ctx,
+                                            MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE, NULL,
+                                            device_serial, content_body_length);
+}
+
+bool memfault_http_start_compressed_device_chunk_batch_post(
+    MfltHttpClientSendCb write_callback, void *ctx, const char *device_serial,
+    size_t content_body_length) {
+  return prv_start_post_with_content_length(write_callback, ctx,
+                                            MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE,
+                                            MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_ENCODING,
+                                            device_serial, content_body_length);
+}
+#endif /* MEMFAULT_HTTP_GATEWAY_ENABLED */
+
 static bool prv_is_number(char c) {
   return ((c) >= '0' && (c) <= '9');
 }
@@ -281,7 +354,9 @@ bool memfault_http_parse_response(
         }
         // We've reached the end of headers marker
         if (ctx->content_length == 0) {
-          // no body to read
+          // no body to read. Count the final '\n' so any bytes which follow (i.e the next response
+          // on a keep-alive connection) are left unprocessed
+          ctx->data_bytes_processed++;
           return true;
         }
         ctx->phase = kMfltHttpParsePhase_ExpectingBody;
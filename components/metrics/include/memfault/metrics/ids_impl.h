@@ -8,6 +8,9 @@
 //! NOTE: The internals of the metric APIs make use of "X-Macros" to enable more flexibility
 //! improving and extending the internal implementation without impacting the externally facing API
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,9 +19,23 @@ extern "C" {
 #  define MEMFAULT_METRICS_USER_HEARTBEAT_DEFS_FILE "memfault_metrics_heartbeat_config.def"
 #endif
 
+//! When enabled, the boot profile (see memfault/core/boot_profile.h) is reported in the first
+//! heartbeat after memfault_boot_complete() is called. Disabled by default so the SDK adds no keys
+//! to the heartbeat unless requested.
+#ifndef MEMFAULT_METRICS_BOOT_PROFILE_ENABLED
+#define MEMFAULT_METRICS_BOOT_PROFILE_ENABLED 0
+#endif
+
+//! When enabled, the connections a port makes to Memfault are reported in the heartbeat. Set by
+//! ports which record them, i.e CONFIG_MEMFAULT_HTTP_METRICS for Zephyr.
+#ifndef MEMFAULT_METRICS_HTTP_CONNECTIONS_ENABLED
+#define MEMFAULT_METRICS_HTTP_CONNECTIONS_ENABLED 0
+#endif
+
 //! Generate extern const char * declarations for all IDs (used in key names):
 #define MEMFAULT_METRICS_KEY_DEFINE(key_name, value_type) \
 extern const char * const g_memfault_metrics_id_##key_name;
+#include "memfault/metrics/heartbeat_config.def"
 #include MEMFAULT_METRICS_USER_HEARTBEAT_DEFS_FILE
 #undef MEMFAULT_METRICS_KEY_DEFINE
 
@@ -47,6 +64,43 @@ typedef struct {
 #define _MEMFAULT_METRICS_ID(id) \
   ((MemfaultMetricId) { ._impl = g_memfault_metrics_id_##id })
 
+//! Generate an index for every key. kMfltMetricsIndex_Count is the total number of metrics
+#define MEMFAULT_METRICS_KEY_DEFINE(key_name, value_type) \
+  kMfltMetricsIndex_##key_name,
+typedef enum MfltMetricsIndex {
+  #include "memfault/metrics/heartbeat_config.def"
+  #include MEMFAULT_METRICS_USER_HEARTBEAT_DEFS_FILE
+  #undef MEMFAULT_METRICS_KEY_DEFINE
+  kMfltMetricsIndex_Count
+} eMfltMetricsIndex;
+
+//! Generate an index for every timer key. kMfltMetricsTimerIndex_Count is the number of timers
+#define _MEMFAULT_METRICS_TIMER_INDEX_kMemfaultMetricType_Unsigned(key_name)
+#define _MEMFAULT_METRICS_TIMER_INDEX_kMemfaultMetricType_Signed(key_name)
+#define _MEMFAULT_METRICS_TIMER_INDEX_kMemfaultMetricType_Timer(key_name) \
+  kMfltMetricsTimerIndex_##key_name,
+#define MEMFAULT_METRICS_KEY_DEFINE(key_name, value_type) \
+  _MEMFAULT_METRICS_TIMER_INDEX_##value_type(key_name)
+typedef enum MfltMetricsTimerIndex {
+  #include "memfault/metrics/heartbeat_config.def"
+  #include MEMFAULT_METRICS_USER_HEARTBEAT_DEFS_FILE
+  #undef MEMFAULT_METRICS_KEY_DEFINE
+  kMfltMetricsTimerIndex_Count
+} eMfltMetricsTimerIndex;
+
+union MemfaultMetricValue {
+  uint32_t u32;
+  int32_t i32;
+};
+
+typedef struct MemfaultMetricValueMetadata {
+  bool is_running:1;
+  // We'll use 32 bits since the rollover time is ~25 days which is much much greater than a
+  // reasonable heartbeat interval. This let's us track whether or not the timer is running in the
+  // top bit
+  uint32_t start_time_ms:31;
+} sMemfaultMetricValueMetadata;
+
 #ifdef __cplusplus
 }
 #endif
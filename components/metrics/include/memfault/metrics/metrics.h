@@ -26,6 +26,7 @@
 #include <inttypes.h>
 
 #include "memfault/core/event_storage.h"
+#include "memfault/core/platform/device_info.h"
 #include "memfault/metrics/ids_impl.h"
 
 #ifdef __cplusplus
@@ -130,6 +131,61 @@ int memfault_metrics_heartbeat_read_unsigned(MemfaultMetricId key, uint32_t *rea
 int memfault_metrics_heartbeat_read_signed(MemfaultMetricId key, int32_t *read_val);
 int memfault_metrics_heartbeat_timer_read(MemfaultMetricId key, uint32_t *read_val);
 
+//
+// Metrics instances
+//
+// The APIs above track the heartbeat of the device the SDK runs on. A metrics instance tracks an
+// independent set of the same heartbeat metrics for another device, for example a downstream node
+// a gateway collects data on behalf of. Heartbeats for an instance are serialized to the event
+// storage provided on initialization, tagged with the instance's device info.
+//
+// Unlike the APIs above, instances do not take memfault_lock() and are not driven by the platform
+// heartbeat timer. The caller must make sure an instance is only used by one thread at a time and
+// call memfault_metrics_ctx_heartbeat_trigger() at the end of every heartbeat interval.
+//
+
+//! @note The contents are private to the implementation
+typedef struct MfltMetricsCtx {
+  union MemfaultMetricValue values[kMfltMetricsIndex_Count];
+  //! Sized with an extra entry so the array is never empty
+  sMemfaultMetricValueMetadata timer_metadata[kMfltMetricsTimerIndex_Count + 1];
+  const sMemfaultEventStorageImpl *storage_impl;
+  const sMemfaultDeviceInfo *device_info;
+} sMfltMetricsCtx;
+
+//! Initializes a metrics instance. All heartbeat values will be initialized to 0.
+//!
+//! @param ctx The instance to initialize. Must remain valid for as long as it is in use
+//! @param storage_impl The event storage to serialize heartbeats to
+//! @param device_info The identity heartbeats are reported for. Must remain valid for as long as
+//!   the instance is in use
+//!
+//! @return 0 on success, else error code
+int memfault_metrics_ctx_init(sMfltMetricsCtx *ctx, const sMemfaultEventStorageImpl *storage_impl,
+                              const sMemfaultDeviceInfo *device_info);
+
+//! Same as the memfault_metrics_heartbeat_*() APIs above but for the instance provided
+int memfault_metrics_ctx_heartbeat_set_signed(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                              int32_t signed_value);
+int memfault_metrics_ctx_heartbeat_set_unsigned(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                                uint32_t unsigned_value);
+int memfault_metrics_ctx_heartbeat_timer_start(sMfltMetricsCtx *ctx, MemfaultMetricId key);
+int memfault_metrics_ctx_heartbeat_timer_stop(sMfltMetricsCtx *ctx, MemfaultMetricId key);
+int memfault_metrics_ctx_heartbeat_add(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                       int32_t amount);
+int memfault_metrics_ctx_heartbeat_read_unsigned(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                                 uint32_t *read_val);
+int memfault_metrics_ctx_heartbeat_read_signed(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                               int32_t *read_val);
+int memfault_metrics_ctx_heartbeat_timer_read(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                              uint32_t *read_val);
+
+//! Ends the current heartbeat interval of the instance: the values are serialized to the
+//! instance's event storage and reset to 0
+//!
+//! @return true if the heartbeat was serialized, false if the event storage was out of space
+bool memfault_metrics_ctx_heartbeat_trigger(sMfltMetricsCtx *ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@
 #include <stddef.h>
 
 #include "memfault/core/event_storage.h"
+#include "memfault/metrics/metrics.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +34,16 @@ size_t memfault_metrics_heartbeat_compute_worst_case_storage_size(void);
 //! to serialize the data
 bool memfault_metrics_heartbeat_serialize(const sMemfaultEventStorageImpl *storage_impl);
 
+//! Same as memfault_metrics_heartbeat_compute_worst_case_storage_size() but for the device info
+//! of a metrics instance
+size_t memfault_metrics_ctx_heartbeat_compute_worst_case_storage_size(sMfltMetricsCtx *ctx);
+
+//! Serialize out the current set of heartbeat metrics of a metrics instance to its event storage
+//!
+//! @return True if the data was successfully serialized, else false if there was not enough space
+//! to serialize the data
+bool memfault_metrics_ctx_heartbeat_serialize(sMfltMetricsCtx *ctx);
+
 
 #ifdef __cplusplus
 }
@@ -17,11 +17,6 @@
 extern "C" {
 #endif
 
-union MemfaultMetricValue {
-  uint32_t u32;
-  int32_t i32;
-};
-
 typedef struct {
   MemfaultMetricId key;
   eMemfaultMetricType type;
@@ -39,6 +34,10 @@ typedef bool (*MemfaultMetricIteratorCallback)(void *ctx, const sMemfaultMetricI
 
 void memfault_metrics_heartbeat_iterate(MemfaultMetricIteratorCallback cb, void *ctx);
 
+//! Same as memfault_metrics_heartbeat_iterate() but for a metrics instance
+void memfault_metrics_ctx_heartbeat_iterate(sMfltMetricsCtx *metrics_ctx,
+                                            MemfaultMetricIteratorCallback cb, void *ctx);
+
 //! @return the number of metrics being required
 size_t memfault_metrics_heartbeat_get_num_metrics(void);
 
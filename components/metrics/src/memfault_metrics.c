@@ -10,6 +10,7 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "memfault/core/boot_profile.h"
 #include "memfault/core/debug_log.h"
 #include "memfault/core/event_storage_implementation.h"
 #include "memfault/core/math.h"
@@ -43,6 +44,7 @@ typedef struct MemfaultMetricKVPair {
 // Generate global ID constants (ROM):
 #define MEMFAULT_METRICS_KEY_DEFINE(key_name, value_type) \
   const char * const g_memfault_metrics_id_##key_name = MEMFAULT_EXPAND_AND_QUOTE(key_name);
+#include "memfault/metrics/heartbeat_config.def"
 #include MEMFAULT_METRICS_USER_HEARTBEAT_DEFS_FILE
 #undef MEMFAULT_METRICS_KEY_DEFINE
 
@@ -51,6 +53,7 @@ typedef struct MemfaultMetricKVPair {
   { .key = _MEMFAULT_METRICS_ID_CREATE(key_name), .type = value_type },
 
 static const sMemfaultMetricKVPair s_memfault_heartbeat_keys[] = {
+  #include "memfault/metrics/heartbeat_config.def"
   #include MEMFAULT_METRICS_USER_HEARTBEAT_DEFS_FILE
   #undef MEMFAULT_METRICS_KEY_DEFINE
 };
@@ -59,47 +62,18 @@ MEMFAULT_STATIC_ASSERT(MEMFAULT_ARRAY_SIZE(s_memfault_heartbeat_keys) != 0,
                        "At least one \"MEMFAULT_METRICS_KEY_DEFINE\" must be defined in " MEMFAULT_METRICS_USER_HEARTBEAT_DEFS_FILE);
 
 
+MEMFAULT_STATIC_ASSERT(MEMFAULT_ARRAY_SIZE(s_memfault_heartbeat_keys) == kMfltMetricsIndex_Count,
+                       "Metrics instance storage out of sync with the heartbeat keys");
+
 #define MEMFAULT_METRICS_TIMER_VAL_MAX 0x80000000
-typedef struct MemfaultMetricValueMetadata {
-  bool is_running:1;
-  // We'll use 32 bits since the rollover time is ~25 days which is much much greater than a
-  // reasonable heartbeat interval. This let's us track whether or not the timer is running in the
-  // top bit
-  uint32_t start_time_ms:31;
-} sMemfaultMetricValueMetadata;
 
 typedef struct MemfaultMetricValueInfo {
   union MemfaultMetricValue *valuep;
   sMemfaultMetricValueMetadata *meta_datap;
 } sMemfaultMetricValueInfo;
 
-// Generate heartbeat values table (RAM):
-#define MEMFAULT_METRICS_KEY_DEFINE(key_name, value_type) { 0 },
-static union MemfaultMetricValue s_memfault_heartbeat_values[] = {
-  #include MEMFAULT_METRICS_USER_HEARTBEAT_DEFS_FILE
-  #undef MEMFAULT_METRICS_KEY_DEFINE
-};
-
-
-#define MEMFAULT_METRICS_STATE_HELPER_kMemfaultMetricType_Unsigned(_name)
-#define MEMFAULT_METRICS_STATE_HELPER_kMemfaultMetricType_Signed(_name)
-#define MEMFAULT_METRICS_STATE_HELPER_kMemfaultMetricType_Timer(_name) { 0 },
-#define MEMFAULT_METRICS_KEY_DEFINE(_name, _type) \
-  MEMFAULT_METRICS_STATE_HELPER_##_type(_name)
-static sMemfaultMetricValueMetadata s_memfault_heartbeat_timer_values_metadata[] = {
-  #include MEMFAULT_METRICS_USER_HEARTBEAT_DEFS_FILE
-  // allocate at least one entry so we don't have an empty array in the situation
-  // where no Timer metrics are defined:
-  MEMFAULT_METRICS_KEY_DEFINE(_, kMemfaultMetricType_Timer)
-  #undef MEMFAULT_METRICS_KEY_DEFINE
-};
-// Work-around for unused-macros error in case not all types are used in the .def file:
-MEMFAULT_METRICS_STATE_HELPER_kMemfaultMetricType_Unsigned(_)
-MEMFAULT_METRICS_STATE_HELPER_kMemfaultMetricType_Signed(_)
-
-static struct {
-  const sMemfaultEventStorageImpl *storage_impl;
-} s_memfault_metrics_ctx;
+//! The instance backing the global metrics API
+static sMfltMetricsCtx s_memfault_metrics_ctx;
 
 //
 // Routines which can be overrideen by customers
@@ -118,15 +92,16 @@ typedef bool (*MemfaultMetricKvIteratorCb)(void *ctx,
                                            const sMemfaultMetricKVPair *kv_pair,
                                            const sMemfaultMetricValueInfo *value_info);
 
-static void prv_metric_iterator(void *ctx, MemfaultMetricKvIteratorCb cb) {
+static void prv_metric_iterator(sMfltMetricsCtx *metrics_ctx, void *ctx,
+                                MemfaultMetricKvIteratorCb cb) {
   uint32_t timer_metadata_index = 0;
-  for (uint32_t idx = 0; idx < MEMFAULT_ARRAY_SIZE(s_memfault_heartbeat_values); ++idx) {
+  for (uint32_t idx = 0; idx < MEMFAULT_ARRAY_SIZE(metrics_ctx->values); ++idx) {
     const sMemfaultMetricKVPair *const kv_pair = &s_memfault_heartbeat_keys[idx];
 
     sMemfaultMetricValueMetadata *meta_datap = NULL;
     switch (kv_pair->type) {
       case kMemfaultMetricType_Timer:
-        meta_datap = &s_memfault_heartbeat_timer_values_metadata[timer_metadata_index];
+        meta_datap = &metrics_ctx->timer_metadata[timer_metadata_index];
         timer_metadata_index++;
         break;
       default:
@@ -134,7 +109,7 @@ static void prv_metric_iterator(void *ctx, MemfaultMetricKvIteratorCb cb) {
     }
 
     sMemfaultMetricValueInfo value_info = {
-        .valuep = &s_memfault_heartbeat_values[idx],
+        .valuep = &metrics_ctx->values[idx],
         .meta_datap = meta_datap,
     };
     bool do_continue = cb(ctx, kv_pair, &value_info);
@@ -166,19 +141,21 @@ static bool prv_find_key_cb(void *ctx, const sMemfaultMetricKVPair *key,
   return false;
 }
 
-static eMemfaultMetricType prv_find_value_for_key(MemfaultMetricId key,
+static eMemfaultMetricType prv_find_value_for_key(sMfltMetricsCtx *metrics_ctx,
+                                                  MemfaultMetricId key,
                                                   sMemfaultMetricValueInfo *value_info_out) {
   sFindValueForKeyCtx ctx = {
     .key_to_find = key,
   };
-  prv_metric_iterator(&ctx, prv_find_key_cb);
+  prv_metric_iterator(metrics_ctx, &ctx, prv_find_key_cb);
   *value_info_out = ctx.value_info_out;
   return ctx.type_out;
 }
 
-static int prv_find_value_info_for_type(MemfaultMetricId key, eMemfaultMetricType expected_type,
+static int prv_find_value_info_for_type(sMfltMetricsCtx *metrics_ctx, MemfaultMetricId key,
+                                        eMemfaultMetricType expected_type,
                                         sMemfaultMetricValueInfo *value_info) {
-  const eMemfaultMetricType type = prv_find_value_for_key(key, value_info);
+  const eMemfaultMetricType type = prv_find_value_for_key(metrics_ctx, key, value_info);
   if (value_info->valuep == NULL) {
     return MEMFAULT_METRICS_KEY_NOT_FOUND;
   }
@@ -190,9 +167,10 @@ static int prv_find_value_info_for_type(MemfaultMetricId key, eMemfaultMetricTyp
 }
 
 static int prv_find_and_set_value_for_key(
-    MemfaultMetricId key, eMemfaultMetricType expected_type, union MemfaultMetricValue *new_value) {
+    sMfltMetricsCtx *metrics_ctx, MemfaultMetricId key, eMemfaultMetricType expected_type,
+    union MemfaultMetricValue *new_value) {
   sMemfaultMetricValueInfo value_info;
-  int rv = prv_find_value_info_for_type(key, expected_type, &value_info);
+  int rv = prv_find_value_info_for_type(metrics_ctx, key, expected_type, &value_info);
   if (rv != 0) {
     return rv;
   }
@@ -201,23 +179,33 @@ static int prv_find_and_set_value_for_key(
   return 0;
 }
 
+int memfault_metrics_ctx_heartbeat_set_signed(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                              int32_t signed_value) {
+  return prv_find_and_set_value_for_key(ctx, key, kMemfaultMetricType_Signed,
+                                        &(union MemfaultMetricValue){.i32 = signed_value});
+}
+
 int memfault_metrics_heartbeat_set_signed(MemfaultMetricId key, int32_t signed_value) {
   int rv;
   memfault_lock();
   {
-    rv = prv_find_and_set_value_for_key(key, kMemfaultMetricType_Signed,
-                                        &(union MemfaultMetricValue){.i32 = signed_value});
+    rv = memfault_metrics_ctx_heartbeat_set_signed(&s_memfault_metrics_ctx, key, signed_value);
   }
   memfault_unlock();
   return rv;
 }
 
+int memfault_metrics_ctx_heartbeat_set_unsigned(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                                uint32_t unsigned_value) {
+  return prv_find_and_set_value_for_key(ctx, key, kMemfaultMetricType_Unsigned,
+                                        &(union MemfaultMetricValue){.u32 = unsigned_value});
+}
+
 int memfault_metrics_heartbeat_set_unsigned(MemfaultMetricId key, uint32_t unsigned_value) {
   int rv;
   memfault_lock();
   {
-    rv = prv_find_and_set_value_for_key(key, kMemfaultMetricType_Unsigned,
-                                        &(union MemfaultMetricValue){.u32 = unsigned_value});
+    rv = memfault_metrics_ctx_heartbeat_set_unsigned(&s_memfault_metrics_ctx, key, unsigned_value);
   }
   memfault_unlock();
   return rv;
@@ -270,9 +258,10 @@ static bool prv_update_timer_metric(const sMemfaultMetricValueInfo *value_info,
   return false;
 }
 
-static int prv_find_timer_metric_and_update(MemfaultMetricId key, eMemfaultTimerOp op) {
+static int prv_find_timer_metric_and_update(sMfltMetricsCtx *metrics_ctx, MemfaultMetricId key,
+                                            eMemfaultTimerOp op) {
   sMemfaultMetricValueInfo value_info;
-  int rv = prv_find_value_info_for_type(key, kMemfaultMetricType_Timer, &value_info);
+  int rv = prv_find_value_info_for_type(metrics_ctx, key, kMemfaultMetricType_Timer, &value_info);
   if (rv != 0) {
     return rv;
   }
@@ -284,21 +273,29 @@ static int prv_find_timer_metric_and_update(MemfaultMetricId key, eMemfaultTimer
   return did_update ? 0 : MEMFAULT_METRICS_TYPE_NO_CHANGE;
 }
 
+int memfault_metrics_ctx_heartbeat_timer_start(sMfltMetricsCtx *ctx, MemfaultMetricId key) {
+  return prv_find_timer_metric_and_update(ctx, key, kMemfaultTimerOp_Start);
+}
+
 int memfault_metrics_heartbeat_timer_start(MemfaultMetricId key) {
   int rv;
   memfault_lock();
   {
-    rv = prv_find_timer_metric_and_update(key, kMemfaultTimerOp_Start);
+    rv = memfault_metrics_ctx_heartbeat_timer_start(&s_memfault_metrics_ctx, key);
   }
   memfault_unlock();
   return rv;
 }
 
+int memfault_metrics_ctx_heartbeat_timer_stop(sMfltMetricsCtx *ctx, MemfaultMetricId key) {
+  return prv_find_timer_metric_and_update(ctx, key, kMemfaultTimerOp_Stop);
+}
+
 int memfault_metrics_heartbeat_timer_stop(MemfaultMetricId key) {
   int rv;
   memfault_lock();
   {
-    rv = prv_find_timer_metric_and_update(key, kMemfaultTimerOp_Stop);
+    rv = memfault_metrics_ctx_heartbeat_timer_stop(&s_memfault_metrics_ctx, key);
   }
   memfault_unlock();
   return rv;
@@ -314,20 +311,57 @@ static bool prv_tally_and_update_timer_cb(void *ctx, const sMemfaultMetricKVPair
   return true;
 }
 
+#if MEMFAULT_METRICS_BOOT_PROFILE_ENABLED
+//! Only the global heartbeat reports the boot profile, metrics instances leave the keys at 0
+static bool s_boot_profile_reported;
+
+//! The boot profile is only reported in the first heartbeat after the application marks the boot
+//! as complete. The values are cleared with the rest of that heartbeat once it is serialized.
+static void prv_collect_boot_profile(void) {
+  sMfltBootProfile profile;
+  if (s_boot_profile_reported || !memfault_boot_profile_get(&profile)) {
+    return;
+  }
+
+  if (profile.uptime_at_reset_ms != 0) {
+    memfault_metrics_heartbeat_set_unsigned(
+        MEMFAULT_METRICS_KEY(MemfaultSdkMetric_UptimeAtResetMs), profile.uptime_at_reset_ms);
+  }
+  if (profile.boot_duration_ms != 0) {
+    memfault_metrics_heartbeat_set_unsigned(
+        MEMFAULT_METRICS_KEY(MemfaultSdkMetric_BootDurationMs), profile.boot_duration_ms);
+  }
+  s_boot_profile_reported = true;
+}
+#endif /* MEMFAULT_METRICS_BOOT_PROFILE_ENABLED */
+
 static void prv_heartbeat_timer(void) {
   // force an update of the timer value for any actively running timers
-  prv_metric_iterator(NULL, prv_tally_and_update_timer_cb);
+  prv_metric_iterator(&s_memfault_metrics_ctx, NULL, prv_tally_and_update_timer_cb);
+#if MEMFAULT_METRICS_BOOT_PROFILE_ENABLED
+  prv_collect_boot_profile();
+#endif
   memfault_metrics_heartbeat_collect_data();
 
   memfault_metrics_heartbeat_serialize(s_memfault_metrics_ctx.storage_impl);
 
   // reset metric values
-  memset(s_memfault_heartbeat_values, 0, sizeof(s_memfault_heartbeat_values));
+  memset(s_memfault_metrics_ctx.values, 0, sizeof(s_memfault_metrics_ctx.values));
 }
 
-static int prv_find_key_and_add(MemfaultMetricId key, int32_t amount) {
+bool memfault_metrics_ctx_heartbeat_trigger(sMfltMetricsCtx *ctx) {
+  prv_metric_iterator(ctx, NULL, prv_tally_and_update_timer_cb);
+
+  const bool success = memfault_metrics_ctx_heartbeat_serialize(ctx);
+
+  memset(ctx->values, 0, sizeof(ctx->values));
+  return success;
+}
+
+static int prv_find_key_and_add(sMfltMetricsCtx *metrics_ctx, MemfaultMetricId key,
+                                int32_t amount) {
   sMemfaultMetricValueInfo value_info;
-  const eMemfaultMetricType type = prv_find_value_for_key(key, &value_info);
+  const eMemfaultMetricType type = prv_find_value_for_key(metrics_ctx, key, &value_info);
   if (value_info.valuep == NULL) {
     return MEMFAULT_METRICS_KEY_NOT_FOUND;
   }
@@ -365,20 +399,26 @@ static int prv_find_key_and_add(MemfaultMetricId key, int32_t amount) {
   return 0;
 }
 
+int memfault_metrics_ctx_heartbeat_add(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                       int32_t amount) {
+  return prv_find_key_and_add(ctx, key, amount);
+}
+
 int memfault_metrics_heartbeat_add(MemfaultMetricId key, int32_t amount) {
   int rv;
   memfault_lock();
   {
-    rv = prv_find_key_and_add(key, amount);
+    rv = memfault_metrics_ctx_heartbeat_add(&s_memfault_metrics_ctx, key, amount);
   }
   memfault_unlock();
   return rv;
 }
 
-static int prv_find_key_of_type(MemfaultMetricId key, eMemfaultMetricType expected_type,
+static int prv_find_key_of_type(sMfltMetricsCtx *metrics_ctx, MemfaultMetricId key,
+                                eMemfaultMetricType expected_type,
                                 union MemfaultMetricValue **value_out) {
   sMemfaultMetricValueInfo value_info;
-  const eMemfaultMetricType type = prv_find_value_for_key(key, &value_info);
+  const eMemfaultMetricType type = prv_find_value_for_key(metrics_ctx, key, &value_info);
   if (value_info.valuep == NULL) {
     return MEMFAULT_METRICS_KEY_NOT_FOUND;
   }
@@ -389,39 +429,92 @@ static int prv_find_key_of_type(MemfaultMetricId key, eMemfaultMetricType expect
   return 0;
 }
 
-int memfault_metrics_heartbeat_read_unsigned(MemfaultMetricId key, uint32_t *read_val) {
-  if (read_val == NULL) {
-    return MEMFAULT_METRICS_TYPE_BAD_PARAM;
+static int prv_read_value(sMfltMetricsCtx *metrics_ctx, MemfaultMetricId key,
+                          eMemfaultMetricType expected_type, union MemfaultMetricValue *read_val) {
+  union MemfaultMetricValue *value;
+  const int rv = prv_find_key_of_type(metrics_ctx, key, expected_type, &value);
+  if (rv == 0) {
+    *read_val = *value;
   }
+  return rv;
+}
 
+static int prv_read_value_locked(MemfaultMetricId key, eMemfaultMetricType expected_type,
+                                 union MemfaultMetricValue *read_val) {
   int rv;
   memfault_lock();
   {
-    union MemfaultMetricValue *value;
-    rv = prv_find_key_of_type(key, kMemfaultMetricType_Unsigned, &value);
-    if (rv == 0) {
-      *read_val = value->u32;
-    }
+    rv = prv_read_value(&s_memfault_metrics_ctx, key, expected_type, read_val);
   }
   memfault_unlock();
   return rv;
 }
 
+int memfault_metrics_ctx_heartbeat_read_unsigned(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                                 uint32_t *read_val) {
+  if (read_val == NULL) {
+    return MEMFAULT_METRICS_TYPE_BAD_PARAM;
+  }
+
+  union MemfaultMetricValue value;
+  const int rv = prv_read_value(ctx, key, kMemfaultMetricType_Unsigned, &value);
+  if (rv == 0) {
+    *read_val = value.u32;
+  }
+  return rv;
+}
+
+int memfault_metrics_heartbeat_read_unsigned(MemfaultMetricId key, uint32_t *read_val) {
+  if (read_val == NULL) {
+    return MEMFAULT_METRICS_TYPE_BAD_PARAM;
+  }
+
+  union MemfaultMetricValue value;
+  const int rv = prv_read_value_locked(key, kMemfaultMetricType_Unsigned, &value);
+  if (rv == 0) {
+    *read_val = value.u32;
+  }
+  return rv;
+}
+
+int memfault_metrics_ctx_heartbeat_read_signed(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                               int32_t *read_val) {
+  if (read_val == NULL) {
+    return MEMFAULT_METRICS_TYPE_BAD_PARAM;
+  }
+
+  union MemfaultMetricValue value;
+  const int rv = prv_read_value(ctx, key, kMemfaultMetricType_Signed, &value);
+  if (rv == 0) {
+    *read_val = value.i32;
+  }
+  return rv;
+}
+
 int memfault_metrics_heartbeat_read_signed(MemfaultMetricId key, int32_t *read_val) {
   if (read_val == NULL) {
     return MEMFAULT_METRICS_TYPE_BAD_PARAM;
   }
 
-  int rv;
-  memfault_lock();
-  {
-    union MemfaultMetricValue *value;
-    rv = prv_find_key_of_type(key, kMemfaultMetricType_Signed, &value);
-    if (rv == 0) {
-      *read_val = value->i32;
-    }
+  union MemfaultMetricValue value;
+  const int rv = prv_read_value_locked(key, kMemfaultMetricType_Signed, &value);
+  if (rv == 0) {
+    *read_val = value.i32;
+  }
+  return rv;
+}
+
+int memfault_metrics_ctx_heartbeat_timer_read(sMfltMetricsCtx *ctx, MemfaultMetricId key,
+                                              uint32_t *read_val) {
+  if (read_val == NULL) {
+    return MEMFAULT_METRICS_TYPE_BAD_PARAM;
+  }
+
+  union MemfaultMetricValue value;
+  const int rv = prv_read_value(ctx, key, kMemfaultMetricType_Timer, &value);
+  if (rv == 0) {
+    *read_val = value.u32;
   }
-  memfault_unlock();
   return rv;
 }
 
@@ -430,16 +523,11 @@ int memfault_metrics_heartbeat_timer_read(MemfaultMetricId key, uint32_t *read_v
     return MEMFAULT_METRICS_TYPE_BAD_PARAM;
   }
 
-  int rv;
-  memfault_lock();
-  {
-    union MemfaultMetricValue *value;
-    rv = prv_find_key_of_type(key, kMemfaultMetricType_Timer, &value);
-    if (rv == 0) {
-      *read_val = value->u32;
-    }
+  union MemfaultMetricValue value;
+  const int rv = prv_read_value_locked(key, kMemfaultMetricType_Timer, &value);
+  if (rv == 0) {
+    *read_val = value.u32;
   }
-  memfault_unlock();
   return rv;
 }
 
@@ -461,20 +549,25 @@ static bool prv_metrics_heartbeat_iterate_cb(void *ctx,
   return ctx_info->user_cb(ctx_info->user_ctx, &info);
 }
 
+void memfault_metrics_ctx_heartbeat_iterate(sMfltMetricsCtx *metrics_ctx,
+                                            MemfaultMetricIteratorCallback cb, void *ctx) {
+  sMetricHeartbeatIterateCtx user_ctx = {
+    .user_cb = cb,
+    .user_ctx = ctx,
+  };
+  prv_metric_iterator(metrics_ctx, &user_ctx, prv_metrics_heartbeat_iterate_cb);
+}
+
 void memfault_metrics_heartbeat_iterate(MemfaultMetricIteratorCallback cb, void *ctx) {
   memfault_lock();
   {
-    sMetricHeartbeatIterateCtx user_ctx = {
-      .user_cb = cb,
-      .user_ctx = ctx,
-    };
-    prv_metric_iterator(&user_ctx, prv_metrics_heartbeat_iterate_cb);
+    memfault_metrics_ctx_heartbeat_iterate(&s_memfault_metrics_ctx, cb, ctx);
   }
   memfault_unlock();
 }
 
 size_t memfault_metrics_heartbeat_get_num_metrics(void) {
-  return MEMFAULT_ARRAY_SIZE(s_memfault_heartbeat_values);
+  return MEMFAULT_ARRAY_SIZE(s_memfault_heartbeat_keys);
 }
 
 static bool prv_heartbeat_debug_print(void *ctx, const sMemfaultMetricInfo *metric_info) {
@@ -512,7 +605,10 @@ int memfault_metrics_boot(const sMemfaultEventStorageImpl *storage_impl) {
   }
 
   s_memfault_metrics_ctx.storage_impl = storage_impl;
-  memset(s_memfault_heartbeat_values, 0, sizeof(s_memfault_heartbeat_values));
+#if MEMFAULT_METRICS_BOOT_PROFILE_ENABLED
+  s_boot_profile_reported = false;
+#endif
+  memset(s_memfault_metrics_ctx.values, 0, sizeof(s_memfault_metrics_ctx.values));
 
   const bool success = memfault_platform_metrics_timer_boot(
       MEMFAULT_METRICS_HEARTBEAT_INTERVAL_SECS, prv_heartbeat_timer);
@@ -526,3 +622,25 @@ int memfault_metrics_boot(const sMemfaultEventStorageImpl *storage_impl) {
   }
   return 0;
 }
+
+int memfault_metrics_ctx_init(sMfltMetricsCtx *ctx, const sMemfaultEventStorageImpl *storage_impl,
+                              const sMemfaultDeviceInfo *device_info) {
+  if ((ctx == NULL) || (storage_impl == NULL) || (device_info == NULL)) {
+    return MEMFAULT_METRICS_TYPE_BAD_PARAM;
+  }
+
+  *ctx = (sMfltMetricsCtx) {
+    .storage_impl = storage_impl,
+    .device_info = device_info,
+  };
+
+  const size_t storage_max_size = memfault_serializer_helper_get_storage_size(storage_impl);
+  const size_t worst_case_size_needed =
+      memfault_metrics_ctx_heartbeat_compute_worst_case_storage_size(ctx);
+  if (worst_case_size_needed > storage_max_size) {
+    MEMFAULT_LOG_WARN("Event storage (%d) smaller than largest metrics event (%d)",
+                      (int)storage_max_size, (int)worst_case_size_needed);
+    return MEMFAULT_METRICS_STORAGE_TOO_SMALL;
+  }
+  return 0;
+}
@@ -26,6 +26,8 @@ typedef struct {
   sMemfaultCborEncoder encoder;
   bool compute_worst_case_size;
   bool encode_success;
+  //! The metrics instance to serialize or NULL for the global metrics
+  sMfltMetricsCtx *metrics_ctx;
 } sMemfaultSerializerState;
 
 static bool prv_metric_heartbeat_writer(void *ctx, const sMemfaultMetricInfo *metric_info) {
@@ -66,7 +68,11 @@ static bool prv_serialize_latest_heartbeat_and_deinit(sMemfaultSerializerState *
     return false;
   }
 
-  if (!memfault_serializer_helper_encode_version_info(encoder)) {
+  const bool version_info_encoded = (state->metrics_ctx != NULL) ?
+      memfault_serializer_helper_encode_version_info_for_device(encoder,
+                                                                state->metrics_ctx->device_info) :
+      memfault_serializer_helper_encode_version_info(encoder);
+  if (!version_info_encoded) {
     goto cleanup;
   }
 
@@ -78,7 +84,11 @@ static bool prv_serialize_latest_heartbeat_and_deinit(sMemfaultSerializerState *
     goto cleanup;
   }
 
-  memfault_metrics_heartbeat_iterate(prv_metric_heartbeat_writer, state);
+  if (state->metrics_ctx != NULL) {
+    memfault_metrics_ctx_heartbeat_iterate(state->metrics_ctx, prv_metric_heartbeat_writer, state);
+  } else {
+    memfault_metrics_heartbeat_iterate(prv_metric_heartbeat_writer, state);
+  }
   success = state->encode_success;
 
 cleanup:
@@ -95,7 +105,13 @@ size_t memfault_metrics_heartbeat_compute_worst_case_storage_size(void) {
   return memfault_serializer_helper_compute_size(&state.encoder, prv_encode_cb, &state);
 }
 
-bool memfault_metrics_heartbeat_serialize(const sMemfaultEventStorageImpl *storage_impl) {
+size_t memfault_metrics_ctx_heartbeat_compute_worst_case_storage_size(sMfltMetricsCtx *ctx) {
+  sMemfaultSerializerState state = { .compute_worst_case_size = true, .metrics_ctx = ctx };
+  return memfault_serializer_helper_compute_size(&state.encoder, prv_encode_cb, &state);
+}
+
+static bool prv_heartbeat_serialize(const sMemfaultEventStorageImpl *storage_impl,
+                                    sMfltMetricsCtx *metrics_ctx) {
   // Build a heartbeat event, which looks like this:
   // {
   //    "type": "heartbeat",
@@ -112,7 +128,7 @@ bool memfault_metrics_heartbeat_serialize(const sMemfaultEventStorageImpl *stora
 
   // NOTE: We'll always attempt to serialize the heartbeat and rollback if we are out of space
   // avoiding the need to serialize the data twice
-  sMemfaultSerializerState state = { 0 };
+  sMemfaultSerializerState state = { .metrics_ctx = metrics_ctx };
   const bool success = memfault_serializer_helper_encode_to_storage(
       &state.encoder, storage_impl, prv_encode_cb, &state);
 
@@ -122,3 +138,11 @@ bool memfault_metrics_heartbeat_serialize(const sMemfaultEventStorageImpl *stora
 
   return success;
 }
+
+bool memfault_metrics_heartbeat_serialize(const sMemfaultEventStorageImpl *storage_impl) {
+  return prv_heartbeat_serialize(storage_impl, NULL);
+}
+
+bool memfault_metrics_ctx_heartbeat_serialize(sMfltMetricsCtx *ctx) {
+  return prv_heartbeat_serialize(ctx->storage_impl, ctx);
+}
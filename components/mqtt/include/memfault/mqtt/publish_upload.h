@@ -0,0 +1,159 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Publishes the data queued in the packetizer over an MQTT (3.1.1) connection the application
+//! already holds, for devices which talk to their backend over MQTT rather than HTTP.
+//!
+//! Every chunk is sent as a QoS 1 PUBLISH to "<topic_prefix>/<device_serial>/chunks". Several
+//! PUBLISHes are kept in flight at once, up to the configured window, so the round trip time of
+//! the link is paid once per window rather than once per chunk. A packetizer message is only
+//! deleted from its data source once every chunk it was split into has been acknowledged with a
+//! PUBACK (see sPacketizerConfig.enable_delivery_confirmation). If the connection is lost, the
+//! message is sent again in its entirety by the next upload.
+//!
+//! Chunks are read by the packetizer straight into the buffer the PUBLISH packet is sent from,
+//! behind room reserved for the fixed header, topic and packet identifier, so no copy of the
+//! chunk is made.
+//!
+//! The application owns the connection (CONNECT, keep alive, reconnects) and drives progress:
+//!
+//!   memfault_mqtt_upload_start(&s_upload, &cfg);
+//!   ... then, from the MQTT client:
+//!   - PUBACK received -> memfault_mqtt_upload_on_puback()
+//!   - connection lost -> memfault_mqtt_upload_on_disconnect()
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Size of the buffer PUBLISH packets are built in. It bounds the size of the chunks sent.
+#ifndef MEMFAULT_MQTT_UPLOAD_TX_BUF_SIZE
+#define MEMFAULT_MQTT_UPLOAD_TX_BUF_SIZE 512
+#endif
+
+//! The largest number of PUBLISH packets awaiting a PUBACK
+#ifndef MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT
+#define MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT 8
+#endif
+
+//! The first level of the topic chunks are published to, when none is configured
+#ifndef MEMFAULT_MQTT_DEFAULT_TOPIC_PREFIX
+#define MEMFAULT_MQTT_DEFAULT_TOPIC_PREFIX "memfault"
+#endif
+
+//! The largest topic the upload can publish to
+#define MEMFAULT_MQTT_MAX_TOPIC_LEN 128
+
+typedef enum MfltMqttUploadResult {
+  kMfltMqttUploadResult_Success = 0,
+  kMfltMqttUploadResult_SendError = -1,
+  //! memfault_mqtt_upload_on_disconnect() was called with PUBLISHes in flight
+  kMfltMqttUploadResult_Disconnected = -2,
+} eMfltMqttUploadResult;
+
+typedef struct MfltMqttUploadTransport {
+  //! Writes a packet to the connection of the MQTT client. The packet must have been written (or
+  //! copied) in its entirety by the time the function returns.
+  //!
+  //! @return 0 if the packet was sent, else error code
+  int (*send)(void *ctx, const void *packet, size_t packet_len);
+} sMfltMqttUploadTransport;
+
+typedef struct MfltMqttUpload sMfltMqttUpload;
+
+//! Invoked once the upload has completed
+//!
+//! @param upload The upload which completed
+//! @param result kMfltMqttUploadResult_Success if all the data was published and acknowledged,
+//!   else the reason the upload was stopped
+//! @param ctx The 'complete_ctx' provided in the upload configuration
+typedef void (*MfltMqttUploadCompleteCb)(sMfltMqttUpload *upload, eMfltMqttUploadResult result,
+                                         void *ctx);
+
+typedef enum MfltMqttUploadStartStatus {
+  kMfltMqttUploadStartStatus_Started = 0,
+  kMfltMqttUploadStartStatus_NoDataFound = 1,
+} eMfltMqttUploadStartStatus;
+
+typedef struct MfltMqttUploadConfig {
+  //! The first levels of the topic, NULL for MEMFAULT_MQTT_DEFAULT_TOPIC_PREFIX
+  const char *topic_prefix;
+  //! The number of PUBLISHes kept in flight, 0 for MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT. It should
+  //! not exceed the "Receive Maximum" of the broker.
+  size_t window_size;
+  const sMfltMqttUploadTransport *transport;
+  //! Passed to all the 'transport' operations
+  void *transport_ctx;
+  MfltMqttUploadCompleteCb complete_cb;
+  void *complete_ctx;
+} sMfltMqttUploadConfig;
+
+typedef struct MfltMqttUploadStats {
+  //! Messages whose chunks were all acknowledged
+  uint32_t num_messages;
+  //! PUBLISH packets sent and PUBACKs received for them
+  uint32_t num_publishes;
+  uint32_t num_pubacks;
+  //! Bytes of the PUBLISH packets sent, chunks included
+  uint32_t tx_bytes;
+} sMfltMqttUploadStats;
+
+struct MfltMqttUpload {
+  //! Counters accumulated over every upload made with this context
+  sMfltMqttUploadStats stats;
+  //! The packet identifier of the next PUBLISH. Identifiers carry on from one upload to the next
+  //! and 0 is skipped, as MQTT reserves it.
+  uint16_t next_packet_id;
+
+  // For internal use only
+  bool in_progress;
+  sMfltMqttUploadConfig cfg;
+  char topic[MEMFAULT_MQTT_MAX_TOPIC_LEN + 1];
+  size_t topic_len;
+  //! Room kept at the start of tx_buf for the largest header of a PUBLISH
+  size_t max_hdr_len;
+  //! Set once the last chunk of the current message has been published
+  bool msg_fully_sent;
+  size_t num_in_flight;
+  uint16_t in_flight_ids[MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT];
+  uint8_t tx_buf[MEMFAULT_MQTT_UPLOAD_TX_BUF_SIZE];
+};
+
+//! Starts publishing the data queued in the packetizer
+//!
+//! @param upload The upload context. It must be zero initialized before it is used for the first
+//!   time and remain valid until the upload completes. It can then be reused for the next upload.
+//! @param cfg The configuration of the upload
+//!
+//! @return kMfltMqttUploadStartStatus_Started if the upload was started,
+//!   kMfltMqttUploadStartStatus_NoDataFound if there is no data to send, else a negative error
+//!   code, i.e if the topic and the PUBLISH header don't leave room for a chunk in
+//!   MEMFAULT_MQTT_UPLOAD_TX_BUF_SIZE
+int memfault_mqtt_upload_start(sMfltMqttUpload *upload, const sMfltMqttUploadConfig *cfg);
+
+//! To be called with the packet identifier of every PUBACK the MQTT client receives
+//!
+//! @return true if the PUBACK acknowledged a PUBLISH of the upload, false if it belongs to
+//!   another publisher of the application
+bool memfault_mqtt_upload_on_puback(sMfltMqttUpload *upload, uint16_t packet_id);
+
+//! To be called when the connection of the MQTT client is lost. An upload in progress fails with
+//! kMfltMqttUploadResult_Disconnected and the message it was sending is sent again by the next
+//! upload.
+void memfault_mqtt_upload_on_disconnect(sMfltMqttUpload *upload);
+
+//! @return true if an upload is in progress
+bool memfault_mqtt_upload_in_progress(const sMfltMqttUpload *upload);
+
+#ifdef __cplusplus
+}
+#endif
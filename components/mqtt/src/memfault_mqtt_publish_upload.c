@@ -0,0 +1,218 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/mqtt/publish_upload.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "memfault/core/compiler.h"
+#include "memfault/core/data_packetizer.h"
+#include "memfault/core/debug_log.h"
+#include "memfault/core/errors.h"
+#include "memfault/core/math.h"
+#include "memfault/core/platform/device_info.h"
+
+// PUBLISH packet, see MQTT 3.1.1 section 3.3. QoS 1, no DUP and no RETAIN
+#define MQTT_PUBLISH_QOS1 0x32
+#define MQTT_MAX_REMAINING_LEN_BYTES 2
+
+MEMFAULT_STATIC_ASSERT(
+    MEMFAULT_MQTT_UPLOAD_TX_BUF_SIZE < (1 << (7 * MQTT_MAX_REMAINING_LEN_BYTES)),
+    "PUBLISH packets are built with at most 2 bytes of Remaining Length");
+
+//! @return the number of bytes the Remaining Length field takes to encode 'len'
+static size_t prv_remaining_len_size(size_t len) {
+  return (len < 128) ? 1 : 2;
+}
+
+static void prv_complete(sMfltMqttUpload *upload, eMfltMqttUploadResult result) {
+  if (result != kMfltMqttUploadResult_Success) {
+    MEMFAULT_LOG_ERROR("MQTT upload failed: rv=%d", (int)result);
+    // some chunks of the message may not have reached the broker, so it will be sent again by
+    // the next upload
+    memfault_packetizer_abort();
+  }
+
+  upload->in_progress = false;
+  upload->num_in_flight = 0;
+  if (upload->cfg.complete_cb != NULL) {
+    upload->cfg.complete_cb(upload, result, upload->cfg.complete_ctx);
+  }
+}
+
+//! Builds the PUBLISH header in front of the 'chunk_len' bytes the packetizer wrote at
+//! tx_buf[max_hdr_len] and sends the packet
+static bool prv_publish_chunk(sMfltMqttUpload *upload, size_t chunk_len) {
+  if (upload->next_packet_id == 0) {
+    upload->next_packet_id++;
+  }
+  const uint16_t packet_id = upload->next_packet_id++;
+
+  const size_t remaining_len = 2 + upload->topic_len + 2 + chunk_len;
+  const size_t hdr_len = 1 + prv_remaining_len_size(remaining_len) + 2 + upload->topic_len + 2;
+  uint8_t *packet = &upload->tx_buf[upload->max_hdr_len - hdr_len];
+
+  size_t offset = 0;
+  packet[offset++] = MQTT_PUBLISH_QOS1;
+  if (remaining_len < 128) {
+    packet[offset++] = (uint8_t)remaining_len;
+  } else {
+    packet[offset++] = (uint8_t)(0x80 | (remaining_len & 0x7f));
+    packet[offset++] = (uint8_t)(remaining_len >> 7);
+  }
+  packet[offset++] = (uint8_t)(upload->topic_len >> 8);
+  packet[offset++] = (uint8_t)(upload->topic_len & 0xff);
+  memcpy(&packet[offset], upload->topic, upload->topic_len);
+  offset += upload->topic_len;
+  packet[offset++] = (uint8_t)(packet_id >> 8);
+  packet[offset++] = (uint8_t)(packet_id & 0xff);
+
+  const size_t packet_len = hdr_len + chunk_len;
+  if (upload->cfg.transport->send(upload->cfg.transport_ctx, packet, packet_len) != 0) {
+    return false;
+  }
+  upload->in_flight_ids[upload->num_in_flight++] = packet_id;
+  upload->stats.num_publishes++;
+  upload->stats.tx_bytes += (uint32_t)packet_len;
+  return true;
+}
+
+//! Loads the next message from the packetizer
+//!
+//! @return false if there are no more messages to send
+static bool prv_begin_next_message(sMfltMqttUpload *upload) {
+  const sPacketizerConfig cfg = {
+    // every chunk is published on its own so it must be complete
+    .enable_multi_packet_chunk = false,
+    // only delete the message once all of its chunks have been acknowledged
+    .enable_delivery_confirmation = true,
+  };
+  sPacketizerMetadata metadata;
+  upload->msg_fully_sent = false;
+  return memfault_packetizer_begin(&cfg, &metadata);
+}
+
+//! Publishes chunks until the window is full or the upload completes
+static void prv_fill_window(sMfltMqttUpload *upload) {
+  const size_t window_size = upload->cfg.window_size;
+  while (upload->in_progress) {
+    if (upload->msg_fully_sent) {
+      if (upload->num_in_flight != 0) {
+        // the next message can only be read once this one has been deleted
+        return;
+      }
+      memfault_packetizer_confirm_delivery();
+      upload->stats.num_messages++;
+      if (!prv_begin_next_message(upload)) {
+        prv_complete(upload, kMfltMqttUploadResult_Success);
+        return;
+      }
+      continue;
+    }
+
+    if (upload->num_in_flight >= window_size) {
+      return;
+    }
+
+    size_t chunk_len = sizeof(upload->tx_buf) - upload->max_hdr_len;
+    const eMemfaultPacketizerStatus status =
+        memfault_packetizer_get_next(&upload->tx_buf[upload->max_hdr_len], &chunk_len);
+    if ((status == kMemfaultPacketizerStatus_NoMoreData) || (chunk_len == 0)) {
+      upload->msg_fully_sent = true;
+      continue;
+    }
+    if (!prv_publish_chunk(upload, chunk_len)) {
+      prv_complete(upload, kMfltMqttUploadResult_SendError);
+      return;
+    }
+  }
+}
+
+int memfault_mqtt_upload_start(sMfltMqttUpload *upload, const sMfltMqttUploadConfig *cfg) {
+  if ((upload == NULL) || (cfg == NULL) || (cfg->transport == NULL) ||
+      (cfg->window_size > MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT)) {
+    return MemfaultInternalReturnCode_InvalidInput;
+  }
+
+  if (memfault_mqtt_upload_in_progress(upload)) {
+    return MemfaultInternalReturnCode_Error;
+  }
+
+  sMemfaultDeviceInfo device_info;
+  memfault_platform_get_device_info(&device_info);
+  if (device_info.device_serial == NULL) {
+    return MemfaultInternalReturnCode_InvalidInput;
+  }
+  const char *topic_prefix =
+      (cfg->topic_prefix != NULL) ? cfg->topic_prefix : MEMFAULT_MQTT_DEFAULT_TOPIC_PREFIX;
+  char topic[MEMFAULT_MQTT_MAX_TOPIC_LEN + 1];
+  const int topic_len = snprintf(topic, sizeof(topic), "%s/%s/chunks", topic_prefix,
+                                 device_info.device_serial);
+  if ((topic_len < 0) || ((size_t)topic_len >= sizeof(topic))) {
+    return MemfaultInternalReturnCode_InvalidInput;
+  }
+
+  const size_t max_hdr_len = 1 + MQTT_MAX_REMAINING_LEN_BYTES + 2 + (size_t)topic_len + 2;
+  if ((max_hdr_len + MEMFAULT_PACKETIZER_MIN_BUF_LEN) > MEMFAULT_MQTT_UPLOAD_TX_BUF_SIZE) {
+    MEMFAULT_LOG_ERROR("PUBLISH header doesn't fit in MEMFAULT_MQTT_UPLOAD_TX_BUF_SIZE");
+    return MemfaultInternalReturnCode_InvalidInput;
+  }
+
+  if (!memfault_packetizer_data_available()) {
+    return kMfltMqttUploadStartStatus_NoDataFound;
+  }
+
+  *upload = (sMfltMqttUpload) {
+    .stats = upload->stats,
+    .next_packet_id = upload->next_packet_id,
+    .in_progress = true,
+    .cfg = *cfg,
+    .topic_len = (size_t)topic_len,
+    .max_hdr_len = max_hdr_len,
+  };
+  if (upload->cfg.window_size == 0) {
+    upload->cfg.window_size = MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT;
+  }
+  memcpy(upload->topic, topic, (size_t)topic_len + 1);
+
+  if (!prv_begin_next_message(upload)) {
+    prv_complete(upload, kMfltMqttUploadResult_Success);
+    return kMfltMqttUploadStartStatus_Started;
+  }
+  prv_fill_window(upload);
+  return kMfltMqttUploadStartStatus_Started;
+}
+
+bool memfault_mqtt_upload_on_puback(sMfltMqttUpload *upload, uint16_t packet_id) {
+  if (!memfault_mqtt_upload_in_progress(upload)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < upload->num_in_flight; i++) {
+    if (upload->in_flight_ids[i] != packet_id) {
+      continue;
+    }
+    // QoS 1 PUBACKs may arrive in any order, so the slot is simply refilled from the end
+    upload->in_flight_ids[i] = upload->in_flight_ids[--upload->num_in_flight];
+    upload->stats.num_pubacks++;
+    prv_fill_window(upload);
+    return true;
+  }
+  return false;
+}
+
+void memfault_mqtt_upload_on_disconnect(sMfltMqttUpload *upload) {
+  if (memfault_mqtt_upload_in_progress(upload)) {
+    prv_complete(upload, kMfltMqttUploadResult_Disconnected);
+  }
+}
+
+bool memfault_mqtt_upload_in_progress(const sMfltMqttUpload *upload) {
+  return upload->in_progress;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! A small policy engine which uses the crash count kept by the reboot tracking module (see
+//! reboot_tracking.h) to react to crash loops.
+//!
+//! When a device resets due to an error over and over, re-attempting a coredump on every crash
+//! wears out flash and uploading data on every boot wastes time which could be used to recover.
+//! Based on memfault_reboot_tracking_get_crash_count(), the policy:
+//!  - Backs off exponentially on coredump capture once the crash count exceeds
+//!    MEMFAULT_CRASH_LOOP_COREDUMP_BACKOFF_THRESHOLD
+//!  - Reports that non-essential boot work (i.e. posting data to Memfault) should be skipped once
+//!    the crash count reaches MEMFAULT_CRASH_LOOP_SKIP_BOOT_WORK_THRESHOLD
+//!  - Invokes memfault_platform_crash_loop_enter_safe_mode() on boot once the crash count
+//!    reaches MEMFAULT_CRASH_LOOP_SAFE_MODE_THRESHOLD
+//!
+//! @note The crash count is only cleared by memfault_reboot_tracking_reset_crash_count(). It's up
+//!   to the user of the SDK to call it once the system is considered healthy (i.e after it has
+//!   been up for some amount of time) so the policy returns to normal operation.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! The number of consecutive crashes for which a coredump is always captured. Past this, a
+//! coredump is only captured when the number of crashes beyond the threshold is a power of two
+#ifndef MEMFAULT_CRASH_LOOP_COREDUMP_BACKOFF_THRESHOLD
+#define MEMFAULT_CRASH_LOOP_COREDUMP_BACKOFF_THRESHOLD 2
+#endif
+
+//! The crash count at which non-essential boot work should be skipped
+#ifndef MEMFAULT_CRASH_LOOP_SKIP_BOOT_WORK_THRESHOLD
+#define MEMFAULT_CRASH_LOOP_SKIP_BOOT_WORK_THRESHOLD 3
+#endif
+
+//! The crash count at which the system is asked to enter a "safe mode"
+#ifndef MEMFAULT_CRASH_LOOP_SAFE_MODE_THRESHOLD
+#define MEMFAULT_CRASH_LOOP_SAFE_MODE_THRESHOLD 8
+#endif
+
+typedef enum MfltCrashLoopState {
+  //! No crash loop detected
+  kMfltCrashLoopState_Normal = 0,
+  //! The system is crash looping and non-essential boot work should be skipped
+  kMfltCrashLoopState_SkipBootWork,
+  //! The system has been crash looping for long enough that it should enter a safe mode
+  kMfltCrashLoopState_SafeMode,
+} eMfltCrashLoopState;
+
+//! @return the current state of the crash loop policy based on the crash count
+eMfltCrashLoopState memfault_crash_loop_policy_get_state(void);
+
+//! Evaluates the policy on boot and calls memfault_platform_crash_loop_enter_safe_mode() if the
+//! safe mode threshold has been reached
+//!
+//! @note Must be called after memfault_reboot_tracking_boot()
+//! @return the current state of the crash loop policy
+eMfltCrashLoopState memfault_crash_loop_policy_boot(void);
+
+//! Checks whether a coredump should be captured for the crash currently being handled
+//!
+//! This is called automatically from the Memfault fault handlers after the crash has been recorded
+//! with memfault_reboot_tracking_mark_reset_imminent() so the crash count includes the current
+//! crash.
+//!
+//! @return true if a coredump should be saved, false if the capture should be skipped
+bool memfault_crash_loop_policy_should_capture_coredump(void);
+
+//! @return true if non-essential boot work (i.e posting data to Memfault) should be run, false if
+//!   it should be skipped because the system is crash looping
+bool memfault_crash_loop_policy_should_run_boot_work(void);
+
+//! Called from memfault_crash_loop_policy_boot() when the crash count has reached
+//! MEMFAULT_CRASH_LOOP_SAFE_MODE_THRESHOLD
+//!
+//! @note A weak no-op version of this API is defined in memfault_crash_loop_policy.c. A platform
+//!   can override it to, for example, disable optional subsystems or boot a recovery image.
+//! @param crash_count The current crash count
+void memfault_platform_crash_loop_enter_safe_mode(size_t crash_count);
+
+#ifdef __cplusplus
+}
+#endif
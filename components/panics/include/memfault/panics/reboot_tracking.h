@@ -16,6 +16,10 @@
 //! tracking" module.  More details can be found in the function descriptions below or a
 //! step-by-step setup tutorial is available at https://mflt.io/2QlOlgH
 //!
+//! The last MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE resets are kept in the reboot tracking region
+//! until they are collected, so a device which reboots several times before it gets a chance to
+//! flush its event storage will still report each reset.
+//!
 //! A user may also (optionally) use two APIs for catching & reacting to reboot loops:
 //!  memfault_reboot_tracking_reset_crash_count()
 //!  memfault_reboot_tracking_get_crash_count()
@@ -39,7 +43,14 @@ typedef struct BootupInfo {
   uint32_t reset_reason_reg;
 } sResetBootupInfo;
 
-#define MEMFAULT_REBOOT_TRACKING_REGION_SIZE 64
+//! The number of resets which can be tracked before they are collected with
+//! memfault_reboot_tracking_collect_reset_info(). Once the history is full, the oldest reset is
+//! dropped to make room for the most recent one.
+#ifndef MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE
+#define MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE 4
+#endif
+
+#define MEMFAULT_REBOOT_TRACKING_REGION_SIZE (64 + (24 * MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE))
 
 //! Sets the memory region used for reboot tracking.
 //!
@@ -58,8 +69,9 @@ typedef struct BootupInfo {
 //!    .noinit (NOLOAD): { KEEP(*(*.mflt_reboot_info)) } > NOINIT
 //!
 //! @note The size of the region should be MEMFAULT_REBOOT_TRACKING_REGION_SIZE
-//! @note This should be called once on bootup of the system prior to making any other
-//!   reboot_tracking calls
+//! @note This should be called exactly once on bootup of the system prior to making any other
+//!   reboot_tracking calls. The reset which just took place is moved into the reboot history
+//!   at this time.
 //! @param start_addr The location where reboot tracking is located
 //! @param bootup_info See struct for more details. Can be NULL if there is no info
 //!  to provide
@@ -80,12 +92,16 @@ typedef struct MfltRebootTrackingRegInfo {
 //! to call the API in these scenarios
 //! @param reboot_reason The reason for the reboot. See eMfltResetReason for options
 //! @param reg Register state at the time the reboot was initiated or NULL if no state is available
+//! @note The time since boot recorded alongside the reset is read with
+//!   memfault_reboot_tracking_get_time_since_boot_ms()
 void memfault_reboot_tracking_mark_reset_imminent(eMfltResetReason reboot_reason,
                                                   const sMfltRebootTrackingRegInfo *reg);
 
 //! Collects recent reset info and pushes it to memfault_event_storage so that the data can
 //! can be sent out using the Memfault data packetizer
 //!
+//! @note All resets in the reboot history are serialized as a single event
+//!
 //! @param storage_impl The event storage implementation being used (returned from
 //!   memfault_events_storage_boot())
 //! @return 0 on success or if there was nothing to collect, error code otherwise
@@ -108,6 +124,16 @@ size_t memfault_reboot_tracking_get_crash_count(void);
 //! Reset the crash count to 0
 void memfault_reboot_tracking_reset_crash_count(void);
 
+//! Returns the time since boot which is recorded alongside a reset in the reboot history
+//!
+//! @note By default this function is defined as a weak symbol which returns 0 (uptime not
+//!   tracked). If memfault_platform_get_time_since_boot_ms() is available on the platform, this
+//!   function can be overridden to forward to it.
+//! @note This is called from memfault_reboot_tracking_mark_reset_imminent(), i.e from fault
+//!   handlers, so it must be safe to call with interrupts disabled and must not take any locks
+//!   or block
+uint64_t memfault_reboot_tracking_get_time_since_boot_ms(void);
+
 
 #ifdef __cplusplus
 }
@@ -42,7 +42,9 @@ typedef MEMFAULT_PACKED_STRUCT MfltTraceReasonBlock {
 typedef enum MfltCoredumpMachineType  {
   kMfltCoredumpMachineType_None = 0,
   kMfltCoredumpMachineType_ARM = 40,
+  kMfltCoredumpMachineType_X86_64 = 62,
   kMfltCoredumpMachineType_Xtensa = 94,
+  kMfltCoredumpMachineType_AArch64 = 183,
 } eMfltCoredumpMachineType;
 
 typedef MEMFAULT_PACKED_STRUCT MfltMachineTypeBlock {
@@ -111,6 +113,12 @@ static eMfltCoredumpMachineType prv_get_machine_type(void) {
   return kMfltCoredumpMachineType_ARM;
 #  elif defined(__XTENSA__)
   return kMfltCoredumpMachineType_Xtensa;
+#  elif defined(__x86_64__)
+  return kMfltCoredumpMachineType_X86_64;
+#  elif defined(__aarch64__)
+  return kMfltCoredumpMachineType_AArch64;
+#  elif defined(__unix__)
+  return kMfltCoredumpMachineType_None;
 #  else
 #    error "Coredumps are not supported for target architecture"
 #  endif
@@ -0,0 +1,65 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/panics/crash_loop_policy.h"
+
+#include "memfault/core/compiler.h"
+#include "memfault/core/debug_log.h"
+#include "memfault/panics/reboot_tracking.h"
+
+MEMFAULT_STATIC_ASSERT(MEMFAULT_CRASH_LOOP_SKIP_BOOT_WORK_THRESHOLD <=
+                       MEMFAULT_CRASH_LOOP_SAFE_MODE_THRESHOLD,
+                       "Boot work should be skipped before safe mode is entered");
+
+MEMFAULT_WEAK
+void memfault_platform_crash_loop_enter_safe_mode(MEMFAULT_UNUSED size_t crash_count) { }
+
+static bool prv_is_power_of_two(size_t value) {
+  return (value != 0) && ((value & (value - 1)) == 0);
+}
+
+eMfltCrashLoopState memfault_crash_loop_policy_get_state(void) {
+  const size_t crash_count = memfault_reboot_tracking_get_crash_count();
+  if (crash_count >= MEMFAULT_CRASH_LOOP_SAFE_MODE_THRESHOLD) {
+    return kMfltCrashLoopState_SafeMode;
+  }
+
+  if (crash_count >= MEMFAULT_CRASH_LOOP_SKIP_BOOT_WORK_THRESHOLD) {
+    return kMfltCrashLoopState_SkipBootWork;
+  }
+
+  return kMfltCrashLoopState_Normal;
+}
+
+eMfltCrashLoopState memfault_crash_loop_policy_boot(void) {
+  const eMfltCrashLoopState state = memfault_crash_loop_policy_get_state();
+  if (state == kMfltCrashLoopState_Normal) {
+    return state;
+  }
+
+  const size_t crash_count = memfault_reboot_tracking_get_crash_count();
+  MEMFAULT_LOG_WARN("Crash loop detected, %d consecutive crashes", (int)crash_count);
+  if (state == kMfltCrashLoopState_SafeMode) {
+    memfault_platform_crash_loop_enter_safe_mode(crash_count);
+  }
+  return state;
+}
+
+bool memfault_crash_loop_policy_should_capture_coredump(void) {
+  const size_t crash_count = memfault_reboot_tracking_get_crash_count();
+  if (crash_count <= MEMFAULT_CRASH_LOOP_COREDUMP_BACKOFF_THRESHOLD) {
+    return true;
+  }
+
+  // Exponential backoff: capture on the 1st, 2nd, 4th, 8th, ... crash past the threshold
+  return prv_is_power_of_two(crash_count - MEMFAULT_CRASH_LOOP_COREDUMP_BACKOFF_THRESHOLD);
+}
+
+bool memfault_crash_loop_policy_should_run_boot_work(void) {
+  return memfault_crash_loop_policy_get_state() == kMfltCrashLoopState_Normal;
+}
@@ -12,6 +12,7 @@
 #include "memfault/panics/arch/arm/cortex_m.h"
 #include "memfault/panics/coredump.h"
 #include "memfault/panics/coredump_impl.h"
+#include "memfault/panics/crash_loop_policy.h"
 #include "memfault_reboot_tracking_private.h"
 
 static eMfltResetReason s_crash_reason = kMfltRebootReason_Unknown;
@@ -143,7 +144,9 @@ void memfault_fault_handler(const sMfltRegState *regs, eMfltResetReason reason)
   };
   save_info.regions = memfault_platform_coredump_get_regions(&info, &save_info.num_regions);
 
-  const bool coredump_saved = memfault_coredump_save(&save_info);
+  // During a crash loop, coredump captures are backed off to save flash wear & boot time
+  const bool coredump_saved = memfault_crash_loop_policy_should_capture_coredump() &&
+      memfault_coredump_save(&save_info);
   if (coredump_saved) {
     memfault_reboot_tracking_mark_coredump_saved();
   }
@@ -8,6 +8,7 @@
 
 #include "memfault/core/platform/core.h"
 #include "memfault/panics/arch/xtensa/esp32.h"
+#include "memfault/panics/crash_loop_policy.h"
 #include "memfault/panics/reboot_tracking.h"
 #include "memfault_reboot_tracking_private.h"
 #include "memfault/panics/coredump.h"
@@ -55,7 +56,9 @@ void memfault_fault_handler(const sMfltRegState *regs, eMfltResetReason reason)
   };
   save_info.regions = memfault_platform_coredump_get_regions(&info, &save_info.num_regions);
 
-  const bool coredump_saved = memfault_coredump_save(&save_info);
+  // During a crash loop, coredump captures are backed off to save flash wear & boot time
+  const bool coredump_saved = memfault_crash_loop_policy_should_capture_coredump() &&
+      memfault_coredump_save(&save_info);
   if (coredump_saved) {
     memfault_reboot_tracking_mark_coredump_saved();
   }
@@ -19,13 +19,33 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
+#include "memfault/core/boot_profile.h"
 #include "memfault/core/compiler.h"
 #include "memfault/core/errors.h"
 
 #define MEMFAULT_REBOOT_INFO_MAGIC 0x21544252
 
-#define MEMFAULT_REBOOT_INFO_VERSION 2
+#define MEMFAULT_REBOOT_INFO_VERSION 3
+
+MEMFAULT_STATIC_ASSERT((MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE > 0) &&
+                       (MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE <= UINT8_MAX),
+                       "MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE must be between 1 and 255");
+
+//! A reset which took place but has not been collected yet
+typedef MEMFAULT_PACKED_STRUCT MfltRebootHistoryEntry {
+  uint32_t reason; // eMfltResetReason
+  uint32_t pc;
+  uint32_t lr;
+  uint32_t reset_reason_reg0;
+  uint32_t uptime_ms;
+  uint8_t coredump_saved;
+  uint8_t rsvd[3];
+} sMfltRebootHistoryEntry;
+
+MEMFAULT_STATIC_ASSERT(sizeof(sMfltRebootHistoryEntry) == 24,
+                       "history entry doesn't match expected size");
 
 typedef MEMFAULT_PACKED_STRUCT MfltRebootInfo {
   //! A cheap way to check if the data within the struct is valid
@@ -38,6 +58,8 @@ typedef MEMFAULT_PACKED_STRUCT MfltRebootInfo {
   uint8_t crash_count;
   uint8_t rsvd1[1];
   uint8_t coredump_saved;
+  //! The reset which is about to take place. These fields are moved into the history on the next
+  //! call to memfault_reboot_tracking_boot()
   uint32_t last_reboot_reason; // eMfltResetReason
   uint32_t pc;
   uint32_t lr;
@@ -47,21 +69,68 @@ typedef MEMFAULT_PACKED_STRUCT MfltRebootInfo {
   //! (where no coredump was saved or no user initiated reset took place). Examples
   //! of this include brown out resets (BORs) & hardware watchdog resets.
   uint32_t reset_reason_reg0;
+  //! Time since boot when the reset was flagged (saturates at UINT32_MAX)
+  uint32_t uptime_ms;
+  //! Index of the oldest entry in the history ring
+  uint8_t history_head;
+  //! Number of entries in the history ring which have not been collected yet
+  uint8_t history_count;
+  uint8_t rsvd3[2];
   // Reserved for future additions
-  uint32_t rsvd2[10];
+  uint32_t rsvd2[8];
+  //! Ring of the most recent resets, oldest entry first starting at history_head
+  sMfltRebootHistoryEntry history[MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE];
 } sMfltRebootInfo;
 
+MEMFAULT_STATIC_ASSERT(offsetof(sMfltRebootInfo, history) == 64,
+                       "fixed fields of struct don't match expected size");
 MEMFAULT_STATIC_ASSERT(sizeof(sMfltRebootInfo) == MEMFAULT_REBOOT_TRACKING_REGION_SIZE,
                        "struct doesn't match expected size");
 
 static sMfltRebootInfo *s_mflt_reboot_info;
 
+MEMFAULT_WEAK
+uint64_t memfault_reboot_tracking_get_time_since_boot_ms(void) {
+  return 0;
+}
+
+static void prv_clear_pending_reset(void) {
+  s_mflt_reboot_info->last_reboot_reason = 0;
+  s_mflt_reboot_info->coredump_saved = 0;
+  s_mflt_reboot_info->pc = 0;
+  s_mflt_reboot_info->lr = 0;
+  s_mflt_reboot_info->reset_reason_reg0 = 0;
+  s_mflt_reboot_info->uptime_ms = 0;
+}
+
+static void prv_clear_history(void) {
+  s_mflt_reboot_info->history_head = 0;
+  s_mflt_reboot_info->history_count = 0;
+  memset(s_mflt_reboot_info->history, 0x0, sizeof(s_mflt_reboot_info->history));
+}
+
+static void prv_increment_crash_count(void) {
+  // saturate rather than wrap so a long running crash loop is never mistaken for a healthy system
+  if (s_mflt_reboot_info->crash_count < UINT8_MAX) {
+    s_mflt_reboot_info->crash_count++;
+  }
+}
+
 static bool prv_check_or_init_struct(void) {
   if (s_mflt_reboot_info == NULL) {
     return false;
   }
 
   if (s_mflt_reboot_info->magic == MEMFAULT_REBOOT_INFO_MAGIC) {
+    if (s_mflt_reboot_info->version != MEMFAULT_REBOOT_INFO_VERSION) {
+      // A region written by an older version of the SDK. The fields up to reset_reason_reg0 are
+      // unchanged so keep them but start with an empty history
+      s_mflt_reboot_info->version = MEMFAULT_REBOOT_INFO_VERSION;
+      s_mflt_reboot_info->uptime_ms = 0;
+      memset(s_mflt_reboot_info->rsvd3, 0x0, sizeof(s_mflt_reboot_info->rsvd3));
+      memset(s_mflt_reboot_info->rsvd2, 0x0, sizeof(s_mflt_reboot_info->rsvd2));
+      prv_clear_history();
+    }
     return true;
   }
 
@@ -73,18 +142,59 @@ static bool prv_check_or_init_struct(void) {
   return true;
 }
 
-static bool prv_read_reset_info(sMfltResetReasonInfo *info) {
+//! Moves the reset which just took place into the history ring, dropping the oldest entry if the
+//! ring is full
+static void prv_record_pending_reset(void) {
   if ((s_mflt_reboot_info->last_reboot_reason == 0) &&
       (s_mflt_reboot_info->reset_reason_reg0 == 0)) {
-    return false; // no reset crashes!
+    prv_clear_pending_reset();
+    return; // nothing to record
   }
 
-  *info = (sMfltResetReasonInfo) {
-    .reason = (eMfltResetReason)s_mflt_reboot_info->last_reboot_reason,
+  const size_t history_size = MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE;
+  if ((s_mflt_reboot_info->history_head >= history_size) ||
+      (s_mflt_reboot_info->history_count > history_size)) {
+    // the region survived with a valid magic but the ring indices are corrupt (or were written by
+    // a build configured with a larger history), there is nothing we can trust in it
+    prv_clear_history();
+  }
+
+  size_t idx = (s_mflt_reboot_info->history_head + s_mflt_reboot_info->history_count) %
+      history_size;
+  if (s_mflt_reboot_info->history_count == history_size) {
+    idx = s_mflt_reboot_info->history_head;
+    s_mflt_reboot_info->history_head = (uint8_t)((idx + 1) % history_size);
+  } else {
+    s_mflt_reboot_info->history_count++;
+  }
+
+  s_mflt_reboot_info->history[idx] = (sMfltRebootHistoryEntry) {
+    .reason = s_mflt_reboot_info->last_reboot_reason,
     .pc = s_mflt_reboot_info->pc,
     .lr = s_mflt_reboot_info->lr,
     .reset_reason_reg0 = s_mflt_reboot_info->reset_reason_reg0,
-    .coredump_saved = s_mflt_reboot_info->coredump_saved == 1,
+    .uptime_ms = s_mflt_reboot_info->uptime_ms,
+    .coredump_saved = s_mflt_reboot_info->coredump_saved,
+  };
+
+  prv_clear_pending_reset();
+}
+
+static bool prv_read_reset_info(size_t index, sMfltResetReasonInfo *info) {
+  if (index >= s_mflt_reboot_info->history_count) {
+    return false; // no reset crashes!
+  }
+
+  const size_t idx = (s_mflt_reboot_info->history_head + index) %
+      MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE;
+  const sMfltRebootHistoryEntry *entry = &s_mflt_reboot_info->history[idx];
+  *info = (sMfltResetReasonInfo) {
+    .reason = (eMfltResetReason)entry->reason,
+    .pc = entry->pc,
+    .lr = entry->lr,
+    .reset_reason_reg0 = entry->reset_reason_reg0,
+    .uptime_ms = entry->uptime_ms,
+    .coredump_saved = entry->coredump_saved == 1,
   };
 
   return true;
@@ -94,22 +204,23 @@ void memfault_reboot_tracking_boot(
     void *start_addr, const sResetBootupInfo *bootup_info) {
   s_mflt_reboot_info = start_addr;
 
-  if (start_addr == NULL) {
-    return;
-  }
-
   if (!prv_check_or_init_struct()) {
+    // no reboot tracking region, but we can still profile the boot
+    memfault_boot_profile_start(0);
     return;
   }
 
   // If the device rebooted, a reason _should_ already be set
   if (s_mflt_reboot_info->last_reboot_reason == 0) {
-    s_mflt_reboot_info->crash_count++;
+    prv_increment_crash_count();
   }
 
   if (bootup_info != NULL) {
     s_mflt_reboot_info->reset_reason_reg0 = bootup_info->reset_reason_reg;
   }
+
+  memfault_boot_profile_start(s_mflt_reboot_info->uptime_ms);
+  prv_record_pending_reset();
 }
 
 void memfault_reboot_tracking_mark_reset_imminent(eMfltResetReason reboot_reason,
@@ -119,7 +230,7 @@ void memfault_reboot_tracking_mark_reset_imminent(eMfltResetReason reboot_reason
   }
 
   if (reboot_reason >= kMfltRebootReason_UnknownError) {
-    s_mflt_reboot_info->crash_count++;
+    prv_increment_crash_count();
   }
 
   if (s_mflt_reboot_info->last_reboot_reason != 0) {
@@ -128,6 +239,10 @@ void memfault_reboot_tracking_mark_reset_imminent(eMfltResetReason reboot_reason
     return;
   }
   s_mflt_reboot_info->last_reboot_reason = reboot_reason;
+
+  const uint64_t uptime_ms = memfault_reboot_tracking_get_time_since_boot_ms();
+  s_mflt_reboot_info->uptime_ms = (uptime_ms > UINT32_MAX) ? UINT32_MAX : (uint32_t)uptime_ms;
+
   if (reg == NULL) { // we don't have any extra metadata
     return;
   }
@@ -145,7 +260,19 @@ bool memfault_reboot_tracking_read_reset_info(sMfltResetReasonInfo *info) {
     return false;
   }
 
-  return prv_read_reset_info(info);
+  return prv_read_reset_info(0, info);
+}
+
+bool memfault_reboot_tracking_read_reset_history(size_t index, sMfltResetReasonInfo *info) {
+  if (info == NULL) {
+    return false;
+  }
+
+  if (!prv_check_or_init_struct()) {
+    return false;
+  }
+
+  return prv_read_reset_info(index, info);
 }
 
 void memfault_reboot_tracking_reset_crash_count(void) {
@@ -169,11 +296,8 @@ void memfault_reboot_tracking_clear_reset_info(void) {
     return;
   }
 
-  s_mflt_reboot_info->last_reboot_reason = 0;
-  s_mflt_reboot_info->coredump_saved = 0;
-  s_mflt_reboot_info->pc = 0;
-  s_mflt_reboot_info->lr = 0;
-  s_mflt_reboot_info->reset_reason_reg0 = 0;
+  prv_clear_pending_reset();
+  prv_clear_history();
 }
 
 void memfault_reboot_tracking_mark_coredump_saved(void) {
@@ -10,6 +10,7 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "memfault/panics/reboot_tracking.h"
 
@@ -22,17 +23,29 @@ typedef struct MfltResetReasonInfo {
   uint32_t pc;
   uint32_t lr;
   uint32_t reset_reason_reg0;
+  //! Time since boot when the reset was flagged or 0 if unknown
+  uint32_t uptime_ms;
   bool coredump_saved;
 } sMfltResetReasonInfo;
 
-//! Clears any crash information which was stored
+//! Clears any crash information which was stored, including the reboot history
 void memfault_reboot_tracking_clear_reset_info(void);
 
 //! Flag that there is also a coredump associated with this reset
 void memfault_reboot_tracking_mark_coredump_saved(void);
 
+//! Reads the oldest reset in the reboot history
+//!
+//! @return true if a reset was found, false otherwise
 bool memfault_reboot_tracking_read_reset_info(sMfltResetReasonInfo *info);
 
+//! Reads a reset from the reboot history
+//!
+//! @param index The entry to read where 0 is the oldest reset which has not yet been collected
+//! @param info Populated with the reset information when an entry is found
+//! @return true if a reset was found at index, false otherwise
+bool memfault_reboot_tracking_read_reset_history(size_t index, sMfltResetReasonInfo *info);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,7 +5,7 @@
 //!
 //! @brief
 //! Reads the current reboot tracking information and converts it into an "trace" event which can
-//! be sent to the Memfault cloud
+//! be sent to the Memfault cloud. All resets in the reboot history are serialized as one event
 
 #include "memfault_reboot_tracking_private.h"
 
@@ -23,20 +23,37 @@
 #define MEMFAULT_REBOOT_TRACKING_BAD_PARAM (-1)
 #define MEMFAULT_REBOOT_TRACKING_STORAGE_TOO_SMALL (-2)
 
-static bool prv_serialize_reboot_info(sMemfaultCborEncoder *e,
-                                      const sMfltResetReasonInfo *info) {
-  const size_t extra_event_info_pairs = 1 /* coredump_saved */ +
-                                        ((info->reset_reason_reg0 != 0) ? 1 : 0);
-  const sMemfaultTraceEventHelperInfo helper_info = {
-      .reason_key = kMemfaultTraceInfoEventKey_Reason,
-      .reason_value = info->reason,
-      .pc = info->pc,
-      .lr = info->lr,
-      .extra_event_info_pairs = extra_event_info_pairs,
-  };
-  bool success = memfault_serializer_helper_encode_trace_event(e, &helper_info);
+typedef struct {
+  //! Number of resets from the history to serialize
+  size_t num_resets;
+  //! When true, every reset is encoded with maximal values rather than being read from the
+  //! history. Used to compute the worst case encoding size
+  bool worst_case;
+} sMfltRebootTrackingSerializeCtx;
+
+static void prv_get_reset_info(const sMfltRebootTrackingSerializeCtx *ctx, size_t index,
+                               sMfltResetReasonInfo *info) {
+  if (ctx->worst_case) {
+    // a reset reason with maximal values so we can compute the worst case encoding size
+    *info = (sMfltResetReasonInfo) {
+      .reason = kMfltRebootReason_HardFault,
+      .pc = UINT32_MAX,
+      .lr = UINT32_MAX,
+      .reset_reason_reg0 = UINT32_MAX,
+      .uptime_ms = UINT32_MAX,
+      .coredump_saved = 1,
+    };
+    return;
+  }
 
-  if (success && info->reset_reason_reg0) {
+  if (!memfault_reboot_tracking_read_reset_history(index, info)) {
+    *info = (sMfltResetReasonInfo) { 0 };
+  }
+}
+
+static bool prv_encode_optional_info(sMemfaultCborEncoder *e, const sMfltResetReasonInfo *info) {
+  bool success = true;
+  if (info->reset_reason_reg0) {
     success = memfault_serializer_helper_encode_uint32_kv_pair(e,
         kMemfaultTraceInfoEventKey_McuReasonRegister, info->reset_reason_reg0);
   }
@@ -46,26 +63,104 @@ static bool prv_serialize_reboot_info(sMemfaultCborEncoder *e,
         e, kMemfaultTraceInfoEventKey_CoredumpSaved, info->coredump_saved);
   }
 
+  if (success && info->uptime_ms) {
+    success = memfault_serializer_helper_encode_uint32_kv_pair(
+        e, kMemfaultTraceInfoEventKey_UptimeMs, info->uptime_ms);
+  }
+
   return success;
 }
 
-static bool prv_encode_cb(sMemfaultCborEncoder *encoder, void *ctx) {
-  const sMfltResetReasonInfo *info = (const sMfltResetReasonInfo *)ctx;
-  return prv_serialize_reboot_info(encoder, info);
+static size_t prv_num_optional_info_pairs(const sMfltResetReasonInfo *info) {
+  return 1 /* coredump_saved */ +
+         ((info->reset_reason_reg0 != 0) ? 1 : 0) +
+         ((info->uptime_ms != 0) ? 1 : 0);
 }
 
-size_t memfault_reboot_tracking_compute_worst_case_storage_size(void) {
-  // a reset reason with maximal values so we can compute the worst case encoding size
-  sMfltResetReasonInfo reset_reason = {
-    .reason = kMfltRebootReason_HardFault,
-    .pc = UINT32_MAX,
-    .lr = UINT32_MAX,
-    .reset_reason_reg0 = UINT32_MAX,
-    .coredump_saved = 1,
+//! Encodes a reset which followed the first one as an entry of the reboot history array. The keys
+//! used match the ones used for the event_info of the trace event itself.
+static bool prv_serialize_reboot_history_entry(sMemfaultCborEncoder *e,
+                                               const sMfltResetReasonInfo *info) {
+  const size_t num_pairs = 1 /* reason */ +
+                           ((info->pc != 0) ? 1 : 0) +
+                           ((info->lr != 0) ? 1 : 0) +
+                           prv_num_optional_info_pairs(info);
+  if (!memfault_cbor_encode_dictionary_begin(e, num_pairs) ||
+      !memfault_serializer_helper_encode_uint32_kv_pair(
+          e, kMemfaultTraceInfoEventKey_Reason, info->reason)) {
+    return false;
+  }
+
+  bool success = true;
+  if (info->pc) {
+    success = memfault_serializer_helper_encode_uint32_kv_pair(e,
+        kMemfaultTraceInfoEventKey_ProgramCounter, info->pc);
+  }
+
+  if (success && info->lr) {
+    success = memfault_serializer_helper_encode_uint32_kv_pair(e,
+        kMemfaultTraceInfoEventKey_LinkRegister, info->lr);
+  }
+
+  return success && prv_encode_optional_info(e, info);
+}
+
+//! The oldest reset is encoded as a regular trace event. Any resets which took place afterward
+//! are appended to the event_info as an array under kMemfaultTraceInfoEventKey_RebootHistory
+static bool prv_serialize_reboot_info(sMemfaultCborEncoder *e,
+                                      const sMfltRebootTrackingSerializeCtx *ctx) {
+  sMfltResetReasonInfo info;
+  prv_get_reset_info(ctx, 0, &info);
+
+  const size_t num_history_entries = ctx->num_resets - 1;
+  const size_t extra_event_info_pairs = prv_num_optional_info_pairs(&info) +
+                                        ((num_history_entries != 0) ? 1 : 0);
+  const sMemfaultTraceEventHelperInfo helper_info = {
+      .reason_key = kMemfaultTraceInfoEventKey_Reason,
+      .reason_value = info.reason,
+      .pc = info.pc,
+      .lr = info.lr,
+      .extra_event_info_pairs = extra_event_info_pairs,
   };
+  bool success = memfault_serializer_helper_encode_trace_event(e, &helper_info) &&
+      prv_encode_optional_info(e, &info);
+
+  if (!success || (num_history_entries == 0)) {
+    return success;
+  }
+
+  if (!memfault_cbor_encode_unsigned_integer(e, kMemfaultTraceInfoEventKey_RebootHistory) ||
+      !memfault_cbor_encode_array_begin(e, num_history_entries)) {
+    return false;
+  }
+
+  for (size_t i = 1; i < ctx->num_resets; i++) {
+    prv_get_reset_info(ctx, i, &info);
+    if (!prv_serialize_reboot_history_entry(e, &info)) {
+      return false;
+    }
+  }
+
+  return true;
+}
 
+static bool prv_encode_cb(sMemfaultCborEncoder *encoder, void *ctx) {
+  const sMfltRebootTrackingSerializeCtx *serialize_ctx =
+      (const sMfltRebootTrackingSerializeCtx *)ctx;
+  return prv_serialize_reboot_info(encoder, serialize_ctx);
+}
+
+static size_t prv_compute_size(const sMfltRebootTrackingSerializeCtx *ctx) {
   sMemfaultCborEncoder encoder = { 0 };
-  return memfault_serializer_helper_compute_size(&encoder, prv_encode_cb, &reset_reason);
+  return memfault_serializer_helper_compute_size(&encoder, prv_encode_cb, (void *)ctx);
+}
+
+size_t memfault_reboot_tracking_compute_worst_case_storage_size(void) {
+  const sMfltRebootTrackingSerializeCtx ctx = {
+    .num_resets = MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE,
+    .worst_case = true,
+  };
+  return prv_compute_size(&ctx);
 }
 
 int  memfault_reboot_tracking_collect_reset_info(const sMemfaultEventStorageImpl *impl) {
@@ -79,17 +174,34 @@ int  memfault_reboot_tracking_collect_reset_info(const sMemfaultEventStorageImpl
   // code if the event could not be stored. This line is here to give the user
   // an idea of how they should size things
 
+  sMfltRebootTrackingSerializeCtx ctx = { 0 };
   sMfltResetReasonInfo info;
-  if (!memfault_reboot_tracking_read_reset_info(&info)) {
+  while (memfault_reboot_tracking_read_reset_history(ctx.num_resets, &info)) {
+    ctx.num_resets++;
+  }
+
+  if (ctx.num_resets == 0) {
     return 0;
   }
 
+  // An event which can never fit would leave the history in place forever and new resets would
+  // push out the oldest ones on every boot. Drop the most recent resets from the event until it
+  // fits, down to the oldest reset alone since it generally reveals what started a crash loop
+  const size_t storage_max_size = memfault_serializer_helper_get_storage_size(impl);
+  const size_t num_resets = ctx.num_resets;
+  while ((ctx.num_resets > 1) && (prv_compute_size(&ctx) > storage_max_size)) {
+    ctx.num_resets--;
+  }
+  if (ctx.num_resets != num_resets) {
+    MEMFAULT_LOG_WARN("Event storage (%d) too small for reboot history, dropping %d resets",
+                      (int)storage_max_size, (int)(num_resets - ctx.num_resets));
+  }
+
   sMemfaultCborEncoder encoder = { 0 };
   const bool success = memfault_serializer_helper_encode_to_storage(
-      &encoder, impl, prv_encode_cb, &info);
+      &encoder, impl, prv_encode_cb, &ctx);
 
   if (!success) {
-    const size_t storage_max_size = impl->get_storage_size_cb();
     const size_t worst_case_size_needed =
         memfault_reboot_tracking_compute_worst_case_storage_size();
     MEMFAULT_LOG_WARN("Event storage (%d) smaller than largest reset reason (%d)",
@@ -23,6 +23,9 @@ extern "C" {
 //! The minimum buffer size required to generate a chunk.
 #define MEMFAULT_MIN_CHUNK_BUF_LEN 9
 
+//! The largest number of data chunks a parity chunk can protect, see fec_group_size
+#define MEMFAULT_CHUNK_TRANSPORT_MAX_FEC_GROUP_SIZE 16
+
 //! Callback invoked by the chunking transport to read a piece of a message
 //!
 //! By using a callback, we avoid requiring that the entire message ever need to be allocated in
@@ -36,6 +39,11 @@ extern "C" {
 typedef void (MfltChunkTransportMsgReaderCb)(uint32_t offset, void *buf,
                                              size_t buf_len);
 
+//! A variant of MfltChunkTransportMsgReaderCb which is passed the read_msg_ctx of the
+//! sMfltChunkTransportCtx being chunked, i.e the instance the message is read from
+typedef void (MfltChunkTransportCtxMsgReaderCb)(void *ctx, uint32_t offset, void *buf,
+                                                size_t buf_len);
+
 //! Context used to hold the state of the current message being chunked
 typedef struct {
   // Input Arguments
@@ -44,10 +52,26 @@ typedef struct {
   uint32_t total_size;
   //! A callback for reading portions of the message to be sent
   MfltChunkTransportMsgReaderCb *read_msg;
+  //! Used instead of read_msg when set, invoked with read_msg_ctx
+  MfltChunkTransportCtxMsgReaderCb *ctx_read_msg;
+  void *read_msg_ctx;
   //! Instead of having a "chunk" span one call, allow for a chunk to span across multiple calls to
   //! this API. This is an optimization that allows us to send messages across "one" chunk if the
   //! transport does not have any size restrictions
   bool enable_multi_call_chunk;
+  //! Forward error correction for links which lose chunks and can't retransmit them. When
+  //! non-zero, a parity chunk (the XOR of the data chunks) follows every 'fec_group_size' data
+  //! chunks and the last data chunk of the message, so a receiver can rebuild one lost chunk per
+  //! group. At most MEMFAULT_CHUNK_TRANSPORT_MAX_FEC_GROUP_SIZE. Ignored when
+  //! enable_multi_call_chunk is set.
+  //!
+  //! @note Parity chunks are not understood by the Memfault cloud. They must be consumed by the
+  //! receiving end of the link (i.e a gateway), which forwards the reassembled messages.
+  uint8_t fec_group_size;
+  //! Scratch space the parity of a group is accumulated in. The data of each chunk is limited to
+  //! its size so it must be provided when fec_group_size is non-zero.
+  uint8_t *fec_parity_buf;
+  size_t fec_parity_buf_len;
 
   // Output Arguments
 
@@ -58,6 +82,12 @@ typedef struct {
   //! A CRC computed over the data (up to read_offset). The CRC for the entire message is written
   //! at the end of the last chunk that makes up a message.
   uint16_t crc16_incremental;
+  //! The group of data chunks the parity in fec_parity_buf covers
+  uint32_t fec_group_start;
+  uint8_t fec_group_num_chunks;
+  size_t fec_parity_len;
+  //! true if the parity chunk of the group is sent by the next call
+  bool fec_parity_pending;
 } sMfltChunkTransportCtx;
 
 //! Takes a message and chunks it up into smaller messages
@@ -72,6 +102,27 @@ typedef struct {
 bool memfault_chunk_transport_get_next_chunk(sMfltChunkTransportCtx *ctx,
                                              void *buf, size_t *buf_len);
 
+//! Regenerates the chunk which starts at 'offset' within the message, i.e to resend a chunk the
+//! transport lost without starting the message over
+//!
+//! Only the data of the chunk is read again (read_msg must support reading at any offset) and
+//! the state of the context is left untouched, so memfault_chunk_transport_get_next_chunk()
+//! carries on where it left off. When 'buf_len' matches the one the chunk was first generated
+//! with, the regenerated chunk is identical to the original.
+//!
+//! @param ctx The context tracking this chunking operation
+//! @param offset The offset of the chunk: 0 for the INIT chunk or the offset encoded in a
+//!   CONTINUATION chunk. Must not be past the data chunked so far (read_offset).
+//! @param buf The buffer to copy the chunk into
+//! @param[in,out] buf_len The size of the buffer. On return, populated with the size of the chunk
+//!
+//! @note Parity chunks (see fec_group_size) can't be regenerated, nor can chunks when
+//! enable_multi_call_chunk is set
+//!
+//! @return true if the chunk was regenerated, false otherwise
+bool memfault_chunk_transport_get_chunk_at_offset(sMfltChunkTransportCtx *ctx, uint32_t offset,
+                                                  void *buf, size_t *buf_len);
+
 //! Computes info about the current chunk being operated on and populates the output arguments of
 //! sMfltChunkTransportCtx with the info
 void memfault_chunk_transport_get_chunk_info(sMfltChunkTransportCtx *ctx);
@@ -0,0 +1,96 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! A small streaming encoder producing the "zlib" format (RFC 1950 wrapping a RFC 1951 deflate
+//! stream), which is what a HTTP "Content-Encoding: deflate" body holds.
+//!
+//! The encoder is tuned for MCUs rather than compression ratio:
+//!  - Matches are searched for in a sliding window of MEMFAULT_DEFLATE_WINDOW_SIZE bytes using a
+//!    single entry hash table (no hash chains, no lazy matching)
+//!  - Matches and literals are encoded with the fixed Huffman codes from the spec so no code
+//!    tables have to be built or sent
+//! The whole state lives in sMemfaultDeflateEncoder, about 2 * MEMFAULT_DEFLATE_WINDOW_SIZE +
+//! 2 * (1 << MEMFAULT_DEFLATE_HASH_BITS) bytes, and no memory is allocated.
+//!
+//! Data such as CBOR encoded events, where the same keys and strings (i.e the device serial and
+//! software version) repeat from one message to the next, typically shrinks by half or more.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! The distance back in the stream at which matches are searched for. Must be a power of two
+//! between 512 and 16384
+#ifndef MEMFAULT_DEFLATE_WINDOW_SIZE
+#define MEMFAULT_DEFLATE_WINDOW_SIZE 1024
+#endif
+
+//! log2 of the number of entries in the hash table used to find matches
+#ifndef MEMFAULT_DEFLATE_HASH_BITS
+#define MEMFAULT_DEFLATE_HASH_BITS 9
+#endif
+
+//! Called with the encoded output
+//!
+//! @return true if the data was written, false otherwise. On failure, the encoder stops writing.
+typedef bool (*MemfaultDeflateWriteCb)(void *ctx, const void *data, size_t data_len);
+
+typedef struct {
+  //! true if a call to the write callback has failed
+  bool write_error;
+  //! The number of bytes which have been written to the callback
+  size_t total_out;
+
+  // For internal use only
+  MemfaultDeflateWriteCb write_cb;
+  void *write_ctx;
+  uint32_t adler_a;
+  uint32_t adler_b;
+  uint32_t bit_buf;
+  uint32_t bit_count;
+  //! The number of bytes in 'window' and the offset of the next one to encode
+  uint32_t window_len;
+  uint32_t window_pos;
+  //! 1 + offset in 'window' of the last position with a given hash, 0 if empty
+  uint16_t hash_head[1 << MEMFAULT_DEFLATE_HASH_BITS];
+  uint8_t window[2 * MEMFAULT_DEFLATE_WINDOW_SIZE];
+  uint8_t out_buf[32];
+  uint32_t out_len;
+} sMemfaultDeflateEncoder;
+
+//! Starts a new stream
+//!
+//! @param encoder The encoder to initialize
+//! @param write_cb Called with the encoded output
+//! @param ctx Passed to every invocation of 'write_cb'
+void memfault_deflate_encoder_init(sMemfaultDeflateEncoder *encoder,
+                                   MemfaultDeflateWriteCb write_cb, void *ctx);
+
+//! Feeds data to compress into the stream. The output lags behind the input since data is only
+//! encoded once enough follows it to look for a match.
+//!
+//! @return false if the write callback has failed, true otherwise
+bool memfault_deflate_encoder_write(sMemfaultDeflateEncoder *encoder, const void *data,
+                                    size_t data_len);
+
+//! Encodes any data left and terminates the stream
+//!
+//! @return false if the write callback has failed, true otherwise
+bool memfault_deflate_encoder_finish(sMemfaultDeflateEncoder *encoder);
+
+//! @return the largest size the stream can grow to when compressing 'data_len' bytes. Data which
+//!   doesn't compress costs up to 9 bits per byte plus the framing.
+size_t memfault_deflate_max_encoded_size(size_t data_len);
+
+#ifdef __cplusplus
+}
+#endif
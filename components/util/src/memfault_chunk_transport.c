@@ -16,6 +16,14 @@
 //!
 //! CONTINUATION Message:
 //!   HEADER_BYTE || varint(OFFSET) || CHUNK_DATA || (HEADER_BYTE.MD ? 0b"" : CRC_16_CCITT)
+//!
+//! PARITY Message (only sent when forward error correction is enabled, see fec_group_size):
+//!   HEADER_BYTE || varint(GROUP_START) || varint(GROUP_END) || NUM_CHUNKS ||
+//!     XOR(CHUNK_DATA of the group) || (HEADER_BYTE.MD ? 0b"" : CRC_16_CCITT)
+//!
+//!    NOTE: The XOR is as long as the longest CHUNK_DATA of the group, shorter ones are treated
+//!          as zero padded. The parity of the last group has MD cleared and repeats the CRC16 so
+//!          the last data chunk can be rebuilt as well.
 
 #include "memfault/util/chunk_transport.h"
 
@@ -30,8 +38,19 @@
 typedef struct {
   bool md;
   bool continuation;
+  bool fec;
+  bool parity;
 } sMemfaultHeaderSettings;
 
+static void prv_read_msg(const sMfltChunkTransportCtx *ctx, uint32_t offset, void *buf,
+                         size_t buf_len) {
+  if (ctx->ctx_read_msg != NULL) {
+    ctx->ctx_read_msg(ctx->read_msg_ctx, offset, buf, buf_len);
+  } else {
+    ctx->read_msg(offset, buf, buf_len);
+  }
+}
+
 static uint8_t prv_build_hdr(const sMemfaultHeaderSettings *settings) {
   // bits 0-2: channel id (0 - 7) Always 0 at the moment but reserved for future where we want
   //           prioritization
@@ -41,8 +60,12 @@ static uint8_t prv_build_hdr(const sMemfaultHeaderSettings *settings) {
   //            0b001 indicates crc16 is written at the end of the last chunk which makes up the msg
   //            Remaing Values: Reserved for future use
   //           For CONTINUATION:
-  //            All zeros. Reserved for future use (i.e. to make TOTAL_LENGTH and CRC16_CCITT
-  //            optional)
+  //            0b000 for messages sent without forward error correction
+  //           For both, when forward error correction is enabled:
+  //            bit 4 is set on every chunk of the message
+  //            bit 5 is set on PARITY chunks (which are always CONTINUATION chunks)
+  //           Remaining Values: Reserved for future use (i.e. to make TOTAL_LENGTH and
+  //           CRC16_CCITT optional)
   // bit 6:    MD: 1 if a CONTINUATION will follow (more data) or 0 if this is the last chunk of this
   //           message.  Right now I'm only using it to conditionally include the TOTAL_LENGTH. But
   //           I think it could also be useful as a trigger for the consumer to run a
@@ -56,6 +79,12 @@ static uint8_t prv_build_hdr(const sMemfaultHeaderSettings *settings) {
   if (!settings->continuation) {
     hdr |= 1 << 3;
   }
+  if (settings->fec) {
+    hdr |= 1 << 4;
+  }
+  if (settings->parity) {
+    hdr |= 1 << 5;
+  }
   return hdr;
 }
 
@@ -67,6 +96,101 @@ static size_t prv_compute_single_message_chunk_size(sMfltChunkTransportCtx *ctx)
   return 1 /* hdr */ + 2 /* crc16 */ + ctx->total_size;
 }
 
+static bool prv_fec_enabled(const sMfltChunkTransportCtx *ctx) {
+  return (ctx->fec_group_size != 0) && !ctx->enable_multi_call_chunk &&
+      (ctx->fec_parity_buf != NULL) && (ctx->fec_parity_buf_len != 0);
+}
+
+//! @return the largest number of bytes a chunk of the message needs on top of its data when
+//! forward error correction is enabled. A PARITY chunk needs the most.
+static size_t prv_fec_chunk_overhead(const sMfltChunkTransportCtx *ctx) {
+  uint8_t varint[MEMFAULT_UINT32_MAX_VARINT_LENGTH];
+  const size_t varint_len = memfault_encode_varint_u32(ctx->total_size, varint);
+  return 1 /* hdr */ + 2 * varint_len + 1 /* num chunks */ + 2 /* crc16 */;
+}
+
+//! Folds the data of a chunk starting at 'offset' into the parity of its group
+static void prv_fec_accumulate(sMfltChunkTransportCtx *ctx, uint32_t offset,
+                               const uint8_t *data, size_t data_len) {
+  if (ctx->fec_group_num_chunks == 0) {
+    ctx->fec_group_start = offset;
+    ctx->fec_parity_len = 0;
+  }
+
+  for (size_t i = 0; i < data_len; i++) {
+    if (i < ctx->fec_parity_len) {
+      ctx->fec_parity_buf[i] ^= data[i];
+    } else {
+      ctx->fec_parity_buf[i] = data[i];
+    }
+  }
+  ctx->fec_parity_len = MEMFAULT_MAX(ctx->fec_parity_len, data_len);
+  ctx->fec_group_num_chunks++;
+
+  const uint32_t end_offset = offset + (uint32_t)data_len;
+  ctx->fec_parity_pending = (ctx->fec_group_num_chunks >= ctx->fec_group_size) ||
+      (end_offset == ctx->total_size);
+}
+
+//! With forward error correction, the data of a chunk is bounded by the parity buffer and by the
+//! space needed to send the parity of the group in a buffer of the same size
+//!
+//! @return false if a buffer of 'buf_len' bytes can't hold a chunk
+static bool prv_get_max_data_len(const sMfltChunkTransportCtx *ctx, bool fec, size_t buf_len,
+                                 size_t *max_data_len) {
+  if (!fec) {
+    *max_data_len = buf_len;
+    return true;
+  }
+  const size_t overhead = prv_fec_chunk_overhead(ctx);
+  if (buf_len <= overhead) {
+    return false;
+  }
+  *max_data_len = MEMFAULT_MIN(ctx->fec_parity_buf_len, buf_len - overhead);
+  return true;
+}
+
+static bool prv_fec_get_parity_chunk(sMfltChunkTransportCtx *ctx, uint8_t *chunk_msg,
+                                     size_t *out_buf_len) {
+  const bool more_data = ctx->read_offset < ctx->total_size;
+  const size_t parity_len = ctx->fec_parity_len;
+  const uint8_t num_chunks = ctx->fec_group_num_chunks;
+  ctx->fec_parity_pending = false;
+  ctx->fec_group_num_chunks = 0;
+
+  if ((prv_fec_chunk_overhead(ctx) + parity_len) > *out_buf_len) {
+    // The buffer shrunk since the data chunks of the group were sent. The group goes unprotected
+    // rather than stalling the message.
+    if (more_data) {
+      return memfault_chunk_transport_get_next_chunk(ctx, chunk_msg, out_buf_len);
+    }
+    *out_buf_len = 0;
+    return false;
+  }
+
+  const sMemfaultHeaderSettings parity_settings = {
+    .md = more_data,
+    .continuation = true,
+    .fec = true,
+    .parity = true,
+  };
+  size_t chunk_len = 0;
+  chunk_msg[chunk_len++] = prv_build_hdr(&parity_settings);
+  chunk_len += memfault_encode_varint_u32(ctx->fec_group_start, &chunk_msg[chunk_len]);
+  chunk_len += memfault_encode_varint_u32(ctx->read_offset, &chunk_msg[chunk_len]);
+  chunk_msg[chunk_len++] = num_chunks;
+  memcpy(&chunk_msg[chunk_len], ctx->fec_parity_buf, parity_len);
+  chunk_len += parity_len;
+  if (!more_data) {
+    const uint16_t crc16 = ctx->crc16_incremental;
+    chunk_msg[chunk_len++] = crc16 & 0xff;
+    chunk_msg[chunk_len++] = (crc16 >> 8) & 0xff;
+  }
+
+  *out_buf_len = chunk_len;
+  return more_data;
+}
+
 bool memfault_chunk_transport_get_next_chunk(sMfltChunkTransportCtx *ctx,
                                              void *out_buf, size_t *out_buf_len) {
   // There's not enough space to encode anything. Consumers of this API should be
@@ -76,6 +200,17 @@ bool memfault_chunk_transport_get_next_chunk(sMfltChunkTransportCtx *ctx,
     return true;
   }
 
+  const bool fec = prv_fec_enabled(ctx);
+  if (fec && ctx->fec_parity_pending) {
+    return prv_fec_get_parity_chunk(ctx, out_buf, out_buf_len);
+  }
+
+  size_t max_data_len;
+  if (!prv_get_max_data_len(ctx, fec, *out_buf_len, &max_data_len)) {
+    *out_buf_len = 0;
+    return true;
+  }
+
   uint8_t *chunk_msg = out_buf;
 
   size_t varint_len = 0;
@@ -90,18 +225,19 @@ bool memfault_chunk_transport_get_next_chunk(sMfltChunkTransportCtx *ctx,
   if (init_pkt_type) {
     varint_len = memfault_encode_varint_u32(ctx->total_size, &chunk_msg[1]);
     const size_t single_msg_size = prv_compute_single_message_chunk_size(ctx);
-    more_data = single_msg_size > *out_buf_len;
+    more_data = fec ? (ctx->total_size > max_data_len) : (single_msg_size > *out_buf_len);
 
     const sMemfaultHeaderSettings init_settings = {
       .md = more_data && !ctx->enable_multi_call_chunk,
-      .continuation = false
+      .continuation = false,
+      .fec = fec,
     };
     ctx->single_chunk_message_length = single_msg_size;
 
     chunk_msg[0] = prv_build_hdr(&init_settings);
     chunk_msg_start_offset = 1;
     if (init_settings.md) {
-      bytes_to_read = *out_buf_len - 1 /* hdr */ - varint_len;
+      bytes_to_read = MEMFAULT_MIN(*out_buf_len - 1 /* hdr */ - varint_len, max_data_len);
       chunk_msg_start_offset += varint_len;
     } else if (ctx->enable_multi_call_chunk) {
       bytes_to_read = MEMFAULT_MIN(*out_buf_len - 1 /* hdr */, ctx->total_size);
@@ -118,12 +254,13 @@ bool memfault_chunk_transport_get_next_chunk(sMfltChunkTransportCtx *ctx,
     const size_t bytes_remaining = ctx->total_size - ctx->read_offset;
 
     size_t out_buf_space_rem = *out_buf_len - 1 /* hdr */ - varint_len;
-    bytes_to_read = MEMFAULT_MIN(out_buf_space_rem, bytes_remaining);
+    bytes_to_read = MEMFAULT_MIN(MEMFAULT_MIN(out_buf_space_rem, bytes_remaining), max_data_len);
     out_buf_space_rem -= bytes_to_read;
-    more_data = (out_buf_space_rem < crc16_len);
+    more_data = (out_buf_space_rem < crc16_len) || (bytes_to_read < bytes_remaining);
     const sMemfaultHeaderSettings cont_settings = {
       .md = more_data,
       .continuation = true,
+      .fec = fec,
     };
     chunk_msg[0] = prv_build_hdr(&cont_settings);
     chunk_msg_start_offset = 1 /* hdr */ + varint_len;
@@ -131,9 +268,12 @@ bool memfault_chunk_transport_get_next_chunk(sMfltChunkTransportCtx *ctx,
 
   if (bytes_to_read != 0) {
     uint8_t *msg_bufp = &chunk_msg[chunk_msg_start_offset];
-    ctx->read_msg(ctx->read_offset, msg_bufp, bytes_to_read);
+    prv_read_msg(ctx, ctx->read_offset, msg_bufp, bytes_to_read);
     ctx->crc16_incremental = memfault_crc16_ccitt_compute(
         ctx->crc16_incremental, msg_bufp, bytes_to_read);
+    if (fec) {
+      prv_fec_accumulate(ctx, ctx->read_offset, msg_bufp, bytes_to_read);
+    }
     chunk_msg_start_offset += bytes_to_read;
   }
 
@@ -165,7 +305,74 @@ bool memfault_chunk_transport_get_next_chunk(sMfltChunkTransportCtx *ctx,
 
   *out_buf_len = bytes_written;
 
-  return more_data;
+  // the parity of the group follows, even after the last data chunk of the message
+  return more_data || ctx->fec_parity_pending;
+}
+
+bool memfault_chunk_transport_get_chunk_at_offset(sMfltChunkTransportCtx *ctx, uint32_t offset,
+                                                  void *out_buf, size_t *out_buf_len) {
+  // Only data which has already been chunked can be sent again. The CRC16 is known once all of it
+  // has been, so a chunk with no data but the CRC16 can be regenerated too.
+  const bool crc_known = ctx->read_offset == ctx->total_size;
+  const bool fec = prv_fec_enabled(ctx);
+  size_t max_data_len;
+  if (ctx->enable_multi_call_chunk || (offset > ctx->read_offset) ||
+      ((offset == ctx->read_offset) && !crc_known) ||
+      (*out_buf_len < MEMFAULT_MIN_CHUNK_BUF_LEN) ||
+      !prv_get_max_data_len(ctx, fec, *out_buf_len, &max_data_len)) {
+    *out_buf_len = 0;
+    return false;
+  }
+
+  uint8_t *chunk_msg = out_buf;
+  const size_t crc16_len = 2;
+  size_t chunk_msg_start_offset = 1;
+  size_t bytes_to_read;
+  bool more_data;
+
+  if (offset == 0) {
+    const bool single_chunk = crc_known &&
+        (fec ? (ctx->total_size <= max_data_len) :
+               (prv_compute_single_message_chunk_size(ctx) <= *out_buf_len));
+    more_data = !single_chunk;
+    if (more_data) {
+      const size_t varint_len = memfault_encode_varint_u32(ctx->total_size, &chunk_msg[1]);
+      chunk_msg_start_offset += varint_len;
+      bytes_to_read = MEMFAULT_MIN(*out_buf_len - chunk_msg_start_offset, max_data_len);
+      bytes_to_read = MEMFAULT_MIN(bytes_to_read, ctx->read_offset);
+    } else {
+      bytes_to_read = ctx->total_size;
+    }
+  } else {
+    chunk_msg_start_offset += memfault_encode_varint_u32(offset, &chunk_msg[1]);
+    const size_t out_buf_space_rem = *out_buf_len - chunk_msg_start_offset;
+    bytes_to_read = MEMFAULT_MIN(out_buf_space_rem, max_data_len);
+    bytes_to_read = MEMFAULT_MIN(bytes_to_read, ctx->read_offset - offset);
+    more_data = ((offset + bytes_to_read) != ctx->total_size) ||
+        ((out_buf_space_rem - bytes_to_read) < crc16_len);
+  }
+
+  const sMemfaultHeaderSettings settings = {
+    .md = more_data,
+    .continuation = (offset != 0),
+    .fec = fec,
+  };
+  chunk_msg[0] = prv_build_hdr(&settings);
+
+  if (bytes_to_read != 0) {
+    prv_read_msg(ctx, offset, &chunk_msg[chunk_msg_start_offset], bytes_to_read);
+    chunk_msg_start_offset += bytes_to_read;
+  }
+
+  if (!more_data) {
+    const uint16_t crc16 = ctx->crc16_incremental;
+    chunk_msg[chunk_msg_start_offset] = crc16 & 0xff;
+    chunk_msg[chunk_msg_start_offset + 1] = (crc16 >> 8) & 0xff;
+    chunk_msg_start_offset += crc16_len;
+  }
+
+  *out_buf_len = chunk_msg_start_offset;
+  return true;
 }
 
 void memfault_chunk_transport_get_chunk_info(sMfltChunkTransportCtx *ctx) {
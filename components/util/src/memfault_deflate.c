@@ -0,0 +1,268 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/util/deflate.h"
+
+#include <string.h>
+
+#include "memfault/core/compiler.h"
+#include "memfault/core/math.h"
+
+#define DEFLATE_WINDOW_SIZE MEMFAULT_DEFLATE_WINDOW_SIZE
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_END_OF_BLOCK 256
+
+MEMFAULT_STATIC_ASSERT(((DEFLATE_WINDOW_SIZE & (DEFLATE_WINDOW_SIZE - 1)) == 0) &&
+                       (DEFLATE_WINDOW_SIZE >= 512) && (DEFLATE_WINDOW_SIZE <= 16384),
+                       "MEMFAULT_DEFLATE_WINDOW_SIZE must be a power of two between 512 and 16384");
+
+// RFC 1951 3.2.5: base values and number of extra bits for length codes 257..285 ...
+static const uint16_t s_length_base[] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t s_length_extra_bits[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+
+// ... and for distance codes 0..29
+static const uint16_t s_dist_base[] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+  193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t s_dist_extra_bits[] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+//
+// Output
+//
+
+static void prv_flush_out_buf(sMemfaultDeflateEncoder *encoder) {
+  if ((encoder->out_len != 0) && !encoder->write_error) {
+    encoder->write_error = !encoder->write_cb(encoder->write_ctx, encoder->out_buf,
+                                              encoder->out_len);
+    encoder->total_out += encoder->out_len;
+  }
+  encoder->out_len = 0;
+}
+
+static void prv_put_byte(sMemfaultDeflateEncoder *encoder, uint8_t byte) {
+  encoder->out_buf[encoder->out_len++] = byte;
+  if (encoder->out_len == sizeof(encoder->out_buf)) {
+    prv_flush_out_buf(encoder);
+  }
+}
+
+//! Deflate packs values starting with the least significant bit
+static void prv_put_bits(sMemfaultDeflateEncoder *encoder, uint32_t value, uint32_t num_bits) {
+  encoder->bit_buf |= value << encoder->bit_count;
+  encoder->bit_count += num_bits;
+  while (encoder->bit_count >= 8) {
+    prv_put_byte(encoder, (uint8_t)encoder->bit_buf);
+    encoder->bit_buf >>= 8;
+    encoder->bit_count -= 8;
+  }
+}
+
+//! Huffman codes are packed starting with the most significant bit
+static void prv_put_code(sMemfaultDeflateEncoder *encoder, uint32_t code, uint32_t num_bits) {
+  uint32_t reversed = 0;
+  for (uint32_t i = 0; i < num_bits; i++) {
+    reversed = (reversed << 1) | ((code >> i) & 0x1);
+  }
+  prv_put_bits(encoder, reversed, num_bits);
+}
+
+//! Emits a literal/length symbol with the fixed Huffman code from RFC 1951 3.2.6
+static void prv_put_lit_len_symbol(sMemfaultDeflateEncoder *encoder, uint32_t symbol) {
+  if (symbol <= 143) {
+    prv_put_code(encoder, 0x30 + symbol, 8);
+  } else if (symbol <= 255) {
+    prv_put_code(encoder, 0x190 + (symbol - 144), 9);
+  } else if (symbol <= 279) {
+    prv_put_code(encoder, symbol - 256, 7);
+  } else {
+    prv_put_code(encoder, 0xC0 + (symbol - 280), 8);
+  }
+}
+
+static void prv_put_match(sMemfaultDeflateEncoder *encoder, uint32_t length, uint32_t distance) {
+  uint32_t code = MEMFAULT_ARRAY_SIZE(s_length_base) - 1;
+  while (s_length_base[code] > length) {
+    code--;
+  }
+  prv_put_lit_len_symbol(encoder, 257 + code);
+  prv_put_bits(encoder, length - s_length_base[code], s_length_extra_bits[code]);
+
+  code = MEMFAULT_ARRAY_SIZE(s_dist_base) - 1;
+  while (s_dist_base[code] > distance) {
+    code--;
+  }
+  // distance codes are all 5 bits long
+  prv_put_code(encoder, code, 5);
+  prv_put_bits(encoder, distance - s_dist_base[code], s_dist_extra_bits[code]);
+}
+
+//
+// Match finding
+//
+
+static uint32_t prv_hash(const uint8_t *data) {
+  const uint32_t value = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+  return (value * 2654435761u) >> (32 - MEMFAULT_DEFLATE_HASH_BITS);
+}
+
+//! Records 'pos' as the most recent position for the 3 bytes which start there
+//!
+//! @return the previous position with the same hash or -1 if there is none
+static int32_t prv_insert_hash(sMemfaultDeflateEncoder *encoder, uint32_t pos) {
+  if ((pos + DEFLATE_MIN_MATCH) > encoder->window_len) {
+    return -1;
+  }
+  const uint32_t hash = prv_hash(&encoder->window[pos]);
+  const int32_t prev_pos = (int32_t)encoder->hash_head[hash] - 1;
+  encoder->hash_head[hash] = (uint16_t)(pos + 1);
+  return prev_pos;
+}
+
+static uint32_t prv_match_length(const sMemfaultDeflateEncoder *encoder, uint32_t match_pos,
+                                 uint32_t pos) {
+  const uint32_t max_len = MEMFAULT_MIN(DEFLATE_MAX_MATCH, encoder->window_len - pos);
+  const uint8_t *a = &encoder->window[match_pos];
+  const uint8_t *b = &encoder->window[pos];
+  uint32_t len = 0;
+  while ((len < max_len) && (a[len] == b[len])) {
+    len++;
+  }
+  return len;
+}
+
+//! Encodes the data in the window up to 'end'
+static void prv_encode(sMemfaultDeflateEncoder *encoder, uint32_t end) {
+  uint32_t pos = encoder->window_pos;
+  while (pos < end) {
+    const int32_t match_pos = prv_insert_hash(encoder, pos);
+    uint32_t match_len = 0;
+    if ((match_pos >= 0) && ((pos - (uint32_t)match_pos) <= DEFLATE_WINDOW_SIZE)) {
+      match_len = prv_match_length(encoder, (uint32_t)match_pos, pos);
+    }
+
+    if (match_len < DEFLATE_MIN_MATCH) {
+      prv_put_lit_len_symbol(encoder, encoder->window[pos]);
+      pos++;
+      continue;
+    }
+
+    prv_put_match(encoder, match_len, pos - (uint32_t)match_pos);
+    // the positions covered by the match are still candidates for future matches
+    for (uint32_t i = 1; i < match_len; i++) {
+      prv_insert_hash(encoder, pos + i);
+    }
+    pos += match_len;
+  }
+  encoder->window_pos = pos;
+}
+
+//! Drops the oldest half of the window to make room for more input
+static void prv_slide_window(sMemfaultDeflateEncoder *encoder) {
+  memmove(&encoder->window[0], &encoder->window[DEFLATE_WINDOW_SIZE], DEFLATE_WINDOW_SIZE);
+  encoder->window_len -= DEFLATE_WINDOW_SIZE;
+  encoder->window_pos -= DEFLATE_WINDOW_SIZE;
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(encoder->hash_head); i++) {
+    const uint16_t head = encoder->hash_head[i];
+    encoder->hash_head[i] = (head > DEFLATE_WINDOW_SIZE) ? (uint16_t)(head - DEFLATE_WINDOW_SIZE) : 0;
+  }
+}
+
+static void prv_update_adler32(sMemfaultDeflateEncoder *encoder, const uint8_t *data,
+                               size_t data_len) {
+  // 5552 is the largest number of bytes which can be summed before the sums overflow
+  #define ADLER32_MOD 65521
+  #define ADLER32_MAX_BLOCK_LEN 5552
+  while (data_len > 0) {
+    const size_t block_len = MEMFAULT_MIN(data_len, ADLER32_MAX_BLOCK_LEN);
+    for (size_t i = 0; i < block_len; i++) {
+      encoder->adler_a += data[i];
+      encoder->adler_b += encoder->adler_a;
+    }
+    encoder->adler_a %= ADLER32_MOD;
+    encoder->adler_b %= ADLER32_MOD;
+    data += block_len;
+    data_len -= block_len;
+  }
+}
+
+void memfault_deflate_encoder_init(sMemfaultDeflateEncoder *encoder,
+                                   MemfaultDeflateWriteCb write_cb, void *ctx) {
+  memset(encoder, 0x0, sizeof(*encoder));
+  encoder->write_cb = write_cb;
+  encoder->write_ctx = ctx;
+  encoder->adler_a = 1;
+
+  // RFC 1950 header: deflate with a window of 2^(CINFO + 8) bytes and the "fastest" level
+  uint32_t cinfo = 0;
+  while ((256U << cinfo) < DEFLATE_WINDOW_SIZE) {
+    cinfo++;
+  }
+  const uint32_t cmf = (cinfo << 4) | 8;
+  const uint32_t flg = (31 - ((cmf << 8) % 31)) % 31;
+  prv_put_byte(encoder, (uint8_t)cmf);
+  prv_put_byte(encoder, (uint8_t)flg);
+
+  // the whole stream is a single final block which uses the fixed Huffman codes
+  const uint32_t bfinal = 1;
+  const uint32_t btype_fixed = 1;
+  prv_put_bits(encoder, bfinal, 1);
+  prv_put_bits(encoder, btype_fixed, 2);
+}
+
+bool memfault_deflate_encoder_write(sMemfaultDeflateEncoder *encoder, const void *data,
+                                    size_t data_len) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  prv_update_adler32(encoder, bytes, data_len);
+
+  while ((data_len > 0) && !encoder->write_error) {
+    if (encoder->window_len == sizeof(encoder->window)) {
+      // keep enough data after the position being encoded to find the longest match
+      prv_encode(encoder, encoder->window_len - DEFLATE_MAX_MATCH);
+      prv_slide_window(encoder);
+    }
+
+    const size_t copy_len = MEMFAULT_MIN(data_len, sizeof(encoder->window) - encoder->window_len);
+    memcpy(&encoder->window[encoder->window_len], bytes, copy_len);
+    encoder->window_len += copy_len;
+    bytes += copy_len;
+    data_len -= copy_len;
+  }
+
+  return !encoder->write_error;
+}
+
+bool memfault_deflate_encoder_finish(sMemfaultDeflateEncoder *encoder) {
+  prv_encode(encoder, encoder->window_len);
+  prv_put_lit_len_symbol(encoder, DEFLATE_END_OF_BLOCK);
+  // pad to a byte boundary
+  prv_put_bits(encoder, 0, (8 - encoder->bit_count) % 8);
+
+  const uint32_t adler32 = (encoder->adler_b << 16) | encoder->adler_a;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    prv_put_byte(encoder, (uint8_t)(adler32 >> shift));
+  }
+  prv_flush_out_buf(encoder);
+  return !encoder->write_error;
+}
+
+size_t memfault_deflate_max_encoded_size(size_t data_len) {
+  // 2 byte header, 3 bits of block header, 9 bits per literal, 7 bits of end of block,
+  // padding and a 4 byte checksum
+  return 2 + ((3 + (9 * data_len) + 7 + 7) / 8) + 4;
+}
@@ -17,7 +17,7 @@
 memfault_assert_arg_defined = \
   $(if $(value $(strip $1)),,$(error Undefined $1:$2))
 
-MEMFAULT_VALID_COMPONENTS := core demo http panics util
+MEMFAULT_VALID_COMPONENTS := coap core demo http mqtt panics util
 
 $(call memfault_assert_arg_defined,MEMFAULT_COMPONENTS,\
   Must be set to one or more of "$(MEMFAULT_VALID_COMPONENTS)")
@@ -4,13 +4,20 @@
 //! See License.txt for details
 //! Reference implementation of the memfault platform header for Mbed
 #include "cmsis.h"
+#include "cmsis_os2.h"
 
 #include "memfault/core/compiler.h"
+#include "memfault/core/platform/core.h"
 
 int memfault_platform_boot(void) {
   return 0;
 }
 
+uint64_t memfault_platform_get_time_since_boot_ms(void) {
+  // Mbed OS runs the RTOS tick at 1 kHz
+  return osKernelGetTickCount();
+}
+
 void memfault_platform_halt_if_debugging(void) {
   if (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) {
     __BKPT(0);
@@ -8,12 +8,15 @@
 #include "memfault/core/compiler.h"
 #include "memfault/core/debug_log.h"
 #include "memfault/core/event_storage.h"
+#include "memfault/core/platform/core.h"
 #include "memfault/panics/assert.h"
 #include "memfault/panics/coredump.h"
 #include "memfault/panics/trace_event.h"
 
+//! Large enough to hold a reboot event with the entire reboot history, see
+//! memfault_reboot_tracking_compute_worst_case_storage_size()
 #if !defined(CONFIG_MEMFAULT_EVENT_STORAGE_SIZE)
-#define CONFIG_MEMFAULT_EVENT_STORAGE_SIZE 100
+#define CONFIG_MEMFAULT_EVENT_STORAGE_SIZE 256
 #endif
 
 //! Sanity check that coredump storage is large enough to capture the regions we want to collect
@@ -40,6 +43,11 @@ int memfault_platform_boot(void) {
   return 0;
 }
 
+uint64_t memfault_platform_get_time_since_boot_ms(void) {
+  // The demo app doesn't keep track of time, 0 is reported as "unknown"
+  return 0;
+}
+
 void memfault_platform_halt_if_debugging(void) {
   NRF_BREAKPOINT_COND;
 }
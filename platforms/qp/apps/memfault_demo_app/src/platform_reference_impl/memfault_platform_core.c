@@ -12,6 +12,11 @@ int memfault_platform_boot(void) {
   return 0;
 }
 
+uint64_t memfault_platform_get_time_since_boot_ms(void) {
+  // The demo app doesn't keep track of time, 0 is reported as "unknown"
+  return 0;
+}
+
 void memfault_platform_halt_if_debugging(void) {
   if (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) {
     __asm("bkpt");
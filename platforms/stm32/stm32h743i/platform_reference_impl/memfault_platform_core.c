@@ -12,6 +12,10 @@ int memfault_platform_boot(void) {
   return 0;
 }
 
+uint64_t memfault_platform_get_time_since_boot_ms(void) {
+  return HAL_GetTick();
+}
+
 void memfault_platform_halt_if_debugging(void) {
   if (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) {
     __asm("bkpt");
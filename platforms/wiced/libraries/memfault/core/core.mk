@@ -1,6 +1,8 @@
 NAME := MemfaultCore
 
-$(NAME)_SOURCES    := src/memfault_data_packetizer.c
+$(NAME)_SOURCES    := src/memfault_boot_profile.c \
+                      src/memfault_data_packetizer.c \
+                      src/memfault_data_source.c \
 
 $(NAME)_COMPONENTS :=
 
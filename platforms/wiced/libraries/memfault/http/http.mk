@@ -1,6 +1,7 @@
 NAME := MemfaultHttp
 
 $(NAME)_SOURCES    := src/memfault_http_client.c \
+                      src/memfault_http_retry_policy.c \
 
 
 $(NAME)_COMPONENTS := libraries/memfault/core \
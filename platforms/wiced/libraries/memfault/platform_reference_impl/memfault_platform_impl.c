@@ -10,12 +10,14 @@
 #include "memfault/core/compiler.h"
 #include "memfault/core/debug_log.h"
 #include "memfault/core/errors.h"
+#include "memfault/core/platform/core.h"
 
 #include "memfault/http/root_certs.h"
 #include "memfault_platform_wiced.h"
 
 #include "wiced_tls.h"
 #include "wiced_result.h"
+#include "wiced_time.h"
 
 // return different error codes from each exit point so it's easier to determine what went wrong
 typedef enum {
@@ -43,6 +45,12 @@ int memfault_platform_boot(void) {
   return 0;
 }
 
+uint64_t memfault_platform_get_time_since_boot_ms(void) {
+  wiced_time_t time_ms = 0;
+  wiced_time_get_time(&time_ms);
+  return time_ms;
+}
+
 void memfault_platform_halt_if_debugging(void) {
   if ((CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) == 0) {
     return;
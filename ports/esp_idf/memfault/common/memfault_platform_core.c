@@ -0,0 +1,15 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Implementation of the core platform dependencies for the esp-idf
+
+#include "memfault/core/platform/core.h"
+
+#include "esp_timer.h"
+
+uint64_t memfault_platform_get_time_since_boot_ms(void) {
+  return (uint64_t)esp_timer_get_time() / 1000;
+}
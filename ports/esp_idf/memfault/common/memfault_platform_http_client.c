@@ -142,6 +142,11 @@ int memfault_platform_http_client_post_data(
     return -1;
   }
 
+  sMfltHttpClientBufferStats buffer_stats;
+  memfault_http_client_get_buffer_stats(&buffer_stats);
+  MEMFAULT_LOG_DEBUG("POST buffer: %d bytes, %d allocation attempts",
+                     (int)buffer_stats.last_buffer_size, (int)buffer_stats.last_alloc_attempts);
+
   esp_http_client_handle_t client = (esp_http_client_handle_t)_client;
   char url[MEMFAULT_HTTP_URL_BUFFER_SIZE];
   memfault_http_build_url(url, MEMFAULT_HTTP_API_CHUNKS_SUBPATH);
@@ -152,6 +157,10 @@ int memfault_platform_http_client_post_data(
   memfault_http_client_release_chunk_buffer(buffer);
   if (rv != 0) {
     MEMFAULT_LOG_ERROR("%s failed: %d", __func__, (int)rv);
+    if (callback) {
+      // no response was received (i.e the connection failed), let the caller record the failure
+      callback(NULL, ctx);
+    }
     return rv;
   }
 
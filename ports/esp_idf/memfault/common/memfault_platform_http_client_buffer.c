@@ -5,13 +5,25 @@
 //!
 //! @brief
 //! Default implementation for buffer allocation while POSTing memfault chunk data
+//!
+//! A single buffer is kept in a pool and reused by every upload. Allocating (up to 16kB) and
+//! freeing it for each upload fragments the heap over time until only small buffers, and so many
+//! small POSTs, are left.
+//!
+//! Uploads may run from several tasks so the pool and the stats are accessed with memfault_lock()
+//! held.
 
 #include "memfault/esp_port/http_client.h"
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "memfault/core/compiler.h"
+#include "memfault/core/debug_log.h"
+#include "memfault/core/errors.h"
+#include "memfault/core/platform/overrides.h"
 
 #ifndef MEMFAULT_HTTP_CLIENT_MAX_BUFFER_SIZE
 #  define MEMFAULT_HTTP_CLIENT_MAX_BUFFER_SIZE  (16 * 1024)
@@ -21,8 +33,21 @@
 #error "MEMFAULT_HTTP_CLIENT_MAX_BUFFER_SIZE must be greater than 1024 bytes"
 #endif
 
-MEMFAULT_WEAK
-void *memfault_http_client_allocate_chunk_buffer(size_t *buffer_size) {
+typedef struct {
+  void *buffer;
+  size_t buffer_size;
+  //! The buffer was reserved from the heap rather than lent by the application
+  bool from_heap;
+  bool in_use;
+} sMfltHttpClientBufferPool;
+
+static sMfltHttpClientBufferPool s_pool;
+static sMfltHttpClientBufferStats s_stats;
+
+//! Allocates the largest buffer the heap can provide
+//!
+//! @param[out] alloc_attempts Incremented for every call to malloc
+static void *prv_alloc_largest(size_t *buffer_size, uint32_t *alloc_attempts) {
   // The more data we can pack into one http request, the more efficient things will
   // be from a network perspective. Let's start by trying to use a 16kB buffer and slim
   // things down if there isn't that much space available
@@ -30,7 +55,8 @@ void *memfault_http_client_allocate_chunk_buffer(size_t *buffer_size) {
   const uint32_t min_alloc_size = MEMFAULT_HTTP_CLIENT_MIN_BUFFER_SIZE;
 
   void *buffer = NULL;
-  while (try_alloc_size > min_alloc_size) {
+  while (try_alloc_size >= min_alloc_size) {
+    (*alloc_attempts)++;
     buffer = malloc(try_alloc_size);
     if (buffer != NULL) {
       *buffer_size = try_alloc_size;
@@ -42,7 +68,134 @@ void *memfault_http_client_allocate_chunk_buffer(size_t *buffer_size) {
   return buffer;
 }
 
+static int prv_pool_reserve(void) {
+  if (s_pool.buffer != NULL) {
+    return 0;
+  }
+
+  size_t buffer_size = 0;
+  void *buffer = prv_alloc_largest(&buffer_size, &s_stats.total_alloc_attempts);
+  if (buffer == NULL) {
+    return MemfaultInternalReturnCode_Error;
+  }
+  s_pool = (sMfltHttpClientBufferPool) {
+    .buffer = buffer,
+    .buffer_size = buffer_size,
+    .from_heap = true,
+  };
+  MEMFAULT_LOG_DEBUG("Reserved a %d byte POST buffer", (int)buffer_size);
+  return 0;
+}
+
+int memfault_http_client_buffer_pool_reserve(void) {
+  int rv;
+  memfault_lock();
+  {
+    rv = prv_pool_reserve();
+  }
+  memfault_unlock();
+  return rv;
+}
+
+int memfault_http_client_buffer_pool_init(void *buffer, size_t buffer_size) {
+  if ((buffer == NULL) || (buffer_size < MEMFAULT_HTTP_CLIENT_MIN_BUFFER_SIZE)) {
+    return MemfaultInternalReturnCode_InvalidInput;
+  }
+
+  int rv = MemfaultInternalReturnCode_Error;
+  memfault_lock();
+  {
+    if (s_pool.buffer == NULL) {
+      s_pool = (sMfltHttpClientBufferPool) {
+        .buffer = buffer,
+        .buffer_size = buffer_size,
+      };
+      rv = 0;
+    }
+  }
+  memfault_unlock();
+  return rv;
+}
+
+int memfault_http_client_buffer_pool_deinit(void) {
+  int rv = MemfaultInternalReturnCode_Error;
+  memfault_lock();
+  {
+    if (!s_pool.in_use) {
+      if (s_pool.from_heap) {
+        free(s_pool.buffer);
+      }
+      memset(&s_pool, 0, sizeof(s_pool));
+      rv = 0;
+    }
+  }
+  memfault_unlock();
+  return rv;
+}
+
+void memfault_http_client_get_buffer_stats(sMfltHttpClientBufferStats *stats_out) {
+  memfault_lock();
+  {
+    *stats_out = s_stats;
+  }
+  memfault_unlock();
+}
+
+static void *prv_allocate_chunk_buffer(size_t *buffer_size) {
+  const uint32_t prev_alloc_attempts = s_stats.total_alloc_attempts;
+
+  void *buffer = NULL;
+  if (!s_pool.in_use) {
+    if (prv_pool_reserve() == 0) {
+      s_pool.in_use = true;
+      buffer = s_pool.buffer;
+      *buffer_size = s_pool.buffer_size;
+    }
+  } else {
+    // i.e another task is posting data. Fall back to a buffer which is only held for this upload.
+    buffer = prv_alloc_largest(buffer_size, &s_stats.total_alloc_attempts);
+    if (buffer != NULL) {
+      s_stats.num_temporary_buffers++;
+    }
+  }
+
+  if (buffer == NULL) {
+    return NULL;
+  }
+  s_stats.num_uploads++;
+  s_stats.last_buffer_size = *buffer_size;
+  s_stats.last_alloc_attempts = s_stats.total_alloc_attempts - prev_alloc_attempts;
+  if ((s_stats.min_buffer_size == 0) || (*buffer_size < s_stats.min_buffer_size)) {
+    s_stats.min_buffer_size = *buffer_size;
+  }
+  return buffer;
+}
+
+MEMFAULT_WEAK
+void *memfault_http_client_allocate_chunk_buffer(size_t *buffer_size) {
+  void *buffer;
+  memfault_lock();
+  {
+    buffer = prv_allocate_chunk_buffer(buffer_size);
+  }
+  memfault_unlock();
+  return buffer;
+}
+
 MEMFAULT_WEAK
 void memfault_http_client_release_chunk_buffer(void *buffer) {
-  free(buffer);
+  bool pool_buffer = false;
+  memfault_lock();
+  {
+    if ((buffer != NULL) && (buffer == s_pool.buffer)) {
+      // kept for the next upload
+      s_pool.in_use = false;
+      pool_buffer = true;
+    }
+  }
+  memfault_unlock();
+
+  if (!pool_buffer) {
+    free(buffer);
+  }
 }
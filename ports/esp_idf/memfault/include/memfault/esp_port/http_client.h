@@ -8,14 +8,17 @@
 //! @brief
 //! esp-idf port specific functions related to http
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #define MEMFAULT_HTTP_CLIENT_MIN_BUFFER_SIZE 1024
 
 //! Called to get a buffer to use for POSTing data to the Memfault cloud
 //!
-//! @note The default implementation just calls malloc but is defined
-//! as weak so a end user can easily override the implementation
+//! @note The default implementation hands out the buffer of the pool (see
+//! memfault_http_client_buffer_pool_reserve()), reserving it from the heap on first use, but is
+//! defined as weak so a end user can easily override the implementation
 //!
 //! @param buffer_size[out] Filled with the size of the buffer allocated. The expectation is that
 //! the buffer will be >= MEMFAULT_HTTP_CLIENT_MIN_BUFFER_SIZE. The larger the buffer, the less
@@ -27,6 +30,50 @@ void *memfault_http_client_allocate_chunk_buffer(size_t *buffer_size);
 
 //! Called to release the buffer that was being to POST data to the Memfault cloud
 //!
-//! @note The default implementation just calls malloc but defined
-//! as weak so an end user can easily override the implementation
+//! @note The default implementation returns the buffer to the pool, where it is kept for the next
+//! upload, but defined as weak so an end user can easily override the implementation
 void memfault_http_client_release_chunk_buffer(void *buffer);
+
+//! Reserves the buffer of the pool from the heap, trying MEMFAULT_HTTP_CLIENT_MAX_BUFFER_SIZE
+//! first and halving the size until an allocation succeeds. The buffer is then reused by every
+//! upload rather than being allocated and freed each time, which fragments the heap.
+//!
+//! @note Call this at boot, while the heap is still in one piece, to get the largest buffer. If
+//! it isn't called, the buffer is reserved by the first upload instead.
+//!
+//! @return 0 on success (or if the pool already holds a buffer), else error code
+int memfault_http_client_buffer_pool_reserve(void);
+
+//! Lends a region to the pool, i.e a static buffer, to be used by every upload instead of memory
+//! from the heap
+//!
+//! @param buffer The region. It must remain valid until memfault_http_client_buffer_pool_deinit()
+//!   is called.
+//! @param buffer_size The size of the region, at least MEMFAULT_HTTP_CLIENT_MIN_BUFFER_SIZE
+//!
+//! @return 0 on success, else error code, i.e if the pool already holds a buffer
+int memfault_http_client_buffer_pool_init(void *buffer, size_t buffer_size);
+
+//! Empties the pool, freeing its buffer if it was reserved from the heap
+//!
+//! @return 0 on success, else error code if an upload is using the buffer
+int memfault_http_client_buffer_pool_deinit(void);
+
+typedef struct MfltHttpClientBufferStats {
+  //! Uploads a buffer was handed out for
+  uint32_t num_uploads;
+  //! The size of the buffer handed out for the last upload and the number of heap allocations
+  //! which were attempted to get it, 0 when the buffer of the pool was reused
+  size_t last_buffer_size;
+  uint32_t last_alloc_attempts;
+  //! The smallest buffer handed out for an upload
+  size_t min_buffer_size;
+  //! Heap allocations attempted across all uploads, including those of
+  //! memfault_http_client_buffer_pool_reserve()
+  uint32_t total_alloc_attempts;
+  //! Uploads which got a temporary buffer from the heap because the buffer of the pool was in use
+  uint32_t num_temporary_buffers;
+} sMfltHttpClientBufferStats;
+
+//! Reads the counters of the default memfault_http_client_allocate_chunk_buffer()
+void memfault_http_client_get_buffer_stats(sMfltHttpClientBufferStats *stats_out);
@@ -0,0 +1,109 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! A gateway which forwards the chunks of downstream devices (i.e BLE sensor nodes) to Memfault
+//! from a Linux host.
+//!
+//! Chunks are handed over, tagged by device serial, from any number of threads (i.e one per
+//! downstream link) with memfault_posix_gateway_add_chunk(). They are queued in the bounded
+//! per-device store of memfault/http/gateway.h and an uploader thread forwards them, taking turns
+//! between the devices, in batches posted to the chunks endpoint of each device. The batches are
+//! posted one after another on a single keep-alive connection to the host configured in
+//! g_mflt_http_client_config.
+//!
+//! Uploads which fail with a transient error (see memfault_http_retry_policy_is_retryable_status())
+//! are retried after MEMFAULT_POSIX_GATEWAY_RETRY_DELAY_MS or the "Retry-After" delay requested by
+//! the server. Batches rejected with other errors are dropped.
+//!
+//! @note Like memfault/http/gateway.h, the gateway is experimental. It is only built when the
+//!   MEMFAULT_POSIX_GATEWAY CMake option is enabled.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memfault/http/gateway.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Delay before an upload which failed with a transient error is retried
+#ifndef MEMFAULT_POSIX_GATEWAY_RETRY_DELAY_MS
+#define MEMFAULT_POSIX_GATEWAY_RETRY_DELAY_MS 1000
+#endif
+
+typedef struct {
+  //! The number of devices which can have chunks queued at a time, 0 for 16
+  size_t max_devices;
+  //! The bytes of queue for each device, 0 for 4kB. Each chunk takes
+  //! MEMFAULT_GATEWAY_CHUNK_OVERHEAD bytes on top of its length.
+  size_t queue_size_per_device;
+  //! The largest body posted, before compression, 0 for 16kB. Chunks which don't fit in it along
+  //! with the framing of a batch are rejected with kMfltGatewayError_ChunkTooLarge.
+  size_t max_batch_size;
+  //! How long the uploader waits for more chunks to show up once the first one has been queued,
+  //! so that batches fill up. 0 posts as soon as there is data.
+  uint32_t linger_ms;
+  //! Compress batches with deflate (see memfault_http_chunk_batch_compress()) when it saves space
+  //!
+  //! @note The encoder used for compression is not reentrant so the application must not call
+  //!   memfault_http_chunk_batch_compress() itself while a gateway is running.
+  bool compress;
+} sMfltPosixGatewayConfig;
+
+typedef struct {
+  //! Batches posted, including the ones which failed
+  uint64_t num_batches;
+  //! Batches which failed with a transient error and were retried
+  uint64_t num_failed_batches;
+  //! Batches which were rejected by the server and dropped
+  uint64_t num_dropped_batches;
+  uint64_t num_chunks_forwarded;
+  //! Size of the bodies posted, as sent over the wire (i.e after compression)
+  uint64_t body_bytes;
+  //! Size of the bodies posted before compression
+  uint64_t uncompressed_body_bytes;
+  //! Connections opened to the server
+  uint64_t num_connections;
+} sMfltPosixGatewayStats;
+
+typedef struct MfltPosixGateway sMfltPosixGateway;
+
+//! Allocates the gateway and starts the uploader thread
+//!
+//! @return The gateway or NULL if it could not be started
+sMfltPosixGateway *memfault_posix_gateway_start(const sMfltPosixGatewayConfig *config);
+
+//! Stops the uploader thread and frees the gateway. Chunks which are still queued are discarded,
+//! see memfault_posix_gateway_flush().
+void memfault_posix_gateway_stop(sMfltPosixGateway *gateway);
+
+//! Queues a chunk received from a downstream device. Can be called from any thread.
+//!
+//! @return 0 if the chunk was queued, else an eMfltGatewayError. On kMfltGatewayError_QueueFull,
+//!   the caller should hold off pulling chunks from the device and try again later.
+int memfault_posix_gateway_add_chunk(sMfltPosixGateway *gateway, const char *device_serial,
+                                     const void *chunk, size_t chunk_len);
+
+//! Posts everything queued right away, without lingering, and waits for the queues to drain
+//!
+//! @return true if all the chunks were forwarded (or dropped by the server) within timeout_ms
+bool memfault_posix_gateway_flush(sMfltPosixGateway *gateway, uint32_t timeout_ms);
+
+void memfault_posix_gateway_get_stats(sMfltPosixGateway *gateway,
+                                      sMfltPosixGatewayStats *stats_out);
+
+//! @return true and populates 'stats_out' if the gateway is tracking the device
+bool memfault_posix_gateway_get_device_stats(sMfltPosixGateway *gateway,
+                                             const char *device_serial,
+                                             sMfltGatewayDeviceStats *stats_out);
+
+#ifdef __cplusplus
+}
+#endif
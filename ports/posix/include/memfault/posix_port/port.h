@@ -0,0 +1,77 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Configuration and helpers specific to the POSIX (Linux) port of the SDK
+//!
+//! The process plays the part of the device: a "reboot" is a restart of the process. State which
+//! would live in noinit RAM or flash on an MCU (reboot tracking, upload retry state, coredump
+//! storage) is kept in files which are mmap'd from MEMFAULT_POSIX_STORAGE_DIR so it survives a
+//! crash of the process.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memfault/core/event_storage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Directory holding the files backing the noinit region and coredump storage. Created if it
+//! does not exist. Can be overridden at runtime with the MEMFAULT_POSIX_STORAGE_DIR environment
+//! variable, i.e to run several instances of a program side by side.
+#ifndef MEMFAULT_POSIX_STORAGE_DIR
+#define MEMFAULT_POSIX_STORAGE_DIR ".memfault"
+#endif
+
+//! Size of the file used for coredump storage
+#ifndef MEMFAULT_POSIX_COREDUMP_STORAGE_SIZE
+#define MEMFAULT_POSIX_COREDUMP_STORAGE_SIZE (32 * 1024)
+#endif
+
+//! Amount of the stack captured in a coredump by the default
+//! memfault_platform_coredump_get_regions() implementation
+#ifndef MEMFAULT_POSIX_COREDUMP_STACK_COLLECTION_SIZE
+#define MEMFAULT_POSIX_COREDUMP_STACK_COLLECTION_SIZE 1024
+#endif
+
+//! Size of the RAM buffer used for event storage
+#ifndef MEMFAULT_POSIX_EVENT_STORAGE_SIZE
+#define MEMFAULT_POSIX_EVENT_STORAGE_SIZE 1024
+#endif
+
+//! Length of a "second" for memfault_platform_metrics_timer_boot(). Lowering it makes heartbeats
+//! fire faster than in real time, which is handy to generate load in tests and benchmarks.
+#ifndef MEMFAULT_POSIX_METRICS_TIMER_MS_PER_SEC
+#define MEMFAULT_POSIX_METRICS_TIMER_MS_PER_SEC 1000
+#endif
+
+//! Send and receive timeout applied to the sockets of the HTTP client
+#ifndef MEMFAULT_POSIX_HTTP_TIMEOUT_MS
+#define MEMFAULT_POSIX_HTTP_TIMEOUT_MS 5000
+#endif
+
+//! Minimum level of the logs printed to stderr, see eMemfaultPlatformLogLevel
+#ifndef MEMFAULT_POSIX_LOG_LEVEL
+#define MEMFAULT_POSIX_LOG_LEVEL kMemfaultPlatformLogLevel_Info
+#endif
+
+//! @return The directory in use for the files backing persistent state
+const char *memfault_posix_port_get_storage_dir(void);
+
+//! @return The event storage booted by memfault_platform_boot() or NULL if it has not run yet
+const sMemfaultEventStorageImpl *memfault_posix_port_get_event_storage(void);
+
+//! Stops the thread started by memfault_platform_metrics_timer_boot(), if any, and waits for it
+//! to exit. Useful to shut down cleanly at the end of a test or benchmark.
+void memfault_posix_port_metrics_timer_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
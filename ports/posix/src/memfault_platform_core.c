@@ -0,0 +1,188 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Boot, time keeping and reboot handling for the POSIX port. The process plays the part of the
+//! device so the "time since boot" is the time since the process started and a reboot is a restart
+//! of the process.
+
+#include "memfault/core/platform/core.h"
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memfault/core/arch.h"
+#include "memfault/core/boot_profile.h"
+#include "memfault/core/compiler.h"
+#include "memfault/core/debug_log.h"
+#include "memfault/core/event_storage.h"
+#include "memfault/core/math.h"
+#include "memfault/http/retry_policy.h"
+#include "memfault/metrics/metrics.h"
+#include "memfault/panics/crash_loop_policy.h"
+#include "memfault/panics/reboot_tracking.h"
+#include "memfault/panics/trace_event.h"
+#include "memfault/posix_port/port.h"
+#include "memfault_posix_port_private.h"
+
+//! State which would be placed in noinit RAM on an MCU
+typedef struct {
+  uint8_t reboot_tracking[MEMFAULT_REBOOT_TRACKING_REGION_SIZE];
+  uint8_t http_retry_state[MEMFAULT_HTTP_RETRY_STATE_REGION_SIZE];
+} sMemfaultPosixNoinit;
+
+//! Used if the noinit file can't be mapped, state is then lost when the process exits
+static sMemfaultPosixNoinit s_fallback_noinit;
+
+static const sMemfaultEventStorageImpl *s_event_storage;
+
+//
+// Time
+//
+
+static uint64_t prv_monotonic_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+}
+
+static uint64_t s_process_start_us;
+
+//! Captures the time the process started, before main() runs
+MEMFAULT_USED __attribute__((constructor))
+static void prv_capture_start_time(void) {
+  s_process_start_us = prv_monotonic_us();
+}
+
+uint64_t memfault_platform_get_time_since_boot_ms(void) {
+  return (prv_monotonic_us() - s_process_start_us) / 1000;
+}
+
+uint64_t memfault_reboot_tracking_get_time_since_boot_ms(void) {
+  return memfault_platform_get_time_since_boot_ms();
+}
+
+uint32_t memfault_platform_get_cycle_count(void) {
+  // a 1 MHz "cycle counter", it wraps after ~71 minutes which is plenty to time a boot
+  return (uint32_t)prv_monotonic_us();
+}
+
+uint32_t memfault_platform_get_cycles_per_ms(void) {
+  return 1000;
+}
+
+//
+// Crash handling
+//
+
+static const struct {
+  int signal;
+  eMfltResetReason reason;
+} s_fatal_signals[] = {
+  { SIGSEGV, kMfltRebootReason_MemFault },
+  { SIGBUS, kMfltRebootReason_BusFault },
+  { SIGILL, kMfltRebootReason_UsageFault },
+  { SIGFPE, kMfltRebootReason_UsageFault },
+  { SIGABRT, kMfltRebootReason_Assert },
+};
+
+static void prv_fatal_signal_handler(int signum) {
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(s_fatal_signals); i++) {
+    if (s_fatal_signals[i].signal == signum) {
+      // only writes to the mapped noinit region so it's safe from a signal handler
+      memfault_reboot_tracking_mark_reset_imminent(s_fatal_signals[i].reason, NULL);
+      break;
+    }
+  }
+
+  // let the default action run so the process still terminates (and dumps core if enabled)
+  signal(signum, SIG_DFL);
+  raise(signum);
+}
+
+//! A process which exits normally is the equivalent of a device being shut down
+static void prv_mark_user_shutdown(void) {
+  memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_UserShutdown, NULL);
+}
+
+static void prv_install_signal_handlers(void) {
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(s_fatal_signals); i++) {
+    signal(s_fatal_signals[i].signal, prv_fatal_signal_handler);
+  }
+}
+
+//
+// Platform APIs
+//
+
+int memfault_platform_boot(void) {
+  sMemfaultPosixNoinit *noinit = memfault_posix_port_map_file("noinit.bin", sizeof(*noinit));
+  if (noinit == NULL) {
+    noinit = &s_fallback_noinit;
+  }
+
+  memfault_reboot_tracking_boot(noinit->reboot_tracking, NULL);
+  memfault_http_retry_policy_boot(noinit->http_retry_state);
+  memfault_crash_loop_policy_boot();
+  memfault_posix_port_coredump_storage_boot();
+  prv_install_signal_handlers();
+  atexit(prv_mark_user_shutdown);
+
+  static uint8_t s_event_storage_buf[MEMFAULT_POSIX_EVENT_STORAGE_SIZE];
+  s_event_storage = memfault_events_storage_boot(s_event_storage_buf, sizeof(s_event_storage_buf));
+  memfault_reboot_tracking_collect_reset_info(s_event_storage);
+  memfault_trace_event_boot(s_event_storage);
+  memfault_metrics_boot(s_event_storage);
+
+  MEMFAULT_LOG_INFO("Memfault POSIX port booted, state in %s",
+                    memfault_posix_port_get_storage_dir());
+  return 0;
+}
+
+const sMemfaultEventStorageImpl *memfault_posix_port_get_event_storage(void) {
+  return s_event_storage;
+}
+
+bool memfault_arch_is_inside_isr(void) {
+  // there are no interrupts, only threads
+  return false;
+}
+
+//! @return true if a debugger (or any other tracer) is attached to the process
+static bool prv_debugger_attached(void) {
+  FILE *status = fopen("/proc/self/status", "r");
+  if (status == NULL) {
+    return false;
+  }
+
+  bool attached = false;
+  char line[128];
+  while (fgets(line, sizeof(line), status) != NULL) {
+    if (strncmp(line, "TracerPid:", strlen("TracerPid:")) == 0) {
+      attached = (strtol(line + strlen("TracerPid:"), NULL, 10) != 0);
+      break;
+    }
+  }
+  fclose(status);
+  return attached;
+}
+
+void memfault_platform_halt_if_debugging(void) {
+  if (prv_debugger_attached()) {
+    raise(SIGTRAP);
+  }
+}
+
+MEMFAULT_NORETURN void memfault_platform_reboot(void) {
+  memfault_platform_halt_if_debugging();
+
+  // the supervisor of the process (i.e systemd or a test harness) is expected to restart it
+  _exit(EXIT_FAILURE);
+}
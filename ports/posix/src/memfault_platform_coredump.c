@@ -0,0 +1,88 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Coredump storage backed by a file which is mmap'd from the storage directory. Writes land in
+//! the page cache right away so a coredump survives the process crashing before it is flushed.
+
+#include "memfault/panics/platform/coredump.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "memfault/core/compiler.h"
+#include "memfault/core/math.h"
+#include "memfault/posix_port/port.h"
+#include "memfault_posix_port_private.h"
+
+static uint8_t *s_coredump_storage;
+
+void memfault_posix_port_coredump_storage_boot(void) {
+  if (s_coredump_storage == NULL) {
+    s_coredump_storage =
+        memfault_posix_port_map_file("coredump.bin", MEMFAULT_POSIX_COREDUMP_STORAGE_SIZE);
+  }
+}
+
+//! Captures the top of the stack which was running at the time of the crash
+//!
+//! @note The function is weak so an application can collect other regions by defining its own
+MEMFAULT_WEAK
+const sMfltCoredumpRegion *memfault_platform_coredump_get_regions(
+    const sCoredumpCrashInfo *crash_info, size_t *num_regions) {
+  static sMfltCoredumpRegion s_coredump_regions[1];
+
+  s_coredump_regions[0] = MEMFAULT_COREDUMP_MEMORY_REGION_INIT(
+      crash_info->stack_address, MEMFAULT_POSIX_COREDUMP_STACK_COLLECTION_SIZE);
+  *num_regions = MEMFAULT_ARRAY_SIZE(s_coredump_regions);
+  return &s_coredump_regions[0];
+}
+
+void memfault_platform_coredump_storage_get_info(sMfltCoredumpStorageInfo *info) {
+  *info = (sMfltCoredumpStorageInfo) {
+    .size = (s_coredump_storage != NULL) ? MEMFAULT_POSIX_COREDUMP_STORAGE_SIZE : 0,
+    .sector_size = MEMFAULT_POSIX_COREDUMP_STORAGE_SIZE,
+  };
+}
+
+static bool prv_op_in_bounds(uint32_t offset, size_t len) {
+  return (s_coredump_storage != NULL) &&
+         ((offset + len) <= MEMFAULT_POSIX_COREDUMP_STORAGE_SIZE);
+}
+
+bool memfault_platform_coredump_storage_read(uint32_t offset, void *data,
+                                             size_t read_len) {
+  if (!prv_op_in_bounds(offset, read_len)) {
+    return false;
+  }
+
+  memcpy(data, &s_coredump_storage[offset], read_len);
+  return true;
+}
+
+bool memfault_platform_coredump_storage_erase(uint32_t offset, size_t erase_size) {
+  if (!prv_op_in_bounds(offset, erase_size)) {
+    return false;
+  }
+
+  memset(&s_coredump_storage[offset], 0x0, erase_size);
+  return true;
+}
+
+bool memfault_platform_coredump_storage_write(uint32_t offset, const void *data,
+                                              size_t data_len) {
+  if (!prv_op_in_bounds(offset, data_len)) {
+    return false;
+  }
+
+  memcpy(&s_coredump_storage[offset], data, data_len);
+  return true;
+}
+
+void memfault_platform_coredump_storage_clear(void) {
+  const uint8_t clear_byte = 0x0;
+  memfault_platform_coredump_storage_write(0, &clear_byte, sizeof(clear_byte));
+}
@@ -0,0 +1,67 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Maps memfault platform logging API to stderr
+
+#include "memfault/core/platform/debug_log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "memfault/posix_port/port.h"
+
+#ifndef MEMFAULT_DEBUG_LOG_BUFFER_SIZE_BYTES
+#  define MEMFAULT_DEBUG_LOG_BUFFER_SIZE_BYTES (256)
+#endif
+
+void memfault_platform_log(eMemfaultPlatformLogLevel level, const char *fmt, ...) {
+  if (level < MEMFAULT_POSIX_LOG_LEVEL) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+
+  char log_buf[MEMFAULT_DEBUG_LOG_BUFFER_SIZE_BYTES];
+  vsnprintf(log_buf, sizeof(log_buf), fmt, args);
+
+  const char *lvl_str = "???";
+  switch (level) {
+    case kMemfaultPlatformLogLevel_Debug:
+      lvl_str = "dbg";
+      break;
+
+    case kMemfaultPlatformLogLevel_Info:
+      lvl_str = "inf";
+      break;
+
+    case kMemfaultPlatformLogLevel_Warning:
+      lvl_str = "wrn";
+      break;
+
+    case kMemfaultPlatformLogLevel_Error:
+      lvl_str = "err";
+      break;
+
+    default:
+      break;
+  }
+  // a single write per line so logs from different threads don't interleave
+  fprintf(stderr, "<%s> <mflt>: %s\n", lvl_str, log_buf);
+
+  va_end(args);
+}
+
+void memfault_platform_log_raw(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+
+  char log_buf[MEMFAULT_DEBUG_LOG_BUFFER_SIZE_BYTES];
+  vsnprintf(log_buf, sizeof(log_buf), fmt, args);
+  fprintf(stderr, "%s\n", log_buf);
+
+  va_end(args);
+}
@@ -0,0 +1,61 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Default device info for the POSIX port. The serial is read from the MEMFAULT_DEVICE_SERIAL
+//! environment variable, so instances of a program can identify as different devices, and
+//! defaults to the host name.
+
+#include "memfault/core/platform/device_info.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "memfault/core/compiler.h"
+
+#ifndef MEMFAULT_POSIX_SOFTWARE_TYPE
+#define MEMFAULT_POSIX_SOFTWARE_TYPE "posix-app"
+#endif
+
+#ifndef MEMFAULT_POSIX_SOFTWARE_VERSION
+#define MEMFAULT_POSIX_SOFTWARE_VERSION "0.0.0"
+#endif
+
+#ifndef MEMFAULT_POSIX_HARDWARE_VERSION
+#define MEMFAULT_POSIX_HARDWARE_VERSION "posix"
+#endif
+
+static const char *prv_get_device_serial(void) {
+  const char *serial = getenv("MEMFAULT_DEVICE_SERIAL");
+  if ((serial != NULL) && (serial[0] != '\0')) {
+    return serial;
+  }
+
+  static char s_hostname[64];
+  if (s_hostname[0] == '\0') {
+    if (gethostname(s_hostname, sizeof(s_hostname) - 1) != 0) {
+      return "posix-device";
+    }
+    // a device serial may only hold [-a-zA-Z0-9_]
+    for (char *c = s_hostname; *c != '\0'; c++) {
+      if (!isalnum((unsigned char)*c) && (*c != '-') && (*c != '_')) {
+        *c = '_';
+      }
+    }
+  }
+  return s_hostname;
+}
+
+//! @note The function is weak so an application can report its own device info
+MEMFAULT_WEAK
+void memfault_platform_get_device_info(sMemfaultDeviceInfo *info) {
+  *info = (sMemfaultDeviceInfo) {
+    .device_serial = prv_get_device_serial(),
+    .software_type = MEMFAULT_POSIX_SOFTWARE_TYPE,
+    .software_version = MEMFAULT_POSIX_SOFTWARE_VERSION,
+    .hardware_version = MEMFAULT_POSIX_HARDWARE_VERSION,
+  };
+}
@@ -0,0 +1,57 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Files standing in for the noinit RAM and flash regions of an MCU
+
+#include "memfault_posix_port_private.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "memfault/core/debug_log.h"
+#include "memfault/posix_port/port.h"
+
+const char *memfault_posix_port_get_storage_dir(void) {
+  const char *dir = getenv("MEMFAULT_POSIX_STORAGE_DIR");
+  return ((dir != NULL) && (dir[0] != '\0')) ? dir : MEMFAULT_POSIX_STORAGE_DIR;
+}
+
+void *memfault_posix_port_map_file(const char *name, size_t size) {
+  const char *dir = memfault_posix_port_get_storage_dir();
+  if ((mkdir(dir, 0755) != 0) && (errno != EEXIST)) {
+    MEMFAULT_LOG_ERROR("Unable to create %s, errno=%d", dir, errno);
+    return NULL;
+  }
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  const int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    MEMFAULT_LOG_ERROR("Unable to open %s, errno=%d", path, errno);
+    return NULL;
+  }
+
+  void *addr = NULL;
+  if (ftruncate(fd, (off_t)size) == 0) {
+    // a shared mapping is written back by the kernel even if the process crashes
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      addr = NULL;
+    }
+  }
+  if (addr == NULL) {
+    MEMFAULT_LOG_ERROR("Unable to map %s, errno=%d", path, errno);
+  }
+  // the mapping stays valid once the descriptor is closed
+  close(fd);
+  return addr;
+}
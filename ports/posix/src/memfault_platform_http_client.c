@@ -0,0 +1,313 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Implementation of the Memfault HTTP client dependencies on top of BSD sockets
+//!
+//! Each message from the packetizer is streamed to the chunks endpoint as it is produced, in a
+//! POST of its own. The connection is kept alive across requests and calls for as long as the
+//! server allows it.
+//!
+//! @note TLS is not implemented. Use the client with g_mflt_http_client_config.api_no_tls set,
+//!   i.e against a local ingestion server or a TLS terminating proxy.
+
+#include "memfault/http/platform/http_client.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "memfault/core/compiler.h"
+#include "memfault/core/data_packetizer.h"
+#include "memfault/core/debug_log.h"
+#include "memfault/core/errors.h"
+#include "memfault/http/http_client.h"
+#include "memfault/http/response_parser.h"
+#include "memfault/http/utils.h"
+#include "memfault/posix_port/port.h"
+#include "memfault_posix_port_private.h"
+
+struct MfltHttpClient {
+  //! The connection to the server, -1 when there is none
+  int fd;
+};
+
+typedef struct MfltHttpResponse {
+  uint32_t status;
+  uint32_t retry_after_s;
+} sMfltHttpResponse;
+
+sMfltHttpClient *memfault_platform_http_client_create(void) {
+  if (!g_mflt_http_client_config.api_no_tls) {
+    MEMFAULT_LOG_ERROR("TLS is not supported by the POSIX port, set api_no_tls");
+    return NULL;
+  }
+
+  sMfltHttpClient *client = calloc(1, sizeof(*client));
+  if (client == NULL) {
+    return NULL;
+  }
+  client->fd = -1;
+  return client;
+}
+
+static void prv_close_connection(sMfltHttpClient *client) {
+  if (client->fd >= 0) {
+    close(client->fd);
+    client->fd = -1;
+  }
+}
+
+int memfault_platform_http_client_destroy(sMfltHttpClient *client) {
+  prv_close_connection(client);
+  free(client);
+  return 0;
+}
+
+int memfault_platform_http_response_get_status(const sMfltHttpResponse *response,
+                                               uint32_t *status_out) {
+  if (status_out) {
+    *status_out = response->status;
+  }
+  return 0;
+}
+
+int memfault_platform_http_response_get_retry_after(const sMfltHttpResponse *response,
+                                                    uint32_t *retry_after_s_out) {
+  if (response->retry_after_s == 0) {
+    return MemfaultInternalReturnCode_Error;
+  }
+  *retry_after_s_out = response->retry_after_s;
+  return 0;
+}
+
+static void prv_configure_socket(int fd) {
+  const struct timeval timeout = {
+    .tv_sec = MEMFAULT_POSIX_HTTP_TIMEOUT_MS / 1000,
+    .tv_usec = (MEMFAULT_POSIX_HTTP_TIMEOUT_MS % 1000) * 1000,
+  };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  // the request headers and body are sent with separate writes
+  const int nodelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+}
+
+int memfault_posix_port_http_connect(void) {
+  const struct addrinfo hints = {
+    .ai_family = AF_UNSPEC,
+    .ai_socktype = SOCK_STREAM,
+  };
+  struct addrinfo *res = NULL;
+  char port[10] = { 0 };
+  snprintf(port, sizeof(port), "%d", MEMFAULT_HTTP_GET_API_PORT());
+
+  const char *host = MEMFAULT_HTTP_GET_API_HOST();
+  const int rv = getaddrinfo(host, port, &hints, &res);
+  if (rv != 0) {
+    MEMFAULT_LOG_ERROR("DNS lookup for %s failed: %s", host, gai_strerror(rv));
+    return -1;
+  }
+
+  int fd = -1;
+  for (struct addrinfo *addr = res; addr != NULL; addr = addr->ai_next) {
+    fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    prv_configure_socket(fd);
+    if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+
+  if (fd < 0) {
+    MEMFAULT_LOG_ERROR("Failed to connect to %s:%s, errno=%d", host, port, errno);
+  }
+  return fd;
+}
+
+bool memfault_posix_port_http_idle_connection_is_usable(int fd) {
+  struct pollfd poll_fd = {
+    .fd = fd,
+    .events = POLLIN,
+  };
+  return (poll(&poll_fd, 1, 0) == 0);
+}
+
+static int prv_get_connection(sMfltHttpClient *client) {
+  if ((client->fd >= 0) && !memfault_posix_port_http_idle_connection_is_usable(client->fd)) {
+    prv_close_connection(client);
+  }
+  if (client->fd < 0) {
+    client->fd = memfault_posix_port_http_connect();
+  }
+  return client->fd;
+}
+
+bool memfault_posix_port_http_send(const void *data, size_t data_len, void *ctx) {
+  const int fd = *(int *)ctx;
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (data_len > 0) {
+    const ssize_t rv = send(fd, bytes, data_len, MSG_NOSIGNAL);
+    if (rv < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      MEMFAULT_LOG_ERROR("Data Send Error: len=%d, errno=%d", (int)data_len, errno);
+      return false;
+    }
+    bytes += rv;
+    data_len -= (size_t)rv;
+  }
+  return true;
+}
+
+bool memfault_posix_port_http_read_response(int fd, uint32_t *status_out,
+                                            uint32_t *retry_after_s_out, bool *keep_alive_out) {
+  sMfltHttpResponseParser parser;
+  memfault_http_response_parser_reset(&parser);
+
+  while (1) {
+    char buf[256];
+    const ssize_t len = recv(fd, buf, sizeof(buf), 0);
+    if (len <= 0) {
+      if ((len < 0) && (errno == EINTR)) {
+        continue;
+      }
+      MEMFAULT_LOG_ERROR("Receive error: len=%d, errno=%d", (int)len, errno);
+      return false;
+    }
+
+    size_t bytes_consumed;
+    if (memfault_http_response_parser_feed(&parser, buf, (size_t)len, &bytes_consumed)) {
+      break;
+    }
+  }
+
+  if (parser.parse_error != kMfltHttpParseStatus_Ok) {
+    MEMFAULT_LOG_ERROR("Malformed response: %d", (int)parser.parse_error);
+    return false;
+  }
+
+  *status_out = (uint32_t)parser.http_status_code;
+  *retry_after_s_out = parser.retry_after_s;
+  *keep_alive_out = parser.keep_alive;
+  return true;
+}
+
+static bool prv_read_response(sMfltHttpClient *client, sMfltHttpResponse *response) {
+  bool keep_alive;
+  if (!memfault_posix_port_http_read_response(client->fd, &response->status,
+                                              &response->retry_after_s, &keep_alive)) {
+    return false;
+  }
+  if (!keep_alive) {
+    prv_close_connection(client);
+  }
+  return true;
+}
+
+//! @return 1 if a message was posted, 0 if there was no more data to send or a negative value if
+//!  an error occurred
+static int prv_post_next_msg(sMfltHttpClient *client, sMfltHttpResponse *response) {
+  const sPacketizerConfig cfg = {
+    // let a single msg span many "memfault_packetizer_get_next" calls
+    .enable_multi_packet_chunk = true,
+  };
+
+  // will be populated with size of entire message queued for sending
+  sPacketizerMetadata metadata;
+  const bool data_available = memfault_packetizer_begin(&cfg, &metadata);
+  if (!data_available) {
+    return 0;
+  }
+
+  int fd = prv_get_connection(client);
+  if ((fd < 0) ||
+      !memfault_http_start_chunk_post(memfault_posix_port_http_send, &fd,
+                                      metadata.single_chunk_message_length)) {
+    goto error;
+  }
+
+  while (1) {
+    uint8_t buf[1024];
+    size_t buf_len = sizeof(buf);
+    const eMemfaultPacketizerStatus status = memfault_packetizer_get_next(buf, &buf_len);
+    if (status == kMemfaultPacketizerStatus_NoMoreData) {
+      break;
+    }
+    if (!memfault_posix_port_http_send(buf, buf_len, &fd)) {
+      goto error;
+    }
+    if (status == kMemfaultPacketizerStatus_EndOfChunk) {
+      break;
+    }
+  }
+
+  if (!prv_read_response(client, response)) {
+    // the message was consumed by now so it can't be re-sent
+    prv_close_connection(client);
+    return -1;
+  }
+  return 1;
+
+error:
+  // the message is sent again in its entirety on the next attempt
+  memfault_packetizer_abort();
+  prv_close_connection(client);
+  return -1;
+}
+
+int memfault_platform_http_client_post_data(sMfltHttpClient *client,
+                                            MemfaultHttpClientResponseCallback callback,
+                                            void *ctx) {
+  if (!memfault_packetizer_data_available()) {
+    return 0; // no new chunks to send
+  }
+
+  MEMFAULT_LOG_DEBUG("Posting Memfault Data");
+
+  sMfltHttpResponse response = { 0 };
+  size_t num_posted = 0;
+  int rv;
+  while ((rv = prv_post_next_msg(client, &response)) > 0) {
+    num_posted++;
+    if ((response.status < 200) || (response.status >= 300)) {
+      // the callback reports the failure, the rest of the data is sent on a later call
+      break;
+    }
+  }
+
+  if (rv < 0) {
+    if (callback) {
+      callback(NULL, ctx);
+    }
+    return rv;
+  }
+
+  if ((num_posted != 0) && callback) {
+    callback(&response, ctx);
+  }
+  MEMFAULT_LOG_DEBUG("Posting Memfault Data Complete!");
+  return 0;
+}
+
+int memfault_platform_http_client_wait_until_requests_completed(
+    MEMFAULT_UNUSED sMfltHttpClient *client, MEMFAULT_UNUSED uint32_t timeout_ms) {
+  // No-op because memfault_platform_http_client_post_data() is synchronous
+  return 0;
+}
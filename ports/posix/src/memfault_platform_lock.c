@@ -0,0 +1,32 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Recursive pthread mutex backing memfault_lock() / memfault_unlock() so SDK APIs can be called
+//! from several threads, i.e the application and the heartbeat timer thread.
+
+#include "memfault/core/platform/overrides.h"
+
+#include <pthread.h>
+
+static pthread_mutex_t s_memfault_mutex;
+static pthread_once_t s_memfault_mutex_once = PTHREAD_ONCE_INIT;
+
+static void prv_mutex_init(void) {
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&s_memfault_mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+void memfault_lock(void) {
+  pthread_once(&s_memfault_mutex_once, prv_mutex_init);
+  pthread_mutex_lock(&s_memfault_mutex);
+}
+
+void memfault_unlock(void) {
+  pthread_mutex_unlock(&s_memfault_mutex);
+}
@@ -0,0 +1,94 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Heartbeat timer for the metrics component, run from a dedicated thread
+
+#include "memfault/metrics/platform/timer.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "memfault/core/debug_log.h"
+#include "memfault/posix_port/port.h"
+
+static struct {
+  pthread_t thread;
+  bool running;
+  pthread_mutex_t mutex;
+  pthread_cond_t stop_cond;
+  bool stop;
+  uint64_t period_ms;
+  MemfaultPlatformTimerCallback *callback;
+} s_metrics_timer = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void prv_timespec_add_ms(struct timespec *ts, uint64_t ms) {
+  const uint64_t nsec = (uint64_t)ts->tv_nsec + ((ms % 1000) * 1000000);
+  ts->tv_sec += (time_t)((ms / 1000) + (nsec / 1000000000));
+  ts->tv_nsec = (long)(nsec % 1000000000);
+}
+
+static void *prv_timer_thread(void *arg) {
+  (void)arg;
+
+  // deadlines are absolute so the callback run time doesn't make the period drift
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  pthread_mutex_lock(&s_metrics_timer.mutex);
+  while (!s_metrics_timer.stop) {
+    prv_timespec_add_ms(&deadline, s_metrics_timer.period_ms);
+    const int rv = pthread_cond_timedwait(&s_metrics_timer.stop_cond, &s_metrics_timer.mutex,
+                                          &deadline);
+    if ((rv == ETIMEDOUT) && !s_metrics_timer.stop) {
+      pthread_mutex_unlock(&s_metrics_timer.mutex);
+      s_metrics_timer.callback();
+      pthread_mutex_lock(&s_metrics_timer.mutex);
+    }
+  }
+  pthread_mutex_unlock(&s_metrics_timer.mutex);
+  return NULL;
+}
+
+bool memfault_platform_metrics_timer_boot(uint32_t period_sec,
+                                          MemfaultPlatformTimerCallback callback) {
+  memfault_posix_port_metrics_timer_stop();
+
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&s_metrics_timer.stop_cond, &attr);
+  pthread_condattr_destroy(&attr);
+
+  s_metrics_timer.stop = false;
+  s_metrics_timer.period_ms = (uint64_t)period_sec * MEMFAULT_POSIX_METRICS_TIMER_MS_PER_SEC;
+  s_metrics_timer.callback = callback;
+  if (pthread_create(&s_metrics_timer.thread, NULL, prv_timer_thread, NULL) != 0) {
+    MEMFAULT_LOG_ERROR("Unable to start the heartbeat timer thread");
+    pthread_cond_destroy(&s_metrics_timer.stop_cond);
+    return false;
+  }
+  s_metrics_timer.running = true;
+  return true;
+}
+
+void memfault_posix_port_metrics_timer_stop(void) {
+  if (!s_metrics_timer.running) {
+    return;
+  }
+
+  pthread_mutex_lock(&s_metrics_timer.mutex);
+  s_metrics_timer.stop = true;
+  pthread_cond_signal(&s_metrics_timer.stop_cond);
+  pthread_mutex_unlock(&s_metrics_timer.mutex);
+
+  pthread_join(s_metrics_timer.thread, NULL);
+  pthread_cond_destroy(&s_metrics_timer.stop_cond);
+  s_metrics_timer.running = false;
+}
@@ -0,0 +1,334 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault/posix_port/gateway.h"
+
+#if MEMFAULT_HTTP_GATEWAY_ENABLED
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memfault/core/debug_log.h"
+#include "memfault/http/chunk_batch.h"
+#include "memfault/http/retry_policy.h"
+#include "memfault/http/utils.h"
+#include "memfault_posix_port_private.h"
+
+#if !MEMFAULT_HTTP_CHUNK_BATCH_ENABLED
+#error "The gateway compresses batches with memfault_http_chunk_batch_compress()"
+#endif
+
+#define DEFAULT_MAX_DEVICES 16
+#define DEFAULT_QUEUE_SIZE_PER_DEVICE (4 * 1024)
+#define DEFAULT_MAX_BATCH_SIZE (16 * 1024)
+
+struct MfltPosixGateway {
+  sMfltPosixGatewayConfig config;
+  pthread_t uploader;
+
+  //! Protects everything below
+  pthread_mutex_t lock;
+  //! Signaled when chunks are added, a flush is requested or the gateway is stopped
+  pthread_cond_t wakeup;
+  //! Signaled whenever a batch completes
+  pthread_cond_t batch_done;
+  bool stop;
+  size_t num_flush_requests;
+  sMfltGateway store;
+  sMfltGatewayDevice *devices;
+  uint8_t *queue_storage;
+  sMfltPosixGatewayStats stats;
+
+  //! Only used by the uploader thread
+  int fd;
+  uint8_t *body;
+  uint8_t *compressed_body;
+};
+
+static void prv_timespec_add_ms(struct timespec *ts, uint64_t ms) {
+  const uint64_t nsec = (uint64_t)ts->tv_nsec + ((ms % 1000) * 1000000);
+  ts->tv_sec += (time_t)((ms / 1000) + (nsec / 1000000000));
+  ts->tv_nsec = (long)(nsec % 1000000000);
+}
+
+//! Waits for 'ms' to elapse or for the gateway to be stopped. Must be called with the lock held.
+//!
+//! @param until_flush Also stop waiting when a flush is requested
+static void prv_wait(sMfltPosixGateway *gateway, uint64_t ms, bool until_flush) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  prv_timespec_add_ms(&deadline, ms);
+
+  int rv = 0;
+  while (!gateway->stop && !(until_flush && (gateway->num_flush_requests != 0)) &&
+         (rv != ETIMEDOUT)) {
+    rv = pthread_cond_timedwait(&gateway->wakeup, &gateway->lock, &deadline);
+  }
+}
+
+static void prv_close_connection(sMfltPosixGateway *gateway) {
+  if (gateway->fd >= 0) {
+    close(gateway->fd);
+    gateway->fd = -1;
+  }
+}
+
+static int prv_get_connection(sMfltPosixGateway *gateway) {
+  if ((gateway->fd >= 0) && !memfault_posix_port_http_idle_connection_is_usable(gateway->fd)) {
+    prv_close_connection(gateway);
+  }
+  if (gateway->fd < 0) {
+    gateway->fd = memfault_posix_port_http_connect();
+    if (gateway->fd >= 0) {
+      pthread_mutex_lock(&gateway->lock);
+      gateway->stats.num_connections++;
+      pthread_mutex_unlock(&gateway->lock);
+    }
+  }
+  return gateway->fd;
+}
+
+//! Posts a batch built by memfault_gateway_batch_build() to the chunks endpoint of its device
+//!
+//! @param[out] status_out The status of the response or 0 if none was received
+//! @param[out] body_bytes_out The size of the body as sent over the wire
+static void prv_post_batch(sMfltPosixGateway *gateway, const sMfltGatewayBatch *batch,
+                           uint32_t *status_out, uint32_t *retry_after_s_out,
+                           size_t *body_bytes_out) {
+  *status_out = 0;
+  *retry_after_s_out = 0;
+
+  const uint8_t *body = gateway->body;
+  size_t body_len = batch->body_len;
+  size_t compressed_len;
+  bool compressed = false;
+  if (gateway->config.compress &&
+      memfault_http_chunk_batch_compress(gateway->body, body_len, gateway->compressed_body,
+                                         gateway->config.max_batch_size, &compressed_len)) {
+    body = gateway->compressed_body;
+    body_len = compressed_len;
+    compressed = true;
+  }
+  *body_bytes_out = body_len;
+
+  int fd = prv_get_connection(gateway);
+  if (fd < 0) {
+    return;
+  }
+
+  const bool sent = (compressed ?
+                     memfault_http_start_compressed_device_chunk_batch_post(
+                         memfault_posix_port_http_send, &fd, batch->device_serial, body_len) :
+                     memfault_http_start_device_chunk_batch_post(
+                         memfault_posix_port_http_send, &fd, batch->device_serial, body_len)) &&
+      memfault_posix_port_http_send(body, body_len, &fd);
+
+  bool keep_alive = false;
+  if (!sent ||
+      !memfault_posix_port_http_read_response(fd, status_out, retry_after_s_out, &keep_alive)) {
+    *status_out = 0;
+    keep_alive = false;
+  }
+  if (!keep_alive) {
+    prv_close_connection(gateway);
+  }
+}
+
+static bool prv_wants_upload(sMfltPosixGateway *gateway) {
+  return memfault_gateway_get_num_queued_chunks(&gateway->store) != 0;
+}
+
+static void *prv_uploader_thread(void *arg) {
+  sMfltPosixGateway *gateway = arg;
+
+  pthread_mutex_lock(&gateway->lock);
+  while (!gateway->stop) {
+    if (!prv_wants_upload(gateway)) {
+      pthread_cond_wait(&gateway->wakeup, &gateway->lock);
+      continue;
+    }
+
+    // give the other devices a chance to add their chunks so the batch fills up
+    if (gateway->config.linger_ms != 0) {
+      prv_wait(gateway, gateway->config.linger_ms, true);
+      if (gateway->stop) {
+        break;
+      }
+    }
+
+    // chunks which could never fit in a batch are rejected by memfault_posix_gateway_add_chunk()
+    // so there is always something to send at this point
+    sMfltGatewayBatch batch;
+    memfault_gateway_batch_build(&gateway->store, gateway->body, gateway->config.max_batch_size,
+                                 &batch);
+    pthread_mutex_unlock(&gateway->lock);
+
+    uint32_t status;
+    uint32_t retry_after_s;
+    size_t body_bytes;
+    prv_post_batch(gateway, &batch, &status, &retry_after_s, &body_bytes);
+
+    const bool delivered = (status >= 200) && (status < 300);
+    const bool retry = !delivered && memfault_http_retry_policy_is_retryable_status(status);
+    if (!delivered) {
+      MEMFAULT_LOG_ERROR("Gateway upload of %d chunks of %s failed, status=%d%s",
+                         (int)batch.num_chunks, batch.device_serial, (int)status,
+                         retry ? "" : ", dropping them");
+    }
+
+    pthread_mutex_lock(&gateway->lock);
+    // a batch which is not worth retrying is dropped so it doesn't hold up the queues forever
+    memfault_gateway_batch_complete(&gateway->store, !retry);
+    sMfltPosixGatewayStats *stats = &gateway->stats;
+    stats->num_batches++;
+    stats->body_bytes += body_bytes;
+    stats->uncompressed_body_bytes += batch.body_len;
+    if (delivered) {
+      stats->num_chunks_forwarded += batch.num_chunks;
+    } else if (retry) {
+      stats->num_failed_batches++;
+    } else {
+      stats->num_dropped_batches++;
+    }
+    pthread_cond_broadcast(&gateway->batch_done);
+
+    if (retry) {
+      const uint64_t delay_ms = (retry_after_s != 0) ? ((uint64_t)retry_after_s * 1000) :
+                                                       MEMFAULT_POSIX_GATEWAY_RETRY_DELAY_MS;
+      prv_wait(gateway, delay_ms, false);
+    }
+  }
+  pthread_mutex_unlock(&gateway->lock);
+
+  prv_close_connection(gateway);
+  return NULL;
+}
+
+static void prv_free(sMfltPosixGateway *gateway) {
+  free(gateway->devices);
+  free(gateway->queue_storage);
+  free(gateway->body);
+  free(gateway->compressed_body);
+  free(gateway);
+}
+
+sMfltPosixGateway *memfault_posix_gateway_start(const sMfltPosixGatewayConfig *config) {
+  sMfltPosixGateway *gateway = calloc(1, sizeof(*gateway));
+  if (gateway == NULL) {
+    return NULL;
+  }
+
+  gateway->config = *config;
+  sMfltPosixGatewayConfig *cfg = &gateway->config;
+  if (cfg->max_devices == 0) {
+    cfg->max_devices = DEFAULT_MAX_DEVICES;
+  }
+  if (cfg->queue_size_per_device == 0) {
+    cfg->queue_size_per_device = DEFAULT_QUEUE_SIZE_PER_DEVICE;
+  }
+  if (cfg->max_batch_size == 0) {
+    cfg->max_batch_size = DEFAULT_MAX_BATCH_SIZE;
+  }
+
+  gateway->fd = -1;
+  gateway->devices = calloc(cfg->max_devices, sizeof(*gateway->devices));
+  gateway->queue_storage = malloc(cfg->max_devices * cfg->queue_size_per_device);
+  gateway->body = malloc(cfg->max_batch_size);
+  gateway->compressed_body = malloc(cfg->max_batch_size);
+  if ((gateway->devices == NULL) || (gateway->queue_storage == NULL) ||
+      (gateway->body == NULL) || (gateway->compressed_body == NULL) ||
+      !memfault_gateway_init(&gateway->store, gateway->devices, cfg->max_devices,
+                             gateway->queue_storage,
+                             cfg->max_devices * cfg->queue_size_per_device,
+                             cfg->max_batch_size)) {
+    prv_free(gateway);
+    return NULL;
+  }
+
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&gateway->wakeup, &attr);
+  pthread_cond_init(&gateway->batch_done, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_mutex_init(&gateway->lock, NULL);
+
+  if (pthread_create(&gateway->uploader, NULL, prv_uploader_thread, gateway) != 0) {
+    MEMFAULT_LOG_ERROR("Unable to start the gateway uploader thread");
+    pthread_cond_destroy(&gateway->wakeup);
+    pthread_cond_destroy(&gateway->batch_done);
+    pthread_mutex_destroy(&gateway->lock);
+    prv_free(gateway);
+    return NULL;
+  }
+  return gateway;
+}
+
+void memfault_posix_gateway_stop(sMfltPosixGateway *gateway) {
+  pthread_mutex_lock(&gateway->lock);
+  gateway->stop = true;
+  pthread_cond_broadcast(&gateway->wakeup);
+  pthread_cond_broadcast(&gateway->batch_done);
+  pthread_mutex_unlock(&gateway->lock);
+
+  pthread_join(gateway->uploader, NULL);
+  pthread_cond_destroy(&gateway->wakeup);
+  pthread_cond_destroy(&gateway->batch_done);
+  pthread_mutex_destroy(&gateway->lock);
+  prv_free(gateway);
+}
+
+int memfault_posix_gateway_add_chunk(sMfltPosixGateway *gateway, const char *device_serial,
+                                     const void *chunk, size_t chunk_len) {
+  pthread_mutex_lock(&gateway->lock);
+  const int rv = memfault_gateway_add_chunk(&gateway->store, device_serial, chunk, chunk_len);
+  if (rv == 0) {
+    pthread_cond_signal(&gateway->wakeup);
+  }
+  pthread_mutex_unlock(&gateway->lock);
+  return rv;
+}
+
+bool memfault_posix_gateway_flush(sMfltPosixGateway *gateway, uint32_t timeout_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  prv_timespec_add_ms(&deadline, timeout_ms);
+
+  pthread_mutex_lock(&gateway->lock);
+  gateway->num_flush_requests++;
+  pthread_cond_broadcast(&gateway->wakeup);
+  int rv = 0;
+  while (prv_wants_upload(gateway) && !gateway->stop && (rv != ETIMEDOUT)) {
+    rv = pthread_cond_timedwait(&gateway->batch_done, &gateway->lock, &deadline);
+  }
+  const bool drained = !prv_wants_upload(gateway);
+  gateway->num_flush_requests--;
+  pthread_mutex_unlock(&gateway->lock);
+  return drained;
+}
+
+void memfault_posix_gateway_get_stats(sMfltPosixGateway *gateway,
+                                      sMfltPosixGatewayStats *stats_out) {
+  pthread_mutex_lock(&gateway->lock);
+  *stats_out = gateway->stats;
+  pthread_mutex_unlock(&gateway->lock);
+}
+
+bool memfault_posix_gateway_get_device_stats(sMfltPosixGateway *gateway,
+                                             const char *device_serial,
+                                             sMfltGatewayDeviceStats *stats_out) {
+  pthread_mutex_lock(&gateway->lock);
+  const bool found = memfault_gateway_get_device_stats(&gateway->store, device_serial, stats_out);
+  pthread_mutex_unlock(&gateway->lock);
+  return found;
+}
+
+#endif /* MEMFAULT_HTTP_GATEWAY_ENABLED */
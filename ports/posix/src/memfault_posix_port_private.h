@@ -0,0 +1,50 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Internal helpers shared between the files of the POSIX port
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Maps a file from the storage directory into memory, creating it (zero filled) if needed
+//!
+//! @param name The name of the file within memfault_posix_port_get_storage_dir()
+//! @param size The size of the mapping. The file is grown or truncated to match.
+//!
+//! @return The address of the mapping or NULL if the file could not be mapped
+void *memfault_posix_port_map_file(const char *name, size_t size);
+
+//! Maps the file backing coredump storage
+void memfault_posix_port_coredump_storage_boot(void);
+
+//! Opens a connection to the API host and port of g_mflt_http_client_config
+//!
+//! @return the socket or -1 if the connection could not be established
+int memfault_posix_port_http_connect(void);
+
+//! An idle keep-alive connection should have nothing to read. If it's readable, the server has
+//! either closed it or sent something unexpected so it can't be reused.
+bool memfault_posix_port_http_idle_connection_is_usable(int fd);
+
+//! A MfltHttpClientSendCb writing to the socket pointed to by 'ctx' (an int *)
+bool memfault_posix_port_http_send(const void *data, size_t data_len, void *ctx);
+
+//! Reads and parses the response to a request
+//!
+//! @return true if a well formed response was received, false on error
+bool memfault_posix_port_http_read_response(int fd, uint32_t *status_out,
+                                            uint32_t *retry_after_s_out, bool *keep_alive_out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,249 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Load test for the gateway of the POSIX port (memfault/posix_port/gateway.h)
+//!
+//! Simulates a fleet of downstream nodes, each on a thread of its own with its own event storage,
+//! metrics and packetizer instances. Every node serializes heartbeats, drains them in MTU sized
+//! chunks with memfault_packetizer_ctx_get_chunk() like a BLE node would and hands the chunks to
+//! the gateway, which forwards them in per-device batches. Point it at the ingestion stand-in
+//! server (tests/ingestion_server) to check what arrives on the other end:
+//!
+//!   ./memfault_ingestion_server -p 8080 &
+//!   ./memfault_gateway_load_test -p 8080 -n 64 -c 100 -z
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memfault/core/data_packetizer.h"
+#include "memfault/core/data_source_rle.h"
+#include "memfault/core/event_storage.h"
+#include "memfault/http/http_client.h"
+#include "memfault/metrics/metrics.h"
+#include "memfault/posix_port/gateway.h"
+
+sMfltHttpClientConfig g_mflt_http_client_config = {
+  .api_key = "00112233445566778899aabbccddeeff",
+  .api_host = "127.0.0.1",
+  .api_no_tls = true,
+  .api_port = 8080,
+};
+
+typedef struct {
+  size_t num_heartbeats;
+  size_t mtu;
+} sLoadTestConfig;
+
+typedef struct {
+  const sLoadTestConfig *config;
+  sMfltPosixGateway *gateway;
+  char device_serial[32];
+  sMemfaultDeviceInfo device_info;
+  uint8_t event_storage_buf[1024];
+  sMfltEventStorageCtx event_storage;
+  sMfltMetricsCtx metrics;
+  sMfltPacketizerCtx packetizer;
+
+  uint64_t num_chunks;
+  uint64_t chunk_bytes;
+  uint64_t num_queue_full;
+} sLoadTestNode;
+
+static uint64_t prv_time_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000) + ((uint64_t)ts.tv_nsec / 1000000);
+}
+
+//! Drains the events of the node into the gateway, one MTU sized chunk at a time
+static void prv_drain_node(sLoadTestNode *node) {
+  uint8_t chunk[512];
+  size_t chunk_len = node->config->mtu;
+  while (memfault_packetizer_ctx_get_chunk(&node->packetizer, chunk, &chunk_len)) {
+    int rv;
+    while ((rv = memfault_posix_gateway_add_chunk(node->gateway, node->device_serial, chunk,
+                                                  chunk_len)) == kMfltGatewayError_QueueFull) {
+      // a real node would be told to hold off over the link, just wait for room here
+      node->num_queue_full++;
+      usleep(1000);
+    }
+    if (rv != 0) {
+      fprintf(stderr, "%s: failed to queue a chunk: %d\n", node->device_serial, rv);
+      return;
+    }
+    node->num_chunks++;
+    node->chunk_bytes += chunk_len;
+    chunk_len = node->config->mtu;
+  }
+}
+
+static void *prv_node_thread(void *arg) {
+  sLoadTestNode *node = arg;
+  for (size_t i = 0; i < node->config->num_heartbeats; i++) {
+    memfault_metrics_ctx_heartbeat_set_unsigned(&node->metrics,
+                                                MEMFAULT_METRICS_KEY(MainLoopIterations),
+                                                (uint32_t)rand());
+    if (!memfault_metrics_ctx_heartbeat_trigger(&node->metrics)) {
+      fprintf(stderr, "%s: event storage full\n", node->device_serial);
+    }
+    prv_drain_node(node);
+  }
+  return NULL;
+}
+
+static bool prv_node_init(sLoadTestNode *node, size_t idx, const sLoadTestConfig *config,
+                          sMfltPosixGateway *gateway) {
+  *node = (sLoadTestNode) {
+    .config = config,
+    .gateway = gateway,
+  };
+  snprintf(node->device_serial, sizeof(node->device_serial), "LOADTEST%05d", (int)idx);
+  node->device_info = (sMemfaultDeviceInfo) {
+    .device_serial = node->device_serial,
+    .software_type = "sensor-node",
+    .software_version = "1.0.0",
+    .hardware_version = "evt",
+  };
+
+  const sMemfaultEventStorageImpl *storage = memfault_events_storage_ctx_init(
+      &node->event_storage, node->event_storage_buf, sizeof(node->event_storage_buf));
+  if ((storage == NULL) ||
+      (memfault_metrics_ctx_init(&node->metrics, storage, &node->device_info) != 0)) {
+    return false;
+  }
+
+  const sMfltPacketizerSources sources = {
+    .event_source = memfault_events_storage_ctx_get_data_source(&node->event_storage),
+  };
+  memfault_packetizer_ctx_init(&node->packetizer, &sources);
+  return true;
+}
+
+static void prv_usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-H host] [-p port] [-k project_key] [-n num_nodes] [-c num_heartbeats]\n"
+          "          [-m mtu] [-b max_batch_size] [-l linger_ms] [-z]\n"
+          "  -H  host to post to (default 127.0.0.1)\n"
+          "  -p  port to post to (default 8080)\n"
+          "  -k  Memfault-Project-Key to post with\n"
+          "  -n  number of simulated nodes (default 16)\n"
+          "  -c  heartbeats generated by each node (default 100)\n"
+          "  -m  size of the chunks produced by the nodes (default 20, a BLE MTU)\n"
+          "  -b  largest batch posted by the gateway (default 16384)\n"
+          "  -l  how long the gateway waits for batches to fill up (default 10ms)\n"
+          "  -z  compress batches\n",
+          prog);
+}
+
+int main(int argc, char *argv[]) {
+  sLoadTestConfig config = {
+    .num_heartbeats = 100,
+    .mtu = 20,
+  };
+  sMfltPosixGatewayConfig gateway_config = {
+    .max_batch_size = 16 * 1024,
+    .linger_ms = 10,
+  };
+  size_t num_nodes = 16;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "H:p:k:n:c:m:b:l:zh")) != -1) {
+    switch (opt) {
+      case 'H':
+        g_mflt_http_client_config.api_host = optarg;
+        break;
+      case 'p':
+        g_mflt_http_client_config.api_port = (uint16_t)strtoul(optarg, NULL, 10);
+        break;
+      case 'k':
+        g_mflt_http_client_config.api_key = optarg;
+        break;
+      case 'n':
+        num_nodes = strtoul(optarg, NULL, 10);
+        break;
+      case 'c':
+        config.num_heartbeats = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        config.mtu = strtoul(optarg, NULL, 10);
+        break;
+      case 'b':
+        gateway_config.max_batch_size = strtoul(optarg, NULL, 10);
+        break;
+      case 'l':
+        gateway_config.linger_ms = (uint32_t)strtoul(optarg, NULL, 10);
+        break;
+      case 'z':
+        gateway_config.compress = true;
+        break;
+      default:
+        prv_usage(argv[0]);
+        return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if ((num_nodes == 0) || (config.mtu < MEMFAULT_PACKETIZER_MIN_BUF_LEN) || (config.mtu > 512)) {
+    prv_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  gateway_config.max_devices = num_nodes;
+
+  sMfltPosixGateway *gateway = memfault_posix_gateway_start(&gateway_config);
+  sLoadTestNode *nodes = calloc(num_nodes, sizeof(*nodes));
+  pthread_t *threads = calloc(num_nodes, sizeof(*threads));
+  if ((gateway == NULL) || (nodes == NULL) || (threads == NULL)) {
+    fprintf(stderr, "Failed to start the gateway\n");
+    return EXIT_FAILURE;
+  }
+
+  const uint64_t start_ms = prv_time_ms();
+  for (size_t i = 0; i < num_nodes; i++) {
+    if (!prv_node_init(&nodes[i], i, &config, gateway) ||
+        (pthread_create(&threads[i], NULL, prv_node_thread, &nodes[i]) != 0)) {
+      fprintf(stderr, "Failed to start node %d\n", (int)i);
+      return EXIT_FAILURE;
+    }
+  }
+
+  uint64_t num_chunks = 0;
+  uint64_t chunk_bytes = 0;
+  uint64_t num_queue_full = 0;
+  for (size_t i = 0; i < num_nodes; i++) {
+    pthread_join(threads[i], NULL);
+    num_chunks += nodes[i].num_chunks;
+    chunk_bytes += nodes[i].chunk_bytes;
+    num_queue_full += nodes[i].num_queue_full;
+  }
+  const bool drained = memfault_posix_gateway_flush(gateway, 30 * 1000);
+  const uint64_t elapsed_ms = prv_time_ms() - start_ms;
+
+  sMfltPosixGatewayStats stats;
+  memfault_posix_gateway_get_stats(gateway, &stats);
+  memfault_posix_gateway_stop(gateway);
+
+  const double elapsed_s = (elapsed_ms != 0) ? ((double)elapsed_ms / 1000.0) : 0.001;
+  printf("nodes:               %d\n", (int)num_nodes);
+  printf("chunks produced:     %" PRIu64 " (%" PRIu64 " bytes, %" PRIu64 " held off)\n",
+         num_chunks, chunk_bytes, num_queue_full);
+  printf("chunks forwarded:    %" PRIu64 "%s\n", stats.num_chunks_forwarded,
+         drained ? "" : " (timed out draining the queues)");
+  printf("batches:             %" PRIu64 " (%" PRIu64 " retried, %" PRIu64 " dropped)\n",
+         stats.num_batches, stats.num_failed_batches, stats.num_dropped_batches);
+  printf("bytes posted:        %" PRIu64 " (%" PRIu64 " before compression)\n", stats.body_bytes,
+         stats.uncompressed_body_bytes);
+  printf("connections:         %" PRIu64 "\n", stats.num_connections);
+  printf("elapsed:             %.3fs, %.0f chunks/s, %.1f kB/s\n", elapsed_s,
+         (double)stats.num_chunks_forwarded / elapsed_s,
+         (double)stats.body_bytes / 1024.0 / elapsed_s);
+
+  free(threads);
+  free(nodes);
+  return (drained && (stats.num_chunks_forwarded == num_chunks)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -7,15 +7,18 @@
 
 #include <soc.h>
 #include <init.h>
+#include <kernel.h>
 #include "zephyr_release_specific_headers.h"
 
+#include "memfault/core/boot_profile.h"
 #include "memfault/core/compiler.h"
 #include "memfault/core/event_storage.h"
+#include "memfault/panics/crash_loop_policy.h"
 #include "memfault/panics/reboot_tracking.h"
 #include "memfault/panics/trace_event.h"
 
 #if !defined(CONFIG_MEMFAULT_EVENT_STORAGE_SIZE)
-#define CONFIG_MEMFAULT_EVENT_STORAGE_SIZE 100
+#define CONFIG_MEMFAULT_EVENT_STORAGE_SIZE 200
 #endif
 
 void memfault_platform_halt_if_debugging(void) {
@@ -30,6 +33,22 @@ void memfault_platform_reboot(void) {
   MEMFAULT_UNREACHABLE;
 }
 
+uint64_t memfault_platform_get_time_since_boot_ms(void) {
+  return (uint64_t)k_uptime_get();
+}
+
+uint64_t memfault_reboot_tracking_get_time_since_boot_ms(void) {
+  return memfault_platform_get_time_since_boot_ms();
+}
+
+uint32_t memfault_platform_get_cycle_count(void) {
+  return k_cycle_get_32();
+}
+
+uint32_t memfault_platform_get_cycles_per_ms(void) {
+  return (uint32_t)(sys_clock_hw_cycles_per_sec() / 1000);
+}
+
 // By default, the Zephyr NMI handler is an infinite loop. Instead
 // let's register the Memfault Exception Handler
 static int prv_install_nmi_handler(struct device *dev) {
@@ -49,6 +68,7 @@ static uint8_t s_reboot_tracking[MEMFAULT_REBOOT_TRACKING_REGION_SIZE];
 
 static int prv_init_and_log_reboot(struct device *dev) {
   memfault_reboot_tracking_boot(s_reboot_tracking, NULL);
+  memfault_crash_loop_policy_boot();
 
   static uint8_t s_event_storage[CONFIG_MEMFAULT_EVENT_STORAGE_SIZE];
   const sMemfaultEventStorageImpl *evt_storage =
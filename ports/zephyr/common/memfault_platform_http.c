@@ -10,6 +10,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <init.h>
 #include <kernel.h>
@@ -20,10 +21,26 @@
 
 #include "memfault/core/data_packetizer.h"
 #include "memfault/core/debug_log.h"
+#include "memfault/core/math.h"
 #include "memfault/http/http_client.h"
+#include "memfault/http/retry_policy.h"
 #include "memfault/http/root_certs.h"
 #include "memfault/http/utils.h"
 
+#if defined(CONFIG_MEMFAULT_HTTP_METRICS)
+#include "memfault/metrics/metrics.h"
+
+#define MEMFAULT_HTTP_METRIC_ADD(key_name) \
+  memfault_metrics_heartbeat_add(MEMFAULT_METRICS_KEY(key_name), 1)
+#define MEMFAULT_HTTP_METRIC_TIMER_START(key_name) \
+  memfault_metrics_heartbeat_timer_start(MEMFAULT_METRICS_KEY(key_name))
+#define MEMFAULT_HTTP_METRIC_TIMER_STOP(key_name) \
+  memfault_metrics_heartbeat_timer_stop(MEMFAULT_METRICS_KEY(key_name))
+#else
+#define MEMFAULT_HTTP_METRIC_ADD(key_name)
+#define MEMFAULT_HTTP_METRIC_TIMER_START(key_name)
+#define MEMFAULT_HTTP_METRIC_TIMER_STOP(key_name)
+#endif
 
 #if !defined(MBEDTLS_CONFIG_FILE)
 #include "mbedtls/config.h"
@@ -35,6 +52,29 @@
 #error "MBEDTLS_SSL_SERVER_NAME_INDICATION must be enabled for Memfault HTTPS. This can be done with CONFIG_MBEDTLS_USER_CONFIG_ENABLE/FILE"
 #endif
 
+#if !defined(CONFIG_MEMFAULT_HTTP_KEEPALIVE_IDLE_TIMEOUT_MS)
+#define CONFIG_MEMFAULT_HTTP_KEEPALIVE_IDLE_TIMEOUT_MS 30000
+#endif
+
+#if !defined(CONFIG_MEMFAULT_HTTP_MAX_PIPELINED_REQUESTS)
+#define CONFIG_MEMFAULT_HTTP_MAX_PIPELINED_REQUESTS 1
+#endif
+
+// A message is only deleted once its 2xx response has been read (see
+// sPacketizerConfig.enable_delivery_confirmation) and the data sources hold a single message
+// awaiting confirmation, so requests can't be pipelined yet
+#if CONFIG_MEMFAULT_HTTP_MAX_PIPELINED_REQUESTS != 1
+#error "CONFIG_MEMFAULT_HTTP_MAX_PIPELINED_REQUESTS must be 1"
+#endif
+
+#if !defined(CONFIG_MEMFAULT_HTTP_MAX_POSTS_PER_CALL)
+#define CONFIG_MEMFAULT_HTTP_MAX_POSTS_PER_CALL 5
+#endif
+
+#if !defined(CONFIG_MEMFAULT_HTTP_DNS_CACHE_TTL_S)
+#define CONFIG_MEMFAULT_HTTP_DNS_CACHE_TTL_S 300
+#endif
+
 typedef enum {
   // arbitrarily high base so as not to conflict with id used for other certs in use by the system
   kMemfaultRootCert_Base = 1000,
@@ -73,6 +113,31 @@ error:
 
 SYS_INIT(prv_memfault_http_install_certs, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
 
+//! State of the connection to the Memfault chunks endpoint which is kept open across calls to
+//! memfault_zephyr_port_post_data() when keep-alive is enabled
+static struct {
+  int fd;
+  //! k_uptime_get() of the last time the connection was used
+  int64_t last_activity_ms;
+} s_memfault_http_conn = {
+  .fd = -1,
+};
+
+//! The address the Memfault API host was last resolved to. Zephyr's resolver doesn't report the
+//! TTL of the records so they are kept for CONFIG_MEMFAULT_HTTP_DNS_CACHE_TTL_S
+static struct {
+  bool valid;
+  //! The host and port which were resolved, the entry is stale if either changes
+  char host[64];
+  int port;
+  //! k_uptime_get() of the time the lookup was made
+  int64_t resolved_at_ms;
+  int family;
+  int socktype;
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+} s_memfault_dns_cache;
+
 static bool prv_send_data(const void *data, size_t data_len, void *ctx) {
   int fd = *(int *)ctx;
   int rv = send(fd, data, data_len, 0);
@@ -86,12 +151,25 @@ static int prv_configure_tls_socket(int sock_fd) {
   if (rv == -1) {
     return rv;
   }
+#if defined(CONFIG_MEMFAULT_HTTP_TLS_SESSION_CACHE)
+#if !defined(TLS_SESSION_CACHE)
+#error "CONFIG_MEMFAULT_HTTP_TLS_SESSION_CACHE requires the TLS_SESSION_CACHE socket option"
+#endif
+  // The socket layer saves the session negotiated with the server (session ID or ticket) and
+  // offers it on the next connection to the same peer so the abbreviated handshake can be used
+  const int session_cache = TLS_SESSION_CACHE_ENABLED;
+  rv = setsockopt(sock_fd, SOL_TLS, TLS_SESSION_CACHE, &session_cache, sizeof(session_cache));
+  if (rv == -1) {
+    // not fatal, every connection will just use a full handshake
+    MEMFAULT_LOG_WARN("Failed to enable TLS session cache, errno=%d", errno);
+  }
+#endif
   const char *host = MEMFAULT_HTTP_GET_API_HOST();
   const size_t host_name_len = strlen(host);
   return setsockopt(sock_fd, SOL_TLS, TLS_HOSTNAME, host, host_name_len + 1);
 }
 
-static int prv_configure_socket(struct addrinfo *res, int fd) {
+static int prv_configure_socket(const struct sockaddr *addr, socklen_t addrlen, int fd) {
   int rv;
   if (!g_mflt_http_client_config.api_no_tls) {
     rv = prv_configure_tls_socket(fd);
@@ -101,18 +179,29 @@ static int prv_configure_socket(struct addrinfo *res, int fd) {
     }
   }
 
-  return connect(fd, res->ai_addr, res->ai_addrlen);
+  // for a TLS socket, the handshake is performed as part of the connect
+  MEMFAULT_HTTP_METRIC_TIMER_START(MemfaultSdkMetric_HttpConnectTimeMs);
+  rv = connect(fd, addr, addrlen);
+  MEMFAULT_HTTP_METRIC_TIMER_STOP(MemfaultSdkMetric_HttpConnectTimeMs);
+  if (rv < 0) {
+    MEMFAULT_HTTP_METRIC_ADD(MemfaultSdkMetric_HttpConnectFailures);
+    return rv;
+  }
+
+  MEMFAULT_HTTP_METRIC_ADD(MemfaultSdkMetric_HttpConnections);
+  return rv;
 }
 
-static int prv_open_and_configure_socket(struct addrinfo *res) {
+static int prv_open_and_configure_socket(void) {
   const int protocol = g_mflt_http_client_config.api_no_tls ? IPPROTO_TCP : IPPROTO_TLS_1_2;
-  int fd = socket(res->ai_family, res->ai_socktype, protocol);
+  int fd = socket(s_memfault_dns_cache.family, s_memfault_dns_cache.socktype, protocol);
   if (fd < 0) {
     MEMFAULT_LOG_ERROR("Failed to open socket, errno=%d", errno);
     return fd;
   }
 
-  int rv = prv_configure_socket(res, fd);
+  int rv = prv_configure_socket((const struct sockaddr *)&s_memfault_dns_cache.addr,
+                                s_memfault_dns_cache.addrlen, fd);
   if (rv < 0) {
     close(fd);
     return rv;
@@ -120,6 +209,124 @@ static int prv_open_and_configure_socket(struct addrinfo *res) {
   return fd;
 }
 
+static bool prv_dns_cache_is_valid(const char *host, int port) {
+  if (!s_memfault_dns_cache.valid || (s_memfault_dns_cache.port != port) ||
+      (strcmp(s_memfault_dns_cache.host, host) != 0)) {
+    return false;
+  }
+  const int64_t age_ms = k_uptime_get() - s_memfault_dns_cache.resolved_at_ms;
+  return (age_ms < ((int64_t)CONFIG_MEMFAULT_HTTP_DNS_CACHE_TTL_S * 1000));
+}
+
+//! Resolves the Memfault API host unless a lookup which hasn't expired yet is cached
+//!
+//! @return 0 if s_memfault_dns_cache holds the address to connect to, else the getaddrinfo() error
+static int prv_resolve(const char *host, int port) {
+  if (prv_dns_cache_is_valid(host, port)) {
+    MEMFAULT_HTTP_METRIC_ADD(MemfaultSdkMetric_HttpDnsCacheHits);
+    return 0;
+  }
+
+  struct addrinfo hints = {
+    .ai_family = AF_INET,
+    .ai_socktype = SOCK_STREAM,
+  };
+  struct addrinfo *res = NULL;
+  char port_str[10] = { 0 };
+  snprintf(port_str, sizeof(port_str), "%d", port);
+
+  MEMFAULT_HTTP_METRIC_ADD(MemfaultSdkMetric_HttpDnsLookups);
+  s_memfault_dns_cache.valid = false;
+  const int rv = getaddrinfo(host, port_str, &hints, &res);
+  if (rv != 0) {
+    MEMFAULT_LOG_ERROR("DNS lookup for %s failed: %d", host, rv);
+    return rv;
+  }
+
+  s_memfault_dns_cache.family = res->ai_family;
+  s_memfault_dns_cache.socktype = res->ai_socktype;
+  s_memfault_dns_cache.addrlen = MEMFAULT_MIN(res->ai_addrlen, sizeof(s_memfault_dns_cache.addr));
+  memcpy(&s_memfault_dns_cache.addr, res->ai_addr, s_memfault_dns_cache.addrlen);
+  freeaddrinfo(res);
+
+  // a host name which doesn't fit is resolved on every connection
+  const size_t host_len = strlen(host);
+  if ((CONFIG_MEMFAULT_HTTP_DNS_CACHE_TTL_S > 0) &&
+      (host_len < sizeof(s_memfault_dns_cache.host))) {
+    memcpy(s_memfault_dns_cache.host, host, host_len + 1);
+    s_memfault_dns_cache.port = port;
+    s_memfault_dns_cache.resolved_at_ms = k_uptime_get();
+    s_memfault_dns_cache.valid = true;
+  }
+  return 0;
+}
+
+static int prv_connect(void) {
+  const char *host = MEMFAULT_HTTP_GET_API_HOST();
+  const int port = MEMFAULT_HTTP_GET_API_PORT();
+  const bool was_cached = prv_dns_cache_is_valid(host, port);
+
+  if (prv_resolve(host, port) != 0) {
+    return -1;
+  }
+  int sock_fd = prv_open_and_configure_socket();
+  if ((sock_fd < 0) && was_cached) {
+    // the host may have moved since it was resolved, look it up again before giving up
+    s_memfault_dns_cache.valid = false;
+    if (prv_resolve(host, port) != 0) {
+      return -1;
+    }
+    sock_fd = prv_open_and_configure_socket();
+  }
+
+  if (sock_fd < 0) {
+    MEMFAULT_LOG_ERROR("Failed to connect to %s, errno=%d", host, errno);
+    return -1;
+  }
+  return sock_fd;
+}
+
+static void prv_close_connection(void) {
+  if (s_memfault_http_conn.fd < 0) {
+    return;
+  }
+  close(s_memfault_http_conn.fd);
+  s_memfault_http_conn.fd = -1;
+}
+
+//! An idle keep-alive connection should have nothing to read. If it's readable, the server has
+//! either closed it (recv() would return 0) or sent something unexpected so it can't be reused.
+static bool prv_idle_connection_is_usable(int sock_fd) {
+  const int64_t idle_ms = k_uptime_get() - s_memfault_http_conn.last_activity_ms;
+  if (idle_ms >= CONFIG_MEMFAULT_HTTP_KEEPALIVE_IDLE_TIMEOUT_MS) {
+    MEMFAULT_LOG_DEBUG("Connection idle for %d ms, reconnecting", (int)idle_ms);
+    return false;
+  }
+
+  struct pollfd poll_fd = {
+    .fd = sock_fd,
+    .events = POLLIN,
+  };
+  const int rv = poll(&poll_fd, 1, 0);
+  return (rv == 0);
+}
+
+//! @return The socket to issue requests on or a negative value if a connection could not be
+//!  established
+static int prv_get_connection(void) {
+  if ((s_memfault_http_conn.fd >= 0) &&
+      !prv_idle_connection_is_usable(s_memfault_http_conn.fd)) {
+    prv_close_connection();
+  }
+
+  if (s_memfault_http_conn.fd < 0) {
+    s_memfault_http_conn.fd = prv_connect();
+  }
+
+  s_memfault_http_conn.last_activity_ms = k_uptime_get();
+  return s_memfault_http_conn.fd;
+}
+
 static bool prv_try_send(int sock_fd, const uint8_t *buf, size_t buf_len) {
   size_t idx = 0;
   while (idx != buf_len) {
@@ -139,10 +346,14 @@ static bool prv_try_send(int sock_fd, const uint8_t *buf, size_t buf_len) {
   return true;
 }
 
-static bool prv_send_next_msg(int sock) {
+//! @return 1 if a message was sent, 0 if there was no more data to send or a negative value if
+//!  an error occurred
+static int prv_send_next_msg(int sock) {
   const sPacketizerConfig cfg = {
     // let a single msg span many "memfault_packetizer_get_next" calls
     .enable_multi_packet_chunk = true,
+    // only delete the message once the server has acknowledged it with a 2xx response
+    .enable_delivery_confirmation = true,
   };
 
   // will be populated with size of entire message queued for sending
@@ -150,10 +361,14 @@ static bool prv_send_next_msg(int sock) {
   const bool data_available = memfault_packetizer_begin(&cfg, &metadata);
   if (!data_available) {
     MEMFAULT_LOG_DEBUG("No more data to send");
-    return false;
+    return 0;
   }
 
-  memfault_http_start_chunk_post(prv_send_data, &sock, metadata.single_chunk_message_length);
+  if (!memfault_http_start_chunk_post(prv_send_data, &sock,
+                                      metadata.single_chunk_message_length)) {
+    memfault_packetizer_abort();
+    return -1;
+  }
 
   while (1) {
     uint8_t buf[128];
@@ -166,7 +381,7 @@ static bool prv_send_next_msg(int sock) {
     if (!prv_try_send(sock, buf, buf_len)) {
       // unexpected failure, abort in-flight transaction
       memfault_packetizer_abort();
-      return false;
+      return -1;
     }
 
     if (status == kMemfaultPacketizerStatus_EndOfChunk) {
@@ -174,28 +389,60 @@ static bool prv_send_next_msg(int sock) {
     }
   }
 
-  // message sent, await response
-  return true;
+  // message sent, response will be read once the pipeline has been filled
+  return 1;
 }
 
-static bool prv_wait_for_http_response(int sock_fd) {
+//! Deletes the message a response was received for unless the server asks for it to be sent again
+//!
+//! @return true if the next message can be sent, false if it should be retried later
+static bool prv_handle_response(const sMemfaultHttpResponseContext *ctx) {
+  const uint32_t http_status = (uint32_t)ctx->http_status_code;
+  if ((http_status >= 200) && (http_status < 300)) {
+    memfault_packetizer_confirm_delivery();
+    return true;
+  }
+
+  MEMFAULT_LOG_ERROR("Chunk post failed, HTTP status %d", ctx->http_status_code);
+  if (!memfault_http_retry_policy_is_retryable_status(http_status)) {
+    // the server will never accept the message, drop it rather than sending it again
+    memfault_packetizer_confirm_delivery();
+    return true;
+  }
+  // the message will be sent again by the next post
+  memfault_packetizer_abort();
+  return false;
+}
+
+//! Reads the responses for all the requests which have been pipelined on the connection
+//!
+//! The responses arrive back-to-back so the bytes left over once one response has been parsed
+//! are fed into a fresh parser context for the next one.
+//!
+//! @return true if all the responses were received and the messages they were for were deleted,
+//!   false if the connection is no longer usable or the server asked for a message to be retried
+static bool prv_wait_for_http_responses(int sock_fd, size_t num_responses) {
   sMemfaultHttpResponseContext ctx = { 0 };
-  while (1) {
+  while (num_responses > 0) {
     struct pollfd poll_fd = {
       .fd = sock_fd,
       .events = POLLIN,
     };
     const int timeout_ms = 5000;
     int rv = poll(&poll_fd, 1, timeout_ms);
+    if (rv == 0) {
+      MEMFAULT_LOG_ERROR("Timeout awaiting response");
+      return false;
+    }
     if (rv < 0) {
-      MEMFAULT_LOG_ERROR("Timeout awaiting response: errno=%d", errno);
+      MEMFAULT_LOG_ERROR("Poll error awaiting response: errno=%d", errno);
       return false;
     }
 
-    char buf[8];
+    char buf[32];
     int len = recv(sock_fd, buf, sizeof(buf), MSG_DONTWAIT);
     if (len <= 0) {
-      if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+      if ((len < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
         continue;
       }
 
@@ -203,53 +450,76 @@ static bool prv_wait_for_http_response(int sock_fd) {
       return false;
     }
 
-    bool done = memfault_http_parse_response(&ctx, buf, len);
-    if (done) {
+    size_t offset = 0;
+    while ((offset < (size_t)len) && (num_responses > 0)) {
+      const bool done = memfault_http_parse_response(&ctx, &buf[offset], len - offset);
+      offset += ctx.data_bytes_processed;
+      if (!done) {
+        break;
+      }
+
       MEMFAULT_LOG_DEBUG("Memfault Message Post Complete: Parse Status %d HTTP Status %d!",
                          (int)ctx.parse_error, ctx.http_status_code);
-      MEMFAULT_LOG_DEBUG("Body: %s", ctx.http_body);
-      return true;
+      if (ctx.parse_error != kMfltHttpParseStatus_Ok) {
+        return false;
+      }
+      MEMFAULT_LOG_DEBUG("Body: %s", ctx.http_body ? ctx.http_body : "");
+      if (!prv_handle_response(&ctx)) {
+        return false;
+      }
+
+      num_responses--;
+      ctx = (sMemfaultHttpResponseContext) { 0 };
     }
   }
+  return true;
 }
 
 int memfault_zephyr_port_post_data(void) {
-    struct addrinfo hints = {
-      .ai_family = AF_INET,
-      .ai_socktype = SOCK_STREAM,
-    };
-    struct addrinfo *res = NULL;
-    char port[10] = { 0 };
-    snprintf(port, sizeof(port), "%d", MEMFAULT_HTTP_GET_API_PORT());
-
-    const char *host = MEMFAULT_HTTP_GET_API_HOST();
-    int rv = getaddrinfo(host, port, &hints, &res);
-    if (rv != 0) {
-      MEMFAULT_LOG_ERROR("DNS lookup for %s failed: %d", host, rv);
-      goto cleanup;
+  const int sock_fd = prv_get_connection();
+  if (sock_fd < 0) {
+    return -1;
+  }
+
+  int rv = 0;
+  size_t max_messages_to_send = CONFIG_MEMFAULT_HTTP_MAX_POSTS_PER_CALL;
+  bool more_data = true;
+  while (more_data && (max_messages_to_send > 0)) {
+    // Requests are pipelined before any of the responses are read so the round trip to the
+    // server is only paid once per batch
+    size_t num_in_flight = 0;
+    while ((num_in_flight < CONFIG_MEMFAULT_HTTP_MAX_PIPELINED_REQUESTS) &&
+           (max_messages_to_send > 0)) {
+      rv = prv_send_next_msg(sock_fd);
+      if (rv <= 0) {
+        more_data = false;
+        break;
+      }
+      num_in_flight++;
+      max_messages_to_send--;
     }
 
-    const int sock_fd = prv_open_and_configure_socket(res);
-    if (sock_fd < 0) {
-      MEMFAULT_LOG_ERROR("Failed to connect to %s, errno=%d",
-                         host, errno);
+    if ((rv >= 0) && (num_in_flight != 0) &&
+        !prv_wait_for_http_responses(sock_fd, num_in_flight)) {
       rv = -1;
-      goto cleanup;
     }
 
-    int max_messages_to_send = 5;
-    while (max_messages_to_send-- > 0) {
-      if (!prv_send_next_msg(sock_fd)) {
-        break;
-      }
-      if (!prv_wait_for_http_response(sock_fd)) {
-        break;
-      }
+    if (rv < 0) {
+      // the message in flight hasn't been acknowledged, it will be sent again by the next post
+      memfault_packetizer_abort();
+      // the state of the stream is unknown, start over with a new connection on the next attempt
+      prv_close_connection();
+      return rv;
     }
+  }
 
-    close(sock_fd);
+  s_memfault_http_conn.last_activity_ms = k_uptime_get();
+  if (CONFIG_MEMFAULT_HTTP_KEEPALIVE_IDLE_TIMEOUT_MS == 0) {
+    prv_close_connection();
+  }
+  return 0;
+}
 
-cleanup:
-    freeaddrinfo(res);
-    return rv;
+void memfault_zephyr_port_http_close(void) {
+  prv_close_connection();
 }
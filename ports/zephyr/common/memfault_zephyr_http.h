@@ -12,8 +12,23 @@
 extern "C" {
 #endif
 
+//! Posts all the Memfault data queued for sending to the chunks endpoint
+//!
+//! The connection to the server is kept open across calls and closed once it has been idle for
+//! more than CONFIG_MEMFAULT_HTTP_KEEPALIVE_IDLE_TIMEOUT_MS (or right away when the timeout is
+//! 0). Each message is only deleted once the server has acknowledged it with a 2xx response. If
+//! the connection drops or the server answers with a transient error (see
+//! memfault_http_retry_policy_is_retryable_status()), the message is sent again by the next call.
+//!
+//! @return 0 on success, else a negative error code
 int memfault_zephyr_port_post_data(void);
 
+//! Closes the connection kept open by memfault_zephyr_port_post_data(), if any
+//!
+//! @note The connection is re-established automatically on the next post so this only needs to be
+//!   called when the network interface is about to go down
+void memfault_zephyr_port_http_close(void);
+
 #ifdef __cplusplus
 }
 #endif
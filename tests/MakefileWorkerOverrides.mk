@@ -31,6 +31,14 @@ export CPPUTEST_USE_GCOV=Y
 # Enable branch coverage reporting
 export GCOV_ARGS=-b -c
 
+# Benchmarks (see makefiles/Makefile_memfault_benchmarks.mk) are built with optimizations and
+# without coverage or sanitizer instrumentation so the numbers reflect the code as it ships
+ifeq ($(MEMFAULT_BENCHMARK_BUILD),1)
+export CPPUTEST_USE_GCOV=N
+CPPUTEST_CFLAGS += -O2
+CPPUTEST_CXXFLAGS += -O2
+endif
+
 # These clang  warninsgs  aren't particularly helpful
 CPPUTEST_WARNINGFLAGS = \
   -Wno-missing-braces \
@@ -61,13 +69,16 @@ endif
 
 CPPUTEST_WARNINGFLAGS += $(COMPILER_SPECIFIC_WARNINGS)
 CPPUTEST_WARNINGFLAGS += \
-  -Werror \
-  -fsanitize=address
-
-export CPPUTEST_WARNINGFLAGS
+  -Werror
 
+ifneq ($(MEMFAULT_BENCHMARK_BUILD),1)
+CPPUTEST_WARNINGFLAGS += \
+  -fsanitize=address
 CPPUTEST_LDFLAGS += \
   -fsanitize=address
+endif
+
+export CPPUTEST_WARNINGFLAGS
 
 export CPPUTEST_LDFLAGS
 
@@ -0,0 +1,72 @@
+//! @file
+//!
+//! @brief
+//! A fake event data source serving messages queued by the test
+
+#include "CppUTest/TestHarness.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "fakes/fake_memfault_event_data_source.h"
+
+#include "memfault/core/data_packetizer_source.h"
+
+#define MAX_MSGS 32
+
+static uint8_t s_msgs[MAX_MSGS][FAKE_EVENT_DATA_SOURCE_MAX_MSG_LEN];
+static size_t s_msg_lens[MAX_MSGS];
+static size_t s_num_msgs;
+static size_t s_num_msgs_read;
+
+void fake_event_data_source_reset(void) {
+  s_num_msgs = 0;
+  s_num_msgs_read = 0;
+}
+
+void fake_event_data_source_queue_msg(size_t payload_len) {
+  CHECK(s_num_msgs < MAX_MSGS);
+  CHECK((payload_len >= 256) &&
+        ((payload_len + FAKE_EVENT_DATA_SOURCE_MSG_HDR_LEN) <= FAKE_EVENT_DATA_SOURCE_MAX_MSG_LEN));
+  uint8_t *msg = s_msgs[s_num_msgs];
+  msg[0] = 0xA1; // map with 1 pair
+  msg[1] = 0x04; // an integer key
+  msg[2] = 0x59; // byte string with a 16 bit length
+  msg[3] = (uint8_t)(payload_len >> 8);
+  msg[4] = (uint8_t)(payload_len & 0xff);
+  for (size_t i = 0; i < payload_len; i++) {
+    msg[FAKE_EVENT_DATA_SOURCE_MSG_HDR_LEN + i] = (uint8_t)(i + (s_num_msgs * 7));
+  }
+  s_msg_lens[s_num_msgs] = payload_len + FAKE_EVENT_DATA_SOURCE_MSG_HDR_LEN;
+  s_num_msgs++;
+}
+
+size_t fake_event_data_source_get_num_msgs_read(void) {
+  return s_num_msgs_read;
+}
+
+static bool prv_has_more_msgs(size_t *next_msg_size) {
+  if (s_num_msgs_read == s_num_msgs) {
+    *next_msg_size = 0;
+    return false;
+  }
+  *next_msg_size = s_msg_lens[s_num_msgs_read];
+  return true;
+}
+
+static bool prv_read_msg(uint32_t offset, void *buf, size_t buf_len) {
+  memcpy(buf, &s_msgs[s_num_msgs_read][offset], buf_len);
+  return true;
+}
+
+static void prv_mark_msg_read(void) {
+  s_num_msgs_read++;
+}
+
+extern "C" {
+  const sMemfaultDataSourceImpl g_memfault_event_data_source = {
+    .has_more_msgs_cb = prv_has_more_msgs,
+    .read_msg_cb = prv_read_msg,
+    .mark_msg_read_cb = prv_mark_msg_read,
+  };
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Every message is a CBOR map holding a byte string, so the ingestion decoder accepts it as an
+//! event. The map, key and byte string length take this many bytes ahead of the payload.
+#define FAKE_EVENT_DATA_SOURCE_MSG_HDR_LEN 5
+
+//! The largest message which can be queued, including the header
+#define FAKE_EVENT_DATA_SOURCE_MAX_MSG_LEN 4096
+
+//! Drops the messages queued and resets the read counter
+void fake_event_data_source_reset(void);
+
+//! Queues a message holding a 'payload_len' byte payload (at least 256 bytes) in
+//! g_memfault_event_data_source. The payload depends on the number of messages queued before it.
+void fake_event_data_source_queue_msg(size_t payload_len);
+
+//! @return the number of messages marked read
+size_t fake_event_data_source_get_num_msgs_read(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,13 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Fake implementation of the time since boot platform API for tests where time doesn't elapse
+
+#include "memfault/core/platform/core.h"
+
+uint64_t memfault_platform_get_time_since_boot_ms(void) {
+  return 0;
+}
@@ -0,0 +1,121 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! libFuzzer harness for the keep-alive capable HTTP response parser (response_parser.h)
+//!
+//! The first input byte selects how the rest of the input is split into reads, the remainder is
+//! the byte stream received from the "server". The stream is parsed as a sequence of pipelined
+//! responses, once in a single call per response and once split into reads, and the outcomes
+//! must match.
+//!
+//! See the Makefile in this directory for how to build and run it.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memfault/http/response_parser.h"
+
+#define FUZZ_MAX_RESPONSES 64
+
+typedef struct {
+  size_t num_responses;
+  size_t bytes_consumed[FUZZ_MAX_RESPONSES];
+  int http_status_code[FUZZ_MAX_RESPONSES];
+  eMfltHttpParseStatus parse_error[FUZZ_MAX_RESPONSES];
+} sFuzzOutcome;
+
+static void prv_check(int condition, const char *what) {
+  if (!condition) {
+    fprintf(stderr, "Check failed: %s\n", what);
+    abort();
+  }
+}
+
+static void prv_record(sFuzzOutcome *outcome, const sMfltHttpResponseParser *parser,
+                       size_t bytes_consumed) {
+  if (outcome->num_responses < FUZZ_MAX_RESPONSES) {
+    const size_t i = outcome->num_responses;
+    outcome->bytes_consumed[i] = bytes_consumed;
+    outcome->http_status_code[i] = parser->http_status_code;
+    outcome->parse_error[i] = parser->parse_error;
+  }
+  outcome->num_responses++;
+}
+
+static void prv_parse_stream(const uint8_t *data, size_t size, size_t read_len,
+                             sFuzzOutcome *outcome) {
+  sMfltHttpResponseParser parser;
+  memfault_http_response_parser_reset(&parser);
+  size_t response_bytes = 0;
+  size_t offset = 0;
+
+  while (offset < size) {
+    const size_t len = (read_len < (size - offset)) ? read_len : (size - offset);
+    size_t bytes_consumed = 0;
+    const int done = memfault_http_response_parser_feed(&parser, &data[offset], len,
+                                                        &bytes_consumed);
+    prv_check(bytes_consumed <= len, "consumed more than provided");
+    prv_check(done || (bytes_consumed == len), "stopped early without completing");
+    prv_check(bytes_consumed != 0, "no progress");
+    offset += bytes_consumed;
+    response_bytes += bytes_consumed;
+
+    if (done) {
+      prv_record(outcome, &parser, response_bytes);
+      response_bytes = 0;
+      if (parser.parse_error != kMfltHttpParseStatus_Ok) {
+        // the connection can't be reused after a malformed response
+        return;
+      }
+    }
+  }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < 1) {
+    return 0;
+  }
+  const size_t read_len = (size_t)data[0] + 1;
+  data++;
+  size--;
+
+  sFuzzOutcome whole = { 0 };
+  sFuzzOutcome split = { 0 };
+  prv_parse_stream(data, size, size, &whole);
+  prv_parse_stream(data, size, read_len, &split);
+
+  prv_check(whole.num_responses == split.num_responses, "number of responses differs");
+  const size_t n = (whole.num_responses < FUZZ_MAX_RESPONSES) ? whole.num_responses :
+                                                                FUZZ_MAX_RESPONSES;
+  for (size_t i = 0; i < n; i++) {
+    prv_check(whole.bytes_consumed[i] == split.bytes_consumed[i], "response length differs");
+    prv_check(whole.http_status_code[i] == split.http_status_code[i], "status differs");
+    prv_check(whole.parse_error[i] == split.parse_error[i], "parse error differs");
+  }
+  return 0;
+}
+
+#if defined(MEMFAULT_FUZZ_STANDALONE)
+//! Replays the inputs passed on the command line (i.e a corpus or a crash) when libFuzzer isn't
+//! available
+int main(int argc, char *argv[]) {
+  static uint8_t buf[64 * 1024];
+  for (int i = 1; i < argc; i++) {
+    FILE *f = fopen(argv[i], "rb");
+    if (f == NULL) {
+      fprintf(stderr, "Unable to open %s\n", argv[i]);
+      return 1;
+    }
+    const size_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    LLVMFuzzerTestOneInput(buf, len);
+  }
+  printf("Replayed %d inputs\n", argc - 1);
+  return 0;
+}
+#endif
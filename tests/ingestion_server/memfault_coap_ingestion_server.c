@@ -0,0 +1,571 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault_coap_ingestion_server.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "memfault_ingestion_server.h"
+
+#define CHUNKS_PATH "chunks"
+
+#define MAX_DEVICE_SERIAL_LEN 64
+#define MAX_PROJECT_KEY_LEN 64
+#define MAX_DATAGRAM_SIZE 1500
+#define MAX_RESPONSE_SIZE 32
+
+//! How often the thread checks whether the server is being stopped
+#define STOP_POLL_INTERVAL_MS 100
+
+#define COAP_VERSION 1
+#define COAP_TYPE_CON 0
+#define COAP_TYPE_ACK 2
+#define COAP_PAYLOAD_MARKER 0xff
+
+#define COAP_CODE(class, detail) ((uint8_t)(((class) << 5) | (detail)))
+#define COAP_CODE_POST COAP_CODE(0, 2)
+#define COAP_CODE_CHANGED COAP_CODE(2, 4)
+#define COAP_CODE_CONTINUE COAP_CODE(2, 31)
+#define COAP_CODE_BAD_REQUEST COAP_CODE(4, 0)
+#define COAP_CODE_UNAUTHORIZED COAP_CODE(4, 1)
+#define COAP_CODE_NOT_FOUND COAP_CODE(4, 4)
+#define COAP_CODE_METHOD_NOT_ALLOWED COAP_CODE(4, 5)
+#define COAP_CODE_REQUEST_ENTITY_INCOMPLETE COAP_CODE(4, 8)
+#define COAP_CODE_REQUEST_ENTITY_TOO_LARGE COAP_CODE(4, 13)
+
+#define COAP_OPTION_URI_PATH 11
+#define COAP_OPTION_URI_QUERY 15
+#define COAP_OPTION_BLOCK1 27
+
+typedef struct MfltCoapIngestionDevice {
+  struct MfltCoapIngestionDevice *next;
+  char device_serial[MAX_DEVICE_SERIAL_LEN + 1];
+  sMfltIngestionDecoder decoder;
+  sMfltCoapIngestionDeviceStats stats;
+
+  //! The chunk being reassembled from the blocks of a Block1 transfer
+  uint8_t *body;
+  size_t body_len;
+  bool transfer_in_progress;
+
+  //! The last request, to answer retransmissions with the response that was sent for it
+  bool has_last_request;
+  uint16_t last_message_id;
+  struct sockaddr_in last_peer;
+  uint8_t last_response[MAX_RESPONSE_SIZE];
+  size_t last_response_len;
+} sMfltCoapIngestionDevice;
+
+struct MfltCoapIngestionServer {
+  sMfltCoapIngestionServerConfig config;
+  int fd;
+  uint16_t port;
+  volatile bool stop;
+  pthread_t thread;
+
+  //! Protects everything below
+  pthread_mutex_t lock;
+  sMfltCoapIngestionDevice *devices;
+  uint32_t num_requests_to_drop;
+  uint32_t num_responses_to_drop;
+  uint8_t response_code;
+};
+
+typedef struct {
+  uint8_t type;
+  uint8_t code;
+  uint16_t message_id;
+  const uint8_t *token;
+  size_t token_len;
+
+  size_t num_path_segments;
+  char path[2][MAX_DEVICE_SERIAL_LEN + 1];
+  bool path_too_long;
+  char project_key[MAX_PROJECT_KEY_LEN + 1];
+  bool has_block1;
+  uint32_t block1_value;
+
+  const uint8_t *payload;
+  size_t payload_len;
+} sCoapRequest;
+
+//
+// Message parsing
+//
+
+static bool prv_read_ext(const uint8_t *buf, size_t len, size_t *offset, uint32_t *value) {
+  if (*value == 13) {
+    if (*offset >= len) {
+      return false;
+    }
+    *value = 13 + buf[(*offset)++];
+  } else if (*value == 14) {
+    if ((*offset + 2) > len) {
+      return false;
+    }
+    *value = 269 + (((uint32_t)buf[*offset] << 8) | buf[*offset + 1]);
+    *offset += 2;
+  } else if (*value == 15) {
+    return false;
+  }
+  return true;
+}
+
+static void prv_copy_string(char *dst, size_t dst_size, const uint8_t *src, size_t len,
+                            bool *truncated) {
+  if (len >= dst_size) {
+    *truncated = true;
+    len = dst_size - 1;
+  }
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+}
+
+static bool prv_parse_request(const uint8_t *buf, size_t len, sCoapRequest *req) {
+  if ((len < 4) || ((buf[0] >> 6) != COAP_VERSION)) {
+    return false;
+  }
+
+  *req = (sCoapRequest) {
+    .type = (buf[0] >> 4) & 0x3,
+    .token_len = buf[0] & 0xf,
+    .code = buf[1],
+    .message_id = (uint16_t)((buf[2] << 8) | buf[3]),
+    .token = &buf[4],
+  };
+  if ((req->token_len > 8) || ((4 + req->token_len) > len)) {
+    return false;
+  }
+
+  size_t offset = 4 + req->token_len;
+  uint32_t option_number = 0;
+  while (offset < len) {
+    if (buf[offset] == COAP_PAYLOAD_MARKER) {
+      req->payload = &buf[offset + 1];
+      req->payload_len = len - offset - 1;
+      break;
+    }
+
+    uint32_t delta = buf[offset] >> 4;
+    uint32_t option_len = buf[offset] & 0xf;
+    offset++;
+    if (!prv_read_ext(buf, len, &offset, &delta) || !prv_read_ext(buf, len, &offset, &option_len) ||
+        ((offset + option_len) > len)) {
+      return false;
+    }
+    option_number += delta;
+    const uint8_t *value = &buf[offset];
+    offset += option_len;
+
+    bool truncated = false;
+    switch (option_number) {
+      case COAP_OPTION_URI_PATH:
+        if (req->num_path_segments < 2) {
+          prv_copy_string(req->path[req->num_path_segments], sizeof(req->path[0]), value,
+                          option_len, &truncated);
+        }
+        req->num_path_segments++;
+        req->path_too_long |= truncated;
+        break;
+      case COAP_OPTION_URI_QUERY:
+        if ((option_len > 4) && (memcmp(value, "key=", 4) == 0)) {
+          prv_copy_string(req->project_key, sizeof(req->project_key), &value[4], option_len - 4,
+                          &truncated);
+        }
+        break;
+      case COAP_OPTION_BLOCK1:
+        if (option_len > 3) {
+          return false;
+        }
+        req->has_block1 = true;
+        req->block1_value = 0;
+        for (size_t i = 0; i < option_len; i++) {
+          req->block1_value = (req->block1_value << 8) | value[i];
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+//
+// Responses
+//
+
+//! Builds a piggybacked response to 'req' in 'buf', which must hold MAX_RESPONSE_SIZE bytes
+//!
+//! @return the length of the response
+static size_t prv_build_response(const sCoapRequest *req, uint8_t code, bool with_block1,
+                                 uint32_t block1_value, uint8_t *buf) {
+  buf[0] = (uint8_t)((COAP_VERSION << 6) | (COAP_TYPE_ACK << 4) | req->token_len);
+  buf[1] = code;
+  buf[2] = (uint8_t)(req->message_id >> 8);
+  buf[3] = (uint8_t)(req->message_id & 0xff);
+  memcpy(&buf[4], req->token, req->token_len);
+  size_t len = 4 + req->token_len;
+
+  if (with_block1) {
+    uint8_t value[3];
+    size_t value_len = 0;
+    for (int shift = 16; shift >= 0; shift -= 8) {
+      const uint8_t byte = (uint8_t)(block1_value >> shift);
+      if ((value_len != 0) || (byte != 0)) {
+        value[value_len++] = byte;
+      }
+    }
+    // Block1 (27) is the only option so its delta is 27, encoded with a one byte extension
+    buf[len++] = (uint8_t)((13 << 4) | value_len);
+    buf[len++] = COAP_OPTION_BLOCK1 - 13;
+    memcpy(&buf[len], value, value_len);
+    len += value_len;
+  }
+  return len;
+}
+
+static void prv_send(sMfltCoapIngestionServer *server, sMfltCoapIngestionDevice *device,
+                     const struct sockaddr_in *peer, const uint8_t *buf, size_t len) {
+  pthread_mutex_lock(&server->lock);
+  const bool drop = server->num_responses_to_drop != 0;
+  if (drop) {
+    server->num_responses_to_drop--;
+  }
+  if (device != NULL) {
+    device->stats.tx_bytes += len;
+  }
+  pthread_mutex_unlock(&server->lock);
+
+  if (!drop) {
+    sendto(server->fd, buf, len, 0, (const struct sockaddr *)peer, sizeof(*peer));
+  }
+}
+
+//
+// Devices
+//
+
+//! Must be called with the server lock held
+static sMfltCoapIngestionDevice *prv_get_device(sMfltCoapIngestionServer *server,
+                                                const char *device_serial) {
+  sMfltCoapIngestionDevice *device = server->devices;
+  while ((device != NULL) && (strcmp(device->device_serial, device_serial) != 0)) {
+    device = device->next;
+  }
+
+  if (device == NULL) {
+    device = calloc(1, sizeof(*device));
+    if (device != NULL) {
+      snprintf(device->device_serial, sizeof(device->device_serial), "%s", device_serial);
+      memfault_ingestion_decoder_init(&device->decoder, device->device_serial,
+                                      server->config.message_cb, server->config.cb_ctx);
+      device->next = server->devices;
+      server->devices = device;
+    }
+  }
+  return device;
+}
+
+static void prv_free_devices(sMfltCoapIngestionServer *server) {
+  sMfltCoapIngestionDevice *device = server->devices;
+  while (device != NULL) {
+    sMfltCoapIngestionDevice *next = device->next;
+    memfault_ingestion_decoder_deinit(&device->decoder);
+    free(device->body);
+    free(device);
+    device = next;
+  }
+  server->devices = NULL;
+}
+
+static uint8_t prv_szx_for_block_size(size_t block_size) {
+  uint8_t szx = 0;
+  while ((szx < 6) && (((size_t)16 << (szx + 1)) <= block_size)) {
+    szx++;
+  }
+  return szx;
+}
+
+//! Handles a block of the Block1 transfer of a device. Must be called with the server lock held.
+//!
+//! @return the response code, with the Block1 option to respond with in 'block1_out'
+static uint8_t prv_handle_block(sMfltCoapIngestionServer *server,
+                                sMfltCoapIngestionDevice *device, const sCoapRequest *req,
+                                uint32_t *block1_out) {
+  // a request without a Block1 option carries the whole chunk
+  const uint32_t block1 = req->has_block1 ? req->block1_value : 0;
+  const uint32_t num = block1 >> 4;
+  const bool more = (block1 & 0x8) != 0;
+  uint8_t szx = block1 & 0x7;
+  if (szx == 7) {
+    return COAP_CODE_BAD_REQUEST;
+  }
+  size_t block_size = (size_t)16 << szx;
+  const size_t offset = (size_t)num * block_size;
+
+  if (num == 0) {
+    // a new transfer, whatever was in progress was abandoned by the device
+    device->body_len = 0;
+    device->transfer_in_progress = true;
+  }
+  if (!device->transfer_in_progress || (offset != device->body_len)) {
+    return COAP_CODE_REQUEST_ENTITY_INCOMPLETE;
+  }
+  if (more && (req->payload_len != block_size)) {
+    return COAP_CODE_BAD_REQUEST;
+  }
+
+  size_t accept_len = req->payload_len;
+  if (more && (server->config.max_block_size != 0) &&
+      (block_size > server->config.max_block_size)) {
+    // only take the first part of the block and ask for smaller ones (RFC 7959 section 2.5)
+    szx = prv_szx_for_block_size(server->config.max_block_size);
+    block_size = (size_t)16 << szx;
+    accept_len = block_size;
+  }
+
+  if ((device->body_len + accept_len) > MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE) {
+    device->transfer_in_progress = false;
+    return COAP_CODE_REQUEST_ENTITY_TOO_LARGE;
+  }
+  uint8_t *body = realloc(device->body, device->body_len + accept_len);
+  if ((body == NULL) && ((device->body_len + accept_len) != 0)) {
+    return COAP_CODE_REQUEST_ENTITY_TOO_LARGE;
+  }
+  device->body = body;
+  memcpy(&device->body[device->body_len], req->payload, accept_len);
+  device->body_len += accept_len;
+
+  if (more) {
+    // the number of the last block received, in the block size the device is asked to use
+    const uint32_t rsp_num = (uint32_t)(device->body_len / block_size) - 1;
+    *block1_out = (rsp_num << 4) | 0x8 | szx;
+    return COAP_CODE_CONTINUE;
+  }
+
+  // the chunk is complete
+  *block1_out = (num << 4) | szx;
+  device->transfer_in_progress = false;
+  device->stats.num_transfers++;
+  memfault_ingestion_decoder_feed_chunk(&device->decoder, device->body, device->body_len);
+  return COAP_CODE_CHANGED;
+}
+
+static void prv_handle_datagram(sMfltCoapIngestionServer *server, const uint8_t *buf, size_t len,
+                                const struct sockaddr_in *peer) {
+  sCoapRequest req;
+  if (!prv_parse_request(buf, len, &req) || (req.type != COAP_TYPE_CON)) {
+    return;
+  }
+
+  uint8_t rsp[MAX_RESPONSE_SIZE];
+  uint8_t code = 0;
+  if (req.code != COAP_CODE_POST) {
+    code = COAP_CODE_METHOD_NOT_ALLOWED;
+  } else if ((req.num_path_segments != 2) || req.path_too_long ||
+             (strcmp(req.path[0], CHUNKS_PATH) != 0) || (req.path[1][0] == '\0')) {
+    code = COAP_CODE_NOT_FOUND;
+  } else if ((server->config.project_key != NULL) &&
+             (strcmp(req.project_key, server->config.project_key) != 0)) {
+    code = COAP_CODE_UNAUTHORIZED;
+  }
+  if (code != 0) {
+    prv_send(server, NULL, peer, rsp, prv_build_response(&req, code, false, 0, rsp));
+    return;
+  }
+
+  pthread_mutex_lock(&server->lock);
+  sMfltCoapIngestionDevice *device = prv_get_device(server, req.path[1]);
+  if (device == NULL) {
+    pthread_mutex_unlock(&server->lock);
+    return;
+  }
+  device->stats.rx_bytes += len;
+  device->stats.num_requests++;
+
+  size_t rsp_len;
+  if (device->has_last_request && (device->last_message_id == req.message_id) &&
+      (device->last_peer.sin_port == peer->sin_port) &&
+      (device->last_peer.sin_addr.s_addr == peer->sin_addr.s_addr)) {
+    // a retransmission, the response to the original request must have been lost
+    device->stats.num_duplicate_requests++;
+    rsp_len = device->last_response_len;
+    memcpy(rsp, device->last_response, rsp_len);
+  } else {
+    uint32_t block1 = 0;
+    if (server->response_code != 0) {
+      code = server->response_code;
+    } else {
+      code = prv_handle_block(server, device, &req, &block1);
+    }
+    if ((code >> 5) != 2) {
+      device->stats.num_rejected_requests++;
+    }
+    rsp_len = prv_build_response(&req, code, (code >> 5) == 2, block1, rsp);
+
+    device->has_last_request = true;
+    device->last_message_id = req.message_id;
+    device->last_peer = *peer;
+    memcpy(device->last_response, rsp, rsp_len);
+    device->last_response_len = rsp_len;
+  }
+  pthread_mutex_unlock(&server->lock);
+
+  prv_send(server, device, peer, rsp, rsp_len);
+}
+
+static void *prv_server_thread(void *arg) {
+  sMfltCoapIngestionServer *server = arg;
+  uint8_t buf[MAX_DATAGRAM_SIZE];
+  while (!server->stop) {
+    struct pollfd poll_fd = { .fd = server->fd, .events = POLLIN };
+    if (poll(&poll_fd, 1, STOP_POLL_INTERVAL_MS) <= 0) {
+      continue;
+    }
+
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    const ssize_t rv = recvfrom(server->fd, buf, sizeof(buf), 0, (struct sockaddr *)&peer,
+                                &peer_len);
+    if (rv <= 0) {
+      continue;
+    }
+
+    pthread_mutex_lock(&server->lock);
+    const bool drop = server->num_requests_to_drop != 0;
+    if (drop) {
+      server->num_requests_to_drop--;
+    }
+    pthread_mutex_unlock(&server->lock);
+    if (!drop) {
+      prv_handle_datagram(server, buf, (size_t)rv, &peer);
+    }
+  }
+  return NULL;
+}
+
+static int prv_bind(sMfltCoapIngestionServer *server) {
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port = htons(server->config.port),
+    .sin_addr.s_addr = htonl(server->config.listen_on_all_interfaces ? INADDR_ANY :
+                                                                        INADDR_LOOPBACK),
+  };
+  socklen_t addr_len = sizeof(addr);
+  if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+      (getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0)) {
+    close(fd);
+    return -1;
+  }
+  server->port = ntohs(addr.sin_port);
+  return fd;
+}
+
+sMfltCoapIngestionServer *memfault_coap_ingestion_server_start(
+    const sMfltCoapIngestionServerConfig *config) {
+  sMfltCoapIngestionServer *server = calloc(1, sizeof(*server));
+  if (server == NULL) {
+    return NULL;
+  }
+  server->config = *config;
+  pthread_mutex_init(&server->lock, NULL);
+
+  server->fd = prv_bind(server);
+  if ((server->fd < 0) ||
+      (pthread_create(&server->thread, NULL, prv_server_thread, server) != 0)) {
+    if (server->fd >= 0) {
+      close(server->fd);
+    }
+    pthread_mutex_destroy(&server->lock);
+    free(server);
+    return NULL;
+  }
+  return server;
+}
+
+void memfault_coap_ingestion_server_stop(sMfltCoapIngestionServer *server) {
+  server->stop = true;
+  pthread_join(server->thread, NULL);
+  close(server->fd);
+  prv_free_devices(server);
+  pthread_mutex_destroy(&server->lock);
+  free(server);
+}
+
+uint16_t memfault_coap_ingestion_server_get_port(const sMfltCoapIngestionServer *server) {
+  return server->port;
+}
+
+void memfault_coap_ingestion_server_drop_datagrams(sMfltCoapIngestionServer *server,
+                                                   uint32_t num_requests, uint32_t num_responses) {
+  pthread_mutex_lock(&server->lock);
+  server->num_requests_to_drop = num_requests;
+  server->num_responses_to_drop = num_responses;
+  pthread_mutex_unlock(&server->lock);
+}
+
+void memfault_coap_ingestion_server_set_response(sMfltCoapIngestionServer *server, uint8_t code) {
+  pthread_mutex_lock(&server->lock);
+  server->response_code = code;
+  pthread_mutex_unlock(&server->lock);
+}
+
+//! Must be called with the server lock held
+static void prv_snapshot_device_stats(const sMfltCoapIngestionDevice *device,
+                                      sMfltCoapIngestionDeviceStats *stats_out) {
+  *stats_out = device->stats;
+  stats_out->decoder = device->decoder.stats;
+}
+
+bool memfault_coap_ingestion_server_get_device_stats(sMfltCoapIngestionServer *server,
+                                                     const char *device_serial,
+                                                     sMfltCoapIngestionDeviceStats *stats_out) {
+  pthread_mutex_lock(&server->lock);
+  const sMfltCoapIngestionDevice *device = server->devices;
+  while ((device != NULL) && (strcmp(device->device_serial, device_serial) != 0)) {
+    device = device->next;
+  }
+  if (device != NULL) {
+    prv_snapshot_device_stats(device, stats_out);
+  }
+  pthread_mutex_unlock(&server->lock);
+  return device != NULL;
+}
+
+void memfault_coap_ingestion_server_print_report(sMfltCoapIngestionServer *server, FILE *out) {
+  fprintf(out, "%-24s %9s %9s %9s %9s %9s %7s %11s %11s\n", "device (coap)", "requests",
+          "retransm", "rejected", "chunks", "messages", "errors", "rx bytes", "tx bytes");
+
+  pthread_mutex_lock(&server->lock);
+  for (sMfltCoapIngestionDevice *device = server->devices; device != NULL; device = device->next) {
+    sMfltCoapIngestionDeviceStats stats;
+    prv_snapshot_device_stats(device, &stats);
+    const sMfltIngestionStats *d = &stats.decoder;
+    const uint64_t num_errors = d->num_framing_errors + d->num_dropped_messages +
+        d->num_crc_errors + d->num_decode_errors;
+    fprintf(out, "%-24s %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64
+            " %7" PRIu64 " %11" PRIu64 " %11" PRIu64 "\n",
+            device->device_serial, stats.num_requests, stats.num_duplicate_requests,
+            stats.num_rejected_requests, d->num_chunks, d->num_messages, num_errors,
+            stats.rx_bytes, stats.tx_bytes);
+  }
+  pthread_mutex_unlock(&server->lock);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! A local CoAP stand-in for the Memfault chunks endpoint, the counterpart of
+//! memfault/coap/block_upload.h. It is used to test CoAP uploads and to compare the bytes they put
+//! on the air with the HTTP path.
+//!
+//! The server listens on a UDP port for confirmable POSTs to /chunks/<device_serial>?key=<key>
+//! carrying one chunk as a Block1 transfer (RFC 7959). Blocks are acknowledged with piggybacked
+//! responses: 2.31 Continue until the final block and 2.04 Changed once the chunk is complete, at
+//! which point it is decoded with a sMfltIngestionDecoder. Retransmitted requests are detected by
+//! their message ID and answered with the response sent the first time around.
+//!
+//! Datagrams can be dropped on purpose (see memfault_coap_ingestion_server_drop_datagrams()) to
+//! exercise the retransmission logic of a client.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "memfault_ingestion_decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  //! The UDP port to listen on, 0 to let the OS pick one (see
+  //! memfault_coap_ingestion_server_get_port())
+  uint16_t port;
+  //! Listen on all interfaces rather than only on the loopback interface
+  bool listen_on_all_interfaces;
+  //! Requests with a different "key" query parameter are rejected with a 4.01. NULL accepts any
+  //! key.
+  const char *project_key;
+  //! When non-zero, clients sending larger blocks are asked to use blocks of this size instead
+  //! (16 to 1024 bytes, a power of 2)
+  size_t max_block_size;
+  //! Called for every message decoded, may be NULL. The callback runs on the server thread.
+  MfltIngestionMessageCb message_cb;
+  void *cb_ctx;
+} sMfltCoapIngestionServerConfig;
+
+typedef struct {
+  //! What was decoded from the chunks of the device
+  sMfltIngestionStats decoder;
+  //! Block1 transfers completed, i.e chunks received
+  uint64_t num_transfers;
+  //! Requests received, including retransmissions, and the number which were retransmissions
+  uint64_t num_requests;
+  uint64_t num_duplicate_requests;
+  //! Requests answered with an error response code
+  uint64_t num_rejected_requests;
+  //! Bytes of the datagrams received from and sent to the device, i.e the UDP payloads
+  uint64_t rx_bytes;
+  uint64_t tx_bytes;
+} sMfltCoapIngestionDeviceStats;
+
+typedef struct MfltCoapIngestionServer sMfltCoapIngestionServer;
+
+//! Binds the UDP socket and starts the thread of the server
+//!
+//! @return The server or NULL if it could not be started
+sMfltCoapIngestionServer *memfault_coap_ingestion_server_start(
+    const sMfltCoapIngestionServerConfig *config);
+
+//! Stops the thread of the server and frees it
+void memfault_coap_ingestion_server_stop(sMfltCoapIngestionServer *server);
+
+//! @return the UDP port the server listens on
+uint16_t memfault_coap_ingestion_server_get_port(const sMfltCoapIngestionServer *server);
+
+//! Drops the next datagrams received and sent by the server, as if they were lost on the way
+//!
+//! @param num_requests The number of requests received to drop
+//! @param num_responses The number of responses to drop after they have been built
+void memfault_coap_ingestion_server_drop_datagrams(sMfltCoapIngestionServer *server,
+                                                   uint32_t num_requests, uint32_t num_responses);
+
+//! Makes the server answer every valid request with 'code', i.e 0xa3 for 5.03 Service Unavailable,
+//! instead of accepting the block. 0 goes back to accepting data.
+void memfault_coap_ingestion_server_set_response(sMfltCoapIngestionServer *server, uint8_t code);
+
+//! @return true and populates 'stats_out' if the server has received data from the device
+bool memfault_coap_ingestion_server_get_device_stats(sMfltCoapIngestionServer *server,
+                                                     const char *device_serial,
+                                                     sMfltCoapIngestionDeviceStats *stats_out);
+
+//! Writes a table of the per device counters to 'out'
+void memfault_coap_ingestion_server_print_report(sMfltCoapIngestionServer *server, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
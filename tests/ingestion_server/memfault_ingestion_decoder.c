@@ -0,0 +1,704 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault_ingestion_decoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "memfault/core/math.h"
+#include "memfault/util/crc16_ccitt.h"
+
+// Chunk header fields, see prv_build_hdr() in memfault_chunk_transport.c
+#define CHUNK_HDR_CONTINUATION_MASK 0x80
+#define CHUNK_HDR_MORE_DATA_MASK 0x40
+#define CHUNK_HDR_CFG(hdr) (((hdr) >> 3) & 0x7)
+#define CHUNK_HDR_CHANNEL(hdr) ((hdr) & 0x7)
+//! INIT configuration: the CRC16 follows the last chunk of the message
+#define CHUNK_HDR_CFG_CRC_AT_END 0x1
+//! The message is sent with forward error correction
+#define CHUNK_HDR_CFG_FEC 0x2
+//! A CONTINUATION chunk which holds the parity of a group of data chunks
+#define CHUNK_HDR_CFG_FEC_PARITY 0x4
+
+#define CHUNK_CRC16_LEN 2
+
+// Message header, see sMfltPacketizerHdr in memfault_data_packetizer.c
+#define MSG_HDR_RLE_MASK 0x80
+#define MSG_HDR_TYPE_MASK 0x7f
+
+// Coredump format, see memfault_coredump.c
+#define COREDUMP_MAGIC 0x45524f43
+#define COREDUMP_VERSION 1
+#define COREDUMP_HDR_LEN 12
+#define COREDUMP_BLOCK_HDR_LEN 12
+#define COREDUMP_BLOCK_TYPE_MEMORY_REGION 1
+#define COREDUMP_BLOCK_TYPE_TRACE_REASON 5
+
+// CBOR event keys, see serializer_key_ids.h
+#define EVENT_KEY_TYPE 2
+
+//! Deepest nesting of CBOR containers accepted in an event
+#define CBOR_MAX_DEPTH 8
+
+size_t memfault_ingestion_decode_varint_u32(const uint8_t *buf, size_t buf_len,
+                                            uint32_t *value_out) {
+  uint32_t value = 0;
+  for (size_t i = 0; (i < buf_len) && (i < 5); i++) {
+    value |= (uint32_t)(buf[i] & 0x7f) << (7 * i);
+    if ((buf[i] & 0x80) == 0) {
+      *value_out = value;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+static uint32_t prv_read_le_u32(const uint8_t *buf) {
+  return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) |
+      ((uint32_t)buf[3] << 24);
+}
+
+static bool prv_reserve(uint8_t **buf, size_t *buf_size, size_t size) {
+  if (size <= *buf_size) {
+    return true;
+  }
+  uint8_t *new_buf = realloc(*buf, size);
+  if (new_buf == NULL) {
+    return false;
+  }
+  *buf = new_buf;
+  *buf_size = size;
+  return true;
+}
+
+//
+// RLE
+//
+
+//! Expands a payload encoded as { ZigZag varint(count) | payload }*, see memfault/util/rle.h
+static bool prv_rle_decode(sMfltIngestionDecoder *decoder, const uint8_t *data, size_t data_len,
+                           size_t *decoded_len_out) {
+  size_t in = 0;
+  size_t out = 0;
+  while (in < data_len) {
+    uint32_t zigzag;
+    const size_t varint_len =
+        memfault_ingestion_decode_varint_u32(&data[in], data_len - in, &zigzag);
+    if (varint_len == 0) {
+      return false;
+    }
+    in += varint_len;
+
+    const int32_t count = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 0x1);
+    const bool repeat = count > 0;
+    const size_t run_len = repeat ? (size_t)count : (size_t)(-(int64_t)count);
+    const size_t num_input_bytes = repeat ? 1 : run_len;
+    if ((run_len == 0) || (num_input_bytes > (data_len - in)) ||
+        ((out + run_len) > MEMFAULT_INGESTION_MAX_MSG_SIZE) ||
+        !prv_reserve(&decoder->rle_buf, &decoder->rle_buf_size, out + run_len)) {
+      return false;
+    }
+
+    if (repeat) {
+      memset(&decoder->rle_buf[out], data[in], run_len);
+    } else {
+      memcpy(&decoder->rle_buf[out], &data[in], run_len);
+    }
+    in += num_input_bytes;
+    out += run_len;
+  }
+
+  *decoded_len_out = out;
+  return true;
+}
+
+//
+// CBOR
+//
+
+//! Reads the initial byte and argument of a CBOR data item
+static bool prv_cbor_read_head(const uint8_t **p, const uint8_t *end, uint8_t *major_type,
+                               uint64_t *arg) {
+  if (*p >= end) {
+    return false;
+  }
+  const uint8_t initial_byte = *(*p)++;
+  *major_type = initial_byte >> 5;
+  const uint8_t additional_info = initial_byte & 0x1f;
+
+  if (additional_info < 24) {
+    *arg = additional_info;
+    return true;
+  }
+  if (additional_info > 27) {
+    // indefinite lengths are never emitted by the SDK's encoder
+    return false;
+  }
+
+  const size_t num_bytes = (size_t)1 << (additional_info - 24);
+  if ((size_t)(end - *p) < num_bytes) {
+    return false;
+  }
+  *arg = 0;
+  for (size_t i = 0; i < num_bytes; i++) {
+    *arg = (*arg << 8) | *(*p)++;
+  }
+  return true;
+}
+
+//! Walks over one complete data item
+static bool prv_cbor_skip_item(const uint8_t **p, const uint8_t *end, int depth) {
+  uint8_t major_type;
+  uint64_t arg;
+  if ((depth > CBOR_MAX_DEPTH) || !prv_cbor_read_head(p, end, &major_type, &arg)) {
+    return false;
+  }
+
+  switch (major_type) {
+    case 0: // unsigned integer
+    case 1: // negative integer
+    case 7: // simple values and floats, the argument is the value
+      return true;
+    case 2: // byte string
+    case 3: // text string
+      if (arg > (uint64_t)(end - *p)) {
+        return false;
+      }
+      *p += arg;
+      return true;
+    case 4: // array
+    case 5: { // map
+      const uint64_t num_items = (major_type == 5) ? arg * 2 : arg;
+      for (uint64_t i = 0; i < num_items; i++) {
+        if (!prv_cbor_skip_item(p, end, depth + 1)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case 6: // tag
+    default:
+      return prv_cbor_skip_item(p, end, depth + 1);
+  }
+}
+
+//! Checks the event is a single CBOR map and extracts its type
+static bool prv_decode_event(const uint8_t *data, size_t data_len, sMfltIngestionMessage *msg) {
+  const uint8_t *p = data;
+  const uint8_t *end = data + data_len;
+
+  uint8_t major_type;
+  uint64_t num_pairs;
+  if (!prv_cbor_read_head(&p, end, &major_type, &num_pairs) || (major_type != 5)) {
+    return false;
+  }
+
+  msg->event_type = kMfltIngestionEventType_Unknown;
+  for (uint64_t i = 0; i < num_pairs; i++) {
+    const uint8_t *key_start = p;
+    uint64_t key;
+    if (!prv_cbor_read_head(&p, end, &major_type, &key)) {
+      return false;
+    }
+    if (major_type != 0) {
+      // not an integer key, walk over it like any other item
+      p = key_start;
+      if (!prv_cbor_skip_item(&p, end, 1)) {
+        return false;
+      }
+    }
+
+    const uint8_t *value_start = p;
+    uint64_t value;
+    if ((major_type == 0) && (key == EVENT_KEY_TYPE) &&
+        prv_cbor_read_head(&p, end, &major_type, &value) && (major_type == 0)) {
+      msg->event_type = (eMfltIngestionEventType)value;
+      continue;
+    }
+    p = value_start;
+    if (!prv_cbor_skip_item(&p, end, 1)) {
+      return false;
+    }
+  }
+
+  // there must be nothing after the event
+  return p == end;
+}
+
+//
+// Coredumps
+//
+
+static bool prv_decode_coredump(const uint8_t *data, size_t data_len,
+                                sMfltIngestionMessage *msg) {
+  if ((data_len < COREDUMP_HDR_LEN) || (prv_read_le_u32(&data[0]) != COREDUMP_MAGIC) ||
+      (prv_read_le_u32(&data[4]) != COREDUMP_VERSION)) {
+    return false;
+  }
+
+  const uint32_t total_size = prv_read_le_u32(&data[8]);
+  if ((total_size < COREDUMP_HDR_LEN) || (total_size > data_len)) {
+    return false;
+  }
+
+  size_t offset = COREDUMP_HDR_LEN;
+  while (offset < total_size) {
+    if ((total_size - offset) < COREDUMP_BLOCK_HDR_LEN) {
+      return false;
+    }
+    const uint8_t block_type = data[offset];
+    const uint32_t block_len = prv_read_le_u32(&data[offset + 8]);
+    offset += COREDUMP_BLOCK_HDR_LEN;
+    if (block_len > (total_size - offset)) {
+      return false;
+    }
+
+    if (block_type == COREDUMP_BLOCK_TYPE_MEMORY_REGION) {
+      msg->coredump_memory_bytes += block_len;
+    } else if ((block_type == COREDUMP_BLOCK_TYPE_TRACE_REASON) && (block_len >= 4)) {
+      msg->coredump_trace_reason = prv_read_le_u32(&data[offset]);
+    }
+    msg->coredump_num_blocks++;
+    offset += block_len;
+  }
+  return true;
+}
+
+//
+// Messages
+//
+
+static bool prv_decode_message(sMfltIngestionDecoder *decoder, const uint8_t *msg_data,
+                               size_t msg_len) {
+  sMfltIngestionStats *stats = &decoder->stats;
+  if (msg_len == 0) {
+    stats->num_decode_errors++;
+    return false;
+  }
+
+  sMfltIngestionMessage msg = {
+    .type = (eMfltIngestionMsgType)(msg_data[0] & MSG_HDR_TYPE_MASK),
+    .rle = (msg_data[0] & MSG_HDR_RLE_MASK) != 0,
+    .data = &msg_data[1],
+    .data_len = msg_len - 1,
+  };
+
+  if (msg.rle) {
+    size_t decoded_len;
+    if (!prv_rle_decode(decoder, msg.data, msg.data_len, &decoded_len)) {
+      stats->num_decode_errors++;
+      return false;
+    }
+    msg.data = decoder->rle_buf;
+    msg.data_len = decoded_len;
+  }
+
+  bool success;
+  switch (msg.type) {
+    case kMfltIngestionMsgType_Event:
+      success = prv_decode_event(msg.data, msg.data_len, &msg);
+      break;
+    case kMfltIngestionMsgType_Coredump:
+      success = prv_decode_coredump(msg.data, msg.data_len, &msg);
+      break;
+    default:
+      success = false;
+      break;
+  }
+  if (!success) {
+    stats->num_decode_errors++;
+    return false;
+  }
+
+  stats->num_messages++;
+  stats->message_bytes += msg.data_len;
+  if (msg.type == kMfltIngestionMsgType_Coredump) {
+    stats->num_coredumps++;
+  } else if (msg.event_type == kMfltIngestionEventType_Heartbeat) {
+    stats->num_heartbeats++;
+  } else if (msg.event_type == kMfltIngestionEventType_Trace) {
+    stats->num_trace_events++;
+  } else {
+    stats->num_other_events++;
+  }
+
+  if (decoder->message_cb != NULL) {
+    decoder->message_cb(decoder->device_serial, &msg, decoder->cb_ctx);
+  }
+  return true;
+}
+
+//! Checks the CRC16 which follows a complete message and decodes it
+static bool prv_complete_message(sMfltIngestionDecoder *decoder, const uint8_t *msg_data,
+                                 size_t msg_len, const uint8_t *crc_bytes) {
+  const uint16_t expected_crc = (uint16_t)(crc_bytes[0] | (crc_bytes[1] << 8));
+  const uint16_t crc = memfault_crc16_ccitt_compute(MEMFAULT_CRC16_CCITT_INITIAL_VALUE, msg_data,
+                                                    msg_len);
+  if (crc != expected_crc) {
+    decoder->stats.num_crc_errors++;
+    return false;
+  }
+  return prv_decode_message(decoder, msg_data, msg_len);
+}
+
+static bool prv_framing_error(sMfltIngestionDecoder *decoder) {
+  decoder->msg_in_progress = false;
+  decoder->stats.num_framing_errors++;
+  return false;
+}
+
+//
+// Forward error correction
+//
+
+static void prv_fec_begin_message(sMfltIngestionDecoder *decoder) {
+  decoder->msg_in_progress = true;
+  decoder->msg_fec = true;
+  decoder->msg_total_known = false;
+  decoder->msg_crc_known = false;
+  decoder->msg_offset = 0;
+  decoder->msg_bytes_received = 0;
+  decoder->fec_num_chunks = 0;
+  decoder->fec_msg_complete = false;
+}
+
+//! Copies the data of a chunk to its place in the message
+static bool prv_fec_add_data(sMfltIngestionDecoder *decoder, uint32_t offset,
+                             const uint8_t *data, size_t data_len) {
+  const size_t end_offset = (size_t)offset + data_len;
+  if ((offset < decoder->msg_offset) || (end_offset > MEMFAULT_INGESTION_MAX_MSG_SIZE) ||
+      (decoder->msg_total_known && (end_offset > decoder->msg_total_len)) ||
+      !prv_reserve(&decoder->msg_buf, &decoder->msg_buf_size, end_offset)) {
+    return false;
+  }
+  memcpy(&decoder->msg_buf[offset], data, data_len);
+  decoder->msg_offset = (uint32_t)end_offset;
+  decoder->msg_bytes_received += (uint32_t)data_len;
+
+  const size_t max_chunks = MEMFAULT_ARRAY_SIZE(decoder->fec_chunks);
+  if (decoder->fec_num_chunks == max_chunks) {
+    // a parity went missing, the oldest chunk can't be part of a group which is still recoverable
+    memmove(&decoder->fec_chunks[0], &decoder->fec_chunks[1],
+            (max_chunks - 1) * sizeof(decoder->fec_chunks[0]));
+    decoder->fec_num_chunks--;
+  }
+  decoder->fec_chunks[decoder->fec_num_chunks].offset = offset;
+  decoder->fec_chunks[decoder->fec_num_chunks].len = (uint32_t)data_len;
+  decoder->fec_num_chunks++;
+  return true;
+}
+
+static bool prv_fec_set_total_len(sMfltIngestionDecoder *decoder, uint32_t total_len) {
+  if (decoder->msg_total_known) {
+    return total_len == decoder->msg_total_len;
+  }
+  if (total_len < decoder->msg_offset) {
+    return false;
+  }
+  decoder->msg_total_known = true;
+  decoder->msg_total_len = total_len;
+  return true;
+}
+
+static void prv_fec_set_crc(sMfltIngestionDecoder *decoder, const uint8_t *crc_bytes) {
+  memcpy(decoder->msg_crc, crc_bytes, sizeof(decoder->msg_crc));
+  decoder->msg_crc_known = true;
+}
+
+//! Completes the message once all of its data, its length and its CRC16 have arrived
+static bool prv_fec_try_complete(sMfltIngestionDecoder *decoder) {
+  if (!decoder->msg_total_known || !decoder->msg_crc_known ||
+      (decoder->msg_bytes_received != decoder->msg_total_len)) {
+    return true;
+  }
+  decoder->msg_in_progress = false;
+  decoder->fec_msg_complete = true;
+  return prv_complete_message(decoder, decoder->msg_buf, decoder->msg_total_len,
+                              decoder->msg_crc);
+}
+
+//! Rebuilds the data chunk missing from the group [group_start, group_end), if there is exactly
+//! one, by XORing the parity with the data of the chunks which did arrive
+static bool prv_fec_recover(sMfltIngestionDecoder *decoder, uint32_t group_start,
+                            uint32_t group_end, uint8_t num_chunks, const uint8_t *parity,
+                            size_t parity_len) {
+  size_t num_received = 0;
+  size_t num_gaps = 0;
+  uint32_t gap_offset = 0;
+  uint32_t gap_len = 0;
+  uint32_t cursor = group_start;
+  for (size_t i = 0; i < decoder->fec_num_chunks; i++) {
+    const uint32_t offset = decoder->fec_chunks[i].offset;
+    if ((offset < group_start) || (offset >= group_end)) {
+      continue;
+    }
+    if (offset > cursor) {
+      num_gaps++;
+      gap_offset = cursor;
+      gap_len = offset - cursor;
+    }
+    cursor = offset + decoder->fec_chunks[i].len;
+    num_received++;
+  }
+  if (cursor < group_end) {
+    num_gaps++;
+    gap_offset = cursor;
+    gap_len = group_end - cursor;
+  }
+
+  if (num_gaps == 0) {
+    return true;
+  }
+  if ((num_gaps != 1) || ((num_received + 1) != num_chunks) || (gap_len > parity_len) ||
+      !prv_reserve(&decoder->msg_buf, &decoder->msg_buf_size, group_end)) {
+    return false;
+  }
+
+  uint8_t *lost = &decoder->msg_buf[gap_offset];
+  memcpy(lost, parity, gap_len);
+  for (size_t i = 0; i < decoder->fec_num_chunks; i++) {
+    const uint32_t offset = decoder->fec_chunks[i].offset;
+    if ((offset < group_start) || (offset >= group_end)) {
+      continue;
+    }
+    const size_t len = MEMFAULT_MIN(decoder->fec_chunks[i].len, gap_len);
+    for (size_t j = 0; j < len; j++) {
+      lost[j] ^= decoder->msg_buf[offset + j];
+    }
+  }
+  decoder->msg_bytes_received += gap_len;
+  decoder->msg_offset = MEMFAULT_MAX(decoder->msg_offset, group_end);
+  decoder->stats.num_recovered_chunks++;
+  return true;
+}
+
+static bool prv_feed_parity_chunk(sMfltIngestionDecoder *decoder, uint8_t hdr,
+                                  const uint8_t *payload, size_t payload_len) {
+  decoder->stats.num_parity_chunks++;
+  if (!decoder->msg_in_progress) {
+    if (decoder->fec_msg_complete) {
+      // all the data chunks of the last message arrived so its parity isn't needed
+      return true;
+    }
+    // the INIT chunk of the message was lost
+    prv_fec_begin_message(decoder);
+  } else if (!decoder->msg_fec) {
+    return prv_framing_error(decoder);
+  }
+
+  uint32_t group_start;
+  uint32_t group_end;
+  size_t len = memfault_ingestion_decode_varint_u32(payload, payload_len, &group_start);
+  const size_t varint_len = (len == 0) ? 0 :
+      memfault_ingestion_decode_varint_u32(&payload[len], payload_len - len, &group_end);
+  len += varint_len;
+  if ((varint_len == 0) || (len >= payload_len) || (group_start >= group_end)) {
+    return prv_framing_error(decoder);
+  }
+  const uint8_t num_chunks = payload[len++];
+  const uint8_t *parity = &payload[len];
+  size_t parity_len = payload_len - len;
+
+  if ((hdr & CHUNK_HDR_MORE_DATA_MASK) == 0) {
+    // the parity of the last group also carries the length of the message and its CRC16
+    if ((parity_len < CHUNK_CRC16_LEN) || !prv_fec_set_total_len(decoder, group_end)) {
+      return prv_framing_error(decoder);
+    }
+    parity_len -= CHUNK_CRC16_LEN;
+    prv_fec_set_crc(decoder, &parity[parity_len]);
+  }
+
+  if ((group_end > MEMFAULT_INGESTION_MAX_MSG_SIZE) ||
+      !prv_fec_recover(decoder, group_start, group_end, num_chunks, parity, parity_len)) {
+    return prv_framing_error(decoder);
+  }
+
+  // the chunks of the group are no longer needed
+  size_t num_kept = 0;
+  for (size_t i = 0; i < decoder->fec_num_chunks; i++) {
+    if (decoder->fec_chunks[i].offset >= group_end) {
+      decoder->fec_chunks[num_kept++] = decoder->fec_chunks[i];
+    }
+  }
+  decoder->fec_num_chunks = num_kept;
+  return prv_fec_try_complete(decoder);
+}
+
+static bool prv_feed_fec_continuation_chunk(sMfltIngestionDecoder *decoder, uint8_t hdr,
+                                            const uint8_t *payload, size_t payload_len) {
+  if ((CHUNK_HDR_CFG(hdr) & CHUNK_HDR_CFG_FEC_PARITY) != 0) {
+    return prv_feed_parity_chunk(decoder, hdr, payload, payload_len);
+  }
+
+  if (!decoder->msg_in_progress) {
+    // the INIT chunk of the message was lost
+    prv_fec_begin_message(decoder);
+  } else if (!decoder->msg_fec) {
+    return prv_framing_error(decoder);
+  }
+
+  uint32_t offset;
+  const size_t varint_len = memfault_ingestion_decode_varint_u32(payload, payload_len, &offset);
+  if (varint_len == 0) {
+    return prv_framing_error(decoder);
+  }
+  payload += varint_len;
+  payload_len -= varint_len;
+
+  if ((hdr & CHUNK_HDR_MORE_DATA_MASK) == 0) {
+    // the last data chunk, which ends with the CRC16 of the message
+    if ((payload_len < CHUNK_CRC16_LEN) ||
+        !prv_fec_set_total_len(decoder, offset + (uint32_t)(payload_len - CHUNK_CRC16_LEN))) {
+      return prv_framing_error(decoder);
+    }
+    payload_len -= CHUNK_CRC16_LEN;
+    prv_fec_set_crc(decoder, &payload[payload_len]);
+  }
+
+  if (!prv_fec_add_data(decoder, offset, payload, payload_len)) {
+    return prv_framing_error(decoder);
+  }
+  return prv_fec_try_complete(decoder);
+}
+
+//
+// Chunks
+//
+
+static bool prv_feed_init_chunk(sMfltIngestionDecoder *decoder, uint8_t hdr,
+                                const uint8_t *payload, size_t payload_len) {
+  const uint8_t cfg = CHUNK_HDR_CFG(hdr);
+  if ((cfg & ~CHUNK_HDR_CFG_FEC) != CHUNK_HDR_CFG_CRC_AT_END) {
+    return prv_framing_error(decoder);
+  }
+  if (decoder->msg_in_progress) {
+    decoder->msg_in_progress = false;
+    decoder->stats.num_dropped_messages++;
+  }
+
+  const bool fec = (cfg & CHUNK_HDR_CFG_FEC) != 0;
+  decoder->msg_fec = false;
+  decoder->fec_msg_complete = fec;
+  if ((hdr & CHUNK_HDR_MORE_DATA_MASK) == 0) {
+    // the whole message is in this chunk
+    if (payload_len < CHUNK_CRC16_LEN) {
+      return prv_framing_error(decoder);
+    }
+    const size_t msg_len = payload_len - CHUNK_CRC16_LEN;
+    return prv_complete_message(decoder, payload, msg_len, &payload[msg_len]);
+  }
+
+  uint32_t total_len;
+  const size_t varint_len =
+      memfault_ingestion_decode_varint_u32(payload, payload_len, &total_len);
+  const size_t data_len = payload_len - varint_len;
+  if ((varint_len == 0) || (total_len > MEMFAULT_INGESTION_MAX_MSG_SIZE) ||
+      (data_len > total_len) ||
+      !prv_reserve(&decoder->msg_buf, &decoder->msg_buf_size, total_len)) {
+    return prv_framing_error(decoder);
+  }
+
+  if (fec) {
+    prv_fec_begin_message(decoder);
+    prv_fec_set_total_len(decoder, total_len);
+    return prv_fec_add_data(decoder, 0, &payload[varint_len], data_len) ||
+        prv_framing_error(decoder);
+  }
+
+  memcpy(decoder->msg_buf, &payload[varint_len], data_len);
+  decoder->msg_in_progress = true;
+  decoder->msg_total_len = total_len;
+  decoder->msg_offset = (uint32_t)data_len;
+  return true;
+}
+
+static bool prv_feed_continuation_chunk(sMfltIngestionDecoder *decoder, uint8_t hdr,
+                                        const uint8_t *payload, size_t payload_len) {
+  if ((CHUNK_HDR_CFG(hdr) & CHUNK_HDR_CFG_FEC) != 0) {
+    return prv_feed_fec_continuation_chunk(decoder, hdr, payload, payload_len);
+  }
+
+  uint32_t offset;
+  const size_t varint_len = memfault_ingestion_decode_varint_u32(payload, payload_len, &offset);
+  if (!decoder->msg_in_progress || decoder->msg_fec || (varint_len == 0) ||
+      (offset != decoder->msg_offset)) {
+    return prv_framing_error(decoder);
+  }
+  payload += varint_len;
+  payload_len -= varint_len;
+
+  const size_t bytes_remaining = decoder->msg_total_len - decoder->msg_offset;
+  if ((hdr & CHUNK_HDR_MORE_DATA_MASK) != 0) {
+    if (payload_len > bytes_remaining) {
+      return prv_framing_error(decoder);
+    }
+    memcpy(&decoder->msg_buf[decoder->msg_offset], payload, payload_len);
+    decoder->msg_offset += (uint32_t)payload_len;
+    return true;
+  }
+
+  // The last chunk holds the rest of the message and the CRC16. It may be padded past that to a
+  // fixed size so anything after the CRC is ignored.
+  if (payload_len < (bytes_remaining + CHUNK_CRC16_LEN)) {
+    return prv_framing_error(decoder);
+  }
+  memcpy(&decoder->msg_buf[decoder->msg_offset], payload, bytes_remaining);
+  decoder->msg_in_progress = false;
+  return prv_complete_message(decoder, decoder->msg_buf, decoder->msg_total_len,
+                              &payload[bytes_remaining]);
+}
+
+void memfault_ingestion_decoder_init(sMfltIngestionDecoder *decoder, const char *device_serial,
+                                     MfltIngestionMessageCb message_cb, void *cb_ctx) {
+  *decoder = (sMfltIngestionDecoder) {
+    .device_serial = device_serial,
+    .message_cb = message_cb,
+    .cb_ctx = cb_ctx,
+  };
+}
+
+void memfault_ingestion_decoder_deinit(sMfltIngestionDecoder *decoder) {
+  free(decoder->msg_buf);
+  free(decoder->rle_buf);
+  *decoder = (sMfltIngestionDecoder) { 0 };
+}
+
+bool memfault_ingestion_decoder_feed_chunk(sMfltIngestionDecoder *decoder, const void *chunk,
+                                           size_t chunk_len) {
+  const uint8_t *bytes = (const uint8_t *)chunk;
+  decoder->stats.num_chunks++;
+  decoder->stats.chunk_bytes += chunk_len;
+
+  if ((chunk_len < 1) || (CHUNK_HDR_CHANNEL(bytes[0]) != 0)) {
+    return prv_framing_error(decoder);
+  }
+
+  const uint8_t hdr = bytes[0];
+  if ((hdr & CHUNK_HDR_CONTINUATION_MASK) != 0) {
+    return prv_feed_continuation_chunk(decoder, hdr, &bytes[1], chunk_len - 1);
+  }
+  return prv_feed_init_chunk(decoder, hdr, &bytes[1], chunk_len - 1);
+}
+
+void memfault_ingestion_stats_add(sMfltIngestionStats *total, const sMfltIngestionStats *stats) {
+  total->num_chunks += stats->num_chunks;
+  total->chunk_bytes += stats->chunk_bytes;
+  total->num_messages += stats->num_messages;
+  total->num_heartbeats += stats->num_heartbeats;
+  total->num_trace_events += stats->num_trace_events;
+  total->num_other_events += stats->num_other_events;
+  total->num_coredumps += stats->num_coredumps;
+  total->message_bytes += stats->message_bytes;
+  total->num_framing_errors += stats->num_framing_errors;
+  total->num_dropped_messages += stats->num_dropped_messages;
+  total->num_crc_errors += stats->num_crc_errors;
+  total->num_decode_errors += stats->num_decode_errors;
+  total->num_parity_chunks += stats->num_parity_chunks;
+  total->num_recovered_chunks += stats->num_recovered_chunks;
+}
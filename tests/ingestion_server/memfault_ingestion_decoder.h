@@ -0,0 +1,165 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Host side decoder for the data a device sends to the Memfault chunks endpoint. It undoes what
+//! the packetizer does on the device:
+//!
+//!  1. Chunks (see memfault_chunk_transport.c) are validated and reassembled into messages. The
+//!     CRC16 at the end of each message is checked. For messages sent with forward error
+//!     correction, a lost data chunk is rebuilt from the parity chunk of its group. The chunks of
+//!     such messages must not be padded.
+//!  2. The message header byte gives the message type and whether the payload is run length
+//!     encoded (see memfault/util/rle.h), in which case it is expanded.
+//!  3. Events are checked to be a single, well formed CBOR item and coredumps to be a valid
+//!     header followed by blocks which add up to the size in the header.
+//!
+//! A decoder holds the reassembly state for one device, so chunks from different devices must be
+//! fed to different decoders. The decoder is not thread safe.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memfault/util/chunk_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! The largest message (after RLE decoding) the decoder accepts
+#ifndef MEMFAULT_INGESTION_MAX_MSG_SIZE
+#define MEMFAULT_INGESTION_MAX_MSG_SIZE (512 * 1024)
+#endif
+
+//! Message types of the chunks API, see eMfltMessageType in memfault_data_packetizer.c
+typedef enum {
+  kMfltIngestionMsgType_Coredump = 1,
+  kMfltIngestionMsgType_Event = 2,
+} eMfltIngestionMsgType;
+
+typedef enum {
+  kMfltIngestionEventType_Unknown = 0,
+  kMfltIngestionEventType_Heartbeat = 1,
+  kMfltIngestionEventType_Trace = 2,
+} eMfltIngestionEventType;
+
+//! A fully reassembled and decoded message
+typedef struct {
+  eMfltIngestionMsgType type;
+  //! true if the payload was run length encoded on the wire
+  bool rle;
+  //! The message payload, after RLE decoding
+  const uint8_t *data;
+  size_t data_len;
+
+  //! kMfltIngestionMsgType_Event: the value of the "type" key of the event
+  eMfltIngestionEventType event_type;
+
+  //! kMfltIngestionMsgType_Coredump: number of blocks and the number of bytes of memory regions
+  size_t coredump_num_blocks;
+  size_t coredump_memory_bytes;
+  //! kMfltIngestionMsgType_Coredump: the trace reason block or 0 if there was none
+  uint32_t coredump_trace_reason;
+} sMfltIngestionMessage;
+
+typedef struct {
+  //! Chunks fed to the decoder and their total size in bytes
+  uint64_t num_chunks;
+  uint64_t chunk_bytes;
+
+  //! Messages successfully decoded, by type
+  uint64_t num_messages;
+  uint64_t num_heartbeats;
+  uint64_t num_trace_events;
+  uint64_t num_other_events;
+  uint64_t num_coredumps;
+  //! Bytes of message payload after RLE decoding
+  uint64_t message_bytes;
+
+  //! Chunks which couldn't be parsed or which didn't follow on from the previous chunk
+  uint64_t num_framing_errors;
+  //! Partially received messages dropped because the device started over with a new message,
+  //! i.e after a memfault_packetizer_abort()
+  uint64_t num_dropped_messages;
+  //! Messages whose CRC16 didn't match
+  uint64_t num_crc_errors;
+  //! Messages whose content couldn't be decoded (bad RLE, malformed CBOR or coredump)
+  uint64_t num_decode_errors;
+
+  //! Forward error correction: parity chunks received and lost data chunks rebuilt from them
+  uint64_t num_parity_chunks;
+  uint64_t num_recovered_chunks;
+} sMfltIngestionStats;
+
+typedef void (*MfltIngestionMessageCb)(const char *device_serial,
+                                       const sMfltIngestionMessage *msg, void *ctx);
+
+typedef struct {
+  const char *device_serial;
+  //! Called for every message decoded, may be NULL
+  MfltIngestionMessageCb message_cb;
+  void *cb_ctx;
+
+  //! Reassembly state for messages which span several chunks
+  uint8_t *msg_buf;
+  size_t msg_buf_size;
+  bool msg_in_progress;
+  uint32_t msg_total_len;
+  uint32_t msg_offset;
+
+  //! Reassembly state for messages sent with forward error correction. Data chunks may be missing
+  //! until the parity of their group arrives, so the chunks received since the last parity are
+  //! tracked and the total length and CRC16 are only known once the last chunks arrive.
+  bool msg_fec;
+  bool msg_total_known;
+  bool msg_crc_known;
+  uint8_t msg_crc[2];
+  uint32_t msg_bytes_received;
+  struct {
+    uint32_t offset;
+    uint32_t len;
+  } fec_chunks[2 * MEMFAULT_CHUNK_TRANSPORT_MAX_FEC_GROUP_SIZE];
+  size_t fec_num_chunks;
+  //! The last message sent with forward error correction is complete, so the parity which
+  //! follows it is ignored
+  bool fec_msg_complete;
+
+  //! Scratch space the RLE encoded payloads are expanded into
+  uint8_t *rle_buf;
+  size_t rle_buf_size;
+
+  sMfltIngestionStats stats;
+} sMfltIngestionDecoder;
+
+//! @param device_serial The serial of the device the chunks come from. Only used to annotate the
+//!   messages passed to message_cb so it must outlive the decoder.
+void memfault_ingestion_decoder_init(sMfltIngestionDecoder *decoder, const char *device_serial,
+                                     MfltIngestionMessageCb message_cb, void *cb_ctx);
+
+//! Frees the buffers held by the decoder
+void memfault_ingestion_decoder_deinit(sMfltIngestionDecoder *decoder);
+
+//! Feeds one chunk, as produced by memfault_packetizer_get_next(), to the decoder
+//!
+//! @return false if the chunk was rejected or completed a message which failed to decode. The
+//!   error is also counted in the stats of the decoder and any message in progress is dropped.
+bool memfault_ingestion_decoder_feed_chunk(sMfltIngestionDecoder *decoder, const void *chunk,
+                                           size_t chunk_len);
+
+//! Adds the counters of 'stats' to 'total'
+void memfault_ingestion_stats_add(sMfltIngestionStats *total, const sMfltIngestionStats *stats);
+
+//! Decodes an unsigned LEB128 varint, the format of memfault_encode_varint_u32()
+//!
+//! @return the number of bytes consumed or 0 if the varint is truncated or too long
+size_t memfault_ingestion_decode_varint_u32(const uint8_t *buf, size_t buf_len,
+                                            uint32_t *value_out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,908 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+// for memmem()
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "memfault_ingestion_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define CHUNKS_PATH "/api/v0/chunks"
+#define CHUNKS_PATH_PREFIX CHUNKS_PATH "/"
+#define CHUNK_BATCH_CONTENT_TYPE "multipart/mixed"
+
+#define MAX_DEVICE_SERIAL_LEN 64
+#define MAX_PROJECT_KEY_LEN 64
+//! The longest multipart boundary RFC 2046 allows
+#define MAX_BOUNDARY_LEN 70
+
+//! Room for the headers and the framing of a body sent with Transfer-Encoding: chunked
+#define MAX_REQUEST_OVERHEAD (64 * 1024)
+#define MAX_REQUEST_SIZE (MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE + MAX_REQUEST_OVERHEAD)
+
+//! Accepted connections waiting for a worker
+#define CONNECTION_QUEUE_SIZE 128
+
+//! How often the threads check whether the server is being stopped
+#define STOP_POLL_INTERVAL_MS 100
+
+typedef struct MfltIngestionDevice {
+  struct MfltIngestionDevice *next;
+  char device_serial[MAX_DEVICE_SERIAL_LEN];
+  //! Serializes the requests of a device which uses several connections
+  pthread_mutex_t lock;
+  sMfltIngestionDecoder decoder;
+  sMfltIngestionDeviceStats stats;
+} sMfltIngestionDevice;
+
+struct MfltIngestionServer {
+  sMfltIngestionServerConfig config;
+  int listen_fd;
+  uint16_t port;
+  uint64_t start_ms;
+  volatile bool stop;
+
+  pthread_t accept_thread;
+  pthread_t *workers;
+  size_t num_workers;
+
+  //! Protects everything below
+  pthread_mutex_t lock;
+  pthread_cond_t connection_available;
+  int connection_queue[CONNECTION_QUEUE_SIZE];
+  size_t queue_head;
+  size_t queue_len;
+  sMfltIngestionDevice *devices;
+  uint32_t response_status;
+  uint32_t response_retry_after_s;
+};
+
+typedef struct {
+  char method[8];
+  char device_serial[MAX_DEVICE_SERIAL_LEN];
+  char project_key[MAX_PROJECT_KEY_LEN];
+  bool is_chunks_path;
+  //! Set for a multipart/mixed batch of chunks, along with the boundary of its parts
+  bool chunk_batch;
+  char boundary[MAX_BOUNDARY_LEN + 1];
+  bool deflate;
+  bool keep_alive;
+  //! The body, decoded from Transfer-Encoding: chunked if need be
+  const uint8_t *body;
+  size_t body_len;
+  //! Set when the body had to be reassembled into a buffer of its own
+  uint8_t *body_buf;
+} sIngestionRequest;
+
+static uint64_t prv_time_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000) + ((uint64_t)ts.tv_nsec / 1000000);
+}
+
+//
+// Devices
+//
+
+static sMfltIngestionDevice *prv_get_device(sMfltIngestionServer *server,
+                                            const char *device_serial) {
+  pthread_mutex_lock(&server->lock);
+  sMfltIngestionDevice *device = server->devices;
+  while ((device != NULL) && (strcmp(device->device_serial, device_serial) != 0)) {
+    device = device->next;
+  }
+
+  if (device == NULL) {
+    device = calloc(1, sizeof(*device));
+    if (device != NULL) {
+      snprintf(device->device_serial, sizeof(device->device_serial), "%s", device_serial);
+      pthread_mutex_init(&device->lock, NULL);
+      memfault_ingestion_decoder_init(&device->decoder, device->device_serial,
+                                      server->config.message_cb, server->config.cb_ctx);
+      device->next = server->devices;
+      server->devices = device;
+    }
+  }
+  pthread_mutex_unlock(&server->lock);
+  return device;
+}
+
+static void prv_free_devices(sMfltIngestionServer *server) {
+  sMfltIngestionDevice *device = server->devices;
+  while (device != NULL) {
+    sMfltIngestionDevice *next = device->next;
+    memfault_ingestion_decoder_deinit(&device->decoder);
+    pthread_mutex_destroy(&device->lock);
+    free(device);
+    device = next;
+  }
+  server->devices = NULL;
+}
+
+//! Must be called with the device lock held
+static void prv_snapshot_device_stats(const sMfltIngestionDevice *device,
+                                      sMfltIngestionDeviceStats *stats_out) {
+  *stats_out = device->stats;
+  stats_out->decoder = device->decoder.stats;
+}
+
+//
+// Request parsing
+//
+
+//! @return a pointer to the value of the header if 'line' is the header 'name' or NULL otherwise
+static const char *prv_header_value(const char *line, const char *line_end, const char *name) {
+  const size_t name_len = strlen(name);
+  if (((size_t)(line_end - line) <= name_len) || (strncasecmp(line, name, name_len) != 0) ||
+      (line[name_len] != ':')) {
+    return NULL;
+  }
+  const char *value = &line[name_len + 1];
+  while ((value < line_end) && (*value == ' ')) {
+    value++;
+  }
+  return value;
+}
+
+static void prv_copy_header_value(char *dst, size_t dst_size, const char *value,
+                                  const char *line_end) {
+  const size_t len = (size_t)(line_end - value);
+  snprintf(dst, dst_size, "%.*s", (int)len, value);
+}
+
+//! Populates the boundary of a multipart/mixed batch of chunks from its Content-Type
+//!
+//! @return false if the batch has no valid boundary
+static bool prv_parse_boundary(const char *value, const char *line_end, sIngestionRequest *req) {
+  const char *param = memmem(value, (size_t)(line_end - value), "boundary=", strlen("boundary="));
+  if (param == NULL) {
+    return false;
+  }
+  const char *boundary = param + strlen("boundary=");
+  const char *boundary_end = boundary;
+  while ((boundary_end < line_end) && (*boundary_end != ';') && (*boundary_end != ' ')) {
+    boundary_end++;
+  }
+  const size_t boundary_len = (size_t)(boundary_end - boundary);
+  if ((boundary_len == 0) || (boundary_len > MAX_BOUNDARY_LEN)) {
+    return false;
+  }
+  memcpy(req->boundary, boundary, boundary_len);
+  req->boundary[boundary_len] = '\0';
+  return true;
+}
+
+static bool prv_parse_request_line(const char *line, const char *line_end,
+                                   sIngestionRequest *req) {
+  // <method> <path> HTTP/1.x
+  const char *method_end = memchr(line, ' ', (size_t)(line_end - line));
+  if ((method_end == NULL) || ((size_t)(method_end - line) >= sizeof(req->method))) {
+    return false;
+  }
+  memcpy(req->method, line, (size_t)(method_end - line));
+
+  const char *path = method_end + 1;
+  const char *path_end = memchr(path, ' ', (size_t)(line_end - path));
+  if ((path_end == NULL) || (strncmp(path_end + 1, "HTTP/1.", strlen("HTTP/1.")) != 0)) {
+    return false;
+  }
+  // HTTP/1.1 connections are persistent unless asked otherwise, HTTP/1.0 ones are not
+  req->keep_alive = (path_end[1 + strlen("HTTP/1.")] == '1');
+
+  const size_t prefix_len = strlen(CHUNKS_PATH_PREFIX);
+  const size_t path_len = (size_t)(path_end - path);
+  const size_t serial_len = path_len - prefix_len;
+  req->is_chunks_path = (path_len > prefix_len) &&
+      (strncmp(path, CHUNKS_PATH_PREFIX, prefix_len) == 0) &&
+      (serial_len < sizeof(req->device_serial)) &&
+      (memchr(&path[prefix_len], '/', serial_len) == NULL);
+  if (req->is_chunks_path) {
+    memcpy(req->device_serial, &path[prefix_len], serial_len);
+  }
+  return true;
+}
+
+//! Reassembles a body sent with "Transfer-Encoding: chunked"
+//!
+//! @return the length of the request, 0 if it is incomplete or -1 if it is malformed
+static ssize_t prv_parse_chunked_body(const char *buf, size_t len, size_t body_start,
+                                      sIngestionRequest *req) {
+  size_t pos = body_start;
+  size_t body_len = 0;
+  uint8_t *body = NULL;
+
+  while (1) {
+    const char *size_line_end = memmem(&buf[pos], len - pos, "\r\n", 2);
+    if (size_line_end == NULL) {
+      free(body);
+      return 0;
+    }
+    char *size_end;
+    const unsigned long chunk_size = strtoul(&buf[pos], &size_end, 16);
+    if ((size_end == &buf[pos]) ||
+        (chunk_size > (MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE - body_len))) {
+      free(body);
+      return -1;
+    }
+    pos = (size_t)(size_line_end - buf) + 2;
+
+    if (chunk_size == 0) {
+      // no trailers are expected, just the blank line which ends the body
+      if ((len - pos) < 2) {
+        free(body);
+        return 0;
+      }
+      if (memcmp(&buf[pos], "\r\n", 2) != 0) {
+        free(body);
+        return -1;
+      }
+      req->body = body;
+      req->body_buf = body;
+      req->body_len = body_len;
+      return (ssize_t)(pos + 2);
+    }
+
+    if ((len - pos) < (chunk_size + 2)) {
+      free(body);
+      return 0;
+    }
+    uint8_t *new_body = realloc(body, body_len + chunk_size);
+    if (new_body == NULL) {
+      free(body);
+      return -1;
+    }
+    body = new_body;
+    memcpy(&body[body_len], &buf[pos], chunk_size);
+    body_len += chunk_size;
+    pos += chunk_size;
+    if (memcmp(&buf[pos], "\r\n", 2) != 0) {
+      free(body);
+      return -1;
+    }
+    pos += 2;
+  }
+}
+
+//! @return the length of the request at the start of 'buf', 0 if it has not been fully received
+//!   yet or -1 if it is malformed
+static ssize_t prv_parse_request(const char *buf, size_t len, sIngestionRequest *req) {
+  *req = (sIngestionRequest) { 0 };
+
+  const char *hdr_end = memmem(buf, len, "\r\n\r\n", 4);
+  if (hdr_end == NULL) {
+    return (len >= MAX_REQUEST_OVERHEAD) ? -1 : 0;
+  }
+
+  const char *line_end = memmem(buf, (size_t)(hdr_end + 2 - buf), "\r\n", 2);
+  if (!prv_parse_request_line(buf, line_end, req)) {
+    return -1;
+  }
+
+  bool chunked = false;
+  size_t content_length = 0;
+  for (const char *line = line_end + 2; line < hdr_end + 2; line = line_end + 2) {
+    line_end = memmem(line, (size_t)(hdr_end + 2 - line), "\r\n", 2);
+    const char *value;
+    if ((value = prv_header_value(line, line_end, "Content-Length")) != NULL) {
+      content_length = strtoul(value, NULL, 10);
+    } else if ((value = prv_header_value(line, line_end, "Transfer-Encoding")) != NULL) {
+      chunked = (strncasecmp(value, "chunked", strlen("chunked")) == 0);
+    } else if ((value = prv_header_value(line, line_end, "Content-Type")) != NULL) {
+      req->chunk_batch = (strncasecmp(value, CHUNK_BATCH_CONTENT_TYPE,
+                                      strlen(CHUNK_BATCH_CONTENT_TYPE)) == 0);
+      if (req->chunk_batch && !prv_parse_boundary(value, line_end, req)) {
+        return -1;
+      }
+    } else if ((value = prv_header_value(line, line_end, "Content-Encoding")) != NULL) {
+      req->deflate = (strncasecmp(value, "deflate", strlen("deflate")) == 0);
+    } else if ((value = prv_header_value(line, line_end, "Connection")) != NULL) {
+      if (strncasecmp(value, "close", strlen("close")) == 0) {
+        req->keep_alive = false;
+      } else if (strncasecmp(value, "keep-alive", strlen("keep-alive")) == 0) {
+        req->keep_alive = true;
+      }
+    } else if ((value = prv_header_value(line, line_end, "Memfault-Project-Key")) != NULL) {
+      prv_copy_header_value(req->project_key, sizeof(req->project_key), value, line_end);
+    }
+  }
+
+  const size_t body_start = (size_t)(hdr_end + 4 - buf);
+  if (chunked) {
+    return prv_parse_chunked_body(buf, len, body_start, req);
+  }
+
+  if (content_length > MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE) {
+    return -1;
+  }
+  if ((len - body_start) < content_length) {
+    return 0;
+  }
+  req->body = (const uint8_t *)&buf[body_start];
+  req->body_len = content_length;
+  return (ssize_t)(body_start + content_length);
+}
+
+//
+// Request handling
+//
+
+static bool prv_inflate(const uint8_t *in, size_t in_len, uint8_t **out, size_t *out_len) {
+  z_stream strm = { 0 };
+  if (inflateInit(&strm) != Z_OK) {
+    return false;
+  }
+  strm.next_in = (Bytef *)in;
+  strm.avail_in = (uInt)in_len;
+
+  size_t buf_size = 0;
+  uint8_t *buf = NULL;
+  int rv;
+  do {
+    if (strm.total_out == buf_size) {
+      if (buf_size >= MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE) {
+        rv = Z_BUF_ERROR;
+        break;
+      }
+      buf_size = (buf_size == 0) ? (in_len * 4) + 256 : buf_size * 2;
+      if (buf_size > MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE) {
+        buf_size = MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE;
+      }
+      uint8_t *new_buf = realloc(buf, buf_size);
+      if (new_buf == NULL) {
+        rv = Z_MEM_ERROR;
+        break;
+      }
+      buf = new_buf;
+    }
+    strm.next_out = &buf[strm.total_out];
+    strm.avail_out = (uInt)(buf_size - strm.total_out);
+    rv = inflate(&strm, Z_NO_FLUSH);
+  } while ((rv == Z_OK) || ((rv == Z_BUF_ERROR) && (strm.avail_out == 0)));
+
+  inflateEnd(&strm);
+  if (rv != Z_STREAM_END) {
+    free(buf);
+    return false;
+  }
+  *out = buf;
+  *out_len = strm.total_out;
+  return true;
+}
+
+//! Feeds the parts of a multipart/mixed batch to the decoder of the device, one chunk per part.
+//! See memfault/http/chunk_batch.h for the format of a batch.
+static bool prv_decode_multipart_body(sMfltIngestionDecoder *decoder, const char *boundary,
+                                      const uint8_t *body, size_t body_len) {
+  // every delimiter but the first one is preceded by the end of the line of the part before it
+  char delimiter[MAX_BOUNDARY_LEN + 5];
+  const size_t delimiter_len = (size_t)snprintf(delimiter, sizeof(delimiter), "\r\n--%s",
+                                                boundary);
+  size_t offset = delimiter_len - 2;
+  if ((body_len < offset) || (memcmp(body, &delimiter[2], offset) != 0)) {
+    decoder->stats.num_framing_errors++;
+    return false;
+  }
+
+  while (1) {
+    // the close delimiter is followed by "--", the others by the end of their line
+    if (((body_len - offset) >= 2) && (memcmp(&body[offset], "--", 2) == 0)) {
+      return true;
+    }
+    if (((body_len - offset) < 2) || (memcmp(&body[offset], "\r\n", 2) != 0)) {
+      decoder->stats.num_framing_errors++;
+      return false;
+    }
+    offset += 2;
+
+    // the headers of the part are skipped, the blank line which ends them starts the chunk
+    size_t chunk_start = offset + 2;
+    if (((body_len - offset) < 2) || (memcmp(&body[offset], "\r\n", 2) != 0)) {
+      const uint8_t *hdr_end = memmem(&body[offset], body_len - offset, "\r\n\r\n", 4);
+      if (hdr_end == NULL) {
+        decoder->stats.num_framing_errors++;
+        return false;
+      }
+      chunk_start = (size_t)(hdr_end - body) + 4;
+    }
+
+    const uint8_t *chunk_end =
+        memmem(&body[chunk_start], body_len - chunk_start, delimiter, delimiter_len);
+    if (chunk_end == NULL) {
+      decoder->stats.num_framing_errors++;
+      return false;
+    }
+    const size_t chunk_len = (size_t)(chunk_end - &body[chunk_start]);
+    if (!memfault_ingestion_decoder_feed_chunk(decoder, &body[chunk_start], chunk_len)) {
+      return false;
+    }
+    offset = chunk_start + chunk_len + delimiter_len;
+  }
+}
+
+//! Feeds the chunks of a body to the decoder of the device
+static bool prv_decode_body(sMfltIngestionDecoder *decoder, const sIngestionRequest *req,
+                            const uint8_t *body, size_t body_len) {
+  if (!req->chunk_batch) {
+    return memfault_ingestion_decoder_feed_chunk(decoder, body, body_len);
+  }
+  return prv_decode_multipart_body(decoder, req->boundary, body, body_len);
+}
+
+//! Must be called with the device lock held
+static void prv_record_request(sMfltIngestionServer *server, sMfltIngestionDevice *device,
+                               uint32_t status, size_t body_bytes) {
+  sMfltIngestionDeviceStats *stats = &device->stats;
+  const uint64_t now_ms = prv_time_ms() - server->start_ms;
+  if (stats->num_requests == 0) {
+    stats->first_request_ms = now_ms;
+  }
+  stats->last_request_ms = now_ms;
+  stats->num_requests++;
+  stats->body_bytes += body_bytes;
+  if ((status < 200) || (status >= 300)) {
+    stats->num_rejected_requests++;
+  }
+}
+
+//! @return the HTTP status to respond with
+static uint32_t prv_handle_request(sMfltIngestionServer *server, const sIngestionRequest *req) {
+  if (strcmp(req->method, "POST") != 0) {
+    return 405;
+  }
+  if (!req->is_chunks_path) {
+    return 404;
+  }
+  if ((server->config.project_key != NULL) &&
+      (strcmp(server->config.project_key, req->project_key) != 0)) {
+    return 401;
+  }
+
+  pthread_mutex_lock(&server->lock);
+  const uint32_t response_status = server->response_status;
+  pthread_mutex_unlock(&server->lock);
+
+  uint8_t *inflated = NULL;
+  const uint8_t *body = req->body;
+  size_t body_len = req->body_len;
+
+  sMfltIngestionDevice *device = prv_get_device(server, req->device_serial);
+  if (device == NULL) {
+    return 500;
+  }
+
+  uint32_t status = response_status;
+  pthread_mutex_lock(&device->lock);
+  if (status == 0) {
+    status = 202;
+    if (req->deflate) {
+      if (prv_inflate(req->body, req->body_len, &inflated, &body_len)) {
+        body = inflated;
+      } else {
+        device->decoder.stats.num_decode_errors++;
+        status = 400;
+      }
+    }
+    if ((status == 202) &&
+        !prv_decode_body(&device->decoder, req, body, body_len)) {
+      status = 400;
+    }
+  }
+  prv_record_request(server, device, status, req->body_len);
+  pthread_mutex_unlock(&device->lock);
+
+  free(inflated);
+  return status;
+}
+
+static const char *prv_status_text(uint32_t status) {
+  switch (status) {
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 429: return "Too Many Requests";
+    case 503: return "Service Unavailable";
+    default: return (status < 300) ? "OK" : "Error";
+  }
+}
+
+static bool prv_send_response(sMfltIngestionServer *server, int fd, uint32_t status,
+                              bool keep_alive) {
+  pthread_mutex_lock(&server->lock);
+  const uint32_t retry_after_s = (server->response_status != 0) ?
+      server->response_retry_after_s : 0;
+  pthread_mutex_unlock(&server->lock);
+
+  if (server->config.response_delay_ms != 0) {
+    usleep(server->config.response_delay_ms * 1000);
+  }
+
+  char retry_after[32] = "";
+  if ((retry_after_s != 0) && (status == server->response_status)) {
+    snprintf(retry_after, sizeof(retry_after), "Retry-After: %" PRIu32 "\r\n", retry_after_s);
+  }
+
+  const char *text = prv_status_text(status);
+  char rsp[256];
+  const int rsp_len = snprintf(rsp, sizeof(rsp),
+                               "HTTP/1.1 %" PRIu32 " %s\r\n"
+                               "%s"
+                               "Connection: %s\r\n"
+                               "Content-Length: %d\r\n"
+                               "\r\n"
+                               "%s",
+                               status, text, retry_after, keep_alive ? "keep-alive" : "close",
+                               (int)strlen(text), text);
+  const char *bytes = rsp;
+  size_t len = (size_t)rsp_len;
+  while (len > 0) {
+    const ssize_t rv = send(fd, bytes, len, MSG_NOSIGNAL);
+    if (rv <= 0) {
+      if ((rv < 0) && (errno == EINTR)) {
+        continue;
+      }
+      return false;
+    }
+    bytes += rv;
+    len -= (size_t)rv;
+  }
+  return true;
+}
+
+//! Serves the requests of a connection until it is closed, goes idle or the server stops
+static void prv_serve_connection(sMfltIngestionServer *server, int fd) {
+  size_t buf_size = 4096;
+  char *buf = malloc(buf_size);
+  size_t len = 0;
+  uint64_t last_activity_ms = prv_time_ms();
+
+  while ((buf != NULL) && !server->stop) {
+    struct pollfd poll_fd = { .fd = fd, .events = POLLIN };
+    const int rv = poll(&poll_fd, 1, STOP_POLL_INTERVAL_MS);
+    if (rv == 0) {
+      if ((prv_time_ms() - last_activity_ms) > MEMFAULT_INGESTION_SERVER_IDLE_TIMEOUT_MS) {
+        break;
+      }
+      continue;
+    }
+    if ((rv < 0) && (errno == EINTR)) {
+      continue;
+    }
+
+    if (len == buf_size) {
+      if (buf_size >= MAX_REQUEST_SIZE) {
+        prv_send_response(server, fd, 413, false);
+        break;
+      }
+      buf_size *= 2;
+      char *new_buf = realloc(buf, buf_size);
+      if (new_buf == NULL) {
+        break;
+      }
+      buf = new_buf;
+    }
+    const ssize_t bytes_read = recv(fd, &buf[len], buf_size - len, 0);
+    if (bytes_read <= 0) {
+      break;
+    }
+    len += (size_t)bytes_read;
+    last_activity_ms = prv_time_ms();
+
+    // several requests may have been pipelined
+    bool keep_alive = true;
+    sIngestionRequest req;
+    ssize_t request_len;
+    while (keep_alive && ((request_len = prv_parse_request(buf, len, &req)) != 0)) {
+      if (request_len < 0) {
+        prv_send_response(server, fd, 400, false);
+        keep_alive = false;
+        break;
+      }
+      const uint32_t status = prv_handle_request(server, &req);
+      free(req.body_buf);
+      keep_alive = req.keep_alive && prv_send_response(server, fd, status, req.keep_alive);
+      memmove(buf, &buf[request_len], len - (size_t)request_len);
+      len -= (size_t)request_len;
+    }
+    if (!keep_alive) {
+      break;
+    }
+  }
+
+  free(buf);
+  close(fd);
+}
+
+//
+// Threads
+//
+
+static void *prv_worker_thread(void *arg) {
+  sMfltIngestionServer *server = arg;
+  while (1) {
+    pthread_mutex_lock(&server->lock);
+    while (!server->stop && (server->queue_len == 0)) {
+      pthread_cond_wait(&server->connection_available, &server->lock);
+    }
+    if (server->stop) {
+      pthread_mutex_unlock(&server->lock);
+      break;
+    }
+    const int fd = server->connection_queue[server->queue_head];
+    server->queue_head = (server->queue_head + 1) % CONNECTION_QUEUE_SIZE;
+    server->queue_len--;
+    pthread_mutex_unlock(&server->lock);
+
+    prv_serve_connection(server, fd);
+  }
+  return NULL;
+}
+
+static void *prv_accept_thread(void *arg) {
+  sMfltIngestionServer *server = arg;
+  while (!server->stop) {
+    struct pollfd poll_fd = { .fd = server->listen_fd, .events = POLLIN };
+    if (poll(&poll_fd, 1, STOP_POLL_INTERVAL_MS) <= 0) {
+      continue;
+    }
+    const int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+
+    pthread_mutex_lock(&server->lock);
+    const bool queued = server->queue_len < CONNECTION_QUEUE_SIZE;
+    if (queued) {
+      const size_t tail = (server->queue_head + server->queue_len) % CONNECTION_QUEUE_SIZE;
+      server->connection_queue[tail] = fd;
+      server->queue_len++;
+      pthread_cond_signal(&server->connection_available);
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (!queued) {
+      prv_send_response(server, fd, 503, false);
+      close(fd);
+    }
+  }
+  return NULL;
+}
+
+static int prv_listen(sMfltIngestionServer *server) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  const int reuse = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port = htons(server->config.port),
+    .sin_addr.s_addr = htonl(server->config.listen_on_all_interfaces ? INADDR_ANY :
+                                                                        INADDR_LOOPBACK),
+  };
+  socklen_t addr_len = sizeof(addr);
+  if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+      (listen(fd, CONNECTION_QUEUE_SIZE) != 0) ||
+      (getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0)) {
+    close(fd);
+    return -1;
+  }
+  server->port = ntohs(addr.sin_port);
+  return fd;
+}
+
+sMfltIngestionServer *memfault_ingestion_server_start(const sMfltIngestionServerConfig *config) {
+  sMfltIngestionServer *server = calloc(1, sizeof(*server));
+  if (server == NULL) {
+    return NULL;
+  }
+  server->config = *config;
+  server->num_workers = (config->num_workers != 0) ? config->num_workers :
+                                                     MEMFAULT_INGESTION_SERVER_DEFAULT_NUM_WORKERS;
+  server->start_ms = prv_time_ms();
+  pthread_mutex_init(&server->lock, NULL);
+  pthread_cond_init(&server->connection_available, NULL);
+
+  server->listen_fd = prv_listen(server);
+  server->workers = calloc(server->num_workers, sizeof(*server->workers));
+  if ((server->listen_fd < 0) || (server->workers == NULL)) {
+    goto error;
+  }
+
+  size_t num_started = 0;
+  for (; num_started < server->num_workers; num_started++) {
+    if (pthread_create(&server->workers[num_started], NULL, prv_worker_thread, server) != 0) {
+      break;
+    }
+  }
+  if ((num_started != server->num_workers) ||
+      (pthread_create(&server->accept_thread, NULL, prv_accept_thread, server) != 0)) {
+    server->stop = true;
+    pthread_mutex_lock(&server->lock);
+    pthread_cond_broadcast(&server->connection_available);
+    pthread_mutex_unlock(&server->lock);
+    for (size_t i = 0; i < num_started; i++) {
+      pthread_join(server->workers[i], NULL);
+    }
+    goto error;
+  }
+  return server;
+
+error:
+  if (server->listen_fd >= 0) {
+    close(server->listen_fd);
+  }
+  free(server->workers);
+  pthread_cond_destroy(&server->connection_available);
+  pthread_mutex_destroy(&server->lock);
+  free(server);
+  return NULL;
+}
+
+void memfault_ingestion_server_stop(sMfltIngestionServer *server) {
+  server->stop = true;
+  pthread_join(server->accept_thread, NULL);
+
+  pthread_mutex_lock(&server->lock);
+  pthread_cond_broadcast(&server->connection_available);
+  pthread_mutex_unlock(&server->lock);
+  for (size_t i = 0; i < server->num_workers; i++) {
+    pthread_join(server->workers[i], NULL);
+  }
+
+  // connections which never got picked up by a worker
+  for (size_t i = 0; i < server->queue_len; i++) {
+    close(server->connection_queue[(server->queue_head + i) % CONNECTION_QUEUE_SIZE]);
+  }
+
+  close(server->listen_fd);
+  prv_free_devices(server);
+  free(server->workers);
+  pthread_cond_destroy(&server->connection_available);
+  pthread_mutex_destroy(&server->lock);
+  free(server);
+}
+
+uint16_t memfault_ingestion_server_get_port(const sMfltIngestionServer *server) {
+  return server->port;
+}
+
+void memfault_ingestion_server_set_response(sMfltIngestionServer *server, uint32_t status,
+                                            uint32_t retry_after_s) {
+  pthread_mutex_lock(&server->lock);
+  server->response_status = status;
+  server->response_retry_after_s = retry_after_s;
+  pthread_mutex_unlock(&server->lock);
+}
+
+//
+// Stats
+//
+
+bool memfault_ingestion_server_get_device_stats(sMfltIngestionServer *server,
+                                                const char *device_serial,
+                                                sMfltIngestionDeviceStats *stats_out) {
+  pthread_mutex_lock(&server->lock);
+  sMfltIngestionDevice *device = server->devices;
+  while ((device != NULL) && (strcmp(device->device_serial, device_serial) != 0)) {
+    device = device->next;
+  }
+  pthread_mutex_unlock(&server->lock);
+
+  if (device == NULL) {
+    return false;
+  }
+  // devices are only freed when the server stops so it's fine to use it outside the server lock
+  pthread_mutex_lock(&device->lock);
+  prv_snapshot_device_stats(device, stats_out);
+  pthread_mutex_unlock(&device->lock);
+  return true;
+}
+
+static void prv_add_device_stats(sMfltIngestionDeviceStats *total,
+                                 const sMfltIngestionDeviceStats *stats, bool first) {
+  memfault_ingestion_stats_add(&total->decoder, &stats->decoder);
+  total->num_requests += stats->num_requests;
+  total->num_rejected_requests += stats->num_rejected_requests;
+  total->body_bytes += stats->body_bytes;
+  if (first || (stats->first_request_ms < total->first_request_ms)) {
+    total->first_request_ms = stats->first_request_ms;
+  }
+  if (stats->last_request_ms > total->last_request_ms) {
+    total->last_request_ms = stats->last_request_ms;
+  }
+}
+
+void memfault_ingestion_server_get_total_stats(sMfltIngestionServer *server,
+                                               sMfltIngestionDeviceStats *stats_out,
+                                               size_t *num_devices_out) {
+  *stats_out = (sMfltIngestionDeviceStats) { 0 };
+  size_t num_devices = 0;
+
+  pthread_mutex_lock(&server->lock);
+  for (sMfltIngestionDevice *device = server->devices; device != NULL; device = device->next) {
+    sMfltIngestionDeviceStats stats;
+    pthread_mutex_lock(&device->lock);
+    prv_snapshot_device_stats(device, &stats);
+    pthread_mutex_unlock(&device->lock);
+    prv_add_device_stats(stats_out, &stats, num_devices == 0);
+    num_devices++;
+  }
+  pthread_mutex_unlock(&server->lock);
+
+  if (num_devices_out != NULL) {
+    *num_devices_out = num_devices;
+  }
+}
+
+static void prv_print_stats_row(FILE *out, const char *name,
+                                const sMfltIngestionDeviceStats *stats) {
+  const sMfltIngestionStats *d = &stats->decoder;
+  const uint64_t num_events = d->num_heartbeats + d->num_trace_events + d->num_other_events;
+  const uint64_t num_errors = d->num_framing_errors + d->num_dropped_messages +
+      d->num_crc_errors + d->num_decode_errors;
+
+  // throughput over the window the device was sending data in
+  const uint64_t duration_ms = stats->last_request_ms - stats->first_request_ms;
+  char throughput[16] = "-";
+  char request_rate[16] = "-";
+  if (duration_ms != 0) {
+    snprintf(throughput, sizeof(throughput), "%.1f",
+             ((double)stats->body_bytes / 1024.0) / ((double)duration_ms / 1000.0));
+    snprintf(request_rate, sizeof(request_rate), "%.1f",
+             (double)stats->num_requests / ((double)duration_ms / 1000.0));
+  }
+
+  fprintf(out, "%-24s %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64
+          " %9" PRIu64 " %7" PRIu64 " %11" PRIu64 " %9s %9s\n",
+          name, stats->num_requests, stats->num_rejected_requests, d->num_chunks,
+          d->num_messages, num_events, d->num_coredumps, num_errors, stats->body_bytes,
+          throughput, request_rate);
+}
+
+void memfault_ingestion_server_print_report(sMfltIngestionServer *server, FILE *out) {
+  fprintf(out, "%-24s %9s %9s %9s %9s %9s %9s %7s %11s %9s %9s\n", "device", "requests",
+          "rejected", "chunks", "messages", "events", "coredumps", "errors", "bytes", "KiB/s",
+          "req/s");
+
+  pthread_mutex_lock(&server->lock);
+  for (sMfltIngestionDevice *device = server->devices; device != NULL; device = device->next) {
+    sMfltIngestionDeviceStats stats;
+    pthread_mutex_lock(&device->lock);
+    prv_snapshot_device_stats(device, &stats);
+    pthread_mutex_unlock(&device->lock);
+    prv_print_stats_row(out, device->device_serial, &stats);
+  }
+  pthread_mutex_unlock(&server->lock);
+
+  size_t num_devices;
+  sMfltIngestionDeviceStats total;
+  memfault_ingestion_server_get_total_stats(server, &total, &num_devices);
+  char name[32];
+  snprintf(name, sizeof(name), "total (%zu devices)", num_devices);
+  prv_print_stats_row(out, name, &total);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! A local stand-in for the Memfault chunks endpoint (POST /api/v0/chunks/<device_serial>), used
+//! to test the HTTP ports and measure upload throughput without access to the Memfault cloud.
+//!
+//! The server speaks plain HTTP/1.1 with keep-alive and accepts every body format the SDK
+//! produces: a single chunk (memfault_http_start_chunk_post()) and multipart/mixed batches of
+//! chunks, optionally deflate compressed (see memfault/http/chunk_batch.h). Like any HTTP/1.1
+//! server, it also takes bodies sent with Transfer-Encoding: chunked. The chunks of each device
+//! are decoded with a sMfltIngestionDecoder and counted.
+//!
+//! Connections are accepted on a dedicated thread and handed to a pool of worker threads, each of
+//! which serves one connection at a time, so many devices can upload concurrently.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "memfault_ingestion_decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEMFAULT_INGESTION_SERVER_DEFAULT_NUM_WORKERS 4
+
+//! The largest request body accepted, before and after decompression
+#ifndef MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE
+#define MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE (1024 * 1024)
+#endif
+
+//! Connections which are idle for longer than this are closed to free up the worker
+#ifndef MEMFAULT_INGESTION_SERVER_IDLE_TIMEOUT_MS
+#define MEMFAULT_INGESTION_SERVER_IDLE_TIMEOUT_MS 5000
+#endif
+
+typedef struct {
+  //! The TCP port to listen on, 0 to let the OS pick one (see memfault_ingestion_server_get_port())
+  uint16_t port;
+  //! Listen on all interfaces rather than only on the loopback interface
+  bool listen_on_all_interfaces;
+  //! The number of worker threads, 0 for MEMFAULT_INGESTION_SERVER_DEFAULT_NUM_WORKERS
+  size_t num_workers;
+  //! Requests with a different Memfault-Project-Key are rejected with a 401. NULL accepts any key.
+  const char *project_key;
+  //! How long every response is held back for, to emulate the round trip time of a link
+  uint32_t response_delay_ms;
+  //! Called for every message decoded, may be NULL. The callback runs on a worker thread but is
+  //! never invoked concurrently for the same device.
+  MfltIngestionMessageCb message_cb;
+  void *cb_ctx;
+} sMfltIngestionServerConfig;
+
+typedef struct {
+  //! What was decoded from the chunks of the device
+  sMfltIngestionStats decoder;
+  //! Requests received and the number which were not answered with a 2xx status
+  uint64_t num_requests;
+  uint64_t num_rejected_requests;
+  //! Size of the request bodies, as sent over the wire (i.e before decompression)
+  uint64_t body_bytes;
+  //! Time, in milliseconds relative to the start of the server, of the first and last request
+  uint64_t first_request_ms;
+  uint64_t last_request_ms;
+} sMfltIngestionDeviceStats;
+
+typedef struct MfltIngestionServer sMfltIngestionServer;
+
+//! Starts listening and the threads of the server
+//!
+//! @return The server or NULL if it could not be started
+sMfltIngestionServer *memfault_ingestion_server_start(const sMfltIngestionServerConfig *config);
+
+//! Stops the threads of the server, closes all connections and frees the server
+void memfault_ingestion_server_stop(sMfltIngestionServer *server);
+
+//! @return the TCP port the server listens on
+uint16_t memfault_ingestion_server_get_port(const sMfltIngestionServer *server);
+
+//! Makes the server answer every valid request with 'status' instead of "202 Accepted", i.e to
+//! exercise the retry logic of a client. The body of the requests is discarded.
+//!
+//! @param status The status to respond with or 0 to go back to accepting data
+//! @param retry_after_s The value of the "Retry-After" header or 0 to leave it out
+void memfault_ingestion_server_set_response(sMfltIngestionServer *server, uint32_t status,
+                                            uint32_t retry_after_s);
+
+//! @return true and populates 'stats_out' if the server has received data from the device
+bool memfault_ingestion_server_get_device_stats(sMfltIngestionServer *server,
+                                                const char *device_serial,
+                                                sMfltIngestionDeviceStats *stats_out);
+
+//! Sums up the stats of all devices
+//!
+//! @param[out] num_devices_out The number of devices which have sent data, may be NULL
+void memfault_ingestion_server_get_total_stats(sMfltIngestionServer *server,
+                                               sMfltIngestionDeviceStats *stats_out,
+                                               size_t *num_devices_out);
+
+//! Writes a table of the per device and aggregate counters and throughput to 'out'
+void memfault_ingestion_server_print_report(sMfltIngestionServer *server, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
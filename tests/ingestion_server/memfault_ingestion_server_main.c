@@ -0,0 +1,174 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Command line front end for the ingestion stand-in server and its CoAP counterpart. Runs until
+//! interrupted and prints the throughput report periodically and on exit.
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "memfault_coap_ingestion_server.h"
+#include "memfault_ingestion_server.h"
+#include "memfault_mqtt_ingestion_server.h"
+
+static volatile sig_atomic_t s_stop;
+
+static void prv_handle_signal(int signum) {
+  (void)signum;
+  s_stop = 1;
+}
+
+static void prv_log_message(const char *device_serial, const sMfltIngestionMessage *msg,
+                            void *ctx) {
+  (void)ctx;
+  if (msg->type == kMfltIngestionMsgType_Coredump) {
+    printf("%s: coredump, %zu bytes%s, %zu blocks, %zu bytes of memory, reason 0x%" PRIx32 "\n",
+           device_serial, msg->data_len, msg->rle ? " (rle)" : "", msg->coredump_num_blocks,
+           msg->coredump_memory_bytes, msg->coredump_trace_reason);
+  } else {
+    printf("%s: event type %d, %zu bytes\n", device_serial, (int)msg->event_type, msg->data_len);
+  }
+}
+
+static void prv_usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-p port] [-u coap_port] [-q mqtt_port] [-j num_workers]\n"
+          "          [-k project_key] [-r report_interval_s] [-a] [-v]\n"
+          "  -p  TCP port to listen on (default 8080, 0 picks a free port)\n"
+          "  -u  also accept CoAP uploads on this UDP port (i.e 5683)\n"
+          "  -q  also accept MQTT PUBLISHes to memfault/<device_serial>/chunks on this TCP port\n"
+          "      (i.e 1883)\n"
+          "  -j  number of worker threads (default %d)\n"
+          "  -k  only accept requests with this Memfault-Project-Key\n"
+          "  -r  print the report every report_interval_s seconds (default 0, only on exit)\n"
+          "  -a  listen on all interfaces instead of only on localhost\n"
+          "  -v  print every message decoded\n",
+          prog, MEMFAULT_INGESTION_SERVER_DEFAULT_NUM_WORKERS);
+}
+
+int main(int argc, char *argv[]) {
+  sMfltIngestionServerConfig config = {
+    .port = 8080,
+  };
+  unsigned long report_interval_s = 0;
+  long coap_port = -1;
+  long mqtt_port = -1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:u:q:j:k:r:avh")) != -1) {
+    switch (opt) {
+      case 'p':
+        config.port = (uint16_t)strtoul(optarg, NULL, 10);
+        break;
+      case 'u':
+        coap_port = (long)strtoul(optarg, NULL, 10);
+        break;
+      case 'q':
+        mqtt_port = (long)strtoul(optarg, NULL, 10);
+        break;
+      case 'j':
+        config.num_workers = strtoul(optarg, NULL, 10);
+        break;
+      case 'k':
+        config.project_key = optarg;
+        break;
+      case 'r':
+        report_interval_s = strtoul(optarg, NULL, 10);
+        break;
+      case 'a':
+        config.listen_on_all_interfaces = true;
+        break;
+      case 'v':
+        config.message_cb = prv_log_message;
+        break;
+      default:
+        prv_usage(argv[0]);
+        return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  sMfltIngestionServer *server = memfault_ingestion_server_start(&config);
+  if (server == NULL) {
+    fprintf(stderr, "Failed to start the server on port %d\n", (int)config.port);
+    return EXIT_FAILURE;
+  }
+  printf("Listening on port %d, POST to /api/v0/chunks/<device_serial>\n",
+         (int)memfault_ingestion_server_get_port(server));
+
+  sMfltCoapIngestionServer *coap_server = NULL;
+  if (coap_port >= 0) {
+    const sMfltCoapIngestionServerConfig coap_config = {
+      .port = (uint16_t)coap_port,
+      .listen_on_all_interfaces = config.listen_on_all_interfaces,
+      .project_key = config.project_key,
+      .message_cb = config.message_cb,
+    };
+    coap_server = memfault_coap_ingestion_server_start(&coap_config);
+    if (coap_server == NULL) {
+      fprintf(stderr, "Failed to start the CoAP server on port %d\n", (int)coap_port);
+      memfault_ingestion_server_stop(server);
+      return EXIT_FAILURE;
+    }
+    printf("Listening on UDP port %d, CoAP POST to /chunks/<device_serial>\n",
+           (int)memfault_coap_ingestion_server_get_port(coap_server));
+  }
+
+  sMfltMqttIngestionServer *mqtt_server = NULL;
+  if (mqtt_port >= 0) {
+    const sMfltMqttIngestionServerConfig mqtt_config = {
+      .port = (uint16_t)mqtt_port,
+      .listen_on_all_interfaces = config.listen_on_all_interfaces,
+      .message_cb = config.message_cb,
+    };
+    mqtt_server = memfault_mqtt_ingestion_server_start(&mqtt_config);
+    if (mqtt_server == NULL) {
+      fprintf(stderr, "Failed to start the MQTT server on port %d\n", (int)mqtt_port);
+      if (coap_server != NULL) {
+        memfault_coap_ingestion_server_stop(coap_server);
+      }
+      memfault_ingestion_server_stop(server);
+      return EXIT_FAILURE;
+    }
+    printf("Listening on port %d, MQTT PUBLISH to memfault/<device_serial>/chunks\n",
+           (int)memfault_mqtt_ingestion_server_get_port(mqtt_server));
+  }
+  fflush(stdout);
+
+  signal(SIGINT, prv_handle_signal);
+  signal(SIGTERM, prv_handle_signal);
+
+  unsigned long elapsed_s = 0;
+  while (!s_stop) {
+    sleep(1);
+    elapsed_s++;
+    if ((report_interval_s != 0) && ((elapsed_s % report_interval_s) == 0)) {
+      memfault_ingestion_server_print_report(server, stdout);
+      if (coap_server != NULL) {
+        memfault_coap_ingestion_server_print_report(coap_server, stdout);
+      }
+      if (mqtt_server != NULL) {
+        memfault_mqtt_ingestion_server_print_report(mqtt_server, stdout);
+      }
+      fflush(stdout);
+    }
+  }
+
+  memfault_ingestion_server_print_report(server, stdout);
+  if (coap_server != NULL) {
+    memfault_coap_ingestion_server_print_report(coap_server, stdout);
+    memfault_coap_ingestion_server_stop(coap_server);
+  }
+  if (mqtt_server != NULL) {
+    memfault_mqtt_ingestion_server_print_report(mqtt_server, stdout);
+    memfault_mqtt_ingestion_server_stop(mqtt_server);
+  }
+  memfault_ingestion_server_stop(server);
+  return EXIT_SUCCESS;
+}
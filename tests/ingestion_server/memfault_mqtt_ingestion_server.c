@@ -0,0 +1,551 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! See header for more details
+
+#include "memfault_mqtt_ingestion_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memfault_ingestion_server.h"
+
+#define DEFAULT_TOPIC_PREFIX "memfault"
+#define CHUNKS_TOPIC_LEVEL "chunks"
+
+#define MAX_DEVICE_SERIAL_LEN 64
+#define MAX_CLIENTS 32
+//! PUBACKs held back per connection. Beyond that they are sent right away.
+#define MAX_HELD_PUBACKS 256
+
+//! How often the thread checks whether the server is being stopped
+#define STOP_POLL_INTERVAL_MS 100
+
+// Control packet types, see MQTT 3.1.1 section 2.2.1
+#define MQTT_CONNECT 1
+#define MQTT_CONNACK 2
+#define MQTT_PUBLISH 3
+#define MQTT_PUBACK 4
+#define MQTT_PINGREQ 12
+#define MQTT_PINGRESP 13
+#define MQTT_DISCONNECT 14
+
+typedef struct MfltMqttIngestionDevice {
+  struct MfltMqttIngestionDevice *next;
+  char device_serial[MAX_DEVICE_SERIAL_LEN + 1];
+  sMfltIngestionDecoder decoder;
+  sMfltMqttIngestionDeviceStats stats;
+} sMfltMqttIngestionDevice;
+
+typedef struct {
+  uint64_t due_ms;
+  uint16_t packet_id;
+} sHeldPuback;
+
+typedef struct {
+  int fd;
+  bool connected;
+  uint8_t *rx_buf;
+  size_t rx_buf_size;
+  size_t rx_len;
+
+  //! PUBACKs held back to emulate the latency of the link, oldest first
+  sHeldPuback held[MAX_HELD_PUBACKS];
+  size_t held_head;
+  size_t num_held;
+} sMqttClient;
+
+struct MfltMqttIngestionServer {
+  sMfltMqttIngestionServerConfig config;
+  const char *topic_prefix;
+  int listen_fd;
+  uint16_t port;
+  volatile bool stop;
+  pthread_t thread;
+  sMqttClient clients[MAX_CLIENTS];
+
+  //! Protects everything below
+  pthread_mutex_t lock;
+  sMfltMqttIngestionDevice *devices;
+  uint32_t publishes_until_disconnect;
+  uint64_t num_connections;
+};
+
+static uint64_t prv_time_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000) + ((uint64_t)ts.tv_nsec / 1000000);
+}
+
+//
+// Devices
+//
+
+//! Must be called with the server lock held
+static sMfltMqttIngestionDevice *prv_get_device(sMfltMqttIngestionServer *server,
+                                                const char *device_serial) {
+  sMfltMqttIngestionDevice *device = server->devices;
+  while ((device != NULL) && (strcmp(device->device_serial, device_serial) != 0)) {
+    device = device->next;
+  }
+
+  if (device == NULL) {
+    device = calloc(1, sizeof(*device));
+    if (device != NULL) {
+      snprintf(device->device_serial, sizeof(device->device_serial), "%s", device_serial);
+      memfault_ingestion_decoder_init(&device->decoder, device->device_serial,
+                                      server->config.message_cb, server->config.cb_ctx);
+      device->next = server->devices;
+      server->devices = device;
+    }
+  }
+  return device;
+}
+
+static void prv_free_devices(sMfltMqttIngestionServer *server) {
+  sMfltMqttIngestionDevice *device = server->devices;
+  while (device != NULL) {
+    sMfltMqttIngestionDevice *next = device->next;
+    memfault_ingestion_decoder_deinit(&device->decoder);
+    free(device);
+    device = next;
+  }
+  server->devices = NULL;
+}
+
+//
+// Connections
+//
+
+static void prv_close_client(sMqttClient *client) {
+  close(client->fd);
+  free(client->rx_buf);
+  *client = (sMqttClient) {
+    .fd = -1,
+  };
+}
+
+static bool prv_send(sMqttClient *client, const uint8_t *buf, size_t len) {
+  while (len > 0) {
+    const ssize_t rv = send(client->fd, buf, len, MSG_NOSIGNAL);
+    if (rv <= 0) {
+      if ((rv < 0) && (errno == EINTR)) {
+        continue;
+      }
+      return false;
+    }
+    buf += rv;
+    len -= (size_t)rv;
+  }
+  return true;
+}
+
+static bool prv_send_puback(sMqttClient *client, uint16_t packet_id) {
+  const uint8_t puback[] = {
+    MQTT_PUBACK << 4, 2, (uint8_t)(packet_id >> 8), (uint8_t)(packet_id & 0xff),
+  };
+  return prv_send(client, puback, sizeof(puback));
+}
+
+//! Sends the PUBACKs which are due
+static bool prv_send_due_pubacks(sMqttClient *client, uint64_t now_ms) {
+  while ((client->num_held != 0) && (client->held[client->held_head].due_ms <= now_ms)) {
+    const uint16_t packet_id = client->held[client->held_head].packet_id;
+    client->held_head = (client->held_head + 1) % MAX_HELD_PUBACKS;
+    client->num_held--;
+    if (!prv_send_puback(client, packet_id)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool prv_queue_puback(sMfltMqttIngestionServer *server, sMqttClient *client,
+                             uint16_t packet_id) {
+  if ((server->config.puback_delay_ms == 0) || (client->num_held == MAX_HELD_PUBACKS)) {
+    return prv_send_puback(client, packet_id);
+  }
+  const size_t idx = (client->held_head + client->num_held) % MAX_HELD_PUBACKS;
+  client->held[idx] = (sHeldPuback) {
+    .due_ms = prv_time_ms() + server->config.puback_delay_ms,
+    .packet_id = packet_id,
+  };
+  client->num_held++;
+  return true;
+}
+
+//! Extracts the device serial from "<topic_prefix>/<device_serial>/chunks"
+static bool prv_parse_topic(const sMfltMqttIngestionServer *server, const uint8_t *topic,
+                            size_t topic_len, char *device_serial) {
+  const size_t prefix_len = strlen(server->topic_prefix);
+  const size_t suffix_len = strlen("/" CHUNKS_TOPIC_LEVEL);
+  if ((topic_len <= (prefix_len + 1 + suffix_len)) ||
+      (memcmp(topic, server->topic_prefix, prefix_len) != 0) || (topic[prefix_len] != '/') ||
+      (memcmp(&topic[topic_len - suffix_len], "/" CHUNKS_TOPIC_LEVEL, suffix_len) != 0)) {
+    return false;
+  }
+
+  const size_t serial_len = topic_len - prefix_len - 1 - suffix_len;
+  if ((serial_len > MAX_DEVICE_SERIAL_LEN) ||
+      (memchr(&topic[prefix_len + 1], '/', serial_len) != NULL)) {
+    return false;
+  }
+  memcpy(device_serial, &topic[prefix_len + 1], serial_len);
+  device_serial[serial_len] = '\0';
+  return true;
+}
+
+//! @return false if the connection must be closed
+static bool prv_handle_publish(sMfltMqttIngestionServer *server, sMqttClient *client,
+                               uint8_t flags, const uint8_t *body, size_t body_len,
+                               size_t packet_len) {
+  const uint8_t qos = (flags >> 1) & 0x3;
+  if ((qos > 1) || (body_len < 2)) {
+    // QoS 2 isn't supported by the stand-in
+    return false;
+  }
+  const size_t topic_len = ((size_t)body[0] << 8) | body[1];
+  size_t offset = 2 + topic_len;
+  uint16_t packet_id = 0;
+  if (qos == 1) {
+    if ((offset + 2) > body_len) {
+      return false;
+    }
+    packet_id = (uint16_t)((body[offset] << 8) | body[offset + 1]);
+    offset += 2;
+  }
+  if (offset > body_len) {
+    return false;
+  }
+
+  pthread_mutex_lock(&server->lock);
+  if (server->publishes_until_disconnect != 0) {
+    if (--server->publishes_until_disconnect == 0) {
+      // the link goes down, this PUBLISH and the PUBACKs held back are lost
+      pthread_mutex_unlock(&server->lock);
+      return false;
+    }
+  }
+
+  char device_serial[MAX_DEVICE_SERIAL_LEN + 1];
+  if (prv_parse_topic(server, &body[2], topic_len, device_serial)) {
+    sMfltMqttIngestionDevice *device = prv_get_device(server, device_serial);
+    if (device != NULL) {
+      device->stats.num_publishes++;
+      device->stats.rx_bytes += packet_len;
+      memfault_ingestion_decoder_feed_chunk(&device->decoder, &body[offset], body_len - offset);
+    }
+  }
+  pthread_mutex_unlock(&server->lock);
+
+  return (qos == 0) || prv_queue_puback(server, client, packet_id);
+}
+
+//! Handles the complete packets received on the connection
+//!
+//! @return false if the connection must be closed
+static bool prv_handle_packets(sMfltMqttIngestionServer *server, sMqttClient *client) {
+  size_t offset = 0;
+  while (offset < client->rx_len) {
+    const uint8_t *packet = &client->rx_buf[offset];
+    const size_t avail = client->rx_len - offset;
+
+    // fixed header: type and flags then the Remaining Length, a varint of up to 4 bytes
+    size_t remaining_len = 0;
+    size_t hdr_len = 1;
+    bool complete_hdr = false;
+    while ((hdr_len < avail) && (hdr_len <= 4)) {
+      const uint8_t byte = packet[hdr_len];
+      remaining_len |= (size_t)(byte & 0x7f) << (7 * (hdr_len - 1));
+      hdr_len++;
+      if ((byte & 0x80) == 0) {
+        complete_hdr = true;
+        break;
+      }
+    }
+    if (!complete_hdr) {
+      if (hdr_len > 4) {
+        return false;
+      }
+      break;
+    }
+    if ((hdr_len + remaining_len) > MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE) {
+      return false;
+    }
+    if ((hdr_len + remaining_len) > avail) {
+      break;
+    }
+
+    const uint8_t type = packet[0] >> 4;
+    const uint8_t *body = &packet[hdr_len];
+    const size_t packet_len = hdr_len + remaining_len;
+    offset += packet_len;
+
+    if (!client->connected && (type != MQTT_CONNECT)) {
+      return false;
+    }
+    bool keep_open = true;
+    switch (type) {
+      case MQTT_CONNECT: {
+        // session present: 0, return code: accepted
+        const uint8_t connack[] = { MQTT_CONNACK << 4, 2, 0, 0 };
+        client->connected = true;
+        keep_open = prv_send(client, connack, sizeof(connack));
+        break;
+      }
+      case MQTT_PUBLISH:
+        keep_open = prv_handle_publish(server, client, packet[0] & 0xf, body, remaining_len,
+                                       packet_len);
+        break;
+      case MQTT_PINGREQ: {
+        const uint8_t pingresp[] = { MQTT_PINGRESP << 4, 0 };
+        keep_open = prv_send(client, pingresp, sizeof(pingresp));
+        break;
+      }
+      case MQTT_DISCONNECT:
+        keep_open = false;
+        break;
+      default:
+        // nothing else is expected from a publisher
+        break;
+    }
+    if (!keep_open) {
+      return false;
+    }
+  }
+
+  memmove(client->rx_buf, &client->rx_buf[offset], client->rx_len - offset);
+  client->rx_len -= offset;
+  return true;
+}
+
+//! @return false if the connection must be closed
+static bool prv_read_client(sMfltMqttIngestionServer *server, sMqttClient *client) {
+  if ((client->rx_buf_size - client->rx_len) < 4096) {
+    const size_t new_size = client->rx_buf_size + 16 * 1024;
+    if (new_size > (2 * MEMFAULT_INGESTION_SERVER_MAX_BODY_SIZE)) {
+      return false;
+    }
+    uint8_t *rx_buf = realloc(client->rx_buf, new_size);
+    if (rx_buf == NULL) {
+      return false;
+    }
+    client->rx_buf = rx_buf;
+    client->rx_buf_size = new_size;
+  }
+
+  const ssize_t rv = recv(client->fd, &client->rx_buf[client->rx_len],
+                          client->rx_buf_size - client->rx_len, 0);
+  if (rv <= 0) {
+    return (rv < 0) && (errno == EINTR);
+  }
+  client->rx_len += (size_t)rv;
+  return prv_handle_packets(server, client);
+}
+
+static void prv_accept_client(sMfltMqttIngestionServer *server) {
+  const int fd = accept(server->listen_fd, NULL, NULL);
+  if (fd < 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < MAX_CLIENTS; i++) {
+    sMqttClient *client = &server->clients[i];
+    if (client->fd < 0) {
+      // PUBACKs are tiny, don't let Nagle hold them back
+      const int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      client->fd = fd;
+      pthread_mutex_lock(&server->lock);
+      server->num_connections++;
+      pthread_mutex_unlock(&server->lock);
+      return;
+    }
+  }
+  close(fd);
+}
+
+static void *prv_server_thread(void *arg) {
+  sMfltMqttIngestionServer *server = arg;
+  while (!server->stop) {
+    struct pollfd poll_fds[MAX_CLIENTS + 1];
+    sMqttClient *polled[MAX_CLIENTS];
+    size_t num_fds = 0;
+    poll_fds[num_fds++] = (struct pollfd) { .fd = server->listen_fd, .events = POLLIN };
+
+    // wake up for the next PUBACK due
+    const uint64_t now_ms = prv_time_ms();
+    uint64_t timeout_ms = STOP_POLL_INTERVAL_MS;
+    for (size_t i = 0; i < MAX_CLIENTS; i++) {
+      sMqttClient *client = &server->clients[i];
+      if (client->fd < 0) {
+        continue;
+      }
+      if (client->num_held != 0) {
+        const uint64_t due_ms = client->held[client->held_head].due_ms;
+        const uint64_t wait_ms = (due_ms <= now_ms) ? 0 : (due_ms - now_ms);
+        timeout_ms = (wait_ms < timeout_ms) ? wait_ms : timeout_ms;
+      }
+      polled[num_fds - 1] = client;
+      poll_fds[num_fds++] = (struct pollfd) { .fd = client->fd, .events = POLLIN };
+    }
+
+    if (poll(poll_fds, num_fds, (int)timeout_ms) < 0) {
+      continue;
+    }
+    if (poll_fds[0].revents & POLLIN) {
+      prv_accept_client(server);
+    }
+    for (size_t i = 1; i < num_fds; i++) {
+      sMqttClient *client = polled[i - 1];
+      bool keep_open = true;
+      if (poll_fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        keep_open = prv_read_client(server, client);
+      }
+      if (keep_open) {
+        keep_open = prv_send_due_pubacks(client, prv_time_ms());
+      }
+      if (!keep_open) {
+        prv_close_client(client);
+      }
+    }
+  }
+  return NULL;
+}
+
+static int prv_listen(sMfltMqttIngestionServer *server) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  const int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port = htons(server->config.port),
+    .sin_addr.s_addr = htonl(server->config.listen_on_all_interfaces ? INADDR_ANY :
+                                                                        INADDR_LOOPBACK),
+  };
+  socklen_t addr_len = sizeof(addr);
+  if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (listen(fd, 16) != 0) ||
+      (getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0)) {
+    close(fd);
+    return -1;
+  }
+  server->port = ntohs(addr.sin_port);
+  return fd;
+}
+
+sMfltMqttIngestionServer *memfault_mqtt_ingestion_server_start(
+    const sMfltMqttIngestionServerConfig *config) {
+  sMfltMqttIngestionServer *server = calloc(1, sizeof(*server));
+  if (server == NULL) {
+    return NULL;
+  }
+  server->config = *config;
+  server->topic_prefix = (config->topic_prefix != NULL) ? config->topic_prefix :
+                                                          DEFAULT_TOPIC_PREFIX;
+  for (size_t i = 0; i < MAX_CLIENTS; i++) {
+    server->clients[i].fd = -1;
+  }
+  pthread_mutex_init(&server->lock, NULL);
+
+  server->listen_fd = prv_listen(server);
+  if ((server->listen_fd < 0) ||
+      (pthread_create(&server->thread, NULL, prv_server_thread, server) != 0)) {
+    if (server->listen_fd >= 0) {
+      close(server->listen_fd);
+    }
+    pthread_mutex_destroy(&server->lock);
+    free(server);
+    return NULL;
+  }
+  return server;
+}
+
+void memfault_mqtt_ingestion_server_stop(sMfltMqttIngestionServer *server) {
+  server->stop = true;
+  pthread_join(server->thread, NULL);
+  for (size_t i = 0; i < MAX_CLIENTS; i++) {
+    if (server->clients[i].fd >= 0) {
+      prv_close_client(&server->clients[i]);
+    }
+  }
+  close(server->listen_fd);
+  prv_free_devices(server);
+  pthread_mutex_destroy(&server->lock);
+  free(server);
+}
+
+uint16_t memfault_mqtt_ingestion_server_get_port(const sMfltMqttIngestionServer *server) {
+  return server->port;
+}
+
+void memfault_mqtt_ingestion_server_disconnect_after(sMfltMqttIngestionServer *server,
+                                                     uint32_t num_publishes) {
+  pthread_mutex_lock(&server->lock);
+  server->publishes_until_disconnect = num_publishes;
+  pthread_mutex_unlock(&server->lock);
+}
+
+uint64_t memfault_mqtt_ingestion_server_get_num_connections(sMfltMqttIngestionServer *server) {
+  pthread_mutex_lock(&server->lock);
+  const uint64_t num_connections = server->num_connections;
+  pthread_mutex_unlock(&server->lock);
+  return num_connections;
+}
+
+//! Must be called with the server lock held
+static void prv_snapshot_device_stats(const sMfltMqttIngestionDevice *device,
+                                      sMfltMqttIngestionDeviceStats *stats_out) {
+  *stats_out = device->stats;
+  stats_out->decoder = device->decoder.stats;
+}
+
+bool memfault_mqtt_ingestion_server_get_device_stats(sMfltMqttIngestionServer *server,
+                                                     const char *device_serial,
+                                                     sMfltMqttIngestionDeviceStats *stats_out) {
+  pthread_mutex_lock(&server->lock);
+  const sMfltMqttIngestionDevice *device = server->devices;
+  while ((device != NULL) && (strcmp(device->device_serial, device_serial) != 0)) {
+    device = device->next;
+  }
+  if (device != NULL) {
+    prv_snapshot_device_stats(device, stats_out);
+  }
+  pthread_mutex_unlock(&server->lock);
+  return device != NULL;
+}
+
+void memfault_mqtt_ingestion_server_print_report(sMfltMqttIngestionServer *server, FILE *out) {
+  fprintf(out, "%-24s %9s %9s %7s %11s\n", "device (mqtt)", "publishes", "messages", "errors",
+          "rx bytes");
+
+  pthread_mutex_lock(&server->lock);
+  for (sMfltMqttIngestionDevice *device = server->devices; device != NULL; device = device->next) {
+    sMfltMqttIngestionDeviceStats stats;
+    prv_snapshot_device_stats(device, &stats);
+    const sMfltIngestionStats *d = &stats.decoder;
+    const uint64_t num_errors = d->num_framing_errors + d->num_dropped_messages +
+        d->num_crc_errors + d->num_decode_errors;
+    fprintf(out, "%-24s %9" PRIu64 " %9" PRIu64 " %7" PRIu64 " %11" PRIu64 "\n",
+            device->device_serial, stats.num_publishes, d->num_messages, num_errors,
+            stats.rx_bytes);
+  }
+  fprintf(out, "connections: %" PRIu64 "\n", server->num_connections);
+  pthread_mutex_unlock(&server->lock);
+}
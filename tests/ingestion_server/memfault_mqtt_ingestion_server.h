@@ -0,0 +1,90 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! A local stand-in for an MQTT broker bridged to the Memfault chunks endpoint, the counterpart
+//! of memfault/mqtt/publish_upload.h. It is used to test MQTT uploads and to compare their
+//! throughput with the HTTP path.
+//!
+//! The server speaks enough MQTT 3.1.1 for a publisher: CONNECT, PUBLISH at QoS 0 and 1, PINGREQ
+//! and DISCONNECT. Every PUBLISH to "<topic_prefix>/<device_serial>/chunks" carries one chunk,
+//! which is decoded with the sMfltIngestionDecoder of the device. PUBLISHes to other topics are
+//! acknowledged and otherwise ignored.
+//!
+//! PUBACKs can be held back for a while (see puback_delay_ms) to emulate the round trip time of a
+//! real link, and connections can be dropped on purpose (see
+//! memfault_mqtt_ingestion_server_disconnect_after()) to exercise the recovery of a client.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "memfault_ingestion_decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  //! The TCP port to listen on, 0 to let the OS pick one (see
+  //! memfault_mqtt_ingestion_server_get_port())
+  uint16_t port;
+  //! Listen on all interfaces rather than only on the loopback interface
+  bool listen_on_all_interfaces;
+  //! The first levels of the chunks topics, NULL for "memfault"
+  const char *topic_prefix;
+  //! How long every PUBACK is held back for, to emulate the round trip time of a link. The
+  //! PUBACKs of the PUBLISHes in flight are held back concurrently.
+  uint32_t puback_delay_ms;
+  //! Called for every message decoded, may be NULL. The callback runs on the server thread.
+  MfltIngestionMessageCb message_cb;
+  void *cb_ctx;
+} sMfltMqttIngestionServerConfig;
+
+typedef struct {
+  //! What was decoded from the chunks of the device
+  sMfltIngestionStats decoder;
+  //! PUBLISH packets received on the chunks topic of the device and their total size
+  uint64_t num_publishes;
+  uint64_t rx_bytes;
+} sMfltMqttIngestionDeviceStats;
+
+typedef struct MfltMqttIngestionServer sMfltMqttIngestionServer;
+
+//! Starts listening and the thread of the server
+//!
+//! @return The server or NULL if it could not be started
+sMfltMqttIngestionServer *memfault_mqtt_ingestion_server_start(
+    const sMfltMqttIngestionServerConfig *config);
+
+//! Stops the thread of the server, closes all connections and frees the server
+void memfault_mqtt_ingestion_server_stop(sMfltMqttIngestionServer *server);
+
+//! @return the TCP port the server listens on
+uint16_t memfault_mqtt_ingestion_server_get_port(const sMfltMqttIngestionServer *server);
+
+//! Drops the connection a PUBLISH arrives on once 'num_publishes' more have been received, as if
+//! the link went down. The PUBLISH which triggers it is discarded and PUBACKs still held back
+//! are never sent. 0 cancels a pending disconnection.
+void memfault_mqtt_ingestion_server_disconnect_after(sMfltMqttIngestionServer *server,
+                                                     uint32_t num_publishes);
+
+//! @return the number of connections the server has accepted
+uint64_t memfault_mqtt_ingestion_server_get_num_connections(sMfltMqttIngestionServer *server);
+
+//! @return true and populates 'stats_out' if the server has received data from the device
+bool memfault_mqtt_ingestion_server_get_device_stats(sMfltMqttIngestionServer *server,
+                                                     const char *device_serial,
+                                                     sMfltMqttIngestionDeviceStats *stats_out);
+
+//! Writes a table of the per device counters to 'out'
+void memfault_mqtt_ingestion_server_print_report(sMfltMqttIngestionServer *server, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,52 @@
+COMPONENT_NAME=memfault_benchmarks
+
+# Built with optimizations and without instrumentation, see MakefileWorkerOverrides.mk
+MEMFAULT_BENCHMARK_BUILD=1
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_boot_profile.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_packetizer.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source_cache.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_event_storage.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_serializer_helper.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_response_parser.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_utils.c \
+  $(MFLT_COMPONENTS_DIR)/metrics/src/memfault_metrics.c \
+  $(MFLT_COMPONENTS_DIR)/metrics/src/memfault_metrics_serializer.c \
+  $(MFLT_COMPONENTS_DIR)/mqtt/src/memfault_mqtt_publish_upload.c \
+  $(MFLT_COMPONENTS_DIR)/panics/src/memfault_coredump.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_chunk_transport.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_circular_buffer.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_crc16_ccitt.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_deflate.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_minimal_cbor.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_rle.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_varint.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_ingestion_decoder.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_ingestion_server.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_mqtt_ingestion_server.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_coredump_storage.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_debug_log.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_locking.c
+
+# The RLE encoder is linked as an object rather than from the library of SRC_FILES. Otherwise the
+# weak stubs in memfault_data_packetizer.c satisfy its symbols and it is never pulled in.
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_benchmarks.cpp \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source_rle.c \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+MEMFAULT_EXTRA_INC_PATHS += \
+  -I$(MFLT_TEST_FAKE_DIR) \
+  -I$(MFLT_TEST_ROOT)/ingestion_server
+
+CPPUTEST_CPPFLAGS += \
+  -DMEMFAULT_BENCHMARK_RESULTS_PATH=\"$(BUILD_DIR)/$(COMPONENT_NAME)/benchmark_results.json\"
+
+CPPUTEST_LDFLAGS += -lpthread -lz
+
+include $(CPPUTEST_MAKFILE_INFRA)
@@ -0,0 +1,33 @@
+COMPONENT_NAME=memfault_coap_ingestion_server
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/coap/src/memfault_coap_block_upload.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_packetizer.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_utils.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_chunk_transport.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_crc16_ccitt.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_varint.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_coap_ingestion_server.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_ingestion_decoder.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_event_data_source.cpp \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_debug_log.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_time.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_coap_ingestion_server.cpp \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+MEMFAULT_EXTRA_INC_PATHS += \
+  -I$(MFLT_TEST_ROOT)/ingestion_server
+
+# Room for 1024 byte blocks, i.e a datagram which fits in the 1280 byte IPv6 MTU, so the server
+# can pick any block size. Retransmissions are kept quick.
+CPPUTEST_CPPFLAGS += -DMEMFAULT_COAP_UPLOAD_TX_BUF_SIZE=1152 -DMEMFAULT_COAP_ACK_TIMEOUT_MS=20
+
+CPPUTEST_LDFLAGS += -lpthread -lz
+
+include $(CPPUTEST_MAKFILE_INFRA)
@@ -0,0 +1,12 @@
+COMPONENT_NAME=memfault_crash_loop_policy
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/panics/src/memfault_crash_loop_policy.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_boot_profile.c \
+  $(MFLT_COMPONENTS_DIR)/panics/src/memfault_ram_reboot_info_tracking.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_debug_log.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_crash_loop_policy.cpp
+
+include $(CPPUTEST_MAKFILE_INFRA)
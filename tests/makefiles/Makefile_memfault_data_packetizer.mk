@@ -1,7 +1,8 @@
 COMPONENT_NAME=memfault_data_packetizer
 
 SRC_FILES = \
-  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_packetizer.c
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_packetizer.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source.c
 
 MOCK_AND_FAKE_SRC_FILES += \
   $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_debug_log.c
@@ -0,0 +1,13 @@
+COMPONENT_NAME=memfault_data_source_cache
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source_cache.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source_rle.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_rle.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_varint.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_data_source_cache.cpp
+
+include $(CPPUTEST_MAKFILE_INFRA)
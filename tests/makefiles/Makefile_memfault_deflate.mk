@@ -0,0 +1,12 @@
+COMPONENT_NAME=memfault_deflate
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_deflate.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_deflate.cpp
+
+# zlib is used as the reference decoder
+CPPUTEST_LDFLAGS += -lz
+
+include $(CPPUTEST_MAKFILE_INFRA)
@@ -2,15 +2,18 @@ COMPONENT_NAME=memfault_demo_cli
 
 SRC_FILES = \
   $(MFLT_COMPONENTS_DIR)/demo/src/memfault_demo_cli_print_chunk.c \
-  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_client.c
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_client.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_retry_policy.c
 
 MOCK_AND_FAKE_SRC_FILES += \
   $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_packetizer.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source.c \
   $(MFLT_COMPONENTS_DIR)/util/src/memfault_chunk_transport.c \
   $(MFLT_COMPONENTS_DIR)/util/src/memfault_crc16_ccitt.c \
   $(MFLT_COMPONENTS_DIR)/util/src/memfault_varint.c \
   $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c \
   $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_http_client.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_time.c \
   $(MFLT_TEST_MOCK_DIR)/mock_memfault_coredump.cpp \
   $(MFLT_TEST_MOCK_DIR)/mock_memfault_platform_debug_log.cpp \
 
@@ -0,0 +1,17 @@
+COMPONENT_NAME=memfault_esp_http_client_buffer
+
+SRC_FILES = \
+  $(MFLT_PORTS_DIR)/esp_idf/memfault/common/memfault_platform_http_client_buffer.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_debug_log.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_locking.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_esp_http_client_buffer.cpp \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+MEMFAULT_EXTRA_INC_PATHS += \
+  -I$(MFLT_PORTS_DIR)/esp_idf/memfault/include
+
+include $(CPPUTEST_MAKFILE_INFRA)
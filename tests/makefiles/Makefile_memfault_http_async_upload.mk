@@ -0,0 +1,17 @@
+COMPONENT_NAME=memfault_http_async_upload
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_async_upload.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_response_parser.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_retry_policy.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_utils.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_debug_log.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_http_async_upload.cpp \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+include $(CPPUTEST_MAKFILE_INFRA)
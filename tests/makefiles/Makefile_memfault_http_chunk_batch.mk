@@ -0,0 +1,20 @@
+COMPONENT_NAME=memfault_http_chunk_batch
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_chunk_batch.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_utils.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_deflate.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_http_chunk_batch.cpp \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+# zlib stands in for the decoder of compressed batches on the server
+CPPUTEST_LDFLAGS += -lz
+
+CPPUTEST_CPPFLAGS += -DMEMFAULT_HTTP_CHUNK_BATCH_ENABLED=1
+
+include $(CPPUTEST_MAKFILE_INFRA)
@@ -0,0 +1,17 @@
+COMPONENT_NAME=memfault_http_gateway
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_gateway.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_utils.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_circular_buffer.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_http_gateway.cpp \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+CPPUTEST_CPPFLAGS += -DMEMFAULT_HTTP_GATEWAY_ENABLED=1
+
+include $(CPPUTEST_MAKFILE_INFRA)
@@ -0,0 +1,14 @@
+COMPONENT_NAME=memfault_http_response_parser
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_response_parser.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_utils.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_http_response_parser.cpp \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+include $(CPPUTEST_MAKFILE_INFRA)
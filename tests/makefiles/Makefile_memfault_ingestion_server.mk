@@ -0,0 +1,18 @@
+COMPONENT_NAME=memfault_ingestion_server
+
+SRC_FILES = \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_ingestion_decoder.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_ingestion_server.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_chunk_transport.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_crc16_ccitt.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_varint.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_ingestion_server.cpp
+
+MEMFAULT_EXTRA_INC_PATHS += \
+  -I$(MFLT_TEST_ROOT)/ingestion_server
+
+CPPUTEST_LDFLAGS += -lpthread -lz
+
+include $(CPPUTEST_MAKFILE_INFRA)
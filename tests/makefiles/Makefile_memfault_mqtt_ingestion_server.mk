@@ -0,0 +1,27 @@
+COMPONENT_NAME=memfault_mqtt_ingestion_server
+
+SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_packetizer.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_data_source.c \
+  $(MFLT_COMPONENTS_DIR)/mqtt/src/memfault_mqtt_publish_upload.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_chunk_transport.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_crc16_ccitt.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_varint.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_ingestion_decoder.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_mqtt_ingestion_server.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_event_data_source.cpp \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_debug_log.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_mqtt_ingestion_server.cpp \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+MEMFAULT_EXTRA_INC_PATHS += \
+  -I$(MFLT_TEST_ROOT)/ingestion_server
+
+CPPUTEST_LDFLAGS += -lpthread
+
+include $(CPPUTEST_MAKFILE_INFRA)
@@ -0,0 +1,44 @@
+COMPONENT_NAME=memfault_posix_port
+
+SRC_FILES = \
+  $(MFLT_PORTS_DIR)/posix/src/memfault_platform_coredump.c \
+  $(MFLT_PORTS_DIR)/posix/src/memfault_platform_file_storage.c \
+  $(MFLT_PORTS_DIR)/posix/src/memfault_platform_http_client.c \
+  $(MFLT_PORTS_DIR)/posix/src/memfault_platform_lock.c \
+  $(MFLT_PORTS_DIR)/posix/src/memfault_platform_metrics_timer.c \
+  $(MFLT_PORTS_DIR)/posix/src/memfault_posix_gateway.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_chunk_batch.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_gateway.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_response_parser.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_retry_policy.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_utils.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_circular_buffer.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_crc16_ccitt.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_deflate.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_varint.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_ingestion_decoder.c \
+  $(MFLT_TEST_ROOT)/ingestion_server/memfault_ingestion_server.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_debug_log.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_time.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_posix_port.cpp \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+MEMFAULT_EXTRA_INC_PATHS += \
+  -I$(MFLT_PORTS_DIR)/posix/include \
+  -I$(MFLT_PORTS_DIR)/posix/src \
+  -I$(MFLT_TEST_ROOT)/ingestion_server
+
+# heartbeats fire 100x faster than in real time and failed gateway uploads are retried quickly
+CPPUTEST_CPPFLAGS += -DMEMFAULT_POSIX_METRICS_TIMER_MS_PER_SEC=10 \
+  -DMEMFAULT_POSIX_GATEWAY_RETRY_DELAY_MS=10
+
+CPPUTEST_CPPFLAGS += -DMEMFAULT_HTTP_GATEWAY_ENABLED=1 -DMEMFAULT_HTTP_CHUNK_BATCH_ENABLED=1
+
+CPPUTEST_LDFLAGS += -lpthread -lz
+
+include $(CPPUTEST_MAKFILE_INFRA)
@@ -0,0 +1,32 @@
+COMPONENT_NAME=memfault_zephyr_http
+
+SRC_FILES = \
+  $(MFLT_PORTS_DIR)/zephyr/common/memfault_platform_http.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_retry_policy.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_http_utils.c \
+  $(MFLT_COMPONENTS_DIR)/http/src/memfault_root_certs_der.c \
+  $(MFLT_COMPONENTS_DIR)/metrics/src/memfault_metrics.c \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_serializer_helper.c \
+  $(MFLT_COMPONENTS_DIR)/util/src/memfault_minimal_cbor.c
+
+MOCK_AND_FAKE_SRC_FILES += \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_event_storage.cpp \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_debug_log.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_get_device_info.c \
+  $(MFLT_TEST_FAKE_DIR)/fake_memfault_platform_time.c
+
+TEST_SRC_FILES = \
+  $(MFLT_TEST_SRC_DIR)/test_memfault_zephyr_http.cpp \
+  $(MOCK_AND_FAKE_SRC_FILES)
+
+MEMFAULT_EXTRA_INC_PATHS += \
+  -I$(MFLT_TEST_ROOT)/stub_includes/zephyr \
+  -I$(MFLT_PORTS_DIR)/zephyr/common
+
+CPPUTEST_CPPFLAGS += \
+  -DCONFIG_MEMFAULT_HTTP_METRICS=1 \
+  -DMEMFAULT_METRICS_HTTP_CONNECTIONS_ENABLED=1
+
+CPPUTEST_LDFLAGS += -lpthread
+
+include $(CPPUTEST_MAKFILE_INFRA)
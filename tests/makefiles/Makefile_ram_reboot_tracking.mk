@@ -1,6 +1,7 @@
 COMPONENT_NAME=memfault_ram_reboot_tracking
 
 SRC_FILES = \
+  $(MFLT_COMPONENTS_DIR)/core/src/memfault_boot_profile.c \
   $(MFLT_COMPONENTS_DIR)/panics/src/memfault_ram_reboot_info_tracking.c
 
 TEST_SRC_FILES = \
@@ -0,0 +1,1118 @@
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Micro-benchmarks for the hot paths of the SDK, run on the host.
+//!
+//! Every benchmark is repeated until it has run for at least MEMFAULT_BENCHMARK_MIN_DURATION_MS.
+//! The results (ns/op and, where it applies, bytes/s and the size of the output) are written as
+//! JSON to the path in the
+//! MEMFAULT_BENCHMARK_RESULTS environment variable or to MEMFAULT_BENCHMARK_RESULTS_PATH so they
+//! can be tracked over time. The file is rewritten after each benchmark, so it is complete even
+//! when only a subset of the benchmarks is selected (i.e with -g / -n).
+
+#include "CppUTest/TestHarness.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+extern "C" {
+  #include "fake_memfault_platform_coredump_storage.h"
+  #include "memfault/core/data_packetizer.h"
+  #include "memfault/core/data_packetizer_source.h"
+  #include "memfault/core/data_source_cache.h"
+  #include "memfault/core/data_source_rle.h"
+  #include "memfault/core/event_storage.h"
+  #include "memfault/core/math.h"
+  #include "memfault/core/serializer_key_ids.h"
+  #include "memfault/http/chunk_batch.h"
+  #include "memfault/http/http_client.h"
+  #include "memfault/http/response_parser.h"
+  #include "memfault/http/utils.h"
+  #include "memfault/metrics/metrics.h"
+  #include "memfault/metrics/platform/timer.h"
+  #include "memfault/metrics/serializer.h"
+  #include "memfault/mqtt/publish_upload.h"
+  #include "memfault/panics/coredump.h"
+  #include "memfault/panics/coredump_impl.h"
+  #include "memfault/panics/platform/coredump.h"
+  #include "memfault/util/cbor.h"
+  #include "memfault/util/chunk_transport.h"
+  #include "memfault/util/circular_buffer.h"
+  #include "memfault/util/crc16_ccitt.h"
+  #include "memfault/util/deflate.h"
+  #include "memfault/util/rle.h"
+  #include "memfault_ingestion_server.h"
+  #include "memfault_mqtt_ingestion_server.h"
+
+  sMfltHttpClientConfig g_mflt_http_client_config = {
+    .api_key = "00112233445566778899aabbccddeeff",
+  };
+
+  bool memfault_platform_coredump_storage_read(uint32_t offset, void *buf, size_t buf_len) {
+    return fake_memfault_platform_coredump_storage_read(offset, buf, buf_len);
+  }
+
+  uint64_t memfault_platform_get_time_since_boot_ms(void) {
+    return 0;
+  }
+
+  bool memfault_platform_metrics_timer_boot(uint32_t period_sec,
+                                            MemfaultPlatformTimerCallback callback) {
+    return true;
+  }
+}
+
+#ifndef MEMFAULT_BENCHMARK_RESULTS_PATH
+#define MEMFAULT_BENCHMARK_RESULTS_PATH "memfault_benchmark_results.json"
+#endif
+
+#ifndef MEMFAULT_BENCHMARK_MIN_DURATION_MS
+#define MEMFAULT_BENCHMARK_MIN_DURATION_MS 50
+#endif
+
+#define MEMFAULT_BENCHMARK_MAX_RESULTS 64
+
+//
+// Harness
+//
+
+typedef struct {
+  const char *name;
+  //! The amount of data processed by one operation, 0 if a throughput makes no sense
+  size_t bytes_per_op;
+  //! The amount of data produced from bytes_per_op, i.e. once compressed, 0 if not tracked
+  size_t out_bytes_per_op;
+  //! Optional, runs before each operation and is not included in the timing
+  void (*setup)(void);
+  void (*run)(void);
+} sMfltBenchmark;
+
+typedef struct {
+  const char *name;
+  uint64_t iterations;
+  double ns_per_op;
+  size_t bytes_per_op;
+  size_t out_bytes_per_op;
+} sMfltBenchmarkResult;
+
+static sMfltBenchmarkResult s_results[MEMFAULT_BENCHMARK_MAX_RESULTS];
+static size_t s_num_results;
+
+//! Results of the operations are folded into this so the compiler can't drop them
+static volatile uint32_t s_sink;
+
+static uint64_t prv_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t prv_time_iterations(const sMfltBenchmark *benchmark, uint64_t iterations) {
+  if (benchmark->setup == NULL) {
+    const uint64_t start_ns = prv_time_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+      benchmark->run();
+    }
+    return prv_time_ns() - start_ns;
+  }
+
+  uint64_t elapsed_ns = 0;
+  for (uint64_t i = 0; i < iterations; i++) {
+    benchmark->setup();
+    const uint64_t start_ns = prv_time_ns();
+    benchmark->run();
+    elapsed_ns += prv_time_ns() - start_ns;
+  }
+  return elapsed_ns;
+}
+
+static void prv_write_results(void) {
+  const char *path = getenv("MEMFAULT_BENCHMARK_RESULTS");
+  if (path == NULL) {
+    path = MEMFAULT_BENCHMARK_RESULTS_PATH;
+  }
+  FILE *out = fopen(path, "w");
+  CHECK_TEXT(out != NULL, path);
+
+  fprintf(out, "{\n  \"min_duration_ms\": %d,\n  \"benchmarks\": [\n",
+          MEMFAULT_BENCHMARK_MIN_DURATION_MS);
+  for (size_t i = 0; i < s_num_results; i++) {
+    const sMfltBenchmarkResult *result = &s_results[i];
+    fprintf(out, "    {\"name\": \"%s\", \"iterations\": %" PRIu64 ", \"ns_per_op\": %.1f, "
+            "\"ops_per_s\": %.0f", result->name, result->iterations, result->ns_per_op,
+            1e9 / result->ns_per_op);
+    if (result->bytes_per_op != 0) {
+      fprintf(out, ", \"bytes_per_op\": %zu, \"bytes_per_s\": %.0f", result->bytes_per_op,
+              ((double)result->bytes_per_op * 1e9) / result->ns_per_op);
+    }
+    if (result->out_bytes_per_op != 0) {
+      fprintf(out, ", \"out_bytes_per_op\": %zu, \"out_ratio\": %.3f", result->out_bytes_per_op,
+              (double)result->out_bytes_per_op / (double)result->bytes_per_op);
+    }
+    fprintf(out, "}%s\n", (i + 1 < s_num_results) ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  fclose(out);
+}
+
+static void prv_run_benchmark(const sMfltBenchmark *benchmark) {
+  const uint64_t min_duration_ns = (uint64_t)MEMFAULT_BENCHMARK_MIN_DURATION_MS * 1000000ULL;
+
+  // Double the number of iterations until the run is long enough for the clock resolution and
+  // the timing overhead to be negligible. The first, short, runs also warm up the caches.
+  uint64_t iterations = 1;
+  uint64_t elapsed_ns;
+  while ((elapsed_ns = prv_time_iterations(benchmark, iterations)) < min_duration_ns) {
+    iterations *= 2;
+  }
+
+  CHECK(s_num_results < MEMFAULT_ARRAY_SIZE(s_results));
+  s_results[s_num_results++] = (sMfltBenchmarkResult) {
+    .name = benchmark->name,
+    .iterations = iterations,
+    .ns_per_op = (double)elapsed_ns / (double)iterations,
+    .bytes_per_op = benchmark->bytes_per_op,
+    .out_bytes_per_op = benchmark->out_bytes_per_op,
+  };
+  prv_write_results();
+}
+
+//
+// Test data
+//
+
+//! Approximates the contents of RAM in a coredump: zero filled and erased areas, repeated fill
+//! patterns and pseudo-random data
+static void prv_fill_ram_like(uint8_t *buf, size_t buf_len) {
+  uint32_t state = 0x12345678;
+  for (size_t i = 0; i < buf_len; i++) {
+    const size_t block = (i / 256) % 4;
+    if (block == 0) {
+      buf[i] = 0;
+    } else if (block == 1) {
+      buf[i] = 0xA5;
+    } else {
+      // xorshift32
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      buf[i] = (uint8_t)state;
+    }
+  }
+}
+
+static uint8_t s_data[4096];
+
+#define BENCHMARK_MTU 128
+static uint8_t s_chunk_buf[BENCHMARK_MTU];
+
+//
+// util
+//
+
+static void prv_crc16_ccitt_run(void) {
+  s_sink ^= memfault_crc16_ccitt_compute(MEMFAULT_CRC16_CCITT_INITIAL_VALUE, s_data, 1024);
+}
+
+static void prv_rle_encode_run(void) {
+  sMemfaultRleCtx ctx = { 0 };
+  size_t offset = 0;
+  while (offset < sizeof(s_data)) {
+    offset += memfault_rle_encode(&ctx, &s_data[offset], sizeof(s_data) - offset);
+  }
+  memfault_rle_encode_finalize(&ctx);
+  s_sink ^= ctx.total_rle_size;
+}
+
+static void prv_chunk_transport_read_msg(uint32_t offset, void *buf, size_t buf_len) {
+  memcpy(buf, &s_data[offset], buf_len);
+}
+
+static void prv_chunk_transport_run(void) {
+  sMfltChunkTransportCtx ctx = {
+    .total_size = sizeof(s_data),
+    .read_msg = prv_chunk_transport_read_msg,
+  };
+  bool more_data;
+  do {
+    size_t buf_len = sizeof(s_chunk_buf);
+    more_data = memfault_chunk_transport_get_next_chunk(&ctx, s_chunk_buf, &buf_len);
+    s_sink ^= s_chunk_buf[0];
+  } while (more_data);
+}
+
+#define CIRCULAR_BUFFER_OP_SIZE 64
+static sMfltCircularBuffer s_circular_buffer;
+static uint8_t s_circular_buffer_storage[1024];
+
+static void prv_circular_buffer_run(void) {
+  uint8_t read_buf[CIRCULAR_BUFFER_OP_SIZE];
+  memfault_circular_buffer_write(&s_circular_buffer, s_data, sizeof(read_buf));
+  memfault_circular_buffer_read(&s_circular_buffer, 0, read_buf, sizeof(read_buf));
+  memfault_circular_buffer_consume(&s_circular_buffer, sizeof(read_buf));
+  s_sink ^= read_buf[0];
+}
+
+static uint8_t s_cbor_buf[256];
+
+static void prv_cbor_write_cb(void *ctx, uint32_t offset, const void *buf, size_t buf_len) {
+  memcpy(&s_cbor_buf[offset], buf, buf_len);
+}
+
+//! Encodes a message shaped like a trace event: a dictionary of integers, strings and a small
+//! byte string
+static size_t prv_cbor_encode(void) {
+  sMemfaultCborEncoder encoder;
+  memfault_cbor_encoder_init(&encoder, prv_cbor_write_cb, NULL, sizeof(s_cbor_buf));
+  memfault_cbor_encode_dictionary_begin(&encoder, 10);
+  for (uint32_t key = 0; key < 6; key++) {
+    memfault_cbor_encode_unsigned_integer(&encoder, key);
+    memfault_cbor_encode_unsigned_integer(&encoder, 0x1000u << (key * 4));
+  }
+  memfault_cbor_encode_unsigned_integer(&encoder, 6);
+  memfault_cbor_encode_signed_integer(&encoder, -1234);
+  memfault_cbor_encode_unsigned_integer(&encoder, 7);
+  memfault_cbor_encode_string(&encoder, "DAABBCCDD");
+  memfault_cbor_encode_unsigned_integer(&encoder, 8);
+  memfault_cbor_encode_string(&encoder, "1.2.3-main");
+  memfault_cbor_encode_unsigned_integer(&encoder, 9);
+  memfault_cbor_encode_byte_string(&encoder, s_data, 32);
+  return memfault_cbor_encoder_deinit(&encoder);
+}
+
+static void prv_cbor_encode_run(void) {
+  s_sink ^= (uint32_t)prv_cbor_encode();
+}
+
+//
+// flash backed data sources
+//
+
+//! The cost of a read of the fake flash: the command and address phases of every transaction,
+//! and the transfer of each byte (i.e a 40 MHz quad SPI bus)
+#define FAKE_FLASH_TRANSACTION_NS 2000
+#define FAKE_FLASH_BYTE_NS 50
+
+static uint8_t s_fake_flash[16 * 1024];
+static size_t s_fake_flash_num_reads;
+
+static void prv_spin_ns(uint64_t duration_ns) {
+  const uint64_t start_ns = prv_time_ns();
+  while ((prv_time_ns() - start_ns) < duration_ns) {
+  }
+}
+
+static bool prv_fake_flash_has_msg(size_t *total_size_out) {
+  *total_size_out = sizeof(s_fake_flash);
+  return true;
+}
+
+static bool prv_fake_flash_read(uint32_t offset, void *buf, size_t buf_len) {
+  prv_spin_ns(FAKE_FLASH_TRANSACTION_NS + ((uint64_t)buf_len * FAKE_FLASH_BYTE_NS));
+  memcpy(buf, &s_fake_flash[offset], buf_len);
+  s_fake_flash_num_reads++;
+  return true;
+}
+
+static void prv_fake_flash_mark_msg_read(void) { }
+
+static const sMemfaultDataSourceImpl s_fake_flash_source = {
+  .has_more_msgs_cb = prv_fake_flash_has_msg,
+  .read_msg_cb = prv_fake_flash_read,
+  .mark_msg_read_cb = prv_fake_flash_mark_msg_read,
+};
+
+static sMfltDataSourceCacheCtx s_flash_cache;
+static uint8_t s_flash_cache_storage[4 * 256];
+
+//! Reads the whole RLE encoded message out in MTU sized pieces, as the packetizer does
+static void prv_rle_read_out(const sMemfaultDataSourceImpl *source) {
+  static sMfltDataSourceRleCtx s_rle;
+  s_rle = (sMfltDataSourceRleCtx) { 0 };
+  const sMemfaultDataSourceImpl *rle_source = memfault_data_source_rle_ctx_set_active(&s_rle,
+                                                                                      source);
+  size_t rle_size = 0;
+  rle_source->ctx_has_more_msgs_cb(rle_source->ctx, &rle_size);
+  for (size_t offset = 0; offset < rle_size; offset += sizeof(s_chunk_buf)) {
+    const size_t len = MEMFAULT_MIN(sizeof(s_chunk_buf), rle_size - offset);
+    rle_source->ctx_read_msg_cb(rle_source->ctx, (uint32_t)offset, s_chunk_buf, len);
+    s_sink ^= s_chunk_buf[0];
+  }
+}
+
+static void prv_rle_fake_flash_uncached_run(void) {
+  prv_rle_read_out(&s_fake_flash_source);
+}
+
+static void prv_rle_fake_flash_cached_run(void) {
+  const sMfltDataSourceCacheConfig cfg = {
+    .source = &s_fake_flash_source,
+    .storage = s_flash_cache_storage,
+    .block_size = 256,
+    .num_blocks = 4,
+    .read_ahead_blocks = 2,
+  };
+  prv_rle_read_out(memfault_data_source_cache_init(&s_flash_cache, &cfg));
+}
+
+//
+// http
+//
+
+static const char s_http_rsp_accepted[] =
+    "HTTP/1.1 202 Accepted\r\n"
+    "Content-Type: text/plain; charset=utf-8\r\n"
+    "Content-Length: 8\r\n"
+    "Date: Wed, 27 Nov 2019 22:52:57 GMT\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "Accepted";
+
+#define HTTP_RSP_LEN (sizeof(s_http_rsp_accepted) - 1)
+#define HTTP_NUM_PIPELINED_RSPS 64
+//! i.e the size of a socket read
+#define HTTP_RECV_LEN 256
+
+//! A stream of pipelined responses, read out HTTP_RECV_LEN bytes at a time
+static char s_http_rsp_stream[HTTP_NUM_PIPELINED_RSPS * HTTP_RSP_LEN];
+static size_t s_http_num_parsed;
+
+static void prv_http_parse_response_run(void) {
+  sMemfaultHttpResponseContext ctx = { };
+  for (size_t offset = 0; offset < sizeof(s_http_rsp_stream); offset += HTTP_RECV_LEN) {
+    const size_t len = MEMFAULT_MIN(HTTP_RECV_LEN, sizeof(s_http_rsp_stream) - offset);
+    size_t segment_offset = 0;
+    while (segment_offset < len) {
+      const bool done = memfault_http_parse_response(
+          &ctx, &s_http_rsp_stream[offset + segment_offset], len - segment_offset);
+      segment_offset += (size_t)ctx.data_bytes_processed;
+      if (done) {
+        s_http_num_parsed++;
+        memset(&ctx, 0, sizeof(ctx));
+      }
+    }
+  }
+}
+
+static void prv_http_response_parser_feed_run(void) {
+  sMfltHttpResponseParser parser;
+  memfault_http_response_parser_reset(&parser);
+  for (size_t offset = 0; offset < sizeof(s_http_rsp_stream); offset += HTTP_RECV_LEN) {
+    const size_t len = MEMFAULT_MIN(HTTP_RECV_LEN, sizeof(s_http_rsp_stream) - offset);
+    size_t segment_offset = 0;
+    while (segment_offset < len) {
+      size_t bytes_consumed;
+      if (memfault_http_response_parser_feed(&parser, &s_http_rsp_stream[offset + segment_offset],
+                                             len - segment_offset, &bytes_consumed)) {
+        s_http_num_parsed++;
+      }
+      segment_offset += bytes_consumed;
+    }
+  }
+}
+
+//
+// deflate
+//
+// Batches of heartbeats, encoded the way the "metrics" component serializes them and laid out
+// like the bodies built by memfault_http_chunk_batch_build(): each event in a multipart/mixed
+// part. zlib at its default level is the reference.
+//
+
+static uint32_t s_rand_state;
+
+static uint32_t prv_rand(void) {
+  s_rand_state ^= s_rand_state << 13;
+  s_rand_state ^= s_rand_state >> 17;
+  s_rand_state ^= s_rand_state << 5;
+  return s_rand_state;
+}
+
+typedef struct {
+  uint8_t *buf;
+  size_t len;
+} sCborBuffer;
+
+static void prv_heartbeat_cbor_write_cb(void *ctx, uint32_t offset, const void *buf,
+                                        size_t buf_len) {
+  sCborBuffer *cbor_buf = (sCborBuffer *)ctx;
+  memcpy(&cbor_buf->buf[offset], buf, buf_len);
+  cbor_buf->len = offset + buf_len;
+}
+
+static size_t prv_encode_heartbeat(uint8_t *buf, size_t buf_len, size_t num_metrics,
+                                   uint32_t heartbeat_idx) {
+  sCborBuffer cbor_buf = { .buf = buf, .len = 0 };
+  sMemfaultCborEncoder encoder;
+  memfault_cbor_encoder_init(&encoder, prv_heartbeat_cbor_write_cb, &cbor_buf, buf_len);
+
+  memfault_cbor_encode_dictionary_begin(&encoder, 7);
+  memfault_cbor_encode_unsigned_integer(&encoder, kMemfaultEventKey_Type);
+  memfault_cbor_encode_unsigned_integer(&encoder, kMemfaultEventType_Heartbeat);
+  memfault_cbor_encode_unsigned_integer(&encoder, kMemfaultEventKey_CborSchemaVersion);
+  memfault_cbor_encode_unsigned_integer(&encoder, 1);
+  memfault_cbor_encode_unsigned_integer(&encoder, kMemfaultEventKey_DeviceSerial);
+  memfault_cbor_encode_string(&encoder, "DEMOSERIAL00042");
+  memfault_cbor_encode_unsigned_integer(&encoder, kMemfaultEventKey_SoftwareType);
+  memfault_cbor_encode_string(&encoder, "main-fw");
+  memfault_cbor_encode_unsigned_integer(&encoder, kMemfaultEventKey_SoftwareVersion);
+  memfault_cbor_encode_string(&encoder, "1.4.2-rc3+a1b2c3d4");
+  memfault_cbor_encode_unsigned_integer(&encoder, kMemfaultEventKey_HardwareVersion);
+  memfault_cbor_encode_string(&encoder, "evt-rev2");
+
+  memfault_cbor_encode_unsigned_integer(&encoder, kMemfaultEventKey_EventInfo);
+  memfault_cbor_encode_dictionary_begin(&encoder, 1);
+  memfault_cbor_encode_unsigned_integer(&encoder, kMemfaultHeartbeatInfoKey_Metrics);
+  memfault_cbor_encode_array_begin(&encoder, num_metrics);
+  for (size_t i = 0; i < num_metrics; i++) {
+    // a mix of counters, gauges and timers
+    uint32_t value;
+    switch (i % 3) {
+      case 0:
+        value = heartbeat_idx * 3 + (prv_rand() % 4);
+        break;
+      case 1:
+        value = 3600 + (prv_rand() % 200);
+        break;
+      default:
+        value = prv_rand() % 100000;
+        break;
+    }
+    memfault_cbor_encode_unsigned_integer(&encoder, value);
+  }
+  return memfault_cbor_encoder_deinit(&encoder);
+}
+
+static uint8_t s_deflate_batch[8192];
+static size_t s_deflate_batch_len;
+static uint8_t s_deflate_out[sizeof(s_deflate_batch) + 64];
+static size_t s_deflate_out_len;
+
+static void prv_build_heartbeat_batch(size_t num_heartbeats, size_t num_metrics) {
+  s_rand_state = 0x12345678;
+  size_t offset = 0;
+  uint8_t heartbeat[512];
+  for (size_t i = 0; i < num_heartbeats; i++) {
+    const size_t heartbeat_len = prv_encode_heartbeat(heartbeat, sizeof(heartbeat), num_metrics,
+                                                      (uint32_t)i);
+    CHECK(heartbeat_len > 0);
+    CHECK(offset + MEMFAULT_HTTP_CHUNK_BATCH_PART_OVERHEAD + heartbeat_len +
+            MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN <= sizeof(s_deflate_batch));
+    const char *part_header = MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER;
+    memcpy(&s_deflate_batch[offset], part_header, strlen(part_header));
+    offset += strlen(part_header);
+    memcpy(&s_deflate_batch[offset], heartbeat, heartbeat_len);
+    offset += heartbeat_len;
+    memcpy(&s_deflate_batch[offset], MEMFAULT_HTTP_CHUNK_BATCH_PART_END, 2);
+    offset += 2;
+  }
+  memcpy(&s_deflate_batch[offset], MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER,
+         MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN);
+  s_deflate_batch_len = offset + MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN;
+}
+
+static bool prv_deflate_write_cb(void *ctx, const void *data, size_t data_len) {
+  memcpy(&s_deflate_out[s_deflate_out_len], data, data_len);
+  s_deflate_out_len += data_len;
+  return true;
+}
+
+static void prv_deflate_run(void) {
+  static sMemfaultDeflateEncoder s_encoder;
+  s_deflate_out_len = 0;
+  memfault_deflate_encoder_init(&s_encoder, prv_deflate_write_cb, NULL);
+  memfault_deflate_encoder_write(&s_encoder, s_deflate_batch, s_deflate_batch_len);
+  memfault_deflate_encoder_finish(&s_encoder);
+}
+
+static void prv_zlib_run(void) {
+  uLongf out_len = sizeof(s_deflate_out);
+  compress2(s_deflate_out, &out_len, s_deflate_batch, (uLong)s_deflate_batch_len,
+            Z_DEFAULT_COMPRESSION);
+  s_deflate_out_len = out_len;
+}
+
+//
+// metrics
+//
+
+static const sMemfaultEventStorageImpl *s_event_storage;
+//! Sized to hold the messages of an upload, see s_upload_msg_sizes
+static uint8_t s_event_storage_buf[8192];
+
+static void prv_metrics_set_unsigned_run(void) {
+  memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(test_key_unsigned), s_sink++);
+}
+
+static void prv_metrics_add_run(void) {
+  memfault_metrics_heartbeat_add(MEMFAULT_METRICS_KEY(test_key_signed), 1);
+}
+
+static bool prv_event_storage_has_event(size_t *event_size) {
+  return g_memfault_event_data_source.has_more_msgs_cb(event_size);
+}
+
+static void prv_event_storage_clear(void) {
+  size_t event_size;
+  while (prv_event_storage_has_event(&event_size)) {
+    g_memfault_event_data_source.mark_msg_read_cb();
+  }
+}
+
+static void prv_heartbeat_serialize_run(void) {
+  s_sink ^= memfault_metrics_heartbeat_serialize(s_event_storage);
+}
+
+//
+// packetizer
+//
+
+static uint8_t s_coredump_storage[16 * 1024];
+static uint8_t s_coredump_first_byte;
+static sMfltCoredumpRegion s_coredump_regions[2];
+
+const sMfltCoredumpRegion *memfault_platform_coredump_get_regions(
+    const sCoredumpCrashInfo *crash_info, size_t *num_regions) {
+  *num_regions = MEMFAULT_ARRAY_SIZE(s_coredump_regions);
+  return s_coredump_regions;
+}
+
+const sMfltCoredumpRegion *memfault_coredump_get_arch_regions(size_t *num_regions) {
+  *num_regions = 0;
+  return NULL;
+}
+
+static size_t prv_packetizer_drain(void) {
+  size_t num_chunks = 0;
+  size_t buf_len = sizeof(s_chunk_buf);
+  while (memfault_packetizer_get_chunk(s_chunk_buf, &buf_len)) {
+    num_chunks++;
+    buf_len = sizeof(s_chunk_buf);
+  }
+  return num_chunks;
+}
+
+static void prv_packetizer_drain_run(void) {
+  s_sink ^= (uint32_t)prv_packetizer_drain();
+}
+
+//! Reading the coredump out only invalidates the first byte of the storage (see
+//! memfault_platform_coredump_storage_clear()) so restoring it makes the coredump available again
+static void prv_coredump_restore(void) {
+  s_coredump_storage[0] = s_coredump_first_byte;
+}
+
+#define EVENTS_PER_DRAIN 8
+
+static void prv_events_fill(void) {
+  for (size_t i = 0; i < EVENTS_PER_DRAIN; i++) {
+    memfault_metrics_heartbeat_serialize(s_event_storage);
+  }
+}
+
+//
+// uploads
+//
+// A device which uploads periodically either keeps its MQTT connection open or, over HTTPS,
+// opens a new connection for every upload and posts one message per request, waiting for each
+// response. The stand-in servers hold back their PUBACKs and responses for UPLOAD_RTT_MS.
+//
+
+#define UPLOAD_RTT_MS 20
+//! The stand-in HTTP server can't do TLS, so the round trips of the TCP (1) and TLS 1.2 (2)
+//! handshakes of every HTTPS connection are slept through instead. The cost of the handshake
+//! crypto on the device comes on top of that and is not counted.
+#define UPLOAD_HTTPS_HANDSHAKE_RTTS 3
+#define UPLOAD_MSG_HDR_LEN 5
+
+static const size_t s_upload_msg_sizes[] = { 256, 300, 1000, 1500, 420, 2000, 260, 777 };
+
+static size_t prv_upload_total_size(void) {
+  size_t total = 0;
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(s_upload_msg_sizes); i++) {
+    total += UPLOAD_MSG_HDR_LEN + s_upload_msg_sizes[i];
+  }
+  return total;
+}
+
+//! Queues the messages of an upload in event storage: a map holding a single byte string
+static void prv_upload_queue_msgs(void) {
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(s_upload_msg_sizes); i++) {
+    const size_t len = s_upload_msg_sizes[i];
+    const uint8_t hdr[UPLOAD_MSG_HDR_LEN] = { 0xA1, 0x04, 0x59, (uint8_t)(len >> 8),
+                                              (uint8_t)(len & 0xff) };
+    CHECK(s_event_storage->begin_write_cb() >= sizeof(hdr) + len);
+    CHECK(s_event_storage->append_data_cb(hdr, sizeof(hdr)));
+    CHECK(s_event_storage->append_data_cb(s_data, len));
+    s_event_storage->finish_write_cb(false);
+  }
+}
+
+static int prv_tcp_connect(uint16_t port) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(fd >= 0);
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  LONGS_EQUAL(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  return fd;
+}
+
+static void prv_send_all(int fd, const void *data, size_t data_len) {
+  LONGS_EQUAL((ssize_t)data_len, send(fd, data, data_len, MSG_NOSIGNAL));
+}
+
+static void prv_recv_all(int fd, void *buf, size_t len) {
+  uint8_t *bytes = (uint8_t *)buf;
+  while (len > 0) {
+    const ssize_t rv = recv(fd, bytes, len, 0);
+    CHECK(rv > 0);
+    bytes += rv;
+    len -= (size_t)rv;
+  }
+}
+
+static bool prv_append(const void *data, size_t data_len, void *ctx) {
+  uint8_t **cursor = (uint8_t **)ctx;
+  memcpy(*cursor, data, data_len);
+  *cursor += data_len;
+  return true;
+}
+
+//! Reads a response of the stand-in HTTP server and returns its status
+static int prv_http_read_response(int fd) {
+  char rsp[512];
+  size_t len = 0;
+  const char *body = NULL;
+  while (body == NULL) {
+    CHECK(len < sizeof(rsp) - 1);
+    const ssize_t rv = recv(fd, &rsp[len], sizeof(rsp) - 1 - len, 0);
+    CHECK(rv > 0);
+    len += (size_t)rv;
+    rsp[len] = '\0';
+    body = strstr(rsp, "\r\n\r\n");
+  }
+  const char *content_len = strstr(rsp, "Content-Length: ");
+  CHECK(content_len != NULL);
+  const size_t body_len = strtoul(content_len + strlen("Content-Length: "), NULL, 10);
+  const size_t hdr_len = (size_t)(body + 4 - rsp);
+  if ((len - hdr_len) < body_len) {
+    prv_recv_all(fd, &rsp[len], body_len - (len - hdr_len));
+  }
+  return atoi(&rsp[strlen("HTTP/1.1 ")]);
+}
+
+static uint16_t s_http_port;
+
+//! Posts everything queued in the packetizer over a new connection, one message per request, as
+//! memfault_http_async_upload.c does
+static void prv_https_upload_run(void) {
+  const int fd = prv_tcp_connect(s_http_port);
+  usleep(UPLOAD_HTTPS_HANDSHAKE_RTTS * UPLOAD_RTT_MS * 1000);
+  const sPacketizerConfig cfg = {
+    .enable_multi_packet_chunk = false,
+  };
+  sPacketizerMetadata metadata;
+  while (memfault_packetizer_begin(&cfg, &metadata)) {
+    static uint8_t s_request[sizeof(s_data) + 512];
+    uint8_t *cursor = s_request;
+    // the message, its type byte, the chunk header byte and the CRC16 in a single chunk
+    const size_t chunk_len = metadata.single_chunk_message_length;
+    CHECK(memfault_http_start_chunk_post(prv_append, &cursor, chunk_len));
+    size_t buf_len = sizeof(s_request) - (size_t)(cursor - s_request);
+    LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk, memfault_packetizer_get_next(cursor,
+                                                                                   &buf_len));
+    LONGS_EQUAL(chunk_len, buf_len);
+    cursor += buf_len;
+    prv_send_all(fd, s_request, (size_t)(cursor - s_request));
+    LONGS_EQUAL(202, prv_http_read_response(fd));
+  }
+  close(fd);
+}
+
+static int s_mqtt_fd;
+
+static int prv_mqtt_send(void *ctx, const void *packet, size_t packet_len) {
+  const ssize_t rv = send(s_mqtt_fd, packet, packet_len, MSG_NOSIGNAL);
+  return (rv == (ssize_t)packet_len) ? 0 : -1;
+}
+
+static const sMfltMqttUploadTransport s_mqtt_transport = {
+  .send = prv_mqtt_send,
+};
+
+static void prv_mqtt_connect(uint16_t port) {
+  s_mqtt_fd = prv_tcp_connect(port);
+  // CONNECT with a clean session, a 60s keep alive and the device serial as client identifier
+  const uint8_t connect_pkt[] = {
+    0x10, 10 + 2 + 9,
+    0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 60,
+    0, 9, 'D', 'A', 'A', 'B', 'B', 'C', 'C', 'D', 'D',
+  };
+  prv_send_all(s_mqtt_fd, connect_pkt, sizeof(connect_pkt));
+  uint8_t connack[4];
+  prv_recv_all(s_mqtt_fd, connack, sizeof(connack));
+  LONGS_EQUAL(0, connack[3]);
+}
+
+//! Runs an upload over the open connection the way the receive loop of an MQTT client would
+static void prv_mqtt_upload_run(void) {
+  static sMfltMqttUpload s_upload;
+  const sMfltMqttUploadConfig cfg = {
+    .transport = &s_mqtt_transport,
+  };
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started, memfault_mqtt_upload_start(&s_upload, &cfg));
+
+  uint8_t rx_buf[256];
+  size_t rx_len = 0;
+  while (memfault_mqtt_upload_in_progress(&s_upload)) {
+    struct pollfd pfd = { .fd = s_mqtt_fd, .events = POLLIN, .revents = 0 };
+    CHECK(poll(&pfd, 1, 5000) == 1);
+    const ssize_t len = recv(s_mqtt_fd, &rx_buf[rx_len], sizeof(rx_buf) - rx_len, 0);
+    CHECK(len > 0);
+    rx_len += (size_t)len;
+
+    // the broker only sends PUBACKs to a publisher
+    size_t offset = 0;
+    while ((rx_len - offset) >= 4) {
+      const uint8_t *puback = &rx_buf[offset];
+      CHECK(memfault_mqtt_upload_on_puback(&s_upload,
+                                           (uint16_t)((puback[2] << 8) | puback[3])));
+      offset += 4;
+    }
+    memmove(rx_buf, &rx_buf[offset], rx_len - offset);
+    rx_len -= offset;
+  }
+}
+
+TEST_GROUP(MfltBenchmarks) {
+  void setup() {
+    prv_fill_ram_like(s_data, sizeof(s_data));
+
+    static bool s_booted;
+    if (!s_booted) {
+      s_event_storage =
+          memfault_events_storage_boot(s_event_storage_buf, sizeof(s_event_storage_buf));
+      memfault_metrics_boot(s_event_storage);
+      fake_memfault_platform_coredump_storage_setup(s_coredump_storage,
+                                                    sizeof(s_coredump_storage), 1024);
+      s_booted = true;
+    }
+
+    // start every benchmark with nothing queued up for the packetizer
+    memfault_platform_coredump_storage_clear();
+    prv_event_storage_clear();
+  }
+};
+
+TEST(MfltBenchmarks, Crc16Ccitt) {
+  const sMfltBenchmark benchmark = {
+    .name = "crc16_ccitt_compute_1KiB",
+    .bytes_per_op = 1024,
+    .run = prv_crc16_ccitt_run,
+  };
+  prv_run_benchmark(&benchmark);
+}
+
+TEST(MfltBenchmarks, RleEncode) {
+  const sMfltBenchmark benchmark = {
+    .name = "rle_encode_4KiB",
+    .bytes_per_op = sizeof(s_data),
+    .run = prv_rle_encode_run,
+  };
+  prv_run_benchmark(&benchmark);
+}
+
+TEST(MfltBenchmarks, ChunkTransport) {
+  const sMfltBenchmark benchmark = {
+    .name = "chunk_transport_get_next_chunk_4KiB_mtu128",
+    .bytes_per_op = sizeof(s_data),
+    .run = prv_chunk_transport_run,
+  };
+  prv_run_benchmark(&benchmark);
+}
+
+TEST(MfltBenchmarks, RleFakeFlash) {
+  prv_fill_ram_like(s_fake_flash, sizeof(s_fake_flash));
+
+  s_fake_flash_num_reads = 0;
+  prv_rle_fake_flash_uncached_run();
+  const size_t uncached_num_reads = s_fake_flash_num_reads;
+  s_fake_flash_num_reads = 0;
+  prv_rle_fake_flash_cached_run();
+  CHECK((s_fake_flash_num_reads * 4) < uncached_num_reads);
+
+  const sMfltBenchmark uncached = {
+    .name = "rle_read_16KiB_fake_spi_flash_uncached",
+    .bytes_per_op = sizeof(s_fake_flash),
+    .run = prv_rle_fake_flash_uncached_run,
+  };
+  prv_run_benchmark(&uncached);
+
+  const sMfltBenchmark cached = {
+    .name = "rle_read_16KiB_fake_spi_flash_cached_4x256B",
+    .bytes_per_op = sizeof(s_fake_flash),
+    .run = prv_rle_fake_flash_cached_run,
+  };
+  prv_run_benchmark(&cached);
+}
+
+TEST(MfltBenchmarks, HttpResponseParsing) {
+  for (size_t i = 0; i < HTTP_NUM_PIPELINED_RSPS; i++) {
+    memcpy(&s_http_rsp_stream[i * HTTP_RSP_LEN], s_http_rsp_accepted, HTTP_RSP_LEN);
+  }
+  s_http_num_parsed = 0;
+  prv_http_parse_response_run();
+  LONGS_EQUAL(HTTP_NUM_PIPELINED_RSPS, s_http_num_parsed);
+  s_http_num_parsed = 0;
+  prv_http_response_parser_feed_run();
+  LONGS_EQUAL(HTTP_NUM_PIPELINED_RSPS, s_http_num_parsed);
+
+  const sMfltBenchmark legacy = {
+    .name = "http_parse_response_64_pipelined_rsps",
+    .bytes_per_op = sizeof(s_http_rsp_stream),
+    .run = prv_http_parse_response_run,
+  };
+  prv_run_benchmark(&legacy);
+
+  const sMfltBenchmark parser = {
+    .name = "http_response_parser_feed_64_pipelined_rsps",
+    .bytes_per_op = sizeof(s_http_rsp_stream),
+    .run = prv_http_response_parser_feed_run,
+  };
+  prv_run_benchmark(&parser);
+}
+
+TEST(MfltBenchmarks, DeflateHeartbeatBatches) {
+  static const struct {
+    size_t num_heartbeats;
+    size_t num_metrics;
+  } s_batches[] = {
+    { 1, 10 },
+    { 4, 10 },
+    { 8, 20 },
+    { 16, 40 },
+  };
+
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(s_batches); i++) {
+    prv_build_heartbeat_batch(s_batches[i].num_heartbeats, s_batches[i].num_metrics);
+
+    // the stream must decode back to the batch
+    prv_deflate_run();
+    CHECK(s_deflate_out_len <= memfault_deflate_max_encoded_size(s_deflate_batch_len));
+    static uint8_t s_decompressed[sizeof(s_deflate_batch)];
+    uLongf decompressed_len = sizeof(s_decompressed);
+    LONGS_EQUAL(Z_OK, uncompress(s_decompressed, &decompressed_len, s_deflate_out,
+                                 s_deflate_out_len));
+    LONGS_EQUAL(s_deflate_batch_len, decompressed_len);
+    MEMCMP_EQUAL(s_deflate_batch, s_decompressed, s_deflate_batch_len);
+    // anything but a single small heartbeat should shrink substantially
+    if (s_batches[i].num_heartbeats > 1) {
+      CHECK(s_deflate_out_len < (s_deflate_batch_len * 3) / 4);
+    }
+
+    static char s_names[2 * MEMFAULT_ARRAY_SIZE(s_batches)][64];
+    char *deflate_name = s_names[2 * i];
+    snprintf(deflate_name, sizeof(s_names[0]), "deflate_heartbeat_batch_%dx%d_metrics",
+             (int)s_batches[i].num_heartbeats, (int)s_batches[i].num_metrics);
+    const sMfltBenchmark deflate = {
+      .name = deflate_name,
+      .bytes_per_op = s_deflate_batch_len,
+      .out_bytes_per_op = s_deflate_out_len,
+      .run = prv_deflate_run,
+    };
+    prv_run_benchmark(&deflate);
+
+    prv_zlib_run();
+    char *zlib_name = s_names[(2 * i) + 1];
+    snprintf(zlib_name, sizeof(s_names[0]), "zlib_default_heartbeat_batch_%dx%d_metrics",
+             (int)s_batches[i].num_heartbeats, (int)s_batches[i].num_metrics);
+    const sMfltBenchmark zlib = {
+      .name = zlib_name,
+      .bytes_per_op = s_deflate_batch_len,
+      .out_bytes_per_op = s_deflate_out_len,
+      .run = prv_zlib_run,
+    };
+    prv_run_benchmark(&zlib);
+  }
+}
+
+TEST(MfltBenchmarks, CircularBuffer) {
+  memfault_circular_buffer_init(&s_circular_buffer, s_circular_buffer_storage,
+                                sizeof(s_circular_buffer_storage));
+  const sMfltBenchmark benchmark = {
+    .name = "circular_buffer_write_read_consume_64B",
+    .bytes_per_op = CIRCULAR_BUFFER_OP_SIZE,
+    .run = prv_circular_buffer_run,
+  };
+  prv_run_benchmark(&benchmark);
+}
+
+TEST(MfltBenchmarks, CborEncode) {
+  const size_t encoded_size = prv_cbor_encode();
+  CHECK(encoded_size != 0);
+  const sMfltBenchmark benchmark = {
+    .name = "cbor_encode_trace_event",
+    .bytes_per_op = encoded_size,
+    .run = prv_cbor_encode_run,
+  };
+  prv_run_benchmark(&benchmark);
+}
+
+TEST(MfltBenchmarks, MetricsSetUnsigned) {
+  const sMfltBenchmark benchmark = {
+    .name = "metrics_heartbeat_set_unsigned",
+    .run = prv_metrics_set_unsigned_run,
+  };
+  prv_run_benchmark(&benchmark);
+}
+
+TEST(MfltBenchmarks, MetricsAdd) {
+  const sMfltBenchmark benchmark = {
+    .name = "metrics_heartbeat_add",
+    .run = prv_metrics_add_run,
+  };
+  prv_run_benchmark(&benchmark);
+}
+
+TEST(MfltBenchmarks, HeartbeatSerialize) {
+  CHECK(memfault_metrics_heartbeat_serialize(s_event_storage));
+  size_t event_size = 0;
+  CHECK(prv_event_storage_has_event(&event_size));
+
+  const sMfltBenchmark benchmark = {
+    .name = "metrics_heartbeat_serialize",
+    .bytes_per_op = event_size,
+    .setup = prv_event_storage_clear,
+    .run = prv_heartbeat_serialize_run,
+  };
+  prv_run_benchmark(&benchmark);
+}
+
+TEST(MfltBenchmarks, PacketizerDrainCoredump) {
+  s_coredump_regions[0] = (sMfltCoredumpRegion) {
+    .type = kMfltCoredumpRegionType_Memory,
+    .region_start = s_data,
+    .region_size = sizeof(s_data),
+  };
+  // a second, incompressible, region standing in for the stack
+  static uint8_t s_stack[1024];
+  prv_fill_ram_like(s_stack, sizeof(s_stack));
+  for (size_t i = 0; i < sizeof(s_stack); i++) {
+    s_stack[i] ^= (uint8_t)(i * 31);
+  }
+  s_coredump_regions[1] = (sMfltCoredumpRegion) {
+    .type = kMfltCoredumpRegionType_Memory,
+    .region_start = s_stack,
+    .region_size = sizeof(s_stack),
+  };
+
+  uint32_t regs[17] = { 0 };
+  const sMemfaultCoredumpSaveInfo save_info = {
+    .regs = regs,
+    .regs_size = sizeof(regs),
+    .trace_reason = kMfltRebootReason_HardFault,
+    .regions = s_coredump_regions,
+    .num_regions = MEMFAULT_ARRAY_SIZE(s_coredump_regions),
+  };
+  CHECK(memfault_coredump_save(&save_info));
+  size_t coredump_size = 0;
+  CHECK(memfault_coredump_has_valid_coredump(&coredump_size));
+  s_coredump_first_byte = s_coredump_storage[0];
+
+  // The coredump is only RLE encoded when memfault_data_source_rle.c is linked as an object (see
+  // Makefile_memfault_benchmarks.mk). Sent as is, it takes more chunks than this.
+  CHECK(prv_packetizer_drain() < (coredump_size / BENCHMARK_MTU));
+  prv_coredump_restore();
+
+  const sMfltBenchmark benchmark = {
+    .name = "packetizer_drain_coredump_mtu128",
+    .bytes_per_op = coredump_size,
+    .setup = prv_coredump_restore,
+    .run = prv_packetizer_drain_run,
+  };
+  prv_run_benchmark(&benchmark);
+  CHECK(!memfault_coredump_has_valid_coredump(NULL));
+}
+
+TEST(MfltBenchmarks, PacketizerDrainEvents) {
+  CHECK(memfault_metrics_heartbeat_serialize(s_event_storage));
+  size_t event_size = 0;
+  CHECK(prv_event_storage_has_event(&event_size));
+  prv_event_storage_clear();
+  CHECK(EVENTS_PER_DRAIN * event_size <= sizeof(s_event_storage_buf));
+
+  const sMfltBenchmark benchmark = {
+    .name = "packetizer_drain_events_mtu128",
+    .bytes_per_op = EVENTS_PER_DRAIN * event_size,
+    .setup = prv_events_fill,
+    .run = prv_packetizer_drain_run,
+  };
+  prv_run_benchmark(&benchmark);
+  CHECK(!memfault_packetizer_data_available());
+}
+
+TEST(MfltBenchmarks, UploadHttpsConnectionPerUpload) {
+  sMfltIngestionServerConfig config;
+  memset(&config, 0, sizeof(config));
+  config.num_workers = 1;
+  config.response_delay_ms = UPLOAD_RTT_MS;
+  sMfltIngestionServer *server = memfault_ingestion_server_start(&config);
+  CHECK(server != NULL);
+  s_http_port = memfault_ingestion_server_get_port(server);
+
+  const sMfltBenchmark benchmark = {
+    .name = "upload_https_connection_per_upload_8_msgs_20ms_rtt",
+    .bytes_per_op = prv_upload_total_size(),
+    .setup = prv_upload_queue_msgs,
+    .run = prv_https_upload_run,
+  };
+  prv_run_benchmark(&benchmark);
+
+  sMfltIngestionDeviceStats stats;
+  CHECK(memfault_ingestion_server_get_device_stats(server, "DAABBCCDD", &stats));
+  LONGS_EQUAL(0, stats.decoder.num_crc_errors);
+  LONGS_EQUAL(stats.num_requests, stats.decoder.num_messages);
+  memfault_ingestion_server_stop(server);
+}
+
+TEST(MfltBenchmarks, UploadMqttQos1) {
+  sMfltMqttIngestionServerConfig config;
+  memset(&config, 0, sizeof(config));
+  config.puback_delay_ms = UPLOAD_RTT_MS;
+  sMfltMqttIngestionServer *server = memfault_mqtt_ingestion_server_start(&config);
+  CHECK(server != NULL);
+  prv_mqtt_connect(memfault_mqtt_ingestion_server_get_port(server));
+
+  const sMfltBenchmark benchmark = {
+    .name = "upload_mqtt_qos1_8_msgs_20ms_rtt",
+    .bytes_per_op = prv_upload_total_size(),
+    .setup = prv_upload_queue_msgs,
+    .run = prv_mqtt_upload_run,
+  };
+  prv_run_benchmark(&benchmark);
+
+  sMfltMqttIngestionDeviceStats stats;
+  CHECK(memfault_mqtt_ingestion_server_get_device_stats(server, "DAABBCCDD", &stats));
+  LONGS_EQUAL(0, stats.decoder.num_crc_errors);
+  CHECK(stats.decoder.num_messages != 0);
+  close(s_mqtt_fd);
+  memfault_mqtt_ingestion_server_stop(server);
+}
@@ -232,3 +232,153 @@ TEST(MemfaultChunkTransport, Test_ChunkerMultiCallSingleChunk) {
   const uint8_t expected_msg_2[] = { 0x0, /* crc */ 0xF4, 0x79 };
   prv_check_chunk(&s_chunk_ctx, !md, 20 /* oversize buffer */, &expected_msg_2, sizeof(expected_msg_2));
 }
+
+TEST(MemfaultChunkTransport, Test_ChunkerFecParityChunks) {
+  uint8_t parity_buf[3];
+  s_chunk_ctx.fec_group_size = 2;
+  s_chunk_ctx.fec_parity_buf = parity_buf;
+  s_chunk_ctx.fec_parity_buf_len = sizeof(parity_buf);
+
+  // the data of each chunk is limited to the size of the parity buffer
+  const size_t receive_buf_size = 16;
+  const bool md = true;
+  const uint8_t expected_msg_1[] = { 0x58, 0x09, 0x1, 0x2, 0x3 };
+  prv_check_chunk(&s_chunk_ctx, md, receive_buf_size, &expected_msg_1, sizeof(expected_msg_1));
+  const uint8_t expected_msg_2[] = { 0xD0, 0x03, 0x4, 0x5, 0x6 };
+  prv_check_chunk(&s_chunk_ctx, md, receive_buf_size, &expected_msg_2, sizeof(expected_msg_2));
+
+  // parity of [0, 6) over 2 chunks
+  const uint8_t expected_parity_1[] = { 0xF0, 0x00, 0x06, 0x02, 0x5, 0x7, 0x5 };
+  prv_check_chunk(&s_chunk_ctx, md, receive_buf_size, &expected_parity_1,
+                  sizeof(expected_parity_1));
+
+  // the last data chunk still ends the message for receivers which ignore the parity
+  const uint8_t expected_msg_3[] = { 0x90, 0x06, 0x7, 0x8, 0xa, 0x1b, 0x13 };
+  prv_check_chunk(&s_chunk_ctx, md, receive_buf_size, &expected_msg_3, sizeof(expected_msg_3));
+
+  // the parity of the last group repeats the crc
+  const uint8_t expected_parity_2[] = { 0xB0, 0x06, 0x09, 0x01, 0x7, 0x8, 0xa, 0x1b, 0x13 };
+  prv_check_chunk(&s_chunk_ctx, !md, receive_buf_size, &expected_parity_2,
+                  sizeof(expected_parity_2));
+}
+
+TEST(MemfaultChunkTransport, Test_ChunkerFecSingleMsg) {
+  uint8_t parity_buf[16];
+  s_chunk_ctx.fec_group_size = 4;
+  s_chunk_ctx.fec_parity_buf = parity_buf;
+  s_chunk_ctx.fec_parity_buf_len = sizeof(parity_buf);
+
+  const bool md = true;
+  const uint8_t expected_msg[] = { 0x18, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8, 0xa, 0x1b, 0x13 };
+  prv_check_chunk(&s_chunk_ctx, md, 32, &expected_msg, sizeof(expected_msg));
+
+  const uint8_t expected_parity[] = { 0xB0, 0x00, 0x09, 0x01, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7,
+                                      0x8, 0xa, 0x1b, 0x13 };
+  prv_check_chunk(&s_chunk_ctx, !md, 32, &expected_parity, sizeof(expected_parity));
+}
+
+TEST(MemfaultChunkTransport, Test_ChunkerFecParitySkippedWhenBufferShrinks) {
+  uint8_t parity_buf[4];
+  s_chunk_ctx.fec_group_size = 2;
+  s_chunk_ctx.fec_parity_buf = parity_buf;
+  s_chunk_ctx.fec_parity_buf_len = sizeof(parity_buf);
+
+  const bool md = true;
+  const uint8_t expected_msg_1[] = { 0x58, 0x09, 0x1, 0x2, 0x3, 0x4 };
+  prv_check_chunk(&s_chunk_ctx, md, 16, &expected_msg_1, sizeof(expected_msg_1));
+  const uint8_t expected_msg_2[] = { 0xD0, 0x04, 0x5, 0x6, 0x7, 0x8 };
+  prv_check_chunk(&s_chunk_ctx, md, 16, &expected_msg_2, sizeof(expected_msg_2));
+
+  // the parity of the first group no longer fits so the next data chunk is sent instead
+  const uint8_t expected_msg_3[] = { 0x90, 0x08, 0xa, 0x1b, 0x13 };
+  prv_check_chunk(&s_chunk_ctx, md, 9, &expected_msg_3, sizeof(expected_msg_3));
+
+  const uint8_t expected_parity[] = { 0xB0, 0x08, 0x09, 0x01, 0xa, 0x1b, 0x13 };
+  prv_check_chunk(&s_chunk_ctx, !md, 16, &expected_parity, sizeof(expected_parity));
+}
+
+TEST(MemfaultChunkTransport, Test_ChunkerFecIgnoredForMultiCallChunk) {
+  uint8_t parity_buf[4];
+  s_chunk_ctx.enable_multi_call_chunk = true;
+  s_chunk_ctx.fec_group_size = 2;
+  s_chunk_ctx.fec_parity_buf = parity_buf;
+  s_chunk_ctx.fec_parity_buf_len = sizeof(parity_buf);
+
+  const bool md = true;
+  const uint8_t expected_msg_all[] = { 0x08, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8, 0xa, 0x1b,
+                                       0x13 };
+  prv_check_chunk(&s_chunk_ctx, !md, sizeof(expected_msg_all), &expected_msg_all,
+                  sizeof(expected_msg_all));
+}
+
+static void prv_check_chunk_at_offset(sMfltChunkTransportCtx *ctx, uint32_t offset,
+                                      size_t receive_buf_len, const void *expected_chunk,
+                                      size_t expected_chunk_len) {
+  // a regenerated chunk is read again out of order, which the read-once checks don't account for
+  const sMfltChunkReadStats read_stats = s_chunk_read_stats;
+  s_chunk_read_stats.last_offset = 0;
+
+  uint8_t actual_chunk[receive_buf_len];
+  memset(actual_chunk, 0x0, receive_buf_len);
+  CHECK(memfault_chunk_transport_get_chunk_at_offset(ctx, offset, &actual_chunk[0],
+                                                     &receive_buf_len));
+  LONGS_EQUAL(expected_chunk_len, receive_buf_len);
+  MEMCMP_EQUAL(expected_chunk, actual_chunk, expected_chunk_len);
+
+  s_chunk_read_stats = read_stats;
+}
+
+TEST(MemfaultChunkTransport, Test_ChunkAtOffset) {
+  const size_t receive_buf_size = 9;
+  const bool md = true;
+  uint8_t chunk[receive_buf_size];
+  size_t chunk_len = sizeof(chunk);
+
+  // nothing has been chunked yet
+  CHECK(!memfault_chunk_transport_get_chunk_at_offset(&s_chunk_ctx, 0, chunk, &chunk_len));
+  LONGS_EQUAL(0, chunk_len);
+
+  const uint8_t expected_msg_1[] = { 0x48, 0x09, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7 };
+  prv_check_chunk(&s_chunk_ctx, md, receive_buf_size, &expected_msg_1, sizeof(expected_msg_1));
+  prv_check_chunk_at_offset(&s_chunk_ctx, 0, receive_buf_size, &expected_msg_1,
+                            sizeof(expected_msg_1));
+
+  // the rest of the message hasn't been chunked yet
+  chunk_len = sizeof(chunk);
+  CHECK(!memfault_chunk_transport_get_chunk_at_offset(&s_chunk_ctx, 7, chunk, &chunk_len));
+
+  // regenerating a chunk doesn't disturb the chunking in progress
+  const uint8_t expected_msg_2[] = { 0x80, 0x7, 0x8, 0xa, 0x1b, 0x13 };
+  prv_check_chunk(&s_chunk_ctx, !md, receive_buf_size, &expected_msg_2, sizeof(expected_msg_2));
+
+  // the last chunk holds the crc
+  prv_check_chunk_at_offset(&s_chunk_ctx, 7, receive_buf_size, &expected_msg_2,
+                            sizeof(expected_msg_2));
+  prv_check_chunk_at_offset(&s_chunk_ctx, 0, receive_buf_size, &expected_msg_1,
+                            sizeof(expected_msg_1));
+
+  // chunks can start at any offset
+  const uint8_t expected_msg_3[] = { 0xC0, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8, 0xa };
+  prv_check_chunk_at_offset(&s_chunk_ctx, 3, receive_buf_size, &expected_msg_3,
+                            sizeof(expected_msg_3));
+
+  // or span the whole message once it has been chunked
+  const uint8_t expected_msg_all[] = { 0x08, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8, 0xa, 0x1b,
+                                       0x13 };
+  prv_check_chunk_at_offset(&s_chunk_ctx, 0, 20, &expected_msg_all, sizeof(expected_msg_all));
+}
+
+TEST(MemfaultChunkTransport, Test_ChunkAtOffsetMultiCallChunk) {
+  s_chunk_ctx.enable_multi_call_chunk = true;
+
+  const bool md = true;
+  const uint8_t expected_msg_all[] = { 0x08, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8, 0xa, 0x1b,
+                                       0x13 };
+  prv_check_chunk(&s_chunk_ctx, !md, sizeof(expected_msg_all), &expected_msg_all,
+                  sizeof(expected_msg_all));
+
+  uint8_t chunk[sizeof(expected_msg_all)];
+  size_t chunk_len = sizeof(chunk);
+  CHECK(!memfault_chunk_transport_get_chunk_at_offset(&s_chunk_ctx, 0, chunk, &chunk_len));
+  LONGS_EQUAL(0, chunk_len);
+}
@@ -0,0 +1,590 @@
+//! @file
+//!
+//! Drives the CoAP Block1 upload with a fake transport to check the requests it builds and how it
+//! reacts to lost, duplicated and unexpected responses. See test_memfault_coap_ingestion_server.cpp
+//! for uploads to the stand-in server.
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <string.h>
+
+extern "C" {
+  #include "fakes/fake_memfault_event_data_source.h"
+  #include "memfault/coap/block_upload.h"
+  #include "memfault/core/compiler.h"
+  #include "memfault/core/data_packetizer.h"
+  #include "memfault/core/math.h"
+  #include "memfault_ingestion_decoder.h"
+}
+
+#define PROJECT_KEY "00112233445566778899aabbccddeeff"
+#define DEVICE_SERIAL "DAABBCCDD"
+
+//
+// A fake transport which records the datagrams sent
+//
+
+#define MAX_DATAGRAMS 64
+
+typedef struct {
+  uint8_t data[MEMFAULT_COAP_UPLOAD_TX_BUF_SIZE];
+  size_t len;
+} sDatagram;
+
+static sDatagram s_sent[MAX_DATAGRAMS];
+static size_t s_num_sent;
+static int s_send_rv;
+
+static int prv_send(MEMFAULT_UNUSED void *ctx, const void *datagram, size_t datagram_len) {
+  if (s_send_rv != 0) {
+    return s_send_rv;
+  }
+  CHECK(s_num_sent < MAX_DATAGRAMS);
+  CHECK(datagram_len <= sizeof(s_sent[0].data));
+  memcpy(s_sent[s_num_sent].data, datagram, datagram_len);
+  s_sent[s_num_sent].len = datagram_len;
+  s_num_sent++;
+  return 0;
+}
+
+static const sMfltCoapUploadTransport s_transport = {
+  .send = prv_send,
+};
+
+static size_t s_num_complete;
+static eMfltCoapUploadResult s_result;
+
+static void prv_complete_cb(MEMFAULT_UNUSED sMfltCoapUpload *upload, eMfltCoapUploadResult result,
+                            MEMFAULT_UNUSED void *ctx) {
+  s_num_complete++;
+  s_result = result;
+}
+
+static uint32_t s_random;
+static size_t s_num_random_calls;
+
+uint32_t memfault_platform_coap_get_random(void) {
+  s_num_random_calls++;
+  return s_random;
+}
+
+static const sMfltCoapUploadConfig s_upload_config = {
+  .project_key = PROJECT_KEY,
+  .transport = &s_transport,
+  .complete_cb = prv_complete_cb,
+};
+
+//
+// Minimal CoAP helpers, written independently of the implementation under test
+//
+
+#define COAP_CON 0
+#define COAP_ACK 2
+#define COAP_RST 3
+
+#define CODE_POST 0x02
+#define CODE_CHANGED 0x44
+#define CODE_CONTINUE 0x5f
+#define CODE_UNAVAILABLE 0xa3
+
+typedef struct {
+  uint8_t type;
+  uint8_t code;
+  uint16_t message_id;
+  uint16_t token;
+  char uri_path[2][80];
+  size_t num_uri_path;
+  char uri_query[80];
+  uint32_t content_format;
+  bool has_block1;
+  uint32_t block1;
+  bool has_size1;
+  uint32_t size1;
+  const uint8_t *payload;
+  size_t payload_len;
+} sRequest;
+
+static uint32_t prv_read_ext(const uint8_t **p, uint32_t nibble) {
+  if (nibble == 13) {
+    return 13 + *(*p)++;
+  }
+  if (nibble == 14) {
+    const uint32_t value = 269 + (((uint32_t)(*p)[0] << 8) | (*p)[1]);
+    *p += 2;
+    return value;
+  }
+  return nibble;
+}
+
+static uint32_t prv_read_uint(const uint8_t *p, size_t len) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < len; i++) {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+static void prv_parse_request(const sDatagram *datagram, sRequest *req) {
+  memset(req, 0, sizeof(*req));
+  const uint8_t *p = datagram->data;
+  const uint8_t *end = p + datagram->len;
+  LONGS_EQUAL(1, p[0] >> 6);
+  req->type = (p[0] >> 4) & 0x3;
+  LONGS_EQUAL(2, p[0] & 0xf);
+  req->code = p[1];
+  req->message_id = (uint16_t)((p[2] << 8) | p[3]);
+  req->token = (uint16_t)((p[4] << 8) | p[5]);
+  p += 6;
+
+  uint32_t number = 0;
+  while ((p < end) && (*p != 0xff)) {
+    const uint8_t byte = *p++;
+    number += prv_read_ext(&p, byte >> 4);
+    const uint32_t len = prv_read_ext(&p, byte & 0xf);
+    switch (number) {
+      case 11:
+        CHECK(req->num_uri_path < 2);
+        memcpy(req->uri_path[req->num_uri_path++], p, len);
+        break;
+      case 12:
+        req->content_format = prv_read_uint(p, len);
+        break;
+      case 15:
+        memcpy(req->uri_query, p, len);
+        break;
+      case 27:
+        req->has_block1 = true;
+        req->block1 = prv_read_uint(p, len);
+        break;
+      case 60:
+        req->has_size1 = true;
+        req->size1 = prv_read_uint(p, len);
+        break;
+      default:
+        FAIL("unexpected option");
+    }
+    p += len;
+  }
+  CHECK(p < end);
+  p++; // payload marker
+  req->payload = p;
+  req->payload_len = (size_t)(end - p);
+}
+
+static size_t prv_build_msg(uint8_t *buf, uint8_t type, uint8_t code, uint16_t message_id,
+                            const uint16_t *token, const uint32_t *block1) {
+  size_t len = 0;
+  buf[len++] = (uint8_t)((1 << 6) | (type << 4) | ((token != NULL) ? 2 : 0));
+  buf[len++] = code;
+  buf[len++] = (uint8_t)(message_id >> 8);
+  buf[len++] = (uint8_t)(message_id & 0xff);
+  if (token != NULL) {
+    buf[len++] = (uint8_t)(*token >> 8);
+    buf[len++] = (uint8_t)(*token & 0xff);
+  }
+  if (block1 != NULL) {
+    // option 27: delta 13 + 14, a 3 byte value
+    buf[len++] = (13 << 4) | 3;
+    buf[len++] = 27 - 13;
+    buf[len++] = (uint8_t)(*block1 >> 16);
+    buf[len++] = (uint8_t)(*block1 >> 8);
+    buf[len++] = (uint8_t)(*block1 & 0xff);
+  }
+  return len;
+}
+
+//! Acknowledges the last request sent with a piggybacked response
+static void prv_ack_last_request(sMfltCoapUpload *upload, uint8_t code, const uint32_t *block1) {
+  sRequest req;
+  prv_parse_request(&s_sent[s_num_sent - 1], &req);
+  uint8_t rsp[16];
+  const size_t rsp_len = prv_build_msg(rsp, COAP_ACK, code, req.message_id, &req.token, block1);
+  memfault_coap_upload_on_datagram(upload, rsp, rsp_len);
+}
+
+//! Acknowledges the last request sent the way a server which accepts any block size would
+static void prv_accept_last_request(sMfltCoapUpload *upload) {
+  sRequest req;
+  prv_parse_request(&s_sent[s_num_sent - 1], &req);
+  const bool more = (req.block1 & 0x8) != 0;
+  prv_ack_last_request(upload, more ? CODE_CONTINUE : CODE_CHANGED, &req.block1);
+}
+
+//! Decodes the chunks posted (the payloads of the Block1 transfers) with the stand-in decoder
+static void prv_decode_chunks(const uint8_t *chunks, const size_t *chunk_lens, size_t num_chunks,
+                              sMfltIngestionStats *stats_out) {
+  sMfltIngestionDecoder decoder;
+  memfault_ingestion_decoder_init(&decoder, DEVICE_SERIAL, NULL, NULL);
+  size_t offset = 0;
+  for (size_t i = 0; i < num_chunks; i++) {
+    CHECK(memfault_ingestion_decoder_feed_chunk(&decoder, &chunks[offset], chunk_lens[i]));
+    offset += chunk_lens[i];
+  }
+  *stats_out = decoder.stats;
+  memfault_ingestion_decoder_deinit(&decoder);
+}
+
+static void prv_reset_fakes(void) {
+  fake_event_data_source_reset();
+  s_num_sent = 0;
+  s_send_rv = 0;
+  s_num_complete = 0;
+  s_result = kMfltCoapUploadResult_Success;
+  s_random = 0;
+  s_num_random_calls = 0;
+  memfault_packetizer_abort();
+}
+
+TEST_GROUP(MfltCoapBlockUpload) {
+  sMfltCoapUpload upload;
+
+  void setup() {
+    memset(&upload, 0, sizeof(upload));
+    prv_reset_fakes();
+  }
+
+  void teardown() {
+    mock().checkExpectations();
+    mock().clear();
+  }
+};
+
+TEST(MfltCoapBlockUpload, Test_NoDataFound) {
+  LONGS_EQUAL(kMfltCoapUploadStartStatus_NoDataFound,
+              memfault_coap_upload_start(&upload, &s_upload_config));
+  LONGS_EQUAL(0, s_num_sent);
+  CHECK_FALSE(memfault_coap_upload_in_progress(&upload));
+}
+
+TEST(MfltCoapBlockUpload, Test_BadInput) {
+  fake_event_data_source_queue_msg(300);
+  sMfltCoapUploadConfig cfg = s_upload_config;
+  cfg.transport = NULL;
+  CHECK(memfault_coap_upload_start(&upload, &cfg) < 0);
+
+  cfg = s_upload_config;
+  cfg.project_key = "0123456789012345678901234567890123456789012345678901234567890123456789";
+  CHECK(memfault_coap_upload_start(&upload, &cfg) < 0);
+  LONGS_EQUAL(0, s_num_sent);
+}
+
+TEST(MfltCoapBlockUpload, Test_RequestFormat) {
+  fake_event_data_source_queue_msg(300);
+  LONGS_EQUAL(kMfltCoapUploadStartStatus_Started,
+              memfault_coap_upload_start(&upload, &s_upload_config));
+  CHECK(memfault_coap_upload_in_progress(&upload));
+  LONGS_EQUAL(1, s_num_sent);
+
+  // 6 bytes of header and token, 36 bytes of options and the payload marker leave room for
+  // 128 byte blocks in a 256 byte buffer
+  LONGS_EQUAL(128, upload.block_size);
+
+  sRequest req;
+  prv_parse_request(&s_sent[0], &req);
+  LONGS_EQUAL(COAP_CON, req.type);
+  LONGS_EQUAL(CODE_POST, req.code);
+  LONGS_EQUAL(2, req.num_uri_path);
+  STRCMP_EQUAL("chunks", req.uri_path[0]);
+  STRCMP_EQUAL(DEVICE_SERIAL, req.uri_path[1]);
+  STRCMP_EQUAL("key=" PROJECT_KEY, req.uri_query);
+  LONGS_EQUAL(42, req.content_format);
+  CHECK(req.has_block1);
+  // NUM 0, more blocks to come, 128 byte blocks
+  LONGS_EQUAL((0 << 4) | 0x8 | 3, req.block1);
+  CHECK(req.has_size1);
+  // the CBOR message, the message type byte, the chunk header byte and the CRC16
+  LONGS_EQUAL(300 + FAKE_EVENT_DATA_SOURCE_MSG_HDR_LEN + 1 + 1 + 2, req.size1);
+  LONGS_EQUAL(128, req.payload_len);
+  CHECK(s_sent[0].len <= MEMFAULT_COAP_UPLOAD_TX_BUF_SIZE);
+}
+
+TEST(MfltCoapBlockUpload, Test_MessageOnlyMarkedReadOnceFinalBlockIsAcked) {
+  fake_event_data_source_queue_msg(300);
+  fake_event_data_source_queue_msg(256);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+
+  uint8_t chunks[2][FAKE_EVENT_DATA_SOURCE_MAX_MSG_LEN];
+  size_t chunk_lens[2] = { 0 };
+  size_t msg_idx = 0;
+  uint32_t size1 = 0;
+  uint16_t last_message_id = 0;
+  size_t num_requests = 0;
+  while (memfault_coap_upload_in_progress(&upload)) {
+    sRequest req;
+    prv_parse_request(&s_sent[s_num_sent - 1], &req);
+    if (num_requests != 0) {
+      LONGS_EQUAL((uint16_t)(last_message_id + 1), req.message_id);
+    }
+    last_message_id = req.message_id;
+    num_requests++;
+
+    const uint32_t num = req.block1 >> 4;
+    if (num == 0) {
+      CHECK(req.has_size1);
+      size1 = req.size1;
+    } else {
+      CHECK_FALSE(req.has_size1);
+    }
+    LONGS_EQUAL(chunk_lens[msg_idx], num * 128);
+    memcpy(&chunks[msg_idx][chunk_lens[msg_idx]], req.payload, req.payload_len);
+    chunk_lens[msg_idx] += req.payload_len;
+
+    const bool more = (req.block1 & 0x8) != 0;
+    // nothing is deleted from the data source until the whole chunk has been acknowledged
+    LONGS_EQUAL(msg_idx, fake_event_data_source_get_num_msgs_read());
+    prv_accept_last_request(&upload);
+    if (!more) {
+      LONGS_EQUAL(size1, chunk_lens[msg_idx]);
+      msg_idx++;
+      LONGS_EQUAL(msg_idx, fake_event_data_source_get_num_msgs_read());
+    }
+  }
+
+  LONGS_EQUAL(1, s_num_complete);
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, s_result);
+  LONGS_EQUAL(2, msg_idx);
+  LONGS_EQUAL(2, upload.stats.num_messages);
+  LONGS_EQUAL(num_requests, upload.stats.num_blocks);
+  LONGS_EQUAL(0, upload.stats.num_retransmissions);
+
+  sMfltIngestionStats stats;
+  prv_decode_chunks(&chunks[0][0], chunk_lens, 1, &stats);
+  LONGS_EQUAL(1, stats.num_messages);
+  prv_decode_chunks(&chunks[1][0], &chunk_lens[1], 1, &stats);
+  LONGS_EQUAL(1, stats.num_messages);
+}
+
+TEST(MfltCoapBlockUpload, Test_LostAckIsRetransmitted) {
+  fake_event_data_source_queue_msg(300);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+  prv_accept_last_request(&upload);
+  LONGS_EQUAL(2, s_num_sent);
+  LONGS_EQUAL(MEMFAULT_COAP_ACK_TIMEOUT_MS, memfault_coap_upload_get_timeout_ms(&upload));
+
+  // the block is resent as is, with the same message ID, and the timeout doubles
+  memfault_coap_upload_on_timeout(&upload);
+  LONGS_EQUAL(3, s_num_sent);
+  LONGS_EQUAL(s_sent[1].len, s_sent[2].len);
+  MEMCMP_EQUAL(s_sent[1].data, s_sent[2].data, s_sent[1].len);
+  LONGS_EQUAL(2 * MEMFAULT_COAP_ACK_TIMEOUT_MS, memfault_coap_upload_get_timeout_ms(&upload));
+
+  // a late acknowledgement of the first block is ignored
+  sRequest first;
+  prv_parse_request(&s_sent[0], &first);
+  uint8_t rsp[16];
+  const size_t rsp_len =
+      prv_build_msg(rsp, COAP_ACK, CODE_CONTINUE, first.message_id, &first.token, &first.block1);
+  memfault_coap_upload_on_datagram(&upload, rsp, rsp_len);
+  LONGS_EQUAL(3, s_num_sent);
+
+  while (memfault_coap_upload_in_progress(&upload)) {
+    prv_accept_last_request(&upload);
+  }
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, s_result);
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+  LONGS_EQUAL(1, upload.stats.num_retransmissions);
+}
+
+TEST(MfltCoapBlockUpload, Test_TimeoutKeepsMessage) {
+  fake_event_data_source_queue_msg(300);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+  prv_accept_last_request(&upload);
+
+  for (size_t i = 0; i < MEMFAULT_COAP_MAX_RETRANSMIT; i++) {
+    memfault_coap_upload_on_timeout(&upload);
+    CHECK(memfault_coap_upload_in_progress(&upload));
+  }
+  LONGS_EQUAL(2 + MEMFAULT_COAP_MAX_RETRANSMIT, s_num_sent);
+  memfault_coap_upload_on_timeout(&upload);
+  CHECK_FALSE(memfault_coap_upload_in_progress(&upload));
+  LONGS_EQUAL(1, s_num_complete);
+  LONGS_EQUAL(kMfltCoapUploadResult_Timeout, s_result);
+  LONGS_EQUAL(0, fake_event_data_source_get_num_msgs_read());
+
+  // the next upload starts the message over from the first block
+  s_num_sent = 0;
+  LONGS_EQUAL(kMfltCoapUploadStartStatus_Started,
+              memfault_coap_upload_start(&upload, &s_upload_config));
+  sRequest req;
+  prv_parse_request(&s_sent[0], &req);
+  LONGS_EQUAL(0, req.block1 >> 4);
+  while (memfault_coap_upload_in_progress(&upload)) {
+    prv_accept_last_request(&upload);
+  }
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, s_result);
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+}
+
+TEST(MfltCoapBlockUpload, Test_ErrorResponse) {
+  fake_event_data_source_queue_msg(300);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+  prv_ack_last_request(&upload, CODE_UNAVAILABLE, NULL);
+  CHECK_FALSE(memfault_coap_upload_in_progress(&upload));
+  LONGS_EQUAL(kMfltCoapUploadResult_ResponseError, s_result);
+  LONGS_EQUAL(CODE_UNAVAILABLE, upload.response_code);
+  LONGS_EQUAL(0, fake_event_data_source_get_num_msgs_read());
+  CHECK(memfault_packetizer_data_available());
+}
+
+TEST(MfltCoapBlockUpload, Test_ResetMessage) {
+  fake_event_data_source_queue_msg(300);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+  sRequest req;
+  prv_parse_request(&s_sent[0], &req);
+  uint8_t rst[4];
+  const size_t rst_len = prv_build_msg(rst, COAP_RST, 0, req.message_id, NULL, NULL);
+  memfault_coap_upload_on_datagram(&upload, rst, rst_len);
+  CHECK_FALSE(memfault_coap_upload_in_progress(&upload));
+  LONGS_EQUAL(kMfltCoapUploadResult_Reset, s_result);
+  LONGS_EQUAL(0, fake_event_data_source_get_num_msgs_read());
+}
+
+TEST(MfltCoapBlockUpload, Test_SendError) {
+  fake_event_data_source_queue_msg(300);
+  s_send_rv = -1;
+  LONGS_EQUAL(kMfltCoapUploadStartStatus_Started,
+              memfault_coap_upload_start(&upload, &s_upload_config));
+  CHECK_FALSE(memfault_coap_upload_in_progress(&upload));
+  LONGS_EQUAL(kMfltCoapUploadResult_SendError, s_result);
+  LONGS_EQUAL(0, fake_event_data_source_get_num_msgs_read());
+}
+
+TEST(MfltCoapBlockUpload, Test_SeparateResponse) {
+  fake_event_data_source_queue_msg(256);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+  while (s_num_sent < 3) {
+    prv_accept_last_request(&upload);
+  }
+
+  // the server acknowledges the final block first and responds in a message of its own later
+  sRequest req;
+  prv_parse_request(&s_sent[s_num_sent - 1], &req);
+  LONGS_EQUAL(0, req.block1 & 0x8);
+  uint8_t msg[16];
+  size_t msg_len = prv_build_msg(msg, COAP_ACK, 0, req.message_id, NULL, NULL);
+  memfault_coap_upload_on_datagram(&upload, msg, msg_len);
+  CHECK(memfault_coap_upload_in_progress(&upload));
+  LONGS_EQUAL(MEMFAULT_COAP_ACK_TIMEOUT_MS << MEMFAULT_COAP_MAX_RETRANSMIT,
+              memfault_coap_upload_get_timeout_ms(&upload));
+
+  // a response with another token is not for us
+  const uint16_t other_token = (uint16_t)(req.token + 1);
+  msg_len = prv_build_msg(msg, COAP_CON, CODE_CHANGED, 0x1234, &other_token, NULL);
+  memfault_coap_upload_on_datagram(&upload, msg, msg_len);
+  CHECK(memfault_coap_upload_in_progress(&upload));
+  LONGS_EQUAL(3, s_num_sent);
+
+  // the confirmable response gets an empty ACK
+  msg_len = prv_build_msg(msg, COAP_CON, CODE_CHANGED, 0x1234, &req.token, NULL);
+  memfault_coap_upload_on_datagram(&upload, msg, msg_len);
+  CHECK_FALSE(memfault_coap_upload_in_progress(&upload));
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, s_result);
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+  LONGS_EQUAL(4, s_num_sent);
+  const uint8_t expected_ack[] = { 0x60, 0x00, 0x12, 0x34 };
+  LONGS_EQUAL(sizeof(expected_ack), s_sent[3].len);
+  MEMCMP_EQUAL(expected_ack, s_sent[3].data, sizeof(expected_ack));
+}
+
+TEST(MfltCoapBlockUpload, Test_ServerAsksForSmallerBlocks) {
+  fake_event_data_source_queue_msg(700);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+
+  uint8_t chunk[FAKE_EVENT_DATA_SOURCE_MAX_MSG_LEN];
+  size_t chunk_len = 0;
+  uint32_t size1 = 0;
+  while (memfault_coap_upload_in_progress(&upload)) {
+    sRequest req;
+    prv_parse_request(&s_sent[s_num_sent - 1], &req);
+    if (req.has_size1) {
+      size1 = req.size1;
+    }
+    const uint32_t num = req.block1 >> 4;
+    const uint32_t szx = req.block1 & 0x7;
+    const bool more = (req.block1 & 0x8) != 0;
+    // after the first block, every request is for a 32 byte block which follows on from the
+    // bytes the server took so far
+    LONGS_EQUAL(num * (16u << szx), chunk_len);
+    if (num != 0) {
+      LONGS_EQUAL(1, szx);
+    }
+
+    // the server takes the first 32 bytes of the block and asks for 32 byte blocks from now on
+    const size_t taken = MEMFAULT_MIN(req.payload_len, (size_t)32);
+    memcpy(&chunk[chunk_len], req.payload, taken);
+    const uint32_t rsp_num = (uint32_t)(chunk_len / 32);
+    chunk_len += taken;
+    const uint32_t block1 = (rsp_num << 4) | (more ? 0x8 : 0) | 1;
+    prv_ack_last_request(&upload, more ? CODE_CONTINUE : CODE_CHANGED, &block1);
+  }
+
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, s_result);
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+  LONGS_EQUAL(size1, chunk_len);
+  sMfltIngestionStats stats;
+  prv_decode_chunks(chunk, &chunk_len, 1, &stats);
+  LONGS_EQUAL(1, stats.num_messages);
+  LONGS_EQUAL(0, stats.num_crc_errors);
+}
+
+TEST(MfltCoapBlockUpload, Test_SmallTxBuffersGetSmallBlocks) {
+  // every block size down to 16 bytes hits the paths where the packetizer can't fill a block
+  // exactly and bytes are carried over to the next one
+  fake_event_data_source_queue_msg(1000);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+  uint8_t chunk[FAKE_EVENT_DATA_SOURCE_MAX_MSG_LEN];
+  size_t chunk_len = 0;
+  uint8_t szx = 6;
+  while (memfault_coap_upload_in_progress(&upload)) {
+    sRequest req;
+    prv_parse_request(&s_sent[s_num_sent - 1], &req);
+    const uint32_t num = req.block1 >> 4;
+    const bool more = (req.block1 & 0x8) != 0;
+    const size_t block_size = 16u << (req.block1 & 0x7);
+    LONGS_EQUAL(num * block_size, chunk_len);
+
+    // shrink the blocks one step at a time
+    szx = (uint8_t)MEMFAULT_MIN(szx, req.block1 & 0x7);
+    if (szx > 0) {
+      szx--;
+    }
+    const size_t taken = MEMFAULT_MIN(req.payload_len, (size_t)16 << szx);
+    memcpy(&chunk[chunk_len], req.payload, taken);
+    chunk_len += taken;
+    const uint32_t rsp_num = (uint32_t)(chunk_len / (16u << szx)) - 1;
+    const bool rsp_more = more || (taken < req.payload_len);
+    const uint32_t block1 = (rsp_num << 4) | (rsp_more ? 0x8 : 0) | szx;
+    prv_ack_last_request(&upload, rsp_more ? CODE_CONTINUE : CODE_CHANGED, &block1);
+  }
+
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, s_result);
+  sMfltIngestionStats stats;
+  prv_decode_chunks(chunk, &chunk_len, 1, &stats);
+  LONGS_EQUAL(1, stats.num_messages);
+  LONGS_EQUAL(16, upload.block_size);
+}
+
+TEST(MfltCoapBlockUpload, Test_MessageIdsSeededRandomlyOnce) {
+  s_random = 0x5a5affff;
+  fake_event_data_source_queue_msg(256);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+  LONGS_EQUAL(1, s_num_random_calls);
+  sRequest req;
+  prv_parse_request(&s_sent[0], &req);
+  LONGS_EQUAL(0xffff, req.message_id);
+  while (memfault_coap_upload_in_progress(&upload)) {
+    prv_accept_last_request(&upload);
+  }
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, s_result);
+  const size_t num_requests = s_num_sent;
+
+  // the next upload carries on from the IDs of the last one, wrapping around
+  fake_event_data_source_queue_msg(256);
+  memfault_coap_upload_start(&upload, &s_upload_config);
+  LONGS_EQUAL(1, s_num_random_calls);
+  prv_parse_request(&s_sent[num_requests], &req);
+  LONGS_EQUAL((uint16_t)(0xffff + num_requests), req.message_id);
+}
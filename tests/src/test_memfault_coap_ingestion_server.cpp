@@ -0,0 +1,264 @@
+//! @file
+//!
+//! Runs CoAP Block1 uploads against the CoAP stand-in server over a UDP socket, over a lossy link
+//! and with the server asking for smaller blocks, and checks the bytes they put on the air against
+//! posting the same chunks over HTTP.
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+  #include "fakes/fake_memfault_event_data_source.h"
+  #include "memfault/coap/block_upload.h"
+  #include "memfault/core/compiler.h"
+  #include "memfault/core/data_packetizer.h"
+  #include "memfault/core/math.h"
+  #include "memfault/http/http_client.h"
+  #include "memfault/http/utils.h"
+  #include "memfault_coap_ingestion_server.h"
+
+  sMfltHttpClientConfig g_mflt_http_client_config = {
+    .api_key = "00112233445566778899aabbccddeeff",
+  };
+}
+
+#define PROJECT_KEY "00112233445566778899aabbccddeeff"
+#define DEVICE_SERIAL "DAABBCCDD"
+
+static const size_t s_msg_sizes[] = { 256, 300, 1000, 1500, 420, 2000, 260, 777 };
+#define NUM_MSGS MEMFAULT_ARRAY_SIZE(s_msg_sizes)
+
+//! Queues the messages of s_msg_sizes in the fake event data source
+static void prv_queue_msgs(void) {
+  fake_event_data_source_reset();
+  for (size_t i = 0; i < NUM_MSGS; i++) {
+    fake_event_data_source_queue_msg(s_msg_sizes[i]);
+  }
+}
+
+//
+// A UDP transport connected to the stand-in server
+//
+
+typedef struct {
+  int fd;
+} sUdpTransport;
+
+static int prv_udp_send(void *ctx, const void *datagram, size_t datagram_len) {
+  sUdpTransport *transport = (sUdpTransport *)ctx;
+  const ssize_t rv = send(transport->fd, datagram, datagram_len, 0);
+  return (rv == (ssize_t)datagram_len) ? 0 : -1;
+}
+
+static const sMfltCoapUploadTransport s_udp_transport = {
+  .send = prv_udp_send,
+};
+
+static size_t s_num_complete;
+static eMfltCoapUploadResult s_result;
+
+static void prv_complete_cb(MEMFAULT_UNUSED sMfltCoapUpload *upload, eMfltCoapUploadResult result,
+                            MEMFAULT_UNUSED void *ctx) {
+  s_num_complete++;
+  s_result = result;
+}
+
+//! Runs the upload the way an event loop would, until it completes
+static eMfltCoapUploadResult prv_upload(sMfltCoapIngestionServer *server,
+                                        sMfltCoapUpload *upload) {
+  sUdpTransport transport;
+  transport.fd = socket(AF_INET, SOCK_DGRAM, 0);
+  CHECK(transport.fd >= 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(memfault_coap_ingestion_server_get_port(server));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  LONGS_EQUAL(0, connect(transport.fd, (struct sockaddr *)&addr, sizeof(addr)));
+
+  const sMfltCoapUploadConfig cfg = {
+    .project_key = PROJECT_KEY,
+    .transport = &s_udp_transport,
+    .transport_ctx = &transport,
+    .complete_cb = prv_complete_cb,
+  };
+  s_num_complete = 0;
+  LONGS_EQUAL(kMfltCoapUploadStartStatus_Started, memfault_coap_upload_start(upload, &cfg));
+
+  while (memfault_coap_upload_in_progress(upload)) {
+    struct pollfd pfd = { .fd = transport.fd, .events = POLLIN, .revents = 0 };
+    const int rv = poll(&pfd, 1, (int)memfault_coap_upload_get_timeout_ms(upload));
+    if (rv == 0) {
+      memfault_coap_upload_on_timeout(upload);
+      continue;
+    }
+    uint8_t datagram[1500];
+    const ssize_t len = recv(transport.fd, datagram, sizeof(datagram), 0);
+    if (len > 0) {
+      memfault_coap_upload_on_datagram(upload, datagram, (size_t)len);
+    }
+  }
+  close(transport.fd);
+  LONGS_EQUAL(1, s_num_complete);
+  return s_result;
+}
+
+static bool prv_count_bytes(MEMFAULT_UNUSED const void *data, size_t data_len, void *ctx) {
+  *(size_t *)ctx += data_len;
+  return true;
+}
+
+TEST_GROUP(MfltCoapIngestionServer) {
+  sMfltCoapUpload upload;
+  sMfltCoapIngestionServer *server;
+
+  void setup() {
+    memset(&upload, 0, sizeof(upload));
+    memfault_packetizer_abort();
+    prv_queue_msgs();
+    server = NULL;
+  }
+
+  void teardown() {
+    stop_server();
+    mock().checkExpectations();
+    mock().clear();
+  }
+
+  void start_server(size_t max_block_size) {
+    sMfltCoapIngestionServerConfig config;
+    memset(&config, 0, sizeof(config));
+    config.project_key = PROJECT_KEY;
+    config.max_block_size = max_block_size;
+    server = memfault_coap_ingestion_server_start(&config);
+    CHECK(server != NULL);
+  }
+
+  void stop_server() {
+    if (server != NULL) {
+      memfault_coap_ingestion_server_stop(server);
+      server = NULL;
+    }
+  }
+
+  void check_all_msgs_received(sMfltCoapIngestionDeviceStats *stats) {
+    CHECK(memfault_coap_ingestion_server_get_device_stats(server, DEVICE_SERIAL, stats));
+    LONGS_EQUAL(NUM_MSGS, stats->num_transfers);
+    LONGS_EQUAL(NUM_MSGS, stats->decoder.num_messages);
+    LONGS_EQUAL(NUM_MSGS, stats->decoder.num_other_events);
+    LONGS_EQUAL(0, stats->decoder.num_framing_errors);
+    LONGS_EQUAL(0, stats->decoder.num_dropped_messages);
+    LONGS_EQUAL(0, stats->decoder.num_crc_errors);
+    LONGS_EQUAL(0, stats->decoder.num_decode_errors);
+    LONGS_EQUAL(NUM_MSGS, fake_event_data_source_get_num_msgs_read());
+    LONGS_EQUAL(NUM_MSGS, upload.stats.num_messages);
+  }
+};
+
+TEST(MfltCoapIngestionServer, Test_Upload) {
+  start_server(0);
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, prv_upload(server, &upload));
+
+  sMfltCoapIngestionDeviceStats stats;
+  check_all_msgs_received(&stats);
+  LONGS_EQUAL(upload.stats.num_blocks, stats.num_requests);
+  LONGS_EQUAL(0, stats.num_duplicate_requests);
+  LONGS_EQUAL(upload.stats.tx_bytes, stats.rx_bytes);
+  LONGS_EQUAL(upload.stats.rx_bytes, stats.tx_bytes);
+}
+
+TEST(MfltCoapIngestionServer, Test_LossyLink) {
+  start_server(0);
+  // lose a request and two responses, the latter make the server see duplicates
+  memfault_coap_ingestion_server_drop_datagrams(server, 1, 2);
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, prv_upload(server, &upload));
+
+  sMfltCoapIngestionDeviceStats stats;
+  check_all_msgs_received(&stats);
+  LONGS_EQUAL(3, upload.stats.num_retransmissions);
+  LONGS_EQUAL(2, stats.num_duplicate_requests);
+}
+
+TEST(MfltCoapIngestionServer, Test_ServerAsksForSmallerBlocks) {
+  start_server(32);
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, prv_upload(server, &upload));
+
+  sMfltCoapIngestionDeviceStats stats;
+  check_all_msgs_received(&stats);
+  LONGS_EQUAL(32, upload.block_size);
+}
+
+TEST(MfltCoapIngestionServer, Test_ServerUnavailable) {
+  start_server(0);
+  memfault_coap_ingestion_server_set_response(server, 0xa3);
+  LONGS_EQUAL(kMfltCoapUploadResult_ResponseError, prv_upload(server, &upload));
+  LONGS_EQUAL(0xa3, upload.response_code);
+  LONGS_EQUAL(0, fake_event_data_source_get_num_msgs_read());
+
+  // nothing was lost, everything goes through once the server is back
+  memfault_coap_ingestion_server_set_response(server, 0);
+  LONGS_EQUAL(kMfltCoapUploadResult_Success, prv_upload(server, &upload));
+  sMfltCoapIngestionDeviceStats stats;
+  check_all_msgs_received(&stats);
+}
+
+//! Posting every message as one chunk over HTTP, as memfault_http_async_upload.c does, costs the
+//! request line and headers, the chunk and the response of the stand-in HTTP server for each
+//! message. The TCP and TLS overheads of HTTP come on top of that and are not counted, nor are the
+//! UDP and IP headers of every CoAP datagram. The counts are deterministic, so they are checked
+//! exactly: a change in the framing of either transport shows up here.
+TEST(MfltCoapIngestionServer, Test_BytesOnAirComparedToHttp) {
+  const char http_response[] =
+      "HTTP/1.1 202 Accepted\r\nConnection: keep-alive\r\nContent-Length: 8\r\n\r\nAccepted";
+  size_t http_bytes = 0;
+  size_t chunk_bytes = 0;
+  for (size_t i = 0; i < NUM_MSGS; i++) {
+    // the message, its type byte, the chunk header byte and the CRC16 in a single chunk
+    const size_t msg_chunk_len = s_msg_sizes[i] + FAKE_EVENT_DATA_SOURCE_MSG_HDR_LEN + 1 + 1 + 2;
+    CHECK(memfault_http_start_chunk_post(prv_count_bytes, &http_bytes, msg_chunk_len));
+    http_bytes += msg_chunk_len + (sizeof(http_response) - 1);
+    chunk_bytes += msg_chunk_len;
+  }
+  LONGS_EQUAL(6585, chunk_bytes);
+  LONGS_EQUAL(8900, http_bytes);
+
+  static const struct {
+    size_t block_size;
+    size_t num_blocks;
+    size_t bytes_on_air;
+  } s_expected[] = {
+    { 1024, 10, 7367 },
+    { 512, 14, 8179 },
+    { 256, 25, 9260 },
+    { 128, 45, 10888 },
+    { 64, 84, 13925 },
+  };
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(s_expected); i++) {
+    memset(&upload, 0, sizeof(upload));
+    prv_queue_msgs();
+    start_server(s_expected[i].block_size);
+    LONGS_EQUAL(kMfltCoapUploadResult_Success, prv_upload(server, &upload));
+    sMfltCoapIngestionDeviceStats stats;
+    check_all_msgs_received(&stats);
+    LONGS_EQUAL(chunk_bytes, stats.decoder.chunk_bytes);
+    stop_server();
+
+    const size_t coap_bytes = upload.stats.tx_bytes + upload.stats.rx_bytes;
+    LONGS_EQUAL(s_expected[i].num_blocks, upload.stats.num_blocks);
+    LONGS_EQUAL(s_expected[i].bytes_on_air, coap_bytes);
+    if (s_expected[i].block_size >= 512) {
+      // with blocks this size the options repeated in every request cost less than the headers
+      // of an HTTP request and response per chunk
+      CHECK(coap_bytes < http_bytes);
+    }
+  }
+}
@@ -0,0 +1,112 @@
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <string.h>
+
+extern "C" {
+  #include "memfault/panics/crash_loop_policy.h"
+  #include "memfault/panics/reboot_tracking.h"
+
+  static uint8_t s_mflt_reboot_tracking_region[MEMFAULT_REBOOT_TRACKING_REGION_SIZE];
+
+  void memfault_platform_crash_loop_enter_safe_mode(size_t crash_count) {
+    mock().actualCall(__func__).withParameter("crash_count", crash_count);
+  }
+}
+
+TEST_GROUP(MfltCrashLoopPolicy) {
+  void setup() {
+    memset(&s_mflt_reboot_tracking_region[0], 0xBA, sizeof(s_mflt_reboot_tracking_region));
+    memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
+    memfault_reboot_tracking_reset_crash_count();
+  }
+
+  void teardown() {
+    mock().checkExpectations();
+    mock().clear();
+  }
+};
+
+//! Mirrors what the Memfault fault handlers do when a crash takes place followed by the
+//! system booting back up
+//!
+//! @return true if a coredump would have been captured for the crash
+static bool prv_simulate_crash_and_reboot(void) {
+  memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_HardFault, NULL);
+  const bool coredump_captured = memfault_crash_loop_policy_should_capture_coredump();
+  memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
+  return coredump_captured;
+}
+
+static void prv_simulate_user_reboot(void) {
+  memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_UserReset, NULL);
+  memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
+}
+
+TEST(MfltCrashLoopPolicy, Test_CoredumpBackoff) {
+  bool captured[21] = { 0 };
+  for (size_t crash = 1; crash < sizeof(captured); crash++) {
+    captured[crash] = prv_simulate_crash_and_reboot();
+    LONGS_EQUAL(crash, memfault_reboot_tracking_get_crash_count());
+  }
+
+  for (size_t crash = 1; crash < sizeof(captured); crash++) {
+    const bool expected = (crash == 1) || (crash == 2) || (crash == 3) || (crash == 4) ||
+        (crash == 6) || (crash == 10) || (crash == 18);
+    LONGS_EQUAL(expected, captured[crash]);
+  }
+}
+
+TEST(MfltCrashLoopPolicy, Test_BootWorkAndSafeMode) {
+  LONGS_EQUAL(kMfltCrashLoopState_Normal, memfault_crash_loop_policy_boot());
+  CHECK(memfault_crash_loop_policy_should_run_boot_work());
+
+  for (size_t crash = 1; crash < MEMFAULT_CRASH_LOOP_SAFE_MODE_THRESHOLD; crash++) {
+    prv_simulate_crash_and_reboot();
+    const eMfltCrashLoopState state = memfault_crash_loop_policy_boot();
+    if (crash < MEMFAULT_CRASH_LOOP_SKIP_BOOT_WORK_THRESHOLD) {
+      LONGS_EQUAL(kMfltCrashLoopState_Normal, state);
+      CHECK(memfault_crash_loop_policy_should_run_boot_work());
+    } else {
+      LONGS_EQUAL(kMfltCrashLoopState_SkipBootWork, state);
+      CHECK(!memfault_crash_loop_policy_should_run_boot_work());
+    }
+  }
+
+  prv_simulate_crash_and_reboot();
+  mock().expectOneCall("memfault_platform_crash_loop_enter_safe_mode")
+      .withParameter("crash_count", (size_t)MEMFAULT_CRASH_LOOP_SAFE_MODE_THRESHOLD);
+  LONGS_EQUAL(kMfltCrashLoopState_SafeMode, memfault_crash_loop_policy_boot());
+  CHECK(!memfault_crash_loop_policy_should_run_boot_work());
+}
+
+TEST(MfltCrashLoopPolicy, Test_HealthySystemRecovers) {
+  for (size_t crash = 0; crash < MEMFAULT_CRASH_LOOP_SKIP_BOOT_WORK_THRESHOLD; crash++) {
+    prv_simulate_crash_and_reboot();
+  }
+  LONGS_EQUAL(kMfltCrashLoopState_SkipBootWork, memfault_crash_loop_policy_boot());
+
+  // expected reboots don't count as crashes
+  prv_simulate_user_reboot();
+  LONGS_EQUAL(kMfltCrashLoopState_SkipBootWork, memfault_crash_loop_policy_boot());
+
+  // the application declares the system healthy
+  memfault_reboot_tracking_reset_crash_count();
+  prv_simulate_user_reboot();
+  LONGS_EQUAL(kMfltCrashLoopState_Normal, memfault_crash_loop_policy_boot());
+  CHECK(memfault_crash_loop_policy_should_run_boot_work());
+  CHECK(prv_simulate_crash_and_reboot());
+}
+
+TEST(MfltCrashLoopPolicy, Test_CrashCountSaturates) {
+  for (size_t crash = 0; crash < 300; crash++) {
+    prv_simulate_crash_and_reboot();
+  }
+  LONGS_EQUAL(UINT8_MAX, memfault_reboot_tracking_get_crash_count());
+
+  mock().expectOneCall("memfault_platform_crash_loop_enter_safe_mode")
+      .withParameter("crash_count", (size_t)UINT8_MAX);
+  LONGS_EQUAL(kMfltCrashLoopState_SafeMode, memfault_crash_loop_policy_boot());
+}
@@ -114,12 +114,24 @@ bool memfault_chunk_transport_get_next_chunk(sMfltChunkTransportCtx *ctx,
                                              void *buf, size_t *buf_len) {
   LONGS_EQUAL(s_multi_call_chunking_enabled, ctx->enable_multi_call_chunk);
   const size_t bytes_to_read = MEMFAULT_MIN(*buf_len, ctx->total_size - ctx->read_offset);
-  ctx->read_msg(ctx->read_offset, buf, bytes_to_read);
+  ctx->ctx_read_msg(ctx->read_msg_ctx, ctx->read_offset, buf, bytes_to_read);
   ctx->read_offset += bytes_to_read;
   *buf_len = bytes_to_read;
   return (ctx->read_offset != ctx->total_size);
 }
 
+bool memfault_chunk_transport_get_chunk_at_offset(sMfltChunkTransportCtx *ctx, uint32_t offset,
+                                                  void *buf, size_t *buf_len) {
+  if (ctx->enable_multi_call_chunk || (offset >= ctx->read_offset)) {
+    *buf_len = 0;
+    return false;
+  }
+  const size_t bytes_to_read = MEMFAULT_MIN(*buf_len, ctx->read_offset - offset);
+  ctx->ctx_read_msg(ctx->read_msg_ctx, offset, buf, bytes_to_read);
+  *buf_len = bytes_to_read;
+  return true;
+}
+
 void memfault_chunk_transport_get_chunk_info(sMfltChunkTransportCtx *ctx) {
   // fake chunker has 0 overhead so total_chunk_size just matches that
   ctx->single_chunk_message_length = ctx->total_size;
@@ -482,3 +494,558 @@ TEST(MemfaultDataPacketizer, Test_BadArguments) {
   md = memfault_packetizer_begin(&cfg, NULL);
   CHECK(!md);
 }
+
+//
+// Packetizer instances
+//
+
+typedef struct {
+  const uint8_t *msg;
+  size_t msg_len;
+  size_t num_msgs;
+} sTestInstanceSource;
+
+static bool prv_instance_has_msg(void *ctx, size_t *total_size_out) {
+  const sTestInstanceSource *source = (const sTestInstanceSource *)ctx;
+  *total_size_out = source->msg_len;
+  return source->num_msgs != 0;
+}
+
+static bool prv_instance_read_msg(void *ctx, uint32_t offset, void *buf, size_t buf_len) {
+  const sTestInstanceSource *source = (const sTestInstanceSource *)ctx;
+  CHECK((offset + buf_len) <= source->msg_len);
+  memcpy(buf, &source->msg[offset], buf_len);
+  return true;
+}
+
+static void prv_instance_mark_msg_read(void *ctx) {
+  sTestInstanceSource *source = (sTestInstanceSource *)ctx;
+  source->num_msgs--;
+}
+
+static void prv_check_instance_chunk(sMfltPacketizerCtx *ctx, const uint8_t *expected_msg,
+                                     size_t expected_msg_len) {
+  uint8_t chunk[16];
+  size_t chunk_len = sizeof(chunk);
+  CHECK(memfault_packetizer_ctx_get_chunk(ctx, chunk, &chunk_len));
+  LONGS_EQUAL(expected_msg_len + 1 /* hdr */, chunk_len);
+  // event message type
+  LONGS_EQUAL(2, chunk[0]);
+  MEMCMP_EQUAL(expected_msg, &chunk[1], expected_msg_len);
+}
+
+TEST(MemfaultDataPacketizer, Test_IndependentInstances) {
+  const uint8_t msg_a[] = { 0xa1, 0xa2, 0xa3 };
+  const uint8_t msg_b[] = { 0xb1, 0xb2, 0xb3, 0xb4, 0xb5 };
+  sTestInstanceSource source_a = { .msg = msg_a, .msg_len = sizeof(msg_a), .num_msgs = 2 };
+  sTestInstanceSource source_b = { .msg = msg_b, .msg_len = sizeof(msg_b), .num_msgs = 1 };
+
+  const sMemfaultDataSourceImpl impl_a = {
+    .ctx_has_more_msgs_cb = prv_instance_has_msg,
+    .ctx_read_msg_cb = prv_instance_read_msg,
+    .ctx_mark_msg_read_cb = prv_instance_mark_msg_read,
+    .ctx = &source_a,
+  };
+  const sMemfaultDataSourceImpl impl_b = {
+    .ctx_has_more_msgs_cb = prv_instance_has_msg,
+    .ctx_read_msg_cb = prv_instance_read_msg,
+    .ctx_mark_msg_read_cb = prv_instance_mark_msg_read,
+    .ctx = &source_b,
+  };
+
+  sMfltPacketizerCtx packetizer_a;
+  sMfltPacketizerCtx packetizer_b;
+  const sMfltPacketizerSources sources_a = { .event_source = &impl_a };
+  const sMfltPacketizerSources sources_b = { .event_source = &impl_b };
+  memfault_packetizer_ctx_init(&packetizer_a, &sources_a);
+  memfault_packetizer_ctx_init(&packetizer_b, &sources_b);
+
+  // Interleave the instances. None of the global data sources should be consulted (strict mock)
+  CHECK(memfault_packetizer_ctx_data_available(&packetizer_a));
+  CHECK(memfault_packetizer_ctx_data_available(&packetizer_b));
+  prv_check_instance_chunk(&packetizer_b, msg_b, sizeof(msg_b));
+  prv_check_instance_chunk(&packetizer_a, msg_a, sizeof(msg_a));
+  CHECK(!memfault_packetizer_ctx_data_available(&packetizer_b));
+  prv_check_instance_chunk(&packetizer_a, msg_a, sizeof(msg_a));
+  CHECK(!memfault_packetizer_ctx_data_available(&packetizer_a));
+
+  LONGS_EQUAL(0, source_a.num_msgs);
+  LONGS_EQUAL(0, source_b.num_msgs);
+}
+
+TEST(MemfaultDataPacketizer, Test_DeliveryConfirmation) {
+  const uint8_t msg[] = { 0xc1, 0xc2, 0xc3 };
+  sTestInstanceSource source = { .msg = msg, .msg_len = sizeof(msg), .num_msgs = 2 };
+  const sMemfaultDataSourceImpl impl = {
+    .ctx_has_more_msgs_cb = prv_instance_has_msg,
+    .ctx_read_msg_cb = prv_instance_read_msg,
+    .ctx_mark_msg_read_cb = prv_instance_mark_msg_read,
+    .ctx = &source,
+  };
+  sMfltPacketizerCtx packetizer;
+  const sMfltPacketizerSources sources = { .event_source = &impl };
+  memfault_packetizer_ctx_init(&packetizer, &sources);
+
+  prv_enable_multi_packet_chunks();
+  const sPacketizerConfig cfg = {
+    .enable_multi_packet_chunk = true,
+    .enable_delivery_confirmation = true,
+  };
+  sPacketizerMetadata metadata;
+  uint8_t packet[16];
+  size_t packet_len = sizeof(packet);
+  CHECK(memfault_packetizer_ctx_begin(&packetizer, &cfg, &metadata));
+  LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  LONGS_EQUAL(sizeof(msg) + 1 /* hdr */, packet_len);
+
+  // the message is kept until its delivery is confirmed
+  LONGS_EQUAL(2, source.num_msgs);
+  packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_NoMoreData,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+
+  // starting over without a confirmation sends the same message again
+  CHECK(memfault_packetizer_ctx_begin(&packetizer, &cfg, &metadata));
+  CHECK(!metadata.send_in_progress);
+  packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  MEMCMP_EQUAL(msg, &packet[1], sizeof(msg));
+  LONGS_EQUAL(2, source.num_msgs);
+
+  memfault_packetizer_ctx_confirm_delivery(&packetizer);
+  LONGS_EQUAL(1, source.num_msgs);
+  // a second confirmation is a no-op
+  memfault_packetizer_ctx_confirm_delivery(&packetizer);
+  LONGS_EQUAL(1, source.num_msgs);
+
+  // an aborted delivery is sent again too
+  CHECK(memfault_packetizer_ctx_begin(&packetizer, &cfg, &metadata));
+  packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  memfault_packetizer_ctx_abort(&packetizer);
+  memfault_packetizer_ctx_confirm_delivery(&packetizer);
+  LONGS_EQUAL(1, source.num_msgs);
+  CHECK(memfault_packetizer_ctx_data_available(&packetizer));
+}
+
+TEST(MemfaultDataPacketizer, Test_PacketAtOffset) {
+  const uint8_t msg[] = { 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda };
+  sTestInstanceSource source = { .msg = msg, .msg_len = sizeof(msg), .num_msgs = 1 };
+  const sMemfaultDataSourceImpl impl = {
+    .ctx_has_more_msgs_cb = prv_instance_has_msg,
+    .ctx_read_msg_cb = prv_instance_read_msg,
+    .ctx_mark_msg_read_cb = prv_instance_mark_msg_read,
+    .ctx = &source,
+  };
+  sMfltPacketizerCtx packetizer;
+  const sMfltPacketizerSources sources = { .event_source = &impl };
+  memfault_packetizer_ctx_init(&packetizer, &sources);
+
+  uint8_t packet[4];
+  size_t packet_len = sizeof(packet);
+  // no message in progress
+  CHECK(!memfault_packetizer_ctx_get_packet_at_offset(&packetizer, 0, packet, &packet_len));
+
+  const sPacketizerConfig cfg = {
+    .enable_multi_packet_chunk = false,
+    .enable_delivery_confirmation = true,
+  };
+  sPacketizerMetadata metadata;
+  CHECK(memfault_packetizer_ctx_begin(&packetizer, &cfg, &metadata));
+
+  // send the message in 4 byte packets, keeping them and their offsets
+  uint8_t packets[3][4];
+  size_t packet_lens[3];
+  uint32_t offsets[3];
+  for (size_t i = 0; i < 3; i++) {
+    offsets[i] = memfault_packetizer_ctx_get_next_offset(&packetizer);
+    packet_lens[i] = sizeof(packets[i]);
+    memfault_packetizer_ctx_get_next(&packetizer, packets[i], &packet_lens[i]);
+
+    if (i == 0) {
+      // the packet just sent can be regenerated and the next one follows on as usual
+      packet_len = sizeof(packet);
+      CHECK(memfault_packetizer_ctx_get_packet_at_offset(&packetizer, 0, packet, &packet_len));
+      LONGS_EQUAL(packet_lens[0], packet_len);
+      MEMCMP_EQUAL(packets[0], packet, packet_len);
+    }
+  }
+  LONGS_EQUAL(0, offsets[0]);
+  LONGS_EQUAL(4, offsets[1]);
+  LONGS_EQUAL(8, offsets[2]);
+  MEMCMP_EQUAL(&msg[3], packets[1], sizeof(packets[1]));
+
+  // the last packets can be resent until the delivery is confirmed
+  for (size_t i = 0; i < 3; i++) {
+    packet_len = sizeof(packet);
+    CHECK(memfault_packetizer_ctx_get_packet_at_offset(&packetizer, offsets[i], packet,
+                                                       &packet_len));
+    LONGS_EQUAL(packet_lens[i], packet_len);
+    MEMCMP_EQUAL(packets[i], packet, packet_len);
+  }
+  packet_len = sizeof(packet);
+  CHECK(!memfault_packetizer_ctx_get_packet_at_offset(&packetizer, sizeof(msg) + 1, packet,
+                                                      &packet_len));
+
+  memfault_packetizer_ctx_confirm_delivery(&packetizer);
+  LONGS_EQUAL(0, source.num_msgs);
+  packet_len = sizeof(packet);
+  CHECK(!memfault_packetizer_ctx_get_packet_at_offset(&packetizer, 0, packet, &packet_len));
+}
+
+//
+// Chunk sizing
+//
+
+TEST(MemfaultDataPacketizer, Test_TransportCapsSizePackets) {
+  uint8_t msg[300];
+  for (size_t i = 0; i < sizeof(msg); i++) {
+    msg[i] = (uint8_t)i;
+  }
+  sTestInstanceSource source = { .msg = msg, .msg_len = sizeof(msg), .num_msgs = 1 };
+  const sMemfaultDataSourceImpl impl = {
+    .ctx_has_more_msgs_cb = prv_instance_has_msg,
+    .ctx_read_msg_cb = prv_instance_read_msg,
+    .ctx_mark_msg_read_cb = prv_instance_mark_msg_read,
+    .ctx = &source,
+  };
+  sMfltPacketizerCtx packetizer;
+  const sMfltPacketizerSources sources = { .event_source = &impl };
+  memfault_packetizer_ctx_init(&packetizer, &sources);
+  LONGS_EQUAL(0, memfault_packetizer_ctx_get_packet_size(&packetizer));
+
+  // a BLE link: 3 bytes of ATT header in every packet and packets filling 64 byte frames
+  const sPacketizerTransportCaps caps = {
+    .mtu = 247,
+    .per_packet_overhead = 3,
+    .preferred_multiple = 64,
+  };
+  CHECK(memfault_packetizer_ctx_set_transport_caps(&packetizer, &caps));
+  LONGS_EQUAL(192 - 3, memfault_packetizer_ctx_get_packet_size(&packetizer));
+
+  const sPacketizerConfig cfg = { .enable_multi_packet_chunk = false };
+  sPacketizerMetadata metadata;
+  CHECK(memfault_packetizer_ctx_begin(&packetizer, &cfg, &metadata));
+  uint8_t packet[512];
+  size_t packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  LONGS_EQUAL(192 - 3, packet_len);
+  LONGS_EQUAL(2, packet[0]);
+  MEMCMP_EQUAL(msg, &packet[1], packet_len - 1);
+
+  // a smaller buffer still bounds the packet
+  packet_len = 50;
+  LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  LONGS_EQUAL(50, packet_len);
+  MEMCMP_EQUAL(&msg[192 - 3 - 1], packet, packet_len);
+
+  // the sizing survives an abort and can be turned off
+  memfault_packetizer_ctx_abort(&packetizer);
+  LONGS_EQUAL(192 - 3, memfault_packetizer_ctx_get_packet_size(&packetizer));
+  CHECK(memfault_packetizer_ctx_set_transport_caps(&packetizer, NULL));
+  LONGS_EQUAL(0, memfault_packetizer_ctx_get_packet_size(&packetizer));
+  CHECK(memfault_packetizer_ctx_begin(&packetizer, &cfg, &metadata));
+  packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  LONGS_EQUAL(sizeof(msg) + 1 /* hdr */, packet_len);
+  LONGS_EQUAL(0, source.num_msgs);
+}
+
+TEST(MemfaultDataPacketizer, Test_TransportCapsTooSmall) {
+  const sPacketizerTransportCaps no_room = {
+    .mtu = 11,
+    .per_packet_overhead = 3,
+    .preferred_multiple = 0,
+  };
+  CHECK(!memfault_packetizer_set_transport_caps(&no_room));
+  LONGS_EQUAL(0, memfault_packetizer_get_packet_size());
+
+  const sPacketizerTransportCaps all_overhead = {
+    .mtu = 20,
+    .per_packet_overhead = 20,
+    .preferred_multiple = 0,
+  };
+  CHECK(!memfault_packetizer_set_transport_caps(&all_overhead));
+
+  const sPacketizerTransportCaps just_enough = {
+    .mtu = 12,
+    .per_packet_overhead = 3,
+    .preferred_multiple = 0,
+  };
+  CHECK(memfault_packetizer_set_transport_caps(&just_enough));
+  LONGS_EQUAL(MEMFAULT_PACKETIZER_MIN_BUF_LEN, memfault_packetizer_get_packet_size());
+  CHECK(memfault_packetizer_set_transport_caps(NULL));
+}
+
+TEST(MemfaultDataPacketizer, Test_LinkFeedbackAdaptsPacketSize) {
+  const sPacketizerTransportCaps caps = {
+    .mtu = 247,
+    .per_packet_overhead = 3,
+    .preferred_multiple = 0,
+  };
+  // feedback is ignored until capabilities are set
+  memfault_packetizer_report_link_feedback(10, 10);
+  LONGS_EQUAL(0, memfault_packetizer_get_packet_size());
+
+  CHECK(memfault_packetizer_set_transport_caps(&caps));
+  LONGS_EQUAL(244, memfault_packetizer_get_packet_size());
+
+  // a lossy link halves the packets, down to an eighth of the largest
+  memfault_packetizer_report_link_feedback(10, 2);
+  LONGS_EQUAL(123 - 3, memfault_packetizer_get_packet_size());
+  memfault_packetizer_report_link_feedback(10, 2);
+  LONGS_EQUAL(61 - 3, memfault_packetizer_get_packet_size());
+  memfault_packetizer_report_link_feedback(10, 2);
+  LONGS_EQUAL(30 - 3, memfault_packetizer_get_packet_size());
+  memfault_packetizer_report_link_feedback(10, 10);
+  LONGS_EQUAL(30 - 3, memfault_packetizer_get_packet_size());
+
+  // a few retransmissions are tolerated but hold back the growth
+  memfault_packetizer_report_link_feedback(10, 0);
+  memfault_packetizer_report_link_feedback(100, 5);
+  memfault_packetizer_report_link_feedback(10, 0);
+  LONGS_EQUAL(30 - 3, memfault_packetizer_get_packet_size());
+
+  // packets grow back by an eighth of the largest once enough are sent cleanly
+  memfault_packetizer_report_link_feedback(MEMFAULT_PACKETIZER_GROW_AFTER_PACKETS - 10, 0);
+  LONGS_EQUAL(60 - 3, memfault_packetizer_get_packet_size());
+  for (size_t i = 0; i < 10; i++) {
+    memfault_packetizer_report_link_feedback(MEMFAULT_PACKETIZER_GROW_AFTER_PACKETS, 0);
+  }
+  LONGS_EQUAL(244, memfault_packetizer_get_packet_size());
+
+  // nothing was sent, nothing is learnt
+  memfault_packetizer_report_link_feedback(0, 0);
+  LONGS_EQUAL(244, memfault_packetizer_get_packet_size());
+  CHECK(memfault_packetizer_set_transport_caps(NULL));
+}
+
+TEST(MemfaultDataPacketizer, Test_LinkFeedbackKeepsPreferredMultiple) {
+  const sPacketizerTransportCaps caps = {
+    .mtu = 1280,
+    .per_packet_overhead = 48,
+    .preferred_multiple = 16,
+  };
+  CHECK(memfault_packetizer_set_transport_caps(&caps));
+  LONGS_EQUAL(1280 - 48, memfault_packetizer_get_packet_size());
+
+  for (size_t i = 0; i < 10; i++) {
+    memfault_packetizer_report_link_feedback(4, 4);
+    const size_t packet_len = memfault_packetizer_get_packet_size() + 48;
+    LONGS_EQUAL(0, packet_len % 16);
+    CHECK(packet_len >= 1280 / 8);
+  }
+  LONGS_EQUAL(160 - 48, memfault_packetizer_get_packet_size());
+
+  memfault_packetizer_report_link_feedback(MEMFAULT_PACKETIZER_GROW_AFTER_PACKETS, 0);
+  LONGS_EQUAL(320 - 48, memfault_packetizer_get_packet_size());
+  CHECK(memfault_packetizer_set_transport_caps(NULL));
+}
+
+//
+// Asynchronous reads
+//
+
+typedef struct {
+  sTestInstanceSource source;
+  bool start_read_fails;
+  size_t num_sync_reads;
+  size_t num_reads_started;
+  // the read in flight
+  bool read_in_flight;
+  uint32_t read_offset;
+  uint8_t *read_buf;
+  size_t read_len;
+  MemfaultDataSourceReadCompleteCallback *complete_cb;
+  void *complete_ctx;
+} sTestAsyncSource;
+
+static bool prv_async_source_read_msg(void *ctx, uint32_t offset, void *buf, size_t buf_len) {
+  sTestAsyncSource *async = (sTestAsyncSource *)ctx;
+  async->num_sync_reads++;
+  return prv_instance_read_msg(&async->source, offset, buf, buf_len);
+}
+
+static bool prv_async_source_has_msg(void *ctx, size_t *total_size_out) {
+  return prv_instance_has_msg(&((sTestAsyncSource *)ctx)->source, total_size_out);
+}
+
+static void prv_async_source_mark_msg_read(void *ctx) {
+  prv_instance_mark_msg_read(&((sTestAsyncSource *)ctx)->source);
+}
+
+static bool prv_async_source_start_read(void *ctx, uint32_t offset, void *buf, size_t buf_len,
+                                        MemfaultDataSourceReadCompleteCallback *complete_cb,
+                                        void *complete_ctx) {
+  sTestAsyncSource *async = (sTestAsyncSource *)ctx;
+  CHECK(!async->read_in_flight);
+  CHECK((offset + buf_len) <= async->source.msg_len);
+  if (async->start_read_fails) {
+    return false;
+  }
+  async->num_reads_started++;
+  async->read_in_flight = true;
+  async->read_offset = offset;
+  async->read_buf = (uint8_t *)buf;
+  async->read_len = buf_len;
+  async->complete_cb = complete_cb;
+  async->complete_ctx = complete_ctx;
+  return true;
+}
+
+//! Completes the read in flight, as the DMA interrupt of a flash driver would
+static void prv_async_source_complete_read(sTestAsyncSource *async) {
+  CHECK(async->read_in_flight);
+  memcpy(async->read_buf, &async->source.msg[async->read_offset], async->read_len);
+  async->read_in_flight = false;
+  async->complete_cb(async->complete_ctx, true);
+}
+
+static void prv_count_wake_ups(void *ctx) {
+  (*(size_t *)ctx)++;
+}
+
+TEST(MemfaultDataPacketizer, Test_AsyncReadsDoubleBuffered) {
+  uint8_t msg[100];
+  for (size_t i = 0; i < sizeof(msg); i++) {
+    msg[i] = (uint8_t)(0x80 + i);
+  }
+  sTestAsyncSource async = { .source = { .msg = msg, .msg_len = sizeof(msg), .num_msgs = 1 } };
+  const sMemfaultDataSourceImpl impl = {
+    .ctx_has_more_msgs_cb = prv_async_source_has_msg,
+    .ctx_read_msg_cb = prv_async_source_read_msg,
+    .ctx_mark_msg_read_cb = prv_async_source_mark_msg_read,
+    .start_read_cb = prv_async_source_start_read,
+    .ctx = &async,
+  };
+  sMfltPacketizerCtx packetizer;
+  const sMfltPacketizerSources sources = { .event_source = &impl };
+  memfault_packetizer_ctx_init(&packetizer, &sources);
+
+  uint8_t read_buf[2 * 32];
+  size_t num_wake_ups = 0;
+  const sPacketizerConfig cfg = {
+    .enable_multi_packet_chunk = false,
+    .async_read_buf = read_buf,
+    .async_read_buf_len = sizeof(read_buf),
+    .async_read_complete_cb = prv_count_wake_ups,
+    .async_read_complete_ctx = &num_wake_ups,
+  };
+  sPacketizerMetadata metadata;
+
+  // the first read starts with the message
+  CHECK(memfault_packetizer_ctx_begin(&packetizer, &cfg, &metadata));
+  CHECK(async.read_in_flight);
+  LONGS_EQUAL(0, async.read_offset);
+  LONGS_EQUAL(32, async.read_len);
+
+  uint8_t packet[16];
+  size_t packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_Pending,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  LONGS_EQUAL(0, packet_len);
+
+  prv_async_source_complete_read(&async);
+  LONGS_EQUAL(1, num_wake_ups);
+  packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  LONGS_EQUAL(sizeof(packet), packet_len);
+  MEMCMP_EQUAL(msg, &packet[1], sizeof(packet) - 1);
+
+  // the data which follows is read while the packet is sent, the next packet is already buffered
+  CHECK(async.read_in_flight);
+  LONGS_EQUAL(32, async.read_offset);
+  packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  MEMCMP_EQUAL(&msg[15], packet, sizeof(packet));
+
+  // drain the rest of the message, completing reads as they are waited on
+  uint8_t sent[sizeof(msg)];
+  size_t sent_len = 15 + sizeof(packet);
+  memcpy(sent, msg, sent_len);
+  size_t num_pending = 0;
+  while (async.source.num_msgs != 0) {
+    packet_len = sizeof(packet);
+    const eMemfaultPacketizerStatus status =
+        memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len);
+    if (status == kMemfaultPacketizerStatus_Pending) {
+      num_pending++;
+      prv_async_source_complete_read(&async);
+      continue;
+    }
+    LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk, status);
+    CHECK((sent_len + packet_len) <= sizeof(sent));
+    memcpy(&sent[sent_len], packet, packet_len);
+    sent_len += packet_len;
+  }
+  LONGS_EQUAL(sizeof(msg), sent_len);
+  MEMCMP_EQUAL(msg, sent, sizeof(msg));
+  CHECK(!async.read_in_flight);
+  LONGS_EQUAL(3, num_pending);
+  LONGS_EQUAL(4, async.num_reads_started);
+  LONGS_EQUAL(0, async.num_sync_reads);
+}
+
+TEST(MemfaultDataPacketizer, Test_AsyncReadsAbortAndFallback) {
+  const uint8_t msg[] = { 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea };
+  sTestAsyncSource async = { .source = { .msg = msg, .msg_len = sizeof(msg), .num_msgs = 1 } };
+  const sMemfaultDataSourceImpl impl = {
+    .ctx_has_more_msgs_cb = prv_async_source_has_msg,
+    .ctx_read_msg_cb = prv_async_source_read_msg,
+    .ctx_mark_msg_read_cb = prv_async_source_mark_msg_read,
+    .start_read_cb = prv_async_source_start_read,
+    .ctx = &async,
+  };
+  sMfltPacketizerCtx packetizer;
+  const sMfltPacketizerSources sources = { .event_source = &impl };
+  memfault_packetizer_ctx_init(&packetizer, &sources);
+
+  uint8_t read_buf[2 * 8];
+  size_t num_wake_ups = 0;
+  const sPacketizerConfig cfg = {
+    .enable_multi_packet_chunk = false,
+    .async_read_buf = read_buf,
+    .async_read_buf_len = sizeof(read_buf),
+    .async_read_complete_cb = prv_count_wake_ups,
+    .async_read_complete_ctx = &num_wake_ups,
+  };
+  sPacketizerMetadata metadata;
+  CHECK(memfault_packetizer_ctx_begin(&packetizer, &cfg, &metadata));
+  CHECK(async.read_in_flight);
+
+  // no new read starts until the one of the aborted message completes
+  memfault_packetizer_ctx_abort(&packetizer);
+  CHECK(memfault_packetizer_ctx_begin(&packetizer, &cfg, &metadata));
+  uint8_t packet[16];
+  size_t packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_Pending,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  LONGS_EQUAL(1, async.num_reads_started);
+  prv_async_source_complete_read(&async);
+  LONGS_EQUAL(1, num_wake_ups);
+
+  // its data was discarded, the message is read again
+  packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_Pending,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  LONGS_EQUAL(2, async.num_reads_started);
+  prv_async_source_complete_read(&async);
+
+  // a data source which can't start a read is read synchronously instead
+  async.start_read_fails = true;
+  packet_len = sizeof(packet);
+  LONGS_EQUAL(kMemfaultPacketizerStatus_EndOfChunk,
+              memfault_packetizer_ctx_get_next(&packetizer, packet, &packet_len));
+  LONGS_EQUAL(sizeof(msg) + 1 /* hdr */, packet_len);
+  MEMCMP_EQUAL(msg, &packet[1], sizeof(msg));
+  LONGS_EQUAL(1, async.num_sync_reads);
+  LONGS_EQUAL(0, async.source.num_msgs);
+}
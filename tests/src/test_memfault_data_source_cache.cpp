@@ -0,0 +1,270 @@
+//! @file
+//!
+//! @brief
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+
+extern "C" {
+  #include <string.h>
+  #include <stddef.h>
+  #include <stdint.h>
+
+  #include "memfault/core/data_packetizer_source.h"
+  #include "memfault/core/data_source_cache.h"
+  #include "memfault/core/data_source_rle.h"
+  #include "memfault/core/math.h"
+}
+
+//! A data source standing in for a message saved in flash, counting the transactions made
+typedef struct {
+  uint8_t data[1024];
+  size_t size;
+  size_t num_reads;
+  size_t bytes_read;
+  bool fail_reads;
+} sTestFlashSource;
+
+static bool prv_flash_has_msg(void *ctx, size_t *total_size_out) {
+  const sTestFlashSource *flash = (const sTestFlashSource *)ctx;
+  *total_size_out = flash->size;
+  return flash->size != 0;
+}
+
+static bool prv_flash_read_msg(void *ctx, uint32_t offset, void *buf, size_t buf_len) {
+  sTestFlashSource *flash = (sTestFlashSource *)ctx;
+  CHECK((offset + buf_len) <= flash->size);
+  flash->num_reads++;
+  flash->bytes_read += buf_len;
+  memcpy(buf, &flash->data[offset], buf_len);
+  return !flash->fail_reads;
+}
+
+static void prv_flash_mark_msg_read(void *ctx) {
+  sTestFlashSource *flash = (sTestFlashSource *)ctx;
+  flash->size = 0;
+}
+
+static void prv_flash_fill(sTestFlashSource *flash, size_t size, uint8_t seed) {
+  for (size_t i = 0; i < size; i++) {
+    flash->data[i] = (uint8_t)((i * 7) + seed);
+  }
+  flash->size = size;
+}
+
+static sTestFlashSource s_flash;
+static const sMemfaultDataSourceImpl s_flash_source = {
+  .ctx_has_more_msgs_cb = prv_flash_has_msg,
+  .ctx_read_msg_cb = prv_flash_read_msg,
+  .ctx_mark_msg_read_cb = prv_flash_mark_msg_read,
+  .ctx = &s_flash,
+};
+
+static uint8_t s_cache_storage[4 * 128];
+static sMfltDataSourceCacheCtx s_cache;
+
+static const sMemfaultDataSourceImpl *prv_cache_init(size_t block_size,
+                                                     size_t read_ahead_blocks) {
+  const sMfltDataSourceCacheConfig cfg = {
+    .source = &s_flash_source,
+    .storage = s_cache_storage,
+    .block_size = block_size,
+    .num_blocks = 4,
+    .read_ahead_blocks = read_ahead_blocks,
+  };
+  const sMemfaultDataSourceImpl *cached = memfault_data_source_cache_init(&s_cache, &cfg);
+  CHECK(cached != NULL);
+  return cached;
+}
+
+static void prv_check_read(const sMemfaultDataSourceImpl *cached, uint32_t offset,
+                           size_t len) {
+  uint8_t buf[256];
+  CHECK(len <= sizeof(buf));
+  CHECK(cached->ctx_read_msg_cb(cached->ctx, offset, buf, len));
+  MEMCMP_EQUAL(&s_flash.data[offset], buf, len);
+}
+
+TEST_GROUP(MemfaultDataSourceCache){
+  void setup() {
+    s_flash = (sTestFlashSource) { };
+  }
+  void teardown() {
+  }
+};
+
+TEST(MemfaultDataSourceCache, Test_BadConfig) {
+  sMfltDataSourceCacheConfig cfg = {
+    .source = &s_flash_source,
+    .storage = s_cache_storage,
+    .block_size = 32,
+    .num_blocks = MEMFAULT_DATA_SOURCE_CACHE_MAX_BLOCKS + 1,
+  };
+  POINTERS_EQUAL(NULL, memfault_data_source_cache_init(&s_cache, &cfg));
+  cfg.num_blocks = 0;
+  POINTERS_EQUAL(NULL, memfault_data_source_cache_init(&s_cache, &cfg));
+  cfg.num_blocks = 4;
+  cfg.block_size = 0;
+  POINTERS_EQUAL(NULL, memfault_data_source_cache_init(&s_cache, &cfg));
+  cfg.block_size = 32;
+  cfg.storage = NULL;
+  POINTERS_EQUAL(NULL, memfault_data_source_cache_init(&s_cache, &cfg));
+  POINTERS_EQUAL(NULL, memfault_data_source_cache_init(&s_cache, NULL));
+}
+
+TEST(MemfaultDataSourceCache, Test_ReadsAcrossBlocks) {
+  const sMemfaultDataSourceImpl *cached = prv_cache_init(32, 0);
+  prv_flash_fill(&s_flash, 100, 0);
+  size_t msg_size = 0;
+  CHECK(cached->ctx_has_more_msgs_cb(cached->ctx, &msg_size));
+  LONGS_EQUAL(100, msg_size);
+
+  // unaligned reads spanning blocks, up to the short last block. The blocks a read is missing
+  // are read at once.
+  prv_check_read(cached, 5, 40);
+  prv_check_read(cached, 30, 70);
+  prv_check_read(cached, 99, 1);
+  prv_check_read(cached, 0, 100);
+
+  sMfltDataSourceCacheStats stats;
+  memfault_data_source_cache_get_stats(&s_cache, &stats);
+  LONGS_EQUAL(4, stats.num_misses);
+  LONGS_EQUAL(2, stats.num_source_reads);
+  LONGS_EQUAL(100, stats.source_bytes_read);
+  LONGS_EQUAL(2 + 1 + 4, stats.num_hits);
+  LONGS_EQUAL(0, stats.num_blocks_read_ahead);
+  LONGS_EQUAL(2, s_flash.num_reads);
+}
+
+TEST(MemfaultDataSourceCache, Test_SequentialReadAhead) {
+  const sMemfaultDataSourceImpl *cached = prv_cache_init(32, 2);
+  prv_flash_fill(&s_flash, 256, 3);
+  size_t msg_size = 0;
+  CHECK(cached->ctx_has_more_msgs_cb(cached->ctx, &msg_size));
+
+  for (uint32_t offset = 0; offset < msg_size; offset += 16) {
+    prv_check_read(cached, offset, 16);
+  }
+
+  // the first block is read on its own, the rest of the stream two blocks at a time
+  sMfltDataSourceCacheStats stats;
+  memfault_data_source_cache_get_stats(&s_cache, &stats);
+  LONGS_EQUAL(5, stats.num_source_reads);
+  LONGS_EQUAL(256, stats.source_bytes_read);
+  LONGS_EQUAL(5, stats.num_misses);
+  LONGS_EQUAL(11, stats.num_hits);
+  LONGS_EQUAL(3, stats.num_blocks_read_ahead);
+
+  // a jump elsewhere isn't sequential, only the block missed is read
+  prv_check_read(cached, 8, 4);
+  memfault_data_source_cache_get_stats(&s_cache, &stats);
+  LONGS_EQUAL(6, stats.num_source_reads);
+  LONGS_EQUAL(3, stats.num_blocks_read_ahead);
+}
+
+TEST(MemfaultDataSourceCache, Test_LeastRecentlyUsedEvicted) {
+  const sMemfaultDataSourceImpl *cached = prv_cache_init(32, 0);
+  prv_flash_fill(&s_flash, 256, 9);
+  size_t msg_size = 0;
+  CHECK(cached->ctx_has_more_msgs_cb(cached->ctx, &msg_size));
+
+  // a header read over and over between reads elsewhere stays cached
+  for (uint32_t offset = 64; offset < msg_size; offset += 32) {
+    prv_check_read(cached, 0, 8);
+    prv_check_read(cached, offset, 32);
+  }
+  sMfltDataSourceCacheStats stats;
+  memfault_data_source_cache_get_stats(&s_cache, &stats);
+  LONGS_EQUAL(1 + 6, stats.num_source_reads);
+  LONGS_EQUAL(5, stats.num_hits);
+}
+
+TEST(MemfaultDataSourceCache, Test_NewMessageInvalidates) {
+  const sMemfaultDataSourceImpl *cached = prv_cache_init(32, 2);
+  prv_flash_fill(&s_flash, 64, 1);
+  size_t msg_size = 0;
+  CHECK(cached->ctx_has_more_msgs_cb(cached->ctx, &msg_size));
+  prv_check_read(cached, 0, 64);
+
+  cached->ctx_mark_msg_read_cb(cached->ctx);
+  CHECK(!cached->ctx_has_more_msgs_cb(cached->ctx, &msg_size));
+
+  // the next message is read from the data source, not from the blocks of the last one
+  prv_flash_fill(&s_flash, 64, 2);
+  CHECK(cached->ctx_has_more_msgs_cb(cached->ctx, &msg_size));
+  prv_check_read(cached, 0, 64);
+
+  // as is data modified behind the back of the cache once invalidated
+  prv_flash_fill(&s_flash, 64, 3);
+  memfault_data_source_cache_invalidate(&s_cache);
+  prv_check_read(cached, 10, 20);
+
+  // reads which fail aren't cached
+  s_flash.fail_reads = true;
+  memfault_data_source_cache_invalidate(&s_cache);
+  uint8_t buf[8];
+  CHECK(!cached->ctx_read_msg_cb(cached->ctx, 0, buf, sizeof(buf)));
+  s_flash.fail_reads = false;
+  prv_check_read(cached, 0, 8);
+}
+
+TEST(MemfaultDataSourceCache, Test_SameSizeMessageInvalidates) {
+  const sMemfaultDataSourceImpl *cached = prv_cache_init(32, 2);
+  prv_flash_fill(&s_flash, 64, 1);
+  size_t msg_size = 0;
+  CHECK(cached->ctx_has_more_msgs_cb(cached->ctx, &msg_size));
+  prv_check_read(cached, 0, 64);
+
+  // a message of the same size but different contents replaces the last one without it being
+  // marked read through the cache, i.e a new coredump saved over the last one
+  prv_flash_fill(&s_flash, 64, 2);
+  CHECK(cached->ctx_has_more_msgs_cb(cached->ctx, &msg_size));
+  LONGS_EQUAL(64, msg_size);
+  const size_t num_reads = s_flash.num_reads;
+  prv_check_read(cached, 0, 64);
+  CHECK(s_flash.num_reads > num_reads);
+
+  // and the same once marked read
+  cached->ctx_mark_msg_read_cb(cached->ctx);
+  prv_flash_fill(&s_flash, 64, 3);
+  CHECK(cached->ctx_has_more_msgs_cb(cached->ctx, &msg_size));
+  prv_check_read(cached, 10, 20);
+}
+
+TEST(MemfaultDataSourceCache, Test_RleEncoderReads) {
+  // runs of repeated bytes between stretches of non-repeating ones
+  uint32_t lfsr = 0xACE1u;
+  for (size_t i = 0; i < sizeof(s_flash.data); i++) {
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    s_flash.data[i] = ((i % 256) < 64) ? 0 : (uint8_t)lfsr;
+  }
+  s_flash.size = sizeof(s_flash.data);
+
+  // the reference encoding, straight from the data source
+  sMfltDataSourceRleCtx rle = { };
+  const sMemfaultDataSourceImpl *rle_source =
+      memfault_data_source_rle_ctx_set_active(&rle, &s_flash_source);
+  size_t rle_size = 0;
+  CHECK(rle_source->ctx_has_more_msgs_cb(rle_source->ctx, &rle_size));
+  static uint8_t expected[2 * sizeof(s_flash.data)];
+  CHECK(rle_size <= sizeof(expected));
+  CHECK(rle_source->ctx_read_msg_cb(rle_source->ctx, 0, expected, rle_size));
+  const size_t uncached_num_reads = s_flash.num_reads;
+
+  // the same encoding through the cache, in less than half the transactions
+  const sMemfaultDataSourceImpl *cached = prv_cache_init(128, 2);
+  s_flash.num_reads = 0;
+  rle = (sMfltDataSourceRleCtx) { };
+  rle_source = memfault_data_source_rle_ctx_set_active(&rle, cached);
+  size_t cached_rle_size = 0;
+  CHECK(rle_source->ctx_has_more_msgs_cb(rle_source->ctx, &cached_rle_size));
+  LONGS_EQUAL(rle_size, cached_rle_size);
+  static uint8_t actual[sizeof(expected)];
+  CHECK(rle_source->ctx_read_msg_cb(rle_source->ctx, 0, actual, rle_size));
+  MEMCMP_EQUAL(expected, actual, rle_size);
+
+  CHECK((s_flash.num_reads * 2) < uncached_num_reads);
+  rle_source->ctx_mark_msg_read_cb(rle_source->ctx);
+  LONGS_EQUAL(0, s_flash.size);
+}
@@ -134,3 +134,220 @@ TEST(MemfaultDataSourceRle, Test_DataSourceMultiByteVarintAndEndsWithNonRepeat)
 
   prv_check_pattern(fake_core, sizeof(fake_core), expected_core_rle, sizeof(expected_core_rle));
 }
+
+typedef struct {
+  const uint8_t *data;
+  size_t size;
+} sTestRleMsg;
+
+static bool prv_instance_has_msgs(void *ctx, size_t *total_size_out) {
+  const sTestRleMsg *msg = (const sTestRleMsg *)ctx;
+  *total_size_out = msg->size;
+  return (*total_size_out != 0);
+}
+
+static bool prv_instance_read_msg_data(void *ctx, uint32_t offset, void *buf, size_t buf_len) {
+  const sTestRleMsg *msg = (const sTestRleMsg *)ctx;
+  memcpy(buf, &msg->data[offset], buf_len);
+  return true;
+}
+
+static void prv_instance_mark_msg_read(void *ctx) {
+  sTestRleMsg *msg = (sTestRleMsg *)ctx;
+  *msg = (sTestRleMsg) { 0 };
+}
+
+TEST(MemfaultDataSourceRle, Test_IndependentInstances) {
+  const uint8_t fake_core_a[] = { 1, 1, 2, 3, 4, 5, 5, 5, 5, 5, 6, 9, 9, 9, 9 };
+  const uint8_t expected_rle_a[] = { 4, 1, 5, 2, 3, 4, 10, 5, 1, 6, 8, 9 };
+  const uint8_t fake_core_b[] = { 7, 7, 7, 7, 7, 7, 7, 7 };
+  const uint8_t expected_rle_b[] = { 16, 7 };
+
+  sTestRleMsg msg_a = { .data = fake_core_a, .size = sizeof(fake_core_a) };
+  sTestRleMsg msg_b = { .data = fake_core_b, .size = sizeof(fake_core_b) };
+  const sMemfaultDataSourceImpl source_a = {
+    .ctx_has_more_msgs_cb = prv_instance_has_msgs,
+    .ctx_read_msg_cb = prv_instance_read_msg_data,
+    .ctx_mark_msg_read_cb = prv_instance_mark_msg_read,
+    .ctx = &msg_a,
+  };
+  const sMemfaultDataSourceImpl source_b = {
+    .ctx_has_more_msgs_cb = prv_instance_has_msgs,
+    .ctx_read_msg_cb = prv_instance_read_msg_data,
+    .ctx_mark_msg_read_cb = prv_instance_mark_msg_read,
+    .ctx = &msg_b,
+  };
+
+  sMfltDataSourceRleCtx rle_a = { };
+  sMfltDataSourceRleCtx rle_b = { };
+  const sMemfaultDataSourceImpl *rle_source_a =
+      memfault_data_source_rle_ctx_set_active(&rle_a, &source_a);
+  const sMemfaultDataSourceImpl *rle_source_b =
+      memfault_data_source_rle_ctx_set_active(&rle_b, &source_b);
+
+  size_t size_a = 0;
+  size_t size_b = 0;
+  CHECK(rle_source_a->ctx_has_more_msgs_cb(rle_source_a->ctx, &size_a));
+  CHECK(rle_source_b->ctx_has_more_msgs_cb(rle_source_b->ctx, &size_b));
+  LONGS_EQUAL(sizeof(expected_rle_a), size_a);
+  LONGS_EQUAL(sizeof(expected_rle_b), size_b);
+
+  // interleave single byte reads, neither encoder should disturb the other
+  uint8_t rle_a_out[sizeof(expected_rle_a)];
+  uint8_t rle_b_out[sizeof(expected_rle_b)];
+  for (size_t i = 0; i < sizeof(rle_a_out); i++) {
+    CHECK(rle_source_a->ctx_read_msg_cb(rle_source_a->ctx, i, &rle_a_out[i], 1));
+    if (i < sizeof(rle_b_out)) {
+      CHECK(rle_source_b->ctx_read_msg_cb(rle_source_b->ctx, i, &rle_b_out[i], 1));
+    }
+  }
+  MEMCMP_EQUAL(expected_rle_a, rle_a_out, sizeof(expected_rle_a));
+  MEMCMP_EQUAL(expected_rle_b, rle_b_out, sizeof(expected_rle_b));
+
+  rle_source_a->ctx_mark_msg_read_cb(rle_source_a->ctx);
+  CHECK(!rle_source_a->ctx_has_more_msgs_cb(rle_source_a->ctx, &size_a));
+  CHECK(rle_source_b->ctx_has_more_msgs_cb(rle_source_b->ctx, &size_b));
+  rle_source_b->ctx_mark_msg_read_cb(rle_source_b->ctx);
+  CHECK(!rle_source_b->ctx_has_more_msgs_cb(rle_source_b->ctx, &size_b));
+}
+
+typedef struct {
+  uint8_t data[4096];
+  size_t size;
+  //! Bytes read from the backing data source, to check how much is encoded again
+  size_t bytes_read;
+} sTestRleLargeMsg;
+
+static bool prv_large_has_msgs(void *ctx, size_t *total_size_out) {
+  const sTestRleLargeMsg *msg = (const sTestRleLargeMsg *)ctx;
+  *total_size_out = msg->size;
+  return (*total_size_out != 0);
+}
+
+static bool prv_large_read_msg_data(void *ctx, uint32_t offset, void *buf, size_t buf_len) {
+  sTestRleLargeMsg *msg = (sTestRleLargeMsg *)ctx;
+  CHECK((offset + buf_len) <= msg->size);
+  memcpy(buf, &msg->data[offset], buf_len);
+  msg->bytes_read += buf_len;
+  return true;
+}
+
+static void prv_large_mark_msg_read(void *ctx) {
+  sTestRleLargeMsg *msg = (sTestRleLargeMsg *)ctx;
+  msg->size = 0;
+}
+
+//! Runs of repeated bytes between stretches of non-repeating ones
+static void prv_fill_large_msg(sTestRleLargeMsg *msg) {
+  uint32_t lfsr = 0xACE1u;
+  for (size_t i = 0; i < sizeof(msg->data); i++) {
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    msg->data[i] = ((i % 256) < 64) ? 0 : (uint8_t)lfsr;
+  }
+  msg->size = sizeof(msg->data);
+}
+
+TEST(MemfaultDataSourceRle, Test_ReadAtPreviousOffsets) {
+  static sTestRleLargeMsg msg;
+  prv_fill_large_msg(&msg);
+  const sMemfaultDataSourceImpl source = {
+    .ctx_has_more_msgs_cb = prv_large_has_msgs,
+    .ctx_read_msg_cb = prv_large_read_msg_data,
+    .ctx_mark_msg_read_cb = prv_large_mark_msg_read,
+    .ctx = &msg,
+  };
+
+  // the reference encoding, read sequentially
+  sMfltDataSourceRleCtx rle = { };
+  const sMemfaultDataSourceImpl *rle_source =
+      memfault_data_source_rle_ctx_set_active(&rle, &source);
+  size_t rle_size = 0;
+  CHECK(rle_source->ctx_has_more_msgs_cb(rle_source->ctx, &rle_size));
+  CHECK(rle_size > 2 * MEMFAULT_DATA_SOURCE_RLE_CHECKPOINT_INTERVAL);
+  static uint8_t expected[sizeof(msg.data) * 2];
+  CHECK(rle_size <= sizeof(expected));
+  const size_t piece_len = 20;
+  msg.bytes_read = 0;
+  for (size_t offset = 0; offset < rle_size; offset += piece_len) {
+    const size_t len = MEMFAULT_MIN(piece_len, rle_size - offset);
+    CHECK(rle_source->ctx_read_msg_cb(rle_source->ctx, (uint32_t)offset, &expected[offset], len));
+  }
+  const size_t sequential_bytes_read = msg.bytes_read;
+  rle_source->ctx_mark_msg_read_cb(rle_source->ctx);
+
+  // the same message read again, going back to earlier pieces as if they had been lost
+  prv_fill_large_msg(&msg);
+  rle_source = memfault_data_source_rle_ctx_set_active(&rle, &source);
+  CHECK(rle_source->ctx_has_more_msgs_cb(rle_source->ctx, &rle_size));
+  uint8_t piece[piece_len];
+  for (size_t offset = 0; offset < rle_size; offset += piece_len) {
+    size_t len = MEMFAULT_MIN(piece_len, rle_size - offset);
+    CHECK(rle_source->ctx_read_msg_cb(rle_source->ctx, (uint32_t)offset, piece, len));
+    MEMCMP_EQUAL(&expected[offset], piece, len);
+
+    if (offset < (3 * piece_len)) {
+      continue;
+    }
+    const size_t lost_offset = offset - (3 * piece_len);
+    msg.bytes_read = 0;
+    CHECK(rle_source->ctx_read_msg_cb(rle_source->ctx, (uint32_t)lost_offset, piece, piece_len));
+    MEMCMP_EQUAL(&expected[lost_offset], piece, piece_len);
+    // only the data since the closest checkpoint is encoded again, rather than the whole message
+    CHECK(msg.bytes_read < (sequential_bytes_read / 2));
+  }
+
+  // a read from the beginning restarts the encoder
+  CHECK(rle_source->ctx_read_msg_cb(rle_source->ctx, 0, piece, piece_len));
+  MEMCMP_EQUAL(&expected[0], piece, piece_len);
+  CHECK(rle_source->ctx_read_msg_cb(rle_source->ctx, piece_len, piece, piece_len));
+  MEMCMP_EQUAL(&expected[piece_len], piece, piece_len);
+
+  // reads past the end of the encoded message fail
+  CHECK(!rle_source->ctx_read_msg_cb(rle_source->ctx, (uint32_t)rle_size - 1, piece, 2));
+  rle_source->ctx_mark_msg_read_cb(rle_source->ctx);
+}
+
+TEST(MemfaultDataSourceRle, Test_CheckpointsSpanMessage) {
+  static sTestRleLargeMsg msg;
+  prv_fill_large_msg(&msg);
+  const sMemfaultDataSourceImpl source = {
+    .ctx_has_more_msgs_cb = prv_large_has_msgs,
+    .ctx_read_msg_cb = prv_large_read_msg_data,
+    .ctx_mark_msg_read_cb = prv_large_mark_msg_read,
+    .ctx = &msg,
+  };
+
+  sMfltDataSourceRleCtx rle = { };
+  const sMemfaultDataSourceImpl *rle_source =
+      memfault_data_source_rle_ctx_set_active(&rle, &source);
+  size_t rle_size = 0;
+  CHECK(rle_source->ctx_has_more_msgs_cb(rle_source->ctx, &rle_size));
+  static uint8_t expected[sizeof(msg.data) * 2];
+  CHECK(rle_size <= sizeof(expected));
+  CHECK(rle_source->ctx_read_msg_cb(rle_source->ctx, 0, expected, rle_size));
+  rle_source->ctx_mark_msg_read_cb(rle_source->ctx);
+
+  prv_fill_large_msg(&msg);
+  rle_source = memfault_data_source_rle_ctx_set_active(&rle, &source);
+  CHECK(rle_source->ctx_has_more_msgs_cb(rle_source->ctx, &rle_size));
+
+  // the message needs more checkpoints than there is room for so the interval grew
+  const sMemfaultDataSourceRleState *state = &rle.state;
+  CHECK(state->num_checkpoints <= MEMFAULT_DATA_SOURCE_RLE_NUM_CHECKPOINTS);
+  CHECK(state->checkpoint_interval > MEMFAULT_DATA_SOURCE_RLE_CHECKPOINT_INTERVAL);
+  CHECK(state->num_checkpoints != 0);
+  for (size_t i = 0; i < state->num_checkpoints; i++) {
+    CHECK(state->checkpoints[i].curr_encoded_len >= ((i + 1) * state->checkpoint_interval));
+  }
+  CHECK((rle_size - state->checkpoints[state->num_checkpoints - 1].curr_encoded_len) <
+        (2 * state->checkpoint_interval));
+
+  // any offset can be read first, in any order
+  uint8_t piece[32];
+  for (size_t i = 0; i < 64; i++) {
+    const size_t offset = ((rle_size - sizeof(piece)) * (63 - i)) / 63;
+    CHECK(rle_source->ctx_read_msg_cb(rle_source->ctx, (uint32_t)offset, piece, sizeof(piece)));
+    MEMCMP_EQUAL(&expected[offset], piece, sizeof(piece));
+  }
+  rle_source->ctx_mark_msg_read_cb(rle_source->ctx);
+}
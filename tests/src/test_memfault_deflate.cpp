@@ -0,0 +1,162 @@
+//! @file
+//!
+//! Round trips the deflate encoder through zlib, the reference decoder. The size/CPU tradeoff on
+//! batches of heartbeat events is measured in test_memfault_benchmarks.cpp.
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+extern "C" {
+  #include "memfault/core/math.h"
+  #include "memfault/util/deflate.h"
+}
+
+typedef struct {
+  uint8_t *buf;
+  size_t buf_len;
+  size_t len;
+  size_t num_writes;
+  size_t fail_after_num_writes;
+} sOutputBuffer;
+
+static bool prv_write_cb(void *ctx, const void *data, size_t data_len) {
+  sOutputBuffer *out = (sOutputBuffer *)ctx;
+  if ((out->fail_after_num_writes != 0) && (out->num_writes == out->fail_after_num_writes)) {
+    return false;
+  }
+  out->num_writes++;
+  CHECK(out->len + data_len <= out->buf_len);
+  memcpy(&out->buf[out->len], data, data_len);
+  out->len += data_len;
+  return true;
+}
+
+static sMemfaultDeflateEncoder s_encoder;
+
+//! Compresses 'data', feeding it to the encoder 'write_len' bytes at a time
+//!
+//! @return the size of the compressed stream
+static size_t prv_compress(const void *data, size_t data_len, size_t write_len, uint8_t *out_buf,
+                           size_t out_buf_len) {
+  sOutputBuffer out = {
+    .buf = out_buf,
+    .buf_len = out_buf_len,
+  };
+  memfault_deflate_encoder_init(&s_encoder, prv_write_cb, &out);
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t offset = 0; offset < data_len; offset += write_len) {
+    CHECK(memfault_deflate_encoder_write(&s_encoder, &bytes[offset],
+                                         MEMFAULT_MIN(write_len, data_len - offset)));
+  }
+  CHECK(memfault_deflate_encoder_finish(&s_encoder));
+  LONGS_EQUAL(out.len, s_encoder.total_out);
+  CHECK(out.len <= memfault_deflate_max_encoded_size(data_len));
+  return out.len;
+}
+
+static void prv_check_round_trip(const void *data, size_t data_len, size_t write_len) {
+  const size_t out_buf_len = memfault_deflate_max_encoded_size(data_len);
+  uint8_t *compressed = (uint8_t *)malloc(out_buf_len);
+  const size_t compressed_len = prv_compress(data, data_len, write_len, compressed, out_buf_len);
+
+  uLongf decompressed_len = (uLongf)data_len + 1;
+  uint8_t *decompressed = (uint8_t *)malloc(decompressed_len);
+  LONGS_EQUAL(Z_OK, uncompress(decompressed, &decompressed_len, compressed, compressed_len));
+  LONGS_EQUAL(data_len, decompressed_len);
+  MEMCMP_EQUAL(data, decompressed, data_len);
+
+  free(decompressed);
+  free(compressed);
+}
+
+static uint32_t s_rand_state;
+
+static uint32_t prv_rand(void) {
+  s_rand_state ^= s_rand_state << 13;
+  s_rand_state ^= s_rand_state >> 17;
+  s_rand_state ^= s_rand_state << 5;
+  return s_rand_state;
+}
+
+TEST_GROUP(MfltDeflate) {
+  void setup() {
+    s_rand_state = 0x12345678;
+  }
+  void teardown() {
+  }
+};
+
+TEST(MfltDeflate, Test_EmptyAndTinyInputs) {
+  prv_check_round_trip("", 0, 1);
+  prv_check_round_trip("a", 1, 1);
+  prv_check_round_trip("abcabcabc", 9, 1);
+  prv_check_round_trip("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 40, 40);
+}
+
+TEST(MfltDeflate, Test_RepetitiveData) {
+  // long runs exercise matches of the maximum length and overlapping copies
+  const size_t data_len = 10000;
+  uint8_t *data = (uint8_t *)calloc(1, data_len);
+  prv_check_round_trip(data, data_len, data_len);
+
+  const size_t out_buf_len = memfault_deflate_max_encoded_size(data_len);
+  uint8_t *compressed = (uint8_t *)malloc(out_buf_len);
+  CHECK(prv_compress(data, data_len, data_len, compressed, out_buf_len) < 100);
+
+  free(compressed);
+  free(data);
+}
+
+TEST(MfltDeflate, Test_RandomData) {
+  // incompressible data stays within the worst case bound
+  const size_t data_len = 5 * MEMFAULT_DEFLATE_WINDOW_SIZE + 17;
+  uint8_t *data = (uint8_t *)malloc(data_len);
+  for (size_t i = 0; i < data_len; i++) {
+    data[i] = (uint8_t)prv_rand();
+  }
+  prv_check_round_trip(data, data_len, 100);
+  free(data);
+}
+
+TEST(MfltDeflate, Test_RandomizedStreams) {
+  // text-like data from a small alphabet, streamed in writes of random sizes, so matches
+  // straddle writes and slides of the window
+  for (size_t iteration = 0; iteration < 200; iteration++) {
+    const size_t data_len = prv_rand() % (8 * MEMFAULT_DEFLATE_WINDOW_SIZE);
+    uint8_t *data = (uint8_t *)malloc(data_len + 1);
+    const size_t alphabet_size = 2 + (prv_rand() % 8);
+    for (size_t i = 0; i < data_len; i++) {
+      data[i] = (uint8_t)('a' + (prv_rand() % alphabet_size));
+    }
+    const size_t write_len = 1 + (prv_rand() % (2 * MEMFAULT_DEFLATE_WINDOW_SIZE));
+    prv_check_round_trip(data, data_len, write_len);
+    free(data);
+  }
+}
+
+TEST(MfltDeflate, Test_WriteFailure) {
+  const size_t data_len = 4096;
+  uint8_t *data = (uint8_t *)malloc(data_len);
+  for (size_t i = 0; i < data_len; i++) {
+    data[i] = (uint8_t)prv_rand();
+  }
+  uint8_t out_buf[8192];
+  sOutputBuffer out = {
+    .buf = out_buf,
+    .buf_len = sizeof(out_buf),
+    .len = 0,
+    .num_writes = 0,
+    .fail_after_num_writes = 3,
+  };
+  memfault_deflate_encoder_init(&s_encoder, prv_write_cb, &out);
+  CHECK(!memfault_deflate_encoder_write(&s_encoder, data, data_len));
+  CHECK(s_encoder.write_error);
+  CHECK(!memfault_deflate_encoder_finish(&s_encoder));
+  LONGS_EQUAL(3, out.num_writes);
+  free(data);
+}
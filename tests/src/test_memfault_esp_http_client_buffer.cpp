@@ -0,0 +1,103 @@
+//! @file
+//!
+//! @brief
+//! Exercises the pool of POST buffers of the esp-idf port
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <string.h>
+
+extern "C" {
+  #include "fakes/fake_memfault_platform_metrics_locking.h"
+  #include "memfault/esp_port/http_client.h"
+}
+
+TEST_GROUP(MfltEspHttpClientBuffer) {
+  void setup() {
+    fake_memfault_metrics_platorm_locking_reboot();
+  }
+  void teardown() {
+    CHECK(fake_memfault_platform_metrics_lock_calls_balanced());
+    LONGS_EQUAL(0, memfault_http_client_buffer_pool_deinit());
+  }
+};
+
+TEST(MfltEspHttpClientBuffer, Test_PoolHit) {
+  static uint8_t s_buf[MEMFAULT_HTTP_CLIENT_MIN_BUFFER_SIZE];
+  LONGS_EQUAL(0, memfault_http_client_buffer_pool_init(s_buf, sizeof(s_buf)));
+
+  sMfltHttpClientBufferStats stats_before;
+  memfault_http_client_get_buffer_stats(&stats_before);
+
+  // every upload gets the buffer of the pool without touching the heap
+  for (int i = 0; i < 3; i++) {
+    size_t buffer_size = 0;
+    void *buffer = memfault_http_client_allocate_chunk_buffer(&buffer_size);
+    POINTERS_EQUAL(s_buf, buffer);
+    LONGS_EQUAL(sizeof(s_buf), buffer_size);
+    memfault_http_client_release_chunk_buffer(buffer);
+  }
+
+  sMfltHttpClientBufferStats stats;
+  memfault_http_client_get_buffer_stats(&stats);
+  LONGS_EQUAL(stats_before.num_uploads + 3, stats.num_uploads);
+  LONGS_EQUAL(stats_before.total_alloc_attempts, stats.total_alloc_attempts);
+  LONGS_EQUAL(0, stats.last_alloc_attempts);
+  LONGS_EQUAL(stats_before.num_temporary_buffers, stats.num_temporary_buffers);
+}
+
+TEST(MfltEspHttpClientBuffer, Test_PoolBusyFallsBackToHeap) {
+  static uint8_t s_buf[MEMFAULT_HTTP_CLIENT_MIN_BUFFER_SIZE];
+  LONGS_EQUAL(0, memfault_http_client_buffer_pool_init(s_buf, sizeof(s_buf)));
+
+  sMfltHttpClientBufferStats stats_before;
+  memfault_http_client_get_buffer_stats(&stats_before);
+
+  size_t pool_buffer_size = 0;
+  void *pool_buffer = memfault_http_client_allocate_chunk_buffer(&pool_buffer_size);
+  POINTERS_EQUAL(s_buf, pool_buffer);
+
+  // i.e another task posts data while the first upload is in progress
+  size_t temp_buffer_size = 0;
+  void *temp_buffer = memfault_http_client_allocate_chunk_buffer(&temp_buffer_size);
+  CHECK(temp_buffer != NULL);
+  CHECK(temp_buffer != pool_buffer);
+  CHECK(temp_buffer_size >= MEMFAULT_HTTP_CLIENT_MIN_BUFFER_SIZE);
+  memset(temp_buffer, 0xA5, temp_buffer_size);
+
+  sMfltHttpClientBufferStats stats;
+  memfault_http_client_get_buffer_stats(&stats);
+  LONGS_EQUAL(stats_before.num_temporary_buffers + 1, stats.num_temporary_buffers);
+  CHECK(stats.last_alloc_attempts >= 1);
+
+  // the pool can't be emptied while its buffer is in use
+  CHECK(memfault_http_client_buffer_pool_deinit() != 0);
+
+  memfault_http_client_release_chunk_buffer(temp_buffer);
+  memfault_http_client_release_chunk_buffer(pool_buffer);
+}
+
+TEST(MfltEspHttpClientBuffer, Test_ReleaseReturnsBufferToPool) {
+  // the pool buffer is reserved from the heap by the first upload
+  size_t buffer_size = 0;
+  void *buffer = memfault_http_client_allocate_chunk_buffer(&buffer_size);
+  CHECK(buffer != NULL);
+  CHECK(buffer_size >= MEMFAULT_HTTP_CLIENT_MIN_BUFFER_SIZE);
+
+  // while it's in use a second upload gets a temporary buffer
+  size_t temp_buffer_size = 0;
+  void *temp_buffer = memfault_http_client_allocate_chunk_buffer(&temp_buffer_size);
+  CHECK(temp_buffer != buffer);
+  memfault_http_client_release_chunk_buffer(temp_buffer);
+
+  // once released, the next upload gets the buffer of the pool back
+  memfault_http_client_release_chunk_buffer(buffer);
+  size_t next_buffer_size = 0;
+  void *next_buffer = memfault_http_client_allocate_chunk_buffer(&next_buffer_size);
+  POINTERS_EQUAL(buffer, next_buffer);
+  LONGS_EQUAL(buffer_size, next_buffer_size);
+  memfault_http_client_release_chunk_buffer(next_buffer);
+}
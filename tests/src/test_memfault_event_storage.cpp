@@ -165,3 +165,58 @@ TEST(MemfaultEventStorage, Test_MemfaultMultiEvent) {
   MEMCMP_EQUAL(payload, result, sizeof(result));
   prv_fake_event_impl_mark_event_read();
 }
+
+static void prv_write_instance_payload(const sMemfaultEventStorageImpl *impl, uint8_t byte) {
+  CHECK(impl->ctx_begin_write_cb(impl->ctx) != 0);
+  CHECK(impl->ctx_append_data_cb(impl->ctx, &byte, sizeof(byte)));
+  impl->ctx_finish_write_cb(impl->ctx, false);
+}
+
+static void prv_check_instance_event(const sMemfaultDataSourceImpl *source, uint8_t expected) {
+  size_t event_size = 0;
+  CHECK(source->ctx_has_more_msgs_cb(source->ctx, &event_size));
+  LONGS_EQUAL(1, event_size);
+  uint8_t data = 0;
+  CHECK(source->ctx_read_msg_cb(source->ctx, 0, &data, sizeof(data)));
+  LONGS_EQUAL(expected, data);
+  source->ctx_mark_msg_read_cb(source->ctx);
+}
+
+TEST(MemfaultEventStorage, Test_IndependentInstances) {
+  uint8_t buf_a[16];
+  uint8_t buf_b[16];
+  sMfltEventStorageCtx storage_a;
+  sMfltEventStorageCtx storage_b;
+  const sMemfaultEventStorageImpl *impl_a =
+      memfault_events_storage_ctx_init(&storage_a, buf_a, sizeof(buf_a));
+  const sMemfaultEventStorageImpl *impl_b =
+      memfault_events_storage_ctx_init(&storage_b, buf_b, sizeof(buf_b));
+  LONGS_EQUAL(sizeof(buf_a), impl_a->ctx_get_storage_size_cb(impl_a->ctx));
+
+  // the default instance should be untouched by writes to the other instances
+  const uint8_t default_payload = 0xab;
+  prv_write_payload(&default_payload, sizeof(default_payload), false);
+
+  prv_write_instance_payload(impl_a, 0xa1);
+  prv_write_instance_payload(impl_b, 0xb1);
+  prv_write_instance_payload(impl_a, 0xa2);
+
+  const sMemfaultDataSourceImpl *source_a =
+      memfault_events_storage_ctx_get_data_source(&storage_a);
+  const sMemfaultDataSourceImpl *source_b =
+      memfault_events_storage_ctx_get_data_source(&storage_b);
+  prv_check_instance_event(source_b, 0xb1);
+  prv_check_instance_event(source_a, 0xa1);
+  prv_check_instance_event(source_a, 0xa2);
+
+  size_t event_size;
+  CHECK(!source_a->ctx_has_more_msgs_cb(source_a->ctx, &event_size));
+  CHECK(!source_b->ctx_has_more_msgs_cb(source_b->ctx, &event_size));
+
+  CHECK(prv_fake_event_impl_has_event(&event_size));
+  LONGS_EQUAL(sizeof(default_payload), event_size);
+  uint8_t data = 0;
+  CHECK(prv_fake_event_impl_read(0, &data, sizeof(data)));
+  LONGS_EQUAL(default_payload, data);
+  prv_fake_event_impl_mark_event_read();
+}
@@ -62,6 +62,19 @@ size_t memfault_metrics_heartbeat_compute_worst_case_storage_size(void) {
   return (size_t)mock().actualCall(__func__).returnIntValueOrDefault(FAKE_STORAGE_SIZE);
 }
 
+static uint32_t s_ctx_serialized_unsigned_val;
+
+bool memfault_metrics_ctx_heartbeat_serialize(sMfltMetricsCtx *ctx) {
+  mock().actualCall(__func__).withPointerParameter("ctx", ctx);
+  memfault_metrics_ctx_heartbeat_read_unsigned(ctx, MEMFAULT_METRICS_KEY(test_key_unsigned),
+                                               &s_ctx_serialized_unsigned_val);
+  return true;
+}
+
+size_t memfault_metrics_ctx_heartbeat_compute_worst_case_storage_size(sMfltMetricsCtx *ctx) {
+  return (size_t)mock().actualCall(__func__).returnIntValueOrDefault(FAKE_STORAGE_SIZE);
+}
+
 TEST_GROUP(MemfaultHeartbeatMetrics){
   void setup() {
     s_fake_time_ms = 0;
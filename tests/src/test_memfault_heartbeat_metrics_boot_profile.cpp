@@ -0,0 +1,164 @@
+//! @file
+//!
+//! @brief
+//! Tests for the boot profile heartbeat metrics, built with MEMFAULT_METRICS_BOOT_PROFILE_ENABLED
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+extern "C" {
+  #include <string.h>
+  #include <stddef.h>
+
+  #include "fakes/fake_memfault_platform_metrics_locking.h"
+  #include "memfault/core/boot_profile.h"
+  #include "memfault/core/event_storage.h"
+  #include "memfault/core/platform/core.h"
+  #include "memfault/metrics/metrics.h"
+  #include "memfault/metrics/platform/overrides.h"
+  #include "memfault/metrics/platform/timer.h"
+  #include "memfault/metrics/serializer.h"
+  #include "memfault/metrics/utils.h"
+
+  uint64_t memfault_platform_get_time_since_boot_ms(void) {
+    return 0;
+  }
+
+  static uint32_t s_fake_cycle_count = 0;
+  uint32_t memfault_platform_get_cycle_count(void) {
+    return s_fake_cycle_count;
+  }
+
+  uint32_t memfault_platform_get_cycles_per_ms(void) {
+    return 64000;
+  }
+}
+
+#define FAKE_STORAGE_SIZE 100
+
+bool memfault_platform_metrics_timer_boot(uint32_t period_sec,
+                                          MemfaultPlatformTimerCallback callback) {
+  return true;
+}
+
+typedef struct {
+  uint32_t uptime_at_reset_ms;
+  uint32_t boot_duration_ms;
+} sBootProfileMetrics;
+
+static sBootProfileMetrics s_serialized;
+
+bool memfault_metrics_heartbeat_serialize(const sMemfaultEventStorageImpl *storage_impl) {
+  mock().actualCall(__func__);
+  memfault_metrics_heartbeat_read_unsigned(
+      MEMFAULT_METRICS_KEY(MemfaultSdkMetric_UptimeAtResetMs), &s_serialized.uptime_at_reset_ms);
+  memfault_metrics_heartbeat_read_unsigned(
+      MEMFAULT_METRICS_KEY(MemfaultSdkMetric_BootDurationMs), &s_serialized.boot_duration_ms);
+  return true;
+}
+
+void memfault_metrics_heartbeat_collect_data(void) {
+  mock().actualCall(__func__);
+}
+
+size_t memfault_metrics_heartbeat_compute_worst_case_storage_size(void) {
+  return FAKE_STORAGE_SIZE;
+}
+
+bool memfault_metrics_ctx_heartbeat_serialize(sMfltMetricsCtx *ctx) {
+  mock().actualCall(__func__);
+  memfault_metrics_ctx_heartbeat_read_unsigned(
+      ctx, MEMFAULT_METRICS_KEY(MemfaultSdkMetric_UptimeAtResetMs),
+      &s_serialized.uptime_at_reset_ms);
+  memfault_metrics_ctx_heartbeat_read_unsigned(
+      ctx, MEMFAULT_METRICS_KEY(MemfaultSdkMetric_BootDurationMs),
+      &s_serialized.boot_duration_ms);
+  return true;
+}
+
+size_t memfault_metrics_ctx_heartbeat_compute_worst_case_storage_size(sMfltMetricsCtx *ctx) {
+  return FAKE_STORAGE_SIZE;
+}
+
+static void prv_trigger_heartbeat(void) {
+  memset(&s_serialized, 0xa5, sizeof(s_serialized));
+  mock().expectOneCall("memfault_metrics_heartbeat_collect_data");
+  mock().expectOneCall("memfault_metrics_heartbeat_serialize");
+  memfault_metrics_heartbeat_debug_trigger();
+  mock().checkExpectations();
+}
+
+static const sMemfaultEventStorageImpl *s_fake_event_storage_impl;
+
+TEST_GROUP(MemfaultHeartbeatMetricsBootProfile){
+  void setup() {
+    s_fake_cycle_count = 0;
+    fake_memfault_metrics_platorm_locking_reboot();
+    static uint8_t s_storage[FAKE_STORAGE_SIZE];
+    mock().strictOrder();
+
+    s_fake_event_storage_impl = memfault_events_storage_boot(&s_storage, sizeof(s_storage));
+    LONGS_EQUAL(0, memfault_metrics_boot(s_fake_event_storage_impl));
+    // the boot profile metrics are defined by the SDK on top of the user's metrics
+    LONGS_EQUAL(kMemfaultMetricType_NumTypes + 2, memfault_metrics_heartbeat_get_num_metrics());
+  }
+  void teardown() {
+    CHECK(fake_memfault_platform_metrics_lock_calls_balanced());
+    mock().checkExpectations();
+    mock().clear();
+  }
+};
+
+TEST(MemfaultHeartbeatMetricsBootProfile, Test_ReportedOnceAfterBootCompletes) {
+  // cycle counter rolls over while booting
+  s_fake_cycle_count = UINT32_MAX - 64000 * 100 + 1;
+  memfault_boot_profile_start(123456);
+
+  // boot has not completed yet so nothing should be reported
+  prv_trigger_heartbeat();
+  LONGS_EQUAL(0, s_serialized.uptime_at_reset_ms);
+  LONGS_EQUAL(0, s_serialized.boot_duration_ms);
+
+  s_fake_cycle_count = 64000 * 150;
+  memfault_boot_complete();
+  // only the first call should be taken into account
+  s_fake_cycle_count += 64000 * 1000;
+  memfault_boot_complete();
+
+  prv_trigger_heartbeat();
+  LONGS_EQUAL(123456, s_serialized.uptime_at_reset_ms);
+  LONGS_EQUAL(250, s_serialized.boot_duration_ms);
+
+  // the values only belong to that heartbeat
+  prv_trigger_heartbeat();
+  LONGS_EQUAL(0, s_serialized.uptime_at_reset_ms);
+  LONGS_EQUAL(0, s_serialized.boot_duration_ms);
+}
+
+TEST(MemfaultHeartbeatMetricsBootProfile, Test_NotReportedByInstances) {
+  memfault_boot_profile_start(123456);
+  s_fake_cycle_count = 64000 * 10;
+  memfault_boot_complete();
+
+  static const sMemfaultDeviceInfo s_device_info = {
+    .device_serial = "DAABBCCDD",
+    .software_type = "main",
+    .software_version = "1.2.3",
+    .hardware_version = "evt_24",
+  };
+  sMfltMetricsCtx ctx;
+  LONGS_EQUAL(0, memfault_metrics_ctx_init(&ctx, s_fake_event_storage_impl, &s_device_info));
+
+  memset(&s_serialized, 0xa5, sizeof(s_serialized));
+  mock().expectOneCall("memfault_metrics_ctx_heartbeat_serialize");
+  CHECK(memfault_metrics_ctx_heartbeat_trigger(&ctx));
+  LONGS_EQUAL(0, s_serialized.uptime_at_reset_ms);
+  LONGS_EQUAL(0, s_serialized.boot_duration_ms);
+
+  // the global heartbeat still reports it
+  prv_trigger_heartbeat();
+  LONGS_EQUAL(123456, s_serialized.uptime_at_reset_ms);
+  LONGS_EQUAL(10, s_serialized.boot_duration_ms);
+}
@@ -0,0 +1,445 @@
+//! @file
+//!
+//! Drives the non-blocking upload state machine the way an event loop would, with a fake
+//! transport which applies backpressure and a fake server which answers every request.
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+  #include "memfault/core/compiler.h"
+  #include "memfault/core/data_packetizer.h"
+  #include "memfault/core/math.h"
+  #include "memfault/http/async_upload.h"
+  #include "memfault/http/http_client.h"
+  #include "memfault/http/retry_policy.h"
+
+  static uint64_t s_time_since_boot_ms;
+
+  uint64_t memfault_platform_get_time_since_boot_ms(void) {
+    return s_time_since_boot_ms;
+  }
+
+  sMfltHttpClientConfig g_mflt_http_client_config = {
+    .api_key = "00112233445566778899aabbccddeeff",
+  };
+}
+
+//
+// A fake packetizer which hands out messages of FAKE_MSG_LEN bytes 100 bytes at a time. A message
+// is only deleted once its delivery is confirmed.
+//
+
+#define FAKE_MSG_LEN 700
+
+static size_t s_num_msgs_pending;
+static size_t s_msg_offset;
+static bool s_awaiting_confirmation;
+
+bool memfault_packetizer_data_available(void) {
+  return s_num_msgs_pending != 0;
+}
+
+bool memfault_packetizer_begin(const sPacketizerConfig *cfg, sPacketizerMetadata *metadata_out) {
+  CHECK(cfg->enable_multi_packet_chunk);
+  CHECK(cfg->enable_delivery_confirmation);
+  if (s_awaiting_confirmation) {
+    // the delivery of the last message was never confirmed, send it again
+    s_awaiting_confirmation = false;
+    s_msg_offset = 0;
+  }
+  if (s_num_msgs_pending == 0) {
+    return false;
+  }
+  memset(metadata_out, 0, sizeof(*metadata_out));
+  metadata_out->single_chunk_message_length = FAKE_MSG_LEN;
+  metadata_out->send_in_progress = (s_msg_offset != 0);
+  return true;
+}
+
+eMemfaultPacketizerStatus memfault_packetizer_get_next(void *buf, size_t *buf_len) {
+  if ((s_num_msgs_pending == 0) || s_awaiting_confirmation) {
+    return kMemfaultPacketizerStatus_NoMoreData;
+  }
+  const size_t len = MEMFAULT_MIN(MEMFAULT_MIN(*buf_len, (size_t)100), FAKE_MSG_LEN - s_msg_offset);
+  memset(buf, 'a' + (int)(s_num_msgs_pending % 26), len);
+  *buf_len = len;
+  s_msg_offset += len;
+  if (s_msg_offset == FAKE_MSG_LEN) {
+    s_awaiting_confirmation = true;
+    return kMemfaultPacketizerStatus_EndOfChunk;
+  }
+  return kMemfaultPacketizerStatus_MoreDataForChunk;
+}
+
+void memfault_packetizer_confirm_delivery(void) {
+  if (!s_awaiting_confirmation) {
+    return;
+  }
+  s_awaiting_confirmation = false;
+  s_msg_offset = 0;
+  s_num_msgs_pending--;
+}
+
+void memfault_packetizer_abort(void) {
+  mock().actualCall(__func__);
+  s_awaiting_confirmation = false;
+  s_msg_offset = 0;
+}
+
+//
+// A fake non-blocking transport. The server end accepts SEND_WINDOW bytes before the
+// connection reports it is backed up. Once a whole request has been received, the response is
+// queued up to be read.
+//
+
+#define SEND_WINDOW 64
+
+static struct {
+  int connect_rv;
+  int send_rv;
+  bool connected;
+  size_t num_closes;
+  size_t window_remaining;
+  size_t num_would_block;
+
+  // server side
+  char request[1024];
+  size_t request_len;
+  size_t num_requests;
+  const char *response;
+  size_t response_offset;
+  bool response_ready;
+} s_transport;
+
+static int prv_connect(MEMFAULT_UNUSED void *ctx) {
+  s_transport.connected = (s_transport.connect_rv == 0);
+  return s_transport.connect_rv;
+}
+
+//! A request is complete once all the bytes announced in the Content-Length have been received
+static void prv_server_check_for_request(void) {
+  s_transport.request[s_transport.request_len] = '\0';
+  const char *hdr_end = strstr(s_transport.request, "\r\n\r\n");
+  if (hdr_end == NULL) {
+    return;
+  }
+  const char *content_length_hdr = strstr(s_transport.request, "Content-Length:");
+  CHECK(content_length_hdr != NULL);
+  const size_t content_length = strtoul(content_length_hdr + strlen("Content-Length:"), NULL, 10);
+  LONGS_EQUAL(FAKE_MSG_LEN, content_length);
+  const size_t hdr_len = (size_t)(hdr_end + 4 - s_transport.request);
+  if (s_transport.request_len < hdr_len + content_length) {
+    return;
+  }
+  LONGS_EQUAL(hdr_len + content_length, s_transport.request_len);
+
+  s_transport.num_requests++;
+  s_transport.request_len = 0;
+  s_transport.response_offset = 0;
+  s_transport.response_ready = true;
+}
+
+static int prv_send(MEMFAULT_UNUSED void *ctx, const void *data, size_t data_len) {
+  CHECK(s_transport.connected);
+  if (s_transport.send_rv != 0) {
+    return s_transport.send_rv;
+  }
+  if (s_transport.window_remaining == 0) {
+    s_transport.num_would_block++;
+    return 0;
+  }
+  const size_t len = MEMFAULT_MIN(data_len, s_transport.window_remaining);
+  CHECK(s_transport.request_len + len < sizeof(s_transport.request));
+  memcpy(&s_transport.request[s_transport.request_len], data, len);
+  s_transport.request_len += len;
+  s_transport.window_remaining -= len;
+  prv_server_check_for_request();
+  return (int)len;
+}
+
+static int prv_recv(MEMFAULT_UNUSED void *ctx, void *buf, size_t buf_len) {
+  CHECK(s_transport.connected);
+  if (!s_transport.response_ready) {
+    return 0;
+  }
+  const size_t response_len = strlen(s_transport.response);
+  if (s_transport.response_offset == response_len) {
+    return 0;
+  }
+  // trickle the response in a few bytes at a time
+  const size_t len = MEMFAULT_MIN(MEMFAULT_MIN(buf_len, (size_t)7),
+                                  response_len - s_transport.response_offset);
+  memcpy(buf, &s_transport.response[s_transport.response_offset], len);
+  s_transport.response_offset += len;
+  if (s_transport.response_offset == response_len) {
+    s_transport.response_ready = false;
+  }
+  return (int)len;
+}
+
+static void prv_close(MEMFAULT_UNUSED void *ctx) {
+  s_transport.connected = false;
+  s_transport.num_closes++;
+}
+
+static const sMfltHttpAsyncUploadTransport s_fake_transport = {
+  .connect = prv_connect,
+  .send = prv_send,
+  .recv = prv_recv,
+  .close = prv_close,
+};
+
+static void prv_upload_complete(MEMFAULT_UNUSED sMfltHttpAsyncUpload *upload,
+                                eMfltHttpAsyncUploadResult result, MEMFAULT_UNUSED void *ctx) {
+  mock().actualCall(__func__).withParameter("result", (int)result);
+}
+
+static const sMfltHttpAsyncUploadConfig s_upload_cfg = {
+  .transport = &s_fake_transport,
+  .transport_ctx = NULL,
+  .complete_cb = prv_upload_complete,
+  .complete_ctx = NULL,
+};
+
+static sMfltHttpAsyncUpload s_upload;
+
+//! A minimal event loop. The send window is replenished on every iteration, like a socket
+//! draining its buffer onto the network.
+static void prv_run_event_loop(size_t max_iterations) {
+  for (size_t i = 0; (i < max_iterations) && memfault_http_async_upload_in_progress(&s_upload);
+       i++) {
+    s_transport.window_remaining = SEND_WINDOW;
+    if (s_upload.state == kMfltHttpAsyncUploadState_Connecting) {
+      memfault_http_async_upload_on_connected(&s_upload, 0);
+    }
+    if (memfault_http_async_upload_wants_write(&s_upload)) {
+      memfault_http_async_upload_on_writable(&s_upload);
+    }
+    if (memfault_http_async_upload_wants_read(&s_upload) && s_transport.response_ready) {
+      memfault_http_async_upload_on_readable(&s_upload);
+    }
+  }
+}
+
+static const char *s_accepted_rsp = "HTTP/1.1 202 Accepted\r\nContent-Length: 8\r\n\r\nAccepted";
+
+TEST_GROUP(MfltHttpAsyncUpload) {
+  void setup() {
+    memset(&s_transport, 0, sizeof(s_transport));
+    memset(&s_upload, 0, sizeof(s_upload));
+    s_transport.response = s_accepted_rsp;
+    s_num_msgs_pending = 0;
+    s_msg_offset = 0;
+    s_awaiting_confirmation = false;
+    s_time_since_boot_ms = 1;
+    memfault_http_retry_policy_record_success();
+  }
+  void teardown() {
+    mock().checkExpectations();
+    mock().clear();
+  }
+};
+
+TEST(MfltHttpAsyncUpload, Test_NoData) {
+  LONGS_EQUAL(kMfltPostDataStatus_NoDataFound,
+              memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  CHECK(!s_transport.connected);
+  CHECK(!memfault_http_async_upload_in_progress(&s_upload));
+}
+
+TEST(MfltHttpAsyncUpload, Test_ConnectFails) {
+  s_num_msgs_pending = 1;
+  s_transport.connect_rv = -5;
+  LONGS_EQUAL(-5, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  CHECK(!memfault_http_async_upload_in_progress(&s_upload));
+  LONGS_EQUAL(1, memfault_http_retry_policy_get_attempt_count());
+
+  // or the connection attempt fails asynchronously once the retry delay has elapsed
+  s_time_since_boot_ms += memfault_http_retry_policy_get_delay_ms();
+  s_transport.connect_rv = 0;
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  CHECK(!memfault_http_async_upload_wants_write(&s_upload));
+  mock().expectOneCall("memfault_packetizer_abort");
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_ConnectError);
+  memfault_http_async_upload_on_connected(&s_upload, -1);
+  CHECK(!memfault_http_async_upload_in_progress(&s_upload));
+  LONGS_EQUAL(1, s_num_msgs_pending);
+}
+
+TEST(MfltHttpAsyncUpload, Test_UploadWithBackpressure) {
+  s_num_msgs_pending = 3;
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  // can't start another upload while one is in progress
+  CHECK(memfault_http_async_upload_start(&s_upload, &s_upload_cfg) < 0);
+  memfault_http_async_upload_on_connected(&s_upload, 0);
+  CHECK(memfault_http_async_upload_wants_write(&s_upload));
+
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_Success);
+  prv_run_event_loop(1000);
+
+  CHECK(!memfault_http_async_upload_in_progress(&s_upload));
+  LONGS_EQUAL(0, s_num_msgs_pending);
+  // all the messages are posted over the same connection
+  LONGS_EQUAL(3, s_transport.num_requests);
+  LONGS_EQUAL(3, s_upload.num_posts);
+  LONGS_EQUAL(202, s_upload.http_status_code);
+  LONGS_EQUAL(1, s_transport.num_closes);
+  // the state machine stopped when the transport was backed up rather than spinning
+  CHECK(s_transport.num_would_block > 0);
+}
+
+TEST(MfltHttpAsyncUpload, Test_ServerClosesConnection) {
+  s_num_msgs_pending = 2;
+  s_transport.response = "HTTP/1.1 202 Accepted\r\nConnection: close\r\n"
+                         "Transfer-Encoding: chunked\r\n\r\n8\r\nAccepted\r\n0\r\n\r\n";
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_Success);
+  prv_run_event_loop(1000);
+
+  LONGS_EQUAL(0, s_num_msgs_pending);
+  LONGS_EQUAL(2, s_transport.num_requests);
+  LONGS_EQUAL(2, s_upload.num_posts);
+  // a new connection is opened for the second message
+  LONGS_EQUAL(2, s_transport.num_closes);
+}
+
+TEST(MfltHttpAsyncUpload, Test_TimeoutMidRequest) {
+  s_num_msgs_pending = 2;
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  memfault_http_async_upload_on_connected(&s_upload, 0);
+
+  s_transport.window_remaining = 300;
+  memfault_http_async_upload_on_writable(&s_upload);
+  CHECK(memfault_http_async_upload_wants_write(&s_upload));
+
+  // the partially sent message is handed back to the packetizer
+  mock().expectOneCall("memfault_packetizer_abort");
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_Timeout);
+  memfault_http_async_upload_on_timeout(&s_upload);
+  CHECK(!memfault_http_async_upload_in_progress(&s_upload));
+  LONGS_EQUAL(2, s_num_msgs_pending);
+  LONGS_EQUAL(0, s_msg_offset);
+  LONGS_EQUAL(1, s_transport.num_closes);
+
+  // a timeout while idle is a no-op
+  memfault_http_async_upload_on_timeout(&s_upload);
+}
+
+TEST(MfltHttpAsyncUpload, Test_TimeoutAwaitingResponse) {
+  s_num_msgs_pending = 1;
+  s_transport.response = "HTTP/1.1 202 Accepted\r\n";
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  prv_run_event_loop(1000);
+  LONGS_EQUAL(1, s_transport.num_requests);
+  CHECK(memfault_http_async_upload_wants_read(&s_upload));
+
+  // the whole message was handed off but the response never arrived so it is kept
+  mock().expectOneCall("memfault_packetizer_abort");
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_Timeout);
+  memfault_http_async_upload_on_timeout(&s_upload);
+  LONGS_EQUAL(1, s_num_msgs_pending);
+
+  // and sent again in its entirety by the next upload
+  s_time_since_boot_ms += memfault_http_retry_policy_get_delay_ms();
+  s_transport.response = s_accepted_rsp;
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_Success);
+  prv_run_event_loop(1000);
+  LONGS_EQUAL(2, s_transport.num_requests);
+  LONGS_EQUAL(0, s_num_msgs_pending);
+}
+
+TEST(MfltHttpAsyncUpload, Test_SendError) {
+  s_num_msgs_pending = 1;
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  memfault_http_async_upload_on_connected(&s_upload, 0);
+
+  s_transport.send_rv = -1;
+  mock().expectOneCall("memfault_packetizer_abort");
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_SendError);
+  memfault_http_async_upload_on_writable(&s_upload);
+  CHECK(!memfault_http_async_upload_in_progress(&s_upload));
+}
+
+TEST(MfltHttpAsyncUpload, Test_ServerError) {
+  s_num_msgs_pending = 2;
+  s_transport.response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n";
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  memfault_http_async_upload_on_connected(&s_upload, 0);
+
+  // a 500 is worth retrying so the message is kept
+  mock().expectOneCall("memfault_packetizer_abort");
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_HttpError);
+  prv_run_event_loop(1000);
+  LONGS_EQUAL(500, s_upload.http_status_code);
+  LONGS_EQUAL(0, s_upload.num_posts);
+  LONGS_EQUAL(1, s_transport.num_requests);
+  LONGS_EQUAL(2, s_num_msgs_pending);
+}
+
+TEST(MfltHttpAsyncUpload, Test_MessageRejected) {
+  s_num_msgs_pending = 2;
+  s_transport.response = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+
+  // the server will never accept the message so it is dropped rather than sent again
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_HttpError);
+  prv_run_event_loop(1000);
+  LONGS_EQUAL(400, s_upload.http_status_code);
+  LONGS_EQUAL(1, s_num_msgs_pending);
+}
+
+TEST(MfltHttpAsyncUpload, Test_RetryAfterServerError) {
+  s_num_msgs_pending = 2;
+  s_transport.response = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 30\r\n"
+                         "Content-Length: 0\r\n\r\n";
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  mock().expectOneCall("memfault_packetizer_abort");
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_HttpError);
+  prv_run_event_loop(1000);
+  LONGS_EQUAL(1, memfault_http_retry_policy_get_attempt_count());
+
+  // the next upload is held off until the delay requested by the server has elapsed
+  LONGS_EQUAL(kMfltPostDataStatus_RetryLater,
+              memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  CHECK(!memfault_http_async_upload_in_progress(&s_upload));
+  s_time_since_boot_ms += 30 * 1000;
+
+  s_transport.response = s_accepted_rsp;
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_Success);
+  prv_run_event_loop(1000);
+  LONGS_EQUAL(0, s_num_msgs_pending);
+  LONGS_EQUAL(0, memfault_http_retry_policy_get_attempt_count());
+}
+
+TEST(MfltHttpAsyncUpload, Test_MalformedResponse) {
+  s_num_msgs_pending = 1;
+  s_transport.response = "HTTP/1.1 2xx Accepted\r\n\r\n";
+  LONGS_EQUAL(0, memfault_http_async_upload_start(&s_upload, &s_upload_cfg));
+  memfault_http_async_upload_on_connected(&s_upload, 0);
+
+  mock().expectOneCall("memfault_packetizer_abort");
+  mock().expectOneCall("prv_upload_complete")
+      .withParameter("result", kMfltHttpAsyncUploadResult_ParseError);
+  prv_run_event_loop(1000);
+  CHECK(!memfault_http_async_upload_in_progress(&s_upload));
+}
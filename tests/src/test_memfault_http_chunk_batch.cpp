@@ -0,0 +1,321 @@
+//! @file
+//!
+//! Exercises batching of multiple chunks in a single POST body. Requests are decoded by a stand-in
+//! for the Memfault chunks endpoint which reassembles the messages and checks their content.
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+extern "C" {
+  #include "memfault/core/data_packetizer.h"
+  #include "memfault/core/math.h"
+  #include "memfault/http/chunk_batch.h"
+  #include "memfault/http/http_client.h"
+  #include "memfault/http/utils.h"
+
+  sMfltHttpClientConfig g_mflt_http_client_config = {
+    .api_key = "00112233445566778899aabbccddeeff",
+  };
+}
+
+#define MAX_FAKE_MSGS 64
+
+//
+// A fake packetizer. Every chunk is made up of a 3 byte header (message id & offset of the data
+// within the message) followed by the message data. Like the real packetizer, a message which
+// doesn't fit in the buffer provided is split across several chunks.
+//
+
+#define FAKE_CHUNK_HDR_LEN 3
+
+static struct {
+  size_t msg_sizes[MAX_FAKE_MSGS];
+  size_t num_msgs;
+  size_t curr_msg;
+  size_t curr_offset;
+  //! The number of messages which have been completely drained, i.e marked as read
+  size_t num_msgs_read;
+} s_fake_packetizer;
+
+static uint8_t prv_msg_byte(size_t msg_id, size_t offset) {
+  return (uint8_t)((msg_id * 31) + offset);
+}
+
+static void prv_queue_msgs(size_t num_msgs, size_t msg_size) {
+  for (size_t i = 0; i < num_msgs; i++) {
+    CHECK(s_fake_packetizer.num_msgs < MAX_FAKE_MSGS);
+    s_fake_packetizer.msg_sizes[s_fake_packetizer.num_msgs++] = msg_size;
+  }
+}
+
+bool memfault_packetizer_get_chunk(void *buf, size_t *buf_len) {
+  CHECK(*buf_len >= MEMFAULT_PACKETIZER_MIN_BUF_LEN);
+  if (s_fake_packetizer.curr_msg == s_fake_packetizer.num_msgs) {
+    return false;
+  }
+
+  const size_t msg_id = s_fake_packetizer.curr_msg;
+  const size_t offset = s_fake_packetizer.curr_offset;
+  const size_t msg_size = s_fake_packetizer.msg_sizes[msg_id];
+  const size_t data_len = MEMFAULT_MIN(msg_size - offset, *buf_len - FAKE_CHUNK_HDR_LEN);
+
+  uint8_t *chunk = (uint8_t *)buf;
+  chunk[0] = (uint8_t)msg_id;
+  chunk[1] = (uint8_t)(offset & 0xff);
+  chunk[2] = (uint8_t)(offset >> 8);
+  for (size_t i = 0; i < data_len; i++) {
+    chunk[FAKE_CHUNK_HDR_LEN + i] = prv_msg_byte(msg_id, offset + i);
+  }
+  *buf_len = FAKE_CHUNK_HDR_LEN + data_len;
+
+  s_fake_packetizer.curr_offset += data_len;
+  if (s_fake_packetizer.curr_offset == msg_size) {
+    s_fake_packetizer.curr_msg++;
+    s_fake_packetizer.curr_offset = 0;
+    s_fake_packetizer.num_msgs_read++;
+  }
+  return true;
+}
+
+//
+// Stand-in for the chunks endpoint
+//
+
+static struct {
+  size_t num_requests;
+  size_t num_compressed_requests;
+  size_t num_chunks;
+  size_t bytes_received[MAX_FAKE_MSGS];
+} s_server;
+
+static void prv_server_handle_chunk(const uint8_t *chunk, size_t chunk_len) {
+  CHECK(chunk_len > FAKE_CHUNK_HDR_LEN);
+  const size_t msg_id = chunk[0];
+  const size_t offset = (size_t)chunk[1] | ((size_t)chunk[2] << 8);
+  CHECK(msg_id < MAX_FAKE_MSGS);
+
+  // chunks for a message must arrive in order
+  LONGS_EQUAL(s_server.bytes_received[msg_id], offset);
+  for (size_t i = FAKE_CHUNK_HDR_LEN; i < chunk_len; i++) {
+    LONGS_EQUAL(prv_msg_byte(msg_id, offset + i - FAKE_CHUNK_HDR_LEN), chunk[i]);
+  }
+  s_server.bytes_received[msg_id] += chunk_len - FAKE_CHUNK_HDR_LEN;
+  s_server.num_chunks++;
+}
+
+//! @return the HTTP status code the server would respond with
+static int prv_server_handle_request(const char *req, size_t req_len) {
+  const char *hdr_end = strstr(req, "\r\n\r\n");
+  CHECK(hdr_end != NULL);
+  const char *expected_request_line = "POST /api/v0/chunks/DAABBCCDD HTTP/1.1\r\n";
+  if (strncmp(req, expected_request_line, strlen(expected_request_line)) != 0) {
+    return 404;
+  }
+
+  const char *content_type = strstr(req, "Content-Type:multipart/mixed; boundary=");
+  const char *content_length_hdr = strstr(req, "Content-Length:");
+  if ((content_type == NULL) || (content_type > hdr_end) || (content_length_hdr == NULL)) {
+    return 400;
+  }
+
+  const uint8_t *body = (const uint8_t *)hdr_end + 4;
+  size_t body_len = req_len - (size_t)(body - (const uint8_t *)req);
+  LONGS_EQUAL(body_len, strtoul(content_length_hdr + strlen("Content-Length:"), NULL, 10));
+
+  static uint8_t s_inflated_body[32 * 1024];
+  const char *content_encoding =
+      strstr(req, "Content-Encoding:" MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_ENCODING "\r\n");
+  if ((content_encoding != NULL) && (content_encoding < hdr_end)) {
+    uLongf inflated_len = sizeof(s_inflated_body);
+    if (uncompress(s_inflated_body, &inflated_len, body, (uLong)body_len) != Z_OK) {
+      return 400;
+    }
+    body = s_inflated_body;
+    body_len = inflated_len;
+  }
+
+  // every part holds a chunk and the body is closed by "--<boundary>--\r\n", see RFC 2046
+  char boundary[80];
+  sscanf(content_type, "Content-Type:multipart/mixed; boundary=%79s", boundary);
+  char delimiter[84];
+  const size_t delimiter_len = (size_t)snprintf(delimiter, sizeof(delimiter), "--%s", boundary);
+  const char *part_hdr = "\r\nContent-Type:application/octet-stream\r\n\r\n";
+  size_t offset = 0;
+  while (1) {
+    CHECK(offset + delimiter_len + 2 <= body_len);
+    CHECK(memcmp(&body[offset], delimiter, delimiter_len) == 0);
+    offset += delimiter_len;
+    if (memcmp(&body[offset], "--\r\n", 4) == 0) {
+      LONGS_EQUAL(body_len, offset + 4);
+      break;
+    }
+    CHECK(memcmp(&body[offset], part_hdr, strlen(part_hdr)) == 0);
+    offset += strlen(part_hdr);
+
+    // the chunk ends where the delimiter of the next part starts
+    size_t chunk_len = 0;
+    while ((offset + chunk_len + 2 + delimiter_len) <= body_len) {
+      if ((memcmp(&body[offset + chunk_len], "\r\n", 2) == 0) &&
+          (memcmp(&body[offset + chunk_len + 2], delimiter, delimiter_len) == 0)) {
+        break;
+      }
+      chunk_len++;
+    }
+    CHECK(offset + chunk_len + 2 + delimiter_len <= body_len);
+    prv_server_handle_chunk(&body[offset], chunk_len);
+    offset += chunk_len + 2;
+  }
+  s_server.num_requests++;
+  return 202;
+}
+
+typedef struct {
+  char *buf;
+  size_t buf_len;
+  size_t bytes_written;
+} sRequestWriteCtx;
+
+static bool prv_request_write_cb(const void *data, size_t data_len, void *ctx) {
+  sRequestWriteCtx *write_ctx = (sRequestWriteCtx *)ctx;
+  CHECK(write_ctx->bytes_written + data_len <= write_ctx->buf_len);
+  memcpy(&write_ctx->buf[write_ctx->bytes_written], data, data_len);
+  write_ctx->bytes_written += data_len;
+  return true;
+}
+
+//! Mirrors what a port does to post all the data queued up in batches
+//!
+//! @return the number of requests which were posted
+static size_t prv_post_all_data_in_batches(size_t body_budget, bool compress) {
+  uint8_t *body = (uint8_t *)malloc(body_budget);
+  uint8_t *compressed_body = (uint8_t *)malloc(body_budget);
+  const size_t request_buf_len = body_budget + 512;
+  char *request = (char *)malloc(request_buf_len);
+
+  size_t num_posts = 0;
+  sMfltHttpChunkBatch batch;
+  while (memfault_http_chunk_batch_build(body, body_budget, &batch)) {
+    CHECK(batch.body_len <= body_budget);
+    CHECK(batch.num_chunks > 0);
+
+    sRequestWriteCtx ctx = { .buf = request, .buf_len = request_buf_len, .bytes_written = 0 };
+    size_t compressed_len;
+    if (compress && memfault_http_chunk_batch_compress(body, batch.body_len, compressed_body,
+                                                       body_budget, &compressed_len)) {
+      CHECK(compressed_len < batch.body_len);
+      CHECK(memfault_http_start_compressed_chunk_batch_post(prv_request_write_cb, &ctx,
+                                                            compressed_len));
+      CHECK(prv_request_write_cb(compressed_body, compressed_len, &ctx));
+      s_server.num_compressed_requests++;
+    } else {
+      CHECK(memfault_http_start_chunk_batch_post(prv_request_write_cb, &ctx, batch.body_len));
+      CHECK(prv_request_write_cb(body, batch.body_len, &ctx));
+    }
+    request[ctx.bytes_written] = '\0';
+
+    const size_t num_chunks_before = s_server.num_chunks;
+    LONGS_EQUAL(202, prv_server_handle_request(request, ctx.bytes_written));
+    LONGS_EQUAL(batch.num_chunks, s_server.num_chunks - num_chunks_before);
+    num_posts++;
+  }
+  LONGS_EQUAL(0, batch.num_chunks);
+
+  free(body);
+  free(compressed_body);
+  free(request);
+  return num_posts;
+}
+
+static void prv_check_all_msgs_received(void) {
+  LONGS_EQUAL(s_fake_packetizer.num_msgs, s_fake_packetizer.num_msgs_read);
+  for (size_t i = 0; i < s_fake_packetizer.num_msgs; i++) {
+    LONGS_EQUAL(s_fake_packetizer.msg_sizes[i], s_server.bytes_received[i]);
+  }
+}
+
+TEST_GROUP(MfltHttpChunkBatch) {
+  void setup() {
+    memset(&s_fake_packetizer, 0, sizeof(s_fake_packetizer));
+    memset(&s_server, 0, sizeof(s_server));
+  }
+  void teardown() {
+    mock().checkExpectations();
+    mock().clear();
+  }
+};
+
+TEST(MfltHttpChunkBatch, Test_NoData) {
+  uint8_t body[64];
+  sMfltHttpChunkBatch batch;
+  CHECK(!memfault_http_chunk_batch_build(body, sizeof(body), &batch));
+  LONGS_EQUAL(0, batch.body_len);
+  LONGS_EQUAL(0, batch.num_chunks);
+}
+
+TEST(MfltHttpChunkBatch, Test_BufferTooSmall) {
+  prv_queue_msgs(1, 10);
+  uint8_t body[MEMFAULT_PACKETIZER_MIN_BUF_LEN];
+  CHECK(!memfault_http_chunk_batch_build(body, sizeof(body), NULL));
+  LONGS_EQUAL(0, s_fake_packetizer.num_msgs_read);
+}
+
+TEST(MfltHttpChunkBatch, Test_ManySmallMessagesInOnePost) {
+  // i.e a burst of events & heartbeats
+  prv_queue_msgs(40, 60);
+  LONGS_EQUAL(1, prv_post_all_data_in_batches(16 * 1024, false));
+  LONGS_EQUAL(40, s_server.num_chunks);
+  prv_check_all_msgs_received();
+}
+
+TEST(MfltHttpChunkBatch, Test_MessagesSplitAcrossBudget) {
+  prv_queue_msgs(5, 300);
+  const size_t num_posts = prv_post_all_data_in_batches(256, false);
+  // 5 * 300 bytes of data, with the chunk and multipart framing, in 256 byte bodies
+  LONGS_EQUAL(15, num_posts);
+  LONGS_EQUAL(num_posts, s_server.num_requests);
+  prv_check_all_msgs_received();
+}
+
+TEST(MfltHttpChunkBatch, Test_LargeChunkAndSmallOnes) {
+  prv_queue_msgs(1, 10 * 1024);
+  prv_queue_msgs(3, 20);
+  LONGS_EQUAL(1, prv_post_all_data_in_batches(16 * 1024, false));
+  LONGS_EQUAL(4, s_server.num_chunks);
+  prv_check_all_msgs_received();
+}
+
+TEST(MfltHttpChunkBatch, Test_CompressedBatches) {
+  prv_queue_msgs(40, 60);
+  prv_queue_msgs(2, 3000);
+  const size_t num_posts = prv_post_all_data_in_batches(2048, true);
+  LONGS_EQUAL(num_posts, s_server.num_requests);
+  LONGS_EQUAL(num_posts, s_server.num_compressed_requests);
+  prv_check_all_msgs_received();
+}
+
+TEST(MfltHttpChunkBatch, Test_CompressFallsBackWhenNotSmaller) {
+  uint8_t body[200];
+  uint32_t rand_state = 0xdeadbeef;
+  for (size_t i = 0; i < sizeof(body); i++) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    body[i] = (uint8_t)rand_state;
+  }
+  uint8_t out[sizeof(body) * 2];
+  size_t out_len;
+  CHECK(!memfault_http_chunk_batch_compress(body, sizeof(body), out, sizeof(out), &out_len));
+  CHECK(!memfault_http_chunk_batch_compress(body, 0, out, sizeof(out), &out_len));
+
+  // or when the output buffer is too small
+  memset(body, 0, sizeof(body));
+  CHECK(memfault_http_chunk_batch_compress(body, sizeof(body), out, sizeof(out), &out_len));
+  CHECK(!memfault_http_chunk_batch_compress(body, sizeof(body), out, out_len - 1, &out_len));
+}
@@ -0,0 +1,384 @@
+//! @file
+//!
+//! @brief
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+  #include "memfault/core/compiler.h"
+  #include "memfault/core/math.h"
+  #include "memfault/http/chunk_batch.h"
+  #include "memfault/http/gateway.h"
+  #include "memfault/http/http_client.h"
+  #include "memfault/http/utils.h"
+
+  sMfltHttpClientConfig g_mflt_http_client_config = {
+    .api_key = "00112233445566778899aabbccddeeff",
+  };
+}
+
+#define MAX_DEVICES 3
+#define QUEUE_SIZE 64
+
+//! The length of a batch holding 'num_chunks' chunks of 'chunk_len' bytes
+#define BATCH_LEN(num_chunks, chunk_len)                                      \
+  (((num_chunks) * (MEMFAULT_HTTP_CHUNK_BATCH_PART_OVERHEAD + (chunk_len))) + \
+   MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN)
+#define MAX_BODY_LEN BATCH_LEN(4, 20)
+
+static sMfltGateway s_gateway;
+static sMfltGatewayDevice s_devices[MAX_DEVICES];
+static uint8_t s_storage[MAX_DEVICES * QUEUE_SIZE];
+
+//
+// Helpers to parse a batch back into its chunks
+//
+
+//! @param[out] chunk_tags The first byte of every chunk, which the tests use to tag chunks with a
+//!   sequence number
+//!
+//! @return the number of chunks found in the batch
+static size_t prv_parse_body(const uint8_t *body, size_t body_len, const size_t chunk_lens[],
+                             uint8_t chunk_tags[], size_t max_chunks) {
+  const char *part_header = MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER;
+  size_t offset = 0;
+  size_t num_chunks = 0;
+  while ((body_len - offset) > MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN) {
+    CHECK(num_chunks < max_chunks);
+    MEMCMP_EQUAL(part_header, &body[offset], strlen(part_header));
+    offset += strlen(part_header);
+    chunk_tags[num_chunks] = body[offset];
+    offset += chunk_lens[num_chunks];
+    MEMCMP_EQUAL(MEMFAULT_HTTP_CHUNK_BATCH_PART_END, &body[offset], 2);
+    offset += 2;
+    num_chunks++;
+  }
+  LONGS_EQUAL(MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN, body_len - offset);
+  MEMCMP_EQUAL(MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER, &body[offset],
+               MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN);
+  return num_chunks;
+}
+
+//! Builds the next batch, checks it belongs to 'device_serial' and holds 'num_chunks' chunks of
+//! 'chunk_len' bytes tagged from 'first_tag' onwards, then completes it
+static void prv_check_next_batch(const char *device_serial, size_t num_chunks, size_t chunk_len,
+                                 uint8_t first_tag) {
+  uint8_t body[MAX_BODY_LEN];
+  sMfltGatewayBatch batch;
+  CHECK(memfault_gateway_batch_build(&s_gateway, body, sizeof(body), &batch));
+  STRCMP_EQUAL(device_serial, batch.device_serial);
+  LONGS_EQUAL(num_chunks, batch.num_chunks);
+  LONGS_EQUAL(BATCH_LEN(num_chunks, chunk_len), batch.body_len);
+
+  size_t chunk_lens[8];
+  uint8_t chunk_tags[8];
+  CHECK(num_chunks <= MEMFAULT_ARRAY_SIZE(chunk_lens));
+  for (size_t i = 0; i < num_chunks; i++) {
+    chunk_lens[i] = chunk_len;
+  }
+  LONGS_EQUAL(num_chunks, prv_parse_body(body, batch.body_len, chunk_lens, chunk_tags,
+                                         MEMFAULT_ARRAY_SIZE(chunk_tags)));
+  for (size_t i = 0; i < num_chunks; i++) {
+    LONGS_EQUAL(first_tag + i, chunk_tags[i]);
+  }
+  memfault_gateway_batch_complete(&s_gateway, true);
+}
+
+static void prv_add_chunk(const char *device_serial, uint8_t tag, size_t chunk_len) {
+  uint8_t chunk[QUEUE_SIZE] = { 0 };
+  CHECK(chunk_len <= sizeof(chunk));
+  memset(chunk, tag, chunk_len);
+  LONGS_EQUAL(0, memfault_gateway_add_chunk(&s_gateway, device_serial, chunk, chunk_len));
+}
+
+static void prv_init(size_t max_body_len) {
+  CHECK(memfault_gateway_init(&s_gateway, s_devices, MAX_DEVICES, s_storage, sizeof(s_storage),
+                              max_body_len));
+}
+
+TEST_GROUP(MfltHttpGateway) {
+  void setup() {
+    prv_init(MAX_BODY_LEN);
+  }
+  void teardown() {
+  }
+};
+
+TEST(MfltHttpGateway, Test_BadArguments) {
+  sMfltGateway gateway;
+  const size_t storage_len = sizeof(s_storage);
+  CHECK(!memfault_gateway_init(NULL, s_devices, MAX_DEVICES, s_storage, storage_len,
+                               MAX_BODY_LEN));
+  CHECK(!memfault_gateway_init(&gateway, NULL, MAX_DEVICES, s_storage, storage_len,
+                               MAX_BODY_LEN));
+  CHECK(!memfault_gateway_init(&gateway, s_devices, 0, s_storage, storage_len, MAX_BODY_LEN));
+  CHECK(!memfault_gateway_init(&gateway, s_devices, MAX_DEVICES, NULL, storage_len,
+                               MAX_BODY_LEN));
+  CHECK(!memfault_gateway_init(&gateway, s_devices, MAX_DEVICES, s_storage, MAX_DEVICES * 2,
+                               MAX_BODY_LEN));
+  CHECK(!memfault_gateway_init(&gateway, s_devices, MAX_DEVICES, s_storage, storage_len, 0));
+  prv_init(MAX_BODY_LEN);
+
+  const uint8_t chunk[4] = { 0 };
+  LONGS_EQUAL(kMfltGatewayError_InvalidInput,
+              memfault_gateway_add_chunk(&s_gateway, NULL, chunk, sizeof(chunk)));
+  LONGS_EQUAL(kMfltGatewayError_InvalidInput,
+              memfault_gateway_add_chunk(&s_gateway, "", chunk, sizeof(chunk)));
+  LONGS_EQUAL(kMfltGatewayError_InvalidInput,
+              memfault_gateway_add_chunk(&s_gateway, "DEV1", NULL, sizeof(chunk)));
+  LONGS_EQUAL(kMfltGatewayError_InvalidInput,
+              memfault_gateway_add_chunk(&s_gateway, "DEV1", chunk, 0));
+
+  char long_serial[MEMFAULT_GATEWAY_MAX_DEVICE_SERIAL_LEN + 2];
+  memset(long_serial, 'A', sizeof(long_serial) - 1);
+  long_serial[sizeof(long_serial) - 1] = '\0';
+  LONGS_EQUAL(kMfltGatewayError_InvalidInput,
+              memfault_gateway_add_chunk(&s_gateway, long_serial, chunk, sizeof(chunk)));
+
+  uint8_t body[MAX_BODY_LEN];
+  CHECK(!memfault_gateway_batch_build(&s_gateway, NULL, sizeof(body), NULL));
+  LONGS_EQUAL(0, memfault_gateway_get_num_queued_chunks(&s_gateway));
+
+  // the buffer must be able to hold the largest body the chunks were accepted for
+  prv_add_chunk("DEV1", 1, 4);
+  CHECK(!memfault_gateway_batch_build(&s_gateway, body, sizeof(body) - 1, NULL));
+  CHECK(memfault_gateway_batch_build(&s_gateway, body, sizeof(body), NULL));
+}
+
+TEST(MfltHttpGateway, Test_NoData) {
+  uint8_t body[MAX_BODY_LEN];
+  sMfltGatewayBatch batch;
+  CHECK(!memfault_gateway_batch_build(&s_gateway, body, sizeof(body), &batch));
+  LONGS_EQUAL(0, batch.body_len);
+  LONGS_EQUAL(0, batch.num_chunks);
+  POINTERS_EQUAL(NULL, batch.device_serial);
+}
+
+TEST(MfltHttpGateway, Test_BatchFormat) {
+  const uint8_t chunk1[] = { 0x01, 0x02, 0x03 };
+  const uint8_t chunk2[] = { 0x04 };
+  LONGS_EQUAL(0, memfault_gateway_add_chunk(&s_gateway, "AB", chunk1, sizeof(chunk1)));
+  LONGS_EQUAL(0, memfault_gateway_add_chunk(&s_gateway, "AB", chunk2, sizeof(chunk2)));
+  LONGS_EQUAL(0, memfault_gateway_add_chunk(&s_gateway, "C", chunk2, sizeof(chunk2)));
+
+  uint8_t body[MAX_BODY_LEN];
+  sMfltGatewayBatch batch;
+  CHECK(memfault_gateway_batch_build(&s_gateway, body, sizeof(body), &batch));
+
+  // the chunks of a single device, laid out like memfault_http_chunk_batch_build() does
+  const char expected[] =
+      MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER "\x01\x02\x03" MEMFAULT_HTTP_CHUNK_BATCH_PART_END
+      MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER "\x04" MEMFAULT_HTTP_CHUNK_BATCH_PART_END
+      MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER;
+  LONGS_EQUAL(sizeof(expected) - 1, batch.body_len);
+  MEMCMP_EQUAL(expected, body, sizeof(expected) - 1);
+  LONGS_EQUAL(2, batch.num_chunks);
+  STRCMP_EQUAL("AB", batch.device_serial);
+
+  // only one batch can be in flight
+  CHECK(!memfault_gateway_batch_build(&s_gateway, body, sizeof(body), &batch));
+
+  memfault_gateway_batch_complete(&s_gateway, true);
+  LONGS_EQUAL(1, memfault_gateway_get_num_queued_chunks(&s_gateway));
+  prv_check_next_batch("C", 1, sizeof(chunk2), 0x04);
+  LONGS_EQUAL(0, memfault_gateway_get_num_queued_chunks(&s_gateway));
+  CHECK(!memfault_gateway_batch_build(&s_gateway, body, sizeof(body), &batch));
+
+  sMfltGatewayDeviceStats stats;
+  CHECK(memfault_gateway_get_device_stats(&s_gateway, "AB", &stats));
+  LONGS_EQUAL(2, stats.num_chunks_received);
+  LONGS_EQUAL(2, stats.num_chunks_forwarded);
+  LONGS_EQUAL(0, stats.num_chunks_rejected);
+  CHECK(!memfault_gateway_get_device_stats(&s_gateway, "XYZ", &stats));
+}
+
+TEST(MfltHttpGateway, Test_FailedBatchIsResent) {
+  prv_add_chunk("DEV1", 1, 8);
+  prv_add_chunk("DEV1", 2, 8);
+
+  uint8_t body[MAX_BODY_LEN];
+  sMfltGatewayBatch batch;
+  CHECK(memfault_gateway_batch_build(&s_gateway, body, sizeof(body), &batch));
+  LONGS_EQUAL(2, batch.num_chunks);
+  memfault_gateway_batch_complete(&s_gateway, false);
+  LONGS_EQUAL(2, memfault_gateway_get_num_queued_chunks(&s_gateway));
+
+  // chunks added while a batch is in flight are picked up by the next one, in order
+  CHECK(memfault_gateway_batch_build(&s_gateway, body, sizeof(body), &batch));
+  prv_add_chunk("DEV1", 3, 8);
+  memfault_gateway_batch_complete(&s_gateway, false);
+
+  prv_check_next_batch("DEV1", 3, 8, 1);
+  LONGS_EQUAL(0, memfault_gateway_get_num_queued_chunks(&s_gateway));
+}
+
+TEST(MfltHttpGateway, Test_QueueIsBounded) {
+  // each chunk takes 20 + MEMFAULT_GATEWAY_CHUNK_OVERHEAD bytes of the 64 byte queue
+  prv_add_chunk("DEV1", 1, 20);
+  prv_add_chunk("DEV1", 2, 20);
+
+  const uint8_t chunk[20] = { 0 };
+  LONGS_EQUAL(kMfltGatewayError_QueueFull,
+              memfault_gateway_add_chunk(&s_gateway, "DEV1", chunk, sizeof(chunk)));
+  // the queues of other devices are independent
+  prv_add_chunk("DEV2", 1, 20);
+
+  sMfltGatewayDeviceStats stats;
+  CHECK(memfault_gateway_get_device_stats(&s_gateway, "DEV1", &stats));
+  LONGS_EQUAL(2, stats.num_chunks_received);
+  LONGS_EQUAL(1, stats.num_chunks_rejected);
+
+  // room frees up once a batch has been delivered
+  prv_check_next_batch("DEV1", 2, 20, 1);
+  prv_add_chunk("DEV1", 3, 20);
+}
+
+TEST(MfltHttpGateway, Test_DeviceSlotsAreReused) {
+  prv_add_chunk("DEV1", 1, 4);
+  prv_add_chunk("DEV2", 1, 4);
+  prv_add_chunk("DEV3", 1, 4);
+
+  const uint8_t chunk[4] = { 0 };
+  LONGS_EQUAL(kMfltGatewayError_NoDeviceSlot,
+              memfault_gateway_add_chunk(&s_gateway, "DEV4", chunk, sizeof(chunk)));
+
+  uint8_t body[MAX_BODY_LEN];
+  sMfltGatewayBatch batch;
+  CHECK(memfault_gateway_batch_build(&s_gateway, body, sizeof(body), &batch));
+  STRCMP_EQUAL("DEV1", batch.device_serial);
+  // the device of the batch in flight keeps its slot
+  LONGS_EQUAL(kMfltGatewayError_NoDeviceSlot,
+              memfault_gateway_add_chunk(&s_gateway, "DEV4", chunk, sizeof(chunk)));
+  memfault_gateway_batch_complete(&s_gateway, true);
+
+  // once drained, the slot of a device can be handed over
+  prv_add_chunk("DEV4", 1, 4);
+  sMfltGatewayDeviceStats stats;
+  CHECK(memfault_gateway_get_device_stats(&s_gateway, "DEV4", &stats));
+  LONGS_EQUAL(1, stats.num_chunks_received);
+  LONGS_EQUAL(0, stats.num_chunks_forwarded);
+  CHECK(!memfault_gateway_get_device_stats(&s_gateway, "DEV1", &stats));
+}
+
+TEST(MfltHttpGateway, Test_FairScheduling) {
+  // Room for 4 chunks per batch
+  prv_init(BATCH_LEN(4, 6));
+
+  // DEV1 has a deep backlog, DEV2 and DEV3 only have a couple of chunks
+  for (uint8_t i = 0; i < 6; i++) {
+    prv_add_chunk("DEV1", i, 6);
+  }
+  prv_add_chunk("DEV2", 0, 6);
+  prv_add_chunk("DEV2", 1, 6);
+  prv_add_chunk("DEV3", 0, 6);
+
+  // every device gets a turn before DEV1 gets a second one
+  prv_check_next_batch("DEV1", 4, 6, 0);
+  prv_check_next_batch("DEV2", 2, 6, 0);
+  prv_check_next_batch("DEV3", 1, 6, 0);
+  // and the rest of DEV1's backlog goes out next, in order
+  prv_check_next_batch("DEV1", 2, 6, 4);
+  LONGS_EQUAL(0, memfault_gateway_get_num_queued_chunks(&s_gateway));
+}
+
+TEST(MfltHttpGateway, Test_DevicesTakeTurns) {
+  // A budget which only fits one chunk per batch: the devices take turns rather than the first
+  // device in the table hogging every batch
+  prv_init(BATCH_LEN(1, 10));
+  for (uint8_t i = 0; i < 3; i++) {
+    prv_add_chunk("DEV1", i, 10);
+    prv_add_chunk("DEV2", i, 10);
+  }
+
+  const char *expected_order[] = { "DEV1", "DEV2", "DEV1", "DEV2", "DEV1", "DEV2" };
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(expected_order); i++) {
+    prv_check_next_batch(expected_order[i], 1, 10, (uint8_t)(i / 2));
+  }
+  LONGS_EQUAL(0, memfault_gateway_get_num_queued_chunks(&s_gateway));
+}
+
+TEST(MfltHttpGateway, Test_BatchEndsAtFirstChunkWhichDoesNotFit) {
+  prv_init(BATCH_LEN(3, 10));
+  prv_add_chunk("DEV1", 1, 10);
+  prv_add_chunk("DEV1", 2, 30);
+  prv_add_chunk("DEV1", 3, 4);
+
+  // the third chunk would fit on its own but not after the first two, and the chunks of a
+  // device must go out in order
+  uint8_t body[BATCH_LEN(3, 10)];
+  sMfltGatewayBatch batch;
+  CHECK(memfault_gateway_batch_build(&s_gateway, body, sizeof(body), &batch));
+  LONGS_EQUAL(2, batch.num_chunks);
+  LONGS_EQUAL(BATCH_LEN(2, 20), batch.body_len);
+  const size_t chunk_lens[] = { 10, 30 };
+  uint8_t chunk_tags[2];
+  LONGS_EQUAL(2, prv_parse_body(body, batch.body_len, chunk_lens, chunk_tags, 2));
+  LONGS_EQUAL(1, chunk_tags[0]);
+  LONGS_EQUAL(2, chunk_tags[1]);
+  memfault_gateway_batch_complete(&s_gateway, true);
+
+  prv_check_next_batch("DEV1", 1, 4, 3);
+  LONGS_EQUAL(0, memfault_gateway_get_num_queued_chunks(&s_gateway));
+}
+
+TEST(MfltHttpGateway, Test_ChunkTooLarge) {
+  // a batch holding only a 20 byte chunk takes up the whole body
+  prv_init(BATCH_LEN(1, 20));
+  const uint8_t chunk[21] = { 0 };
+  LONGS_EQUAL(kMfltGatewayError_ChunkTooLarge,
+              memfault_gateway_add_chunk(&s_gateway, "DEV1", chunk, sizeof(chunk)));
+  prv_add_chunk("DEV1", 1, sizeof(chunk) - 1);
+
+  sMfltGatewayDeviceStats stats;
+  CHECK(memfault_gateway_get_device_stats(&s_gateway, "DEV1", &stats));
+  LONGS_EQUAL(1, stats.num_chunks_received);
+  LONGS_EQUAL(1, stats.num_chunks_rejected);
+
+  // the largest chunk accepted doesn't wedge the queue of the device
+  prv_check_next_batch("DEV1", 1, sizeof(chunk) - 1, 1);
+  LONGS_EQUAL(0, memfault_gateway_get_num_queued_chunks(&s_gateway));
+}
+
+//
+// Request headers
+//
+
+static char s_request[512];
+static size_t s_request_len;
+
+static bool prv_send_cb(const void *data, size_t data_len, MEMFAULT_UNUSED void *ctx) {
+  CHECK((s_request_len + data_len) < sizeof(s_request));
+  memcpy(&s_request[s_request_len], data, data_len);
+  s_request_len += data_len;
+  s_request[s_request_len] = '\0';
+  return true;
+}
+
+TEST(MfltHttpGateway, Test_DeviceBatchPost) {
+  s_request_len = 0;
+  CHECK(memfault_http_start_device_chunk_batch_post(prv_send_cb, NULL, "node-1", 123));
+  STRCMP_EQUAL("POST /api/v0/chunks/node-1 HTTP/1.1\r\n"
+               "Host:chunks.memfault.com\r\n"
+               "User-Agent:MemfaultSDK/0.0.11\r\n"
+               "Memfault-Project-Key:00112233445566778899aabbccddeeff\r\n"
+               "Content-Type:" MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE "\r\n"
+               "Content-Length:123\r\n"
+               "\r\n", s_request);
+
+  s_request_len = 0;
+  CHECK(memfault_http_start_compressed_device_chunk_batch_post(prv_send_cb, NULL, "node-2", 45));
+  STRCMP_EQUAL("POST /api/v0/chunks/node-2 HTTP/1.1\r\n"
+               "Host:chunks.memfault.com\r\n"
+               "User-Agent:MemfaultSDK/0.0.11\r\n"
+               "Memfault-Project-Key:00112233445566778899aabbccddeeff\r\n"
+               "Content-Type:" MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE "\r\n"
+               "Content-Encoding:deflate\r\n"
+               "Content-Length:45\r\n"
+               "\r\n", s_request);
+}
@@ -0,0 +1,335 @@
+//! @file
+//!
+//! Unit tests and a randomized robustness test for the keep-alive capable HTTP response parser.
+//! Its throughput compared with memfault_http_parse_response() is measured in
+//! test_memfault_benchmarks.cpp.
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+  #include "memfault/core/math.h"
+  #include "memfault/http/http_client.h"
+  #include "memfault/http/response_parser.h"
+  #include "memfault/http/utils.h"
+
+  sMfltHttpClientConfig g_mflt_http_client_config;
+}
+
+static const char *s_rsp_accepted =
+    "HTTP/1.1 202 Accepted\r\n"
+    "Content-Type: text/plain; charset=utf-8\r\n"
+    "Content-Length: 8\r\n"
+    "Date: Wed, 27 Nov 2019 22:52:57 GMT\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "Accepted";
+
+static const char *s_rsp_chunked =
+    "HTTP/1.1 200 OK\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n"
+    "5\r\n"
+    "Hello\r\n"
+    "1A;name=value\r\n"
+    "abcdefghijklmnopqrstuvwxyz\r\n"
+    "0\r\n"
+    "X-Trailer: ignored\r\n"
+    "\r\n";
+
+static const char *s_rsp_no_content =
+    "HTTP/1.1 204 No Content\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+typedef struct {
+  bool done;
+  size_t bytes_consumed;
+  sMfltHttpResponseParser parser;
+} sParseResult;
+
+static sParseResult prv_parse(const char *rsp, size_t rsp_len) {
+  sParseResult result = { };
+  memfault_http_response_parser_reset(&result.parser);
+  result.done = memfault_http_response_parser_feed(&result.parser, rsp, rsp_len,
+                                                   &result.bytes_consumed);
+  return result;
+}
+
+//! Feeds a response one byte at a time and checks the outcome matches parsing it in one go
+static void prv_check_byte_at_a_time(const char *rsp, size_t rsp_len, const sParseResult *expected) {
+  sMfltHttpResponseParser parser;
+  memfault_http_response_parser_reset(&parser);
+  size_t total_consumed = 0;
+  bool done = false;
+  for (size_t i = 0; (i < rsp_len) && !done; i++) {
+    size_t bytes_consumed;
+    done = memfault_http_response_parser_feed(&parser, &rsp[i], 1, &bytes_consumed);
+    LONGS_EQUAL(1, bytes_consumed);
+    total_consumed += bytes_consumed;
+  }
+  LONGS_EQUAL(expected->done, done);
+  LONGS_EQUAL(expected->bytes_consumed, total_consumed);
+  LONGS_EQUAL(expected->parser.parse_error, parser.parse_error);
+  LONGS_EQUAL(expected->parser.http_status_code, parser.http_status_code);
+  LONGS_EQUAL(expected->parser.keep_alive, parser.keep_alive);
+  LONGS_EQUAL(expected->parser.body_len, parser.body_len);
+}
+
+static sParseResult prv_expect_parse_success(const char *rsp, int expected_status) {
+  const size_t rsp_len = strlen(rsp);
+  const sParseResult result = prv_parse(rsp, rsp_len);
+  CHECK(result.done);
+  LONGS_EQUAL(kMfltHttpParseStatus_Ok, result.parser.parse_error);
+  LONGS_EQUAL(expected_status, result.parser.http_status_code);
+  LONGS_EQUAL(rsp_len, result.bytes_consumed);
+  prv_check_byte_at_a_time(rsp, rsp_len, &result);
+  return result;
+}
+
+static void prv_expect_parse_failure(const char *rsp, eMfltHttpParseStatus expected_error) {
+  const sParseResult result = prv_parse(rsp, strlen(rsp));
+  CHECK(result.done);
+  LONGS_EQUAL(expected_error, result.parser.parse_error);
+  prv_check_byte_at_a_time(rsp, strlen(rsp), &result);
+}
+
+TEST_GROUP(MfltHttpResponseParser) {
+  void setup() { }
+  void teardown() {
+    mock().checkExpectations();
+    mock().clear();
+  }
+};
+
+TEST(MfltHttpResponseParser, Test_ContentLength) {
+  sParseResult result = prv_expect_parse_success(s_rsp_accepted, 202);
+  CHECK(result.parser.keep_alive);
+  CHECK(!result.parser.chunked);
+  LONGS_EQUAL(8, result.parser.body_len);
+
+  // whitespace trailing the value isn't part of it
+  result = prv_expect_parse_success("HTTP/1.1 200 OK\r\nContent-Length: 2  \r\n\r\nok", 200);
+  LONGS_EQUAL(2, result.parser.body_len);
+}
+
+TEST(MfltHttpResponseParser, Test_Chunked) {
+  const sParseResult result = prv_expect_parse_success(s_rsp_chunked, 200);
+  CHECK(result.parser.keep_alive);
+  CHECK(result.parser.chunked);
+  LONGS_EQUAL(5 + 26, result.parser.body_len);
+}
+
+TEST(MfltHttpResponseParser, Test_NoBody) {
+  const sParseResult result = prv_expect_parse_success(s_rsp_no_content, 204);
+  CHECK(!result.parser.keep_alive);
+  LONGS_EQUAL(0, result.parser.body_len);
+
+  // a 304 never has a body, even if there is a Content-Length
+  prv_expect_parse_success("HTTP/1.1 304 Not Modified\r\nContent-Length: 10\r\n\r\n", 304);
+}
+
+TEST(MfltHttpResponseParser, Test_ConnectionHeader) {
+  // HTTP/1.0 closes the connection by default
+  sParseResult result = prv_expect_parse_success("HTTP/1.0 200 OK\r\n\r\n", 200);
+  CHECK(!result.parser.keep_alive);
+
+  result = prv_expect_parse_success("HTTP/1.0 200 OK\r\nconnection: Keep-Alive\r\n\r\n", 200);
+  CHECK(result.parser.keep_alive);
+
+  result = prv_expect_parse_success("HTTP/1.1 200 OK\r\nConnection: Upgrade, close\r\n\r\n", 200);
+  CHECK(!result.parser.keep_alive);
+
+  // bare LF line endings are tolerated
+  result = prv_expect_parse_success("HTTP/1.1 200 OK\nContent-Length: 2\n\nok", 200);
+  CHECK(result.parser.keep_alive);
+  LONGS_EQUAL(2, result.parser.body_len);
+}
+
+TEST(MfltHttpResponseParser, Test_RetryAfterHeader) {
+  sParseResult result = prv_expect_parse_success(
+      "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 120\r\n\r\n", 503);
+  LONGS_EQUAL(120, result.parser.retry_after_s);
+
+  // whitespace trailing the value isn't part of it
+  result = prv_expect_parse_success(
+      "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 30 \t\r\n\r\n", 503);
+  LONGS_EQUAL(30, result.parser.retry_after_s);
+
+  // the HTTP-date form is not supported
+  result = prv_expect_parse_success(
+      "HTTP/1.1 429 Too Many Requests\r\nretry-after: Fri, 31 Dec 1999 23:59:59 GMT\r\n\r\n",
+      429);
+  LONGS_EQUAL(0, result.parser.retry_after_s);
+}
+
+TEST(MfltHttpResponseParser, Test_LongLinesAndBodies) {
+  // header lines longer than the line buffer and bodies of any size are skipped
+  char rsp[4096];
+  char long_value[2 * MEMFAULT_HTTP_RESPONSE_PARSER_LINE_BUF_SIZE];
+  memset(long_value, 'x', sizeof(long_value));
+  long_value[sizeof(long_value) - 1] = '\0';
+  const size_t body_len = 1024 * 1024;
+  snprintf(rsp, sizeof(rsp),
+           "HTTP/1.1 429 A Very Long Reason Phrase Which Does Not Fit In The Line Buffer At All\r\n"
+           "X-Long: %s\r\n"
+           "Content-Length: %d\r\n"
+           "\r\n", long_value, (int)body_len);
+
+  sMfltHttpResponseParser parser;
+  memfault_http_response_parser_reset(&parser);
+  size_t bytes_consumed;
+  CHECK(!memfault_http_response_parser_feed(&parser, rsp, strlen(rsp), &bytes_consumed));
+  LONGS_EQUAL(strlen(rsp), bytes_consumed);
+  LONGS_EQUAL(429, parser.http_status_code);
+
+  char body[1000];
+  memset(body, 'b', sizeof(body));
+  size_t body_received = 0;
+  bool done = false;
+  while (!done) {
+    done = memfault_http_response_parser_feed(&parser, body, sizeof(body), &bytes_consumed);
+    body_received += bytes_consumed;
+  }
+  LONGS_EQUAL(kMfltHttpParseStatus_Ok, parser.parse_error);
+  LONGS_EQUAL(body_len, body_received);
+  LONGS_EQUAL(body_len, parser.body_len);
+}
+
+TEST(MfltHttpResponseParser, Test_PipelinedResponses) {
+  char rsp[1024];
+  const int rsp_len = snprintf(rsp, sizeof(rsp), "%s%s%s%s", s_rsp_accepted, s_rsp_chunked,
+                               s_rsp_accepted, s_rsp_no_content);
+  const int expected_status[] = { 202, 200, 202, 204 };
+  const size_t expected_body_len[] = { 8, 31, 8, 0 };
+
+  // leftover bytes are fed right back in, the parser resets itself between responses
+  sMfltHttpResponseParser parser;
+  memfault_http_response_parser_reset(&parser);
+  size_t offset = 0;
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(expected_status); i++) {
+    size_t bytes_consumed;
+    CHECK(memfault_http_response_parser_feed(&parser, &rsp[offset], (size_t)rsp_len - offset,
+                                             &bytes_consumed));
+    LONGS_EQUAL(kMfltHttpParseStatus_Ok, parser.parse_error);
+    LONGS_EQUAL(expected_status[i], parser.http_status_code);
+    LONGS_EQUAL(expected_body_len[i], parser.body_len);
+    offset += bytes_consumed;
+  }
+  LONGS_EQUAL(rsp_len, offset);
+  CHECK(!parser.keep_alive);
+
+  // the same stream split in awkward places
+  memfault_http_response_parser_reset(&parser);
+  size_t num_responses = 0;
+  const size_t split_len = 7;
+  for (offset = 0; offset < (size_t)rsp_len; ) {
+    const size_t len = MEMFAULT_MIN(split_len, (size_t)rsp_len - offset);
+    size_t segment_offset = 0;
+    while (segment_offset < len) {
+      size_t bytes_consumed;
+      const bool done = memfault_http_response_parser_feed(
+          &parser, &rsp[offset + segment_offset], len - segment_offset, &bytes_consumed);
+      segment_offset += bytes_consumed;
+      if (done) {
+        LONGS_EQUAL(expected_status[num_responses], parser.http_status_code);
+        num_responses++;
+      }
+    }
+    offset += len;
+  }
+  LONGS_EQUAL(MEMFAULT_ARRAY_SIZE(expected_status), num_responses);
+}
+
+TEST(MfltHttpResponseParser, Test_Errors) {
+  prv_expect_parse_failure("HTTP/2 200 OK\r\n\r\n", MfltHttpParseStatus_ParseStatusLineError);
+  prv_expect_parse_failure("HTTP/1.1 20 OK\r\n\r\n", MfltHttpParseStatus_ParseStatusLineError);
+  prv_expect_parse_failure("HTTP/1.1 2000 OK\r\n\r\n", MfltHttpParseStatus_ParseStatusLineError);
+  prv_expect_parse_failure("HTTP/1.1200 OK\r\n\r\n", MfltHttpParseStatus_ParseStatusLineError);
+  prv_expect_parse_failure("HTTP/1.1 200 OK\r\nNoColon\r\n\r\n",
+                           MfltHttpParseStatus_ParseHeaderError);
+  prv_expect_parse_failure("HTTP/1.1 200 OK\r\nContent-Length: abc\r\n\r\n",
+                           MfltHttpParseStatus_ParseHeaderError);
+  prv_expect_parse_failure("HTTP/1.1 200 OK\r\nContent-Length: 12abc\r\n\r\n",
+                           MfltHttpParseStatus_ParseHeaderError);
+  prv_expect_parse_failure("HTTP/1.1 200 OK\r\nContent-Length:\r\n\r\n",
+                           MfltHttpParseStatus_ParseHeaderError);
+  prv_expect_parse_failure("HTTP/1.1 200 OK\r\nContent-Length: 99999999999999999999999\r\n\r\n",
+                           MfltHttpParseStatus_ParseHeaderError);
+  prv_expect_parse_failure("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+                           MfltHttpParseStatus_ParseChunkedBodyError);
+  prv_expect_parse_failure("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nabc\r\n",
+                           MfltHttpParseStatus_ParseChunkedBodyError);
+}
+
+//
+// Randomized robustness test. Canned responses are mutated and split at random points. The
+// parser must always make progress, never consume more than it's given and reach the same
+// outcome no matter how the input is split. See tests/fuzz for a libFuzzer harness.
+//
+
+static uint32_t s_rand_state;
+
+static uint32_t prv_rand(void) {
+  // xorshift32, deterministic so failures are reproducible
+  s_rand_state ^= s_rand_state << 13;
+  s_rand_state ^= s_rand_state >> 17;
+  s_rand_state ^= s_rand_state << 5;
+  return s_rand_state;
+}
+
+TEST(MfltHttpResponseParser, Test_RandomizedInputs) {
+  const char *seeds[] = { s_rsp_accepted, s_rsp_chunked, s_rsp_no_content };
+  const char alphabet[] = "\r\n:;, 0123456789abcdefHTTP/1.";
+  s_rand_state = 0x12345678;
+
+  for (size_t iteration = 0; iteration < 5000; iteration++) {
+    char input[512];
+    const char *seed = seeds[prv_rand() % MEMFAULT_ARRAY_SIZE(seeds)];
+    size_t input_len = strlen(seed);
+    memcpy(input, seed, input_len);
+
+    const size_t num_mutations = prv_rand() % 4;
+    for (size_t m = 0; m < num_mutations; m++) {
+      const size_t idx = prv_rand() % input_len;
+      switch (prv_rand() % 3) {
+        case 0: // replace with a "structural" character
+          input[idx] = alphabet[prv_rand() % (sizeof(alphabet) - 1)];
+          break;
+        case 1: // replace with any byte
+          input[idx] = (char)prv_rand();
+          break;
+        default: // truncate
+          input_len = idx + 1;
+          break;
+      }
+    }
+
+    const sParseResult whole = prv_parse(input, input_len);
+    CHECK(whole.bytes_consumed <= input_len);
+    CHECK(whole.done || (whole.bytes_consumed == input_len));
+
+    // now split the input at random points
+    sMfltHttpResponseParser parser;
+    memfault_http_response_parser_reset(&parser);
+    size_t offset = 0;
+    bool done = false;
+    while ((offset < input_len) && !done) {
+      const size_t len = 1 + (prv_rand() % (input_len - offset));
+      size_t bytes_consumed;
+      done = memfault_http_response_parser_feed(&parser, &input[offset], len, &bytes_consumed);
+      CHECK(bytes_consumed <= len);
+      CHECK(done || (bytes_consumed == len));
+      offset += bytes_consumed;
+    }
+    LONGS_EQUAL(whole.done, done);
+    LONGS_EQUAL(whole.bytes_consumed, offset);
+    LONGS_EQUAL(whole.parser.parse_error, parser.parse_error);
+    LONGS_EQUAL(whole.parser.http_status_code, parser.http_status_code);
+  }
+}
@@ -0,0 +1,141 @@
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <string.h>
+
+extern "C" {
+  #include "memfault/core/math.h"
+  #include "memfault/http/retry_policy.h"
+
+  static uint64_t s_time_since_boot_ms;
+  static uint32_t s_random;
+
+  uint64_t memfault_platform_get_time_since_boot_ms(void) {
+    return s_time_since_boot_ms;
+  }
+
+  uint32_t memfault_platform_http_retry_get_random(void) {
+    return s_random;
+  }
+}
+
+static uint8_t s_retry_state_region[MEMFAULT_HTTP_RETRY_STATE_REGION_SIZE];
+
+TEST_GROUP(MfltHttpRetryPolicy) {
+  void setup() {
+    s_time_since_boot_ms = 1;
+    s_random = UINT32_MAX;
+    memset(s_retry_state_region, 0xA5, sizeof(s_retry_state_region));
+    memfault_http_retry_policy_boot(s_retry_state_region);
+  }
+  void teardown() {
+  }
+};
+
+TEST(MfltHttpRetryPolicy, Test_RetryableStatus) {
+  CHECK(memfault_http_retry_policy_is_retryable_status(0));
+  CHECK(memfault_http_retry_policy_is_retryable_status(408));
+  CHECK(memfault_http_retry_policy_is_retryable_status(429));
+  CHECK(memfault_http_retry_policy_is_retryable_status(500));
+  CHECK(memfault_http_retry_policy_is_retryable_status(503));
+  CHECK(!memfault_http_retry_policy_is_retryable_status(400));
+  CHECK(!memfault_http_retry_policy_is_retryable_status(401));
+  CHECK(!memfault_http_retry_policy_is_retryable_status(404));
+}
+
+TEST(MfltHttpRetryPolicy, Test_NonRetryableFailure) {
+  CHECK(!memfault_http_retry_policy_record_failure(400, 60));
+  CHECK(memfault_http_retry_policy_upload_allowed());
+  LONGS_EQUAL(0, memfault_http_retry_policy_get_attempt_count());
+}
+
+TEST(MfltHttpRetryPolicy, Test_ExponentialBackoffWithFullJitter) {
+  for (uint32_t attempt = 1; attempt < MEMFAULT_HTTP_RETRY_MAX_ATTEMPTS; attempt++) {
+    const uint64_t bound_ms = MEMFAULT_MIN((uint64_t)MEMFAULT_HTTP_RETRY_BASE_DELAY_MS
+                                               << (attempt - 1),
+                                           (uint64_t)MEMFAULT_HTTP_RETRY_MAX_DELAY_MS);
+    // the largest random value maps to the exponential bound
+    s_random = (uint32_t)bound_ms;
+    CHECK(memfault_http_retry_policy_record_failure(503, 0));
+    LONGS_EQUAL(attempt, memfault_http_retry_policy_get_attempt_count());
+    LONGS_EQUAL(bound_ms, memfault_http_retry_policy_get_delay_ms());
+    CHECK(!memfault_http_retry_policy_upload_allowed());
+
+    s_time_since_boot_ms += bound_ms - 1;
+    CHECK(!memfault_http_retry_policy_upload_allowed());
+    s_time_since_boot_ms += 1;
+    CHECK(memfault_http_retry_policy_upload_allowed());
+  }
+
+  // and anywhere between 0 and the bound otherwise
+  memfault_http_retry_policy_record_success();
+  s_random = 1234;
+  CHECK(memfault_http_retry_policy_record_failure(0, 0));
+  LONGS_EQUAL(1234 % (MEMFAULT_HTTP_RETRY_BASE_DELAY_MS + 1),
+              memfault_http_retry_policy_get_delay_ms());
+}
+
+TEST(MfltHttpRetryPolicy, Test_GiveUpAfterMaxAttempts) {
+  s_random = 0;
+  for (uint32_t attempt = 1; attempt < MEMFAULT_HTTP_RETRY_MAX_ATTEMPTS; attempt++) {
+    CHECK(memfault_http_retry_policy_record_failure(500, 0));
+    CHECK(memfault_http_retry_policy_upload_allowed());
+  }
+
+  CHECK(!memfault_http_retry_policy_record_failure(500, 0));
+  LONGS_EQUAL(0, memfault_http_retry_policy_get_attempt_count());
+  LONGS_EQUAL(MEMFAULT_HTTP_RETRY_MAX_DELAY_MS, memfault_http_retry_policy_get_delay_ms());
+}
+
+TEST(MfltHttpRetryPolicy, Test_RetryAfter) {
+  s_random = 0;
+  CHECK(memfault_http_retry_policy_record_failure(429, 120));
+  LONGS_EQUAL(120 * 1000, memfault_http_retry_policy_get_delay_ms());
+
+  // jitter which exceeds the Retry-After wins
+  s_random = MEMFAULT_HTTP_RETRY_BASE_DELAY_MS * 2;
+  CHECK(memfault_http_retry_policy_record_failure(503, 1));
+  LONGS_EQUAL(MEMFAULT_HTTP_RETRY_BASE_DELAY_MS * 2, memfault_http_retry_policy_get_delay_ms());
+
+  // an unreasonable Retry-After is clamped
+  s_random = 0;
+  CHECK(memfault_http_retry_policy_record_failure(503, UINT32_MAX));
+  LONGS_EQUAL(MEMFAULT_HTTP_RETRY_AFTER_MAX_S * 1000, memfault_http_retry_policy_get_delay_ms());
+}
+
+TEST(MfltHttpRetryPolicy, Test_SuccessClearsBackoff) {
+  CHECK(memfault_http_retry_policy_record_failure(503, 60));
+  CHECK(!memfault_http_retry_policy_upload_allowed());
+
+  memfault_http_retry_policy_record_success();
+  CHECK(memfault_http_retry_policy_upload_allowed());
+  LONGS_EQUAL(0, memfault_http_retry_policy_get_attempt_count());
+}
+
+TEST(MfltHttpRetryPolicy, Test_StatePersistsAcrossReboots) {
+  s_random = 0;
+  CHECK(memfault_http_retry_policy_record_failure(503, 60));
+  CHECK(memfault_http_retry_policy_record_failure(503, 60));
+  s_time_since_boot_ms += 20 * 1000;
+  LONGS_EQUAL(40 * 1000, memfault_http_retry_policy_get_delay_ms());
+
+  // the device reboots, the delay remaining is applied again from boot
+  s_time_since_boot_ms = 500;
+  memfault_http_retry_policy_boot(s_retry_state_region);
+  LONGS_EQUAL(2, memfault_http_retry_policy_get_attempt_count());
+  LONGS_EQUAL(40 * 1000, memfault_http_retry_policy_get_delay_ms());
+  CHECK(!memfault_http_retry_policy_upload_allowed());
+
+  // the attempt count keeps growing where it left off
+  CHECK(memfault_http_retry_policy_record_failure(0, 0));
+  LONGS_EQUAL(3, memfault_http_retry_policy_get_attempt_count());
+}
+
+TEST(MfltHttpRetryPolicy, Test_NoTimeSource) {
+  CHECK(memfault_http_retry_policy_record_failure(503, 60));
+  s_time_since_boot_ms = 0;
+  CHECK(memfault_http_retry_policy_upload_allowed());
+  LONGS_EQUAL(1, memfault_http_retry_policy_get_attempt_count());
+}
@@ -8,6 +8,7 @@ extern "C" {
   #include <stddef.h>
   #include <string.h>
 
+  #include "memfault/core/math.h"
   #include "memfault/core/platform/device_info.h"
   #include "memfault/http/http_client.h"
   #include "memfault/http/utils.h"
@@ -148,6 +149,34 @@ TEST(MfltHttpClientUtils, Test_MfltResponseParserNoContentLength) {
 }
 
 
+TEST(MfltHttpClientUtils, Test_MfltResponseParserPipelined) {
+  // Responses to pipelined requests arrive back-to-back on a keep-alive connection
+  const char *rsp =
+      "HTTP/1.1 202 Accepted\r\n"
+      "Content-Length: 8\r\n"
+      "\r\n"
+      "Accepted"
+      "HTTP/1.1 202 Accepted\r\n"
+      "\r\n"
+      "HTTP/1.1 429 Too Many Requests\r\n"
+      "Content-Length: 4\r\n"
+      "\r\n"
+      "Slow";
+  const int expected_status[] = { 202, 202, 429 };
+
+  const size_t rsp_len = strlen(rsp);
+  size_t offset = 0;
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(expected_status); i++) {
+    sMemfaultHttpResponseContext ctx = { };
+    const bool done = memfault_http_parse_response(&ctx, &rsp[offset], rsp_len - offset);
+    CHECK(done);
+    CHECK(!ctx.parse_error);
+    LONGS_EQUAL(expected_status[i], ctx.http_status_code);
+    offset += (size_t)ctx.data_bytes_processed;
+  }
+  LONGS_EQUAL(rsp_len, offset);
+}
+
 TEST(MfltHttpClientUtils, Test_MfltResponseParser411) {
   const char *good_response =
       "HTTP/1.1 411 Length Required\r\n"
@@ -0,0 +1,687 @@
+//! @file
+//!
+//! Exercises the ingestion stand-in server used by the HTTP port tests: decoding of chunks into
+//! messages and the HTTP front end serving several devices at once
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+extern "C" {
+  #include "memfault/core/compiler.h"
+  #include "memfault/http/chunk_batch.h"
+  #include "memfault/util/chunk_transport.h"
+  #include "memfault/util/varint.h"
+  #include "memfault_ingestion_decoder.h"
+  #include "memfault_ingestion_server.h"
+}
+
+//
+// Helpers to build messages the way the SDK does
+//
+
+#define MSG_TYPE_COREDUMP 0x01
+#define MSG_TYPE_EVENT 0x02
+#define MSG_RLE_MASK 0x80
+
+static uint8_t s_msg[4096];
+static size_t s_msg_len;
+
+static void prv_read_msg(uint32_t offset, void *buf, size_t buf_len) {
+  memcpy(buf, &s_msg[offset], buf_len);
+}
+
+//! A heartbeat event: { type: heartbeat, device_serial: <serial> }
+static void prv_build_event_msg(const char *serial) {
+  const size_t serial_len = strlen(serial);
+  CHECK(serial_len < 24);
+  s_msg_len = 0;
+  s_msg[s_msg_len++] = MSG_TYPE_EVENT;
+  s_msg[s_msg_len++] = 0xA2; // map with 2 pairs
+  s_msg[s_msg_len++] = 0x02; // type
+  s_msg[s_msg_len++] = 0x01; // heartbeat
+  s_msg[s_msg_len++] = 0x07; // device serial
+  s_msg[s_msg_len++] = (uint8_t)(0x60 | serial_len);
+  memcpy(&s_msg[s_msg_len], serial, serial_len);
+  s_msg_len += serial_len;
+}
+
+static void prv_put_le_u32(uint8_t *buf, uint32_t value) {
+  for (size_t i = 0; i < 4; i++) {
+    buf[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+//! Appends an RLE sequence to s_msg, see memfault/util/rle.h
+static void prv_put_rle_seq(const uint8_t *data, int32_t count) {
+  s_msg_len += memfault_encode_varint_si32(count, &s_msg[s_msg_len]);
+  const size_t len = (count > 0) ? 1 : (size_t)-count;
+  memcpy(&s_msg[s_msg_len], data, len);
+  s_msg_len += len;
+}
+
+//! A run length encoded coredump with a trace reason block and a 1kB memory region of zeros
+static void prv_build_rle_coredump_msg(void) {
+  uint8_t hdr_and_reason[12 + 12 + 4] = { 0 };
+  prv_put_le_u32(&hdr_and_reason[0], 0x45524f43);
+  prv_put_le_u32(&hdr_and_reason[4], 1);
+  prv_put_le_u32(&hdr_and_reason[8], sizeof(hdr_and_reason) + 12 + 1024);
+  hdr_and_reason[12] = 5; // trace reason
+  prv_put_le_u32(&hdr_and_reason[20], 4);
+  prv_put_le_u32(&hdr_and_reason[24], 0xab);
+
+  uint8_t region_hdr[12] = { 0 };
+  region_hdr[0] = 1; // memory region
+  prv_put_le_u32(&region_hdr[4], 0x20000000);
+  prv_put_le_u32(&region_hdr[8], 1024);
+
+  s_msg_len = 0;
+  s_msg[s_msg_len++] = MSG_TYPE_COREDUMP | MSG_RLE_MASK;
+  prv_put_rle_seq(hdr_and_reason, -(int32_t)sizeof(hdr_and_reason));
+  prv_put_rle_seq(region_hdr, -(int32_t)sizeof(region_hdr));
+  const uint8_t zero = 0;
+  prv_put_rle_seq(&zero, 1024);
+}
+
+//! A coredump with a trace reason block and a memory region filled with a counting pattern
+static void prv_build_coredump_msg(size_t region_len) {
+  s_msg_len = 0;
+  s_msg[s_msg_len++] = MSG_TYPE_COREDUMP;
+  prv_put_le_u32(&s_msg[s_msg_len], 0x45524f43);
+  prv_put_le_u32(&s_msg[s_msg_len + 4], 1);
+  prv_put_le_u32(&s_msg[s_msg_len + 8], (uint32_t)(12 + 12 + 4 + 12 + region_len));
+  s_msg_len += 12;
+
+  memset(&s_msg[s_msg_len], 0, 12 + 4 + 12);
+  s_msg[s_msg_len] = 5; // trace reason
+  prv_put_le_u32(&s_msg[s_msg_len + 8], 4);
+  prv_put_le_u32(&s_msg[s_msg_len + 12], 0xab);
+  s_msg_len += 12 + 4;
+  s_msg[s_msg_len] = 1; // memory region
+  prv_put_le_u32(&s_msg[s_msg_len + 4], 0x20000000);
+  prv_put_le_u32(&s_msg[s_msg_len + 8], (uint32_t)region_len);
+  s_msg_len += 12;
+
+  CHECK((s_msg_len + region_len) <= sizeof(s_msg));
+  for (size_t i = 0; i < region_len; i++) {
+    s_msg[s_msg_len++] = (uint8_t)(i * 7);
+  }
+}
+
+static uint8_t s_fec_parity_buf[256];
+
+//! Chunks s_msg with the chunk transport, like the packetizer does
+//!
+//! @param fec_group_size The number of data chunks each parity chunk covers, 0 for none
+//!
+//! @return the number of chunks written to 'chunks'
+static size_t prv_chunk_msg_with_fec(size_t mtu, uint8_t fec_group_size, uint8_t chunks[][256],
+                                     size_t chunk_lens[], size_t max_chunks) {
+  sMfltChunkTransportCtx ctx = { };
+  ctx.total_size = (uint32_t)s_msg_len;
+  ctx.read_msg = prv_read_msg;
+  ctx.fec_group_size = fec_group_size;
+  ctx.fec_parity_buf = s_fec_parity_buf;
+  ctx.fec_parity_buf_len = sizeof(s_fec_parity_buf);
+
+  size_t num_chunks = 0;
+  bool more_data;
+  do {
+    CHECK(num_chunks < max_chunks);
+    chunk_lens[num_chunks] = mtu;
+    more_data = memfault_chunk_transport_get_next_chunk(&ctx, chunks[num_chunks],
+                                                        &chunk_lens[num_chunks]);
+    num_chunks++;
+  } while (more_data);
+  return num_chunks;
+}
+
+static size_t prv_chunk_msg(size_t mtu, uint8_t chunks[][256], size_t chunk_lens[],
+                            size_t max_chunks) {
+  return prv_chunk_msg_with_fec(mtu, 0, chunks, chunk_lens, max_chunks);
+}
+
+static bool prv_is_parity_chunk(const uint8_t *chunk) {
+  return (chunk[0] & 0xA0) == 0xA0;
+}
+
+static size_t s_num_msgs_decoded;
+static sMfltIngestionMessage s_last_msg;
+
+static void prv_message_cb(MEMFAULT_UNUSED const char *device_serial,
+                           const sMfltIngestionMessage *msg, MEMFAULT_UNUSED void *ctx) {
+  s_num_msgs_decoded++;
+  s_last_msg = *msg;
+}
+
+static sMfltIngestionDecoder s_decoder;
+
+TEST_GROUP(MfltIngestionDecoder) {
+  void setup() {
+    s_num_msgs_decoded = 0;
+    memfault_ingestion_decoder_init(&s_decoder, "DAABBCCDD", prv_message_cb, NULL);
+  }
+  void teardown() {
+    memfault_ingestion_decoder_deinit(&s_decoder);
+  }
+};
+
+TEST(MfltIngestionDecoder, Test_SingleChunkEvent) {
+  prv_build_event_msg("DAABBCCDD");
+  uint8_t chunks[1][256];
+  size_t chunk_lens[1];
+  LONGS_EQUAL(1, prv_chunk_msg(sizeof(chunks[0]), chunks, chunk_lens, 1));
+
+  CHECK(memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[0], chunk_lens[0]));
+  LONGS_EQUAL(1, s_num_msgs_decoded);
+  LONGS_EQUAL(kMfltIngestionMsgType_Event, s_last_msg.type);
+  LONGS_EQUAL(kMfltIngestionEventType_Heartbeat, s_last_msg.event_type);
+  CHECK(!s_last_msg.rle);
+  LONGS_EQUAL(1, s_decoder.stats.num_messages);
+  LONGS_EQUAL(1, s_decoder.stats.num_heartbeats);
+  LONGS_EQUAL(chunk_lens[0], s_decoder.stats.chunk_bytes);
+}
+
+TEST(MfltIngestionDecoder, Test_MultiChunkReassembly) {
+  prv_build_rle_coredump_msg();
+  uint8_t chunks[32][256];
+  size_t chunk_lens[32];
+  const size_t num_chunks = prv_chunk_msg(MEMFAULT_MIN_CHUNK_BUF_LEN + 3, chunks, chunk_lens, 32);
+  CHECK(num_chunks >= 4);
+
+  for (size_t i = 0; i < num_chunks; i++) {
+    CHECK(memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[i], chunk_lens[i]));
+    LONGS_EQUAL((i == (num_chunks - 1)) ? 1 : 0, s_num_msgs_decoded);
+  }
+
+  LONGS_EQUAL(kMfltIngestionMsgType_Coredump, s_last_msg.type);
+  CHECK(s_last_msg.rle);
+  LONGS_EQUAL(12 + 12 + 4 + 12 + 1024, s_last_msg.data_len);
+  LONGS_EQUAL(2, s_last_msg.coredump_num_blocks);
+  LONGS_EQUAL(1024, s_last_msg.coredump_memory_bytes);
+  LONGS_EQUAL(0xab, s_last_msg.coredump_trace_reason);
+  LONGS_EQUAL(1, s_decoder.stats.num_coredumps);
+  LONGS_EQUAL(num_chunks, s_decoder.stats.num_chunks);
+}
+
+TEST(MfltIngestionDecoder, Test_CrcMismatch) {
+  prv_build_event_msg("DAABBCCDD");
+  uint8_t chunks[1][256];
+  size_t chunk_lens[1];
+  prv_chunk_msg(sizeof(chunks[0]), chunks, chunk_lens, 1);
+  chunks[0][3] ^= 0x1;
+
+  CHECK(!memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[0], chunk_lens[0]));
+  LONGS_EQUAL(0, s_num_msgs_decoded);
+  LONGS_EQUAL(1, s_decoder.stats.num_crc_errors);
+}
+
+TEST(MfltIngestionDecoder, Test_FramingErrors) {
+  prv_build_rle_coredump_msg();
+  uint8_t chunks[32][256];
+  size_t chunk_lens[32];
+  const size_t num_chunks = prv_chunk_msg(MEMFAULT_MIN_CHUNK_BUF_LEN + 3, chunks, chunk_lens, 32);
+
+  // a continuation with no message in progress
+  CHECK(!memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[1], chunk_lens[1]));
+  LONGS_EQUAL(1, s_decoder.stats.num_framing_errors);
+
+  // a chunk went missing
+  CHECK(memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[0], chunk_lens[0]));
+  CHECK(!memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[2], chunk_lens[2]));
+  LONGS_EQUAL(2, s_decoder.stats.num_framing_errors);
+
+  // the device starting over, i.e after an abort, drops the partial message
+  CHECK(memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[0], chunk_lens[0]));
+  for (size_t i = 0; i < num_chunks; i++) {
+    CHECK(memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[i], chunk_lens[i]));
+  }
+  LONGS_EQUAL(1, s_decoder.stats.num_dropped_messages);
+  LONGS_EQUAL(1, s_num_msgs_decoded);
+}
+
+TEST(MfltIngestionDecoder, Test_MalformedEvent) {
+  prv_build_event_msg("DAABBCCDD");
+  // claim a longer device serial than there is data for
+  s_msg[5] = 0x60 | 20;
+  uint8_t chunks[1][256];
+  size_t chunk_lens[1];
+  prv_chunk_msg(sizeof(chunks[0]), chunks, chunk_lens, 1);
+
+  CHECK(!memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[0], chunk_lens[0]));
+  LONGS_EQUAL(1, s_decoder.stats.num_decode_errors);
+  LONGS_EQUAL(0, s_num_msgs_decoded);
+}
+
+//! Feeds the chunks to the decoder, except for those whose bit is set in 'lost_mask'
+static void prv_feed_chunks(uint8_t chunks[][256], const size_t chunk_lens[], size_t num_chunks,
+                            uint32_t lost_mask) {
+  for (size_t i = 0; i < num_chunks; i++) {
+    if ((lost_mask & (1u << i)) == 0) {
+      memfault_ingestion_decoder_feed_chunk(&s_decoder, chunks[i], chunk_lens[i]);
+    }
+  }
+}
+
+static void prv_check_coredump_decoded(size_t region_len) {
+  LONGS_EQUAL(1, s_num_msgs_decoded);
+  LONGS_EQUAL(kMfltIngestionMsgType_Coredump, s_last_msg.type);
+  LONGS_EQUAL(s_msg_len - 1, s_last_msg.data_len);
+  MEMCMP_EQUAL(&s_msg[1], s_last_msg.data, s_last_msg.data_len);
+  LONGS_EQUAL(region_len, s_last_msg.coredump_memory_bytes);
+  LONGS_EQUAL(0xab, s_last_msg.coredump_trace_reason);
+}
+
+TEST(MfltIngestionDecoder, Test_FecNoLoss) {
+  prv_build_coredump_msg(200);
+  uint8_t chunks[16][256];
+  size_t chunk_lens[16];
+  // 32 bytes of data per chunk: 8 data chunks in 2 groups
+  const size_t num_chunks = prv_chunk_msg_with_fec(40, 4, chunks, chunk_lens, 16);
+  LONGS_EQUAL(10, num_chunks);
+  CHECK(prv_is_parity_chunk(chunks[4]));
+  CHECK(prv_is_parity_chunk(chunks[9]));
+
+  prv_feed_chunks(chunks, chunk_lens, num_chunks, 0);
+  prv_check_coredump_decoded(200);
+  LONGS_EQUAL(2, s_decoder.stats.num_parity_chunks);
+  LONGS_EQUAL(0, s_decoder.stats.num_recovered_chunks);
+  LONGS_EQUAL(0, s_decoder.stats.num_framing_errors);
+}
+
+TEST(MfltIngestionDecoder, Test_FecRecoversAnyLostChunk) {
+  prv_build_coredump_msg(200);
+  uint8_t chunks[16][256];
+  size_t chunk_lens[16];
+  const size_t num_chunks = prv_chunk_msg_with_fec(40, 4, chunks, chunk_lens, 16);
+
+  // includes the INIT chunk, the last data chunk which holds the CRC and the parity chunks
+  for (size_t lost = 0; lost < num_chunks; lost++) {
+    memfault_ingestion_decoder_deinit(&s_decoder);
+    memfault_ingestion_decoder_init(&s_decoder, "DAABBCCDD", prv_message_cb, NULL);
+    s_num_msgs_decoded = 0;
+
+    prv_feed_chunks(chunks, chunk_lens, num_chunks, 1u << lost);
+    prv_check_coredump_decoded(200);
+    LONGS_EQUAL(prv_is_parity_chunk(chunks[lost]) ? 0 : 1, s_decoder.stats.num_recovered_chunks);
+    LONGS_EQUAL(0, s_decoder.stats.num_framing_errors);
+  }
+}
+
+TEST(MfltIngestionDecoder, Test_FecOneLostChunkPerGroup) {
+  prv_build_coredump_msg(200);
+  uint8_t chunks[16][256];
+  size_t chunk_lens[16];
+  const size_t num_chunks = prv_chunk_msg_with_fec(40, 4, chunks, chunk_lens, 16);
+
+  prv_feed_chunks(chunks, chunk_lens, num_chunks, (1u << 1) | (1u << 8));
+  prv_check_coredump_decoded(200);
+  LONGS_EQUAL(2, s_decoder.stats.num_recovered_chunks);
+}
+
+TEST(MfltIngestionDecoder, Test_FecTwoLostChunksInGroup) {
+  prv_build_coredump_msg(200);
+  uint8_t chunks[16][256];
+  size_t chunk_lens[16];
+  const size_t num_chunks = prv_chunk_msg_with_fec(40, 4, chunks, chunk_lens, 16);
+
+  prv_feed_chunks(chunks, chunk_lens, num_chunks, (1u << 1) | (1u << 2));
+  LONGS_EQUAL(0, s_num_msgs_decoded);
+  LONGS_EQUAL(0, s_decoder.stats.num_recovered_chunks);
+  CHECK(s_decoder.stats.num_framing_errors >= 1);
+
+  // the next message is decoded as usual
+  prv_feed_chunks(chunks, chunk_lens, num_chunks, 0);
+  prv_check_coredump_decoded(200);
+}
+
+TEST(MfltIngestionDecoder, Test_FecSingleChunkMessage) {
+  prv_build_event_msg("DAABBCCDD");
+  uint8_t chunks[2][256];
+  size_t chunk_lens[2];
+  LONGS_EQUAL(2, prv_chunk_msg_with_fec(sizeof(chunks[0]), 4, chunks, chunk_lens, 2));
+
+  // the parity of a message sent in one chunk is a copy of it
+  prv_feed_chunks(chunks, chunk_lens, 2, 1u << 0);
+  LONGS_EQUAL(1, s_num_msgs_decoded);
+  LONGS_EQUAL(kMfltIngestionEventType_Heartbeat, s_last_msg.event_type);
+  LONGS_EQUAL(1, s_decoder.stats.num_recovered_chunks);
+
+  // and is ignored when the message arrived
+  prv_feed_chunks(chunks, chunk_lens, 2, 0);
+  LONGS_EQUAL(2, s_num_msgs_decoded);
+  LONGS_EQUAL(1, s_decoder.stats.num_recovered_chunks);
+  LONGS_EQUAL(0, s_decoder.stats.num_framing_errors);
+}
+
+//
+// Server
+//
+
+static sMfltIngestionServer *s_server;
+
+static int prv_connect(void) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(fd >= 0);
+  struct sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(memfault_ingestion_server_get_port(s_server));
+  LONGS_EQUAL(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  return fd;
+}
+
+//! Sends a request and reads the response
+//!
+//! @return the status of the response
+static int prv_post(int fd, const char *serial, const char *extra_headers, const void *body,
+                    size_t body_len, char *rsp, size_t rsp_size) {
+  char hdr[512];
+  const int hdr_len = snprintf(hdr, sizeof(hdr),
+                               "POST /api/v0/chunks/%s HTTP/1.1\r\n"
+                               "Host:127.0.0.1\r\n"
+                               "Memfault-Project-Key:00112233445566778899aabbccddeeff\r\n"
+                               "%s"
+                               "Content-Length:%d\r\n\r\n",
+                               serial, extra_headers, (int)body_len);
+  LONGS_EQUAL(hdr_len, send(fd, hdr, (size_t)hdr_len, 0));
+  if (body_len != 0) {
+    LONGS_EQUAL(body_len, send(fd, body, body_len, 0));
+  }
+
+  // all responses from the server are small enough to arrive in one piece
+  const ssize_t rsp_len = recv(fd, rsp, rsp_size - 1, 0);
+  CHECK(rsp_len > 0);
+  rsp[rsp_len] = '\0';
+  int status = 0;
+  LONGS_EQUAL(1, sscanf(rsp, "HTTP/1.1 %d", &status));
+  return status;
+}
+
+static int prv_post_event(int fd, const char *serial) {
+  prv_build_event_msg(serial);
+  uint8_t chunks[1][256];
+  size_t chunk_lens[1];
+  prv_chunk_msg(sizeof(chunks[0]), chunks, chunk_lens, 1);
+  char rsp[256];
+  return prv_post(fd, serial, "", chunks[0], chunk_lens[0], rsp, sizeof(rsp));
+}
+
+TEST_GROUP(MfltIngestionServer) {
+  void setup() {
+    sMfltIngestionServerConfig config = { };
+    config.project_key = "00112233445566778899aabbccddeeff";
+    s_server = memfault_ingestion_server_start(&config);
+    CHECK(s_server != NULL);
+  }
+  void teardown() {
+    memfault_ingestion_server_stop(s_server);
+  }
+};
+
+TEST(MfltIngestionServer, Test_SingleChunkPosts) {
+  const int fd = prv_connect();
+  for (int i = 0; i < 3; i++) {
+    LONGS_EQUAL(202, prv_post_event(fd, "device-a"));
+  }
+  close(fd);
+
+  sMfltIngestionDeviceStats stats;
+  CHECK(memfault_ingestion_server_get_device_stats(s_server, "device-a", &stats));
+  LONGS_EQUAL(3, stats.num_requests);
+  LONGS_EQUAL(0, stats.num_rejected_requests);
+  LONGS_EQUAL(3, stats.decoder.num_heartbeats);
+  CHECK(!memfault_ingestion_server_get_device_stats(s_server, "device-b", &stats));
+}
+
+//! Lays out chunks the way memfault_http_chunk_batch_build() does, see memfault/http/chunk_batch.h
+//!
+//! @return the length of the batch
+static size_t prv_build_batch(uint8_t *body, uint8_t chunks[][256], const size_t chunk_lens[],
+                              size_t num_chunks) {
+  const char *part_header = MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER;
+  size_t body_len = 0;
+  for (size_t i = 0; i < num_chunks; i++) {
+    memcpy(&body[body_len], part_header, strlen(part_header));
+    body_len += strlen(part_header);
+    memcpy(&body[body_len], chunks[i], chunk_lens[i]);
+    body_len += chunk_lens[i];
+    memcpy(&body[body_len], MEMFAULT_HTTP_CHUNK_BATCH_PART_END, 2);
+    body_len += 2;
+  }
+  memcpy(&body[body_len], MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER,
+         MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN);
+  return body_len + MEMFAULT_HTTP_CHUNK_BATCH_CLOSE_DELIMITER_LEN;
+}
+
+TEST(MfltIngestionServer, Test_CompressedBatch) {
+  // a batch of a coredump split in several chunks and an event, see chunk_batch.h
+  uint8_t body[4096];
+  uint8_t chunks[32][256];
+  size_t chunk_lens[32];
+
+  prv_build_rle_coredump_msg();
+  size_t num_chunks = prv_chunk_msg(24, chunks, chunk_lens, 32);
+  prv_build_event_msg("device-a");
+  num_chunks += prv_chunk_msg(sizeof(chunks[0]), &chunks[num_chunks], &chunk_lens[num_chunks],
+                              32 - num_chunks);
+  const size_t body_len = prv_build_batch(body, chunks, chunk_lens, num_chunks);
+
+  uint8_t compressed[4096];
+  uLongf compressed_len = sizeof(compressed);
+  LONGS_EQUAL(Z_OK, compress(compressed, &compressed_len, body, body_len));
+
+  const int fd = prv_connect();
+  char rsp[256];
+  LONGS_EQUAL(202, prv_post(fd, "device-a",
+                            "Content-Type:" MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE "\r\n"
+                            "Content-Encoding:deflate\r\n",
+                            compressed, compressed_len, rsp, sizeof(rsp)));
+  close(fd);
+
+  sMfltIngestionDeviceStats stats;
+  CHECK(memfault_ingestion_server_get_device_stats(s_server, "device-a", &stats));
+  LONGS_EQUAL(num_chunks, stats.decoder.num_chunks);
+  LONGS_EQUAL(1, stats.decoder.num_coredumps);
+  LONGS_EQUAL(1, stats.decoder.num_heartbeats);
+  LONGS_EQUAL(compressed_len, stats.body_bytes);
+}
+
+TEST(MfltIngestionServer, Test_DeviceBatchesOnOneConnection) {
+  // a gateway posts the batches of its devices one after another on the same connection, each to
+  // the chunks endpoint of its device (see memfault/http/gateway.h)
+  uint8_t body[4096];
+  uint8_t chunks[32][256];
+  size_t chunk_lens[32];
+  const char *batch_hdr = "Content-Type:" MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE "\r\n";
+  const int fd = prv_connect();
+  char rsp[256];
+
+  prv_build_rle_coredump_msg();
+  const size_t node1_num_chunks = prv_chunk_msg(24, chunks, chunk_lens, 32);
+  size_t body_len = prv_build_batch(body, chunks, chunk_lens, node1_num_chunks);
+  LONGS_EQUAL(202, prv_post(fd, "node-1", batch_hdr, body, body_len, rsp, sizeof(rsp)));
+
+  for (int i = 0; i < 2; i++) {
+    prv_build_event_msg("node-2");
+    const size_t num_chunks = prv_chunk_msg(sizeof(chunks[0]), chunks, chunk_lens, 32);
+    body_len = prv_build_batch(body, chunks, chunk_lens, num_chunks);
+    LONGS_EQUAL(202, prv_post(fd, "node-2", batch_hdr, body, body_len, rsp, sizeof(rsp)));
+  }
+
+  // there is no endpoint for the chunks of several devices
+  const char *no_serial = "POST /api/v0/chunks HTTP/1.1\r\nContent-Length:0\r\n\r\n";
+  LONGS_EQUAL(strlen(no_serial), send(fd, no_serial, strlen(no_serial), 0));
+  const ssize_t rsp_len = recv(fd, rsp, sizeof(rsp) - 1, 0);
+  CHECK(rsp_len > 0);
+  rsp[rsp_len] = '\0';
+  CHECK(strncmp(rsp, "HTTP/1.1 404", strlen("HTTP/1.1 404")) == 0);
+  close(fd);
+
+  sMfltIngestionDeviceStats stats;
+  CHECK(memfault_ingestion_server_get_device_stats(s_server, "node-1", &stats));
+  LONGS_EQUAL(node1_num_chunks, stats.decoder.num_chunks);
+  LONGS_EQUAL(1, stats.decoder.num_coredumps);
+  LONGS_EQUAL(0, stats.num_rejected_requests);
+
+  CHECK(memfault_ingestion_server_get_device_stats(s_server, "node-2", &stats));
+  LONGS_EQUAL(2, stats.decoder.num_heartbeats);
+  LONGS_EQUAL(2, stats.num_requests);
+  LONGS_EQUAL(0, stats.decoder.num_framing_errors);
+}
+
+TEST(MfltIngestionServer, Test_StreamedChunk) {
+  prv_build_event_msg("device-a");
+  uint8_t chunks[1][256];
+  size_t chunk_lens[1];
+  prv_chunk_msg(sizeof(chunks[0]), chunks, chunk_lens, 1);
+
+  // the chunk is streamed in two pieces with Transfer-Encoding: chunked
+  char req[512];
+  int req_len = snprintf(req, sizeof(req),
+                         "POST /api/v0/chunks/device-a HTTP/1.1\r\n"
+                         "Memfault-Project-Key:00112233445566778899aabbccddeeff\r\n"
+                         "Transfer-Encoding:chunked\r\n\r\n"
+                         "4\r\n");
+  memcpy(&req[req_len], chunks[0], 4);
+  req_len += 4;
+  req_len += snprintf(&req[req_len], sizeof(req) - (size_t)req_len, "\r\n%x\r\n",
+                      (unsigned int)(chunk_lens[0] - 4));
+  memcpy(&req[req_len], &chunks[0][4], chunk_lens[0] - 4);
+  req_len += (int)chunk_lens[0] - 4;
+  req_len += snprintf(&req[req_len], sizeof(req) - (size_t)req_len, "\r\n0\r\n\r\n");
+
+  const int fd = prv_connect();
+  LONGS_EQUAL(req_len, send(fd, req, (size_t)req_len, 0));
+  char rsp[256];
+  const ssize_t rsp_len = recv(fd, rsp, sizeof(rsp) - 1, 0);
+  CHECK(rsp_len > 0);
+  rsp[rsp_len] = '\0';
+  CHECK(strncmp(rsp, "HTTP/1.1 202", strlen("HTTP/1.1 202")) == 0);
+  close(fd);
+
+  sMfltIngestionDeviceStats stats;
+  CHECK(memfault_ingestion_server_get_device_stats(s_server, "device-a", &stats));
+  LONGS_EQUAL(1, stats.decoder.num_heartbeats);
+}
+
+TEST(MfltIngestionServer, Test_RejectedRequests) {
+  const int fd = prv_connect();
+  char rsp[256];
+
+  const uint8_t garbage[] = { 0x08, 0x01, 0x02 };
+  LONGS_EQUAL(400, prv_post(fd, "device-a", "", garbage, sizeof(garbage), rsp, sizeof(rsp)));
+
+  // a batch which is not closed by its close delimiter
+  const char *unterminated = MEMFAULT_HTTP_CHUNK_BATCH_PART_HEADER "\x08\x01\x02";
+  LONGS_EQUAL(400, prv_post(fd, "device-a",
+                            "Content-Type:" MEMFAULT_HTTP_CHUNK_BATCH_CONTENT_TYPE "\r\n",
+                            unterminated, strlen(unterminated), rsp, sizeof(rsp)));
+
+  const char *wrong_path = "POST /api/v0/events HTTP/1.1\r\nContent-Length:0\r\n\r\n";
+  LONGS_EQUAL(strlen(wrong_path), send(fd, wrong_path, strlen(wrong_path), 0));
+  const ssize_t rsp_len = recv(fd, rsp, sizeof(rsp) - 1, 0);
+  CHECK(rsp_len > 0);
+  rsp[rsp_len] = '\0';
+  CHECK(strncmp(rsp, "HTTP/1.1 404", strlen("HTTP/1.1 404")) == 0);
+
+  // the body of requests is discarded while the server is told to reject them
+  memfault_ingestion_server_set_response(s_server, 429, 30);
+  LONGS_EQUAL(429, prv_post(fd, "device-a", "", garbage, sizeof(garbage), rsp, sizeof(rsp)));
+  CHECK(strstr(rsp, "Retry-After: 30\r\n") != NULL);
+  LONGS_EQUAL(429, prv_post_event(fd, "device-a"));
+
+  memfault_ingestion_server_set_response(s_server, 0, 0);
+  LONGS_EQUAL(202, prv_post_event(fd, "device-a"));
+  close(fd);
+
+  sMfltIngestionDeviceStats stats;
+  CHECK(memfault_ingestion_server_get_device_stats(s_server, "device-a", &stats));
+  LONGS_EQUAL(5, stats.num_requests);
+  LONGS_EQUAL(4, stats.num_rejected_requests);
+  LONGS_EQUAL(1, stats.decoder.num_heartbeats);
+  LONGS_EQUAL(1, stats.decoder.num_crc_errors);
+}
+
+TEST(MfltIngestionServer, Test_WrongProjectKey) {
+  const int fd = prv_connect();
+  const char *req = "POST /api/v0/chunks/device-a HTTP/1.1\r\n"
+                    "Memfault-Project-Key:ffffffffffffffffffffffffffffffff\r\n"
+                    "Content-Length:0\r\n\r\n";
+  LONGS_EQUAL(strlen(req), send(fd, req, strlen(req), 0));
+  char rsp[256];
+  const ssize_t rsp_len = recv(fd, rsp, sizeof(rsp) - 1, 0);
+  CHECK(rsp_len > 0);
+  rsp[rsp_len] = '\0';
+  CHECK(strncmp(rsp, "HTTP/1.1 401", strlen("HTTP/1.1 401")) == 0);
+  close(fd);
+
+  size_t num_devices;
+  sMfltIngestionDeviceStats stats;
+  memfault_ingestion_server_get_total_stats(s_server, &stats, &num_devices);
+  LONGS_EQUAL(0, num_devices);
+}
+
+#define NUM_DEVICES 8
+#define NUM_POSTS_PER_DEVICE 25
+
+static void *prv_device_thread(void *arg) {
+  const int device_id = (int)(intptr_t)arg;
+  char serial[16];
+  snprintf(serial, sizeof(serial), "device-%d", device_id);
+
+  // half the devices use a connection per request
+  int fd = prv_connect();
+  int num_accepted = 0;
+  for (int i = 0; i < NUM_POSTS_PER_DEVICE; i++) {
+    num_accepted += (prv_post_event(fd, serial) == 202) ? 1 : 0;
+    if ((device_id % 2) == 0) {
+      close(fd);
+      fd = prv_connect();
+    }
+  }
+  close(fd);
+  return (void *)(intptr_t)num_accepted;
+}
+
+TEST(MfltIngestionServer, Test_ConcurrentDevices) {
+  // more devices than workers, connections queue up until a worker frees up
+  pthread_t threads[NUM_DEVICES];
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    LONGS_EQUAL(0, pthread_create(&threads[i], NULL, prv_device_thread, (void *)(intptr_t)i));
+  }
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    void *num_accepted;
+    pthread_join(threads[i], &num_accepted);
+    LONGS_EQUAL(NUM_POSTS_PER_DEVICE, (intptr_t)num_accepted);
+  }
+
+  size_t num_devices;
+  sMfltIngestionDeviceStats total;
+  memfault_ingestion_server_get_total_stats(s_server, &total, &num_devices);
+  LONGS_EQUAL(NUM_DEVICES, num_devices);
+  LONGS_EQUAL(NUM_DEVICES * NUM_POSTS_PER_DEVICE, total.num_requests);
+  LONGS_EQUAL(NUM_DEVICES * NUM_POSTS_PER_DEVICE, total.decoder.num_heartbeats);
+  LONGS_EQUAL(0, total.num_rejected_requests);
+
+  sMfltIngestionDeviceStats stats;
+  CHECK(memfault_ingestion_server_get_device_stats(s_server, "device-3", &stats));
+  LONGS_EQUAL(NUM_POSTS_PER_DEVICE, stats.decoder.num_messages);
+
+  char report[4096];
+  FILE *out = fmemopen(report, sizeof(report), "w");
+  memfault_ingestion_server_print_report(s_server, out);
+  fclose(out);
+  CHECK(strstr(report, "device-3 ") != NULL);
+  CHECK(strstr(report, "total (8 devices)") != NULL);
+}
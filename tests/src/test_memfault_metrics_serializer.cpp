@@ -14,6 +14,7 @@
 
 #include "fakes/fake_memfault_event_storage.h"
 #include "memfault/core/event_storage.h"
+#include "memfault/core/serializer_key_ids.h"
 #include "memfault/metrics/serializer.h"
 #include "memfault/metrics/utils.h"
 
@@ -55,6 +56,11 @@ void memfault_metrics_heartbeat_iterate(MemfaultMetricIteratorCallback cb, void
   cb(ctx, &info);
 }
 
+void memfault_metrics_ctx_heartbeat_iterate(sMfltMetricsCtx *metrics_ctx,
+                                            MemfaultMetricIteratorCallback cb, void *ctx) {
+  memfault_metrics_heartbeat_iterate(cb, ctx);
+}
+
 size_t memfault_metrics_heartbeat_get_num_metrics(void) {
   // if this fails, it means we need to add add a report for the new type
   // to the fake "memfault_metrics_heartbeat_iterate"
@@ -90,6 +96,50 @@ TEST(MemfaultMetricsSerializer, Test_MemfaultMetricSerialize) {
   fake_event_storage_assert_contents_match(expected_serialization, sizeof(expected_serialization));
 }
 
+//! The expected serializations hard-code the key ids. Including the header from C++ also checks
+//! that its extern "C" block is closed.
+TEST(MemfaultMetricsSerializer, Test_KeyIds) {
+  LONGS_EQUAL(0x02, kMemfaultEventKey_Type);
+  LONGS_EQUAL(0x01, kMemfaultEventType_Heartbeat);
+  LONGS_EQUAL(0x03, kMemfaultEventKey_CborSchemaVersion);
+  LONGS_EQUAL(0x01, MEMFAULT_CBOR_SCHEMA_VERSION_V1);
+  LONGS_EQUAL(0x07, kMemfaultEventKey_DeviceSerial);
+  LONGS_EQUAL(0x0a, kMemfaultEventKey_SoftwareType);
+  LONGS_EQUAL(0x09, kMemfaultEventKey_SoftwareVersion);
+  LONGS_EQUAL(0x06, kMemfaultEventKey_HardwareVersion);
+  LONGS_EQUAL(0x04, kMemfaultEventKey_EventInfo);
+  LONGS_EQUAL(0x01, kMemfaultHeartbeatInfoKey_Metrics);
+}
+
+TEST(MemfaultMetricsSerializer, Test_MemfaultMetricCtxSerialize) {
+  // an instance should report its own device identity rather than the platform one
+  const sMemfaultDeviceInfo device_info = {
+    .device_serial = "NODE00042",
+    .software_type = "main",
+    .software_version = "1.2.3",
+    .hardware_version = "evt_24",
+  };
+  sMfltMetricsCtx metrics_ctx = { };
+  metrics_ctx.storage_impl = s_fake_event_storage_impl;
+  metrics_ctx.device_info = &device_info;
+
+  mock().expectOneCall("prv_begin_write");
+  mock().expectOneCall("prv_finish_write").withParameter("rollback", false);
+
+  CHECK(memfault_metrics_ctx_heartbeat_serialize(&metrics_ctx));
+
+  const uint8_t expected_serialization[] = {
+      0xa7, 0x02, 0x01, 0x03, 0x01, 0x07, 0x69, 0x4e, 0x4f, 0x44,
+      0x45, 0x30, 0x30, 0x30, 0x34, 0x32, 0x0a, 0x64, 0x6d, 0x61,
+      0x69, 0x6e, 0x09, 0x65, 0x31, 0x2e, 0x32, 0x2e, 0x33, 0x06,
+      0x66, 0x65, 0x76, 0x74, 0x5f, 0x32, 0x34, 0x04, 0xa1, 0x01,
+      0x83, 0x19, 0x03, 0xe8, 0x39, 0x03, 0xe7, 0x19, 0x04, 0xd2,
+  };
+
+  fake_event_storage_assert_contents_match(expected_serialization, sizeof(expected_serialization));
+  LONGS_EQUAL(56, memfault_metrics_ctx_heartbeat_compute_worst_case_storage_size(&metrics_ctx));
+}
+
 TEST(MemfaultMetricsSerializer, Test_MemfaultMetricSerializeWorstCaseSize) {
   const size_t worst_case_storage = memfault_metrics_heartbeat_compute_worst_case_storage_size();
   LONGS_EQUAL(56, worst_case_storage);
@@ -0,0 +1,243 @@
+//! @file
+//!
+//! Runs MQTT publish uploads against the stand-in broker over TCP, including over a connection
+//! which drops. Their throughput compared with HTTPS is measured in test_memfault_benchmarks.cpp.
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+  #include "fakes/fake_memfault_event_data_source.h"
+  #include "memfault/core/compiler.h"
+  #include "memfault/core/data_packetizer.h"
+  #include "memfault/core/math.h"
+  #include "memfault/mqtt/publish_upload.h"
+  #include "memfault_mqtt_ingestion_server.h"
+}
+
+#define DEVICE_SERIAL "DAABBCCDD"
+
+static const size_t s_msg_sizes[] = { 256, 300, 1000, 1500, 420, 2000, 260, 777 };
+#define NUM_MSGS MEMFAULT_ARRAY_SIZE(s_msg_sizes)
+
+//! Queues the messages of s_msg_sizes in the fake event data source
+static void prv_queue_msgs(void) {
+  fake_event_data_source_reset();
+  for (size_t i = 0; i < NUM_MSGS; i++) {
+    fake_event_data_source_queue_msg(s_msg_sizes[i]);
+  }
+}
+
+static int prv_tcp_connect(uint16_t port) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(fd >= 0);
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  LONGS_EQUAL(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  return fd;
+}
+
+static void prv_send_all(int fd, const void *data, size_t data_len) {
+  LONGS_EQUAL((ssize_t)data_len, send(fd, data, data_len, MSG_NOSIGNAL));
+}
+
+static void prv_recv_all(int fd, void *buf, size_t len) {
+  uint8_t *bytes = (uint8_t *)buf;
+  while (len > 0) {
+    const ssize_t rv = recv(fd, bytes, len, 0);
+    CHECK(rv > 0);
+    bytes += rv;
+    len -= (size_t)rv;
+  }
+}
+
+//
+// An MQTT client connected to the stand-in broker. The test owns the connection, as an
+// application would.
+//
+
+typedef struct {
+  int fd;
+  uint8_t rx_buf[256];
+  size_t rx_len;
+} sMqttClient;
+
+static void prv_mqtt_connect(sMqttClient *client, uint16_t port) {
+  client->fd = prv_tcp_connect(port);
+  client->rx_len = 0;
+
+  // CONNECT with a clean session, a 60s keep alive and the device serial as client identifier
+  const uint8_t connect_pkt[] = {
+    0x10, 10 + 2 + sizeof(DEVICE_SERIAL) - 1,
+    0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 60,
+    0, sizeof(DEVICE_SERIAL) - 1, 'D', 'A', 'A', 'B', 'B', 'C', 'C', 'D', 'D',
+  };
+  prv_send_all(client->fd, connect_pkt, sizeof(connect_pkt));
+  uint8_t connack[4];
+  prv_recv_all(client->fd, connack, sizeof(connack));
+  const uint8_t expected_connack[] = { 0x20, 2, 0, 0 };
+  MEMCMP_EQUAL(expected_connack, connack, sizeof(connack));
+}
+
+static void prv_mqtt_close(sMqttClient *client) {
+  if (client->fd >= 0) {
+    const uint8_t disconnect_pkt[] = { 0xe0, 0 };
+    send(client->fd, disconnect_pkt, sizeof(disconnect_pkt), MSG_NOSIGNAL);
+    close(client->fd);
+    client->fd = -1;
+  }
+}
+
+static int prv_mqtt_send(void *ctx, const void *packet, size_t packet_len) {
+  sMqttClient *client = (sMqttClient *)ctx;
+  const ssize_t rv = send(client->fd, packet, packet_len, MSG_NOSIGNAL);
+  return (rv == (ssize_t)packet_len) ? 0 : -1;
+}
+
+static const sMfltMqttUploadTransport s_mqtt_transport = {
+  .send = prv_mqtt_send,
+};
+
+static size_t s_num_complete;
+static eMfltMqttUploadResult s_result;
+
+static void prv_complete_cb(MEMFAULT_UNUSED sMfltMqttUpload *upload, eMfltMqttUploadResult result,
+                            MEMFAULT_UNUSED void *ctx) {
+  s_num_complete++;
+  s_result = result;
+}
+
+//! Runs the upload the way the receive loop of an MQTT client would, until it completes
+static eMfltMqttUploadResult prv_mqtt_upload(sMqttClient *client, sMfltMqttUpload *upload) {
+  const sMfltMqttUploadConfig cfg = {
+    .topic_prefix = NULL,
+    .window_size = 0,
+    .transport = &s_mqtt_transport,
+    .transport_ctx = client,
+    .complete_cb = prv_complete_cb,
+    .complete_ctx = NULL,
+  };
+  s_num_complete = 0;
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started, memfault_mqtt_upload_start(upload, &cfg));
+
+  while (memfault_mqtt_upload_in_progress(upload)) {
+    struct pollfd pfd = { .fd = client->fd, .events = POLLIN, .revents = 0 };
+    CHECK(poll(&pfd, 1, 5000) == 1);
+    const ssize_t len = recv(client->fd, &client->rx_buf[client->rx_len],
+                             sizeof(client->rx_buf) - client->rx_len, 0);
+    if (len <= 0) {
+      memfault_mqtt_upload_on_disconnect(upload);
+      close(client->fd);
+      client->fd = -1;
+      break;
+    }
+    client->rx_len += (size_t)len;
+
+    // the broker only sends PUBACKs to a publisher
+    size_t offset = 0;
+    while ((client->rx_len - offset) >= 4) {
+      const uint8_t *puback = &client->rx_buf[offset];
+      LONGS_EQUAL(0x40, puback[0]);
+      LONGS_EQUAL(2, puback[1]);
+      CHECK(memfault_mqtt_upload_on_puback(upload, (uint16_t)((puback[2] << 8) | puback[3])));
+      offset += 4;
+    }
+    memmove(client->rx_buf, &client->rx_buf[offset], client->rx_len - offset);
+    client->rx_len -= offset;
+  }
+  LONGS_EQUAL(1, s_num_complete);
+  return s_result;
+}
+
+TEST_GROUP(MfltMqttIngestionServer) {
+  sMfltMqttUpload upload;
+  sMqttClient client;
+  sMfltMqttIngestionServer *server;
+
+  void setup() {
+    memset(&upload, 0, sizeof(upload));
+    client.fd = -1;
+    memfault_packetizer_abort();
+    prv_queue_msgs();
+    server = NULL;
+  }
+
+  void teardown() {
+    prv_mqtt_close(&client);
+    stop_server();
+    mock().checkExpectations();
+    mock().clear();
+  }
+
+  void start_server(uint32_t puback_delay_ms) {
+    sMfltMqttIngestionServerConfig config;
+    memset(&config, 0, sizeof(config));
+    config.puback_delay_ms = puback_delay_ms;
+    server = memfault_mqtt_ingestion_server_start(&config);
+    CHECK(server != NULL);
+  }
+
+  void stop_server() {
+    if (server != NULL) {
+      memfault_mqtt_ingestion_server_stop(server);
+      server = NULL;
+    }
+  }
+
+  void check_all_msgs_received(sMfltMqttIngestionDeviceStats *stats) {
+    CHECK(memfault_mqtt_ingestion_server_get_device_stats(server, DEVICE_SERIAL, stats));
+    LONGS_EQUAL(NUM_MSGS, stats->decoder.num_messages);
+    LONGS_EQUAL(NUM_MSGS, stats->decoder.num_other_events);
+    LONGS_EQUAL(0, stats->decoder.num_framing_errors);
+    LONGS_EQUAL(0, stats->decoder.num_crc_errors);
+    LONGS_EQUAL(0, stats->decoder.num_decode_errors);
+    LONGS_EQUAL(NUM_MSGS, fake_event_data_source_get_num_msgs_read());
+  }
+};
+
+TEST(MfltMqttIngestionServer, Test_Upload) {
+  start_server(0);
+  prv_mqtt_connect(&client, memfault_mqtt_ingestion_server_get_port(server));
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, prv_mqtt_upload(&client, &upload));
+
+  sMfltMqttIngestionDeviceStats stats;
+  check_all_msgs_received(&stats);
+  LONGS_EQUAL(0, stats.decoder.num_dropped_messages);
+  LONGS_EQUAL(NUM_MSGS, upload.stats.num_messages);
+  LONGS_EQUAL(upload.stats.num_publishes, stats.num_publishes);
+  LONGS_EQUAL(upload.stats.num_publishes, upload.stats.num_pubacks);
+  LONGS_EQUAL(upload.stats.tx_bytes, stats.rx_bytes);
+  LONGS_EQUAL(1, memfault_mqtt_ingestion_server_get_num_connections(server));
+}
+
+TEST(MfltMqttIngestionServer, Test_ConnectionDrops) {
+  start_server(0);
+  prv_mqtt_connect(&client, memfault_mqtt_ingestion_server_get_port(server));
+  memfault_mqtt_ingestion_server_disconnect_after(server, 12);
+  LONGS_EQUAL(kMfltMqttUploadResult_Disconnected, prv_mqtt_upload(&client, &upload));
+  CHECK(fake_event_data_source_get_num_msgs_read() < NUM_MSGS);
+
+  // the message which was cut off is sent again in its entirety once reconnected
+  prv_mqtt_connect(&client, memfault_mqtt_ingestion_server_get_port(server));
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, prv_mqtt_upload(&client, &upload));
+
+  sMfltMqttIngestionDeviceStats stats;
+  check_all_msgs_received(&stats);
+  CHECK(stats.decoder.num_dropped_messages <= 1);
+  LONGS_EQUAL(2, memfault_mqtt_ingestion_server_get_num_connections(server));
+}
@@ -0,0 +1,435 @@
+//! @file
+//!
+//! Drives the MQTT publish upload with a fake transport to check the PUBLISH packets it builds,
+//! how it keeps the window full and when messages get deleted. See
+//! test_memfault_mqtt_ingestion_server.cpp for uploads to the stand-in broker.
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <string.h>
+
+extern "C" {
+  #include "fakes/fake_memfault_event_data_source.h"
+  #include "memfault/core/compiler.h"
+  #include "memfault/core/data_packetizer.h"
+  #include "memfault/core/errors.h"
+  #include "memfault/core/math.h"
+  #include "memfault/mqtt/publish_upload.h"
+  #include "memfault_ingestion_decoder.h"
+}
+
+#define DEVICE_SERIAL "DAABBCCDD"
+#define TOPIC "memfault/" DEVICE_SERIAL "/chunks"
+
+//
+// A fake transport which records the packets sent
+//
+
+#define MAX_PACKETS 128
+
+typedef struct {
+  uint8_t data[MEMFAULT_MQTT_UPLOAD_TX_BUF_SIZE];
+  size_t len;
+  //! Where the packet was sent from, to check chunks aren't copied
+  const void *src;
+} sPacket;
+
+static sPacket s_sent[MAX_PACKETS];
+static bool s_acked[MAX_PACKETS];
+static size_t s_num_sent;
+static int s_send_rv;
+
+static int prv_send(MEMFAULT_UNUSED void *ctx, const void *packet, size_t packet_len) {
+  if (s_send_rv != 0) {
+    return s_send_rv;
+  }
+  CHECK(s_num_sent < MAX_PACKETS);
+  CHECK(packet_len <= sizeof(s_sent[0].data));
+  memcpy(s_sent[s_num_sent].data, packet, packet_len);
+  s_sent[s_num_sent].len = packet_len;
+  s_sent[s_num_sent].src = packet;
+  s_acked[s_num_sent] = false;
+  s_num_sent++;
+  return 0;
+}
+
+static const sMfltMqttUploadTransport s_transport = {
+  .send = prv_send,
+};
+
+static size_t s_num_complete;
+static eMfltMqttUploadResult s_result;
+
+static void prv_complete_cb(MEMFAULT_UNUSED sMfltMqttUpload *upload, eMfltMqttUploadResult result,
+                            MEMFAULT_UNUSED void *ctx) {
+  s_num_complete++;
+  s_result = result;
+}
+
+static const sMfltMqttUploadConfig s_upload_config = {
+  .topic_prefix = NULL,
+  .window_size = 0,
+  .transport = &s_transport,
+  .transport_ctx = NULL,
+  .complete_cb = prv_complete_cb,
+  .complete_ctx = NULL,
+};
+
+//
+// Minimal MQTT helpers, written independently of the implementation under test
+//
+
+typedef struct {
+  uint8_t type_and_flags;
+  size_t remaining_len;
+  char topic[MEMFAULT_MQTT_MAX_TOPIC_LEN + 1];
+  uint16_t packet_id;
+  const uint8_t *payload;
+  size_t payload_len;
+} sPublish;
+
+static void prv_parse_publish(const sPacket *packet, sPublish *publish) {
+  const uint8_t *data = packet->data;
+  size_t offset = 0;
+  publish->type_and_flags = data[offset++];
+  size_t remaining_len = 0;
+  unsigned int shift = 0;
+  uint8_t byte;
+  do {
+    byte = data[offset++];
+    remaining_len |= (size_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while ((byte & 0x80) != 0);
+  publish->remaining_len = remaining_len;
+  LONGS_EQUAL(packet->len, offset + remaining_len);
+
+  const size_t topic_len = ((size_t)data[offset] << 8) | data[offset + 1];
+  offset += 2;
+  CHECK(topic_len <= MEMFAULT_MQTT_MAX_TOPIC_LEN);
+  memcpy(publish->topic, &data[offset], topic_len);
+  publish->topic[topic_len] = '\0';
+  offset += topic_len;
+  publish->packet_id = (uint16_t)((data[offset] << 8) | data[offset + 1]);
+  offset += 2;
+  publish->payload = &data[offset];
+  publish->payload_len = packet->len - offset;
+}
+
+static uint16_t prv_packet_id(size_t packet_idx) {
+  sPublish publish;
+  prv_parse_publish(&s_sent[packet_idx], &publish);
+  return publish.packet_id;
+}
+
+static bool prv_puback(sMfltMqttUpload *upload, size_t packet_idx) {
+  CHECK(packet_idx < s_num_sent);
+  s_acked[packet_idx] = true;
+  return memfault_mqtt_upload_on_puback(upload, prv_packet_id(packet_idx));
+}
+
+//! Acknowledges the packets sent which haven't been yet, oldest first, until the upload completes
+static void prv_ack_all(sMfltMqttUpload *upload) {
+  for (size_t i = 0; (i < s_num_sent) && memfault_mqtt_upload_in_progress(upload); i++) {
+    if (!s_acked[i]) {
+      CHECK(prv_puback(upload, i));
+    }
+  }
+  CHECK_FALSE(memfault_mqtt_upload_in_progress(upload));
+}
+
+TEST_GROUP(MfltMqttPublishUpload) {
+  sMfltMqttUpload upload;
+
+  void setup() {
+    memset(&upload, 0, sizeof(upload));
+    fake_event_data_source_reset();
+    s_num_sent = 0;
+    s_send_rv = 0;
+    s_num_complete = 0;
+    s_result = kMfltMqttUploadResult_Success;
+    memfault_packetizer_abort();
+  }
+
+  void teardown() {
+    mock().checkExpectations();
+    mock().clear();
+  }
+
+  //! Feeds the chunks of all the packets sent to a decoder
+  void check_decoded(size_t num_msgs) {
+    sMfltIngestionDecoder decoder;
+    memfault_ingestion_decoder_init(&decoder, DEVICE_SERIAL, NULL, NULL);
+    for (size_t i = 0; i < s_num_sent; i++) {
+      sPublish publish;
+      prv_parse_publish(&s_sent[i], &publish);
+      CHECK(memfault_ingestion_decoder_feed_chunk(&decoder, publish.payload, publish.payload_len));
+    }
+    LONGS_EQUAL(num_msgs, decoder.stats.num_messages);
+    LONGS_EQUAL(0, decoder.stats.num_framing_errors);
+    LONGS_EQUAL(0, decoder.stats.num_crc_errors);
+    LONGS_EQUAL(0, decoder.stats.num_decode_errors);
+    memfault_ingestion_decoder_deinit(&decoder);
+  }
+};
+
+TEST(MfltMqttPublishUpload, Test_BadInput) {
+  LONGS_EQUAL(MemfaultInternalReturnCode_InvalidInput, memfault_mqtt_upload_start(NULL, NULL));
+  LONGS_EQUAL(MemfaultInternalReturnCode_InvalidInput, memfault_mqtt_upload_start(&upload, NULL));
+
+  sMfltMqttUploadConfig cfg = s_upload_config;
+  cfg.transport = NULL;
+  LONGS_EQUAL(MemfaultInternalReturnCode_InvalidInput, memfault_mqtt_upload_start(&upload, &cfg));
+
+  cfg = s_upload_config;
+  cfg.window_size = MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT + 1;
+  LONGS_EQUAL(MemfaultInternalReturnCode_InvalidInput, memfault_mqtt_upload_start(&upload, &cfg));
+
+  // the topic must fit in MEMFAULT_MQTT_MAX_TOPIC_LEN
+  char long_prefix[MEMFAULT_MQTT_MAX_TOPIC_LEN + 1];
+  memset(long_prefix, 'a', sizeof(long_prefix) - 1);
+  long_prefix[sizeof(long_prefix) - 1] = '\0';
+  cfg = s_upload_config;
+  cfg.topic_prefix = long_prefix;
+  LONGS_EQUAL(MemfaultInternalReturnCode_InvalidInput, memfault_mqtt_upload_start(&upload, &cfg));
+}
+
+TEST(MfltMqttPublishUpload, Test_NoDataFound) {
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_NoDataFound,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  LONGS_EQUAL(0, s_num_sent);
+  LONGS_EQUAL(0, s_num_complete);
+  CHECK_FALSE(memfault_mqtt_upload_in_progress(&upload));
+}
+
+TEST(MfltMqttPublishUpload, Test_PublishFormat) {
+  fake_event_data_source_queue_msg(300);
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  CHECK(memfault_mqtt_upload_in_progress(&upload));
+
+  // the message, its type byte, the chunk header byte and the CRC16 fit in a single chunk
+  LONGS_EQUAL(1, s_num_sent);
+  sPublish publish;
+  prv_parse_publish(&s_sent[0], &publish);
+  LONGS_EQUAL(0x32, publish.type_and_flags); // PUBLISH, QoS 1
+  STRCMP_EQUAL(TOPIC, publish.topic);
+  LONGS_EQUAL(1, publish.packet_id);
+  LONGS_EQUAL(300 + FAKE_EVENT_DATA_SOURCE_MSG_HDR_LEN + 1 + 1 + 2, publish.payload_len);
+  // the chunk is sent from the buffer the packetizer wrote it to
+  POINTERS_EQUAL(&upload.tx_buf[upload.max_hdr_len], (const uint8_t *)s_sent[0].src +
+                                                         (publish.payload - s_sent[0].data));
+
+  // the message is only deleted once the PUBLISH has been acknowledged
+  LONGS_EQUAL(0, fake_event_data_source_get_num_msgs_read());
+  CHECK(memfault_mqtt_upload_on_puback(&upload, 1));
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+  LONGS_EQUAL(1, s_num_complete);
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, s_result);
+  CHECK_FALSE(memfault_mqtt_upload_in_progress(&upload));
+
+  LONGS_EQUAL(1, upload.stats.num_messages);
+  LONGS_EQUAL(1, upload.stats.num_publishes);
+  LONGS_EQUAL(1, upload.stats.num_pubacks);
+  LONGS_EQUAL(s_sent[0].len, upload.stats.tx_bytes);
+  check_decoded(1);
+}
+
+TEST(MfltMqttPublishUpload, Test_TopicPrefix) {
+  fake_event_data_source_queue_msg(256);
+  sMfltMqttUploadConfig cfg = s_upload_config;
+  cfg.topic_prefix = "fleet/prod";
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started, memfault_mqtt_upload_start(&upload, &cfg));
+  sPublish publish;
+  prv_parse_publish(&s_sent[0], &publish);
+  STRCMP_EQUAL("fleet/prod/" DEVICE_SERIAL "/chunks", publish.topic);
+  prv_ack_all(&upload);
+}
+
+TEST(MfltMqttPublishUpload, Test_WindowLimitsPublishesInFlight) {
+  // a message which spans many chunks
+  fake_event_data_source_queue_msg(4000);
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  LONGS_EQUAL(MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT, s_num_sent);
+  LONGS_EQUAL(MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT, upload.num_in_flight);
+
+  // every PUBACK lets one more PUBLISH out
+  CHECK(prv_puback(&upload, 0));
+  LONGS_EQUAL(MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT + 1, s_num_sent);
+  LONGS_EQUAL(MEMFAULT_MQTT_UPLOAD_MAX_IN_FLIGHT, upload.num_in_flight);
+
+  prv_ack_all(&upload);
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, s_result);
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+  LONGS_EQUAL(s_num_sent, upload.stats.num_pubacks);
+  check_decoded(1);
+}
+
+TEST(MfltMqttPublishUpload, Test_SmallerWindow) {
+  fake_event_data_source_queue_msg(4000);
+  sMfltMqttUploadConfig cfg = s_upload_config;
+  cfg.window_size = 2;
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started, memfault_mqtt_upload_start(&upload, &cfg));
+  LONGS_EQUAL(2, s_num_sent);
+  prv_ack_all(&upload);
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, s_result);
+  check_decoded(1);
+}
+
+TEST(MfltMqttPublishUpload, Test_PubacksOutOfOrder) {
+  fake_event_data_source_queue_msg(4000);
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+
+  // acknowledge the newest PUBLISH in flight every time
+  while (memfault_mqtt_upload_in_progress(&upload)) {
+    CHECK(upload.num_in_flight > 0);
+    size_t newest = s_num_sent - 1;
+    while (s_acked[newest]) {
+      newest--;
+    }
+    CHECK(prv_puback(&upload, newest));
+    // the message can't be deleted while any of its chunks are unacknowledged
+    if (upload.num_in_flight != 0) {
+      LONGS_EQUAL(0, fake_event_data_source_get_num_msgs_read());
+    }
+  }
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, s_result);
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+  LONGS_EQUAL(s_num_sent, upload.stats.num_pubacks);
+  check_decoded(1);
+}
+
+TEST(MfltMqttPublishUpload, Test_SeveralMessages) {
+  const size_t payload_lens[] = { 256, 2000, 300, 1200, 777 };
+  for (size_t i = 0; i < MEMFAULT_ARRAY_SIZE(payload_lens); i++) {
+    fake_event_data_source_queue_msg(payload_lens[i]);
+  }
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  // the window doesn't span messages, the next one is read once the first has been deleted
+  LONGS_EQUAL(1, s_num_sent);
+
+  prv_ack_all(&upload);
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, s_result);
+  LONGS_EQUAL(MEMFAULT_ARRAY_SIZE(payload_lens), fake_event_data_source_get_num_msgs_read());
+  LONGS_EQUAL(MEMFAULT_ARRAY_SIZE(payload_lens), upload.stats.num_messages);
+  check_decoded(MEMFAULT_ARRAY_SIZE(payload_lens));
+}
+
+TEST(MfltMqttPublishUpload, Test_ForeignPuback) {
+  fake_event_data_source_queue_msg(256);
+  // PUBACKs with no upload in progress belong to someone else
+  CHECK_FALSE(memfault_mqtt_upload_on_puback(&upload, 1));
+
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  CHECK_FALSE(memfault_mqtt_upload_on_puback(&upload, 1234));
+  CHECK(memfault_mqtt_upload_in_progress(&upload));
+  LONGS_EQUAL(0, upload.stats.num_pubacks);
+
+  CHECK(memfault_mqtt_upload_on_puback(&upload, 1));
+  // a duplicate PUBACK is not the upload's anymore
+  CHECK_FALSE(memfault_mqtt_upload_on_puback(&upload, 1));
+  LONGS_EQUAL(1, s_num_complete);
+}
+
+TEST(MfltMqttPublishUpload, Test_PacketIdsSkipZero) {
+  fake_event_data_source_queue_msg(4000);
+  upload.next_packet_id = 0xfffe;
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  LONGS_EQUAL(0xfffe, prv_packet_id(0));
+  LONGS_EQUAL(0xffff, prv_packet_id(1));
+  LONGS_EQUAL(1, prv_packet_id(2));
+  LONGS_EQUAL(2, prv_packet_id(3));
+  prv_ack_all(&upload);
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, s_result);
+}
+
+TEST(MfltMqttPublishUpload, Test_PacketIdsCarryOver) {
+  fake_event_data_source_queue_msg(256);
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  prv_ack_all(&upload);
+
+  fake_event_data_source_queue_msg(256);
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  LONGS_EQUAL(2, prv_packet_id(1));
+  prv_ack_all(&upload);
+  LONGS_EQUAL(2, upload.stats.num_messages);
+  LONGS_EQUAL(2, upload.stats.num_publishes);
+}
+
+TEST(MfltMqttPublishUpload, Test_DisconnectResendsMessage) {
+  fake_event_data_source_queue_msg(256);
+  fake_event_data_source_queue_msg(4000);
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  CHECK(prv_puback(&upload, 0));
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+  // some chunks of the second message are acknowledged before the connection drops
+  CHECK(prv_puback(&upload, 1));
+  CHECK(prv_puback(&upload, 2));
+
+  memfault_mqtt_upload_on_disconnect(&upload);
+  LONGS_EQUAL(1, s_num_complete);
+  LONGS_EQUAL(kMfltMqttUploadResult_Disconnected, s_result);
+  CHECK_FALSE(memfault_mqtt_upload_in_progress(&upload));
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+  // nothing happens when no upload is in progress
+  memfault_mqtt_upload_on_disconnect(&upload);
+  LONGS_EQUAL(1, s_num_complete);
+
+  // the second message is sent again from its start by the next upload
+  const size_t first_retry = s_num_sent;
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  sPublish original;
+  sPublish retry;
+  prv_parse_publish(&s_sent[1], &original);
+  prv_parse_publish(&s_sent[first_retry], &retry);
+  LONGS_EQUAL(original.payload_len, retry.payload_len);
+  MEMCMP_EQUAL(original.payload, retry.payload, original.payload_len);
+
+  // PUBACKs of the PUBLISHes lost with the connection never come
+  for (size_t i = 0; i < first_retry; i++) {
+    s_acked[i] = true;
+  }
+  prv_ack_all(&upload);
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, s_result);
+  LONGS_EQUAL(2, fake_event_data_source_get_num_msgs_read());
+}
+
+TEST(MfltMqttPublishUpload, Test_SendError) {
+  fake_event_data_source_queue_msg(4000);
+  s_send_rv = -5;
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  LONGS_EQUAL(1, s_num_complete);
+  LONGS_EQUAL(kMfltMqttUploadResult_SendError, s_result);
+  CHECK_FALSE(memfault_mqtt_upload_in_progress(&upload));
+  LONGS_EQUAL(0, fake_event_data_source_get_num_msgs_read());
+
+  // the message is still there for the next upload
+  s_send_rv = 0;
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  prv_ack_all(&upload);
+  LONGS_EQUAL(kMfltMqttUploadResult_Success, s_result);
+  LONGS_EQUAL(1, fake_event_data_source_get_num_msgs_read());
+  check_decoded(1);
+}
+
+TEST(MfltMqttPublishUpload, Test_StartWhileInProgress) {
+  fake_event_data_source_queue_msg(256);
+  LONGS_EQUAL(kMfltMqttUploadStartStatus_Started,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  LONGS_EQUAL(MemfaultInternalReturnCode_Error,
+              memfault_mqtt_upload_start(&upload, &s_upload_config));
+  prv_ack_all(&upload);
+}
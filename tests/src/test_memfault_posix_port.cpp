@@ -0,0 +1,687 @@
+//! @file
+//!
+//! Exercises the POSIX port: file backed storage, locking, the heartbeat timer thread, the
+//! socket based HTTP client and the gateway, the latter two against HTTP servers running on the
+//! host
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+  #include "memfault/core/compiler.h"
+  #include "memfault/core/data_packetizer.h"
+  #include "memfault/core/platform/overrides.h"
+  #include "memfault/http/http_client.h"
+  #include "memfault/http/platform/http_client.h"
+  #include "memfault/metrics/platform/timer.h"
+  #include "memfault/panics/platform/coredump.h"
+  #include "memfault/posix_port/gateway.h"
+  #include "memfault/posix_port/port.h"
+  #include "memfault/util/crc16_ccitt.h"
+  #include "memfault_ingestion_server.h"
+  #include "memfault_posix_port_private.h"
+
+  sMfltHttpClientConfig g_mflt_http_client_config;
+
+  //
+  // A fake packetizer where every message fits in a single chunk. Each chunk holds a valid
+  // heartbeat event so it can be decoded by the ingestion stand-in server.
+  //
+
+  #define FAKE_MSG_LEN 20
+
+  static void prv_build_fake_chunk(uint8_t *buf) {
+    static const uint8_t s_event[] = {
+      0x02, 0xA2, 0x02, 0x01, 0x07, 0x6B,
+      'i', 'n', 't', 'e', 'g', 'r', 'a', 't', 'i', 'o', 'n',
+    };
+    // single chunk message, CRC at the end
+    buf[0] = 0x08;
+    memcpy(&buf[1], s_event, sizeof(s_event));
+    const uint16_t crc =
+        memfault_crc16_ccitt_compute(MEMFAULT_CRC16_CCITT_INITIAL_VALUE, s_event, sizeof(s_event));
+    buf[1 + sizeof(s_event)] = crc & 0xff;
+    buf[2 + sizeof(s_event)] = (crc >> 8) & 0xff;
+  }
+
+  static size_t s_num_msgs_pending;
+  static size_t s_num_aborts;
+
+  bool memfault_packetizer_data_available(void) {
+    return s_num_msgs_pending != 0;
+  }
+
+  bool memfault_packetizer_begin(MEMFAULT_UNUSED const sPacketizerConfig *cfg,
+                                 sPacketizerMetadata *metadata_out) {
+    if (s_num_msgs_pending == 0) {
+      return false;
+    }
+    memset(metadata_out, 0, sizeof(*metadata_out));
+    metadata_out->single_chunk_message_length = FAKE_MSG_LEN;
+    return true;
+  }
+
+  eMemfaultPacketizerStatus memfault_packetizer_get_next(void *buf, size_t *buf_len) {
+    if (s_num_msgs_pending == 0) {
+      return kMemfaultPacketizerStatus_NoMoreData;
+    }
+    prv_build_fake_chunk((uint8_t *)buf);
+    *buf_len = FAKE_MSG_LEN;
+    s_num_msgs_pending--;
+    return kMemfaultPacketizerStatus_EndOfChunk;
+  }
+
+  void memfault_packetizer_abort(void) {
+    s_num_aborts++;
+  }
+
+  // memfault_http_chunk_batch_build() isn't used by the gateway, only the compression helper
+  bool memfault_packetizer_get_chunk(MEMFAULT_UNUSED void *buf, MEMFAULT_UNUSED size_t *buf_len) {
+    return false;
+  }
+}
+
+static char s_storage_dir[64];
+
+static void prv_remove_storage_dir(void) {
+  char cmd[128];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", s_storage_dir);
+  CHECK(system(cmd) == 0);
+}
+
+TEST_GROUP(MfltPosixPortStorage) {
+  void setup() {
+    snprintf(s_storage_dir, sizeof(s_storage_dir), "/tmp/memfault_posix_test_%d", (int)getpid());
+    setenv("MEMFAULT_POSIX_STORAGE_DIR", s_storage_dir, 1);
+  }
+  void teardown() {
+    prv_remove_storage_dir();
+    unsetenv("MEMFAULT_POSIX_STORAGE_DIR");
+  }
+};
+
+TEST(MfltPosixPortStorage, Test_StorageDir) {
+  STRCMP_EQUAL(s_storage_dir, memfault_posix_port_get_storage_dir());
+  unsetenv("MEMFAULT_POSIX_STORAGE_DIR");
+  STRCMP_EQUAL(MEMFAULT_POSIX_STORAGE_DIR, memfault_posix_port_get_storage_dir());
+}
+
+TEST(MfltPosixPortStorage, Test_MappedFilePersists) {
+  uint8_t *region = (uint8_t *)memfault_posix_port_map_file("region.bin", 64);
+  CHECK(region != NULL);
+  // a new file starts out zeroed
+  for (size_t i = 0; i < 64; i++) {
+    LONGS_EQUAL(0, region[i]);
+  }
+  memcpy(region, "persisted", sizeof("persisted"));
+
+  // the data is visible through the file right away, as it would be after a crash
+  char path[128];
+  snprintf(path, sizeof(path), "%s/region.bin", s_storage_dir);
+  const int fd = open(path, O_RDONLY);
+  CHECK(fd >= 0);
+  char buf[sizeof("persisted")];
+  LONGS_EQUAL(sizeof(buf), read(fd, buf, sizeof(buf)));
+  close(fd);
+  STRCMP_EQUAL("persisted", buf);
+
+  // and when the file is mapped again, i.e by the next run of the process
+  const char *remapped = (const char *)memfault_posix_port_map_file("region.bin", 64);
+  STRCMP_EQUAL("persisted", remapped);
+}
+
+TEST(MfltPosixPortStorage, Test_CoredumpStorage) {
+  memfault_posix_port_coredump_storage_boot();
+
+  sMfltCoredumpStorageInfo info;
+  memfault_platform_coredump_storage_get_info(&info);
+  LONGS_EQUAL(MEMFAULT_POSIX_COREDUMP_STORAGE_SIZE, info.size);
+
+  const uint8_t data[] = { 1, 2, 3, 4 };
+  CHECK(memfault_platform_coredump_storage_write(100, data, sizeof(data)));
+  uint8_t read_buf[sizeof(data)];
+  CHECK(memfault_platform_coredump_storage_read(100, read_buf, sizeof(read_buf)));
+  MEMCMP_EQUAL(data, read_buf, sizeof(data));
+
+  CHECK(memfault_platform_coredump_storage_erase(100, sizeof(data)));
+  CHECK(memfault_platform_coredump_storage_read(100, read_buf, sizeof(read_buf)));
+  const uint8_t zeros[sizeof(data)] = { 0 };
+  MEMCMP_EQUAL(zeros, read_buf, sizeof(zeros));
+
+  // out of bounds accesses are rejected
+  CHECK(!memfault_platform_coredump_storage_write(info.size - 1, data, sizeof(data)));
+  CHECK(!memfault_platform_coredump_storage_read(info.size, read_buf, 1));
+}
+
+//
+// Locking and the heartbeat timer
+//
+
+static volatile bool s_thread_has_lock;
+
+static void *prv_lock_thread(MEMFAULT_UNUSED void *arg) {
+  memfault_lock();
+  s_thread_has_lock = true;
+  memfault_unlock();
+  return NULL;
+}
+
+static volatile size_t s_timer_fired_count;
+
+static void prv_timer_callback(void) {
+  s_timer_fired_count++;
+}
+
+TEST_GROUP(MfltPosixPort) {
+  void setup() {
+    s_thread_has_lock = false;
+    s_timer_fired_count = 0;
+  }
+  void teardown() {
+    memfault_posix_port_metrics_timer_stop();
+  }
+};
+
+TEST(MfltPosixPort, Test_LockIsRecursive) {
+  memfault_lock();
+  memfault_lock();
+
+  pthread_t thread;
+  LONGS_EQUAL(0, pthread_create(&thread, NULL, prv_lock_thread, NULL));
+  memfault_unlock();
+  usleep(20 * 1000);
+  // still held once
+  CHECK(!s_thread_has_lock);
+
+  memfault_unlock();
+  pthread_join(thread, NULL);
+  CHECK(s_thread_has_lock);
+}
+
+TEST(MfltPosixPort, Test_MetricsTimer) {
+  // MEMFAULT_POSIX_METRICS_TIMER_MS_PER_SEC is lowered to 10 for the test so this fires every 20ms
+  CHECK(memfault_platform_metrics_timer_boot(2, prv_timer_callback));
+  for (int i = 0; (i < 100) && (s_timer_fired_count < 3); i++) {
+    usleep(10 * 1000);
+  }
+  CHECK(s_timer_fired_count >= 3);
+
+  memfault_posix_port_metrics_timer_stop();
+  const size_t count = s_timer_fired_count;
+  usleep(50 * 1000);
+  LONGS_EQUAL(count, s_timer_fired_count);
+}
+
+//
+// Stand-in for the Memfault chunks endpoint which answers every request with s_server.response
+//
+
+static struct {
+  pthread_t thread;
+  int listen_fd;
+  uint16_t port;
+  volatile bool stop;
+  const char *response;
+  //! Close the connection after each response
+  volatile bool close_after_response;
+  volatile size_t num_connections;
+  volatile size_t num_requests;
+} s_server;
+
+//! @return the length of the request at the start of buf or 0 if it has not been fully received
+static size_t prv_server_request_len(const char *buf, size_t len) {
+  const char *hdr_end = (const char *)memmem(buf, len, "\r\n\r\n", 4);
+  if (hdr_end == NULL) {
+    return 0;
+  }
+
+  size_t content_length = 0;
+  for (const char *line = buf; line < hdr_end; line = strstr(line, "\r\n") + 2) {
+    if (strncasecmp(line, "Content-Length:", strlen("Content-Length:")) == 0) {
+      content_length = strtoul(line + strlen("Content-Length:"), NULL, 10);
+    }
+  }
+  const size_t request_len = (size_t)(hdr_end + 4 - buf) + content_length;
+  return (request_len <= len) ? request_len : 0;
+}
+
+static void prv_server_handle_connection(int fd) {
+  char buf[4096];
+  size_t len = 0;
+
+  while (!s_server.stop) {
+    struct pollfd poll_fd = { .fd = fd, .events = POLLIN };
+    if (poll(&poll_fd, 1, 50) == 0) {
+      continue;
+    }
+    const ssize_t bytes_read = recv(fd, &buf[len], sizeof(buf) - len, 0);
+    if (bytes_read <= 0) {
+      break;
+    }
+    len += (size_t)bytes_read;
+
+    const size_t request_len = prv_server_request_len(buf, len);
+    if (request_len == 0) {
+      continue;
+    }
+    CHECK(strncmp(buf, "POST /api/v0/chunks/", strlen("POST /api/v0/chunks/")) == 0);
+    memmove(buf, &buf[request_len], len - request_len);
+    len -= request_len;
+    s_server.num_requests++;
+
+    const size_t rsp_len = strlen(s_server.response);
+    LONGS_EQUAL(rsp_len, send(fd, s_server.response, rsp_len, 0));
+    if (s_server.close_after_response) {
+      break;
+    }
+  }
+  close(fd);
+}
+
+static void *prv_server_thread(MEMFAULT_UNUSED void *arg) {
+  while (!s_server.stop) {
+    struct pollfd poll_fd = { .fd = s_server.listen_fd, .events = POLLIN };
+    if (poll(&poll_fd, 1, 50) <= 0) {
+      continue;
+    }
+    const int fd = accept(s_server.listen_fd, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    s_server.num_connections++;
+    prv_server_handle_connection(fd);
+  }
+  return NULL;
+}
+
+static void prv_server_start(void) {
+  memset(&s_server, 0, sizeof(s_server));
+  s_server.response = "HTTP/1.1 202 Accepted\r\nContent-Length: 8\r\n\r\nAccepted";
+  s_server.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(s_server.listen_fd >= 0);
+
+  struct sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  LONGS_EQUAL(0, bind(s_server.listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  LONGS_EQUAL(0, listen(s_server.listen_fd, 4));
+
+  socklen_t addr_len = sizeof(addr);
+  LONGS_EQUAL(0, getsockname(s_server.listen_fd, (struct sockaddr *)&addr, &addr_len));
+  s_server.port = ntohs(addr.sin_port);
+
+  LONGS_EQUAL(0, pthread_create(&s_server.thread, NULL, prv_server_thread, NULL));
+}
+
+static void prv_server_stop(void) {
+  s_server.stop = true;
+  pthread_join(s_server.thread, NULL);
+  close(s_server.listen_fd);
+}
+
+static size_t s_num_callbacks;
+static bool s_last_response_null;
+static uint32_t s_last_status;
+static uint32_t s_last_retry_after_s;
+
+static void prv_response_callback(const sMfltHttpResponse *response,
+                                  MEMFAULT_UNUSED void *ctx) {
+  s_num_callbacks++;
+  s_last_response_null = (response == NULL);
+  if (response != NULL) {
+    LONGS_EQUAL(0, memfault_platform_http_response_get_status(response, &s_last_status));
+    if (memfault_platform_http_response_get_retry_after(response, &s_last_retry_after_s) != 0) {
+      s_last_retry_after_s = 0;
+    }
+  }
+}
+
+static sMfltHttpClient *s_client;
+
+TEST_GROUP(MfltPosixPortHttpClient) {
+  void setup() {
+    prv_server_start();
+    g_mflt_http_client_config = (sMfltHttpClientConfig) {
+      .api_key = "00112233445566778899aabbccddeeff",
+      .api_host = "127.0.0.1",
+      .api_no_tls = true,
+      .api_port = s_server.port,
+    };
+    s_num_msgs_pending = 0;
+    s_num_aborts = 0;
+    s_num_callbacks = 0;
+    s_last_status = 0;
+    s_last_retry_after_s = 0;
+    s_client = memfault_platform_http_client_create();
+    CHECK(s_client != NULL);
+  }
+
+  void teardown() {
+    memfault_platform_http_client_destroy(s_client);
+    prv_server_stop();
+  }
+};
+
+TEST(MfltPosixPortHttpClient, Test_TlsNotSupported) {
+  g_mflt_http_client_config.api_no_tls = false;
+  POINTERS_EQUAL(NULL, memfault_platform_http_client_create());
+}
+
+TEST(MfltPosixPortHttpClient, Test_NoData) {
+  LONGS_EQUAL(0, memfault_platform_http_client_post_data(s_client, prv_response_callback, NULL));
+  LONGS_EQUAL(0, s_num_callbacks);
+  LONGS_EQUAL(0, s_server.num_connections);
+}
+
+TEST(MfltPosixPortHttpClient, Test_PostsReuseTheConnection) {
+  s_num_msgs_pending = 3;
+  LONGS_EQUAL(0, memfault_platform_http_client_post_data(s_client, prv_response_callback, NULL));
+  LONGS_EQUAL(0, s_num_msgs_pending);
+  LONGS_EQUAL(3, s_server.num_requests);
+  LONGS_EQUAL(1, s_num_callbacks);
+  CHECK(!s_last_response_null);
+  LONGS_EQUAL(202, s_last_status);
+
+  s_num_msgs_pending = 1;
+  LONGS_EQUAL(0, memfault_platform_http_client_post_data(s_client, prv_response_callback, NULL));
+  LONGS_EQUAL(4, s_server.num_requests);
+  LONGS_EQUAL(1, s_server.num_connections);
+}
+
+TEST(MfltPosixPortHttpClient, Test_ServerClosesConnection) {
+  s_server.response = "HTTP/1.1 202 Accepted\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+  s_server.close_after_response = true;
+  s_num_msgs_pending = 2;
+  LONGS_EQUAL(0, memfault_platform_http_client_post_data(s_client, prv_response_callback, NULL));
+  LONGS_EQUAL(2, s_server.num_requests);
+  LONGS_EQUAL(2, s_server.num_connections);
+  LONGS_EQUAL(202, s_last_status);
+}
+
+TEST(MfltPosixPortHttpClient, Test_ErrorStopsPosting) {
+  s_server.response =
+      "HTTP/1.1 429 Too Many Requests\r\nRetry-After: 30\r\nContent-Length: 0\r\n\r\n";
+  s_num_msgs_pending = 3;
+  LONGS_EQUAL(0, memfault_platform_http_client_post_data(s_client, prv_response_callback, NULL));
+  LONGS_EQUAL(1, s_server.num_requests);
+  LONGS_EQUAL(2, s_num_msgs_pending);
+  LONGS_EQUAL(1, s_num_callbacks);
+  LONGS_EQUAL(429, s_last_status);
+  LONGS_EQUAL(30, s_last_retry_after_s);
+}
+
+TEST(MfltPosixPortHttpClient, Test_ConnectFails) {
+  prv_server_stop();
+  // the port of the client config stays bound, without anything listening on it, so a server
+  // started by another test can't be handed the same port and connecting to it is refused
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(fd >= 0);
+  struct sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(s_server.port);
+  LONGS_EQUAL(0, bind(fd, (struct sockaddr *)&addr, sizeof(addr)));
+
+  s_num_msgs_pending = 1;
+  CHECK(memfault_platform_http_client_post_data(s_client, prv_response_callback, NULL) < 0);
+  LONGS_EQUAL(1, s_num_callbacks);
+  CHECK(s_last_response_null);
+  // the message is kept for the next attempt
+  LONGS_EQUAL(1, s_num_msgs_pending);
+  LONGS_EQUAL(1, s_num_aborts);
+
+  close(fd);
+  prv_server_start();
+}
+
+TEST_GROUP(MfltPosixPortIngestion) {
+  sMfltIngestionServer *server;
+
+  void setup() {
+    const sMfltIngestionServerConfig config = {
+      .port = 0,
+      .project_key = "00112233445566778899aabbccddeeff",
+    };
+    server = memfault_ingestion_server_start(&config);
+    CHECK(server != NULL);
+    g_mflt_http_client_config = (sMfltHttpClientConfig) {
+      .api_key = config.project_key,
+      .api_host = "127.0.0.1",
+      .api_no_tls = true,
+      .api_port = memfault_ingestion_server_get_port(server),
+    };
+    s_num_msgs_pending = 0;
+    s_num_callbacks = 0;
+    s_last_status = 0;
+    s_client = memfault_platform_http_client_create();
+    CHECK(s_client != NULL);
+  }
+
+  void teardown() {
+    memfault_platform_http_client_destroy(s_client);
+    memfault_ingestion_server_stop(server);
+  }
+};
+
+TEST(MfltPosixPortIngestion, Test_ChunksAreDecoded) {
+  s_num_msgs_pending = 10;
+  LONGS_EQUAL(0, memfault_platform_http_client_post_data(s_client, prv_response_callback, NULL));
+  LONGS_EQUAL(0, s_num_msgs_pending);
+  LONGS_EQUAL(202, s_last_status);
+
+  sMfltIngestionDeviceStats stats;
+  CHECK(memfault_ingestion_server_get_device_stats(server, "DAABBCCDD", &stats));
+  LONGS_EQUAL(10, stats.num_requests);
+  LONGS_EQUAL(0, stats.num_rejected_requests);
+  LONGS_EQUAL(10, stats.decoder.num_chunks);
+  LONGS_EQUAL(10, stats.decoder.num_heartbeats);
+  LONGS_EQUAL(0, stats.decoder.num_crc_errors + stats.decoder.num_decode_errors +
+                     stats.decoder.num_framing_errors);
+}
+
+TEST(MfltPosixPortIngestion, Test_RetryAfterIsReported) {
+  memfault_ingestion_server_set_response(server, 503, 60);
+  s_num_msgs_pending = 2;
+  LONGS_EQUAL(0, memfault_platform_http_client_post_data(s_client, prv_response_callback, NULL));
+  LONGS_EQUAL(1, s_num_msgs_pending);
+  LONGS_EQUAL(503, s_last_status);
+  LONGS_EQUAL(60, s_last_retry_after_s);
+
+  memfault_ingestion_server_set_response(server, 0, 0);
+  LONGS_EQUAL(0, memfault_platform_http_client_post_data(s_client, prv_response_callback, NULL));
+  LONGS_EQUAL(202, s_last_status);
+
+  sMfltIngestionDeviceStats stats;
+  CHECK(memfault_ingestion_server_get_device_stats(server, "DAABBCCDD", &stats));
+  LONGS_EQUAL(2, stats.num_requests);
+  LONGS_EQUAL(1, stats.num_rejected_requests);
+  LONGS_EQUAL(1, stats.decoder.num_heartbeats);
+}
+
+TEST_GROUP(MfltPosixGateway) {
+  sMfltIngestionServer *server;
+  sMfltPosixGateway *gateway;
+
+  void setup() {
+    const sMfltIngestionServerConfig config = {
+      .port = 0,
+      .project_key = "00112233445566778899aabbccddeeff",
+    };
+    server = memfault_ingestion_server_start(&config);
+    CHECK(server != NULL);
+    g_mflt_http_client_config = (sMfltHttpClientConfig) {
+      .api_key = config.project_key,
+      .api_host = "127.0.0.1",
+      .api_no_tls = true,
+      .api_port = memfault_ingestion_server_get_port(server),
+    };
+    gateway = NULL;
+  }
+
+  void teardown() {
+    if (gateway != NULL) {
+      memfault_posix_gateway_stop(gateway);
+    }
+    memfault_ingestion_server_stop(server);
+  }
+
+  void start_gateway(bool compress) {
+    sMfltPosixGatewayConfig gateway_config = { };
+    gateway_config.max_devices = 8;
+    gateway_config.queue_size_per_device = 256;
+    gateway_config.max_batch_size = 1024;
+    gateway_config.linger_ms = 5;
+    gateway_config.compress = compress;
+    gateway = memfault_posix_gateway_start(&gateway_config);
+    CHECK(gateway != NULL);
+  }
+};
+
+#define NUM_GATEWAY_NODES 4
+#define NUM_CHUNKS_PER_NODE 50
+
+typedef struct {
+  sMfltPosixGateway *gateway;
+  char device_serial[16];
+  size_t num_queue_full;
+} sGatewayNode;
+
+//! A downstream device handing its chunks over to the gateway, as fast as the gateway takes them
+static void *prv_gateway_node_thread(void *arg) {
+  sGatewayNode *node = (sGatewayNode *)arg;
+  uint8_t chunk[FAKE_MSG_LEN];
+  prv_build_fake_chunk(chunk);
+
+  for (size_t i = 0; i < NUM_CHUNKS_PER_NODE; ) {
+    const int rv =
+        memfault_posix_gateway_add_chunk(node->gateway, node->device_serial, chunk, sizeof(chunk));
+    if (rv == kMfltGatewayError_QueueFull) {
+      // backpressure: hold off until the gateway has forwarded some chunks
+      node->num_queue_full++;
+      usleep(1000);
+      continue;
+    }
+    if (rv != 0) {
+      break;
+    }
+    i++;
+  }
+  return NULL;
+}
+
+static void prv_run_gateway_nodes(sMfltPosixGateway *gateway) {
+  pthread_t threads[NUM_GATEWAY_NODES];
+  sGatewayNode nodes[NUM_GATEWAY_NODES];
+  for (size_t i = 0; i < NUM_GATEWAY_NODES; i++) {
+    nodes[i] = (sGatewayNode) { .gateway = gateway };
+    snprintf(nodes[i].device_serial, sizeof(nodes[i].device_serial), "node-%d", (int)i);
+    LONGS_EQUAL(0, pthread_create(&threads[i], NULL, prv_gateway_node_thread, &nodes[i]));
+  }
+  for (size_t i = 0; i < NUM_GATEWAY_NODES; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  CHECK(memfault_posix_gateway_flush(gateway, 5000));
+}
+
+static void prv_check_nodes_forwarded(sMfltIngestionServer *server, sMfltPosixGateway *gateway) {
+  for (size_t i = 0; i < NUM_GATEWAY_NODES; i++) {
+    char device_serial[16];
+    snprintf(device_serial, sizeof(device_serial), "node-%d", (int)i);
+
+    sMfltIngestionDeviceStats stats;
+    CHECK(memfault_ingestion_server_get_device_stats(server, device_serial, &stats));
+    LONGS_EQUAL(NUM_CHUNKS_PER_NODE, stats.decoder.num_heartbeats);
+    LONGS_EQUAL(0, stats.num_rejected_requests);
+    LONGS_EQUAL(0, stats.decoder.num_crc_errors + stats.decoder.num_decode_errors +
+                       stats.decoder.num_framing_errors);
+
+    sMfltGatewayDeviceStats device_stats;
+    CHECK(memfault_posix_gateway_get_device_stats(gateway, device_serial, &device_stats));
+    LONGS_EQUAL(NUM_CHUNKS_PER_NODE, device_stats.num_chunks_forwarded);
+  }
+}
+
+TEST(MfltPosixGateway, Test_ChunksOfManyDevicesAreForwarded) {
+  start_gateway(false);
+  prv_run_gateway_nodes(gateway);
+  prv_check_nodes_forwarded(server, gateway);
+
+  sMfltPosixGatewayStats stats;
+  memfault_posix_gateway_get_stats(gateway, &stats);
+  LONGS_EQUAL(NUM_GATEWAY_NODES * NUM_CHUNKS_PER_NODE, stats.num_chunks_forwarded);
+  // all batches went over the same connection and held several chunks each
+  LONGS_EQUAL(1, stats.num_connections);
+  CHECK(stats.num_batches < (NUM_GATEWAY_NODES * NUM_CHUNKS_PER_NODE));
+  LONGS_EQUAL(0, stats.num_failed_batches + stats.num_dropped_batches);
+}
+
+TEST(MfltPosixGateway, Test_CompressedBatches) {
+  start_gateway(true);
+  prv_run_gateway_nodes(gateway);
+  prv_check_nodes_forwarded(server, gateway);
+
+  sMfltPosixGatewayStats stats;
+  memfault_posix_gateway_get_stats(gateway, &stats);
+  CHECK(stats.body_bytes < stats.uncompressed_body_bytes);
+}
+
+TEST(MfltPosixGateway, Test_FailedBatchIsRetried) {
+  start_gateway(false);
+  memfault_ingestion_server_set_response(server, 503, 0);
+
+  uint8_t chunk[FAKE_MSG_LEN];
+  prv_build_fake_chunk(chunk);
+  LONGS_EQUAL(0, memfault_posix_gateway_add_chunk(gateway, "node-0", chunk, sizeof(chunk)));
+
+  sMfltPosixGatewayStats stats;
+  for (int i = 0; i < 500; i++) {
+    memfault_posix_gateway_get_stats(gateway, &stats);
+    if (stats.num_failed_batches != 0) {
+      break;
+    }
+    usleep(1000);
+  }
+  CHECK(stats.num_failed_batches != 0);
+
+  memfault_ingestion_server_set_response(server, 0, 0);
+  CHECK(memfault_posix_gateway_flush(gateway, 5000));
+
+  sMfltIngestionDeviceStats device_stats;
+  CHECK(memfault_ingestion_server_get_device_stats(server, "node-0", &device_stats));
+  LONGS_EQUAL(1, device_stats.decoder.num_heartbeats);
+}
+
+TEST(MfltPosixGateway, Test_RejectedBatchIsDropped) {
+  start_gateway(false);
+  memfault_ingestion_server_set_response(server, 400, 0);
+
+  uint8_t chunk[FAKE_MSG_LEN];
+  prv_build_fake_chunk(chunk);
+  LONGS_EQUAL(0, memfault_posix_gateway_add_chunk(gateway, "node-0", chunk, sizeof(chunk)));
+  CHECK(memfault_posix_gateway_flush(gateway, 5000));
+
+  sMfltPosixGatewayStats stats;
+  memfault_posix_gateway_get_stats(gateway, &stats);
+  LONGS_EQUAL(1, stats.num_dropped_batches);
+  LONGS_EQUAL(0, stats.num_chunks_forwarded);
+
+  // chunks which could never fit in a batch are refused up front
+  uint8_t big_chunk[1024] = { 0 };
+  LONGS_EQUAL(kMfltGatewayError_ChunkTooLarge,
+              memfault_posix_gateway_add_chunk(gateway, "node-0", big_chunk, sizeof(big_chunk)));
+}
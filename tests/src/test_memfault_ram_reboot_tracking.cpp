@@ -6,16 +6,23 @@
 #include <string.h>
 
 extern "C" {
+  #include "memfault/core/boot_profile.h"
   #include "memfault/panics/reboot_tracking.h"
   #include "memfault_reboot_tracking_private.h"
 
   static uint8_t s_mflt_reboot_tracking_region[MEMFAULT_REBOOT_TRACKING_REGION_SIZE];
+  static uint64_t s_fake_time_since_boot_ms;
+
+  uint64_t memfault_reboot_tracking_get_time_since_boot_ms(void) {
+    return s_fake_time_since_boot_ms;
+  }
 }
 
 TEST_GROUP(MfltStorageTestGroup) {
   void setup() {
     // simulate memory initializing with random pattern at boot
     memset(&s_mflt_reboot_tracking_region[0], 0xBA, sizeof(s_mflt_reboot_tracking_region));
+    s_fake_time_since_boot_ms = 0;
     memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
     memfault_reboot_tracking_reset_crash_count();
   }
@@ -90,3 +97,130 @@ TEST(MfltStorageTestGroup, Test_CrashTracking) {
   crash_count = memfault_reboot_tracking_get_crash_count();
   LONGS_EQUAL(0, crash_count);
 }
+
+TEST(MfltStorageTestGroup, Test_RebootHistory) {
+  const size_t num_resets = 3;
+  for (uint32_t i = 0; i < num_resets; i++) {
+    s_fake_time_since_boot_ms = 1000 * (i + 1);
+    sMfltRebootTrackingRegInfo reg_info = {
+      .pc = 0x100 + i,
+      .lr = 0x200 + i,
+    };
+    memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_Assert, &reg_info);
+    // only the first reset flagged during a boot is tracked
+    memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_UserReset, NULL);
+    if (i == 1) {
+      memfault_reboot_tracking_mark_coredump_saved();
+    }
+
+    const sResetBootupInfo bootup_info = {
+      .reset_reason_reg = 0x10 + i,
+    };
+    memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, &bootup_info);
+  }
+
+  // an unexpected reset with no information available isn't recorded
+  memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
+
+  sMfltResetReasonInfo read_info;
+  for (uint32_t i = 0; i < num_resets; i++) {
+    CHECK(memfault_reboot_tracking_read_reset_history(i, &read_info));
+    LONGS_EQUAL(kMfltRebootReason_Assert, read_info.reason);
+    LONGS_EQUAL(0x100 + i, read_info.pc);
+    LONGS_EQUAL(0x200 + i, read_info.lr);
+    LONGS_EQUAL(0x10 + i, read_info.reset_reason_reg0);
+    LONGS_EQUAL(1000 * (i + 1), read_info.uptime_ms);
+    LONGS_EQUAL(i == 1, read_info.coredump_saved);
+  }
+  CHECK(!memfault_reboot_tracking_read_reset_history(num_resets, &read_info));
+
+  // oldest entry is returned by the single read API
+  CHECK(memfault_reboot_tracking_read_reset_info(&read_info));
+  LONGS_EQUAL(0x100, read_info.pc);
+
+  memfault_reboot_tracking_clear_reset_info();
+  CHECK(!memfault_reboot_tracking_read_reset_history(0, &read_info));
+}
+
+TEST(MfltStorageTestGroup, Test_RebootHistoryOverflow) {
+  const size_t num_resets = MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE + 2;
+  for (uint32_t i = 0; i < num_resets; i++) {
+    const sMfltRebootTrackingRegInfo reg_info = {
+      .pc = i + 1,
+      .lr = 0,
+    };
+    memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_FirmwareUpdate, &reg_info);
+    memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
+  }
+
+  // the most recent resets should be retained, oldest first
+  sMfltResetReasonInfo read_info;
+  for (size_t i = 0; i < MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE; i++) {
+    CHECK(memfault_reboot_tracking_read_reset_history(i, &read_info));
+    LONGS_EQUAL(kMfltRebootReason_FirmwareUpdate, read_info.reason);
+    LONGS_EQUAL(num_resets - MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE + i + 1, read_info.pc);
+  }
+  CHECK(!memfault_reboot_tracking_read_reset_history(MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE,
+                                                     &read_info));
+  LONGS_EQUAL(0, memfault_reboot_tracking_get_crash_count());
+}
+
+TEST(MfltStorageTestGroup, Test_CorruptHistoryIndices) {
+  memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_Assert, NULL);
+
+  // history_head & history_count live at offset 28 of the region, point them past the ring
+  s_mflt_reboot_tracking_region[28] = 0xBA;
+  s_mflt_reboot_tracking_region[29] = 0xBA;
+  memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
+
+  // the corrupt history is dropped and only the reset which just took place is recorded
+  sMfltResetReasonInfo read_info;
+  CHECK(memfault_reboot_tracking_read_reset_info(&read_info));
+  LONGS_EQUAL(kMfltRebootReason_Assert, read_info.reason);
+  CHECK(!memfault_reboot_tracking_read_reset_history(1, &read_info));
+}
+
+TEST(MfltStorageTestGroup, Test_UptimeSaturates) {
+  s_fake_time_since_boot_ms = ((uint64_t)UINT32_MAX) + 1;
+  memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_HardFault, NULL);
+  memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
+
+  sMfltResetReasonInfo read_info;
+  CHECK(memfault_reboot_tracking_read_reset_info(&read_info));
+  LONGS_EQUAL(UINT32_MAX, read_info.uptime_ms);
+  LONGS_EQUAL(1, memfault_reboot_tracking_get_crash_count());
+}
+
+TEST(MfltStorageTestGroup, Test_UpgradeFromVersion2) {
+  memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_Assert, NULL);
+
+  // simulate a region written by an older SDK: version 2 with garbage beyond the 64 byte struct
+  s_mflt_reboot_tracking_region[4] = 2;
+  memset(&s_mflt_reboot_tracking_region[64], 0xBA, sizeof(s_mflt_reboot_tracking_region) - 64);
+  memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
+
+  sMfltResetReasonInfo read_info;
+  CHECK(memfault_reboot_tracking_read_reset_info(&read_info));
+  LONGS_EQUAL(kMfltRebootReason_Assert, read_info.reason);
+  CHECK(!memfault_reboot_tracking_read_reset_history(1, &read_info));
+}
+
+TEST(MfltStorageTestGroup, Test_BootProfileUptimeAtReset) {
+  s_fake_time_since_boot_ms = 5000;
+  memfault_reboot_tracking_mark_reset_imminent(kMfltRebootReason_UserReset, NULL);
+  memfault_reboot_tracking_boot(s_mflt_reboot_tracking_region, NULL);
+
+  sMfltBootProfile profile;
+  CHECK(!memfault_boot_profile_get(&profile));
+  memfault_boot_complete();
+  CHECK(memfault_boot_profile_get(&profile));
+  LONGS_EQUAL(5000, profile.uptime_at_reset_ms);
+  // no cycle counter available
+  LONGS_EQUAL(0, profile.boot_duration_ms);
+
+  // with no reboot tracking region, the boot can still be profiled
+  memfault_reboot_tracking_boot(NULL, NULL);
+  memfault_boot_complete();
+  CHECK(memfault_boot_profile_get(&profile));
+  LONGS_EQUAL(0, profile.uptime_at_reset_ms);
+}
@@ -10,10 +10,16 @@
 #include "memfault_reboot_tracking_private.h"
 
 static sMfltResetReasonInfo s_fake_reset_reason_info;
+static sMfltResetReasonInfo s_fake_reset_history[MEMFAULT_REBOOT_TRACKING_HISTORY_SIZE];
+static size_t s_fake_reset_history_count;
 static const sMemfaultEventStorageImpl *s_fake_event_storage_impl;
 
-bool memfault_reboot_tracking_read_reset_info(sMfltResetReasonInfo *info) {
-  *info = s_fake_reset_reason_info;
+bool memfault_reboot_tracking_read_reset_history(size_t index, sMfltResetReasonInfo *info) {
+  if (index >= s_fake_reset_history_count) {
+    return false;
+  }
+  // the first entry is always the one being modified by the test
+  *info = (index == 0) ? s_fake_reset_reason_info : s_fake_reset_history[index];
   return true;
 }
 
@@ -32,6 +38,7 @@ TEST_GROUP(MfltRebootTrackingSerializer) {
       .lr = 0xdeadbeef,
       .reset_reason_reg0 = 0x12345678,
     };
+    s_fake_reset_history_count = 1;
   }
 
   void teardown() {
@@ -107,7 +114,78 @@ TEST(MfltRebootTrackingSerializer, Test_Serialize) {
                                        sizeof(expected_data_no_optionals), &s_fake_reset_reason_info);
 }
 
+TEST(MfltRebootTrackingSerializer, Test_SerializeUptime) {
+  s_fake_reset_reason_info.uptime_ms = 0x10000;
+  const uint8_t expected_data[] = {
+    0xa7, 0x02, 0x02, 0x03, 0x01, 0x07, 0x69, 0x44, 0x41, 0x41, 0x42, 0x42, 0x43, 0x43, 0x44, 0x44,
+    0x0a, 0x64, 0x6d, 0x61, 0x69, 0x6e, 0x09, 0x65, 0x31, 0x2e, 0x32, 0x2e, 0x33, 0x06, 0x66, 0x65,
+    0x76, 0x74, 0x5f, 0x32, 0x34, 0x04, 0xa6, 0x01, 0x19, 0x80, 0x01, 0x02, 0x1a, 0x0b, 0xad, 0xca,
+    0xfe, 0x03, 0x1a, 0xde, 0xad, 0xbe, 0xef, 0x04, 0x1a, 0x12, 0x34, 0x56, 0x78, 0x05, 0x00, 0x07,
+    0x1a, 0x00, 0x01, 0x00, 0x00
+  };
+  prv_run_reset_reason_serializer_test(expected_data, sizeof(expected_data),
+                                       &s_fake_reset_reason_info);
+}
+
+TEST(MfltRebootTrackingSerializer, Test_SerializeHistory) {
+  s_fake_reset_reason_info.reset_reason_reg0 = 0;
+  s_fake_reset_history[1] = (sMfltResetReasonInfo) {
+    .reason = kMfltRebootReason_HardFault,
+    .pc = 0x10,
+    .coredump_saved = true,
+  };
+  s_fake_reset_history[2] = (sMfltResetReasonInfo) {
+    .reason = kMfltRebootReason_Watchdog,
+    .reset_reason_reg0 = 0x20,
+    .uptime_ms = 0x30,
+  };
+  s_fake_reset_history_count = 3;
+
+  const uint8_t expected_data[] = {
+    0xa7, 0x02, 0x02, 0x03, 0x01, 0x07, 0x69, 0x44, 0x41, 0x41, 0x42, 0x42, 0x43, 0x43, 0x44, 0x44,
+    0x0a, 0x64, 0x6d, 0x61, 0x69, 0x6e, 0x09, 0x65, 0x31, 0x2e, 0x32, 0x2e, 0x33, 0x06, 0x66, 0x65,
+    0x76, 0x74, 0x5f, 0x32, 0x34, 0x04, 0xa5, 0x01, 0x19, 0x80, 0x01, 0x02, 0x1a, 0x0b, 0xad, 0xca,
+    0xfe, 0x03, 0x1a, 0xde, 0xad, 0xbe, 0xef, 0x05, 0x00,
+    // reboot history
+    0x08, 0x82,
+    0xa3, 0x01, 0x19, 0x94, 0x00, 0x02, 0x10, 0x05, 0x01,
+    0xa4, 0x01, 0x19, 0x80, 0x02, 0x04, 0x18, 0x20, 0x05, 0x00, 0x07, 0x18, 0x30,
+  };
+  prv_run_reset_reason_serializer_test(expected_data, sizeof(expected_data),
+                                       &s_fake_reset_reason_info);
+}
+
+TEST(MfltRebootTrackingSerializer, Test_SerializeTruncatedHistory) {
+  s_fake_reset_history[1] = (sMfltResetReasonInfo) {
+    .reason = kMfltRebootReason_HardFault,
+    .pc = 0x10,
+    .coredump_saved = true,
+  };
+  s_fake_reset_history_count = 2;
+
+  // the storage can hold the oldest reset but not the history which followed it
+  const uint8_t expected_data[] = {
+    0xa7, 0x02, 0x02, 0x03, 0x01, 0x07, 0x69, 0x44, 0x41, 0x41, 0x42, 0x42, 0x43, 0x43, 0x44, 0x44,
+    0x0a, 0x64, 0x6d, 0x61, 0x69, 0x6e, 0x09, 0x65, 0x31, 0x2e, 0x32, 0x2e, 0x33, 0x06, 0x66, 0x65,
+    0x76, 0x74, 0x5f, 0x32, 0x34, 0x04, 0xa5, 0x01, 0x19, 0x80, 0x01, 0x02, 0x1a, 0x0b, 0xad, 0xca,
+    0xfe, 0x03, 0x1a, 0xde, 0xad, 0xbe, 0xef, 0x04, 0x1a, 0x12, 0x34, 0x56, 0x78, 0x05, 0x00,
+  };
+  prv_run_reset_reason_serializer_test(expected_data, sizeof(expected_data),
+                                       &s_fake_reset_reason_info);
+}
+
+TEST(MfltRebootTrackingSerializer, Test_StorageTooSmallForOneReset) {
+  fake_memfault_event_storage_clear();
+  fake_memfault_event_storage_set_available_space(10);
+
+  // the history is kept so it can be collected once there is room for it
+  mock().expectOneCall("prv_begin_write");
+  mock().expectOneCall("prv_finish_write").withParameter("rollback", true);
+  const int rv = memfault_reboot_tracking_collect_reset_info(s_fake_event_storage_impl);
+  LONGS_EQUAL(-2, rv);
+}
+
 TEST(MfltRebootTrackingSerializer, Test_GetWorstCaseSerializeSize) {
   const size_t worst_case_size = memfault_reboot_tracking_compute_worst_case_storage_size();
-  LONGS_EQUAL(63, worst_case_size);
+  LONGS_EQUAL(164, worst_case_size);
 }
@@ -0,0 +1,453 @@
+//! @file
+//!
+//! Exercises the keep-alive connection and the delivery confirmation of the Zephyr HTTP port
+//! against a minimal HTTP server running on the host
+
+#include "CppUTest/MemoryLeakDetectorMallocMacros.h"
+#include "CppUTest/MemoryLeakDetectorNewMacros.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+  #include "memfault/core/compiler.h"
+  #include "memfault/core/data_packetizer.h"
+  #include "memfault/core/event_storage.h"
+  #include "memfault/core/math.h"
+  #include "memfault/http/http_client.h"
+  #include "memfault/metrics/metrics.h"
+  #include "memfault/metrics/platform/timer.h"
+  #include "memfault/metrics/serializer.h"
+  #include "memfault_zephyr_http.h"
+  #include "net/tls_credentials.h"
+
+  sMfltHttpClientConfig g_mflt_http_client_config;
+
+  static int64_t s_fake_uptime_ms;
+
+  int64_t k_uptime_get(void) {
+    return s_fake_uptime_ms;
+  }
+
+  int tls_credential_add(MEMFAULT_UNUSED sec_tag_t tag,
+                         MEMFAULT_UNUSED enum tls_credential_type type,
+                         MEMFAULT_UNUSED const void *cred, MEMFAULT_UNUSED size_t credlen) {
+    return 0;
+  }
+
+  //
+  // A fake packetizer where every message fits in a single chunk and is only deleted once its
+  // delivery has been confirmed
+  //
+
+  #define FAKE_MSG_LEN 20
+
+  static size_t s_num_msgs_pending;
+  static bool s_awaiting_confirmation;
+
+  bool memfault_packetizer_begin(const sPacketizerConfig *cfg,
+                                 sPacketizerMetadata *metadata_out) {
+    CHECK(cfg->enable_delivery_confirmation);
+    // a message whose delivery was never confirmed is sent again
+    s_awaiting_confirmation = false;
+    if (s_num_msgs_pending == 0) {
+      return false;
+    }
+    memset(metadata_out, 0, sizeof(*metadata_out));
+    metadata_out->single_chunk_message_length = FAKE_MSG_LEN;
+    return true;
+  }
+
+  eMemfaultPacketizerStatus memfault_packetizer_get_next(void *buf, size_t *buf_len) {
+    if ((s_num_msgs_pending == 0) || s_awaiting_confirmation) {
+      return kMemfaultPacketizerStatus_NoMoreData;
+    }
+    memset(buf, 'm', FAKE_MSG_LEN);
+    *buf_len = FAKE_MSG_LEN;
+    s_awaiting_confirmation = true;
+    return kMemfaultPacketizerStatus_EndOfChunk;
+  }
+
+  void memfault_packetizer_confirm_delivery(void) {
+    CHECK(s_awaiting_confirmation);
+    s_awaiting_confirmation = false;
+    s_num_msgs_pending--;
+  }
+
+  void memfault_packetizer_abort(void) {
+    s_awaiting_confirmation = false;
+  }
+}
+
+//
+// The connection metrics are recorded in the heartbeat, which is never serialized by these tests
+//
+
+#define FAKE_STORAGE_SIZE 100
+
+bool memfault_platform_metrics_timer_boot(MEMFAULT_UNUSED uint32_t period_sec,
+                                          MEMFAULT_UNUSED MemfaultPlatformTimerCallback callback) {
+  return true;
+}
+
+bool memfault_metrics_heartbeat_serialize(
+    MEMFAULT_UNUSED const sMemfaultEventStorageImpl *storage_impl) {
+  return true;
+}
+
+size_t memfault_metrics_heartbeat_compute_worst_case_storage_size(void) {
+  return FAKE_STORAGE_SIZE;
+}
+
+bool memfault_metrics_ctx_heartbeat_serialize(MEMFAULT_UNUSED sMfltMetricsCtx *ctx) {
+  return true;
+}
+
+size_t memfault_metrics_ctx_heartbeat_compute_worst_case_storage_size(
+    MEMFAULT_UNUSED sMfltMetricsCtx *ctx) {
+  return FAKE_STORAGE_SIZE;
+}
+
+static uint32_t prv_read_metric(MemfaultMetricId key) {
+  uint32_t value = 0;
+  LONGS_EQUAL(0, memfault_metrics_heartbeat_read_unsigned(key, &value));
+  return value;
+}
+
+//
+// Stand-in for the Memfault chunks endpoint. Requests are accumulated until the client stops
+// sending for a little while and the responses for the whole batch are then sent back with a
+// single write so they arrive back-to-back. A client waiting for a response after each request
+// therefore results in a batch size of 1.
+//
+// Responses carry 'status_code'. When 'close_before_response' is set, the connection is closed
+// once the next batch of requests has been received, without responding.
+//
+
+#define SERVER_MAX_BATCHES 16
+
+static struct {
+  pthread_t thread;
+  int listen_fd;
+  uint16_t port;
+  volatile bool stop;
+  //! Close the connection once the next batch of responses has been sent
+  volatile bool close_after_response;
+  volatile bool close_before_response;
+  volatile int status_code;
+  volatile size_t num_connections;
+  volatile size_t num_requests;
+  volatile size_t num_batches;
+  size_t batch_sizes[SERVER_MAX_BATCHES];
+} s_server;
+
+//! @return the length of the request at the start of buf or 0 if it has not been fully received
+static size_t prv_server_request_len(const char *buf, size_t len) {
+  const char *hdr_end = (const char *)memmem(buf, len, "\r\n\r\n", 4);
+  if (hdr_end == NULL) {
+    return 0;
+  }
+  CHECK(strncmp(buf, "POST /api/v0/chunks/", strlen("POST /api/v0/chunks/")) == 0);
+
+  size_t content_length = 0;
+  for (const char *line = buf; line < hdr_end; line = strstr(line, "\r\n") + 2) {
+    if (strncasecmp(line, "Content-Length:", strlen("Content-Length:")) == 0) {
+      content_length = strtoul(line + strlen("Content-Length:"), NULL, 10);
+    }
+  }
+  const size_t request_len = (size_t)(hdr_end + 4 - buf) + content_length;
+  return (request_len <= len) ? request_len : 0;
+}
+
+static void prv_server_send_responses(int fd, size_t num_responses) {
+  char rsp[1024];
+  size_t rsp_len = 0;
+  for (size_t i = 0; i < num_responses; i++) {
+    // alternate between responses with and without a body
+    const char *fmt = ((i % 2) == 0) ?
+        "HTTP/1.1 %d Status\r\nContent-Length: 8\r\n\r\nAccepted" :
+        "HTTP/1.1 %d Status\r\nContent-Length: 0\r\n\r\n";
+    rsp_len += (size_t)snprintf(&rsp[rsp_len], sizeof(rsp) - rsp_len, fmt, s_server.status_code);
+  }
+  LONGS_EQUAL(rsp_len, send(fd, rsp, rsp_len, 0));
+
+  if (s_server.num_batches < SERVER_MAX_BATCHES) {
+    s_server.batch_sizes[s_server.num_batches] = num_responses;
+  }
+  s_server.num_batches++;
+}
+
+static void prv_server_handle_connection(int fd) {
+  char buf[4096];
+  size_t len = 0;
+  size_t num_pending = 0;
+
+  while (!s_server.stop) {
+    struct pollfd poll_fd = { .fd = fd, .events = POLLIN };
+    const int rv = poll(&poll_fd, 1, 100);
+    if (rv == 0) {
+      if (num_pending == 0) {
+        continue;
+      }
+      if (s_server.close_before_response) {
+        s_server.close_before_response = false;
+        break;
+      }
+      prv_server_send_responses(fd, num_pending);
+      num_pending = 0;
+      if (s_server.close_after_response) {
+        s_server.close_after_response = false;
+        break;
+      }
+      continue;
+    }
+
+    const ssize_t bytes_read = recv(fd, &buf[len], sizeof(buf) - len, 0);
+    if (bytes_read <= 0) {
+      break;
+    }
+    len += (size_t)bytes_read;
+
+    size_t request_len;
+    while ((request_len = prv_server_request_len(buf, len)) != 0) {
+      memmove(buf, &buf[request_len], len - request_len);
+      len -= request_len;
+      num_pending++;
+      s_server.num_requests++;
+    }
+  }
+  close(fd);
+}
+
+static void *prv_server_thread(MEMFAULT_UNUSED void *arg) {
+  while (!s_server.stop) {
+    struct pollfd poll_fd = { .fd = s_server.listen_fd, .events = POLLIN };
+    if (poll(&poll_fd, 1, 50) <= 0) {
+      continue;
+    }
+    const int fd = accept(s_server.listen_fd, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    s_server.num_connections++;
+    prv_server_handle_connection(fd);
+  }
+  return NULL;
+}
+
+static void prv_server_start(void) {
+  memset(&s_server, 0, sizeof(s_server));
+  s_server.status_code = 202;
+  s_server.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(s_server.listen_fd >= 0);
+
+  struct sockaddr_in addr = { };
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  LONGS_EQUAL(0, bind(s_server.listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+  LONGS_EQUAL(0, listen(s_server.listen_fd, 4));
+
+  socklen_t addr_len = sizeof(addr);
+  LONGS_EQUAL(0, getsockname(s_server.listen_fd, (struct sockaddr *)&addr, &addr_len));
+  s_server.port = ntohs(addr.sin_port);
+
+  LONGS_EQUAL(0, pthread_create(&s_server.thread, NULL, prv_server_thread, NULL));
+}
+
+static void prv_server_stop(void) {
+  s_server.stop = true;
+  pthread_join(s_server.thread, NULL);
+  close(s_server.listen_fd);
+}
+
+//! Waits for the server thread to observe something the client has done
+static void prv_wait_for(volatile size_t *value, size_t expected) {
+  for (int i = 0; (i < 100) && (*value != expected); i++) {
+    usleep(10 * 1000);
+  }
+  LONGS_EQUAL(expected, *value);
+}
+
+TEST_GROUP(MfltZephyrHttp) {
+  void setup() {
+    // sending on a connection the server closed fails with EPIPE, as it does on Zephyr, rather
+    // than raising SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+    prv_server_start();
+    g_mflt_http_client_config = (sMfltHttpClientConfig) {
+      .api_key = "00112233445566778899aabbccddeeff",
+      .api_host = "127.0.0.1",
+      .api_no_tls = true,
+      .api_port = s_server.port,
+    };
+    s_fake_uptime_ms = 0;
+    s_num_msgs_pending = 0;
+    s_awaiting_confirmation = false;
+
+    static uint8_t s_storage[FAKE_STORAGE_SIZE];
+    LONGS_EQUAL(0, memfault_metrics_boot(memfault_events_storage_boot(&s_storage,
+                                                                      sizeof(s_storage))));
+  }
+
+  void teardown() {
+    memfault_zephyr_port_http_close();
+    prv_server_stop();
+    mock().checkExpectations();
+    mock().clear();
+  }
+};
+
+TEST(MfltZephyrHttp, Test_NoData) {
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(0, s_server.num_requests);
+}
+
+TEST(MfltZephyrHttp, Test_EachPostAwaitsItsResponse) {
+  s_num_msgs_pending = 6;
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(1, s_num_msgs_pending);
+  LONGS_EQUAL(5, s_server.num_requests);
+  prv_wait_for(&s_server.num_batches, 5);
+  for (size_t i = 0; i < 5; i++) {
+    LONGS_EQUAL(1, s_server.batch_sizes[i]);
+  }
+
+  // the connection is reused for the next post
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(0, s_num_msgs_pending);
+  LONGS_EQUAL(6, s_server.num_requests);
+  LONGS_EQUAL(1, s_server.num_connections);
+}
+
+TEST(MfltZephyrHttp, Test_IdleTimeoutReconnects) {
+  s_num_msgs_pending = 1;
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+
+  s_fake_uptime_ms += 1000;
+  s_num_msgs_pending = 1;
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(1, s_server.num_connections);
+
+  s_fake_uptime_ms += 30000;
+  s_num_msgs_pending = 1;
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  prv_wait_for(&s_server.num_connections, 2);
+  LONGS_EQUAL(3, s_server.num_requests);
+}
+
+TEST(MfltZephyrHttp, Test_ServerClosedConnection) {
+  s_server.close_after_response = true;
+  s_num_msgs_pending = 2;
+  LONGS_EQUAL(-1, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(1, s_server.num_batches);
+  LONGS_EQUAL(1, s_num_msgs_pending);
+
+  // the closed connection is detected and the message it lost is sent on a new one
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  prv_wait_for(&s_server.num_connections, 2);
+  prv_wait_for(&s_server.num_requests, 2);
+  LONGS_EQUAL(0, s_num_msgs_pending);
+}
+
+TEST(MfltZephyrHttp, Test_ConnectionLostBeforeResponseKeepsMessage) {
+  s_server.close_before_response = true;
+  s_num_msgs_pending = 2;
+  LONGS_EQUAL(-1, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(1, s_server.num_requests);
+  LONGS_EQUAL(2, s_num_msgs_pending);
+
+  // the message is sent again on a new connection
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  prv_wait_for(&s_server.num_connections, 2);
+  LONGS_EQUAL(3, s_server.num_requests);
+  LONGS_EQUAL(0, s_num_msgs_pending);
+}
+
+TEST(MfltZephyrHttp, Test_ServerErrorKeepsMessage) {
+  s_server.status_code = 503;
+  s_num_msgs_pending = 2;
+  LONGS_EQUAL(-1, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(1, s_server.num_requests);
+  LONGS_EQUAL(2, s_num_msgs_pending);
+
+  s_server.status_code = 202;
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  prv_wait_for(&s_server.num_requests, 3);
+  LONGS_EQUAL(0, s_num_msgs_pending);
+}
+
+TEST(MfltZephyrHttp, Test_RejectedMessageIsDropped) {
+  // the server will never accept the message so it isn't sent again
+  s_server.status_code = 400;
+  s_num_msgs_pending = 2;
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(2, s_server.num_requests);
+  LONGS_EQUAL(0, s_num_msgs_pending);
+}
+
+TEST(MfltZephyrHttp, Test_DnsCache) {
+  // every connection after the first one uses the cached address until it expires
+  for (int i = 0; i < 3; i++) {
+    s_num_msgs_pending = 1;
+    LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+    memfault_zephyr_port_http_close();
+    s_fake_uptime_ms += 1000;
+  }
+  prv_wait_for(&s_server.num_connections, 3);
+  LONGS_EQUAL(1, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpDnsLookups)));
+  LONGS_EQUAL(2, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpDnsCacheHits)));
+  LONGS_EQUAL(3, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpConnections)));
+  LONGS_EQUAL(0, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpConnectFailures)));
+
+  s_fake_uptime_ms += 300 * 1000;
+  s_num_msgs_pending = 1;
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(2, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpDnsLookups)));
+  LONGS_EQUAL(2, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpDnsCacheHits)));
+  LONGS_EQUAL(4, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpConnections)));
+
+  // each heartbeat covers the connections made since the previous one
+  memfault_metrics_heartbeat_debug_trigger();
+  LONGS_EQUAL(0, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpDnsLookups)));
+  LONGS_EQUAL(0, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpConnections)));
+}
+
+TEST(MfltZephyrHttp, Test_DnsCacheInvalidatedOnConnectFailure) {
+  s_num_msgs_pending = 1;
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  memfault_zephyr_port_http_close();
+  memfault_metrics_heartbeat_debug_trigger();
+
+  // nothing listens on the cached address anymore
+  const uint16_t port = s_server.port;
+  prv_server_stop();
+  prv_server_start();
+  g_mflt_http_client_config.api_port = port;
+  s_num_msgs_pending = 1;
+  LONGS_EQUAL(-1, memfault_zephyr_port_post_data());
+
+  // the host is looked up again before giving up
+  LONGS_EQUAL(1, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpDnsCacheHits)));
+  LONGS_EQUAL(1, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpDnsLookups)));
+  LONGS_EQUAL(2, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpConnectFailures)));
+  LONGS_EQUAL(0, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpConnections)));
+  memfault_metrics_heartbeat_debug_trigger();
+
+  // and a new server address is picked up right away
+  g_mflt_http_client_config.api_port = s_server.port;
+  LONGS_EQUAL(0, memfault_zephyr_port_post_data());
+  LONGS_EQUAL(1, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpDnsLookups)));
+  LONGS_EQUAL(1, prv_read_metric(MEMFAULT_METRICS_KEY(MemfaultSdkMetric_HttpConnections)));
+}
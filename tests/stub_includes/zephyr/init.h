@@ -0,0 +1,15 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Minimal stand-in for the Zephyr init API so the Zephyr port can be unit tested on the host
+
+struct device;
+
+//! Rather than running at boot, the init function is exposed so a test can invoke it
+#define SYS_INIT(init_fn, level, prio) \
+  int (*const g_sys_init_##init_fn)(struct device *dev) = init_fn
@@ -0,0 +1,15 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Minimal stand-in for the Zephyr kernel API so the Zephyr port can be unit tested on the host
+
+#include <stdint.h>
+
+struct device;
+
+int64_t k_uptime_get(void);
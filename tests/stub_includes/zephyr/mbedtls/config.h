@@ -0,0 +1,11 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Minimal stand-in for the mbedTLS configuration used by the Zephyr port
+
+#define MBEDTLS_SSL_SERVER_NAME_INDICATION
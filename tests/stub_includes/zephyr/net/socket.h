@@ -0,0 +1,27 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Zephyr's BSD socket API mirrors POSIX so the host implementation is used for unit tests. Only
+//! the TLS extensions need to be stubbed out.
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define IPPROTO_TLS_1_2 258
+#define SOL_TLS 282
+#define TLS_SEC_TAG_LIST 1
+#define TLS_HOSTNAME 2
+#define TLS_SESSION_CACHE 12
+#define TLS_SESSION_CACHE_DISABLED 0
+#define TLS_SESSION_CACHE_ENABLED 1
+
+typedef int sec_tag_t;
@@ -0,0 +1,21 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Minimal stand-in for the Zephyr TLS credentials API so the Zephyr port can be unit tested on
+//! the host
+
+#include <stddef.h>
+
+#include "net/socket.h"
+
+enum tls_credential_type {
+  TLS_CREDENTIAL_CA_CERTIFICATE = 1,
+};
+
+int tls_credential_add(sec_tag_t tag, enum tls_credential_type type, const void *cred,
+                       size_t credlen);
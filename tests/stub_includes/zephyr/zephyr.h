@@ -0,0 +1,11 @@
+#pragma once
+
+//! @file
+//!
+//! Copyright (c) Memfault, Inc.
+//! See License.txt for details
+//!
+//! @brief
+//! Minimal stand-in for the Zephyr kernel API so the Zephyr port can be unit tested on the host
+
+#include "kernel.h"